@@ -46,6 +46,7 @@
 #include "memref.h"
 #include "memtrace_stream.h"
 #include "trace_entry.h"
+#include <iostream>
 #include <string>
 #include <vector>
 
@@ -178,6 +179,23 @@ public:
      */
     virtual bool
     process_memref(const RecordType &entry) = 0;
+    /**
+     * Operates on \p count consecutive trace entries starting at \p entries, with the
+     * same effect as calling process_memref() on each of them in turn.  This is only
+     * invoked if memref_batch_supported() returns true.  The default implementation
+     * does just that; a tool may override it to avoid a virtual call per entry.
+     * The return value indicates whether it was successful.
+     * On failure, get_error_string() returns a descriptive message.
+     */
+    virtual bool
+    process_memref_batch(const RecordType *entries, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            if (!process_memref(entries[i]))
+                return false;
+        }
+        return true;
+    }
     /**
      * This routine reports the results of the trace analysis.
      * It should leave the i/o state in a default format (std::dec) to support
@@ -329,6 +347,25 @@ public:
     {
         return true;
     }
+    /**
+     * Prints the result for the single whole-trace interval in \p snapshot to \p out.
+     * This is invoked instead of print_interval_results() when the framework streams
+     * interval results as each whole-trace interval completes (see the
+     * -interval_stream_file option).  \p prev_snapshot is the whole-trace snapshot
+     * streamed just before this one, or nullptr for the first interval, for tools that
+     * report per-interval deltas.  The default implementation prints the instruction
+     * counts maintained by the framework.
+     */
+    virtual bool
+    print_interval_result(const interval_state_snapshot_t *snapshot,
+                          const interval_state_snapshot_t *prev_snapshot,
+                          std::ostream &out)
+    {
+        out << "Interval #" << snapshot->interval_id << " ending at timestamp "
+            << snapshot->interval_end_timestamp << ": " << snapshot->instr_count_delta
+            << " instructions, " << snapshot->instr_count_cumulative << " cumulative\n";
+        return true;
+    }
     /**
      * Notifies the tool that the \p interval_state_snapshot_t object pointed to
      * by \p interval_snapshot is no longer needed by the framework. The tool may
@@ -350,6 +387,21 @@ public:
     {
         return false;
     }
+    /**
+     * Returns whether this tool accepts trace entries in batches through
+     * process_memref_batch() and parallel_shard_memref_batch().  If every tool being
+     * run returns true, the analyzer reads and delivers entries in batches, which
+     * avoids much of its per-entry overhead.  During a batch the memtrace_stream_t
+     * queries describe the final entry of the batch rather than the entry being
+     * processed, so a tool whose per-entry processing uses those queries should
+     * return false, as the default does.  Timestamp markers and thread exits are
+     * always the final entry of a batch.  This may be called prior to initialize().
+     */
+    virtual bool
+    memref_batch_supported()
+    {
+        return false;
+    }
     /**
      * Invoked once for each worker thread prior to calling any shard routine from
      * that thread.  This allows a tool to create data local to a worker, such as a
@@ -430,6 +482,24 @@ public:
     {
         return false;
     }
+    /**
+     * Operates on \p count consecutive trace entries of one shard starting at \p
+     * entries, with the same effect as calling parallel_shard_memref() on each of them
+     * in turn.  This is only invoked if memref_batch_supported() returns true.  The
+     * default implementation does just that; a tool may override it to avoid a
+     * virtual call per entry.  The return value indicates whether this function was
+     * successful. On failure, parallel_shard_error() returns a descriptive message.
+     */
+    virtual bool
+    parallel_shard_memref_batch(void *shard_data, const RecordType *entries,
+                                size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            if (!parallel_shard_memref(shard_data, entries[i]))
+                return false;
+        }
+        return true;
+    }
     /** Returns a description of the last error for this shard. */
     virtual std::string
     parallel_shard_error(void *shard_data)
@@ -493,6 +563,51 @@ typedef analysis_tool_tmpl_t<memref_t> analysis_tool_t;
 /** See #dynamorio::drmemtrace::analysis_tool_tmpl_t. */
 typedef analysis_tool_tmpl_t<trace_entry_t> record_analysis_tool_t;
 
+/**
+ * An analysis tool of type \p ToolType which accepts trace entries in batches can
+ * subclass batched_analysis_tool_tmpl_t<ToolType, RecordType> in place of
+ * analysis_tool_tmpl_t<RecordType>.  Its process_memref_batch() and
+ * parallel_shard_memref_batch() invoke \p ToolType's process_memref() and
+ * parallel_shard_memref() on each entry without a virtual call per entry, and its
+ * memref_batch_supported() returns true.  Since those calls are not virtual, a
+ * further subclass of \p ToolType that overrides process_memref() or
+ * parallel_shard_memref() must override the batch routines as well.
+ */
+template <typename ToolType, typename RecordType>
+class batched_analysis_tool_tmpl_t : public analysis_tool_tmpl_t<RecordType> {
+public:
+    bool
+    process_memref_batch(const RecordType *entries, size_t count) override
+    {
+        ToolType *tool = static_cast<ToolType *>(this);
+        for (size_t i = 0; i < count; ++i) {
+            if (!tool->ToolType::process_memref(entries[i]))
+                return false;
+        }
+        return true;
+    }
+    bool
+    memref_batch_supported() override
+    {
+        return true;
+    }
+    bool
+    parallel_shard_memref_batch(void *shard_data, const RecordType *entries,
+                                size_t count) override
+    {
+        ToolType *tool = static_cast<ToolType *>(this);
+        for (size_t i = 0; i < count; ++i) {
+            if (!tool->ToolType::parallel_shard_memref(shard_data, entries[i]))
+                return false;
+        }
+        return true;
+    }
+};
+
+/** See #dynamorio::drmemtrace::batched_analysis_tool_tmpl_t. */
+template <typename ToolType>
+using batched_analysis_tool_t = batched_analysis_tool_tmpl_t<ToolType, memref_t>;
+
 } // namespace drmemtrace
 } // namespace dynamorio
 
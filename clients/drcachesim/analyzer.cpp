@@ -44,9 +44,11 @@
 
 #include <algorithm>
 #include <cassert>
+#include <functional>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <string>
 #include <thread>
@@ -401,6 +403,60 @@ analyzer_tmpl_t<RecordType, ReaderType>::advance_interval_id(
     return false;
 }
 
+template <typename RecordType, typename ReaderType>
+typename analyzer_tmpl_t<RecordType, ReaderType>::sched_type_t::stream_status_t
+analyzer_tmpl_t<RecordType, ReaderType>::next_records(analyzer_worker_data_t *worker,
+                                                      std::vector<RecordType> &records,
+                                                      size_t &count, uint64_t cur_micros)
+{
+    if (batch_size_ > 1)
+        return worker->stream->next_record_batch(records.data(), batch_size_, count,
+                                                 cur_micros);
+    count = 1;
+    return worker->stream->next_record(records[0], cur_micros);
+}
+
+template <typename RecordType, typename ReaderType>
+bool
+analyzer_tmpl_t<RecordType, ReaderType>::process_records_serial(
+    analyzer_worker_data_t *worker, const RecordType *records, size_t count)
+{
+    for (int i = 0; i < num_tools_; ++i) {
+        bool res = batch_size_ > 1 ? tools_[i]->process_memref_batch(records, count)
+                                   : tools_[i]->process_memref(records[0]);
+        if (!res) {
+            worker->error = tools_[i]->get_error_string();
+            VPRINT(this, 1, "Worker %d hit memref error %s on trace shard %s\n",
+                   worker->index, worker->error.c_str(),
+                   worker->stream->get_stream_name().c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename RecordType, typename ReaderType>
+bool
+analyzer_tmpl_t<RecordType, ReaderType>::process_records_parallel(
+    analyzer_worker_data_t *worker, int shard_index, const RecordType *records,
+    size_t count)
+{
+    for (int i = 0; i < num_tools_; ++i) {
+        void *shard_data = worker->shard_data[shard_index].tool_data[i].shard_data;
+        bool res = batch_size_ > 1
+            ? tools_[i]->parallel_shard_memref_batch(shard_data, records, count)
+            : tools_[i]->parallel_shard_memref(shard_data, records[0]);
+        if (!res) {
+            worker->error = tools_[i]->parallel_shard_error(shard_data);
+            VPRINT(this, 1, "Worker %d hit shard memref error %s on trace shard %s\n",
+                   worker->index, worker->error.c_str(),
+                   worker->stream->get_stream_name().c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
 template <typename RecordType, typename ReaderType>
 void
 analyzer_tmpl_t<RecordType, ReaderType>::process_serial(analyzer_worker_data_t &worker)
@@ -418,13 +474,14 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_serial(analyzer_worker_data_t &
         if (!worker.error.empty())
             return;
     }
+    std::vector<RecordType> records(batch_size_);
     while (true) {
-        RecordType record;
+        size_t count;
         // The current time is used for time quanta; for instr quanta, it's ignored and
         // we pass 0.
         uint64_t cur_micros = sched_by_time_ ? get_current_microseconds() : 0;
         typename sched_type_t::stream_status_t status =
-            worker.stream->next_record(record, cur_micros);
+            next_records(&worker, records, count, cur_micros);
         if (status != sched_type_t::STATUS_OK) {
             if (status != sched_type_t::STATUS_EOF) {
                 if (status == sched_type_t::STATUS_REGION_INVALID) {
@@ -442,24 +499,22 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_serial(analyzer_worker_data_t &
             }
             return;
         }
+        // Only the final record of a batch can be a timestamp.  The interval it ends
+        // must be processed before the tools see it.
+        const RecordType &last = records[count - 1];
+        if (count > 1 && !process_records_serial(&worker, records.data(), count - 1))
+            return;
         uint64_t prev_interval_index;
         uint64_t prev_interval_init_instr_count;
-        if (record_is_timestamp(record) &&
+        if (record_is_timestamp(last) &&
             advance_interval_id(worker.stream, &worker.shard_data[0], prev_interval_index,
                                 prev_interval_init_instr_count) &&
             !process_interval(prev_interval_index, prev_interval_init_instr_count,
                               &worker, /*parallel=*/false)) {
             return;
         }
-        for (int i = 0; i < num_tools_; ++i) {
-            if (!tools_[i]->process_memref(record)) {
-                worker.error = tools_[i]->get_error_string();
-                VPRINT(this, 1, "Worker %d hit memref error %s on trace shard %s\n",
-                       worker.index, worker.error.c_str(),
-                       worker.stream->get_stream_name().c_str());
-                return;
-            }
-        }
+        if (!process_records_serial(&worker, &last, 1))
+            return;
     }
 }
 
@@ -476,6 +531,11 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_shard_exit(
                           worker,
                           /*parallel=*/true, shard_index))
         return false;
+    if (interval_microseconds_ != 0 && interval_sink_ &&
+        !stream_shard_interval_snapshots(shard_index, {},
+                                         std::numeric_limits<uint64_t>::max(),
+                                         worker->error))
+        return false;
     for (int i = 0; i < num_tools_; ++i) {
         if (!tools_[i]->parallel_shard_exit(
                 worker->shard_data[shard_index].tool_data[i].shard_data)) {
@@ -499,14 +559,15 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_tasks(analyzer_worker_data_t *w
     for (int i = 0; i < num_tools_; ++i)
         user_worker_data[i] = tools_[i]->parallel_worker_init(worker->index);
 
-    RecordType record;
+    std::vector<RecordType> records(batch_size_);
+    size_t count;
     // The current time is used for time quanta; for instr quanta, it's ignored and
     // we pass 0.
     uint64_t cur_micros = sched_by_time_ ? get_current_microseconds() : 0;
     for (typename sched_type_t::stream_status_t status =
-             worker->stream->next_record(record, cur_micros);
+             next_records(worker, records, count, cur_micros);
          status != sched_type_t::STATUS_EOF;
-         status = worker->stream->next_record(record, cur_micros)) {
+         status = next_records(worker, records, count, cur_micros)) {
         if (sched_by_time_)
             cur_micros = get_current_microseconds();
         if (status == sched_type_t::STATUS_WAIT) {
@@ -525,6 +586,8 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_tasks(analyzer_worker_data_t *w
             }
             return;
         }
+        // A batch ends at a thread exit or a switch to another input, so all of its
+        // records come from the input the stream now describes.
         int shard_index = shard_type_ == SHARD_BY_CORE
             ? worker->index
             : worker->stream->get_input_stream_ordinal();
@@ -544,36 +607,41 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_tasks(analyzer_worker_data_t *w
         if (worker->shard_data[shard_index].shard_id == 0) {
             if (shard_type_ == SHARD_BY_CORE)
                 worker->shard_data[shard_index].shard_id = worker->index;
-            else if (record_has_tid(record, tid))
-                worker->shard_data[shard_index].shard_id = tid;
+            else {
+                for (size_t i = 0; i < count; ++i) {
+                    if (record_has_tid(records[i], tid)) {
+                        worker->shard_data[shard_index].shard_id = tid;
+                        break;
+                    }
+                }
+            }
         }
+        // Only the final record of a batch can be a timestamp.  The interval it ends
+        // must be processed before the tools see it.
+        const RecordType &last = records[count - 1];
+        if (count > 1 &&
+            !process_records_parallel(worker, shard_index, records.data(), count - 1))
+            return;
         uint64_t prev_interval_index;
         uint64_t prev_interval_init_instr_count;
-        if (record_is_timestamp(record) &&
+        if (record_is_timestamp(last) &&
             advance_interval_id(worker->stream, &worker->shard_data[shard_index],
                                 prev_interval_index, prev_interval_init_instr_count) &&
             !process_interval(prev_interval_index, prev_interval_init_instr_count, worker,
                               /*parallel=*/true, shard_index)) {
             return;
         }
-        for (int i = 0; i < num_tools_; ++i) {
-            if (!tools_[i]->parallel_shard_memref(
-                    worker->shard_data[shard_index].tool_data[i].shard_data, record)) {
-                worker->error = tools_[i]->parallel_shard_error(
-                    worker->shard_data[shard_index].tool_data[i].shard_data);
-                VPRINT(this, 1, "Worker %d hit shard memref error %s on trace shard %s\n",
-                       worker->index, worker->error.c_str(),
-                       worker->stream->get_stream_name().c_str());
-                return;
-            }
-        }
-        if (record_is_thread_final(record) && shard_type_ != SHARD_BY_CORE) {
+        if (!process_records_parallel(worker, shard_index, &last, 1))
+            return;
+        if (record_is_thread_final(last) && shard_type_ != SHARD_BY_CORE) {
             if (!process_shard_exit(worker, shard_index))
                 return;
         }
     }
     if (shard_type_ == SHARD_BY_CORE) {
-        if (!process_shard_exit(worker, worker->index))
+        // A core that never received any input has no shard to exit.
+        if (worker->shard_data.find(worker->index) != worker->shard_data.end() &&
+            !process_shard_exit(worker, worker->index))
             return;
     }
     for (int i = 0; i < num_tools_; ++i) {
@@ -635,14 +703,41 @@ analyzer_tmpl_t<RecordType, ReaderType>::merge_shard_interval_results(
 {
     assert(!intervals.empty());
     assert(merged_intervals.empty());
-    // Used to recompute the interval_id for the result whole trace intervals, which are
-    // numbered by the earliest shard's timestamp.
     uint64_t earliest_ever_interval_end_timestamp = std::numeric_limits<uint64_t>::max();
+    std::vector<interval_snapshot_t *> last_snapshot_per_shard(intervals.size(),
+                                                               nullptr);
+    if (!merge_shard_interval_results_before(
+            intervals, last_snapshot_per_shard, earliest_ever_interval_end_timestamp,
+            std::numeric_limits<uint64_t>::max(), tool_idx,
+            [&merged_intervals](interval_snapshot_t *merged) {
+                merged_intervals.push_back(merged);
+                return true;
+            }))
+        return false;
+    for (auto snapshot : last_snapshot_per_shard) {
+        if (snapshot != nullptr &&
+            !tools_[tool_idx]->release_interval_snapshot(snapshot)) {
+            error_string_ = tools_[tool_idx]->get_error_string();
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename RecordType, typename ReaderType>
+bool
+analyzer_tmpl_t<RecordType, ReaderType>::merge_shard_interval_results_before(
+    std::vector<std::queue<interval_snapshot_t *>> &intervals,
+    std::vector<interval_snapshot_t *> &last_snapshot_per_shard,
+    uint64_t &earliest_ever_interval_end_timestamp, uint64_t end_timestamp_limit,
+    int tool_idx, const std::function<bool(interval_snapshot_t *)> &emit)
+{
+    // earliest_ever_interval_end_timestamp is used to recompute the interval_id for
+    // the result whole trace intervals, which are numbered by the earliest shard's
+    // timestamp.
     size_t shard_count = intervals.size();
-    bool any_shard_has_results_left = true;
-    std::vector<typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t *>
-        last_snapshot_per_shard(shard_count, nullptr);
-    while (any_shard_has_results_left) {
+    assert(last_snapshot_per_shard.size() == shard_count);
+    while (true) {
         // Look for the next whole trace interval across all shards, which will be the
         // one with the earliest interval-end timestamp.
         uint64_t earliest_interval_end_timestamp = std::numeric_limits<uint64_t>::max();
@@ -653,11 +748,11 @@ analyzer_tmpl_t<RecordType, ReaderType>::merge_shard_interval_results(
                 std::min(earliest_interval_end_timestamp,
                          intervals[shard_idx].front()->interval_end_timestamp);
         }
-        // We're done if no shard has any interval left unprocessed.
-        if (earliest_interval_end_timestamp == std::numeric_limits<uint64_t>::max()) {
-            any_shard_has_results_left = false;
-            continue;
-        }
+        // We're done if no shard has any interval left unprocessed, or if some
+        // shard may still produce a snapshot for the next interval.
+        if (earliest_interval_end_timestamp == std::numeric_limits<uint64_t>::max() ||
+            earliest_interval_end_timestamp >= end_timestamp_limit)
+            break;
         assert(earliest_interval_end_timestamp % interval_microseconds_ == 0);
         if (earliest_ever_interval_end_timestamp ==
             std::numeric_limits<uint64_t>::max()) {
@@ -687,32 +782,129 @@ analyzer_tmpl_t<RecordType, ReaderType>::merge_shard_interval_results(
         }
         // Merge last_snapshot_per_shard to form the result of the current
         // whole-trace interval.
-        std::vector<
-            const typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t *>
-            const_last_snapshot_per_shard;
-        const_last_snapshot_per_shard.insert(const_last_snapshot_per_shard.end(),
-                                             last_snapshot_per_shard.begin(),
-                                             last_snapshot_per_shard.end());
-        typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t
-            *cur_merged_interval;
+        std::vector<const interval_snapshot_t *> const_last_snapshot_per_shard(
+            last_snapshot_per_shard.begin(), last_snapshot_per_shard.end());
+        interval_snapshot_t *cur_merged_interval;
         if (!combine_interval_snapshots(const_last_snapshot_per_shard,
                                         earliest_interval_end_timestamp, tool_idx,
                                         cur_merged_interval))
             return false;
         // Add the merged interval to the result list of whole trace intervals.
-        cur_merged_interval->shard_id = analysis_tool_tmpl_t<
-            RecordType>::interval_state_snapshot_t::WHOLE_TRACE_SHARD_ID;
+        cur_merged_interval->shard_id = interval_snapshot_t::WHOLE_TRACE_SHARD_ID;
         cur_merged_interval->interval_end_timestamp = earliest_interval_end_timestamp;
         cur_merged_interval->interval_id = compute_interval_id(
             earliest_ever_interval_end_timestamp, earliest_interval_end_timestamp);
-        merged_intervals.push_back(cur_merged_interval);
+        if (!emit(cur_merged_interval))
+            return false;
     }
-    for (auto snapshot : last_snapshot_per_shard) {
-        if (snapshot != nullptr &&
-            !tools_[tool_idx]->release_interval_snapshot(snapshot)) {
-            error_string_ = tools_[tool_idx]->get_error_string();
+    return true;
+}
+
+template <typename RecordType, typename ReaderType>
+void
+analyzer_tmpl_t<RecordType, ReaderType>::set_interval_sink(interval_sink_t sink)
+{
+    interval_sink_ = std::move(sink);
+}
+
+template <typename RecordType, typename ReaderType>
+bool
+analyzer_tmpl_t<RecordType, ReaderType>::stream_interval_snapshot(
+    int tool_idx, interval_snapshot_t *snapshot)
+{
+    interval_stream_tool_t &tool = interval_stream_tools_[tool_idx];
+    bool sunk = interval_sink_(tool_idx, snapshot, tool.last_streamed);
+    if (tool.last_streamed != nullptr &&
+        !tools_[tool_idx]->release_interval_snapshot(tool.last_streamed)) {
+        error_string_ = tools_[tool_idx]->get_error_string();
+        return false;
+    }
+    // We hold on to the latest snapshot so the sink can compute deltas.
+    tool.last_streamed = snapshot;
+    if (!sunk) {
+        error_string_ = tools_[tool_idx]->get_error_string();
+        if (error_string_.empty())
+            error_string_ = "Interval sink failed";
+        return false;
+    }
+    return true;
+}
+
+template <typename RecordType, typename ReaderType>
+bool
+analyzer_tmpl_t<RecordType, ReaderType>::stream_shard_interval_snapshots(
+    int shard_idx, const std::vector<interval_snapshot_t *> &snapshots,
+    uint64_t next_end_timestamp, std::string &error)
+{
+    std::lock_guard<std::mutex> guard(interval_stream_mutex_);
+    size_t slot;
+    auto it = interval_stream_shard_slot_.find(shard_idx);
+    if (it == interval_stream_shard_slot_.end()) {
+        slot = interval_stream_shard_progress_.size();
+        interval_stream_shard_slot_[shard_idx] = slot;
+        interval_stream_shard_progress_.push_back(0);
+        for (auto &tool : interval_stream_tools_) {
+            tool.pending.emplace_back();
+            tool.last_snapshot_per_shard.push_back(nullptr);
+        }
+    } else
+        slot = it->second;
+    for (size_t tool_idx = 0; tool_idx < snapshots.size(); ++tool_idx) {
+        if (snapshots[tool_idx] != nullptr)
+            interval_stream_tools_[tool_idx].pending[slot].push(snapshots[tool_idx]);
+    }
+    assert(next_end_timestamp >= interval_stream_shard_progress_[slot]);
+    interval_stream_shard_progress_[slot] = next_end_timestamp;
+    if (interval_stream_shard_progress_.size() < interval_stream_shard_count_)
+        return true;
+    if (!stream_ready_intervals(*std::min_element(
+            interval_stream_shard_progress_.begin(),
+            interval_stream_shard_progress_.end()))) {
+        error = error_string_;
+        return false;
+    }
+    return true;
+}
+
+template <typename RecordType, typename ReaderType>
+bool
+analyzer_tmpl_t<RecordType, ReaderType>::stream_ready_intervals(
+    uint64_t end_timestamp_limit)
+{
+    for (int tool_idx = 0; tool_idx < num_tools_; ++tool_idx) {
+        interval_stream_tool_t &tool = interval_stream_tools_[tool_idx];
+        if (!merge_shard_interval_results_before(
+                tool.pending, tool.last_snapshot_per_shard,
+                tool.earliest_ever_interval_end_timestamp, end_timestamp_limit,
+                tool_idx, [this, tool_idx](interval_snapshot_t *merged) {
+                    return stream_interval_snapshot(tool_idx, merged);
+                }))
             return false;
+    }
+    return true;
+}
+
+template <typename RecordType, typename ReaderType>
+bool
+analyzer_tmpl_t<RecordType, ReaderType>::finish_interval_stream()
+{
+    std::lock_guard<std::mutex> guard(interval_stream_mutex_);
+    // Shards that never started or never ended an interval can no longer hold
+    // anything back.
+    if (!stream_ready_intervals(std::numeric_limits<uint64_t>::max()))
+        return false;
+    for (int tool_idx = 0; tool_idx < num_tools_; ++tool_idx) {
+        interval_stream_tool_t &tool = interval_stream_tools_[tool_idx];
+        tool.last_snapshot_per_shard.push_back(tool.last_streamed);
+        tool.last_streamed = nullptr;
+        for (auto snapshot : tool.last_snapshot_per_shard) {
+            if (snapshot != nullptr &&
+                !tools_[tool_idx]->release_interval_snapshot(snapshot)) {
+                error_string_ = tools_[tool_idx]->get_error_string();
+                return false;
+            }
         }
+        tool.last_snapshot_per_shard.clear();
     }
     return true;
 }
@@ -754,6 +946,19 @@ bool
 analyzer_tmpl_t<RecordType, ReaderType>::run()
 {
     // XXX i#3286: Add a %-completed progress message by looking at the file sizes.
+    batch_size_ = max_batch_size_;
+    for (int i = 0; i < num_tools_; ++i) {
+        if (!tools_[i]->memref_batch_supported())
+            batch_size_ = 1;
+    }
+    if (interval_microseconds_ != 0 && interval_sink_) {
+        interval_stream_tools_.resize(num_tools_);
+        if (parallel_ && interval_stream_shard_count_ == 0) {
+            interval_stream_shard_count_ = shard_type_ == SHARD_BY_CORE
+                ? worker_count_
+                : scheduler_.get_input_stream_count();
+        }
+    }
     if (!parallel_) {
         process_serial(worker_data_[0]);
         if (!worker_data_[0].error.empty()) {
@@ -790,6 +995,8 @@ analyzer_tmpl_t<RecordType, ReaderType>::run()
         }
     }
     if (interval_microseconds_ != 0) {
+        if (interval_sink_)
+            return finish_interval_stream();
         return collect_and_maybe_merge_shard_interval_results();
     }
     return true;
@@ -837,6 +1044,9 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_interval(
     analyzer_worker_data_t *worker, bool parallel, int shard_idx)
 {
     assert(parallel || shard_idx == 0); // Default to zero for the serial mode.
+    std::vector<interval_snapshot_t *> streamed;
+    if (interval_sink_ && parallel)
+        streamed.resize(num_tools_, nullptr);
     for (int tool_idx = 0; tool_idx < num_tools_; ++tool_idx) {
         typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t *snapshot;
         if (parallel) {
@@ -867,10 +1077,28 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_interval(
             snapshot->instr_count_cumulative = worker->stream->get_instruction_ordinal();
             snapshot->instr_count_delta =
                 snapshot->instr_count_cumulative - interval_init_instr_count;
-            worker->shard_data[shard_idx].tool_data[tool_idx].interval_snapshot_data.push(
-                snapshot);
+            if (!interval_sink_) {
+                worker->shard_data[shard_idx]
+                    .tool_data[tool_idx]
+                    .interval_snapshot_data.push(snapshot);
+            } else if (parallel) {
+                streamed[tool_idx] = snapshot;
+            } else if (!stream_interval_snapshot(tool_idx, snapshot)) {
+                // Serial snapshots are already whole-trace ones.
+                worker->error = error_string_;
+                return false;
+            }
         }
     }
+    if (interval_sink_ && parallel) {
+        // The shard's next snapshot ends no earlier than its current interval.
+        return stream_shard_interval_snapshots(
+            shard_idx, streamed,
+            compute_interval_end_timestamp(
+                worker->stream->get_first_timestamp(),
+                worker->shard_data[shard_idx].cur_interval_index),
+            worker->error);
+    }
     return true;
 }
 
@@ -45,8 +45,11 @@
 
 #include <stdint.h>
 
+#include <functional>
 #include <iterator>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <string>
 #include <unordered_map>
@@ -127,6 +130,30 @@ public:
     virtual bool
     print_stats();
 
+    /** The interval state snapshot type of the tools being run. */
+    typedef typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t
+        interval_snapshot_t;
+    /**
+     * Receives a whole-trace interval snapshot for the tool at index \p tool_idx.
+     * \p prev_snapshot is the snapshot passed just before for the same tool, or
+     * nullptr for its first interval.  Neither may be used after the call returns.
+     * Returning false aborts the analysis.
+     */
+    typedef std::function<bool(int tool_idx, const interval_snapshot_t *snapshot,
+                               const interval_snapshot_t *prev_snapshot)>
+        interval_sink_t;
+    /**
+     * Requests that whole-trace interval results be streamed to \p sink instead of
+     * being kept until the end for print_stats().  Each whole-trace interval is
+     * merged and passed to \p sink as soon as every shard has moved past its end,
+     * and its snapshots are released right afterward, bounding the memory used for
+     * intervals of long-running or online traces.  In parallel mode the merging and
+     * \p sink run on the worker threads, serialized by a lock.  Must be called
+     * before run(); has no effect unless interval_microseconds is set.
+     */
+    void
+    set_interval_sink(interval_sink_t sink);
+
 protected:
     typedef scheduler_tmpl_t<RecordType, ReaderType> sched_type_t;
 
@@ -238,6 +265,22 @@ protected:
     bool
     process_shard_exit(analyzer_worker_data_t *worker, int shard_index);
 
+    // Reads the next record, or the next batch of records if batch_size_ > 1, from
+    // the worker's stream into "records", setting "count" to the number read.
+    typename sched_type_t::stream_status_t
+    next_records(analyzer_worker_data_t *worker, std::vector<RecordType> &records,
+                 size_t &count, uint64_t cur_micros);
+
+    // Helpers for process_serial() and process_tasks() which pass "count" records
+    // to each tool's memref routine.  Return false if there was an error and the
+    // caller should return early.
+    bool
+    process_records_serial(analyzer_worker_data_t *worker, const RecordType *records,
+                           size_t count);
+    bool
+    process_records_parallel(analyzer_worker_data_t *worker, int shard_index,
+                             const RecordType *records, size_t count);
+
     bool
     record_has_tid(RecordType record, memref_tid_t &tid);
 
@@ -296,6 +339,42 @@ protected:
                         *> &merged_intervals,
         int tool_idx);
 
+    // Merges, in order, the whole-trace intervals that end before end_timestamp_limit
+    // from the shard-local snapshots queued in intervals, passing each resulting
+    // snapshot to emit.  last_snapshot_per_shard (one entry per queue) and
+    // earliest_ever_interval_end_timestamp carry the merge state across calls; the
+    // caller releases the snapshots left in last_snapshot_per_shard when done.
+    bool
+    merge_shard_interval_results_before(
+        std::vector<std::queue<interval_snapshot_t *>> &intervals,
+        std::vector<interval_snapshot_t *> &last_snapshot_per_shard,
+        uint64_t &earliest_ever_interval_end_timestamp, uint64_t end_timestamp_limit,
+        int tool_idx, const std::function<bool(interval_snapshot_t *)> &emit);
+
+    // Passes snapshot to interval_sink_ and releases the snapshot streamed before it
+    // for the same tool.
+    bool
+    stream_interval_snapshot(int tool_idx, interval_snapshot_t *snapshot);
+
+    // Queues the snapshots (one per tool, possibly null) generated by the shard at
+    // shard_idx for streaming and publishes every whole-trace interval that all
+    // shards have now moved past.  The shard will produce no later snapshot ending
+    // before next_end_timestamp.  Called by worker threads, so on failure this sets
+    // error rather than error_string_.
+    bool
+    stream_shard_interval_snapshots(int shard_idx,
+                                    const std::vector<interval_snapshot_t *> &snapshots,
+                                    uint64_t next_end_timestamp, std::string &error);
+
+    // Publishes the whole-trace intervals all shards have moved past.  The caller
+    // must hold interval_stream_mutex_.
+    bool
+    stream_ready_intervals(uint64_t end_timestamp_limit);
+
+    // Publishes all remaining intervals and releases the streaming state.
+    bool
+    finish_interval_stream();
+
     // Combines all interval snapshots in the given vector to create the interval
     // snapshot for the whole-trace interval ending at interval_end_timestamp and
     // stores it in 'result'. These snapshots are for the tool at tool_idx. Returns
@@ -330,6 +409,25 @@ protected:
     std::vector<std::vector<
         typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t *>>
         merged_interval_snapshots_;
+    // Streaming state for set_interval_sink(), guarded by interval_stream_mutex_.
+    struct interval_stream_tool_t {
+        // Indexed by the shard's slot in interval_stream_shard_slot_.
+        std::vector<std::queue<interval_snapshot_t *>> pending;
+        std::vector<interval_snapshot_t *> last_snapshot_per_shard;
+        uint64_t earliest_ever_interval_end_timestamp =
+            std::numeric_limits<uint64_t>::max();
+        interval_snapshot_t *last_streamed = nullptr;
+    };
+    interval_sink_t interval_sink_;
+    std::mutex interval_stream_mutex_;
+    std::vector<interval_stream_tool_t> interval_stream_tools_;
+    std::unordered_map<int, size_t> interval_stream_shard_slot_;
+    // For each slot, no later snapshot from that shard ends before this timestamp.
+    std::vector<uint64_t> interval_stream_shard_progress_;
+    // Intervals are held back until this many shards have reported progress, as a
+    // shard that has not yet started may still produce early intervals.  Computed
+    // in run() from the shard type when left at 0.
+    size_t interval_stream_shard_count_ = 0;
     bool parallel_;
     int worker_count_;
     const char *output_prefix_ = "[analyzer]";
@@ -338,6 +436,10 @@ protected:
     int verbosity_ = 0;
     shard_type_t shard_type_ = SHARD_BY_THREAD;
     bool sched_by_time_ = false;
+    // The number of records read and delivered at once: max_batch_size_ if every
+    // tool returns true from memref_batch_supported() and 1 otherwise.
+    static const int max_batch_size_ = 256;
+    size_t batch_size_ = 1;
 
 private:
     bool
@@ -57,7 +57,9 @@
 #include "tools/histogram_create.h"
 #include "tools/invariant_checker.h"
 #include "tools/invariant_checker_create.h"
+#include "tools/miss_ratio_curve_create.h"
 #include "tools/opcode_mix_create.h"
+#include "tools/simpoint_create.h"
 #include "tools/syscall_mix_create.h"
 #include "tools/reuse_distance_create.h"
 #include "tools/reuse_time_create.h"
@@ -172,6 +174,8 @@ analyzer_multi_t::analyzer_multi_t()
                 op_alt_module_dir.get_value(), op_chunk_instr_count.get_value(),
                 dir.in_kfiles_map_, dir.kcoredir_, dir.kallsymsdir_);
             std::string error = raw2trace.do_conversion();
+            if (error.empty())
+                error = dir.finish_output_files();
             if (!error.empty()) {
                 success_ = false;
                 error_string_ = "raw2trace failed: " + error;
@@ -227,6 +231,25 @@ analyzer_multi_t::analyzer_multi_t()
         success_ = false;
         return;
     }
+    if (interval_microseconds_ != 0 && !op_interval_stream_file.get_value().empty()) {
+        interval_stream_file_.reset(
+            new std::ofstream(op_interval_stream_file.get_value()));
+        if (!*interval_stream_file_) {
+            error_string_ = "Failed to open -interval_stream_file " +
+                op_interval_stream_file.get_value();
+            success_ = false;
+            return;
+        }
+        set_interval_sink([this](int tool_idx, const interval_snapshot_t *snapshot,
+                                 const interval_snapshot_t *prev_snapshot) {
+            if (!tools_[tool_idx]->print_interval_result(snapshot, prev_snapshot,
+                                                         *interval_stream_file_))
+                return false;
+            // Flush so that anyone following the file sees each interval right away.
+            interval_stream_file_->flush();
+            return interval_stream_file_->good();
+        });
+    }
     // We can't call serial_trace_iter_->init() here as it blocks for ipc_reader_t.
 }
 
@@ -256,6 +279,11 @@ analyzer_multi_t::init_dynamic_schedule()
     sched_ops.quantum_duration = op_sched_quantum.get_value();
     if (op_sched_time.get_value())
         sched_ops.quantum_unit = scheduler_t::QUANTUM_TIME;
+    if (op_sched_local_queues.get_value()) {
+        sched_ops.flags = static_cast<scheduler_t::scheduler_flags_t>(
+            static_cast<int>(sched_ops.flags) |
+            static_cast<int>(scheduler_t::SCHEDULER_LOCAL_READY_QUEUES));
+    }
 #ifdef HAS_ZIP
     if (!op_record_file.get_value().empty()) {
         record_schedule_zip_.reset(new zipfile_ostream_t(op_record_file.get_value()));
@@ -367,6 +395,17 @@ analyzer_multi_t::create_analysis_tool_from_options(const std::string &simulator
         knobs.TLB_L2_entries = op_TLB_L2_entries.get_value();
         knobs.TLB_L2_assoc = op_TLB_L2_assoc.get_value();
         knobs.TLB_replace_policy = op_TLB_replace_policy.get_value();
+        knobs.TLB_page_size_map = op_TLB_page_size_map.get_value();
+        knobs.TLB_pwc_entries = op_TLB_pwc_entries.get_value();
+        knobs.TLB_walk_latencies = op_TLB_walk_latencies.get_value();
+        knobs.TLB_walk_caches = op_TLB_walk_caches.get_value();
+        if (knobs.TLB_walk_caches) {
+            cache_simulator_knobs_t *cache_knobs = get_cache_simulator_knobs();
+            knobs.walk_cache_knobs = *cache_knobs;
+            // Walks are charged -TLB_walk_latencies instead.
+            knobs.walk_cache_knobs.timing = false;
+            delete cache_knobs;
+        }
         knobs.skip_refs = op_skip_refs.get_value();
         knobs.warmup_refs = op_warmup_refs.get_value();
         knobs.warmup_fraction = op_warmup_fraction.get_value();
@@ -392,8 +431,47 @@ analyzer_multi_t::create_analysis_tool_from_options(const std::string &simulator
             ERRMSG("Usage error: reuse_histogram_bin_multiplier must be >= 1.0\n");
             return nullptr;
         }
+        knobs.engine = op_reuse_engine.get_value();
+        if (knobs.engine != "list" && knobs.engine != "tree") {
+            ERRMSG("Usage error: reuse_engine must be \"list\" or \"tree\"\n");
+            return nullptr;
+        }
+        knobs.sample_rate = op_reuse_sample_rate.get_value();
+        if (knobs.sample_rate <= 0.0 || knobs.sample_rate > 1.0) {
+            ERRMSG("Usage error: reuse_sample_rate must be > 0 and <= 1\n");
+            return nullptr;
+        }
         knobs.verbose = op_verbose.get_value();
         return reuse_distance_tool_create(knobs);
+    } else if (simulator_type == MISS_RATIO_CURVE) {
+        miss_ratio_curve_knobs_t knobs;
+        knobs.line_size = op_line_size.get_value();
+        knobs.sample_rate = op_mrc_sample_rate.get_value();
+        if (knobs.sample_rate <= 0.0 || knobs.sample_rate > 1.0) {
+            ERRMSG("Usage error: mrc_sample_rate must be > 0 and <= 1\n");
+            return nullptr;
+        }
+        knobs.sample_lines = op_mrc_sample_lines.get_value();
+        knobs.sample_sets = op_mrc_sample_sets.get_value();
+        knobs.output_format = op_mrc_format.get_value();
+        if (knobs.output_format != "csv" && knobs.output_format != "json") {
+            ERRMSG("Usage error: mrc_format must be csv or json\n");
+            return nullptr;
+        }
+        knobs.output_file = op_mrc_outfile.get_value();
+        knobs.verbose = op_verbose.get_value();
+        return miss_ratio_curve_tool_create(knobs);
+    } else if (simulator_type == SIMPOINT) {
+        simpoint_knobs_t knobs;
+        knobs.interval_instrs = op_simpoint_interval_instrs.get_value();
+        if (knobs.interval_instrs == 0) {
+            ERRMSG("Usage error: simpoint_interval_instrs must be > 0\n");
+            return nullptr;
+        }
+        knobs.max_clusters = op_simpoint_max_k.get_value();
+        knobs.output_file = op_simpoint_outfile.get_value();
+        knobs.verbose = op_verbose.get_value();
+        return simpoint_tool_create(knobs);
     } else if (simulator_type == REUSE_TIME) {
         return reuse_time_tool_create(op_line_size.get_value(), op_verbose.get_value());
     } else if (simulator_type == BASIC_COUNTS) {
@@ -565,6 +643,18 @@ analyzer_multi_t::get_cache_simulator_knobs()
     knobs->verbose = op_verbose.get_value();
     knobs->cpu_scheduling = op_cpu_scheduling.get_value();
     knobs->use_physical = op_use_physical.get_value();
+    knobs->parallel_cores = op_parallel_cores.get_value();
+    knobs->timing = op_timing.get_value();
+    knobs->L1_latency = op_L1_latency.get_value();
+    knobs->LL_latency = op_LL_latency.get_value();
+    knobs->L1_mshrs = op_L1_mshrs.get_value();
+    knobs->LL_mshrs = op_LL_mshrs.get_value();
+    knobs->rob_size = op_rob_size.get_value();
+    knobs->dram_banks = op_dram_banks.get_value();
+    knobs->dram_bytes_per_cycle = op_dram_bytes_per_cycle.get_value();
+    knobs->dram_row_hit_latency = op_dram_row_hit_latency.get_value();
+    knobs->dram_row_miss_latency = op_dram_row_miss_latency.get_value();
+    knobs->timing_interval = op_timing_interval.get_value();
     return knobs;
 }
 
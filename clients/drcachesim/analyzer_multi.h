@@ -37,6 +37,9 @@
 #ifndef _ANALYZER_MULTI_H_
 #define _ANALYZER_MULTI_H_ 1
 
+#include <fstream>
+#include <memory>
+
 #include "analyzer.h"
 #include "archive_ostream.h"
 #include "scheduler.h"
@@ -92,6 +95,7 @@ protected:
     std::unique_ptr<archive_istream_t> cpu_schedule_zip_;
     std::unique_ptr<archive_ostream_t> record_schedule_zip_;
     std::unique_ptr<archive_istream_t> replay_schedule_zip_;
+    std::unique_ptr<std::ofstream> interval_stream_file_;
 
     static const int max_num_tools_ = 8;
 };
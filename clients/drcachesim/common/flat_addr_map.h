@@ -0,0 +1,707 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* flat_addr_map: compact hash containers keyed by addresses. */
+
+#ifndef _FLAT_ADDR_MAP_H_
+#define _FLAT_ADDR_MAP_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(X86_64)
+#    include <emmintrin.h>
+#elif defined(ARM_64)
+#    include <arm_neon.h>
+#endif
+#ifdef _MSC_VER
+#    include <intrin.h>
+#endif
+
+#include "memref.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// A hash map from addresses (or other 64-bit integer keys) to small trivially
+// copyable values, for the per-shard tables of analysis tools, which can hold
+// many millions of entries.  Compared to std::unordered_map it has no per-entry
+// allocation or pointers: keys, values, and a control byte per slot live in
+// separate arrays of a single allocation.  The control byte holds 7 bits of the
+// key's hash for a full slot, so a lookup compares a whole group of 16 slots'
+// control bytes at once (with SSE2 on x86_64 and NEON on AArch64, the vector
+// extensions in those targets' baselines) and touches a key only when its hash
+// bits match.  Groups are probed with triangular steps, and a lookup stops at
+// the first group with an empty slot.
+//
+// Unlike std::unordered_map, any insertion may move existing entries, which
+// invalidates pointers returned by find() and insert() as well as iterators.
+// Iteration order is unspecified.
+template <typename Value> class flat_addr_map_t {
+    static_assert(std::is_trivially_copyable<Value>::value,
+                  "values are copied as raw bytes");
+
+public:
+    typedef addr_t key_type;
+    typedef Value mapped_type;
+    typedef std::pair<addr_t, Value> value_type;
+
+    flat_addr_map_t()
+    {
+    }
+    flat_addr_map_t(const flat_addr_map_t &other)
+    {
+        *this = other;
+    }
+    flat_addr_map_t(flat_addr_map_t &&other) noexcept
+    {
+        *this = std::move(other);
+    }
+    flat_addr_map_t &
+    operator=(const flat_addr_map_t &other)
+    {
+        if (this == &other)
+            return *this;
+        if (other.capacity_ != capacity_)
+            allocate(other.capacity_);
+        if (capacity_ > 0)
+            memcpy(arena_.get(), other.arena_.get(), arena_size(capacity_));
+        size_ = other.size_;
+        growth_left_ = other.growth_left_;
+        return *this;
+    }
+    flat_addr_map_t &
+    operator=(flat_addr_map_t &&other) noexcept
+    {
+        arena_ = std::move(other.arena_);
+        keys_ = other.keys_;
+        values_ = other.values_;
+        ctrl_ = other.ctrl_;
+        capacity_ = other.capacity_;
+        size_ = other.size_;
+        growth_left_ = other.growth_left_;
+        other.keys_ = nullptr;
+        other.values_ = nullptr;
+        other.ctrl_ = nullptr;
+        other.capacity_ = 0;
+        other.size_ = 0;
+        other.growth_left_ = 0;
+        return *this;
+    }
+
+    size_t
+    size() const
+    {
+        return size_;
+    }
+    bool
+    empty() const
+    {
+        return size_ == 0;
+    }
+    // Returns the bytes allocated for the table.
+    size_t
+    memory_usage() const
+    {
+        return capacity_ == 0 ? 0 : arena_size(capacity_);
+    }
+
+    // Removes all entries, keeping the allocated space.
+    void
+    clear()
+    {
+        if (capacity_ == 0)
+            return;
+        memset(ctrl_, CTRL_EMPTY, capacity_);
+        size_ = 0;
+        growth_left_ = max_load(capacity_);
+    }
+
+    // Makes room for "count" entries in total without further allocation.
+    void
+    reserve(size_t count)
+    {
+        if (count <= size_)
+            return;
+        size_t capacity = capacity_ == 0 ? GROUP_SIZE : capacity_;
+        while (max_load(capacity) < count)
+            capacity *= 2;
+        // Rehashing at the same capacity reclaims deleted slots.
+        if (capacity > capacity_ || growth_left_ < count - size_)
+            rehash(capacity);
+    }
+
+    // Returns the value for "key", or nullptr if it is absent.
+    Value *
+    find(addr_t key)
+    {
+        size_t slot = find_slot(key, hash(key));
+        return slot == NO_SLOT ? nullptr : &values_[value_index(slot)];
+    }
+    const Value *
+    find(addr_t key) const
+    {
+        size_t slot = find_slot(key, hash(key));
+        return slot == NO_SLOT ? nullptr : &values_[value_index(slot)];
+    }
+    size_t
+    count(addr_t key) const
+    {
+        return find_slot(key, hash(key)) == NO_SLOT ? 0 : 1;
+    }
+
+    // Returns the value for "key", which is value-initialized if it was absent,
+    // along with whether it was absent.
+    std::pair<Value *, bool>
+    insert(addr_t key)
+    {
+        uint64_t key_hash = hash(key);
+        size_t slot = find_slot(key, key_hash);
+        if (slot != NO_SLOT)
+            return std::make_pair(&values_[value_index(slot)], false);
+        slot = add(key, key_hash);
+        Value *value = &values_[value_index(slot)];
+        new (value) Value();
+        return std::make_pair(value, true);
+    }
+    Value &
+    operator[](addr_t key)
+    {
+        return *insert(key).first;
+    }
+
+    // Returns whether "key" was present.
+    bool
+    erase(addr_t key)
+    {
+        size_t slot = find_slot(key, hash(key));
+        if (slot == NO_SLOT)
+            return false;
+        // If this slot's group has an empty slot then no lookup has ever needed
+        // to continue past it, so this slot can become empty as well.  Otherwise
+        // we leave a marker that lookups continue past.
+        if (match_empty(&ctrl_[slot & ~(GROUP_SIZE - 1)]) != 0) {
+            ctrl_[slot] = CTRL_EMPTY;
+            ++growth_left_;
+        } else
+            ctrl_[slot] = CTRL_DELETED;
+        --size_;
+        return true;
+    }
+
+    // Combines "other" into this map: absent keys are copied, and for keys in both
+    // combine(Value &ours, const Value &theirs) is called.  This is meant for
+    // reducing per-shard tables, so it sizes the table once up front and copies
+    // the whole table when this one is empty.
+    template <typename Combine>
+    void
+    merge(const flat_addr_map_t &other, Combine combine)
+    {
+        if (size_ == 0) {
+            *this = other;
+            return;
+        }
+        reserve(size_ + other.size_);
+        for (size_t slot = 0; slot < other.capacity_; ++slot) {
+            if (!is_full(other.ctrl_[slot]))
+                continue;
+            addr_t key = other.keys_[slot];
+            uint64_t key_hash = hash(key);
+            const Value &theirs = other.values_[value_index(slot)];
+            size_t ours = find_slot(key, key_hash);
+            if (ours != NO_SLOT)
+                combine(values_[value_index(ours)], theirs);
+            else
+                values_[value_index(add(key, key_hash))] = theirs;
+        }
+    }
+    // Merges by adding the values of keys in both maps.
+    void
+    merge_add(const flat_addr_map_t &other)
+    {
+        merge(other, [](Value &ours, const Value &theirs) { ours += theirs; });
+    }
+
+    bool
+    operator==(const flat_addr_map_t &rhs) const
+    {
+        if (size_ != rhs.size_)
+            return false;
+        for (size_t slot = 0; slot < capacity_; ++slot) {
+            if (!is_full(ctrl_[slot]))
+                continue;
+            const Value *theirs = rhs.find(keys_[slot]);
+            if (theirs == nullptr ||
+                memcmp(theirs, &values_[value_index(slot)], sizeof(Value)) != 0)
+                return false;
+        }
+        return true;
+    }
+    bool
+    operator!=(const flat_addr_map_t &rhs) const
+    {
+        return !(*this == rhs);
+    }
+
+    // Iterates over copies of the entries.
+    class const_iterator {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef typename flat_addr_map_t::value_type value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const value_type *pointer;
+        typedef value_type reference;
+
+        const_iterator(const flat_addr_map_t *map, size_t slot)
+            : map_(map)
+            , slot_(slot)
+        {
+            skip_unused();
+        }
+        value_type
+        operator*() const
+        {
+            return value_type(map_->keys_[slot_],
+                              map_->values_[map_->value_index(slot_)]);
+        }
+        const_iterator &
+        operator++()
+        {
+            ++slot_;
+            skip_unused();
+            return *this;
+        }
+        const_iterator
+        operator++(int)
+        {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+        bool
+        operator==(const const_iterator &rhs) const
+        {
+            return slot_ == rhs.slot_;
+        }
+        bool
+        operator!=(const const_iterator &rhs) const
+        {
+            return slot_ != rhs.slot_;
+        }
+
+    private:
+        void
+        skip_unused()
+        {
+            while (slot_ < map_->capacity_ && !is_full(map_->ctrl_[slot_]))
+                ++slot_;
+        }
+        const flat_addr_map_t *map_;
+        size_t slot_;
+    };
+    const_iterator
+    begin() const
+    {
+        return const_iterator(this, 0);
+    }
+    const_iterator
+    end() const
+    {
+        return const_iterator(this, capacity_);
+    }
+
+private:
+    static constexpr size_t GROUP_SIZE = 16;
+    static constexpr size_t NO_SLOT = ~static_cast<size_t>(0);
+    // A full slot's control byte is the top 7 bits of its key's hash.
+    static constexpr uint8_t CTRL_EMPTY = 0x80;
+    static constexpr uint8_t CTRL_DELETED = 0xfe;
+    // An empty value type takes no space: all slots share one value.
+    static constexpr bool VALUES_EMPTY = std::is_empty<Value>::value;
+
+    static bool
+    is_full(uint8_t ctrl)
+    {
+        return (ctrl & 0x80) == 0;
+    }
+    static size_t
+    max_load(size_t capacity)
+    {
+        // We allow a load factor of 7/8.
+        return capacity - capacity / 8;
+    }
+    static size_t
+    value_index(size_t slot)
+    {
+        return VALUES_EMPTY ? 0 : slot;
+    }
+    static uint64_t
+    hash(addr_t key)
+    {
+        // The splitmix64 finalizer: consecutive addresses and addresses differing
+        // only in their upper bits both need mixing.
+        uint64_t h = static_cast<uint64_t>(key);
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        return h ^ (h >> 31);
+    }
+    static uint8_t
+    hash_tag(uint64_t key_hash)
+    {
+        return static_cast<uint8_t>(key_hash >> 57);
+    }
+
+    // The group matching routines return a mask with bit (i * MASK_STRIDE) set
+    // for each matching slot i of the group.
+#if defined(ARM_64)
+    static constexpr int MASK_STRIDE = 4;
+    static uint64_t
+    to_mask(uint8x16_t eq)
+    {
+        // Narrowing each byte to a nibble is the cheapest NEON equivalent of an
+        // x86 byte movemask.
+        uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+        return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) & 0x8888888888888888ULL;
+    }
+#else
+    static constexpr int MASK_STRIDE = 1;
+#endif
+
+    static uint64_t
+    match_tag(const uint8_t *group, uint8_t tag)
+    {
+#if defined(X86_64)
+        __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+        return static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(tag))));
+#elif defined(ARM_64)
+        return to_mask(vceqq_u8(vld1q_u8(group), vdupq_n_u8(tag)));
+#else
+        uint64_t mask = 0;
+        for (size_t i = 0; i < GROUP_SIZE; ++i) {
+            if (group[i] == tag)
+                mask |= 1ULL << i;
+        }
+        return mask;
+#endif
+    }
+    static uint64_t
+    match_empty(const uint8_t *group)
+    {
+        return match_tag(group, CTRL_EMPTY);
+    }
+    static uint64_t
+    match_empty_or_deleted(const uint8_t *group)
+    {
+#if defined(X86_64)
+        // Only those have their top bit set.
+        __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(ctrl));
+#elif defined(ARM_64)
+        return to_mask(vcltzq_s8(vreinterpretq_s8_u8(vld1q_u8(group))));
+#else
+        uint64_t mask = 0;
+        for (size_t i = 0; i < GROUP_SIZE; ++i) {
+            if (!is_full(group[i]))
+                mask |= 1ULL << i;
+        }
+        return mask;
+#endif
+    }
+    // Returns the slot within its group of the lowest set bit of "mask".
+    static size_t
+    lowest_match(uint64_t mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, mask);
+        return index / MASK_STRIDE;
+#else
+        return __builtin_ctzll(mask) / MASK_STRIDE;
+#endif
+    }
+
+    size_t
+    find_slot(addr_t key, uint64_t key_hash) const
+    {
+        if (capacity_ == 0)
+            return NO_SLOT;
+        const size_t group_mask = capacity_ / GROUP_SIZE - 1;
+        const uint8_t tag = hash_tag(key_hash);
+        size_t group = static_cast<size_t>(key_hash) & group_mask;
+        for (size_t step = 1;; ++step) {
+            const size_t base = group * GROUP_SIZE;
+            for (uint64_t mask = match_tag(&ctrl_[base], tag); mask != 0;
+                 mask &= mask - 1) {
+                size_t slot = base + lowest_match(mask);
+                if (keys_[slot] == key)
+                    return slot;
+            }
+            if (match_empty(&ctrl_[base]) != 0 || step > group_mask)
+                return NO_SLOT;
+            // Triangular steps visit every group of a power-of-two table.
+            group = (group + step) & group_mask;
+        }
+    }
+
+    // Places "key", which must be absent, returning its slot.
+    size_t
+    add(addr_t key, uint64_t key_hash)
+    {
+        if (capacity_ == 0)
+            rehash(GROUP_SIZE);
+        else if (growth_left_ == 0) {
+            // Reclaim deleted slots if they are a large enough fraction, else grow.
+            rehash(size_ < max_load(capacity_) / 2 ? capacity_ : 2 * capacity_);
+        }
+        const size_t group_mask = capacity_ / GROUP_SIZE - 1;
+        size_t group = static_cast<size_t>(key_hash) & group_mask;
+        for (size_t step = 1;; ++step) {
+            const size_t base = group * GROUP_SIZE;
+            uint64_t mask = match_empty_or_deleted(&ctrl_[base]);
+            if (mask != 0) {
+                size_t slot = base + lowest_match(mask);
+                if (ctrl_[slot] == CTRL_EMPTY)
+                    --growth_left_;
+                ctrl_[slot] = hash_tag(key_hash);
+                keys_[slot] = key;
+                ++size_;
+                return slot;
+            }
+            group = (group + step) & group_mask;
+        }
+    }
+
+    static size_t
+    values_size(size_t capacity)
+    {
+        return sizeof(Value) * (VALUES_EMPTY ? 1 : capacity);
+    }
+    static size_t
+    values_offset(size_t capacity)
+    {
+        return capacity * sizeof(addr_t);
+    }
+    static size_t
+    ctrl_offset(size_t capacity)
+    {
+        // Keep each group of control bytes within one cache line.
+        size_t offset = values_offset(capacity) + values_size(capacity);
+        return (offset + GROUP_SIZE - 1) & ~(GROUP_SIZE - 1);
+    }
+    static size_t
+    arena_size(size_t capacity)
+    {
+        return ctrl_offset(capacity) + capacity;
+    }
+
+    // Replaces the storage with an empty table of "capacity" slots.
+    void
+    allocate(size_t capacity)
+    {
+        capacity_ = capacity;
+        size_ = 0;
+        growth_left_ = max_load(capacity);
+        if (capacity == 0) {
+            arena_.reset();
+            keys_ = nullptr;
+            values_ = nullptr;
+            ctrl_ = nullptr;
+            return;
+        }
+        arena_.reset(new uint64_t[(arena_size(capacity) + 7) / 8]);
+        char *base = reinterpret_cast<char *>(arena_.get());
+        keys_ = reinterpret_cast<addr_t *>(base);
+        values_ = reinterpret_cast<Value *>(base + values_offset(capacity));
+        ctrl_ = reinterpret_cast<uint8_t *>(base + ctrl_offset(capacity));
+        memset(ctrl_, CTRL_EMPTY, capacity);
+    }
+
+    void
+    rehash(size_t capacity)
+    {
+        std::unique_ptr<uint64_t[]> old_arena = std::move(arena_);
+        const addr_t *old_keys = keys_;
+        const Value *old_values = values_;
+        const uint8_t *old_ctrl = ctrl_;
+        size_t old_capacity = capacity_;
+        allocate(capacity);
+        for (size_t slot = 0; slot < old_capacity; ++slot) {
+            if (!is_full(old_ctrl[slot]))
+                continue;
+            addr_t key = old_keys[slot];
+            values_[value_index(add(key, hash(key)))] = old_values[value_index(slot)];
+        }
+    }
+
+    std::unique_ptr<uint64_t[]> arena_;
+    addr_t *keys_ = nullptr;
+    Value *values_ = nullptr;
+    uint8_t *ctrl_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    // How many more entries can be added before rehashing.
+    size_t growth_left_ = 0;
+};
+
+// A set of addresses with the same representation as flat_addr_map_t.
+class flat_addr_set_t {
+public:
+    typedef addr_t key_type;
+    typedef addr_t value_type;
+
+    size_t
+    size() const
+    {
+        return map_.size();
+    }
+    bool
+    empty() const
+    {
+        return map_.empty();
+    }
+    size_t
+    memory_usage() const
+    {
+        return map_.memory_usage();
+    }
+    void
+    clear()
+    {
+        map_.clear();
+    }
+    void
+    reserve(size_t count)
+    {
+        map_.reserve(count);
+    }
+    size_t
+    count(addr_t key) const
+    {
+        return map_.count(key);
+    }
+    // Returns whether "key" was absent.
+    bool
+    insert(addr_t key)
+    {
+        return map_.insert(key).second;
+    }
+    bool
+    erase(addr_t key)
+    {
+        return map_.erase(key);
+    }
+    void
+    merge(const flat_addr_set_t &other)
+    {
+        map_.merge(other.map_, [](no_value_t &, const no_value_t &) {});
+    }
+    bool
+    operator==(const flat_addr_set_t &rhs) const
+    {
+        return map_ == rhs.map_;
+    }
+    bool
+    operator!=(const flat_addr_set_t &rhs) const
+    {
+        return map_ != rhs.map_;
+    }
+
+private:
+    struct no_value_t {};
+    typedef flat_addr_map_t<no_value_t> map_t;
+
+public:
+    class const_iterator {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef addr_t value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const addr_t *pointer;
+        typedef addr_t reference;
+
+        explicit const_iterator(map_t::const_iterator it)
+            : it_(it)
+        {
+        }
+        addr_t
+        operator*() const
+        {
+            return (*it_).first;
+        }
+        const_iterator &
+        operator++()
+        {
+            ++it_;
+            return *this;
+        }
+        bool
+        operator==(const const_iterator &rhs) const
+        {
+            return it_ == rhs.it_;
+        }
+        bool
+        operator!=(const const_iterator &rhs) const
+        {
+            return it_ != rhs.it_;
+        }
+
+    private:
+        map_t::const_iterator it_;
+    };
+    const_iterator
+    begin() const
+    {
+        return const_iterator(map_.begin());
+    }
+    const_iterator
+    end() const
+    {
+        return const_iterator(map_.end());
+    }
+
+private:
+    map_t map_;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _FLAT_ADDR_MAP_H_ */
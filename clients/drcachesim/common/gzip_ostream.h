@@ -33,6 +33,8 @@
 /* gzip_ostream_t: a wrapper around zlib gzFile to match the parts of the
  * std::ostream interface we use for raw2trace and file_reader_t.
  * Seeking is not supported.
+ * gzip_chunked_ostream_t: an archive_ostream_t which writes each component as
+ * a separate gzip member and records a seek index for it (see seek_index.h).
  */
 
 #ifndef _GZIP_OSTREAM_H_
@@ -41,9 +43,19 @@
 #ifndef HAS_ZLIB
 #    error HAS_ZLIB is required
 #endif
+#include <stdint.h>
+#include <string.h>
+
+#include <cstdio>
 #include <fstream>
+#include <string>
+#include <vector>
 #include <zlib.h>
 
+#include "archive_ostream.h"
+#include "seek_index.h"
+#include "trace_entry.h"
+
 namespace dynamorio {
 namespace drmemtrace {
 
@@ -96,12 +108,82 @@ public:
         return overflow(traits_type::eof());
     }
 
-private:
+protected:
     static const int buffer_size_ = 4096;
     gzFile file_ = nullptr;
     char *buf_ = nullptr;
 };
 
+/* Finishes the current gzip member on each new_member() call, so that a reader
+ * can start decompressing at the next one's offset, and remembers that offset
+ * and the first timestamp written to each member.
+ */
+class gzip_chunked_streambuf_t : public gzip_streambuf_t {
+public:
+    explicit gzip_chunked_streambuf_t(const std::string &path)
+        : gzip_streambuf_t(path)
+    {
+    }
+    int
+    overflow(int extra_char) override
+    {
+        if (!members_.empty() && members_.back().timestamp == 0) {
+            scan_for_timestamp(pbase(), pptr());
+            if (extra_char != traits_type::eof()) {
+                char extra = traits_type::to_char_type(extra_char);
+                scan_for_timestamp(&extra, &extra + 1);
+            }
+        }
+        return gzip_streambuf_t::overflow(extra_char);
+    }
+    // Completes the current member, if any, and starts a new one.
+    bool
+    new_member()
+    {
+        if (file_ == nullptr || sync() == traits_type::eof())
+            return false;
+        if (!members_.empty() && gzflush(file_, Z_FINISH) != Z_OK)
+            return false;
+        z_off_t pos = gzoffset(file_);
+        if (pos < 0)
+            return false;
+        members_.push_back({ static_cast<uint64_t>(pos), 0 });
+        partial_size_ = 0;
+        return true;
+    }
+    const std::vector<seek_index_entry_t> &
+    get_members() const
+    {
+        return members_;
+    }
+
+private:
+    // Components hold whole trace_entry_t records, but buffer flushes can split
+    // them, so we carry partial records across calls.
+    void
+    scan_for_timestamp(const char *start, const char *end)
+    {
+        char *partial = reinterpret_cast<char *>(&partial_);
+        while (start < end && members_.back().timestamp == 0) {
+            size_t len = sizeof(partial_) - partial_size_;
+            if (len > static_cast<size_t>(end - start))
+                len = end - start;
+            memcpy(partial + partial_size_, start, len);
+            partial_size_ += len;
+            start += len;
+            if (partial_size_ < sizeof(partial_))
+                break;
+            partial_size_ = 0;
+            if (partial_.type == TRACE_TYPE_MARKER &&
+                partial_.size == TRACE_MARKER_TYPE_TIMESTAMP)
+                members_.back().timestamp = partial_.addr;
+        }
+    }
+    std::vector<seek_index_entry_t> members_;
+    trace_entry_t partial_;
+    size_t partial_size_ = 0;
+};
+
 class gzip_ostream_t : public std::ostream {
 public:
     explicit gzip_ostream_t(const std::string &path)
@@ -116,6 +198,65 @@ public:
     }
 };
 
+/* Each component is a separate gzip member: readers without the index see a
+ * single stream as zlib transparently reads concatenated members.  The index is
+ * written to the file's path plus DRMEMTRACE_SEEK_INDEX_SUFFIX by close(), or on
+ * destruction if close() was not called, if there is more than one component.
+ */
+class gzip_chunked_ostream_t : public archive_ostream_t {
+public:
+    explicit gzip_chunked_ostream_t(const std::string &path)
+        : archive_ostream_t(new gzip_chunked_streambuf_t(path))
+        , path_(path)
+    {
+        if (!rdbuf())
+            setstate(std::ios::badbit);
+    }
+    ~gzip_chunked_ostream_t() override
+    {
+        if (rdbuf() != nullptr)
+            close();
+    }
+    // Closes the file and writes its index.  Returns an empty string on success or
+    // a non-empty error description on failure.  No further writes are allowed.
+    std::string
+    close()
+    {
+        if (rdbuf() == nullptr)
+            return "";
+        // Flush while our streambuf's overflow() can still scan the final member.
+        flush();
+        bool flushed = good();
+        std::vector<seek_index_entry_t> members =
+            static_cast<gzip_chunked_streambuf_t *>(rdbuf())->get_members();
+        // Close the file so its size is final.
+        delete rdbuf(nullptr);
+        setstate(std::ios::badbit);
+        if (!flushed)
+            return "Failed to write " + path_;
+        std::string index_path = path_ + DRMEMTRACE_SEEK_INDEX_SUFFIX;
+        if (members.size() <= 1) {
+            // Avoid leaving a stale index from a prior run.
+            std::remove(index_path.c_str());
+            return "";
+        }
+        std::ifstream file(path_, std::ifstream::binary | std::ifstream::ate);
+        if (!file)
+            return "Failed to read the size of " + path_;
+        return write_seek_index(index_path, static_cast<uint64_t>(file.tellg()), members);
+    }
+    std::string
+    open_new_component(const std::string &name) override
+    {
+        if (!static_cast<gzip_chunked_streambuf_t *>(rdbuf())->new_member())
+            return "Failed to start a new gzip member for " + name;
+        return "";
+    }
+
+private:
+    std::string path_;
+};
+
 } // namespace drmemtrace
 } // namespace dynamorio
 
@@ -133,9 +133,11 @@ droption_t<bytesize_t> op_chunk_instr_count(
 #endif
     "Chunk instruction count",
     "Specifies the size in instructions of the chunks into which a trace output file "
-    "is split inside a zipfile.  This is the granularity of a fast seek. "
-    "This only applies when generating .zip-format traces; when built without "
-    "support for writing .zip files, this option is ignored. "
+    "is split inside a zipfile, or into separate indexed members of a gzip file for "
+    "-compress gzip_indexed.  "
+    "This is the granularity of a fast seek. "
+    "This only applies when generating .zip-format or indexed .gz-format traces; "
+    "otherwise, this option is ignored. "
     "For 32-bit this cannot exceed 4G.");
 
 droption_t<bool> op_instr_encodings(
@@ -257,6 +259,21 @@ droption_t<bool> op_coherence(
     DROPTION_SCOPE_FRONTEND, "coherence", false, "Model coherence for private caches",
     "Writes to cache lines will invalidate other private caches that hold that line.");
 
+droption_t<bool> op_parallel_cores(
+    DROPTION_SCOPE_FRONTEND, "parallel_cores", false,
+    "Simulate cores in parallel under -core_sharded",
+    "For -core_sharded, simulate each core's private caches in parallel in the worker "
+    "thread owning that core.  Requests from private caches to caches shared among "
+    "cores are logged and replayed into the shared caches in a fixed order, so for a "
+    "given schedule of threads onto cores all statistics are identical to a serial "
+    "simulation which interleaves the cores one trace record at a time (the dynamic "
+    "schedule itself may vary from run to run).  The logged requests of cores "
+    "running ahead are held in memory until the slower cores catch up.  Hierarchies "
+    "with -coherence, inclusive shared caches, or L1 caches shared among cores, and "
+    "-timing, are simulated serially instead, as are runs where another tool "
+    "requires serial analysis.  This mode does not support "
+    "-skip_refs, -warmup_refs, -warmup_fraction, -sim_refs, or -use_physical.");
+
 droption_t<bool> op_use_physical(
     DROPTION_SCOPE_ALL, "use_physical", false, "Use physical addresses if possible",
     "If available, metadata with virtual-to-physical-address translation information "
@@ -387,13 +404,50 @@ droption_t<std::string> op_raw_compress(
     "for an SSD, zlib and gzip typically add overhead and would only be used if space is "
     "at a premium; snappy_nocrc and lz4 are nearly always performance wins.");
 
+droption_t<unsigned int> op_write_behind_threads(
+    DROPTION_SCOPE_CLIENT, "write_behind_threads", 0,
+    "Number of threads compressing and writing raw offline files",
+    "If non-zero, full trace buffers are handed off to this many internal threads, "
+    "which compress (per -raw_compress) and write them to the raw offline files "
+    "while the application thread continues with a fresh buffer.  Each application "
+    "thread's data is always written by the same internal thread, in order.  The "
+    "memory used for queued buffers is bounded by -write_behind_max_mem; an "
+    "application thread only blocks when that limit is reached.  The time each thread "
+    "spent blocked is reported at -verbose 1.  This is only supported for -offline "
+    "without a replacement buffer handoff function.");
+
+droption_t<bytesize_t> op_write_behind_max_mem(
+    DROPTION_SCOPE_CLIENT, "write_behind_max_mem", 256 * 1024 * 1024,
+    "Cap on memory for buffers queued for -write_behind_threads",
+    "Limits the total size of trace buffers that are queued for, or being written "
+    "by, the -write_behind_threads internal threads, not counting each application "
+    "thread's own current buffer.  At least one buffer is always allowed.");
+
 droption_t<std::string> op_trace_compress(
     DROPTION_SCOPE_FRONTEND, "compress", DEFAULT_TRACE_COMPRESSION_TYPE,
-    "Trace compression: \"zip\",\"gzip\",\"zlib\",\"lz4\",\"none\"",
+#ifdef HAS_ZSTD
+    "Trace compression: \"zip\",\"gzip\",\"gzip_indexed\",\"zlib\",\"lz4\",\"zstd\","
+    "\"none\"",
+    "Specifies the compression type to use for trace files: \"zip\", "
+    "\"gzip\", \"gzip_indexed\", \"zlib\", \"lz4\", \"zstd\", or \"none\". "
+#else
+    "Trace compression: \"zip\",\"gzip\",\"gzip_indexed\",\"zlib\",\"lz4\",\"none\"",
     "Specifies the compression type to use for trace files: \"zip\", "
-    "\"gzip\", \"zlib\", \"lz4\", or \"none\". "
+    "\"gzip\", \"gzip_indexed\", \"zlib\", \"lz4\", or \"none\". "
+#endif
+    "\"gzip_indexed\" writes each -chunk_instr_count chunk as a separate gzip member "
+    "and a \".idx\" seek index alongside each file, which lets readers jump to the "
+    "target chunk when skipping instructions.  As each member is compressed "
+    "independently the files are larger: negligibly so at the default "
+    "-chunk_instr_count, but by several percent for chunks of a few thousand "
+    "instructions. "
     "In most cases where fast skipping by instruction count is not needed "
     "lz4 compression generally improves performance and is recommended. "
+#ifdef HAS_ZSTD
+    "zstd compresses nearly as well as gzip at a fraction of the decompression "
+    "cost, decompresses ahead on a separate thread, and supports fast skipping "
+    "by jumping to the target chunk. "
+#endif
     "When it comes to storage types, the impact on overhead varies: "
     "for SSDs, zip and gzip often increase overhead and should only be chosen "
     "if space is limited.");
@@ -407,10 +461,13 @@ droption_t<bool> op_online_instr_types(
 
 droption_t<std::string> op_replace_policy(
     DROPTION_SCOPE_FRONTEND, "replace_policy", REPLACE_POLICY_LRU,
-    "Cache replacement policy (LRU, LFU, FIFO)",
+    "Cache replacement policy (LRU, LFU, FIFO, PLRU, SRRIP, BRRIP, DRRIP, SHiP)",
     "Specifies the replacement policy for "
     "caches. Supported policies: LRU (Least Recently Used), LFU (Least Frequently Used), "
-    "FIFO (First-In-First-Out).");
+    "FIFO (First-In-First-Out), PLRU (tree pseudo-LRU, for power-of-2 associativities "
+    "up to 64), SRRIP, BRRIP, and DRRIP (static, bimodal, and set-dueling dynamic "
+    "Re-Reference Interval Prediction), and SHiP (Signature-based Hit Predictor "
+    "using PC signatures on top of SRRIP).");
 
 droption_t<std::string> op_data_prefetcher(
     DROPTION_SCOPE_FRONTEND, "data_prefetcher", PREFETCH_POLICY_NEXTLINE,
@@ -420,6 +477,74 @@ droption_t<std::string> op_data_prefetcher(
     "subsequent cache line) and 'none' (disables hardware prefetching).  The prefetcher "
     "is located between the L1D and LL caches.");
 
+droption_t<bool> op_timing(
+    DROPTION_SCOPE_FRONTEND, "timing", false, "Model the timing of cache accesses",
+    "If true, the cache simulator also estimates the cycles each core spends on its "
+    "accesses, reporting instructions per cycle, the average memory access time "
+    "(AMAT), prefetch timeliness, and DRAM bandwidth use per core.  Each cache level "
+    "costs its hit latency (-L1_latency, -LL_latency) and may only have a limited "
+    "number of misses outstanding (-L1_mshrs, -LL_mshrs), while DRAM is modeled as "
+    "banks with open rows sharing a bandwidth-limited bus.  Loads overlap with "
+    "later instructions up to -rob_size instructions.  For a configuration file, "
+    "each cache may set its own 'latency' and 'mshrs'.");
+
+droption_t<unsigned int> op_L1_latency(DROPTION_SCOPE_FRONTEND, "L1_latency", 4,
+                                       "L1 hit latency in cycles for -timing",
+                                       "Specifies the cycles an L1 cache hit takes "
+                                       "under -timing.");
+
+droption_t<unsigned int> op_LL_latency(DROPTION_SCOPE_FRONTEND, "LL_latency", 40,
+                                       "Last-level cache hit latency for -timing",
+                                       "Specifies the cycles a last-level cache hit "
+                                       "takes under -timing.  A miss takes this long "
+                                       "before its request reaches DRAM.");
+
+droption_t<unsigned int> op_L1_mshrs(
+    DROPTION_SCOPE_FRONTEND, "L1_mshrs", 16, "L1 outstanding misses for -timing",
+    "Specifies the number of miss status holding registers of each L1 cache under "
+    "-timing: a miss finding them all busy waits for the first to free up.  0 "
+    "means unlimited.");
+
+droption_t<unsigned int> op_LL_mshrs(
+    DROPTION_SCOPE_FRONTEND, "LL_mshrs", 64,
+    "Last-level cache outstanding misses for -timing",
+    "Specifies the number of miss status holding registers of the last-level cache "
+    "under -timing.  0 means unlimited.");
+
+droption_t<unsigned int> op_rob_size(
+    DROPTION_SCOPE_FRONTEND, "rob_size", 224, "Instruction window size for -timing",
+    "Specifies how many instructions may be fetched under -timing while a load is "
+    "still waiting for its data, approximating an out-of-order core's reorder "
+    "buffer.  1 makes every load stall the core.");
+
+droption_t<unsigned int> op_dram_banks(DROPTION_SCOPE_FRONTEND, "dram_banks", 16,
+                                       "DRAM banks for -timing",
+                                       "Specifies the number of DRAM banks under "
+                                       "-timing, across which cache lines are "
+                                       "interleaved.");
+
+droption_t<unsigned int> op_dram_bytes_per_cycle(
+    DROPTION_SCOPE_FRONTEND, "dram_bytes_per_cycle", 8, "DRAM bandwidth for -timing",
+    "Specifies the bytes the DRAM bus transfers per core cycle under -timing, which "
+    "bounds the memory bandwidth of all cores combined.");
+
+droption_t<unsigned int> op_dram_row_hit_latency(
+    DROPTION_SCOPE_FRONTEND, "dram_row_hit_latency", 60,
+    "DRAM open row latency for -timing",
+    "Specifies the cycles a DRAM access to a bank's open row takes under -timing.");
+
+droption_t<unsigned int> op_dram_row_miss_latency(
+    DROPTION_SCOPE_FRONTEND, "dram_row_miss_latency", 150,
+    "DRAM closed row latency for -timing",
+    "Specifies the cycles a DRAM access to a row other than its bank's open row "
+    "takes under -timing, including the precharge and activate.");
+
+droption_t<bytesize_t> op_timing_interval(
+    DROPTION_SCOPE_FRONTEND, "timing_interval", 0,
+    "Cycles per interval of -timing results",
+    "If non-zero, -timing additionally reports each core's instructions, IPC, AMAT, "
+    "and share of the DRAM bandwidth for every interval of this many cycles.");
+
 droption_t<bytesize_t> op_page_size(DROPTION_SCOPE_FRONTEND, "page_size",
                                     bytesize_t(4 * 1024), "Virtual/physical page size",
                                     "Specifies the virtual/physical page size.");
@@ -455,11 +580,49 @@ droption_t<std::string>
                           "Specifies the replacement policy for TLBs. "
                           "Supported policies: LFU (Least Frequently Used).");
 
+droption_t<std::string> op_TLB_page_size_map(
+    DROPTION_SCOPE_FRONTEND, "TLB_page_size_map", "",
+    "File listing the huge page ranges for the TLBs",
+    "Specifies a file listing the virtual address ranges mapped by huge pages, one "
+    "\"<start> <end> <page_size>\" range per line, such as \"0x7f0000000000 "
+    "0x7f0040000000 2M\".  Addresses may be hex and sizes may have a K, M, or G "
+    "suffix; lines starting with # are ignored.  The TLBs hold base and huge page "
+    "entries side by side, and page walks for huge pages end at the PDPT (1G) or "
+    "PD (2M) level.  Addresses outside every range use -page_size.  This is "
+    "typically derived from the AnonHugePages and hugetlbfs mappings of the "
+    "traced application's /proc/pid/smaps.");
+
+droption_t<std::string> op_TLB_pwc_entries(
+    DROPTION_SCOPE_FRONTEND, "TLB_pwc_entries", "2,4,32",
+    "Paging-structure cache sizes",
+    "Specifies the number of entries in each core's PML4, PDPT, and PDE caches, "
+    "separated by commas.  These hold upper-level page table entries so that a "
+    "walk after a last-level TLB miss can skip the levels above them.  0 disables a "
+    "cache.");
+
+droption_t<std::string> op_TLB_walk_latencies(
+    DROPTION_SCOPE_FRONTEND, "TLB_walk_latencies", "4,40,200",
+    "Cycles per page table entry read by cache level",
+    "Specifies the cycles charged for each page table entry read by a walk, by the "
+    "cache level that supplied it from the L1 outward, separated by commas.  The "
+    "last value is for memory, and cache levels beyond the list use its last cache "
+    "value.  Without -TLB_walk_caches every entry is charged the memory latency.");
+
+droption_t<bool> op_TLB_walk_caches(
+    DROPTION_SCOPE_FRONTEND, "TLB_walk_caches", false,
+    "Send page walks through a cache hierarchy",
+    "If true, the TLB simulator also simulates a cache hierarchy configured by the "
+    "cache simulator options (-L1D_size, -LL_size, and so on) that sees every "
+    "instruction and data access along with the page table entries read by walks. "
+    "Each entry's latency then comes from the level that supplied it "
+    "(see -TLB_walk_latencies).");
+
 droption_t<std::string>
     op_simulator_type(DROPTION_SCOPE_FRONTEND, "simulator_type", CPU_CACHE,
                       "Specifies the types of simulators, separated by a colon (\":\").",
                       "Predefined types: " CPU_CACHE ", " MISS_ANALYZER ", " TLB
-                      ", " REUSE_DIST ", " REUSE_TIME ", " HISTOGRAM ", " BASIC_COUNTS
+                      ", " REUSE_DIST ", " REUSE_TIME ", " MISS_RATIO_CURVE
+                      ", " SIMPOINT ", " HISTOGRAM ", " BASIC_COUNTS
                       ", or " INVARIANT_CHECKER
                       ". The external types: name of a tool identified by a "
                       "name.drcachesim config file in the DR tools directory.");
@@ -521,6 +684,15 @@ droption_t<bytesize_t> op_interval_microseconds(
     "Trace intervals are measured using the TRACE_MARKER_TYPE_TIMESTAMP marker values. "
     "If set, analysis tools receive a callback at the end of each interval.");
 
+droption_t<std::string> op_interval_stream_file(
+    DROPTION_SCOPE_FRONTEND, "interval_stream_file", "",
+    "Stream whole-trace interval results to this file as they complete.",
+    "When -interval_microseconds is set, each whole-trace interval's results are "
+    "merged across shards and appended to this file as soon as every shard has moved "
+    "past the end of the interval, rather than all being printed with the final "
+    "results.  This bounds the memory held for interval snapshots and lets long-running "
+    "online analyses be monitored live.");
+
 droption_t<int>
     op_only_thread(DROPTION_SCOPE_FRONTEND, "only_thread", 0,
                    "Only analyze this thread (0 means all)",
@@ -648,6 +820,83 @@ droption_t<double> op_reuse_histogram_bin_multiplier(
     "bins.  Note that this option only affects the printing of histograms via "
     "the -reuse_distance_histogram option; the raw histogram data is always "
     "collected at full precision.");
+droption_t<std::string> op_reuse_engine(
+    DROPTION_SCOPE_FRONTEND, "reuse_engine", "list",
+    "The reuse distance computation method: \"list\" or \"tree\".",
+    "Selects how the reuse_distance tool computes distances.  \"list\" walks a "
+    "linked list of cache lines accelerated by a skip list (see -reuse_skip_dist), "
+    "which is fast when most distances are short.  \"tree\" uses an "
+    "order-statistic tree over access times, whose cost grows only logarithmically "
+    "with the distance and which needs no tuning; it is recommended for traces "
+    "with large working sets.  Both produce identical results.");
+droption_t<double> op_reuse_sample_rate(
+    DROPTION_SCOPE_FRONTEND, "reuse_sample_rate", 1.0,
+    "If below 1, track only this fraction of cache lines for reuse distance.",
+    "Specifies the fraction of cache lines, between 0 and 1, whose reuse distances "
+    "the reuse_distance tool tracks.  Lines are selected by hashing their addresses "
+    "so that every access to a selected line is seen, and measured distances are "
+    "scaled up by the inverse of the rate (the SHARDS approach).  This reduces "
+    "time and memory roughly in proportion to the rate at the cost of approximate "
+    "distances.  Reported counts of lines and reuses include only sampled lines, "
+    "and -reuse_distance_threshold and -reuse_distance_limit remain in terms of "
+    "full (scaled) distances.");
+
+droption_t<double> op_mrc_sample_rate(
+    DROPTION_SCOPE_FRONTEND, "mrc_sample_rate", 1.0,
+    "Initial fraction of cache lines sampled by the miss_ratio_curve tool.",
+    "Specifies the fraction of cache lines, between 0 and 1, that the "
+    "miss_ratio_curve tool initially samples.  Lines are selected by hashing their "
+    "addresses, and the rate is lowered automatically whenever a sample set would "
+    "exceed -mrc_sample_lines lines, so this only needs lowering to save time on "
+    "traces known to have large working sets.");
+droption_t<unsigned int> op_mrc_sample_lines(
+    DROPTION_SCOPE_FRONTEND, "mrc_sample_lines", 8192, 1, UINT_MAX,
+    "Maximum cache lines in each miss_ratio_curve sample set.",
+    "Specifies the maximum number of cache lines tracked by each of the "
+    "miss_ratio_curve tool's sample sets for each shard.  This bounds the tool's "
+    "memory usage regardless of the trace's working set size.  Larger values "
+    "improve accuracy.");
+droption_t<unsigned int> op_mrc_sample_sets(
+    DROPTION_SCOPE_FRONTEND, "mrc_sample_sets", 4, 1, 64,
+    "Number of independent sample sets in the miss_ratio_curve tool.",
+    "Specifies how many independently hashed sample sets the miss_ratio_curve tool "
+    "keeps for each shard.  The reported miss ratio is their mean, and the reported "
+    "low and high bounds are a 95% confidence interval computed from their spread.  "
+    "Time grows in proportion to this value.");
+droption_t<std::string> op_mrc_format(
+    DROPTION_SCOPE_FRONTEND, "mrc_format", "csv",
+    "Output format of the miss_ratio_curve tool: \"csv\" or \"json\".",
+    "Specifies whether the miss_ratio_curve tool prints its curve as comma-separated "
+    "values or as JSON.  Each point gives a cache size in lines and in bytes "
+    "(using -line_size), the estimated miss ratio of a fully associative LRU cache "
+    "of that size, and the bounds of its confidence interval.");
+droption_t<std::string> op_mrc_outfile(
+    DROPTION_SCOPE_FRONTEND, "mrc_outfile", "",
+    "Output file for the miss_ratio_curve tool's curve.",
+    "If set, the miss_ratio_curve tool writes its curve to this file rather than "
+    "printing it to stderr.");
+
+droption_t<bytesize_t> op_simpoint_interval_instrs(
+    DROPTION_SCOPE_FRONTEND, "simpoint_interval_instrs", 10000000,
+    "Instructions in each interval clustered by the simpoint tool.",
+    "Specifies the length in instructions of the intervals each thread is divided "
+    "into by the simpoint tool.  Each interval's basic block vector is clustered, "
+    "and one interval per cluster is reported as a representative.  A final partial "
+    "interval shorter than half this length is not clustered.  The length must be "
+    "positive.");
+droption_t<unsigned int> op_simpoint_max_k(
+    DROPTION_SCOPE_FRONTEND, "simpoint_max_k", 30, 1, 1024,
+    "Maximum number of clusters tried by the simpoint tool.",
+    "Specifies the largest number of clusters the simpoint tool tries.  It picks the "
+    "smallest cluster count whose Bayesian information criterion score is within 90% "
+    "of the best score's range.");
+droption_t<std::string> op_simpoint_outfile(
+    DROPTION_SCOPE_FRONTEND, "simpoint_outfile", "",
+    "Output file for the simpoint tool's representative intervals.",
+    "If set, the simpoint tool also writes its representative intervals to this file "
+    "as comma-separated values: the thread id, the first and last instruction "
+    "ordinals (inclusive, starting at 1, as in the scheduler's regions of interest), "
+    "the weight, and the cluster.");
 
 #define OP_RECORD_FUNC_ITEM_SEP "&"
 // XXX i#3048: replace function return address with function callstack
@@ -790,6 +1039,13 @@ droption_t<bool> op_enable_drstatecmp(
     DROPTION_SCOPE_CLIENT, "enable_drstatecmp", false, "Enable the drstatecmp library.",
     "When true, this option enables the drstatecmp library that performs state "
     "comparisons to detect instrumentation-induced bugs due to state clobbering.");
+droption_t<bool> op_inter_block_liveness(
+    DROPTION_SCOPE_CLIENT, "inter_block_liveness", false,
+    "Use register liveness across blocks to avoid spills.",
+    "When true, the tracer asks drreg to consider the liveness of registers and "
+    "arithmetic flags in the direct successors of each block, which avoids spilling "
+    "scratch registers that are dead on exit.  This assumes the application does not "
+    "modify the code of its loaded modules in place.");
 
 #ifdef BUILD_PT_TRACER
 droption_t<bool> op_enable_kernel_tracing(
@@ -808,7 +1064,8 @@ droption_t<bool> op_core_sharded(
     "software threads.  This option instead schedules those threads onto virtual cores "
     "and analyzes each core in parallel.  Thus, each shard consists of pieces from "
     "many software threads.  How the scheduling is performed is controlled by a set "
-    "of options with the prefix \"sched_\" along with -num_cores.");
+    "of options with the prefix \"sched_\" along with -num_cores.  The cache "
+    "simulator still simulates the cores serially unless -parallel_cores is set.");
 
 droption_t<bool> op_core_serial(
     DROPTION_SCOPE_ALL, "core_serial", false, "Analyze per-core in serial.",
@@ -837,6 +1094,15 @@ droption_t<bool> op_sched_order_time(DROPTION_SCOPE_ALL, "sched_order_time", tru
                                      "Applies to -core_sharded and -core_serial. "
                                      "Whether to honor recorded timestamps for ordering");
 
+droption_t<bool> op_sched_local_queues(
+    DROPTION_SCOPE_ALL, "sched_local_queues", false,
+    "Use a ready queue per core with work stealing",
+    "Applies to -core_sharded and -core_serial. "
+    "Gives each core its own queue of ready inputs rather than sharing one global "
+    "queue, with idle cores stealing inputs from other cores' queues.  This reduces "
+    "lock contention with many cores at the cost of the ordering by priority and "
+    "timestamp being per-core rather than global.");
+
 #ifdef HAS_ZIP
 droption_t<std::string> op_record_file(DROPTION_SCOPE_FRONTEND, "record_file", "",
                                        "Path for storing record of schedule",
@@ -39,6 +39,11 @@
 #define REPLACE_POLICY_LRU "LRU"
 #define REPLACE_POLICY_LFU "LFU"
 #define REPLACE_POLICY_FIFO "FIFO"
+#define REPLACE_POLICY_PLRU "PLRU"
+#define REPLACE_POLICY_SRRIP "SRRIP"
+#define REPLACE_POLICY_BRRIP "BRRIP"
+#define REPLACE_POLICY_DRRIP "DRRIP"
+#define REPLACE_POLICY_SHIP "SHiP"
 #define PREFETCH_POLICY_NEXTLINE "nextline"
 #define PREFETCH_POLICY_NONE "none"
 #define CPU_CACHE "cache"
@@ -47,6 +52,8 @@
 #define HISTOGRAM "histogram"
 #define REUSE_DIST "reuse_distance"
 #define REUSE_TIME "reuse_time"
+#define MISS_RATIO_CURVE "miss_ratio_curve"
+#define SIMPOINT "simpoint"
 #define BASIC_COUNTS "basic_counts"
 #define OPCODE_MIX "opcode_mix"
 #define SYSCALL_MIX "syscall_mix"
@@ -109,6 +116,7 @@ extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
     op_L0_filter_until_instrs;
 extern dynamorio::droption::droption_t<bool> op_instr_only_trace;
 extern dynamorio::droption::droption_t<bool> op_coherence;
+extern dynamorio::droption::droption_t<bool> op_parallel_cores;
 extern dynamorio::droption::droption_t<bool> op_use_physical;
 extern dynamorio::droption::droption_t<unsigned int> op_virt2phys_freq;
 extern dynamorio::droption::droption_t<bool> op_cpu_scheduling;
@@ -126,10 +134,25 @@ extern dynamorio::droption::droption_t<bool> op_split_windows;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
     op_exit_after_tracing;
 extern dynamorio::droption::droption_t<std::string> op_raw_compress;
+extern dynamorio::droption::droption_t<unsigned int> op_write_behind_threads;
+extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
+    op_write_behind_max_mem;
 extern dynamorio::droption::droption_t<std::string> op_trace_compress;
 extern dynamorio::droption::droption_t<bool> op_online_instr_types;
 extern dynamorio::droption::droption_t<std::string> op_replace_policy;
 extern dynamorio::droption::droption_t<std::string> op_data_prefetcher;
+extern dynamorio::droption::droption_t<bool> op_timing;
+extern dynamorio::droption::droption_t<unsigned int> op_L1_latency;
+extern dynamorio::droption::droption_t<unsigned int> op_LL_latency;
+extern dynamorio::droption::droption_t<unsigned int> op_L1_mshrs;
+extern dynamorio::droption::droption_t<unsigned int> op_LL_mshrs;
+extern dynamorio::droption::droption_t<unsigned int> op_rob_size;
+extern dynamorio::droption::droption_t<unsigned int> op_dram_banks;
+extern dynamorio::droption::droption_t<unsigned int> op_dram_bytes_per_cycle;
+extern dynamorio::droption::droption_t<unsigned int> op_dram_row_hit_latency;
+extern dynamorio::droption::droption_t<unsigned int> op_dram_row_miss_latency;
+extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
+    op_timing_interval;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t> op_page_size;
 extern dynamorio::droption::droption_t<unsigned int> op_TLB_L1I_entries;
 extern dynamorio::droption::droption_t<unsigned int> op_TLB_L1D_entries;
@@ -138,6 +161,10 @@ extern dynamorio::droption::droption_t<unsigned int> op_TLB_L1D_assoc;
 extern dynamorio::droption::droption_t<unsigned int> op_TLB_L2_entries;
 extern dynamorio::droption::droption_t<unsigned int> op_TLB_L2_assoc;
 extern dynamorio::droption::droption_t<std::string> op_TLB_replace_policy;
+extern dynamorio::droption::droption_t<std::string> op_TLB_page_size_map;
+extern dynamorio::droption::droption_t<std::string> op_TLB_pwc_entries;
+extern dynamorio::droption::droption_t<std::string> op_TLB_walk_latencies;
+extern dynamorio::droption::droption_t<bool> op_TLB_walk_caches;
 extern dynamorio::droption::droption_t<std::string> op_simulator_type;
 extern dynamorio::droption::droption_t<unsigned int> op_verbose;
 extern dynamorio::droption::droption_t<bool> op_show_func_trace;
@@ -153,6 +180,7 @@ extern dynamorio::droption::droption_t<std::string> op_tracer_alt;
 extern dynamorio::droption::droption_t<std::string> op_tracer_ops;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
     op_interval_microseconds;
+extern dynamorio::droption::droption_t<std::string> op_interval_stream_file;
 extern dynamorio::droption::droption_t<int> op_only_thread;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t> op_skip_instrs;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t> op_skip_refs;
@@ -167,6 +195,17 @@ extern dynamorio::droption::droption_t<unsigned int> op_reuse_skip_dist;
 extern dynamorio::droption::droption_t<unsigned int> op_reuse_distance_limit;
 extern dynamorio::droption::droption_t<bool> op_reuse_verify_skip;
 extern dynamorio::droption::droption_t<double> op_reuse_histogram_bin_multiplier;
+extern dynamorio::droption::droption_t<std::string> op_reuse_engine;
+extern dynamorio::droption::droption_t<double> op_reuse_sample_rate;
+extern dynamorio::droption::droption_t<double> op_mrc_sample_rate;
+extern dynamorio::droption::droption_t<unsigned int> op_mrc_sample_lines;
+extern dynamorio::droption::droption_t<unsigned int> op_mrc_sample_sets;
+extern dynamorio::droption::droption_t<std::string> op_mrc_format;
+extern dynamorio::droption::droption_t<std::string> op_mrc_outfile;
+extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
+    op_simpoint_interval_instrs;
+extern dynamorio::droption::droption_t<unsigned int> op_simpoint_max_k;
+extern dynamorio::droption::droption_t<std::string> op_simpoint_outfile;
 extern dynamorio::droption::droption_t<std::string> op_view_syntax;
 extern dynamorio::droption::droption_t<std::string> op_record_function;
 extern dynamorio::droption::droption_t<bool> op_record_heap;
@@ -178,6 +217,7 @@ extern dynamorio::droption::droption_t<unsigned int> op_miss_count_threshold;
 extern dynamorio::droption::droption_t<double> op_miss_frac_threshold;
 extern dynamorio::droption::droption_t<double> op_confidence_threshold;
 extern dynamorio::droption::droption_t<bool> op_enable_drstatecmp;
+extern dynamorio::droption::droption_t<bool> op_inter_block_liveness;
 #ifdef BUILD_PT_TRACER
 extern dynamorio::droption::droption_t<bool> op_enable_kernel_tracing;
 #endif
@@ -186,6 +226,7 @@ extern dynamorio::droption::droption_t<bool> op_core_serial;
 extern dynamorio::droption::droption_t<int64_t> op_sched_quantum;
 extern dynamorio::droption::droption_t<bool> op_sched_time;
 extern dynamorio::droption::droption_t<bool> op_sched_order_time;
+extern dynamorio::droption::droption_t<bool> op_sched_local_queues;
 #ifdef HAS_ZIP
 extern dynamorio::droption::droption_t<std::string> op_record_file;
 extern dynamorio::droption::droption_t<std::string> op_replay_file;
@@ -0,0 +1,211 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* pipelined_ostream_t: an std::ostream that hands each filled buffer to a
+ * shared pool of writer threads, which write it to (and thereby compress it
+ * in) a wrapped std::ostream such as gzip_ostream_t, so that the producer keeps
+ * running while the previous buffer is written.
+ */
+
+#ifndef _PIPELINED_OSTREAM_H_
+#define _PIPELINED_OSTREAM_H_ 1
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace dynamorio {
+namespace drmemtrace {
+
+/* A fixed set of threads running the buffer writes of any number of
+ * pipelined_ostream_t instances.  The number of threads bounds how many
+ * outputs are compressed concurrently.
+ */
+class pipelined_write_pool_t {
+public:
+    explicit pipelined_write_pool_t(int num_threads)
+    {
+        for (int i = 0; i < num_threads; ++i)
+            threads_.emplace_back(&pipelined_write_pool_t::run, this);
+    }
+    ~pipelined_write_pool_t()
+    {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            exiting_ = true;
+        }
+        cond_.notify_all();
+        for (std::thread &thread : threads_)
+            thread.join();
+    }
+    void
+    submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        cond_.notify_one();
+    }
+
+private:
+    void
+    run()
+    {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [this] { return exiting_ || !tasks_.empty(); });
+                // Streams wait for their own writes before they are destroyed, so
+                // there is nothing left to run once we are told to exit.
+                if (tasks_.empty())
+                    return;
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<std::function<void()>> tasks_;
+    bool exiting_ = false;
+    std::vector<std::thread> threads_;
+};
+
+/* We double-buffer: the producer fills one buffer while a pool thread writes the
+ * other.  At most one write per stream is in flight, which keeps the output in
+ * order without any reordering on the writer side.  A write failure is reported
+ * by the next overflow() or sync(), so the stream turns bad one buffer late.
+ */
+class pipelined_streambuf_t : public std::basic_streambuf<char, std::char_traits<char>> {
+public:
+    pipelined_streambuf_t(std::unique_ptr<std::ostream> out, pipelined_write_pool_t *pool,
+                          size_t buffer_size)
+        : out_(std::move(out))
+        , pool_(pool)
+        , fill_buf_(buffer_size)
+        , write_buf_(buffer_size)
+    {
+        // We leave an extra slot for extra_char on overflow.
+        setp(fill_buf_.data(), fill_buf_.data() + fill_buf_.size() - 1);
+    }
+    ~pipelined_streambuf_t() override
+    {
+        sync();
+        // Destroying the wrapped stream here, on the producer's thread, completes
+        // the output file.
+    }
+    int
+    overflow(int extra_char) override
+    {
+        if (extra_char != traits_type::eof()) {
+            // Put the extra char into the buffer.  We left an extra slot for it.
+            *pptr() = traits_type::to_char_type(extra_char);
+            pbump(1);
+        }
+        if (!wait_for_write())
+            return traits_type::eof();
+        size_t len = pptr() - pbase();
+        if (len > 0) {
+            std::swap(fill_buf_, write_buf_);
+            in_flight_ = true;
+            pool_->submit([this, len] {
+                bool ok = static_cast<bool>(out_->write(write_buf_.data(), len));
+                std::lock_guard<std::mutex> guard(mutex_);
+                failed_ = failed_ || !ok;
+                in_flight_ = false;
+                cond_.notify_all();
+            });
+        }
+        setp(fill_buf_.data(), fill_buf_.data() + fill_buf_.size() - 1);
+        return traits_type::not_eof(extra_char);
+    }
+    int
+    sync() override
+    {
+        if (overflow(traits_type::eof()) == traits_type::eof() || !wait_for_write() ||
+            !out_->flush())
+            return -1;
+        return 0;
+    }
+
+private:
+    // Returns whether all writes so far succeeded.
+    bool
+    wait_for_write()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return !in_flight_; });
+        return !failed_;
+    }
+
+    std::unique_ptr<std::ostream> out_;
+    pipelined_write_pool_t *pool_;
+    std::vector<char> fill_buf_;
+    std::vector<char> write_buf_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool in_flight_ = false;
+    bool failed_ = false;
+};
+
+class pipelined_ostream_t : public std::ostream {
+public:
+    // 64K keeps the two buffers per open output small while making each handoff
+    // large relative to its synchronization cost.
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+    pipelined_ostream_t(std::unique_ptr<std::ostream> out, pipelined_write_pool_t *pool,
+                        size_t buffer_size = DEFAULT_BUFFER_SIZE)
+        : std::ostream(new pipelined_streambuf_t(std::move(out), pool, buffer_size))
+    {
+    }
+    ~pipelined_ostream_t() override
+    {
+        delete rdbuf();
+    }
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _PIPELINED_OSTREAM_H_ */
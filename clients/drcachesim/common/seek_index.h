@@ -0,0 +1,132 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* seek_index: a sidecar file listing where each chunk of a compressed trace
+ * file starts, for compression formats such as gzip which, unlike a zipfile,
+ * have no directory of their own to seek with.
+ */
+
+#ifndef _SEEK_INDEX_H_
+#define _SEEK_INDEX_H_ 1
+
+#include <stdint.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// The suffix appended to a compressed trace file's path to name its seek index.
+#define DRMEMTRACE_SEEK_INDEX_SUFFIX ".idx"
+
+// One entry per chunk, in chunk order.  The first instruction in chunk #N is
+// instruction ordinal N * chunk_instr_count + 1, where chunk_instr_count is
+// taken from the trace's TRACE_MARKER_TYPE_CHUNK_INSTR_COUNT marker.  Each
+// chunk must be a self-contained stream starting at "offset" in the compressed
+// file (e.g., a separate gzip member) which repeats the timestamp, cpu, record
+// ordinal, and encodings that a reader needs to resume there.
+struct seek_index_entry_t {
+    uint64_t offset;
+    // The first timestamp in the chunk, or 0 if it has none.
+    uint64_t timestamp;
+};
+
+static const uint64_t SEEK_INDEX_MAGIC = 0x78646e496b656553ULL; // "SeekIndx"
+static const uint64_t SEEK_INDEX_VERSION = 1;
+
+// The on-disk layout is this header followed by "num_entries" seek_index_entry_t.
+struct seek_index_header_t {
+    uint64_t magic;
+    uint64_t version;
+    // The size of the indexed file, used to detect a stale index.
+    uint64_t file_size;
+    uint64_t num_entries;
+};
+
+// Writes the index for the compressed file of size "file_size" to "path".
+// Returns an empty string on success or an error description on failure.
+static inline std::string
+write_seek_index(const std::string &path, uint64_t file_size,
+                 const std::vector<seek_index_entry_t> &entries)
+{
+    std::ofstream file(path, std::ofstream::binary);
+    if (!file)
+        return "Failed to open seek index " + path;
+    seek_index_header_t header = { SEEK_INDEX_MAGIC, SEEK_INDEX_VERSION, file_size,
+                                   entries.size() };
+    if (!file.write(reinterpret_cast<const char *>(&header), sizeof(header)) ||
+        !file.write(reinterpret_cast<const char *>(entries.data()),
+                    entries.size() * sizeof(entries[0])))
+        return "Failed to write seek index " + path;
+    return "";
+}
+
+// Reads the index at "path" for the compressed file of size "file_size".
+// Returns false if there is no index or it is malformed or stale.
+static inline bool
+read_seek_index(const std::string &path, uint64_t file_size,
+                std::vector<seek_index_entry_t> *entries)
+{
+    entries->clear();
+    std::ifstream file(path, std::ifstream::binary);
+    if (!file)
+        return false;
+    seek_index_header_t header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        header.magic != SEEK_INDEX_MAGIC || header.version != SEEK_INDEX_VERSION ||
+        header.file_size != file_size)
+        return false;
+    // Guard the allocation against a corrupt count.
+    if (header.num_entries > file_size)
+        return false;
+    entries->resize(static_cast<size_t>(header.num_entries));
+    if (!file.read(reinterpret_cast<char *>(entries->data()),
+                   entries->size() * sizeof((*entries)[0]))) {
+        entries->clear();
+        return false;
+    }
+    for (size_t i = 1; i < entries->size(); ++i) {
+        if ((*entries)[i].offset <= (*entries)[i - 1].offset ||
+            (*entries)[i].offset >= file_size) {
+            entries->clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _SEEK_INDEX_H_ */
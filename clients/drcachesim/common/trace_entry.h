@@ -555,6 +555,25 @@ typedef enum {
      */
     TRACE_MARKER_TYPE_SYSCALL_FAILED,
 
+    /**
+     * Present in a trace sampled by the record_filter tool's -sample_window_instrs
+     * option.  It marks where instructions (along with their data references) were
+     * removed from the trace, and the marker value holds how many were removed.
+     * It is placed just before the first instruction after the removed region, or
+     * before the thread exit if the trace ends in such a region.  The instructions
+     * between this marker and the next #TRACE_MARKER_TYPE_SAMPLE_WINDOW are
+     * warmup for the window that follows.
+     */
+    TRACE_MARKER_TYPE_SAMPLE_SKIP,
+
+    /**
+     * Present in a trace sampled by the record_filter tool's -sample_window_instrs
+     * option.  It marks the start of a detailed window, which extends to the next
+     * #TRACE_MARKER_TYPE_SAMPLE_SKIP marker or to the end of the thread.  The marker
+     * value holds the ordinal of the window within its thread, starting at 0.
+     */
+    TRACE_MARKER_TYPE_SAMPLE_WINDOW,
+
     // ...
     // These values are reserved for future built-in marker types.
     // ...
@@ -0,0 +1,316 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* zstd_istream_t: a wrapper around zstd to match the parts of the
+ * std::istream interface we use for raw2trace and file_reader_t.  Reads the
+ * frame-indexed archives written by zstd_ostream_t (see zstd_seek_table.h).
+ * A background thread decompresses the frames following the current one, and
+ * the seek table lets readers jump straight to any component.
+ */
+
+#ifndef _ZSTD_ISTREAM_H_
+#define _ZSTD_ISTREAM_H_ 1
+
+#ifndef HAS_ZSTD
+#    error HAS_ZSTD is required
+#endif
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <zstd.h>
+
+#include "archive_istream.h"
+#include "zstd_seek_table.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+class zstd_istreambuf_t : public std::basic_streambuf<char, std::char_traits<char>> {
+public:
+    // "readahead" is the number of decompressed frames the background thread
+    // keeps ready beyond the one being read.
+    explicit zstd_istreambuf_t(const std::string &path, int readahead = 2)
+        : readahead_(readahead < 1 ? 1 : readahead)
+    {
+        fd_ = open(path.c_str(), O_RDONLY);
+        if (fd_ < 0)
+            return;
+        if (!read_seek_table()) {
+            close(fd_);
+            fd_ = -1;
+            return;
+        }
+        decoder_ = std::thread(&zstd_istreambuf_t::decode_frames, this);
+    }
+
+    ~zstd_istreambuf_t() override
+    {
+        if (decoder_.joinable()) {
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                exit_ = true;
+            }
+            cond_.notify_all();
+            decoder_.join();
+        }
+        if (fd_ >= 0)
+            close(fd_);
+    }
+
+    bool
+    is_open() const
+    {
+        return fd_ >= 0;
+    }
+
+    size_t
+    num_components() const
+    {
+        return components_.size();
+    }
+
+    // Repositions at the start of the component with index "index", in the
+    // order they were written.  Returns false if there is no such component.
+    bool
+    seek_component(size_t index)
+    {
+        if (index >= components_.size())
+            return false;
+        seek_frame(components_[index].second);
+        return true;
+    }
+
+    std::string
+    open_component(const std::string &name)
+    {
+        for (const auto &component : components_) {
+            if (component.first == name) {
+                seek_frame(component.second);
+                return "";
+            }
+        }
+        return "Failed to find component " + name;
+    }
+
+protected:
+    int
+    underflow() override
+    {
+        if (gptr() != egptr())
+            return traits_type::to_int_type(*gptr());
+        std::unique_lock<std::mutex> lock(mutex_);
+        // Skip any empty frames.
+        do {
+            if (next_read_ >= frames_.size())
+                return traits_type::eof();
+            cond_.wait(lock, [this] { return !ready_.empty(); });
+            cur_.swap(ready_.front().data);
+            bool error = ready_.front().error;
+            ready_.pop_front();
+            ++next_read_;
+            // Let the decoder refill the slot we just took.
+            cond_.notify_all();
+            if (error)
+                return traits_type::eof();
+        } while (cur_.empty());
+        setg(cur_.data(), cur_.data(), cur_.data() + cur_.size());
+        return traits_type::to_int_type(*gptr());
+    }
+
+    struct decoded_frame_t {
+        std::vector<char> data;
+        bool error = false;
+    };
+
+    bool
+    read_seek_table()
+    {
+        struct stat st;
+        zstd_seek_table_footer_t footer;
+        if (fstat(fd_, &st) != 0 ||
+            st.st_size < static_cast<off_t>(sizeof(footer) + 2 * sizeof(uint32_t)) ||
+            pread(fd_, &footer, sizeof(footer), st.st_size - sizeof(footer)) !=
+                static_cast<ssize_t>(sizeof(footer)) ||
+            footer.magic != ZSTD_ARCHIVE_TABLE_MAGIC ||
+            footer.table_size + 2 * sizeof(uint32_t) > static_cast<size_t>(st.st_size))
+            return false;
+        off_t table_start = st.st_size - footer.table_size;
+        uint32_t header[2];
+        if (pread(fd_, header, sizeof(header), table_start - sizeof(header)) !=
+                static_cast<ssize_t>(sizeof(header)) ||
+            header[0] != ZSTD_ARCHIVE_SKIPPABLE_MAGIC || header[1] != footer.table_size)
+            return false;
+        std::string payload(footer.table_size, '\0');
+        if (pread(fd_, &payload[0], payload.size(), table_start) !=
+                static_cast<ssize_t>(payload.size()) ||
+            !zstd_seek_table_parse(payload, footer, &frames_, &components_))
+            return false;
+        uint64_t offset = 0;
+        frame_offsets_.reserve(frames_.size());
+        for (const auto &frame : frames_) {
+            frame_offsets_.push_back(offset);
+            offset += frame.compressed_size;
+        }
+        return offset + sizeof(header) == static_cast<uint64_t>(table_start);
+    }
+
+    void
+    seek_frame(size_t frame)
+    {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            // Frames the decoder is working on now are dropped when it sees the
+            // generation has changed.
+            ++generation_;
+            ready_.clear();
+            next_decode_ = frame;
+            next_read_ = frame;
+        }
+        cond_.notify_all();
+        setg(nullptr, nullptr, nullptr);
+    }
+
+    void
+    decode_frames()
+    {
+        ZSTD_DCtx *dctx = ZSTD_createDCtx();
+        std::vector<char> src;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cond_.wait(lock, [this] {
+                return exit_ ||
+                    (ready_.size() < readahead_ && next_decode_ < frames_.size());
+            });
+            if (exit_)
+                break;
+            size_t index = next_decode_++;
+            uint64_t generation = generation_;
+            lock.unlock();
+            decoded_frame_t decoded;
+            const zstd_frame_entry_t &frame = frames_[index];
+            src.resize(frame.compressed_size);
+            decoded.data.resize(frame.decompressed_size);
+            if (dctx == nullptr ||
+                pread(fd_, src.data(), src.size(), frame_offsets_[index]) !=
+                    static_cast<ssize_t>(src.size())) {
+                decoded.error = true;
+            } else {
+                size_t res = ZSTD_decompressDCtx(dctx, decoded.data.data(),
+                                                 decoded.data.size(), src.data(),
+                                                 src.size());
+                decoded.error = ZSTD_isError(res) || res != decoded.data.size();
+            }
+            lock.lock();
+            if (generation == generation_) {
+                ready_.push_back(std::move(decoded));
+                cond_.notify_all();
+            }
+        }
+        ZSTD_freeDCtx(dctx);
+    }
+
+    int fd_ = -1;
+    const size_t readahead_;
+    std::vector<zstd_frame_entry_t> frames_;
+    std::vector<uint64_t> frame_offsets_;
+    std::vector<std::pair<std::string, uint32_t>> components_;
+    // The frame backing the get area.
+    std::vector<char> cur_;
+    // Fields below are shared with the decoder thread and guarded by mutex_.
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    // Decoded frames in order, starting with frame next_read_.
+    std::deque<decoded_frame_t> ready_;
+    size_t next_read_ = 0;
+    size_t next_decode_ = 0;
+    // Incremented on each seek to invalidate in-flight decodes.
+    uint64_t generation_ = 0;
+    bool exit_ = false;
+    std::thread decoder_;
+};
+
+class zstd_istream_t : public archive_istream_t {
+public:
+    explicit zstd_istream_t(const std::string &path)
+        : archive_istream_t(new zstd_istreambuf_t(path))
+    {
+        zstd_istreambuf_t *zbuf = reinterpret_cast<zstd_istreambuf_t *>(rdbuf());
+        if (zbuf == nullptr || !zbuf->is_open())
+            setstate(std::ios::failbit);
+    }
+    ~zstd_istream_t() override
+    {
+        delete rdbuf();
+    }
+    std::string
+    open_component(const std::string &name) override
+    {
+        zstd_istreambuf_t *zbuf = reinterpret_cast<zstd_istreambuf_t *>(rdbuf());
+        if (zbuf == nullptr)
+            return "Failed to access rdbuf";
+        std::string res = zbuf->open_component(name);
+        if (res.empty())
+            clear();
+        return res;
+    }
+    // Repositions at the start of the component with index "index".  Returns
+    // false if there is no such component.
+    bool
+    seek_component(size_t index)
+    {
+        zstd_istreambuf_t *zbuf = reinterpret_cast<zstd_istreambuf_t *>(rdbuf());
+        if (zbuf == nullptr || !zbuf->seek_component(index))
+            return false;
+        clear();
+        return true;
+    }
+    size_t
+    num_components()
+    {
+        zstd_istreambuf_t *zbuf = reinterpret_cast<zstd_istreambuf_t *>(rdbuf());
+        return zbuf == nullptr ? 0 : zbuf->num_components();
+    }
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _ZSTD_ISTREAM_H_ */
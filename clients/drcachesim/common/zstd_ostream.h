@@ -0,0 +1,174 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* zstd_ostream_t: a wrapper around zstd to match the parts of the
+ * std::ostream interface we use for raw2trace.  Data is written as a sequence
+ * of independent frames plus a trailing seek table (see zstd_seek_table.h)
+ * so that zstd_istream_t can jump to any component.
+ */
+
+#ifndef _ZSTD_OSTREAM_H_
+#define _ZSTD_OSTREAM_H_ 1
+
+#ifndef HAS_ZSTD
+#    error HAS_ZSTD is required
+#endif
+
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <zstd.h>
+
+#include "archive_ostream.h"
+#include "zstd_seek_table.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+class zstd_ostreambuf_t : public std::basic_streambuf<char, std::char_traits<char>> {
+public:
+    explicit zstd_ostreambuf_t(const std::string &path)
+        : file_(path, std::ofstream::binary)
+    {
+        cctx_ = ZSTD_createCCtx();
+        if (cctx_ == nullptr || !file_)
+            return;
+        src_buf_.resize(ZSTD_ARCHIVE_FRAME_BYTES);
+        dest_buf_.resize(ZSTD_compressBound(src_buf_.size()));
+        char *base = &src_buf_.front();
+        // Leave room for overflow()'s extra character.
+        setp(base, base + src_buf_.size() - 1);
+    }
+
+    ~zstd_ostreambuf_t() override
+    {
+        sync();
+        if (is_open()) {
+            std::string table = zstd_seek_table_serialize(frames_, components_);
+            file_.write(table.data(), table.size());
+        }
+        ZSTD_freeCCtx(cctx_);
+    }
+
+    bool
+    is_open() const
+    {
+        return cctx_ != nullptr && pbase() != nullptr && file_.good();
+    }
+
+    std::string
+    open_new_component(const std::string &name)
+    {
+        // Frames never span components, so each component can be decoded from
+        // its first frame.
+        if (sync() != 0)
+            return "Failed to compress prior component";
+        components_.emplace_back(name, static_cast<uint32_t>(frames_.size()));
+        return "";
+    }
+
+protected:
+    int
+    overflow(int extra_char) override
+    {
+        if (!is_open())
+            return traits_type::eof();
+        if (extra_char != traits_type::eof()) {
+            *pptr() = traits_type::to_char_type(extra_char);
+            pbump(1);
+        }
+        if (!write_frame())
+            return traits_type::eof();
+        return traits_type::not_eof(extra_char);
+    }
+
+    int
+    sync() override
+    {
+        return overflow(traits_type::eof()) == traits_type::eof() ? -1 : 0;
+    }
+
+    bool
+    write_frame()
+    {
+        size_t size = pptr() - pbase();
+        if (size == 0)
+            return true;
+        setp(pbase(), epptr());
+        size_t res = ZSTD_compressCCtx(cctx_, &dest_buf_.front(), dest_buf_.size(),
+                                       pbase(), size, ZSTD_CLEVEL_DEFAULT);
+        if (ZSTD_isError(res))
+            return false;
+        file_.write(&dest_buf_.front(), res);
+        zstd_frame_entry_t frame;
+        frame.compressed_size = static_cast<uint32_t>(res);
+        frame.decompressed_size = static_cast<uint32_t>(size);
+        frames_.push_back(frame);
+        return file_.good();
+    }
+
+    std::ofstream file_;
+    ZSTD_CCtx *cctx_ = nullptr;
+    std::vector<char> src_buf_;
+    std::vector<char> dest_buf_;
+    std::vector<zstd_frame_entry_t> frames_;
+    std::vector<std::pair<std::string, uint32_t>> components_;
+};
+
+class zstd_ostream_t : public archive_ostream_t {
+public:
+    explicit zstd_ostream_t(const std::string &path)
+        : archive_ostream_t(new zstd_ostreambuf_t(path))
+    {
+        zstd_ostreambuf_t *zbuf = reinterpret_cast<zstd_ostreambuf_t *>(rdbuf());
+        if (zbuf == nullptr || !zbuf->is_open())
+            setstate(std::ios::badbit);
+    }
+    ~zstd_ostream_t() override
+    {
+        delete rdbuf();
+    }
+    std::string
+    open_new_component(const std::string &name) override
+    {
+        zstd_ostreambuf_t *zbuf = reinterpret_cast<zstd_ostreambuf_t *>(rdbuf());
+        if (zbuf == nullptr)
+            return "Failed to access rdbuf";
+        return zbuf->open_new_component(name);
+    }
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _ZSTD_OSTREAM_H_ */
@@ -0,0 +1,149 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* zstd_seek_table: the layout shared by zstd_ostream_t and zstd_istream_t.
+ *
+ * A drmemtrace zstd archive is a sequence of independently decodable zstd
+ * frames, each holding at most ZSTD_ARCHIVE_FRAME_BYTES of uncompressed data
+ * from a single component, followed by a zstd skippable frame holding a seek
+ * table.  Standard zstd tools skip the table and decompress the concatenated
+ * components.  The table payload is, in order:
+ * + One zstd_frame_entry_t per data frame.
+ * + One component entry per component: its first frame index (uint32_t), its
+ *   name length (uint32_t), and its name bytes.
+ * + A zstd_seek_table_footer_t, which ends the file so that readers can locate
+ *   the table without scanning the frames.
+ * All integers are in host byte order, like the trace entries themselves.
+ */
+
+#ifndef _ZSTD_SEEK_TABLE_H_
+#define _ZSTD_SEEK_TABLE_H_ 1
+
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// Large enough for good compression, small enough that skipping to a point
+// inside a component rarely decompresses much unneeded data.
+static const uint32_t ZSTD_ARCHIVE_FRAME_BYTES = 512 * 1024;
+
+// The last of the 16 magic values zstd reserves for skippable frames.
+static const uint32_t ZSTD_ARCHIVE_SKIPPABLE_MAGIC = 0x184D2A5E;
+static const uint32_t ZSTD_ARCHIVE_TABLE_MAGIC = 0x5a53524d; // "MRSZ"
+
+struct zstd_frame_entry_t {
+    uint32_t compressed_size;
+    uint32_t decompressed_size;
+};
+
+struct zstd_seek_table_footer_t {
+    uint32_t num_frames;
+    uint32_t num_components;
+    // The size of the whole skippable frame payload, including this footer.
+    uint32_t table_size;
+    uint32_t magic;
+};
+
+// Serializes the skippable frame holding the seek table, including its
+// zstd skippable frame header.
+static inline std::string
+zstd_seek_table_serialize(const std::vector<zstd_frame_entry_t> &frames,
+                          const std::vector<std::pair<std::string, uint32_t>> &components)
+{
+    std::string payload;
+    auto append = [&payload](const void *data, size_t size) {
+        payload.append(reinterpret_cast<const char *>(data), size);
+    };
+    for (const auto &frame : frames)
+        append(&frame, sizeof(frame));
+    for (const auto &component : components) {
+        uint32_t name_len = static_cast<uint32_t>(component.first.size());
+        append(&component.second, sizeof(component.second));
+        append(&name_len, sizeof(name_len));
+        append(component.first.data(), name_len);
+    }
+    zstd_seek_table_footer_t footer;
+    footer.num_frames = static_cast<uint32_t>(frames.size());
+    footer.num_components = static_cast<uint32_t>(components.size());
+    footer.table_size = static_cast<uint32_t>(payload.size() + sizeof(footer));
+    footer.magic = ZSTD_ARCHIVE_TABLE_MAGIC;
+    append(&footer, sizeof(footer));
+    uint32_t header[2] = { ZSTD_ARCHIVE_SKIPPABLE_MAGIC, footer.table_size };
+    return std::string(reinterpret_cast<const char *>(header), sizeof(header)) +
+        payload;
+}
+
+// Parses a seek table payload (excluding the skippable frame header) whose
+// footer has already been read and checked.  Returns false if the table is
+// inconsistent.
+static inline bool
+zstd_seek_table_parse(const std::string &payload, const zstd_seek_table_footer_t &footer,
+                      std::vector<zstd_frame_entry_t> *frames,
+                      std::vector<std::pair<std::string, uint32_t>> *components)
+{
+    size_t pos = 0;
+    size_t end = payload.size() - sizeof(footer);
+    auto extract = [&payload, &pos, end](void *data, size_t size) {
+        if (end - pos < size)
+            return false;
+        payload.copy(reinterpret_cast<char *>(data), size, pos);
+        pos += size;
+        return true;
+    };
+    frames->resize(footer.num_frames);
+    for (auto &frame : *frames) {
+        if (!extract(&frame, sizeof(frame)))
+            return false;
+    }
+    components->clear();
+    for (uint32_t i = 0; i < footer.num_components; ++i) {
+        uint32_t first_frame, name_len;
+        if (!extract(&first_frame, sizeof(first_frame)) ||
+            !extract(&name_len, sizeof(name_len)) || end - pos < name_len ||
+            first_frame > footer.num_frames ||
+            (!components->empty() && first_frame < components->back().second))
+            return false;
+        components->emplace_back(payload.substr(pos, name_len), first_frame);
+        pos += name_len;
+    }
+    return pos == end;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _ZSTD_SEEK_TABLE_H_ */
@@ -32,13 +32,23 @@
 
 #include "compressed_file_reader.h"
 
+#include <fcntl.h>
+#include <inttypes.h>
 #include <zlib.h>
+#ifdef WINDOWS
+#    include <io.h>
+#else
+#    include <unistd.h>
+#endif
 
+#include <fstream>
 #include <memory>
+#include <queue>
 #include <string>
 
 #include "file_reader.h"
 #include "record_file_reader.h"
+#include "seek_index.h"
 #include "trace_entry.h"
 
 namespace dynamorio {
@@ -56,6 +66,40 @@ open_single_file_common(const std::string &path, gzFile &out)
     return out != nullptr;
 }
 
+// Opens "path" for decompression starting at "offset", which must be the start
+// of a gzip member.
+static gzFile
+open_at_offset(const std::string &path, uint64_t offset)
+{
+#ifdef WINDOWS
+    int fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+    if (fd < 0)
+        return nullptr;
+    if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) {
+        _close(fd);
+        return nullptr;
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    if (lseek(fd, static_cast<off_t>(offset), SEEK_SET) < 0) {
+        close(fd);
+        return nullptr;
+    }
+#endif
+    // zlib starts reading at the descriptor's current position.
+    gzFile file = gzdopen(fd, "rb");
+    if (file == nullptr) {
+#ifdef WINDOWS
+        _close(fd);
+#else
+        close(fd);
+#endif
+    }
+    return file;
+}
+
 trace_entry_t *
 read_next_entry_common(gzip_reader_t *gzip, bool *eof)
 {
@@ -107,7 +151,18 @@ file_reader_t<gzip_reader_t>::open_single_file(const std::string &path)
     if (!open_single_file_common(path, file))
         return false;
     VPRINT(this, 1, "Opened input file %s\n", path.c_str());
-    input_file_ = gzip_reader_t(file);
+    input_file_.file = file;
+    input_file_.cur_buf = input_file_.buf;
+    input_file_.max_buf = input_file_.buf;
+    input_file_.path = path;
+    std::ifstream size_query(path, std::ifstream::binary | std::ifstream::ate);
+    if (size_query &&
+        read_seek_index(path + DRMEMTRACE_SEEK_INDEX_SUFFIX,
+                        static_cast<uint64_t>(size_query.tellg()),
+                        &input_file_.seek_index)) {
+        VPRINT(this, 1, "Loaded seek index with %zu chunks\n",
+               input_file_.seek_index.size());
+    }
     return true;
 }
 
@@ -127,6 +182,51 @@ file_reader_t<gzip_reader_t>::read_next_entry()
     return &entry_copy_;
 }
 
+template <>
+reader_t &
+file_reader_t<gzip_reader_t>::skip_instructions(uint64_t instruction_count)
+{
+    gzip_reader_t *gzip = &input_file_;
+    // Without an index we can only decompress our way forward.
+    if (gzip->seek_index.empty() || instruction_count == 0)
+        return reader_t::skip_instructions(instruction_count);
+    VPRINT(this, 2, "Skipping %" PRIi64 " instrs\n", instruction_count);
+    if (!pre_skip_instructions())
+        return *this;
+    uint64_t stop_count = cur_instr_count_ + instruction_count + 1;
+    if (chunk_instr_count_ > 0) {
+        // First, jump to the start of the chunk containing the target, if that is
+        // past our current position.
+        uint64_t chunk = (stop_count - 1) / chunk_instr_count_;
+        if (chunk >= gzip->seek_index.size())
+            chunk = gzip->seek_index.size() - 1;
+        if (chunk * chunk_instr_count_ > cur_instr_count_) {
+            gzFile file = open_at_offset(gzip->path, gzip->seek_index[chunk].offset);
+            if (file == nullptr) {
+                VPRINT(this, 1, "Failed to seek to chunk %" PRIu64 "\n", chunk);
+                at_eof_ = true;
+                return *this;
+            }
+            gzclose(gzip->file);
+            gzip->file = file;
+            // Clear cached data from the prior chunk, including read-ahead records
+            // from a prior skip and any pending skip of the header we are about to
+            // read and count.
+            gzip->cur_buf = gzip->max_buf;
+            queue_ = std::queue<trace_entry_t>();
+            skip_chunk_header_.clear();
+            cur_instr_count_ = chunk * chunk_instr_count_;
+            VPRINT(this, 2, "At %" PRIi64 " instrs at start of chunk %" PRIu64 "\n",
+                   cur_instr_count_, chunk);
+        }
+    }
+    // Now do a linear walk the rest of the way, remembering timestamps (we have
+    // duplicated timestamps at the start of the chunk to cover any skipped in
+    // the jump we just did).
+    // Subtract 1 to pass the target instr itself.
+    return skip_instructions_with_timestamp(stop_count - 1);
+}
+
 /*********************************************************
  * gzip_reader_t specializations for record_file_reader_t.
  */
@@ -37,8 +37,12 @@
 
 #include <zlib.h>
 
+#include <string>
+#include <vector>
+
 #include "file_reader.h"
 #include "record_file_reader.h"
+#include "seek_index.h"
 #include "trace_entry.h"
 
 namespace dynamorio {
@@ -60,12 +64,23 @@ struct gzip_reader_t {
     trace_entry_t buf[4096];
     trace_entry_t *cur_buf = buf;
     trace_entry_t *max_buf = buf;
+    // The path and seek index (see seek_index.h) are used to jump to a chunk in
+    // skip_instructions().  The index is empty if there is none for the file.
+    std::string path;
+    std::vector<seek_index_entry_t> seek_index;
 };
 
 typedef file_reader_t<gzip_reader_t> compressed_file_reader_t;
 typedef dynamorio::drmemtrace::record_file_reader_t<gzip_reader_t>
     compressed_record_file_reader_t;
 
+/* Declare this so the compiler knows not to use the default implementation in the
+ * class declaration.
+ */
+template <>
+reader_t &
+file_reader_t<gzip_reader_t>::skip_instructions(uint64_t instruction_count);
+
 } // namespace drmemtrace
 } // namespace dynamorio
 
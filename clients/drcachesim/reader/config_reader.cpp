@@ -171,6 +171,69 @@ config_reader_t::configure(std::istream *config_file, cache_simulator_knobs_t &k
             } else {
                 knobs.use_physical = false;
             }
+        } else if (param == "parallel_cores") {
+            // Whether to simulate cores in parallel for core-sharded analysis.
+            std::string bool_val;
+            if (!(*fin_ >> bool_val)) {
+                ERRMSG("Error reading parallel_cores from the configuration file\n");
+                return false;
+            }
+            if (is_true(bool_val)) {
+                knobs.parallel_cores = true;
+            } else {
+                knobs.parallel_cores = false;
+            }
+        } else if (param == "timing") {
+            // Whether to model the timing of accesses.
+            std::string bool_val;
+            if (!(*fin_ >> bool_val)) {
+                ERRMSG("Error reading timing from the configuration file\n");
+                return false;
+            }
+            if (is_true(bool_val)) {
+                knobs.timing = true;
+            } else {
+                knobs.timing = false;
+            }
+        } else if (param == "rob_size") {
+            // Instructions a load may be overtaken by under timing.
+            if (!(*fin_ >> knobs.rob_size)) {
+                ERRMSG("Error reading rob_size from the configuration file\n");
+                return false;
+            }
+        } else if (param == "dram_banks") {
+            // Number of DRAM banks under timing.
+            if (!(*fin_ >> knobs.dram_banks)) {
+                ERRMSG("Error reading dram_banks from the configuration file\n");
+                return false;
+            }
+        } else if (param == "dram_bytes_per_cycle") {
+            // DRAM data bus bytes per cycle under timing.
+            if (!(*fin_ >> knobs.dram_bytes_per_cycle)) {
+                ERRMSG("Error reading dram_bytes_per_cycle from "
+                       "the configuration file\n");
+                return false;
+            }
+        } else if (param == "dram_row_hit_latency") {
+            // DRAM latency of an open row access under timing.
+            if (!(*fin_ >> knobs.dram_row_hit_latency)) {
+                ERRMSG("Error reading dram_row_hit_latency from "
+                       "the configuration file\n");
+                return false;
+            }
+        } else if (param == "dram_row_miss_latency") {
+            // DRAM latency of a closed row access under timing.
+            if (!(*fin_ >> knobs.dram_row_miss_latency)) {
+                ERRMSG("Error reading dram_row_miss_latency from "
+                       "the configuration file\n");
+                return false;
+            }
+        } else if (param == "timing_interval") {
+            // Cycles per interval of timing results.
+            if (!(*fin_ >> knobs.timing_interval)) {
+                ERRMSG("Error reading timing_interval from the configuration file\n");
+                return false;
+            }
         } else {
             // A cache unit.
             cache_params_t cache;
@@ -292,7 +355,9 @@ config_reader_t::configure_cache(cache_params_t &cache)
             }
         } else if (param == "replace_policy") {
             // Cache replacement policy: REPLACE_POLICY_LRU (default),
-            // REPLACE_POLICY_LFU or REPLACE_POLICY_FIFO.
+            // REPLACE_POLICY_LFU, REPLACE_POLICY_FIFO, REPLACE_POLICY_PLRU,
+            // REPLACE_POLICY_SRRIP, REPLACE_POLICY_BRRIP, REPLACE_POLICY_DRRIP,
+            // or REPLACE_POLICY_SHIP.
             if (!(*fin_ >> cache.replace_policy)) {
                 ERRMSG("Error reading cache replace_policy from "
                        "the configuration file\n");
@@ -301,7 +366,12 @@ config_reader_t::configure_cache(cache_params_t &cache)
             if (cache.replace_policy != REPLACE_POLICY_NON_SPECIFIED &&
                 cache.replace_policy != REPLACE_POLICY_LRU &&
                 cache.replace_policy != REPLACE_POLICY_LFU &&
-                cache.replace_policy != REPLACE_POLICY_FIFO) {
+                cache.replace_policy != REPLACE_POLICY_FIFO &&
+                cache.replace_policy != REPLACE_POLICY_PLRU &&
+                cache.replace_policy != REPLACE_POLICY_SRRIP &&
+                cache.replace_policy != REPLACE_POLICY_BRRIP &&
+                cache.replace_policy != REPLACE_POLICY_DRRIP &&
+                cache.replace_policy != REPLACE_POLICY_SHIP) {
                 ERRMSG("Unknown replacement policy: %s\n", cache.replace_policy.c_str());
                 return false;
             }
@@ -318,6 +388,20 @@ config_reader_t::configure_cache(cache_params_t &cache)
                 ERRMSG("Unknown prefetcher type: %s\n", cache.prefetcher.c_str());
                 return false;
             }
+        } else if (param == "latency") {
+            // Cycles per hit under timing.
+            if (!(*fin_ >> cache.latency) || cache.latency < 0) {
+                ERRMSG("Error reading cache latency from "
+                       "the configuration file\n");
+                return false;
+            }
+        } else if (param == "mshrs") {
+            // Outstanding misses under timing, where 0 means unlimited.
+            if (!(*fin_ >> cache.mshrs) || cache.mshrs < 0) {
+                ERRMSG("Error reading cache mshrs from "
+                       "the configuration file\n");
+                return false;
+            }
         } else if (param == "miss_file") {
             // Name of the file to use to dump cache misses info.
             if (!(*fin_ >> cache.miss_file)) {
@@ -63,6 +63,8 @@ struct cache_params_t {
         , replace_policy(REPLACE_POLICY_LRU)
         , prefetcher(PREFETCH_POLICY_NONE)
         , miss_file("")
+        , latency(-1)
+        , mshrs(-1)
     {
     }
     // Cache's name. Each cache must have a unique name.
@@ -92,6 +94,11 @@ struct cache_params_t {
     std::string prefetcher;
     // Name of the file to use to dump cache misses info.
     std::string miss_file;
+    // Cycles per hit and the number of outstanding misses when modeling timing.
+    // If negative, the L1 or last-level knob applies depending on whether the
+    // cache has a core.
+    int latency;
+    int mshrs;
 };
 
 class config_reader_t {
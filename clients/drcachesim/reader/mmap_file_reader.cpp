@@ -0,0 +1,220 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "mmap_file_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+
+#include "file_reader.h"
+#include "record_file_reader.h"
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+/**************************************************************************
+ * Common logic used in the mmap_reader_t specializations for file_reader_t
+ * and record_file_reader_t.
+ */
+
+namespace {
+
+// How far ahead of the current entry we ask the kernel to read.  Together with
+// MADV_SEQUENTIAL, which doubles the kernel's own read-ahead and lets it drop
+// pages behind us, this keeps the reader from stalling on page faults.
+constexpr size_t PREFETCH_BYTES = 8 * 1024 * 1024;
+
+void
+close_common(mmap_reader_t *reader)
+{
+    if (reader->map_base != nullptr) {
+        munmap(reader->map_base, reader->map_size);
+        reader->map_base = nullptr;
+    }
+    reader->map_size = 0;
+    reader->cur = nullptr;
+    reader->end = nullptr;
+    reader->prefetch_end = nullptr;
+}
+
+bool
+open_single_file_common(const std::string &path, mmap_reader_t *reader)
+{
+    // Any file opened before is replaced.
+    close_common(reader);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        // mmap rejects an empty length, and an empty file is simply at its end,
+        // as with a stream read.
+        close(fd);
+        return true;
+    }
+    void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    madvise(map, size, MADV_SEQUENTIAL);
+    reader->map_base = static_cast<char *>(map);
+    reader->map_size = size;
+    reader->cur = reinterpret_cast<trace_entry_t *>(reader->map_base);
+    // A trailing partial entry is treated as the end of the file, as with a failed
+    // istream read.
+    reader->end = reader->cur + size / sizeof(trace_entry_t);
+    reader->prefetch_end = reader->map_base;
+    return true;
+}
+
+trace_entry_t *
+read_next_entry_common(mmap_reader_t *reader, bool *eof)
+{
+    if (reader->cur >= reader->end) {
+        *eof = true;
+        return nullptr;
+    }
+    // Once we are halfway through the region being read ahead, request the next.
+    char *map_end = reader->map_base + reader->map_size;
+    if (reader->prefetch_end < map_end &&
+        reinterpret_cast<char *>(reader->cur) + PREFETCH_BYTES / 2 >=
+            reader->prefetch_end) {
+        size_t len = PREFETCH_BYTES;
+        if (static_cast<size_t>(map_end - reader->prefetch_end) < len)
+            len = map_end - reader->prefetch_end;
+        // The region start stays page-aligned as the stride is a page multiple.
+        madvise(reader->prefetch_end, len, MADV_WILLNEED);
+        reader->prefetch_end += len;
+    }
+    return reader->cur++;
+}
+
+} // namespace
+
+/**************************************************
+ * mmap_reader_t specializations for file_reader_t.
+ */
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<mmap_reader_t>::file_reader_t()
+{
+}
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<mmap_reader_t>::~file_reader_t<mmap_reader_t>()
+{
+    close_common(&input_file_);
+}
+
+template <>
+bool
+file_reader_t<mmap_reader_t>::open_single_file(const std::string &path)
+{
+    if (!open_single_file_common(path, &input_file_))
+        return false;
+    VPRINT(this, 1, "Mapped input file %s\n", path.c_str());
+    return true;
+}
+
+template <>
+trace_entry_t *
+file_reader_t<mmap_reader_t>::read_next_entry()
+{
+    trace_entry_t *entry = read_queued_entry();
+    if (entry != nullptr)
+        return entry;
+    // We return the entry in place rather than copying it to entry_copy_.
+    entry = read_next_entry_common(&input_file_, &at_eof_);
+    if (entry == nullptr)
+        return entry;
+    VPRINT(this, 4, "Read from file: type=%s (%d), size=%d, addr=%zu\n",
+           trace_type_names[entry->type], entry->type, entry->size, entry->addr);
+    return entry;
+}
+
+/*********************************************************
+ * mmap_reader_t specializations for record_file_reader_t.
+ */
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+record_file_reader_t<mmap_reader_t>::~record_file_reader_t<mmap_reader_t>()
+{
+    if (input_file_ != nullptr)
+        close_common(input_file_.get());
+}
+
+template <>
+bool
+record_file_reader_t<mmap_reader_t>::open_single_file(const std::string &path)
+{
+    if (input_file_ == nullptr)
+        input_file_.reset(new mmap_reader_t);
+    if (!open_single_file_common(path, input_file_.get()))
+        return false;
+    VPRINT(this, 1, "Mapped input file %s\n", path.c_str());
+    return true;
+}
+
+template <>
+bool
+record_file_reader_t<mmap_reader_t>::read_next_entry()
+{
+    trace_entry_t *entry = read_next_entry_common(input_file_.get(), &eof_);
+    if (entry == nullptr)
+        return false;
+    cur_entry_ = *entry;
+    VPRINT(this, 4, "Read from file: type=%s (%d), size=%d, addr=%zu\n",
+           trace_type_names[cur_entry_.type], cur_entry_.type, cur_entry_.size,
+           cur_entry_.addr);
+    return true;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -0,0 +1,68 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* mmap_file_reader: reads uncompressed files containing memory traces by mapping
+ * them into memory and handing out entries in place, avoiding the copy through
+ * istream buffers.
+ */
+
+#ifndef _MMAP_FILE_READER_H_
+#define _MMAP_FILE_READER_H_ 1
+
+#include <stddef.h>
+
+#include "file_reader.h"
+#include "record_file_reader.h"
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+struct mmap_reader_t {
+    // The whole file is mapped privately and writably: reader_t updates some
+    // entries in place, which must not reach the file.
+    char *map_base = nullptr;
+    size_t map_size = 0;
+    trace_entry_t *cur = nullptr;
+    trace_entry_t *end = nullptr;
+    // The end of the region we have asked the kernel to read ahead.
+    char *prefetch_end = nullptr;
+};
+
+typedef file_reader_t<mmap_reader_t> mmap_file_reader_t;
+typedef dynamorio::drmemtrace::record_file_reader_t<mmap_reader_t>
+    mmap_record_file_reader_t;
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _MMAP_FILE_READER_H_ */
@@ -0,0 +1,207 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "zstd_file_reader.h"
+
+#include <inttypes.h>
+
+namespace dynamorio {
+namespace drmemtrace {
+
+namespace {
+
+trace_entry_t *
+read_next_entry_common(zstd_reader_t *reader, bool *eof)
+{
+    if (reader->cur_buf >= reader->max_buf) {
+        int len = reader->file
+                      ->read(reinterpret_cast<char *>(&reader->buf), sizeof(reader->buf))
+                      .gcount();
+        if (len < static_cast<int>(sizeof(trace_entry_t)) ||
+            len % static_cast<int>(sizeof(trace_entry_t)) != 0) {
+            *eof = (len >= 0);
+            return nullptr;
+        }
+        reader->cur_buf = reader->buf;
+        reader->max_buf = reader->buf + (len / sizeof(trace_entry_t));
+    }
+    trace_entry_t *res = reader->cur_buf;
+    ++reader->cur_buf;
+    return res;
+}
+
+zstd_istream_t *
+open_single_file_common(const std::string &path)
+{
+    zstd_istream_t *file = new zstd_istream_t(path);
+    if (!*file) {
+        delete file;
+        return nullptr;
+    }
+    return file;
+}
+
+} // namespace
+
+/**************************************************
+ * zstd_reader_t specializations for file_reader_t.
+ */
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<zstd_reader_t>::file_reader_t()
+{
+    input_file_.file = nullptr;
+}
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<zstd_reader_t>::~file_reader_t<zstd_reader_t>()
+{
+    if (input_file_.file != nullptr) {
+        delete input_file_.file;
+        input_file_.file = nullptr;
+    }
+}
+
+template <>
+bool
+file_reader_t<zstd_reader_t>::open_single_file(const std::string &path)
+{
+    zstd_istream_t *file = open_single_file_common(path);
+    if (file == nullptr)
+        return false;
+    VPRINT(this, 1, "Opened input file %s\n", path.c_str());
+    input_file_.file = file;
+    return true;
+}
+
+template <>
+trace_entry_t *
+file_reader_t<zstd_reader_t>::read_next_entry()
+{
+    trace_entry_t *entry = read_queued_entry();
+    if (entry != nullptr)
+        return entry;
+    entry = read_next_entry_common(&input_file_, &at_eof_);
+    if (entry == nullptr)
+        return entry;
+    VPRINT(this, 4, "Read from file: type=%s (%d), size=%d, addr=%zu\n",
+           trace_type_names[entry->type], entry->type, entry->size, entry->addr);
+    entry_copy_ = *entry;
+    return &entry_copy_;
+}
+
+template <>
+reader_t &
+file_reader_t<zstd_reader_t>::skip_instructions(uint64_t instruction_count)
+{
+    zstd_reader_t *zstd = &input_file_;
+    if (instruction_count == 0 || zstd->file->num_components() == 0)
+        return reader_t::skip_instructions(instruction_count);
+    VPRINT(this, 2, "Skipping %" PRIi64 " instrs\n", instruction_count);
+    if (!pre_skip_instructions())
+        return *this;
+    uint64_t stop_count = cur_instr_count_ + instruction_count + 1;
+    if (chunk_instr_count_ > 0) {
+        // First, jump to the start of the chunk containing the target, if that is
+        // past our current position.  Each chunk is its own archive component.
+        uint64_t chunk = (stop_count - 1) / chunk_instr_count_;
+        if (chunk >= zstd->file->num_components())
+            chunk = zstd->file->num_components() - 1;
+        if (chunk * chunk_instr_count_ > cur_instr_count_) {
+            if (!zstd->file->seek_component(chunk)) {
+                VPRINT(this, 1, "Failed to seek to chunk %" PRIu64 "\n", chunk);
+                at_eof_ = true;
+                return *this;
+            }
+            // Clear cached data from the prior chunk, including read-ahead records
+            // from a prior skip and any pending skip of the header we are about to
+            // read and count.
+            zstd->cur_buf = zstd->max_buf;
+            queue_ = std::queue<trace_entry_t>();
+            skip_chunk_header_.clear();
+            cur_instr_count_ = chunk * chunk_instr_count_;
+            VPRINT(this, 2, "At %" PRIi64 " instrs at start of chunk %" PRIu64 "\n",
+                   cur_instr_count_, chunk);
+        }
+    }
+    // Now do a linear walk the rest of the way, remembering timestamps (we have
+    // duplicated timestamps at the start of the chunk to cover any skipped in
+    // the jump we just did).
+    // Subtract 1 to pass the target instr itself.
+    return skip_instructions_with_timestamp(stop_count - 1);
+}
+
+/*********************************************************
+ * zstd_reader_t specializations for record_file_reader_t.
+ */
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+record_file_reader_t<zstd_reader_t>::~record_file_reader_t<zstd_reader_t>()
+{
+    if (input_file_ != nullptr)
+        delete input_file_->file;
+}
+
+template <>
+bool
+record_file_reader_t<zstd_reader_t>::open_single_file(const std::string &path)
+{
+    zstd_istream_t *file = open_single_file_common(path);
+    if (file == nullptr)
+        return false;
+    VPRINT(this, 1, "Opened input file %s\n", path.c_str());
+    input_file_ = std::unique_ptr<zstd_reader_t>(new zstd_reader_t(file));
+    return true;
+}
+
+template <>
+bool
+record_file_reader_t<zstd_reader_t>::read_next_entry()
+{
+    trace_entry_t *entry = read_next_entry_common(input_file_.get(), &eof_);
+    if (entry == nullptr)
+        return false;
+    cur_entry_ = *entry;
+    VPRINT(this, 4, "Read from file: type=%s (%d), size=%d, addr=%zu\n",
+           trace_type_names[cur_entry_.type], cur_entry_.type, cur_entry_.size,
+           cur_entry_.addr);
+    return true;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
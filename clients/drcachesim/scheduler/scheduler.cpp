@@ -53,6 +53,7 @@
 #include "memtrace_stream.h"
 #include "reader.h"
 #include "record_file_reader.h"
+#include "seek_index.h"
 #include "trace_entry.h"
 #ifdef HAS_LZ4
 #    include "lz4_file_reader.h"
@@ -68,6 +69,12 @@
 #ifdef HAS_SNAPPY
 #    include "snappy_file_reader.h"
 #endif
+#ifdef HAS_MMAP
+#    include "mmap_file_reader.h"
+#endif
+#ifdef HAS_ZSTD
+#    include "zstd_file_reader.h"
+#endif
 #include "directory_iterator.h"
 #include "utils.h"
 #ifdef UNIX
@@ -126,12 +133,21 @@ template <>
 std::unique_ptr<reader_t>
 scheduler_tmpl_t<memref_t, reader_t>::get_reader(const std::string &path, int verbosity)
 {
-#if defined(HAS_SNAPPY) || defined(HAS_ZIP) || defined(HAS_LZ4)
+#ifdef HAS_MMAP
+    // Uncompressed files are mapped, which avoids copying each record.
+    if (ends_with(path, ".trace"))
+        return std::unique_ptr<reader_t>(new mmap_file_reader_t(path, verbosity));
+#endif
+#if defined(HAS_SNAPPY) || defined(HAS_ZIP) || defined(HAS_LZ4) || defined(HAS_ZSTD)
 #    ifdef HAS_LZ4
     if (ends_with(path, ".lz4")) {
         return std::unique_ptr<reader_t>(new lz4_file_reader_t(path, verbosity));
     }
 #    endif
+#    ifdef HAS_ZSTD
+    if (ends_with(path, ".zst"))
+        return std::unique_ptr<reader_t>(new zstd_file_reader_t(path, verbosity));
+#    endif
 #    ifdef HAS_SNAPPY
     if (ends_with(path, ".sz"))
         return std::unique_ptr<reader_t>(new snappy_file_reader_t(path, verbosity));
@@ -158,7 +174,8 @@ scheduler_tmpl_t<memref_t, reader_t>::get_reader(const std::string &path, int ve
             // Skip the auxiliary files.
             if (fname == DRMEMTRACE_MODULE_LIST_FILENAME ||
                 fname == DRMEMTRACE_FUNCTION_LIST_FILENAME ||
-                fname == DRMEMTRACE_ENCODING_FILENAME)
+                fname == DRMEMTRACE_ENCODING_FILENAME ||
+                ends_with(fname, DRMEMTRACE_SEEK_INDEX_SUFFIX))
                 continue;
 #    ifdef HAS_SNAPPY
             if (ends_with(*iter, ".sz")) {
@@ -176,6 +193,12 @@ scheduler_tmpl_t<memref_t, reader_t>::get_reader(const std::string &path, int ve
             if (ends_with(path, ".lz4")) {
                 return std::unique_ptr<reader_t>(new lz4_file_reader_t(path, verbosity));
             }
+#    endif
+#    ifdef HAS_ZSTD
+            if (ends_with(*iter, ".zst")) {
+                return std::unique_ptr<reader_t>(
+                    new zstd_file_reader_t(path, verbosity));
+            }
 #    endif
         }
     }
@@ -227,6 +250,13 @@ scheduler_tmpl_t<memref_t, reader_t>::record_type_is_timestamp(memref_t record,
     return true;
 }
 
+template <>
+bool
+scheduler_tmpl_t<memref_t, reader_t>::record_type_is_thread_exit(memref_t record)
+{
+    return record.exit.type == TRACE_TYPE_THREAD_EXIT;
+}
+
 template <>
 bool
 scheduler_tmpl_t<memref_t, reader_t>::record_type_is_invalid(memref_t record)
@@ -303,6 +333,18 @@ scheduler_tmpl_t<trace_entry_t, record_reader_t>::get_reader(const std::string &
     // .zip files.
     if (ends_with(path, ".sz") || ends_with(path, ".zip"))
         return nullptr;
+#ifdef HAS_MMAP
+    if (ends_with(path, ".trace")) {
+        return std::unique_ptr<dynamorio::drmemtrace::record_reader_t>(
+            new mmap_record_file_reader_t(path, verbosity));
+    }
+#endif
+#ifdef HAS_ZSTD
+    if (ends_with(path, ".zst")) {
+        return std::unique_ptr<dynamorio::drmemtrace::record_reader_t>(
+            new zstd_record_file_reader_t(path, verbosity));
+    }
+#endif
     return std::unique_ptr<dynamorio::drmemtrace::record_reader_t>(
         new default_record_file_reader_t(path, verbosity));
 }
@@ -350,6 +392,16 @@ scheduler_tmpl_t<trace_entry_t, record_reader_t>::record_type_is_timestamp(
     return true;
 }
 
+template <>
+bool
+scheduler_tmpl_t<trace_entry_t, record_reader_t>::record_type_is_thread_exit(
+    trace_entry_t record)
+{
+    // The footer follows the exit record and is what ends the thread for the
+    // record-oriented analyzer.
+    return record.type == TRACE_TYPE_THREAD_EXIT || record.type == TRACE_TYPE_FOOTER;
+}
+
 template <>
 bool
 scheduler_tmpl_t<trace_entry_t, record_reader_t>::record_type_is_invalid(
@@ -465,6 +517,43 @@ scheduler_tmpl_t<RecordType, ReaderType>::stream_t::next_record(RecordType &reco
     return sched_type_t::STATUS_OK;
 }
 
+template <typename RecordType, typename ReaderType>
+typename scheduler_tmpl_t<RecordType, ReaderType>::stream_status_t
+scheduler_tmpl_t<RecordType, ReaderType>::stream_t::next_record_batch(
+    RecordType *records, size_t max_count, size_t &count, uint64_t cur_time)
+{
+    count = 0;
+    if (pending_batch_status_ != sched_type_t::STATUS_OK) {
+        sched_type_t::stream_status_t res = pending_batch_status_;
+        pending_batch_status_ = sched_type_t::STATUS_OK;
+        return res;
+    }
+    auto &outinfo = scheduler_->outputs_[ordinal_];
+    while (count < max_count) {
+        outinfo.stop_before_switch = count > 0;
+        // We call our own implementation directly to avoid a virtual call per record.
+        sched_type_t::stream_status_t res =
+            stream_t::next_record(records[count], cur_time);
+        if (res != sched_type_t::STATUS_OK) {
+            if (outinfo.stopped_before_switch) {
+                outinfo.stopped_before_switch = false;
+                break;
+            }
+            if (count == 0)
+                return res;
+            pending_batch_status_ = res;
+            break;
+        }
+        const RecordType &record = records[count++];
+        uintptr_t timestamp;
+        if (scheduler_->record_type_is_timestamp(record, timestamp) ||
+            scheduler_->record_type_is_thread_exit(record))
+            break;
+    }
+    outinfo.stop_before_switch = false;
+    return sched_type_t::STATUS_OK;
+}
+
 template <typename RecordType, typename ReaderType>
 typename scheduler_tmpl_t<RecordType, ReaderType>::stream_status_t
 scheduler_tmpl_t<RecordType, ReaderType>::stream_t::unread_last_record()
@@ -612,6 +701,9 @@ scheduler_tmpl_t<RecordType, ReaderType>::init(
         static_cast<int>(options_.flags) |
         static_cast<int>(sched_type_t::SCHEDULER_SPECULATE_NOPS));
 
+    int queue_count = local_ready_queues() ? output_count : 1;
+    for (int i = 0; i < queue_count; ++i)
+        ready_queues_.emplace_back(new ready_queue_t);
     outputs_.reserve(output_count);
     for (int i = 0; i < output_count; ++i) {
         outputs_.emplace_back(this, i,
@@ -733,12 +825,18 @@ scheduler_tmpl_t<RecordType, ReaderType>::set_initial_schedule(
             // base_timestamp, which our queue does for us.  We want the rest of the
             // inputs in the queue in any case so it is simplest to insert all and
             // remove the first N rather than sorting the first N separately.
+            // With local queues we sort in a staging queue and then deal out the
+            // rest in sorted order across the outputs' queues.
+            ready_queue_t staging;
+            ready_queue_t &initial = local_ready_queues() ? staging : *ready_queues_[0];
             for (int i = 0; i < static_cast<input_ordinal_t>(inputs_.size()); ++i) {
-                add_to_ready_queue(&inputs_[i]);
+                inputs_[i].queue_counter = ++ready_counter_;
+                initial.queue.push(&inputs_[i]);
             }
+            initial.size.store(initial.queue.size(), std::memory_order_relaxed);
             for (int i = 0; i < static_cast<output_ordinal_t>(outputs_.size()); ++i) {
                 if (i < static_cast<input_ordinal_t>(inputs_.size())) {
-                    input_info_t *queue_next = pop_from_ready_queue(i);
+                    input_info_t *queue_next = pop_from_queue(initial, i);
                     if (queue_next == nullptr)
                         set_cur_input(i, INVALID_INPUT_ORDINAL);
                     else
@@ -746,6 +844,13 @@ scheduler_tmpl_t<RecordType, ReaderType>::set_initial_schedule(
                 } else
                     set_cur_input(i, INVALID_INPUT_ORDINAL);
             }
+            output_ordinal_t output_count =
+                static_cast<output_ordinal_t>(outputs_.size());
+            for (int i = 0; !staging.queue.empty(); ++i) {
+                input_info_t *input = staging.queue.top();
+                staging.queue.pop();
+                add_to_ready_queue(input, i % output_count);
+            }
         } else {
             // Just take the 1st N inputs (even if all from the same workload).
             for (int i = 0; i < static_cast<output_ordinal_t>(outputs_.size()); ++i) {
@@ -756,7 +861,8 @@ scheduler_tmpl_t<RecordType, ReaderType>::set_initial_schedule(
             }
             for (int i = static_cast<output_ordinal_t>(outputs_.size());
                  i < static_cast<input_ordinal_t>(inputs_.size()); ++i) {
-                add_to_ready_queue(&inputs_[i]);
+                add_to_ready_queue(&inputs_[i],
+                                   i % static_cast<output_ordinal_t>(outputs_.size()));
             }
         }
     }
@@ -1223,7 +1329,8 @@ scheduler_tmpl_t<RecordType, ReaderType>::open_readers(
         // Skip the auxiliary files.
         if (fname == DRMEMTRACE_MODULE_LIST_FILENAME ||
             fname == DRMEMTRACE_FUNCTION_LIST_FILENAME ||
-            fname == DRMEMTRACE_ENCODING_FILENAME)
+            fname == DRMEMTRACE_ENCODING_FILENAME ||
+            ends_with(fname, DRMEMTRACE_SEEK_INDEX_SUFFIX))
             continue;
         const std::string file = path + DIRSEP + fname;
         sched_type_t::scheduler_status_t res =
@@ -1515,53 +1622,101 @@ template <typename RecordType, typename ReaderType>
 bool
 scheduler_tmpl_t<RecordType, ReaderType>::ready_queue_empty()
 {
-    return ready_priority_.empty();
+    for (auto &ready : ready_queues_) {
+        std::lock_guard<std::mutex> lock(ready->lock);
+        if (!ready->queue.empty())
+            return false;
+    }
+    return true;
 }
 
 template <typename RecordType, typename ReaderType>
 void
-scheduler_tmpl_t<RecordType, ReaderType>::add_to_ready_queue(input_info_t *input)
-{
-    VPRINT(
-        this, 4,
-        "add_to_ready_queue (pre-size %zu): input %d priority %d timestamp delta %" PRIu64
-        "\n",
-        ready_priority_.size(), input->index, input->priority,
-        input->reader->get_last_timestamp() - input->base_timestamp);
+scheduler_tmpl_t<RecordType, ReaderType>::add_to_ready_queue(input_info_t *input,
+                                                             output_ordinal_t from_output)
+{
+    output_ordinal_t target = 0;
+    if (local_ready_queues()) {
+        target = from_output;
+        // Keep bound inputs on a queue of an output that can run them so that only
+        // a steal from an unbound output has to skip past them.
+        if (!input->binding.empty() &&
+            input->binding.find(target) == input->binding.end())
+            target = *input->binding.begin();
+    }
+    ready_queue_t &ready = *ready_queues_[target];
+    std::lock_guard<std::mutex> lock(ready.lock);
+    VPRINT(this, 4,
+           "add_to_ready_queue[%d] (pre-size %zu): input %d priority %d timestamp "
+           "delta %" PRIu64 "\n",
+           target, ready.queue.size(), input->index, input->priority,
+           input->reader->get_last_timestamp() - input->base_timestamp);
     input->queue_counter = ++ready_counter_;
-    ready_priority_.push(input);
+    ready.queue.push(input);
+    ready.size.store(ready.queue.size(), std::memory_order_relaxed);
 }
 
 template <typename RecordType, typename ReaderType>
 typename scheduler_tmpl_t<RecordType, ReaderType>::input_info_t *
-scheduler_tmpl_t<RecordType, ReaderType>::pop_from_ready_queue(
-    output_ordinal_t for_output)
+scheduler_tmpl_t<RecordType, ReaderType>::pop_from_queue(ready_queue_t &ready,
+                                                         output_ordinal_t for_output)
 {
     std::set<input_info_t *> skipped;
     input_info_t *res = nullptr;
-    do {
-        res = ready_priority_.top();
-        ready_priority_.pop();
+    while (!ready.queue.empty()) {
+        res = ready.queue.top();
+        ready.queue.pop();
         if (res->binding.empty() || res->binding.find(for_output) != res->binding.end())
             break;
         // We keep searching for a suitable input.
         skipped.insert(res);
         res = nullptr;
-    } while (!ready_priority_.empty());
+    }
     // Re-add the ones we skipped, but without changing their counters so we preserve
     // the prior FIFO order.
     for (input_info_t *save : skipped)
-        ready_priority_.push(save);
+        ready.queue.push(save);
+    ready.size.store(ready.queue.size(), std::memory_order_relaxed);
     if (res != nullptr) {
         VPRINT(this, 4,
                "pop_from_ready_queue[%d] (post-size %zu): input %d priority %d timestamp "
                "delta %" PRIu64 "\n",
-               for_output, ready_priority_.size(), res->index, res->priority,
+               for_output, ready.queue.size(), res->index, res->priority,
                res->reader->get_last_timestamp() - res->base_timestamp);
     }
     return res;
 }
 
+template <typename RecordType, typename ReaderType>
+typename scheduler_tmpl_t<RecordType, ReaderType>::input_info_t *
+scheduler_tmpl_t<RecordType, ReaderType>::pop_from_ready_queue(
+    output_ordinal_t for_output)
+{
+    if (!local_ready_queues()) {
+        std::lock_guard<std::mutex> lock(ready_queues_[0]->lock);
+        return pop_from_queue(*ready_queues_[0], for_output);
+    }
+    // Try our own queue first and then steal from the others, starting with our
+    // neighbor to spread out the contention.
+    output_ordinal_t count = static_cast<output_ordinal_t>(ready_queues_.size());
+    for (output_ordinal_t i = 0; i < count; ++i) {
+        output_ordinal_t victim = (for_output + i) % count;
+        ready_queue_t &ready = *ready_queues_[victim];
+        if (ready.size.load(std::memory_order_relaxed) == 0)
+            continue;
+        std::lock_guard<std::mutex> lock(ready.lock);
+        input_info_t *res = pop_from_queue(ready, for_output);
+        if (res != nullptr) {
+            if (victim != for_output) {
+                VPRINT(this, 3, "pop_from_ready_queue[%d]: stole input %d from %d\n",
+                       for_output, res->index, victim);
+            }
+            return res;
+        }
+    }
+    return nullptr;
+}
+
 template <typename RecordType, typename ReaderType>
 typename scheduler_tmpl_t<RecordType, ReaderType>::stream_status_t
 scheduler_tmpl_t<RecordType, ReaderType>::set_cur_input(output_ordinal_t output,
@@ -1576,7 +1731,7 @@ scheduler_tmpl_t<RecordType, ReaderType>::set_cur_input(output_ordinal_t output,
     int prev_input = outputs_[output].cur_input;
     if (prev_input >= 0) {
         if (options_.mapping == MAP_TO_ANY_OUTPUT && prev_input != input)
-            add_to_ready_queue(&inputs_[prev_input]);
+            add_to_ready_queue(&inputs_[prev_input], output);
         if (prev_input != input && options_.schedule_record_ostream != nullptr) {
             input_info_t &prev_info = inputs_[prev_input];
             std::lock_guard<std::mutex> lock(*prev_info.lock);
@@ -1727,14 +1882,59 @@ scheduler_tmpl_t<RecordType, ReaderType>::pick_next_input_as_previously(
     return sched_type_t::STATUS_OK;
 }
 
+template <typename RecordType, typename ReaderType>
+typename scheduler_tmpl_t<RecordType, ReaderType>::stream_status_t
+scheduler_tmpl_t<RecordType, ReaderType>::pick_next_input_from_local_queues(
+    output_ordinal_t output, bool in_wait_state, input_ordinal_t &index)
+{
+    // Unlike the global queue, we cannot give up the current input before popping
+    // as another output could steal it in the meantime.  We instead pop first and
+    // then compare against the current input as though it had just been queued.
+    input_ordinal_t cur_index = outputs_[output].cur_input;
+    bool cur_runnable = false;
+    if (cur_index != INVALID_INPUT_ORDINAL) {
+        std::lock_guard<std::mutex> lock(*inputs_[cur_index].lock);
+        cur_runnable = !inputs_[cur_index].at_eof;
+    }
+    input_info_t *queue_next = pop_from_ready_queue(output);
+    if (queue_next == nullptr) {
+        if (!cur_runnable)
+            return sched_type_t::STATUS_EOF;
+        index = cur_index; // Go back to prior.
+        return sched_type_t::STATUS_OK;
+    }
+    if (!in_wait_state && cur_index != INVALID_INPUT_ORDINAL) {
+        input_info_t *cur = &inputs_[cur_index];
+        if (cur_runnable) {
+            cur->queue_counter = ++ready_counter_;
+            if (InputTimestampComparator()(queue_next, cur)) {
+                // The current input is strictly better so we keep it.  We put the
+                // candidate on our own queue with its counter intact.
+                ready_queue_t &ready = *ready_queues_[output];
+                std::lock_guard<std::mutex> lock(ready.lock);
+                ready.queue.push(queue_next);
+                ready.size.store(ready.queue.size(), std::memory_order_relaxed);
+                index = cur_index;
+                return sched_type_t::STATUS_OK;
+            }
+        }
+        set_cur_input(output, INVALID_INPUT_ORDINAL);
+    }
+    index = queue_next->index;
+    return sched_type_t::STATUS_OK;
+}
+
 template <typename RecordType, typename ReaderType>
 typename scheduler_tmpl_t<RecordType, ReaderType>::stream_status_t
 scheduler_tmpl_t<RecordType, ReaderType>::pick_next_input(output_ordinal_t output,
                                                           bool in_wait_state)
 {
     sched_type_t::stream_status_t res = sched_type_t::STATUS_OK;
-    bool need_lock =
-        options_.mapping == MAP_TO_ANY_OUTPUT || options_.mapping == MAP_AS_PREVIOUSLY;
+    // With local ready queues we only need the global lock to serialize updates to
+    // the recorded schedule.
+    bool need_lock = options_.mapping == MAP_AS_PREVIOUSLY ||
+        (options_.mapping == MAP_TO_ANY_OUTPUT &&
+         (!local_ready_queues() || options_.schedule_record_ostream != nullptr));
     auto scoped_lock = need_lock ? std::unique_lock<std::mutex>(sched_lock_)
                                  : std::unique_lock<std::mutex>();
     input_ordinal_t prev_index = outputs_[output].cur_input;
@@ -1763,6 +1963,10 @@ scheduler_tmpl_t<RecordType, ReaderType>::pick_next_input(output_ordinal_t outpu
                     break;
                 if (res != sched_type_t::STATUS_OK)
                     return res;
+            } else if (local_ready_queues()) {
+                res = pick_next_input_from_local_queues(output, in_wait_state, index);
+                if (res != sched_type_t::STATUS_OK)
+                    return res;
             } else if (options_.mapping == MAP_TO_ANY_OUTPUT) {
                 if (ready_queue_empty()) {
                     if (prev_index == INVALID_INPUT_ORDINAL)
@@ -1917,6 +2121,12 @@ scheduler_tmpl_t<RecordType, ReaderType>::next_record(output_ordinal_t output,
                 input->needs_advance = true;
             }
             if (input->at_eof || *input->reader == *input->reader_end) {
+                if (outputs_[output].stop_before_switch) {
+                    // End the batch here and come back to this check next time.
+                    input->needs_advance = false;
+                    outputs_[output].stopped_before_switch = true;
+                    return sched_type_t::STATUS_WAIT;
+                }
                 lock.unlock();
                 VPRINT(this, 5, "next_record[%d]: need new input (cur=%d eof)\n", output,
                        input->index);
@@ -2034,6 +2244,26 @@ scheduler_tmpl_t<RecordType, ReaderType>::next_record(output_ordinal_t output,
             options_.mapping != MAP_TO_ANY_OUTPUT &&
             record_type_is_timestamp(record, input->next_timestamp))
             need_new_input = true;
+        if (outputs_[output].switch_deferred) {
+            outputs_[output].switch_deferred = false;
+            need_new_input = true;
+            in_wait_state = outputs_[output].deferred_wait_state;
+        }
+        if (need_new_input && outputs_[output].stop_before_switch) {
+            // End the batch here, putting the candidate record back to be re-read
+            // by the next call, which then switches.
+            VPRINT(this, 5, "next_record[%d]: deferring switch to end batch\n", output);
+            input->queue.push_front(record);
+            // Undo the count the re-read will repeat.
+            if (options_.mapping == MAP_TO_ANY_OUTPUT && !in_wait_state &&
+                options_.quantum_unit == QUANTUM_INSTRUCTIONS &&
+                record_type_is_instr(record))
+                --input->instrs_in_quantum;
+            outputs_[output].switch_deferred = true;
+            outputs_[output].deferred_wait_state = in_wait_state;
+            outputs_[output].stopped_before_switch = true;
+            return sched_type_t::STATUS_WAIT;
+        }
         if (need_new_input) {
             int prev_input = outputs_[output].cur_input;
             VPRINT(this, 5, "next_record[%d]: need new input (cur=%d)\n", output,
@@ -45,6 +45,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <atomic>
 #include <deque>
 #include <limits>
 #include <memory>
@@ -412,6 +413,18 @@ public:
          * #SCHEDULER_USE_INPUT_ORDINALS; otherwise, it has no effect.
          */
         SCHEDULER_USE_SINGLE_INPUT_ORDINALS = 0x8,
+        /**
+         * For #MAP_TO_ANY_OUTPUT, gives each output stream its own ready queue
+         * rather than sharing a single global queue under a global lock.  An input
+         * that is descheduled is added to the queue of the output it last ran on
+         * (or to a queue of an output in its binding), and an output whose own queue
+         * has nothing it can run steals from the other outputs' queues.  Priorities,
+         * timestamp ordering, and bindings are honored within each queue, but the
+         * selected input is no longer guaranteed to be the globally best candidate.
+         * This scales better to large numbers of outputs.  When recording a
+         * schedule, a global lock is still acquired on each input switch.
+         */
+        SCHEDULER_LOCAL_READY_QUEUES = 0x10,
         // TODO i#5843: Add more speculation flags for other strategies.
     };
 
@@ -548,6 +561,22 @@ public:
         virtual stream_status_t
         next_record(RecordType &record, uint64_t cur_time);
 
+        /**
+         * Advances through up to \p max_count records in the stream, storing them
+         * consecutively into \p records and their number into \p count, as a series
+         * of next_record() calls with the same \p cur_time would.  The batch ends
+         * early after any timestamp marker or thread exit record, so that those are
+         * always the final record of a batch, before a switch to another input, so
+         * that all of its records come from one input, or when next_record() would
+         * return a status other than #STATUS_OK.  That status is returned if no
+         * records were read and is otherwise returned by the subsequent call.  Queries
+         * on this stream made after this returns describe the final record of the
+         * batch.
+         */
+        virtual stream_status_t
+        next_record_batch(RecordType *records, size_t max_count, size_t &count,
+                          uint64_t cur_time);
+
         /**
          * Queues the last-read record returned by next_record() such that it will be
          * returned on the subsequent call to next_record() when this same input is
@@ -818,6 +847,9 @@ public:
         uint64_t cache_line_size_ = 0;
         uint64_t chunk_instr_count_ = 0;
         uint64_t page_size_ = 0;
+        // A status hit partway through a batch, to be returned by the next
+        // next_record_batch() call.
+        stream_status_t pending_batch_status_ = STATUS_OK;
 
         // Let the outer class update our state.
         friend class scheduler_tmpl_t<RecordType, ReaderType>;
@@ -1042,6 +1074,14 @@ protected:
         uint64_t cur_time = 0;
         // Used for MAP_TO_RECORDED_OUTPUT get_output_cpuid().
         int64_t as_traced_cpuid = -1;
+        // Set by next_record_batch() while it holds records, so that a switch to
+        // another input ends the batch instead.  The switch is then deferred to the
+        // next call, with stopped_before_switch set to tell the batch to end.
+        bool stop_before_switch = false;
+        bool stopped_before_switch = false;
+        // A deferred switch away from the candidate record queued on cur_input.
+        bool switch_deferred = false;
+        bool deferred_wait_state = false;
     };
 
     // Called just once at initialization time to set the initial input-to-output
@@ -1163,6 +1203,10 @@ protected:
     bool
     record_type_is_timestamp(RecordType record, uintptr_t &value);
 
+    // Returns whether the given record ends its thread's trace.
+    bool
+    record_type_is_thread_exit(RecordType record);
+
     bool
     record_type_is_invalid(RecordType record);
 
@@ -1243,19 +1287,56 @@ protected:
         }
     };
 
-    // sched_lock_ must be held by the caller.
+    // A queue of inputs ready to be scheduled, sorted by priority and then timestamp
+    // if timestamp dependencies are requested.  We use the timestamp delta from the
+    // first observed timestamp in each workload in order to mix inputs from different
+    // workloads in the same queue.  FIFO ordering is used for same-priority entries.
+    struct ready_queue_t {
+        // Protects "queue".  For the single global queue this is always acquired
+        // while holding sched_lock_ and is thus uncontended.
+        std::mutex lock;
+        std::priority_queue<input_info_t *, std::vector<input_info_t *>,
+                            InputTimestampComparator>
+            queue;
+        // A copy of queue.size() which can be read without holding "lock" so that
+        // work stealing can skip empty queues cheaply.
+        std::atomic<size_t> size { 0 };
+    };
+
+    bool
+    local_ready_queues() const
+    {
+        return options_.mapping == MAP_TO_ANY_OUTPUT &&
+            TESTANY(SCHEDULER_LOCAL_READY_QUEUES, options_.flags);
+    }
+
+    // sched_lock_ must be held by the caller unless local_ready_queues() is true.
     bool
     ready_queue_empty();
 
-    // sched_lock_ must be held by the caller.
+    // sched_lock_ must be held by the caller unless local_ready_queues() is true.
+    // "from_output" is the output the input last ran on, which selects the queue
+    // it is added to when local_ready_queues() is true.
     void
-    add_to_ready_queue(input_info_t *input);
+    add_to_ready_queue(input_info_t *input, output_ordinal_t from_output);
 
-    // sched_lock_ must be held by the caller.
+    // sched_lock_ must be held by the caller unless local_ready_queues() is true.
     // "for_output" is which output stream is looking for a new input; only an
-    // input which is able to run on that output will be selected.
+    // input which is able to run on that output will be selected.  With
+    // local_ready_queues(), the queue for "for_output" is searched first and the
+    // other outputs' queues are then searched in turn (work stealing).
     input_info_t *
     pop_from_ready_queue(output_ordinal_t for_output);
+
+    // Pops the best input in "queue" that is able to run on "for_output".  The
+    // caller must hold queue.lock (or otherwise own the queue).
+    input_info_t *
+    pop_from_queue(ready_queue_t &queue, output_ordinal_t for_output);
+
+    // Used by pick_next_input() with local_ready_queues().
+    stream_status_t
+    pick_next_input_from_local_queues(output_ordinal_t output, bool in_wait_state,
+                                      input_ordinal_t &index);
     ///
     ///////////////////////////////////////////////////////////////////////////
 
@@ -1271,18 +1352,17 @@ protected:
     std::vector<output_info_t> outputs_;
     // We use a central lock for global scheduling.  We assume the synchronization
     // cost is outweighed by the simulator's overhead.  This protects concurrent
-    // access to inputs_.size(), outputs_.size(), ready_priority_, and
-    // ready_counter_.
+    // access to inputs_.size(), outputs_.size(), and the ready queue, unless
+    // local_ready_queues() is true in which case each ready queue has its own lock.
     std::mutex sched_lock_;
-    // Inputs ready to be scheduled, sorted by priority and then timestamp if timestamp
-    // dependencies are requested.  We use the timestamp delta from the first observed
-    // timestamp in each workload in order to mix inputs from different workloads in the
-    // same queue.  FIFO ordering is used for same-priority entries.
-    std::priority_queue<input_info_t *, std::vector<input_info_t *>,
-                        InputTimestampComparator>
-        ready_priority_;
+    // The ready queues: a single global queue, or one per output when
+    // local_ready_queues() is true.  These are pointers as the mutexes are not
+    // movable.
+    std::vector<std::unique_ptr<ready_queue_t>> ready_queues_;
     // Global ready queue counter used to provide FIFO for same-priority inputs.
-    uint64_t ready_counter_ = 0;
+    // It is shared across all queues so that inputs moved between queues keep
+    // their relative order.
+    std::atomic<uint64_t> ready_counter_ { 0 };
 };
 
 /** See #dynamorio::drmemtrace::scheduler_tmpl_t. */
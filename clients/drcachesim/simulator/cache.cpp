@@ -34,6 +34,7 @@
 
 #include <stddef.h>
 
+#include <mutex>
 #include <utility>
 #include <vector>
 
@@ -82,6 +83,15 @@ cache_t::request(const memref_t &memref)
     caching_device_t::request(memref);
 }
 
+void
+cache_t::replay_shared_request(const memref_t &memref, bool is_flush)
+{
+    if (is_flush)
+        ((cache_t *)parent_)->flush(memref);
+    else
+        caching_device_t::replay_shared_request(memref, is_flush);
+}
+
 void
 cache_t::flush(const memref_t &memref)
 {
@@ -93,12 +103,16 @@ cache_t::flush(const memref_t &memref)
         auto block_way = find_caching_device_block(tag);
         if (block_way.first == nullptr)
             continue;
-        invalidate_caching_device_block(block_way.first);
+        invalidate_caching_device_block(compute_block_idx(tag), block_way.second);
     }
     // We flush parent_'s code cache here.
     // XXX: should L1 data cache be flushed when L1 instr cache is flushed?
-    if (parent_ != NULL)
+    if (shared_request_log_ != nullptr)
+        shared_request_log_->add(this, memref, true /*flush*/);
+    else if (parent_ != NULL) {
+        std::unique_lock<std::mutex> parent_lock = parent_->lock_for_access_from(this);
         ((cache_t *)parent_)->flush(memref);
+    }
     if (stats_ != NULL)
         ((cache_stats_t *)stats_)->flush(memref);
 }
@@ -70,6 +70,8 @@ public:
     request(const memref_t &memref) override;
     virtual void
     flush(const memref_t &memref);
+    void
+    replay_shared_request(const memref_t &memref, bool is_flush) override;
 
 protected:
     void
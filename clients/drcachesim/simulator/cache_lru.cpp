@@ -40,6 +40,7 @@
 #include "caching_device_stats.h"
 #include "prefetcher.h"
 #include "snoop_filter.h"
+#include "way_search.h"
 
 namespace dynamorio {
 namespace drmemtrace {
@@ -68,7 +69,7 @@ cache_lru_t::init(int associativity, int block_size, int total_size,
     // Initialize line counters with 0, 1, 2, ..., associativity - 1.
     for (int i = 0; i < blocks_per_way_; i++) {
         for (int way = 0; way < associativity_; ++way) {
-            get_caching_device_block(i * associativity_, way).counter_ = way;
+            get_block_counter(i * associativity_, way) = way;
         }
     }
     return true;
@@ -77,17 +78,15 @@ cache_lru_t::init(int associativity, int block_size, int total_size,
 void
 cache_lru_t::access_update(int block_idx, int way)
 {
-    int cnt = get_caching_device_block(block_idx, way).counter_;
+    int cnt = get_block_counter(block_idx, way);
     // Optimization: return early if it is a repeated access.
     if (cnt == 0)
         return;
     // We inc all the counters that are not larger than cnt for LRU.
-    for (int i = 0; i < associativity_; ++i) {
-        if (i != way && get_caching_device_block(block_idx, i).counter_ <= cnt)
-            get_caching_device_block(block_idx, i).counter_++;
-    }
+    // This includes our own, which is cleared below.
+    increment_counters_up_to(&counters_[block_idx], associativity_, cnt);
     // Clear the counter for LRU.
-    get_caching_device_block(block_idx, way).counter_ = 0;
+    get_block_counter(block_idx, way) = 0;
 }
 
 int
@@ -99,20 +98,12 @@ cache_lru_t::replace_which_way(int block_idx)
 int
 cache_lru_t::get_next_way_to_replace(int block_idx) const
 {
-    // We implement LRU by picking the slot with the largest counter value.
-    int max_counter = 0;
-    int max_way = 0;
-    for (int way = 0; way < associativity_; ++way) {
-        if (get_caching_device_block(block_idx, way).tag_ == TAG_INVALID) {
-            max_way = way;
-            break;
-        }
-        if (get_caching_device_block(block_idx, way).counter_ > max_counter) {
-            max_counter = get_caching_device_block(block_idx, way).counter_;
-            max_way = way;
-        }
-    }
-    return max_way;
+    // We implement LRU by picking the slot with the largest counter value,
+    // unless there is an invalid slot.
+    int way = find_way_with_tag(&tags_[block_idx], associativity_, TAG_INVALID);
+    if (way >= 0)
+        return way;
+    return find_way_with_max_counter(&counters_[block_idx], associativity_);
 }
 
 } // namespace drmemtrace
@@ -0,0 +1,117 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "cache_plru.h"
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "cache.h"
+#include "caching_device.h"
+#include "caching_device_block.h"
+#include "caching_device_stats.h"
+#include "prefetcher.h"
+#include "snoop_filter.h"
+#include "utils.h"
+#include "way_search.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// For tree pseudo-LRU, each set keeps a binary tree with one bit per internal
+// node pointing toward the less recently used half of the ways below it.  An
+// access flips the bits on its path to point away from it, and the victim is
+// found by following the bits from the root.  This needs a single word per set
+// rather than a counter per way.
+
+bool
+cache_plru_t::init(int associativity, int block_size, int total_size,
+                   caching_device_t *parent, caching_device_stats_t *stats,
+                   prefetcher_t *prefetcher, bool inclusive, bool coherent_cache, int id,
+                   snoop_filter_t *snoop_filter,
+                   const std::vector<caching_device_t *> &children)
+{
+    if (!IS_POWER_OF_2(associativity) || associativity > 64)
+        return false;
+    bool ret_val =
+        cache_t::init(associativity, block_size, total_size, parent, stats, prefetcher,
+                      inclusive, coherent_cache, id, snoop_filter, children);
+    if (ret_val == false)
+        return false;
+    levels_ = compute_log2(associativity);
+    tree_bits_.assign(blocks_per_way_, 0);
+    return true;
+}
+
+void
+cache_plru_t::access_update(int block_idx, int way)
+{
+    uint64_t &bits = tree_bits_[block_idx >> levels_];
+    int node = 1;
+    for (int level = levels_ - 1; level >= 0; --level) {
+        int right = (way >> level) & 1;
+        // Point at the other half.
+        if (right)
+            bits &= ~(1ULL << node);
+        else
+            bits |= 1ULL << node;
+        node = 2 * node + right;
+    }
+}
+
+int
+cache_plru_t::replace_which_way(int block_idx)
+{
+    return get_next_way_to_replace(block_idx);
+}
+
+int
+cache_plru_t::get_next_way_to_replace(const int block_idx) const
+{
+    int way = find_way_with_tag(&tags_[block_idx], associativity_, TAG_INVALID);
+    if (way >= 0)
+        return way;
+    uint64_t bits = tree_bits_[block_idx >> levels_];
+    int node = 1;
+    way = 0;
+    for (int level = 0; level < levels_; ++level) {
+        int right = (bits >> node) & 1;
+        way = (way << 1) | right;
+        node = 2 * node + right;
+    }
+    return way;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
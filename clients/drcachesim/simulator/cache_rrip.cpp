@@ -0,0 +1,163 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "cache_rrip.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "cache.h"
+#include "caching_device.h"
+#include "caching_device_block.h"
+#include "caching_device_stats.h"
+#include "prefetcher.h"
+#include "snoop_filter.h"
+#include "way_search.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// This follows Jaleel et al., "High Performance Cache Replacement Using
+// Re-Reference Interval Prediction (RRIP)", ISCA 2010, with 2-bit RRPVs and
+// hit-priority promotion.
+
+constexpr uint8_t cache_rrip_t::RRPV_MAX;
+constexpr int cache_rrip_t::PSEL_MAX;
+
+bool
+cache_rrip_t::init(int associativity, int block_size, int total_size,
+                   caching_device_t *parent, caching_device_stats_t *stats,
+                   prefetcher_t *prefetcher, bool inclusive, bool coherent_cache, int id,
+                   snoop_filter_t *snoop_filter,
+                   const std::vector<caching_device_t *> &children)
+{
+    bool ret_val =
+        cache_t::init(associativity, block_size, total_size, parent, stats, prefetcher,
+                      inclusive, coherent_cache, id, snoop_filter, children);
+    if (ret_val == false)
+        return false;
+    rrpv_.assign(num_blocks_, RRPV_MAX);
+    if (insertion_ == RRIP_DYNAMIC && blocks_per_way_ >= 2 * NUM_LEADER_SETS)
+        constituency_sets_ = blocks_per_way_ / NUM_LEADER_SETS;
+    return true;
+}
+
+std::string
+cache_rrip_t::get_replace_policy() const
+{
+    switch (insertion_) {
+    case RRIP_BIMODAL: return "BRRIP";
+    case RRIP_DYNAMIC: return "DRRIP";
+    default: return "SRRIP";
+    }
+}
+
+void
+cache_rrip_t::access_update(int block_idx, int way)
+{
+    if (fill_pending_) {
+        fill_pending_ = false;
+        rrpv_[block_idx + way] = insertion_rrpv(block_idx, way);
+    } else
+        rrpv_[block_idx + way] = 0;
+}
+
+int
+cache_rrip_t::replace_which_way(int block_idx)
+{
+    fill_pending_ = true;
+    int way = find_way_with_tag(&tags_[block_idx], associativity_, TAG_INVALID);
+    if (way >= 0)
+        return way;
+    // Age the set just enough for its most distant block to reach RRPV_MAX,
+    // which is equivalent to incrementing every RRPV until one does.
+    uint8_t *set = &rrpv_[block_idx];
+    uint8_t oldest = *std::max_element(set, set + associativity_);
+    if (oldest < RRPV_MAX) {
+        uint8_t delta = RRPV_MAX - oldest;
+        for (int i = 0; i < associativity_; ++i)
+            set[i] += delta;
+    }
+    return get_next_way_to_replace(block_idx);
+}
+
+int
+cache_rrip_t::get_next_way_to_replace(const int block_idx) const
+{
+    int way = find_way_with_tag(&tags_[block_idx], associativity_, TAG_INVALID);
+    if (way >= 0)
+        return way;
+    // The first block with the largest RRPV, which is the one that aging would
+    // bring to RRPV_MAX first.
+    const uint8_t *set = &rrpv_[block_idx];
+    return static_cast<int>(std::max_element(set, set + associativity_) - set);
+}
+
+uint8_t
+cache_rrip_t::bimodal_rrpv()
+{
+    if (++bimodal_fills_ == BIMODAL_PERIOD) {
+        bimodal_fills_ = 0;
+        return RRPV_MAX - 1;
+    }
+    return RRPV_MAX;
+}
+
+uint8_t
+cache_rrip_t::insertion_rrpv(int block_idx, int way)
+{
+    switch (insertion_) {
+    case RRIP_STATIC: return RRPV_MAX - 1;
+    case RRIP_BIMODAL: return bimodal_rrpv();
+    default: break;
+    }
+    if (constituency_sets_ > 0) {
+        // A miss in a leader set is a vote against its policy.
+        int offset = (block_idx / associativity_) % constituency_sets_;
+        if (offset == 0) {
+            psel_ = std::min(psel_ + 1, PSEL_MAX);
+            return RRPV_MAX - 1;
+        }
+        if (offset == constituency_sets_ / 2) {
+            psel_ = std::max(psel_ - 1, 0);
+            return bimodal_rrpv();
+        }
+    }
+    return psel_ > PSEL_MAX / 2 ? bimodal_rrpv() : RRPV_MAX - 1;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
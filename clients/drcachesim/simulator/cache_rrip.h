@@ -0,0 +1,119 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* cache_rrip: represents a single hardware cache with the re-reference interval
+ * prediction algos SRRIP, BRRIP, and DRRIP.
+ */
+
+#ifndef _CACHE_RRIP_H_
+#define _CACHE_RRIP_H_ 1
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "cache.h"
+#include "prefetcher.h"
+#include "snoop_filter.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// Each block has a 2-bit re-reference prediction value (RRPV) where 0 predicts a
+// near re-reference and 3 a distant one.  Hits reset the RRPV to 0 and the
+// victim is a block with RRPV 3, after aging the set until one exists.  The
+// variants differ in the RRPV of newly filled blocks: SRRIP inserts at 2 and
+// BRRIP mostly at 3, while DRRIP picks between them by set dueling.
+class cache_rrip_t : public cache_t {
+public:
+    enum insertion_t {
+        RRIP_STATIC,
+        RRIP_BIMODAL,
+        RRIP_DYNAMIC,
+    };
+
+    explicit cache_rrip_t(const std::string &name = "cache_rrip",
+                          insertion_t insertion = RRIP_STATIC)
+        : cache_t(name)
+        , insertion_(insertion)
+    {
+    }
+    bool
+    init(int associativity, int line_size, int total_size, caching_device_t *parent,
+         caching_device_stats_t *stats, prefetcher_t *prefetcher = nullptr,
+         bool inclusive = false, bool coherent_cache = false, int id_ = -1,
+         snoop_filter_t *snoop_filter_ = nullptr,
+         const std::vector<caching_device_t *> &children = {}) override;
+    std::string
+    get_replace_policy() const override;
+
+protected:
+    static constexpr uint8_t RRPV_MAX = 3;
+    // BRRIP inserts one fill in this many at RRPV_MAX - 1.
+    static constexpr int BIMODAL_PERIOD = 32;
+    // DRRIP dedicates this many sets to each of SRRIP and BRRIP.
+    static constexpr int NUM_LEADER_SETS = 32;
+    static constexpr int PSEL_MAX = 1023;
+
+    void
+    access_update(int block_idx, int way) override;
+    int
+    replace_which_way(int block_idx) override;
+    int
+    get_next_way_to_replace(const int block_idx) const override;
+
+    // Returns the RRPV for a block being filled into the set at "block_idx".
+    // This is called once per miss.
+    virtual uint8_t
+    insertion_rrpv(int block_idx, int way);
+
+    uint8_t
+    bimodal_rrpv();
+
+    insertion_t insertion_;
+    // One byte per block, with the ways of a set adjacent.
+    std::vector<uint8_t> rrpv_;
+    // Set between replace_which_way() and the access_update() of the new block.
+    bool fill_pending_ = false;
+    int bimodal_fills_ = 0;
+    // For DRRIP, each constituency of this many sets holds one SRRIP leader at
+    // offset 0 and one BRRIP leader at its middle; 0 disables dueling.
+    int constituency_sets_ = 0;
+    int psel_ = (PSEL_MAX + 1) / 2;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _CACHE_RRIP_H_ */
@@ -0,0 +1,121 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "cache_ship.h"
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "cache_rrip.h"
+#include "caching_device.h"
+#include "caching_device_block.h"
+#include "caching_device_stats.h"
+#include "memref.h"
+#include "prefetcher.h"
+#include "snoop_filter.h"
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// This follows SHiP-PC from Wu et al., "SHiP: Signature-based Hit Predictor for
+// High Performance Caching", MICRO 2011, with a 16K-entry table of 3-bit
+// counters.
+
+bool
+cache_ship_t::init(int associativity, int block_size, int total_size,
+                   caching_device_t *parent, caching_device_stats_t *stats,
+                   prefetcher_t *prefetcher, bool inclusive, bool coherent_cache, int id,
+                   snoop_filter_t *snoop_filter,
+                   const std::vector<caching_device_t *> &children)
+{
+    bool ret_val = cache_rrip_t::init(associativity, block_size, total_size, parent,
+                                      stats, prefetcher, inclusive, coherent_cache, id,
+                                      snoop_filter, children);
+    if (ret_val == false)
+        return false;
+    block_signatures_.assign(num_blocks_, 0);
+    // Start out weakly predicting reuse, so that the first fills of each
+    // signature are treated like SRRIP's.
+    counters_by_signature_.assign(1 << SIGNATURE_BITS, 1);
+    return true;
+}
+
+void
+cache_ship_t::request(const memref_t &memref)
+{
+    addr_t pc = type_is_instr(memref.instr.type) ? memref.instr.addr : memref.data.pc;
+    // Fold the PC so that its higher bits contribute to the signature.
+    pc ^= pc >> SIGNATURE_BITS;
+    pc ^= pc >> (2 * SIGNATURE_BITS);
+    signature_ = static_cast<uint16_t>(pc & (REUSED_BIT - 1));
+    cache_rrip_t::request(memref);
+}
+
+void
+cache_ship_t::access_update(int block_idx, int way)
+{
+    if (!fill_pending_) {
+        uint16_t &block = block_signatures_[block_idx + way];
+        uint8_t &counter = counters_by_signature_[block & (REUSED_BIT - 1)];
+        if (counter < COUNTER_MAX)
+            ++counter;
+        block |= REUSED_BIT;
+    }
+    cache_rrip_t::access_update(block_idx, way);
+}
+
+int
+cache_ship_t::replace_which_way(int block_idx)
+{
+    int way = cache_rrip_t::replace_which_way(block_idx);
+    // A valid victim that was never hit trains its signature toward distant.
+    uint16_t block = block_signatures_[block_idx + way];
+    if (get_block_tag(block_idx, way) != TAG_INVALID && (block & REUSED_BIT) == 0) {
+        uint8_t &counter = counters_by_signature_[block];
+        if (counter > 0)
+            --counter;
+    }
+    return way;
+}
+
+uint8_t
+cache_ship_t::insertion_rrpv(int block_idx, int way)
+{
+    block_signatures_[block_idx + way] = signature_;
+    return counters_by_signature_[signature_] == 0 ? RRPV_MAX : RRPV_MAX - 1;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
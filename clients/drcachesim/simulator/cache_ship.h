@@ -0,0 +1,102 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* cache_ship: represents a single hardware cache with the signature-based hit
+ * predictor (SHiP) algo.
+ */
+
+#ifndef _CACHE_SHIP_H_
+#define _CACHE_SHIP_H_ 1
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "cache_rrip.h"
+#include "memref.h"
+#include "prefetcher.h"
+#include "snoop_filter.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// SHiP builds on SRRIP by predicting the re-reference interval of a new block
+// from the program counter of the access that filled it.  A table of saturating
+// counters indexed by a hash of that PC learns whether the blocks it fills tend
+// to be hit before eviction, and blocks from PCs that never see hits are
+// inserted at the distant RRPV.
+class cache_ship_t : public cache_rrip_t {
+public:
+    explicit cache_ship_t(const std::string &name = "cache_ship")
+        : cache_rrip_t(name, RRIP_STATIC)
+    {
+    }
+    bool
+    init(int associativity, int line_size, int total_size, caching_device_t *parent,
+         caching_device_stats_t *stats, prefetcher_t *prefetcher = nullptr,
+         bool inclusive = false, bool coherent_cache = false, int id_ = -1,
+         snoop_filter_t *snoop_filter_ = nullptr,
+         const std::vector<caching_device_t *> &children = {}) override;
+    void
+    request(const memref_t &memref) override;
+    std::string
+    get_replace_policy() const override
+    {
+        return "SHiP";
+    }
+
+protected:
+    static constexpr int SIGNATURE_BITS = 14;
+    static constexpr uint16_t REUSED_BIT = 1 << SIGNATURE_BITS;
+    static constexpr uint8_t COUNTER_MAX = 7;
+
+    void
+    access_update(int block_idx, int way) override;
+    int
+    replace_which_way(int block_idx) override;
+    uint8_t
+    insertion_rrpv(int block_idx, int way) override;
+
+    // The signature of the PC of the current request.
+    uint16_t signature_ = 0;
+    // Per block, the filling signature plus REUSED_BIT once the block is hit.
+    std::vector<uint16_t> block_signatures_;
+    // The signature history counter table.
+    std::vector<uint8_t> counters_by_signature_;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _CACHE_SHIP_H_ */
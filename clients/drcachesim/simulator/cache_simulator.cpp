@@ -36,10 +36,13 @@
 #include <stdint.h> /* for supporting 64-bit integers*/
 
 #include <functional>
+#include <iomanip>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -53,8 +56,12 @@
 #include "cache.h"
 #include "cache_fifo.h"
 #include "cache_lru.h"
+#include "cache_plru.h"
+#include "cache_rrip.h"
+#include "cache_ship.h"
 #include "cache_simulator_create.h"
 #include "cache_stats.h"
+#include "cache_timing.h"
 #include "caching_device.h"
 #include "caching_device_stats.h"
 #include "prefetcher.h"
@@ -187,6 +194,20 @@ cache_simulator_t::cache_simulator_t(const cache_simulator_knobs_t &knobs)
         success_ = false;
         return;
     }
+
+    if (knobs_.timing) {
+        timing_ = new cache_timing_t(knobs_);
+        timing_->add_device(llc, knobs_.LL_latency, knobs_.LL_mshrs);
+        for (unsigned int i = 0; i < knobs_.num_cores; i++) {
+            timing_->add_device(l1_icaches_[i], knobs_.L1_latency, knobs_.L1_mshrs);
+            timing_->add_device(l1_dcaches_[i], knobs_.L1_latency, knobs_.L1_mshrs);
+        }
+        if (!init_timing()) {
+            error_string_ = "Usage error: failed to initialize the timing model";
+            success_ = false;
+            return;
+        }
+    }
 }
 
 cache_simulator_t::cache_simulator_t(std::istream *config_file)
@@ -380,15 +401,37 @@ cache_simulator_t::cache_simulator_t(std::istream *config_file)
         success_ = false;
         return;
     }
-    // For larger hierarchies, especially with coherence, using hashtables
-    // for faster lookups provides performance wins as high as 15%.
-    // However, hashtables can slow down smaller hierarchies, so we only
-    // enable if we anticipate a win.
+    // Each cache uses hashtables for faster lookups by default where its
+    // geometry makes that a win (see caching_device_t::init()).  For larger
+    // hierarchies, especially with coherence, using them throughout provides
+    // wins as high as 15%.
     if (other_caches_.size() > 0 && (knobs_.model_coherence || knobs_.num_cores >= 32)) {
         for (auto &cache : all_caches_) {
             cache.second->set_hashtable_use(true);
         }
     }
+
+    if (knobs_.timing) {
+        // Caches without their own latency or MSHR count take the L1 knobs if
+        // they belong to a core and the last-level knobs otherwise.
+        timing_ = new cache_timing_t(knobs_);
+        for (auto &cache : all_caches_) {
+            const cache_params_t &cache_config = cache_params.find(cache.first)->second;
+            bool is_l1 = cache_config.core >= 0;
+            unsigned int latency = is_l1 ? knobs_.L1_latency : knobs_.LL_latency;
+            unsigned int mshrs = is_l1 ? knobs_.L1_mshrs : knobs_.LL_mshrs;
+            if (cache_config.latency >= 0)
+                latency = cache_config.latency;
+            if (cache_config.mshrs >= 0)
+                mshrs = cache_config.mshrs;
+            timing_->add_device(cache.second, latency, mshrs);
+        }
+        if (!init_timing()) {
+            error_string_ = "Usage error: failed to initialize the timing model";
+            success_ = false;
+            return;
+        }
+    }
 }
 
 cache_simulator_t::~cache_simulator_t()
@@ -412,6 +455,10 @@ cache_simulator_t::~cache_simulator_t()
     if (snoop_filter_ != NULL) {
         delete snoop_filter_;
     }
+    delete timing_;
+    for (auto &iter : shard_map_) {
+        delete iter.second;
+    }
 }
 
 uint64_t
@@ -451,8 +498,15 @@ cache_simulator_t::process_memref(const memref_t &memref)
                       << "marker type " << memref.marker.marker_type << " value "
                       << memref.marker.marker_value << "\n";
         }
+        update_window_tids(memref);
+        count_sampling(memref, false, sample_counts_);
         return true;
     }
+    bool in_window = false;
+    if (sample_counts_.sampled) {
+        in_window = window_tids_.count(memref.data.tid) > 0;
+        count_sampling(memref, in_window, sample_counts_);
+    }
 
     int core;
     if (memref.data.tid == last_thread_)
@@ -473,40 +527,9 @@ cache_simulator_t::process_memref(const memref_t &memref)
         simref = &phys_memref;
     }
 
-    if (type_is_instr(simref->instr.type) ||
-        simref->instr.type == TRACE_TYPE_PREFETCH_INSTR) {
-        if (knobs_.verbose >= 3) {
-            std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
-                      << " @" << (void *)simref->instr.addr << " instr x"
-                      << simref->instr.size << "\n";
-        }
-        l1_icaches_[core]->request(*simref);
-    } else if (simref->data.type == TRACE_TYPE_READ ||
-               simref->data.type == TRACE_TYPE_WRITE ||
-               // We may potentially handle prefetches differently.
-               // TRACE_TYPE_PREFETCH_INSTR is handled above.
-               type_is_prefetch(simref->data.type)) {
-        if (knobs_.verbose >= 3) {
-            std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
-                      << " @" << (void *)simref->data.pc << " "
-                      << trace_type_names[simref->data.type] << " "
-                      << (void *)simref->data.addr << " x" << simref->data.size << "\n";
-        }
-        l1_dcaches_[core]->request(*simref);
-    } else if (simref->flush.type == TRACE_TYPE_INSTR_FLUSH) {
-        if (knobs_.verbose >= 3) {
-            std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
-                      << " @" << (void *)simref->data.pc << " iflush "
-                      << (void *)simref->data.addr << " x" << simref->data.size << "\n";
-        }
-        l1_icaches_[core]->flush(*simref);
-    } else if (simref->flush.type == TRACE_TYPE_DATA_FLUSH) {
-        if (knobs_.verbose >= 3) {
-            std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
-                      << " @" << (void *)simref->data.pc << " dflush "
-                      << (void *)simref->data.addr << " x" << simref->data.size << "\n";
-        }
-        l1_dcaches_[core]->flush(*simref);
+    if (in_window ? simulate_window_access(core, *simref, sample_counts_.window_misses)
+                  : simulate_access(core, *simref)) {
+        // Nothing further to do.
     } else if (simref->exit.type == TRACE_TYPE_THREAD_EXIT) {
         handle_thread_exit(simref->exit.tid);
         last_thread_ = 0;
@@ -531,6 +554,8 @@ cache_simulator_t::process_memref(const memref_t &memref)
             cache_t *cache = cache_it.second;
             cache->get_stats()->reset();
         }
+        if (timing_ != nullptr)
+            timing_->reset_stats();
         if (knobs_.verbose >= 1) {
             std::cerr << "Cache simulation warmed up\n";
         }
@@ -541,6 +566,438 @@ cache_simulator_t::process_memref(const memref_t &memref)
     return true;
 }
 
+bool
+cache_simulator_t::simulate_access(int core, const memref_t &simref)
+{
+    if (type_is_instr(simref.instr.type) ||
+        simref.instr.type == TRACE_TYPE_PREFETCH_INSTR) {
+        if (knobs_.verbose >= 3) {
+            std::cerr << "::" << simref.data.pid << "." << simref.data.tid << ":: "
+                      << " @" << (void *)simref.instr.addr << " instr x"
+                      << simref.instr.size << "\n";
+        }
+        if (timing_ != nullptr)
+            timing_->begin_access(core);
+        l1_icaches_[core]->request(simref);
+        if (timing_ != nullptr)
+            timing_->end_access(core, simref);
+    } else if (simref.data.type == TRACE_TYPE_READ ||
+               simref.data.type == TRACE_TYPE_WRITE ||
+               // We may potentially handle prefetches differently.
+               // TRACE_TYPE_PREFETCH_INSTR is handled above.
+               type_is_prefetch(simref.data.type)) {
+        if (knobs_.verbose >= 3) {
+            std::cerr << "::" << simref.data.pid << "." << simref.data.tid << ":: "
+                      << " @" << (void *)simref.data.pc << " "
+                      << trace_type_names[simref.data.type] << " "
+                      << (void *)simref.data.addr << " x" << simref.data.size << "\n";
+        }
+        if (timing_ != nullptr)
+            timing_->begin_access(core);
+        l1_dcaches_[core]->request(simref);
+        if (timing_ != nullptr)
+            timing_->end_access(core, simref);
+    } else if (simref.flush.type == TRACE_TYPE_INSTR_FLUSH) {
+        if (knobs_.verbose >= 3) {
+            std::cerr << "::" << simref.data.pid << "." << simref.data.tid << ":: "
+                      << " @" << (void *)simref.data.pc << " iflush "
+                      << (void *)simref.data.addr << " x" << simref.data.size << "\n";
+        }
+        l1_icaches_[core]->flush(simref);
+    } else if (simref.flush.type == TRACE_TYPE_DATA_FLUSH) {
+        if (knobs_.verbose >= 3) {
+            std::cerr << "::" << simref.data.pid << "." << simref.data.tid << ":: "
+                      << " @" << (void *)simref.data.pc << " dflush "
+                      << (void *)simref.data.addr << " x" << simref.data.size << "\n";
+        }
+        l1_dcaches_[core]->flush(simref);
+    } else
+        return false;
+    return true;
+}
+
+bool
+cache_simulator_t::init_timing()
+{
+    return timing_->init(
+        std::vector<caching_device_t *>(l1_icaches_, l1_icaches_ + knobs_.num_cores),
+        std::vector<caching_device_t *>(l1_dcaches_, l1_dcaches_ + knobs_.num_cores));
+}
+
+bool
+cache_simulator_t::parallel_shard_supported()
+{
+    std::unordered_set<caching_device_t *> shared;
+    return knobs_.parallel_cores && find_shared_caches(shared);
+}
+
+std::string
+cache_simulator_t::initialize_stream(memtrace_stream_t *serial_stream)
+{
+    serial_operation_ = serial_stream != nullptr;
+    return simulator_t::initialize_stream(serial_stream);
+}
+
+std::string
+cache_simulator_t::initialize_shard_type(shard_type_t shard_type)
+{
+    if (!knobs_.parallel_cores)
+        return "";
+    if (shard_type != SHARD_BY_CORE)
+        return "The parallel_cores cache simulator knob requires core-sharded analysis";
+    // Hierarchies we cannot simulate in parallel, or another tool or -core_serial
+    // requiring serial analysis, leave us with a regular serial simulation.
+    if (serial_operation_ || !parallel_shard_supported())
+        return "";
+    return init_core_sharded();
+}
+
+bool
+cache_simulator_t::find_shared_caches(std::unordered_set<caching_device_t *> &shared)
+{
+    // Coherence invalidates lines in other cores' private caches.  So does a
+    // shared inclusive cache, and the timing of a private cache's miss depends on
+    // what the shared caches hold.
+    if (knobs_.model_coherence || timing_ != nullptr)
+        return false;
+    std::unordered_map<caching_device_t *, std::unordered_set<unsigned int>>
+        cores_per_cache;
+    for (unsigned int i = 0; i < knobs_.num_cores; i++) {
+        for (caching_device_t *cache = l1_icaches_[i]; cache != nullptr;
+             cache = cache->get_parent())
+            cores_per_cache[cache].insert(i);
+        for (caching_device_t *cache = l1_dcaches_[i]; cache != nullptr;
+             cache = cache->get_parent())
+            cores_per_cache[cache].insert(i);
+    }
+    for (const auto &entry : cores_per_cache) {
+        if (entry.second.size() > 1) {
+            if (entry.first->is_inclusive() || entry.first->is_coherent())
+                return false;
+            shared.insert(entry.first);
+        }
+    }
+    for (unsigned int i = 0; i < knobs_.num_cores; i++) {
+        if (shared.count(l1_icaches_[i]) > 0 || shared.count(l1_dcaches_[i]) > 0)
+            return false;
+    }
+    return true;
+}
+
+std::string
+cache_simulator_t::init_core_sharded()
+{
+    if (knobs_.skip_refs > 0 || knobs_.warmup_refs > 0 ||
+        knobs_.warmup_fraction > 0.0 ||
+        knobs_.sim_refs != cache_simulator_knobs_t().sim_refs) {
+        return "Core-sharded cache simulation does not support -skip_refs, "
+               "-warmup_refs, -warmup_fraction, or -sim_refs";
+    }
+    if (knobs_.use_physical)
+        return "Core-sharded cache simulation does not support -use_physical";
+    std::unordered_set<caching_device_t *> shared;
+    find_shared_caches(shared);
+    core_logs_.resize(knobs_.num_cores);
+    pending_requests_.resize(knobs_.num_cores);
+    core_progress_.assign(knobs_.num_cores, 0);
+    core_done_.assign(knobs_.num_cores, false);
+    for (caching_device_t *cache : shared)
+        cache->set_shared_lock(&shared_caches_mutex_);
+    for (unsigned int i = 0; i < knobs_.num_cores; i++) {
+        for (caching_device_t *l1 : { l1_icaches_[i], l1_dcaches_[i] }) {
+            caching_device_t *cache = l1;
+            while (cache->get_parent() != nullptr && !cache->get_parent()->is_shared())
+                cache = cache->get_parent();
+            if (cache->get_parent() != nullptr)
+                cache->set_shared_request_log(&core_logs_[i]);
+        }
+    }
+    return "";
+}
+
+void
+cache_simulator_t::publish_shared_requests(int core, uint64_t progress, bool done)
+{
+    std::vector<shared_request_t> &logged = core_logs_[core].get_requests();
+    std::lock_guard<std::mutex> guard(shared_caches_mutex_);
+    pending_requests_[core].insert(pending_requests_[core].end(), logged.begin(),
+                                   logged.end());
+    logged.clear();
+    core_progress_[core] = progress;
+    if (done)
+        core_done_[core] = true;
+    replay_shared_requests();
+}
+
+void
+cache_simulator_t::replay_shared_requests()
+{
+    // Any further request from core c has an ordinal of at least core_progress_[c],
+    // and requests with equal ordinals are replayed in core order.  Thus the
+    // earliest pending request can be replayed once it precedes the
+    // (progress, core) pair of every core that is not done.
+    while (true) {
+        int next = -1;
+        for (int c = 0; c < static_cast<int>(pending_requests_.size()); c++) {
+            if (!pending_requests_[c].empty() &&
+                (next == -1 ||
+                 pending_requests_[c].front().ordinal <
+                     pending_requests_[next].front().ordinal))
+                next = c;
+        }
+        if (next == -1)
+            return;
+        const shared_request_t &request = pending_requests_[next].front();
+        for (int c = 0; c < static_cast<int>(core_done_.size()); c++) {
+            if (!core_done_[c] &&
+                !(std::make_pair(request.ordinal, next) <
+                  std::make_pair(core_progress_[c], c)))
+                return;
+        }
+        if (request.in_sample_window) {
+            caching_device_t *llc = request.requester;
+            while (llc->get_parent() != nullptr)
+                llc = llc->get_parent();
+            int64_t misses = llc->get_stats()->get_metric(metric_name_t::MISSES);
+            request.requester->replay_shared_request(request.memref, request.is_flush);
+            shared_window_misses_[llc] +=
+                llc->get_stats()->get_metric(metric_name_t::MISSES) - misses;
+        } else
+            request.requester->replay_shared_request(request.memref, request.is_flush);
+        pending_requests_[next].pop_front();
+    }
+}
+
+void *
+cache_simulator_t::parallel_worker_init(int worker_index)
+{
+    // For core-sharded analysis, worker i simulates core i.
+    return new int(worker_index);
+}
+
+std::string
+cache_simulator_t::parallel_worker_exit(void *worker_data)
+{
+    int *core = reinterpret_cast<int *>(worker_data);
+    // A core whose worker never received any input must not hold back the
+    // replay of the other cores' requests.
+    if (!core_logs_.empty() && *core >= 0 && *core < static_cast<int>(knobs_.num_cores))
+        publish_shared_requests(*core, 0, true);
+    delete core;
+    return "";
+}
+
+void *
+cache_simulator_t::parallel_shard_init_stream(int shard_index, void *worker_data,
+                                              memtrace_stream_t *shard_stream)
+{
+    core_shard_t *shard = new core_shard_t;
+    shard->core = shard_index;
+    if (shard_index < 0 || shard_index >= static_cast<int>(knobs_.num_cores)) {
+        shard->error = "Core-sharded shard " + std::to_string(shard_index) +
+            " exceeds the simulated core count";
+    }
+    std::lock_guard<std::mutex> guard(shard_map_mutex_);
+    shard_map_[shard_index] = shard;
+    return reinterpret_cast<void *>(shard);
+}
+
+bool
+cache_simulator_t::parallel_shard_exit(void *shard_data)
+{
+    core_shard_t *shard = reinterpret_cast<core_shard_t *>(shard_data);
+    if (!shard->error.empty())
+        return false;
+    // Only this shard's thread touches its core's entry.
+    thread_ever_counts_[shard->core] = static_cast<int>(shard->tids.size());
+    if (shard->sample_counts.sampled) {
+        std::lock_guard<std::mutex> guard(shard_map_mutex_);
+        sample_counts_.sampled = true;
+        sample_counts_.windows += shard->sample_counts.windows;
+        sample_counts_.skipped_instrs += shard->sample_counts.skipped_instrs;
+        sample_counts_.window_instrs += shard->sample_counts.window_instrs;
+        sample_counts_.warmup_instrs += shard->sample_counts.warmup_instrs;
+        for (const auto &it : shard->sample_counts.window_misses)
+            sample_counts_.window_misses[it.first] += it.second;
+    }
+    for (caching_device_t *cache = l1_icaches_[shard->core];
+         cache != nullptr && !cache->is_shared(); cache = cache->get_parent())
+        cache->flush_deferred_child_hits();
+    if (l1_dcaches_[shard->core] != l1_icaches_[shard->core]) {
+        for (caching_device_t *cache = l1_dcaches_[shard->core];
+             cache != nullptr && !cache->is_shared(); cache = cache->get_parent())
+            cache->flush_deferred_child_hits();
+    }
+    publish_shared_requests(shard->core, shard->ordinal, true);
+    return true;
+}
+
+bool
+cache_simulator_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
+{
+    core_shard_t *shard = reinterpret_cast<core_shard_t *>(shard_data);
+    if (!shard->error.empty())
+        return false;
+    if (memref.marker.type == TRACE_TYPE_MARKER) {
+        if (memref.marker.marker_type == TRACE_MARKER_TYPE_SAMPLE_WINDOW ||
+            memref.marker.marker_type == TRACE_MARKER_TYPE_SAMPLE_SKIP) {
+            std::lock_guard<std::mutex> guard(shard_map_mutex_);
+            bool in_window = update_window_tids(memref);
+            if (memref.marker.tid == shard->last_tid)
+                shard->in_window = in_window;
+        }
+        count_sampling(memref, false, shard->sample_counts);
+        return true;
+    }
+    if (shard->tids.empty() || memref.data.tid != shard->last_tid) {
+        shard->tids.insert(memref.data.tid);
+        shard->last_tid = memref.data.tid;
+        // The thread may have entered a window while running on another core.
+        std::lock_guard<std::mutex> guard(shard_map_mutex_);
+        shard->in_window = window_tids_.count(memref.data.tid) > 0;
+    }
+    if (shard->sample_counts.sampled || shard->in_window)
+        count_sampling(memref, shard->in_window, shard->sample_counts);
+    core_logs_[shard->core].set_ordinal(shard->ordinal++);
+    core_logs_[shard->core].set_in_sample_window(shard->in_window);
+    if (!(shard->in_window ? simulate_window_access(shard->core, memref,
+                                                    shard->sample_counts.window_misses)
+                           : simulate_access(shard->core, memref)) &&
+        memref.exit.type != TRACE_TYPE_THREAD_EXIT &&
+        memref.instr.type != TRACE_TYPE_INSTR_NO_FETCH) {
+        shard->error = "Unhandled memref type " + std::to_string(memref.data.type);
+        return false;
+    }
+    // We publish periodically to let the other cores' requests be replayed and to
+    // bound the memory held by the pending requests.
+    if (shard->ordinal % SHARED_REQUEST_PUBLISH_INTERVAL == 0)
+        publish_shared_requests(shard->core, shard->ordinal, false);
+    return true;
+}
+
+std::string
+cache_simulator_t::parallel_shard_error(void *shard_data)
+{
+    core_shard_t *shard = reinterpret_cast<core_shard_t *>(shard_data);
+    return shard->error;
+}
+
+void
+cache_simulator_t::count_sampling(const memref_t &memref, bool in_window,
+                                  sample_counts_t &counts)
+{
+    if (memref.marker.type == TRACE_TYPE_MARKER) {
+        if (memref.marker.marker_type == TRACE_MARKER_TYPE_SAMPLE_WINDOW) {
+            counts.sampled = true;
+            ++counts.windows;
+        } else if (memref.marker.marker_type == TRACE_MARKER_TYPE_SAMPLE_SKIP) {
+            counts.sampled = true;
+            counts.skipped_instrs += memref.marker.marker_value;
+        }
+    } else if (type_is_instr(memref.instr.type)) {
+        if (in_window)
+            ++counts.window_instrs;
+        else
+            ++counts.warmup_instrs;
+    }
+}
+
+bool
+cache_simulator_t::update_window_tids(const memref_t &memref)
+{
+    if (memref.marker.marker_type == TRACE_MARKER_TYPE_SAMPLE_WINDOW) {
+        window_tids_.insert(memref.marker.tid);
+        return true;
+    }
+    if (memref.marker.marker_type == TRACE_MARKER_TYPE_SAMPLE_SKIP)
+        window_tids_.erase(memref.marker.tid);
+    return false;
+}
+
+bool
+cache_simulator_t::simulate_window_access(
+    int core, const memref_t &simref,
+    std::unordered_map<caching_device_t *, int64_t> &window_misses)
+{
+    // The LLCs are the roots of the core's hierarchy, typically a single one.
+    caching_device_t *llcs[2] = { l1_icaches_[core], l1_dcaches_[core] };
+    int64_t misses[2] = { 0, 0 };
+    for (int i = 0; i < 2; i++) {
+        while (llcs[i]->get_parent() != nullptr)
+            llcs[i] = llcs[i]->get_parent();
+        if (llcs[i]->is_shared() || (i == 1 && llcs[1] == llcs[0]))
+            llcs[i] = nullptr;
+        else
+            misses[i] = llcs[i]->get_stats()->get_metric(metric_name_t::MISSES);
+    }
+    bool handled = simulate_access(core, simref);
+    for (int i = 0; i < 2; i++) {
+        if (llcs[i] != nullptr) {
+            window_misses[llcs[i]] +=
+                llcs[i]->get_stats()->get_metric(metric_name_t::MISSES) - misses[i];
+        }
+    }
+    return handled;
+}
+
+// A sampled trace only holds a fraction of the instructions: each window is
+// preceded by the warmup instructions kept to fill the caches, and by a marker
+// giving the count of those removed before them.  Only the windows represent the
+// program's behavior, so we scale the misses inside them by the ratio of all
+// instructions to window ones to estimate those of the whole trace.
+int64_t
+cache_simulator_t::get_extrapolated_misses(const std::string &llc_name) const
+{
+    auto llc_it = llcaches_.find(llc_name);
+    if (!sample_counts_.sampled || sample_counts_.window_instrs == 0 ||
+        llc_it == llcaches_.end())
+        return -1;
+    caching_device_t *llc = llc_it->second;
+    int64_t misses = 0;
+    auto misses_it = sample_counts_.window_misses.find(llc);
+    if (misses_it != sample_counts_.window_misses.end())
+        misses += misses_it->second;
+    misses_it = shared_window_misses_.find(llc);
+    if (misses_it != shared_window_misses_.end())
+        misses += misses_it->second;
+    double scale = static_cast<double>(sample_counts_.window_instrs +
+                                       sample_counts_.warmup_instrs +
+                                       sample_counts_.skipped_instrs) /
+        sample_counts_.window_instrs;
+    return static_cast<int64_t>(misses * scale);
+}
+
+void
+cache_simulator_t::print_sampling_extrapolation()
+{
+    if (sample_counts_.window_instrs == 0)
+        return;
+    double scale = static_cast<double>(sample_counts_.window_instrs +
+                                       sample_counts_.warmup_instrs +
+                                       sample_counts_.skipped_instrs) /
+        sample_counts_.window_instrs;
+    std::cerr << "Sampled trace extrapolation:\n";
+    std::cerr << "    " << std::setw(18) << std::left << "Windows:" << std::setw(20)
+              << std::right << sample_counts_.windows << std::endl;
+    std::cerr << "    " << std::setw(18) << std::left << "Window instrs:"
+              << std::setw(20) << std::right << sample_counts_.window_instrs
+              << std::endl;
+    std::cerr << "    " << std::setw(18) << std::left << "Warmup instrs:"
+              << std::setw(20) << std::right << sample_counts_.warmup_instrs
+              << std::endl;
+    std::cerr << "    " << std::setw(18) << std::left << "Removed instrs:"
+              << std::setw(20) << std::right << sample_counts_.skipped_instrs
+              << std::endl;
+    std::cerr << "    " << std::setw(18) << std::left << "Scale factor:" << std::setw(20)
+              << std::right << std::fixed << std::setprecision(2) << scale << std::endl;
+    for (auto &caches_it : llcaches_) {
+        std::cerr << "    " << std::setw(18) << std::left
+                  << (caches_it.first + " est. misses:") << std::setw(20)
+                  << std::right << get_extrapolated_misses(caches_it.first)
+                  << std::endl;
+    }
+}
+
 // Return true if the number of warmup references have been executed or if
 // specified fraction of the llcaches_ has been loaded. Also return true if the
 // cache has already been warmed up. When there are multiple last level caches
@@ -585,6 +1042,12 @@ cache_simulator_t::check_warmed_up()
 bool
 cache_simulator_t::print_results()
 {
+    if (!core_logs_.empty()) {
+        // Replay whatever is left should a worker have exited early.
+        std::lock_guard<std::mutex> guard(shared_caches_mutex_);
+        core_done_.assign(core_done_.size(), true);
+        replay_shared_requests();
+    }
     std::cerr << "Cache simulation results:\n";
     // Print core and associated L1 cache stats first.
     for (unsigned int i = 0; i < knobs_.num_cores; i++) {
@@ -602,6 +1065,8 @@ cache_simulator_t::print_results()
                           << l1_icaches_[i]->get_description() << ") stats:" << std::endl;
                 l1_icaches_[i]->get_stats()->print_stats("    ");
             }
+            if (timing_ != nullptr)
+                timing_->print_core_stats(i, "  ");
         }
     }
 
@@ -623,6 +1088,12 @@ cache_simulator_t::print_results()
         snoop_filter_->print_stats();
     }
 
+    if (timing_ != nullptr)
+        timing_->print_memory_stats("");
+
+    if (sample_counts_.sampled)
+        print_sampling_extrapolation();
+
     return true;
 }
 
@@ -667,6 +1138,31 @@ cache_simulator_t::get_knobs() const
     return knobs_;
 }
 
+bool
+cache_simulator_t::access_shared(int core, const memref_t &memref, int *level)
+{
+    if (level == nullptr)
+        return simulate_access(core, memref);
+    caching_device_t *l1 = type_is_instr(memref.instr.type)
+        ? static_cast<caching_device_t *>(l1_icaches_[core])
+        : static_cast<caching_device_t *>(l1_dcaches_[core]);
+    std::vector<int64_t> hits;
+    for (caching_device_t *cache = l1; cache != nullptr; cache = cache->get_parent())
+        hits.push_back(cache->get_stats()->get_metric(metric_name_t::HITS));
+    if (!simulate_access(core, memref))
+        return false;
+    *level = 0;
+    int depth = 1;
+    for (caching_device_t *cache = l1; cache != nullptr;
+         cache = cache->get_parent(), ++depth) {
+        if (cache->get_stats()->get_metric(metric_name_t::HITS) != hits[depth - 1]) {
+            *level = depth;
+            break;
+        }
+    }
+    return true;
+}
+
 cache_t *
 cache_simulator_t::create_cache(const std::string &name, const std::string &policy)
 {
@@ -677,10 +1173,23 @@ cache_simulator_t::create_cache(const std::string &name, const std::string &poli
         return new cache_t(name);
     if (policy == REPLACE_POLICY_FIFO) // set to FIFO
         return new cache_fifo_t(name);
+    if (policy == REPLACE_POLICY_PLRU)
+        return new cache_plru_t(name);
+    if (policy == REPLACE_POLICY_SRRIP)
+        return new cache_rrip_t(name, cache_rrip_t::RRIP_STATIC);
+    if (policy == REPLACE_POLICY_BRRIP)
+        return new cache_rrip_t(name, cache_rrip_t::RRIP_BIMODAL);
+    if (policy == REPLACE_POLICY_DRRIP)
+        return new cache_rrip_t(name, cache_rrip_t::RRIP_DYNAMIC);
+    if (policy == REPLACE_POLICY_SHIP)
+        return new cache_ship_t(name);
 
     // undefined replacement policy
     ERRMSG("Usage error: undefined replacement policy. "
-           "Please choose " REPLACE_POLICY_LRU " or " REPLACE_POLICY_LFU ".\n");
+           "Please choose " REPLACE_POLICY_LRU ", " REPLACE_POLICY_LFU
+           ", " REPLACE_POLICY_FIFO ", " REPLACE_POLICY_PLRU ", " REPLACE_POLICY_SRRIP
+           ", " REPLACE_POLICY_BRRIP ", " REPLACE_POLICY_DRRIP
+           ", or " REPLACE_POLICY_SHIP ".\n");
     return NULL;
 }
 
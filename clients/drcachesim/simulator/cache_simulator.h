@@ -39,13 +39,18 @@
 #include <limits.h>
 #include <stdint.h>
 
+#include <deque>
 #include <istream>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "cache.h"
 #include "cache_simulator_create.h"
 #include "cache_stats.h"
+#include "cache_timing.h"
 #include "simulator.h"
 #include "snoop_filter.h"
 
@@ -82,6 +87,35 @@ public:
     bool
     print_results() override;
 
+    // With the parallel_cores knob set, each core's private caches are simulated
+    // in parallel by the worker thread owning that core's shard.  The requests
+    // the private caches send to caches shared among cores are logged and
+    // replayed into the shared caches in the order of a serial simulation which
+    // interleaves the cores one trace record at a time, so the results for a
+    // given schedule are deterministic and identical to that serial simulation.
+    // Hierarchies where a core's private results depend on other cores
+    // (coherence, inclusive shared caches, shared L1 caches) and the timing
+    // model do not support this and are simulated serially.
+    bool
+    parallel_shard_supported() override;
+    std::string
+    initialize_stream(memtrace_stream_t *serial_stream) override;
+    std::string
+    initialize_shard_type(shard_type_t shard_type) override;
+    void *
+    parallel_worker_init(int worker_index) override;
+    std::string
+    parallel_worker_exit(void *worker_data) override;
+    void *
+    parallel_shard_init_stream(int shard_index, void *worker_data,
+                               memtrace_stream_t *shard_stream) override;
+    bool
+    parallel_shard_exit(void *shard_data) override;
+    bool
+    parallel_shard_memref(void *shard_data, const memref_t &memref) override;
+    std::string
+    parallel_shard_error(void *shard_data) override;
+
     int64_t
     get_cache_metric(metric_name_t metric, unsigned level, unsigned core = 0,
                      cache_split_t split = cache_split_t::DATA) const;
@@ -95,11 +129,111 @@ public:
     const cache_simulator_knobs_t &
     get_knobs() const;
 
+    // Simulates an access on behalf of another simulator sharing this hierarchy,
+    // such as the page walks of the TLB simulator, bypassing the skip and warmup
+    // accounting of process_memref().  If "level" is non-null it is set to the
+    // cache level that supplied the data, counting from 1 for the L1, or to 0 if
+    // it came from memory.  With a prefetcher, a prefetch hit in an outer level
+    // may be credited for a demand miss.  Returns false for an unhandled type.
+    bool
+    access_shared(int core, const memref_t &memref, int *level = nullptr);
+
+    // For a trace sampled by record_filter, returns the misses of the LLC named
+    // "llc_name" extrapolated to the whole trace from those inside the sampled
+    // windows, or -1 if the trace is not sampled or there is no such LLC.
+    int64_t
+    get_extrapolated_misses(const std::string &llc_name) const;
+
+    // Returns the timing model, which is null unless the timing knob is set.
+    const cache_timing_t *
+    get_timing() const
+    {
+        return timing_;
+    }
+
 protected:
+    // What the markers of a trace sampled by record_filter report, for
+    // extrapolating the results to the whole trace.
+    struct sample_counts_t {
+        bool sampled = false;
+        uint64_t windows = 0;
+        uint64_t skipped_instrs = 0;
+        // The instructions simulated once sampling markers were seen, inside the
+        // windows and in the warmup regions before them.
+        uint64_t window_instrs = 0;
+        uint64_t warmup_instrs = 0;
+        // The misses of each LLC caused by accesses inside windows.
+        std::unordered_map<caching_device_t *, int64_t> window_misses;
+    };
+
+    struct core_shard_t {
+        int core = 0;
+        // The distinct software threads run on this core, for print_core().
+        std::unordered_set<memref_tid_t> tids;
+        memref_tid_t last_tid = 0;
+        std::string error;
+        sample_counts_t sample_counts;
+        // Whether last_tid is inside a window of a sampled trace.
+        bool in_window = false;
+        // The ordinal of the next cache access or flush on this core.
+        uint64_t ordinal = 0;
+    };
+
+    // Updates "counts" for "memref" if it is a sampling marker or an instruction,
+    // where "in_window" says whether its thread is inside a window.
+    static void
+    count_sampling(const memref_t &memref, bool in_window, sample_counts_t &counts);
+
+    // Updates window_tids_ for "memref" if it is a sampling marker.  Returns whether
+    // it starts or ends a window.
+    bool
+    update_window_tids(const memref_t &memref);
+
+    // Like simulate_access() for an access inside a window of a sampled trace,
+    // also adding the misses it causes in the LLCs of "core" to "window_misses".
+    // A shared LLC in parallel operation is left to replay_shared_requests().
+    bool
+    simulate_window_access(
+        int core, const memref_t &simref,
+        std::unordered_map<caching_device_t *, int64_t> &window_misses);
+
+    void
+    print_sampling_extrapolation();
+
     // Create a cache_t object with a specific replacement policy.
     virtual cache_t *
     create_cache(const std::string &name, const std::string &policy);
 
+    // Sends an access or flush to the L1 caches of "core".  Returns false if
+    // "simref" is neither.
+    bool
+    simulate_access(int core, const memref_t &simref);
+
+    // Finds the caches reachable from more than one core.  Returns false if
+    // a core's private cache results could depend on the other cores.
+    bool
+    find_shared_caches(std::unordered_set<caching_device_t *> &shared);
+
+    // Marks caches reachable from more than one core as shared for parallel
+    // simulation and has their private children log requests to them.
+    std::string
+    init_core_sharded();
+
+    // Hands the requests "core" logged so far over for replay, where "progress"
+    // is the ordinal of the core's next record and "done" indicates that there
+    // are no further records.
+    void
+    publish_shared_requests(int core, uint64_t progress, bool done);
+    // Replays every pending request which no request yet to come can precede.
+    // The caller must hold shared_caches_mutex_.
+    void
+    replay_shared_requests();
+
+    // Resolves the structure of the hierarchy once every cache has been added
+    // to timing_.
+    bool
+    init_timing();
+
     cache_simulator_knobs_t knobs_;
 
     // Implement a set of ICaches and DCaches with pointer arrays.
@@ -120,6 +254,35 @@ protected:
     // Snoop filter tracks ownership of cache lines across private caches.
     snoop_filter_t *snoop_filter_ = nullptr;
 
+    cache_timing_t *timing_ = nullptr;
+
+    // For parallel simulation with the parallel_cores knob.
+    // Set when the analyzer runs us serially, where the shared requests must not
+    // be logged as nothing would publish them.
+    bool serial_operation_ = false;
+    std::unordered_map<int, core_shard_t *> shard_map_;
+    std::mutex shard_map_mutex_;
+    // Guards the shared portion of the hierarchy and the replay state below.
+    std::mutex shared_caches_mutex_;
+    // How many records a core simulates between hand-overs of its logged requests.
+    static constexpr uint64_t SHARED_REQUEST_PUBLISH_INTERVAL = 4096;
+    // Each core's log is only touched by the thread simulating the core.
+    std::vector<shared_request_log_t> core_logs_;
+    // Published requests not yet replayed, per core.
+    std::vector<std::deque<shared_request_t>> pending_requests_;
+    // Each core's ordinal below which all of its requests have been published.
+    std::vector<uint64_t> core_progress_;
+    std::vector<bool> core_done_;
+
+    // Guarded by shard_map_mutex_ in parallel operation.
+    sample_counts_t sample_counts_;
+    // The threads whose trace is currently inside a window.  Guarded by
+    // shard_map_mutex_ in parallel operation.
+    std::unordered_set<memref_tid_t> window_tids_;
+    // The window misses of shared LLCs in parallel operation, which arise as the
+    // logged requests are replayed.  Guarded by shared_caches_mutex_.
+    std::unordered_map<caching_device_t *, int64_t> shared_window_misses_;
+
 private:
     bool is_warmed_up_;
 };
@@ -71,6 +71,18 @@ struct cache_simulator_knobs_t {
         , sim_refs(1ULL << 63)
         , cpu_scheduling(false)
         , use_physical(false)
+        , parallel_cores(false)
+        , timing(false)
+        , L1_latency(4)
+        , LL_latency(40)
+        , L1_mshrs(16)
+        , LL_mshrs(64)
+        , rob_size(224)
+        , dram_banks(16)
+        , dram_bytes_per_cycle(8)
+        , dram_row_hit_latency(60)
+        , dram_row_miss_latency(150)
+        , timing_interval(0)
         , verbose(0)
     {
     }
@@ -92,6 +104,18 @@ struct cache_simulator_knobs_t {
     uint64_t sim_refs;
     bool cpu_scheduling;
     bool use_physical;
+    bool parallel_cores;
+    bool timing;
+    unsigned int L1_latency;
+    unsigned int LL_latency;
+    unsigned int L1_mshrs;
+    unsigned int LL_mshrs;
+    unsigned int rob_size;
+    unsigned int dram_banks;
+    unsigned int dram_bytes_per_cycle;
+    unsigned int dram_row_hit_latency;
+    unsigned int dram_row_miss_latency;
+    uint64_t timing_interval;
     unsigned int verbose;
 };
 
@@ -0,0 +1,478 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "cache_timing.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <locale>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cache_simulator_create.h"
+#include "caching_device.h"
+#include "memref.h"
+#include "trace_entry.h"
+#include "utils.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+constexpr unsigned int dram_t::ROW_BYTES;
+constexpr int cache_timing_t::FILL_TABLE_SIZE;
+
+thread_local cache_timing_t::core_t *cache_timing_t::current_core_ = nullptr;
+
+dram_t::dram_t(unsigned int banks, unsigned int line_size, unsigned int bytes_per_cycle,
+               unsigned int row_hit_latency, unsigned int row_miss_latency,
+               uint64_t skew_limit)
+    : banks_(std::max(banks, 1u))
+    , line_size_(line_size)
+    , lines_per_row_(std::max(ROW_BYTES / line_size, 1u))
+    , transfer_cycles_(
+          std::max((line_size + bytes_per_cycle - 1) / std::max(bytes_per_cycle, 1u), 1u))
+    , row_hit_latency_(row_hit_latency)
+    , row_miss_latency_(std::max(row_miss_latency, row_hit_latency))
+    , skew_limit_(skew_limit)
+{
+}
+
+uint64_t
+dram_t::access(addr_t addr, uint64_t time, int core)
+{
+    addr_t line = addr / line_size_;
+    bank_t &bank = banks_[line % banks_.size()];
+    addr_t row = line / banks_.size() / lines_per_row_;
+    uint64_t start = timing_slot_start(bank.slot, core, time, skew_limit_);
+    uint64_t latency = row_hit_latency_;
+    if (bank.open_row == row)
+        ++row_hits_;
+    else {
+        if (bank.open_row != NO_ROW)
+            ++row_conflicts_;
+        latency = row_miss_latency_;
+        bank.open_row = row;
+    }
+    // The bank can take the next column access once this one's data leaves it,
+    // while a row change keeps it busy for the precharge and activate as well.
+    bank.slot.ready = start + latency - row_hit_latency_ + transfer_cycles_;
+    bank.slot.core = core;
+    uint64_t data = start + latency;
+    uint64_t bus_start = timing_slot_start(bus_, core, data, skew_limit_);
+    bus_.ready = bus_start + transfer_cycles_;
+    bus_.core = core;
+    ++reads_;
+    queue_cycles_ += (start - time) + (bus_start - data);
+    bus_cycles_ += transfer_cycles_;
+    return bus_.ready;
+}
+
+void
+dram_t::reset_stats()
+{
+    reads_ = 0;
+    row_hits_ = 0;
+    row_conflicts_ = 0;
+    queue_cycles_ = 0;
+    bus_cycles_ = 0;
+}
+
+cache_timing_t::cache_timing_t(const cache_simulator_knobs_t &knobs)
+    : cores_(knobs.num_cores)
+    , dram_(knobs.dram_banks, knobs.line_size, knobs.dram_bytes_per_cycle,
+            knobs.dram_row_hit_latency, knobs.dram_row_miss_latency,
+            static_cast<uint64_t>(knobs.dram_banks) * knobs.dram_row_miss_latency)
+    , line_size_(knobs.line_size)
+    , line_bits_(compute_log2(static_cast<int>(knobs.line_size)))
+    , rob_size_(knobs.rob_size)
+    , bytes_per_cycle_(std::max(knobs.dram_bytes_per_cycle, 1u))
+    , interval_(knobs.timing_interval)
+    , skew_limit_(static_cast<uint64_t>(knobs.dram_banks) * knobs.dram_row_miss_latency)
+{
+    for (core_t &core : cores_) {
+        core.fills.resize(FILL_TABLE_SIZE);
+        core.interval_end = interval_;
+    }
+}
+
+void
+cache_timing_t::add_device(caching_device_t *device, unsigned int latency,
+                           unsigned int mshrs)
+{
+    device->set_miss_observer(this, static_cast<int>(devices_.size()));
+    devices_.push_back({ device, -1, latency, std::vector<timing_slot_t>(mshrs) });
+}
+
+bool
+cache_timing_t::init(const std::vector<caching_device_t *> &l1_icaches,
+                     const std::vector<caching_device_t *> &l1_dcaches)
+{
+    std::unordered_map<caching_device_t *, int> ids;
+    for (size_t i = 0; i < devices_.size(); ++i)
+        ids[devices_[i].device] = static_cast<int>(i);
+    for (device_t &device : devices_) {
+        caching_device_t *parent = device.device->get_parent();
+        if (parent == nullptr)
+            continue;
+        auto it = ids.find(parent);
+        if (it == ids.end())
+            return false;
+        device.parent = it->second;
+    }
+    if (l1_icaches.size() != cores_.size() || l1_dcaches.size() != cores_.size())
+        return false;
+    for (size_t i = 0; i < cores_.size(); ++i) {
+        auto icache = ids.find(l1_icaches[i]);
+        auto dcache = ids.find(l1_dcaches[i]);
+        if (icache == ids.end() || dcache == ids.end())
+            return false;
+        cores_[i].l1i = icache->second;
+        cores_[i].l1d = dcache->second;
+    }
+    return true;
+}
+
+void
+cache_timing_t::begin_access(int core)
+{
+    current_core_ = &cores_[core];
+}
+
+void
+cache_timing_t::on_miss(int id, addr_t tag, bool is_prefetch)
+{
+    if (current_core_ != nullptr)
+        current_core_->misses.push_back({ id, tag, is_prefetch });
+}
+
+void
+cache_timing_t::end_access(int core_index, const memref_t &memref)
+{
+    current_core_ = nullptr;
+    core_t &core = cores_[core_index];
+    bool is_fetch = type_is_instr(memref.instr.type);
+    if (is_fetch) {
+        ++core.counts.instrs;
+        ++core.instr_ordinal;
+        ++core.clock;
+        // The fetch needs a slot in the window, which the oldest loads may hold.
+        while (!core.pending_loads.empty() &&
+               core.pending_loads.front().instr + rob_size_ <= core.instr_ordinal) {
+            core.clock = std::max(core.clock, core.pending_loads.front().ready);
+            core.pending_loads.pop_front();
+        }
+    }
+    const device_t &l1 = devices_[is_fetch ||
+                                          memref.instr.type == TRACE_TYPE_PREFETCH_INSTR
+                                      ? core.l1i
+                                      : core.l1d];
+    uint64_t now = core.clock;
+    uint64_t ready = now + l1.latency;
+    if (core.misses.empty()) {
+        addr_t tag = memref.data.addr >> line_bits_;
+        fill_t &fill = find_fill(core, tag);
+        if (fill.tag == tag) {
+            if (fill.prefetched && !type_is_prefetch(memref.data.type)) {
+                fill.prefetched = false;
+                if (fill.ready > now)
+                    ++core.counts.late_prefetches;
+                else
+                    ++core.counts.timely_prefetches;
+            }
+            ready = std::max(ready, fill.ready);
+        }
+    } else {
+        ready = std::max(ready, process_misses(core_index, now));
+        core.misses.clear();
+    }
+    uint64_t latency = ready - now;
+    if (is_fetch) {
+        ++core.counts.fetches;
+        core.counts.fetch_cycles += latency;
+        // Hit latency is hidden by the pipeline.
+        core.clock += latency - l1.latency;
+        if (interval_ > 0 && core.clock >= core.interval_end)
+            end_intervals(core);
+    } else if (memref.data.type == TRACE_TYPE_READ ||
+               memref.data.type == TRACE_TYPE_WRITE) {
+        ++core.counts.data_accesses;
+        core.counts.data_cycles += latency;
+        if (memref.data.type == TRACE_TYPE_READ && latency > l1.latency)
+            core.pending_loads.push_back({ ready, core.instr_ordinal });
+    }
+}
+
+size_t
+cache_timing_t::first_free_mshr(const device_t &device)
+{
+    size_t first = 0;
+    for (size_t i = 1; i < device.mshrs.size(); ++i) {
+        if (device.mshrs[i].ready < device.mshrs[first].ready)
+            first = i;
+    }
+    return first;
+}
+
+uint64_t
+cache_timing_t::process_misses(int core_index, uint64_t now)
+{
+    core_t &core = cores_[core_index];
+    uint64_t demand_ready = 0;
+    const std::vector<miss_t> &misses = core.misses;
+    size_t start = 0;
+    while (start < misses.size()) {
+        // Group the misses of one block from a device outward through its
+        // ancestors.
+        const miss_t &first = misses[start];
+        size_t end = start + 1;
+        while (end < misses.size() && misses[end].tag == first.tag &&
+               misses[end].is_prefetch == first.is_prefetch &&
+               misses[end].id == devices_[misses[end - 1].id].parent)
+            ++end;
+        uint64_t issue = now;
+        for (size_t i = start; i < end; ++i) {
+            const device_t &device = devices_[misses[i].id];
+            if (device.mshrs.empty())
+                continue;
+            issue = std::max(issue,
+                             timing_slot_start(device.mshrs[first_free_mshr(device)],
+                                               core_index, now, skew_limit_));
+        }
+        core.counts.mshr_stall_cycles += issue - now;
+        const device_t &last = devices_[misses[end - 1].id];
+        uint64_t ready;
+        if (last.parent < 0) {
+            ready =
+                dram_.access(first.tag << line_bits_, issue + last.latency, core_index);
+            ++core.counts.dram_reads;
+        } else
+            ready = issue + devices_[last.parent].latency;
+        for (size_t i = start; i < end; ++i) {
+            device_t &device = devices_[misses[i].id];
+            if (device.mshrs.empty())
+                continue;
+            timing_slot_t &mshr = device.mshrs[first_free_mshr(device)];
+            mshr.ready = ready;
+            mshr.core = core_index;
+        }
+        if (first.is_prefetch)
+            ++core.counts.prefetches;
+        else
+            demand_ready = std::max(demand_ready, ready);
+        if (first.id == core.l1i || first.id == core.l1d) {
+            fill_t &fill = find_fill(core, first.tag);
+            fill.tag = first.tag;
+            fill.ready = ready;
+            fill.prefetched = first.is_prefetch;
+        }
+        start = end;
+    }
+    return demand_ready;
+}
+
+void
+cache_timing_t::subtract(counts_t &counts, const counts_t &base)
+{
+    counts.instrs -= base.instrs;
+    counts.fetches -= base.fetches;
+    counts.fetch_cycles -= base.fetch_cycles;
+    counts.data_accesses -= base.data_accesses;
+    counts.data_cycles -= base.data_cycles;
+    counts.mshr_stall_cycles -= base.mshr_stall_cycles;
+    counts.prefetches -= base.prefetches;
+    counts.timely_prefetches -= base.timely_prefetches;
+    counts.late_prefetches -= base.late_prefetches;
+    counts.dram_reads -= base.dram_reads;
+}
+
+void
+cache_timing_t::end_intervals(core_t &core)
+{
+    // A long stall can span several intervals, the later ones being empty.
+    while (core.clock >= core.interval_end) {
+        interval_t interval = { core.interval_end, core.counts };
+        subtract(interval.counts, core.interval_start);
+        core.intervals.push_back(interval);
+        core.interval_start = core.counts;
+        core.interval_end += interval_;
+    }
+}
+
+void
+cache_timing_t::reset_stats()
+{
+    for (core_t &core : cores_) {
+        core.counts = counts_t();
+        core.start_clock = core.clock;
+        core.interval_start = counts_t();
+        core.interval_end = core.clock + interval_;
+        core.intervals.clear();
+    }
+    dram_.reset_stats();
+}
+
+uint64_t
+cache_timing_t::get_cycles(int core_index) const
+{
+    const core_t &core = cores_[core_index];
+    uint64_t end = core.clock;
+    for (const pending_load_t &load : core.pending_loads)
+        end = std::max(end, load.ready);
+    return end - core.start_clock;
+}
+
+double
+cache_timing_t::get_amat(int core) const
+{
+    const counts_t &counts = cores_[core].counts;
+    if (counts.data_accesses == 0)
+        return 0.;
+    return static_cast<double>(counts.data_cycles) / counts.data_accesses;
+}
+
+void
+cache_timing_t::print_core_stats(int core_index, const std::string &prefix) const
+{
+    const core_t &core = cores_[core_index];
+    const counts_t &counts = core.counts;
+    uint64_t cycles = get_cycles(core_index);
+    std::cerr.imbue(std::locale(""));
+    std::cerr << prefix << "Timing stats:" << std::endl;
+    std::cerr << prefix << "  " << std::setw(18) << std::left
+              << "Instructions:" << std::setw(20) << std::right << counts.instrs
+              << std::endl;
+    std::cerr << prefix << "  " << std::setw(18) << std::left << "Cycles:"
+              << std::setw(20) << std::right << cycles << std::endl;
+    std::cerr << std::fixed << std::setprecision(2);
+    std::cerr << prefix << "  " << std::setw(18) << std::left << "IPC:"
+              << std::setw(20) << std::right
+              << (cycles == 0 ? 0. : static_cast<double>(counts.instrs) / cycles)
+              << std::endl;
+    std::cerr << prefix << "  " << std::setw(18) << std::left
+              << "Fetch latency:" << std::setw(20) << std::right
+              << (counts.fetches == 0
+                      ? 0.
+                      : static_cast<double>(counts.fetch_cycles) / counts.fetches)
+              << std::endl;
+    std::cerr << prefix << "  " << std::setw(18) << std::left << "Data AMAT:"
+              << std::setw(20) << std::right << get_amat(core_index) << std::endl;
+    std::cerr << prefix << "  " << std::setw(18) << std::left
+              << "MSHR stall cycles:" << std::setw(20) << std::right
+              << counts.mshr_stall_cycles << std::endl;
+    std::cerr << prefix << "  " << std::setw(18) << std::left
+              << "Prefetches:" << std::setw(20) << std::right << counts.prefetches
+              << std::endl;
+    std::cerr << prefix << "  " << std::setw(18) << std::left
+              << "Timely prefetches:" << std::setw(20) << std::right
+              << counts.timely_prefetches << std::endl;
+    std::cerr << prefix << "  " << std::setw(18) << std::left
+              << "Late prefetches:" << std::setw(20) << std::right
+              << counts.late_prefetches << std::endl;
+    std::cerr << prefix << "  " << std::setw(18) << std::left
+              << "DRAM reads:" << std::setw(20) << std::right << counts.dram_reads
+              << std::endl;
+    std::cerr << prefix << "  " << std::setw(18) << std::left
+              << "DRAM bytes/cycle:" << std::setw(20) << std::right
+              << (cycles == 0 ? 0.
+                              : static_cast<double>(counts.dram_reads) * line_size_ /
+                       cycles)
+              << std::endl;
+    std::cerr.imbue(std::locale("C"));
+    if (interval_ > 0)
+        print_intervals(core, prefix + "  ");
+}
+
+void
+cache_timing_t::print_intervals(const core_t &core, const std::string &prefix) const
+{
+    std::cerr << prefix << "Intervals of " << interval_ << " cycles:" << std::endl;
+    std::cerr << prefix << "  " << std::setw(16) << std::right << "End cycle"
+              << std::setw(14) << "Instructions" << std::setw(8) << "IPC"
+              << std::setw(11) << "Data AMAT" << std::setw(12) << "DRAM util"
+              << std::endl;
+    std::cerr << std::fixed;
+    std::vector<interval_t> intervals = core.intervals;
+    // Include the partial interval at the end.
+    interval_t last = { core.clock, core.counts };
+    subtract(last.counts, core.interval_start);
+    if (last.counts.instrs > 0)
+        intervals.push_back(last);
+    uint64_t begin = core.start_clock;
+    for (const interval_t &interval : intervals) {
+        const counts_t &counts = interval.counts;
+        double cycles = static_cast<double>(interval.end - begin);
+        begin = interval.end;
+        double amat = counts.data_accesses == 0
+            ? 0.
+            : static_cast<double>(counts.data_cycles) / counts.data_accesses;
+        // This core's share of the peak bandwidth.
+        double util = 100. * counts.dram_reads * line_size_ / (cycles * bytes_per_cycle_);
+        std::cerr << prefix << "  " << std::setw(16) << interval.end << std::setw(14)
+                  << counts.instrs << std::setw(8) << std::setprecision(2)
+                  << counts.instrs / cycles << std::setw(11)
+                  << amat << std::setw(11) << std::setprecision(1) << util << "%"
+                  << std::endl;
+    }
+}
+
+void
+cache_timing_t::print_memory_stats(const std::string &prefix) const
+{
+    uint64_t cycles = 0;
+    for (size_t i = 0; i < cores_.size(); ++i)
+        cycles = std::max(cycles, get_cycles(static_cast<int>(i)));
+    std::cerr.imbue(std::locale(""));
+    std::cerr << prefix << "DRAM timing stats:" << std::endl;
+    std::cerr << prefix << "    " << std::setw(18) << std::left << "Reads:"
+              << std::setw(20) << std::right << dram_.get_reads() << std::endl;
+    std::cerr << prefix << "    " << std::setw(18) << std::left << "Row buffer hits:"
+              << std::setw(20) << std::right << dram_.get_row_hits() << std::endl;
+    std::cerr << prefix << "    " << std::setw(18) << std::left << "Bank conflicts:"
+              << std::setw(20) << std::right << dram_.get_row_conflicts() << std::endl;
+    std::cerr << prefix << "    " << std::setw(18) << std::left << "Queueing cycles:"
+              << std::setw(20) << std::right << dram_.get_queue_cycles() << std::endl;
+    std::cerr << prefix << "    " << std::setw(18) << std::left << "Bus utilization:"
+              << std::setw(19) << std::right << std::fixed << std::setprecision(2)
+              << (cycles == 0 ? 0.
+                              : 100. * static_cast<double>(dram_.get_bus_cycles()) /
+                       cycles)
+              << "%" << std::endl;
+    std::cerr.imbue(std::locale("C"));
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -0,0 +1,346 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* cache_timing: an optional timing model layered on a cache hierarchy, with
+ * per-level latencies, miss status holding registers, and banked DRAM.
+ */
+
+#ifndef _CACHE_TIMING_H_
+#define _CACHE_TIMING_H_ 1
+
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "cache_simulator_create.h"
+#include "caching_device.h"
+#include "memref.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// When a resource is next free and which core last claimed it.
+struct timing_slot_t {
+    uint64_t ready = 0;
+    int core = -1;
+};
+
+// Returns when a request by "core" at cycle "time" may use "slot".  A slot
+// claimed by another core until well after "time" may only reflect that core's
+// clock running ahead, so the wait is then capped at "skew_limit" cycles.
+inline uint64_t
+timing_slot_start(const timing_slot_t &slot, int core, uint64_t time,
+                  uint64_t skew_limit)
+{
+    if (slot.ready <= time)
+        return time;
+    if (slot.core != core && slot.ready - time > skew_limit)
+        return time + skew_limit;
+    return slot.ready;
+}
+
+// Main memory as a set of banks sharing one data bus.  Lines are interleaved
+// across the banks, each of which keeps its most recently used row open: an
+// access to the open row only pays the column latency while any other row first
+// pays for a precharge and activate.  Every line then occupies the bus for
+// line_size / bytes_per_cycle cycles, which bounds the bandwidth.
+class dram_t {
+public:
+    // A request waits at most "skew_limit" cycles for a bank or the bus last
+    // claimed by another core (see cache_timing_t).
+    dram_t(unsigned int banks, unsigned int line_size, unsigned int bytes_per_cycle,
+           unsigned int row_hit_latency, unsigned int row_miss_latency,
+           uint64_t skew_limit);
+
+    // Returns the cycle by which the line holding "addr", requested by "core" at
+    // cycle "time", has crossed the bus.
+    uint64_t
+    access(addr_t addr, uint64_t time, int core);
+
+    void
+    reset_stats();
+
+    uint64_t
+    get_reads() const
+    {
+        return reads_;
+    }
+    uint64_t
+    get_row_hits() const
+    {
+        return row_hits_;
+    }
+    // Accesses that found another row open in their bank.
+    uint64_t
+    get_row_conflicts() const
+    {
+        return row_conflicts_;
+    }
+    // Cycles requests spent waiting for a busy bank or the bus.
+    uint64_t
+    get_queue_cycles() const
+    {
+        return queue_cycles_;
+    }
+    uint64_t
+    get_bus_cycles() const
+    {
+        return bus_cycles_;
+    }
+
+private:
+    static constexpr unsigned int ROW_BYTES = 8192;
+    static constexpr addr_t NO_ROW = ~static_cast<addr_t>(0);
+
+    struct bank_t {
+        addr_t open_row = NO_ROW;
+        timing_slot_t slot;
+    };
+
+    std::vector<bank_t> banks_;
+    unsigned int line_size_;
+    unsigned int lines_per_row_;
+    uint64_t transfer_cycles_;
+    uint64_t row_hit_latency_;
+    uint64_t row_miss_latency_;
+    uint64_t skew_limit_;
+    timing_slot_t bus_;
+
+    uint64_t reads_ = 0;
+    uint64_t row_hits_ = 0;
+    uint64_t row_conflicts_ = 0;
+    uint64_t queue_cycles_ = 0;
+    uint64_t bus_cycles_ = 0;
+};
+
+// Estimates the cycles each core spends on its memory accesses by observing
+// which devices miss on each access the functional simulation performs.
+//
+// Each core retires one instruction per cycle unless stalled.  A device hit
+// costs that device's latency, and a miss is served by the first ancestor
+// holding the line, or by DRAM after the last-level latency.  A miss also needs
+// a miss status holding register (MSHR) at every device it misses in until the
+// data arrives, so when all of them are busy the miss waits for one to free up.
+// Instruction fetch misses stall the core.  Loads do not stall until the
+// instruction rob_size instructions later needs to be fetched, approximating
+// the overlap an out-of-order window provides, while stores never stall.
+// Lines filled into an L1 are remembered until they arrive, so an access to a
+// line still in flight waits for it: this is how late prefetches are detected.
+//
+// Each core keeps its own clock.  The cores' accesses are interleaved in trace
+// order rather than by their clocks, so the clocks drift apart.  A request
+// finding a shared MSHR, DRAM bank, or the bus claimed by another core until
+// well after the request's own time is assumed to come from a lagging core and
+// its wait is capped; contention among cores is thus approximate.
+class cache_timing_t : public miss_observer_t {
+public:
+    explicit cache_timing_t(const cache_simulator_knobs_t &knobs);
+
+    // Adds "device", which costs "latency" cycles per hit and has "mshrs"
+    // outstanding misses (0 for unlimited), and starts observing its misses.
+    // Every device reachable from the L1s must be added prior to init().
+    void
+    add_device(caching_device_t *device, unsigned int latency, unsigned int mshrs);
+
+    // Returns false if a device added has a parent that was not.
+    bool
+    init(const std::vector<caching_device_t *> &l1_icaches,
+         const std::vector<caching_device_t *> &l1_dcaches);
+
+    // Every request sent to an L1 of "core" is bracketed by these two calls.
+    void
+    begin_access(int core);
+    void
+    end_access(int core, const memref_t &memref);
+
+    void
+    on_miss(int id, addr_t tag, bool is_prefetch) override;
+
+    void
+    reset_stats();
+
+    void
+    print_core_stats(int core, const std::string &prefix) const;
+    void
+    print_memory_stats(const std::string &prefix) const;
+
+    // Accessors for the results of each core since the last reset.
+    uint64_t
+    get_instructions(int core) const
+    {
+        return cores_[core].counts.instrs;
+    }
+    // Includes waiting for the loads still outstanding.
+    uint64_t
+    get_cycles(int core) const;
+    // The average cycles per data access.
+    double
+    get_amat(int core) const;
+    uint64_t
+    get_mshr_stall_cycles(int core) const
+    {
+        return cores_[core].counts.mshr_stall_cycles;
+    }
+    uint64_t
+    get_prefetches(int core) const
+    {
+        return cores_[core].counts.prefetches;
+    }
+    uint64_t
+    get_timely_prefetches(int core) const
+    {
+        return cores_[core].counts.timely_prefetches;
+    }
+    uint64_t
+    get_late_prefetches(int core) const
+    {
+        return cores_[core].counts.late_prefetches;
+    }
+    const dram_t &
+    get_dram() const
+    {
+        return dram_;
+    }
+
+private:
+    struct device_t {
+        caching_device_t *device;
+        // The index of the parent, or -1 for memory.
+        int parent;
+        uint64_t latency;
+        std::vector<timing_slot_t> mshrs;
+    };
+
+    struct miss_t {
+        int id;
+        addr_t tag;
+        bool is_prefetch;
+    };
+
+    // A line filled into an L1, remembered until a later fill maps to its slot.
+    struct fill_t {
+        addr_t tag = TAG_INVALID;
+        uint64_t ready = 0;
+        // Set for a prefetched line until its first demand access.
+        bool prefetched = false;
+    };
+
+    // A load that completes after its L1 hit latency.
+    struct pending_load_t {
+        uint64_t ready;
+        uint64_t instr;
+    };
+
+    struct counts_t {
+        uint64_t instrs = 0;
+        uint64_t fetches = 0;
+        uint64_t fetch_cycles = 0;
+        uint64_t data_accesses = 0;
+        uint64_t data_cycles = 0;
+        uint64_t mshr_stall_cycles = 0;
+        uint64_t prefetches = 0;
+        uint64_t timely_prefetches = 0;
+        uint64_t late_prefetches = 0;
+        uint64_t dram_reads = 0;
+    };
+
+    struct interval_t {
+        uint64_t end;
+        counts_t counts;
+    };
+
+    struct core_t {
+        int l1i = -1;
+        int l1d = -1;
+        uint64_t clock = 0;
+        // Counts every instruction including those prior to a reset.
+        uint64_t instr_ordinal = 0;
+        uint64_t start_clock = 0;
+        std::deque<pending_load_t> pending_loads;
+        // The misses of the access in progress.
+        std::vector<miss_t> misses;
+        std::vector<fill_t> fills;
+        counts_t counts;
+        // For -timing_interval.
+        uint64_t interval_end = 0;
+        counts_t interval_start;
+        std::vector<interval_t> intervals;
+    };
+
+    static constexpr int FILL_TABLE_SIZE = 256;
+
+    fill_t &
+    find_fill(core_t &core, addr_t tag)
+    {
+        return core.fills[(tag ^ (tag >> 8)) & (FILL_TABLE_SIZE - 1)];
+    }
+
+    // Returns the index of the MSHR of "device" freed first.
+    static size_t
+    first_free_mshr(const device_t &device);
+
+    // Computes when each miss of the access in progress issued at "now" is
+    // served and returns the latest cycle at which demand data arrives, or 0 if
+    // every miss was a prefetch.
+    uint64_t
+    process_misses(int core_index, uint64_t now);
+
+    void
+    end_intervals(core_t &core);
+
+    static void
+    subtract(counts_t &counts, const counts_t &base);
+
+    void
+    print_intervals(const core_t &core, const std::string &prefix) const;
+
+    // The core whose access is in progress on this thread.
+    static thread_local core_t *current_core_;
+
+    std::vector<device_t> devices_;
+    std::vector<core_t> cores_;
+    dram_t dram_;
+    unsigned int line_size_;
+    int line_bits_;
+    uint64_t rob_size_;
+    uint64_t bytes_per_cycle_;
+    uint64_t interval_;
+    uint64_t skew_limit_;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _CACHE_TIMING_H_ */
@@ -35,19 +35,20 @@
 #include <assert.h>
 #include <stddef.h>
 
-#include <functional>
+#include <mutex>
 #include <string>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "memref.h"
 #include "caching_device_block.h"
+#include "caching_device_index.h"
 #include "caching_device_stats.h"
 #include "prefetcher.h"
 #include "snoop_filter.h"
 #include "trace_entry.h"
 #include "utils.h"
+#include "way_search.h"
 
 namespace dynamorio {
 namespace drmemtrace {
@@ -56,10 +57,6 @@ caching_device_t::caching_device_t(const std::string &name)
     : blocks_(NULL)
     , stats_(NULL)
     , prefetcher_(NULL)
-    // The tag being hashed is already right-shifted to the cache line and
-    // an identity hash is plenty good enough and nice and fast.
-    // We set the size and load factor only if being used, in set_hashtable_use().
-    , tag2block(0, [](addr_t key) { return static_cast<unsigned long>(key); })
     , name_(name)
 {
 }
@@ -111,8 +108,16 @@ caching_device_t::init(int associativity, int block_size, int num_blocks,
     snoop_filter_ = snoop_filter;
     coherent_cache_ = coherent_cache;
 
+    tags_.assign(num_blocks_, TAG_INVALID);
+    counters_.assign(num_blocks_, 0);
     blocks_ = new caching_device_block_t *[num_blocks_];
     init_blocks();
+    if (!hashtable_use_chosen_) {
+        use_tag2block_table_ = associativity_ >= INDEX_MIN_ASSOCIATIVITY &&
+            num_blocks_ <= INDEX_MAX_BLOCKS;
+    }
+    if (use_tag2block_table_)
+        tag2block.init(num_blocks_);
 
     last_tag_ = TAG_INVALID; // sentinel
 
@@ -136,19 +141,17 @@ std::pair<caching_device_block_t *, int>
 caching_device_t::find_caching_device_block(addr_t tag)
 {
     if (use_tag2block_table_) {
-        auto it = tag2block.find(tag);
-        if (it == tag2block.end())
+        const caching_device_index_t::entry_t *entry = tag2block.find(tag);
+        if (entry == nullptr)
             return std::make_pair(nullptr, 0);
-        assert(it->second.first->tag_ == tag);
-        return it->second;
+        assert(get_block_tag(compute_block_idx(tag), entry->way) == tag);
+        return std::make_pair(entry->block, entry->way);
     }
     int block_idx = compute_block_idx(tag);
-    for (int way = 0; way < associativity_; ++way) {
-        caching_device_block_t &block = get_caching_device_block(block_idx, way);
-        if (block.tag_ == tag)
-            return std::make_pair(&block, way);
-    }
-    return std::make_pair(nullptr, 0);
+    int way = find_way_with_tag(&tags_[block_idx], associativity_, tag);
+    if (way < 0)
+        return std::make_pair(nullptr, 0);
+    return std::make_pair(&get_caching_device_block(block_idx, way), way);
 }
 
 void
@@ -169,7 +172,7 @@ caching_device_t::request(const memref_t &memref_in)
         // Make sure last_tag_ is properly in sync.
         caching_device_block_t *cache_block =
             &get_caching_device_block(last_block_idx_, last_way_);
-        assert(tag != TAG_INVALID && tag == cache_block->tag_);
+        assert(tag != TAG_INVALID && tag == get_block_tag(last_block_idx_, last_way_));
         record_access_stats(memref_in, true /*hit*/, cache_block);
         access_update(last_block_idx_, last_way_);
         return;
@@ -207,17 +210,30 @@ caching_device_t::request(const memref_t &memref_in)
             caching_device_block_t *cache_block =
                 &get_caching_device_block(block_idx, way);
 
-            record_access_stats(memref, false /*miss*/, cache_block);
             missed = true;
-            // If no parent we assume we get the data from main memory
-            if (parent_ != NULL)
-                parent_->request(memref);
+            if (miss_observer_ != nullptr) {
+                miss_observer_->on_miss(miss_observer_id_, tag,
+                                        type_is_prefetch(memref.data.type));
+            }
+            if (shared_request_log_ != nullptr) {
+                record_access_stats(memref, false /*miss*/, cache_block);
+                shared_request_log_->add(this, memref, false /*!flush*/);
+            } else {
+                // Both the stats propagation and the request reach the parent.
+                std::unique_lock<std::mutex> parent_lock;
+                if (parent_ != NULL)
+                    parent_lock = parent_->lock_for_access_from(this);
+                record_access_stats(memref, false /*miss*/, cache_block);
+                // If no parent we assume we get the data from main memory
+                if (parent_ != NULL)
+                    parent_->request(memref);
+            }
             if (snoop_filter_ != NULL) {
                 // Update snoop filter, other private caches invalidated on write.
                 snoop_filter_->snoop(tag, id_, (memref.data.type == TRACE_TYPE_WRITE));
             }
 
-            addr_t victim_tag = cache_block->tag_;
+            addr_t victim_tag = get_block_tag(block_idx, way);
             // Check if we are inserting a new block, if we are then increment
             // the block loaded count.
             if (victim_tag == TAG_INVALID) {
@@ -254,7 +270,7 @@ caching_device_t::request(const memref_t &memref_in)
                     }
                 }
             }
-            update_tag(cache_block, way, tag);
+            update_tag(block_idx, way, tag);
         }
 
         access_update(block_idx, way);
@@ -281,7 +297,7 @@ void
 caching_device_t::access_update(int block_idx, int way)
 {
     // We just inc the counter for LFU.  We live with any blip on overflow.
-    get_caching_device_block(block_idx, way).counter_++;
+    get_block_counter(block_idx, way)++;
 }
 
 int
@@ -289,7 +305,7 @@ caching_device_t::replace_which_way(int block_idx)
 {
     int min_way = get_next_way_to_replace(block_idx);
     // Clear the counter for LFU.
-    get_caching_device_block(block_idx, min_way).counter_ = 0;
+    get_block_counter(block_idx, min_way) = 0;
     return min_way;
 }
 
@@ -299,19 +315,11 @@ caching_device_t::get_next_way_to_replace(const int block_idx) const
     // The base caching device class only implements LFU.
     // A subclass can override this and access_update() to implement
     // some other scheme.
-    int min_counter = 0; /* avoid "may be used uninitialized" with GCC 4.4.7 */
-    int min_way = 0;
-    for (int way = 0; way < associativity_; ++way) {
-        if (get_caching_device_block(block_idx, way).tag_ == TAG_INVALID) {
-            min_way = way;
-            break;
-        }
-        if (way == 0 || get_caching_device_block(block_idx, way).counter_ < min_counter) {
-            min_counter = get_caching_device_block(block_idx, way).counter_;
-            min_way = way;
-        }
-    }
-    return min_way;
+    // An invalid way is preferred over the least frequently used one.
+    int way = find_way_with_tag(&tags_[block_idx], associativity_, TAG_INVALID);
+    if (way >= 0)
+        return way;
+    return find_way_with_min_counter(&counters_[block_idx], associativity_);
 }
 
 void
@@ -319,7 +327,7 @@ caching_device_t::invalidate(addr_t tag, invalidation_type_t invalidation_type)
 {
     auto block_way = find_caching_device_block(tag);
     if (block_way.first != nullptr) {
-        invalidate_caching_device_block(block_way.first);
+        invalidate_caching_device_block(compute_block_idx(tag), block_way.second);
         stats_->invalidate(invalidation_type);
         // Invalidate last_tag_ if it was this tag.
         if (last_tag_ == tag) {
@@ -418,11 +426,42 @@ caching_device_t::record_access_stats(const memref_t &memref, bool hit,
     // We propagate hits all the way up the hierarchy.
     // But to avoid over-counting we only propagate misses one level up.
     if (hit) {
-        for (caching_device_t *up = parent_; up != nullptr; up = up->parent_)
+        for (caching_device_t *up = parent_; up != nullptr; up = up->parent_) {
+            if (up->is_shared() && !is_shared()) {
+                // Batched for this and all further ancestors: see
+                // flush_deferred_child_hits().
+                ++deferred_child_hits_;
+                break;
+            }
             up->stats_->child_access(memref, hit, cache_block);
-    } else if (parent_ != nullptr)
+        }
+    } else if (parent_ != nullptr && shared_request_log_ == nullptr)
         parent_->stats_->child_access(memref, hit, cache_block);
 }
 
+void
+caching_device_t::replay_shared_request(const memref_t &memref, bool is_flush)
+{
+    assert(!is_flush && parent_ != nullptr);
+    parent_->stats_->child_access(memref, false /*miss*/, nullptr);
+    parent_->request(memref);
+}
+
+void
+caching_device_t::flush_deferred_child_hits()
+{
+    if (deferred_child_hits_ == 0)
+        return;
+    caching_device_t *up = parent_;
+    while (up != nullptr && !up->is_shared())
+        up = up->parent_;
+    if (up != nullptr) {
+        std::unique_lock<std::mutex> lock = up->lock_for_access_from(this);
+        for (; up != nullptr; up = up->parent_)
+            up->stats_->add_child_hits(deferred_child_hits_);
+    }
+    deferred_child_hits_ = 0;
+}
+
 } // namespace drmemtrace
 } // namespace dynamorio
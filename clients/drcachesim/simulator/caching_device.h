@@ -36,13 +36,13 @@
 #ifndef _CACHING_DEVICE_H_
 #define _CACHING_DEVICE_H_ 1
 
-#include <functional>
+#include <mutex>
 #include <string>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "caching_device_block.h"
+#include "caching_device_index.h"
 #include "caching_device_stats.h"
 #include "memref.h"
 #include "trace_entry.h"
@@ -56,10 +56,72 @@ namespace drmemtrace {
 // subclassing caching_device_t.
 
 // We assume we're only invoked from a single thread of control and do
-// not need to synchronize data access.
+// not need to synchronize data access, except for parallel simulation of
+// multiple cores (see set_shared_lock()) where devices shared by more than
+// one core are only accessed while holding a lock.
 
 class snoop_filter_t;
 class prefetcher_t;
+class caching_device_t;
+
+// A request from a core's private device to a shared parent, deferred for
+// parallel simulation of multiple cores (see set_shared_request_log()).
+struct shared_request_t {
+    // The ordinal of the core's trace record that caused the request.
+    uint64_t ordinal;
+    caching_device_t *requester;
+    memref_t memref;
+    bool is_flush;
+    // Whether the record is inside a window of a sampled trace.
+    bool in_sample_window;
+};
+
+// Collects the requests the private devices of one core send to shared devices.
+// The requests of all cores are replayed into the shared devices in the order of
+// their (ordinal, core) pairs, which makes the shared results independent of how
+// the threads simulating the cores are interleaved.
+class shared_request_log_t {
+public:
+    void
+    set_ordinal(uint64_t ordinal)
+    {
+        ordinal_ = ordinal;
+    }
+    void
+    set_in_sample_window(bool in_sample_window)
+    {
+        in_sample_window_ = in_sample_window;
+    }
+    void
+    add(caching_device_t *requester, const memref_t &memref, bool is_flush)
+    {
+        requests_.push_back({ ordinal_, requester, memref, is_flush, in_sample_window_ });
+    }
+    std::vector<shared_request_t> &
+    get_requests()
+    {
+        return requests_;
+    }
+
+private:
+    uint64_t ordinal_ = 0;
+    bool in_sample_window_ = false;
+    std::vector<shared_request_t> requests_;
+};
+
+// Receives the misses of the devices it observes (see
+// caching_device_t::set_miss_observer()), such as to model their timing.
+class miss_observer_t {
+public:
+    virtual ~miss_observer_t()
+    {
+    }
+    // Called for each block missed by a device before its parent is asked for
+    // it, so the misses of one access arrive from the innermost device outward.
+    // "id" is the value passed to set_miss_observer().
+    virtual void
+    on_miss(int id, addr_t tag, bool is_prefetch) = 0;
+};
 
 class caching_device_t {
 public:
@@ -82,6 +144,55 @@ public:
     void
     propagate_write(addr_t tag, const caching_device_t *requester);
 
+    // For parallel simulation where each core's private devices are driven by a
+    // separate thread, a device reachable from more than one core is marked as
+    // shared by passing the lock which guards the entire shared portion of the
+    // hierarchy.  Must be called prior to any call to request().
+    void
+    set_shared_lock(std::mutex *lock)
+    {
+        shared_lock_ = lock;
+    }
+    bool
+    is_shared() const
+    {
+        return shared_lock_ != nullptr;
+    }
+    // Returns a held lock on the shared portion of the hierarchy if this device is
+    // shared and "accessor" (nullptr for a caller outside the hierarchy) is not;
+    // returns an empty lock otherwise.
+    std::unique_lock<std::mutex>
+    lock_for_access_from(const caching_device_t *accessor) const
+    {
+        if (shared_lock_ == nullptr || (accessor != nullptr && accessor->is_shared()))
+            return std::unique_lock<std::mutex>();
+        return std::unique_lock<std::mutex>(*shared_lock_);
+    }
+    // Has this private device, whose parent is shared, add its requests to the
+    // parent to "log" rather than sending them; they are later sent with
+    // replay_shared_request().  Must be called prior to any call to request().
+    void
+    set_shared_request_log(shared_request_log_t *log)
+    {
+        shared_request_log_ = log;
+    }
+    // Sends a request previously added to a shared_request_log_t to the parent.
+    virtual void
+    replay_shared_request(const memref_t &memref, bool is_flush);
+    // Reports each miss to "observer" along with "id".  Must be called prior to
+    // any call to request().
+    void
+    set_miss_observer(miss_observer_t *observer, int id)
+    {
+        miss_observer_ = observer;
+        miss_observer_id_ = id;
+    }
+    // Hits in a private device are propagated to shared ancestors' stats in a
+    // batch, to avoid acquiring the shared lock on every hit.  This pushes out
+    // any pending hits and must be called before reading shared stats.
+    void
+    flush_deferred_child_hits();
+
     caching_device_stats_t *
     get_stats() const
     {
@@ -110,19 +221,25 @@ public:
     {
         return double(loaded_blocks_) / num_blocks_;
     }
-    // Must be called prior to any call to request().
+    // Overrides the choice init() makes of whether to look tags up through an
+    // index rather than by walking the ways of their set.  Must be called prior to
+    // any call to request().
     virtual inline void
     set_hashtable_use(bool use_hashtable)
     {
-        if (!use_tag2block_table_ && use_hashtable) {
-            // Resizing from an initial small table causes noticeable overhead, so we
-            // start with a relatively large table.
-            tag2block.reserve(1 << 16);
-            // Even with the large initial size, for large caches we want to keep the
-            // load factor small.
-            tag2block.max_load_factor(0.5);
-        }
+        // The table is sized from the block count, so if we are not yet
+        // initialized this happens in init().
+        if (!use_tag2block_table_ && use_hashtable && blocks_ != NULL)
+            tag2block.init(num_blocks_);
+        else if (use_tag2block_table_ && !use_hashtable)
+            tag2block = caching_device_index_t();
         use_tag2block_table_ = use_hashtable;
+        hashtable_use_chosen_ = true;
+    }
+    bool
+    get_hashtable_use() const
+    {
+        return use_tag2block_table_;
     }
     int
     get_block_index(const addr_t addr) const
@@ -203,24 +320,41 @@ protected:
     {
         return *(blocks_[block_idx + way]);
     }
+    inline addr_t
+    get_block_tag(int block_idx, int way) const
+    {
+        return tags_[block_idx + way];
+    }
+    inline int &
+    get_block_counter(int block_idx, int way)
+    {
+        return counters_[block_idx + way];
+    }
+    inline int
+    get_block_counter(int block_idx, int way) const
+    {
+        return counters_[block_idx + way];
+    }
 
     inline void
-    invalidate_caching_device_block(caching_device_block_t *block)
+    invalidate_caching_device_block(int block_idx, int way)
     {
+        addr_t &tag = tags_[block_idx + way];
         if (use_tag2block_table_)
-            tag2block.erase(block->tag_);
-        block->tag_ = TAG_INVALID;
+            tag2block.erase(tag);
+        tag = TAG_INVALID;
     }
 
     inline void
-    update_tag(caching_device_block_t *block, int way, addr_t new_tag)
+    update_tag(int block_idx, int way, addr_t new_tag)
     {
+        addr_t &tag = tags_[block_idx + way];
         if (use_tag2block_table_) {
-            if (block->tag_ != TAG_INVALID)
-                tag2block.erase(block->tag_);
-            tag2block[new_tag] = std::make_pair(block, way);
+            if (tag != TAG_INVALID)
+                tag2block.erase(tag);
+            tag2block.insert(new_tag, blocks_[block_idx + way], way);
         }
-        block->tag_ = new_tag;
+        tag = new_tag;
     }
 
     // Returns the block (and its way) whose tag equals `tag`.
@@ -255,6 +389,12 @@ protected:
     // an extended block class which has its own member variables cannot be indexed
     // correctly by base class pointers.
     caching_device_block_t **blocks_;
+    // The tag and replacement counter of each block, indexed like blocks_ so
+    // that the ways of a set are contiguous for vectorized searches.
+    std::vector<addr_t> tags_;
+    // XXX: using int64_t here results in a ~4% slowdown for 32-bit apps.
+    // A 32-bit counter should be sufficient but we may want to revisit.
+    std::vector<int> counters_; // for use by replacement policies
     int blocks_per_way_;
     // Optimization fields for fast bit operations
     int blocks_per_way_mask_;
@@ -273,10 +413,28 @@ protected:
     // We can't easily remove the blocks_ array and replace with just
     // the hashtable as replace_which_way(), etc. want quick access to
     // every way for a given line index.
-    std::unordered_map<addr_t, std::pair<caching_device_block_t *, int>,
-                       std::function<unsigned long(addr_t)>>
-        tag2block;
+    caching_device_index_t tag2block;
     bool use_tag2block_table_ = false;
+    // Whether set_hashtable_use() was called, overriding the default.
+    bool hashtable_use_chosen_ = false;
+    // By default the index is used by devices with at least this many ways and at
+    // most this many blocks.  The index's lookups beat the way walk by more as the
+    // associativity grows, while for larger devices the host's cache misses
+    // dominate either way and the index just takes memory (as measured by
+    // tool.drcachesim.caching_device_benchmark).
+    static constexpr int INDEX_MIN_ASSOCIATIVITY = 8;
+    static constexpr int INDEX_MAX_BLOCKS = 1 << 16;
+
+    // Lock guarding the shared portion of the hierarchy: non-null only if this
+    // device is shared among cores simulated in parallel.
+    std::mutex *shared_lock_ = nullptr;
+    // Hits not yet propagated to shared ancestors.
+    int64_t deferred_child_hits_ = 0;
+    // Non-null only for a private device with a shared parent.
+    shared_request_log_t *shared_request_log_ = nullptr;
+
+    miss_observer_t *miss_observer_ = nullptr;
+    int miss_observer_id_ = -1;
 
     // Name for this cache.
     const std::string name_;
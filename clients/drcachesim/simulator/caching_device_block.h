@@ -48,26 +48,19 @@ namespace drmemtrace {
 // block status.
 static const addr_t TAG_INVALID = (addr_t)-1; // block is invalid
 
+// The tag and replacement counter of each block are not stored here but in
+// structure-of-arrays form in caching_device_t (see get_block_tag() and
+// get_block_counter()), so that all ways of a set can be searched at once.
+// This class holds any additional per-block state for a subclassed device.
 class caching_device_block_t {
 public:
-    // Initializing counter to 0 is just to be safe and to make it easier to write new
-    // replacement algorithms without errors (and we expect negligible perf cost).
     caching_device_block_t()
-        : tag_(TAG_INVALID)
-        , counter_(0)
     {
     }
     // Destructor must be virtual and default is not.
     virtual ~caching_device_block_t()
     {
     }
-
-    addr_t tag_;
-
-    // XXX: using int64_t here results in a ~4% slowdown for 32-bit apps.
-    // A 32-bit counter should be sufficient but we may want to revisit.
-    // We already have stdint.h so we can reinstate int64_t easily.
-    int counter_; // for use by replacement policies
 };
 
 } // namespace drmemtrace
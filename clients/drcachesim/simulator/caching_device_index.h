@@ -0,0 +1,149 @@
+/* **********************************************************
+ * Copyright (c) 2023 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* caching_device_index: maps a tag to the block holding it in a caching device.
+ */
+
+#ifndef _CACHING_DEVICE_INDEX_H_
+#define _CACHING_DEVICE_INDEX_H_ 1
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "caching_device_block.h"
+#include "memref.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// An open-addressing hashtable from a tag to its {block,way}, used in place of
+// serial walks over the ways of a set for highly associative devices.  A device
+// never holds more valid tags than it has blocks, so the capacity is fixed at
+// init time to keep the load factor at or below 1/2 and we never resize.
+// Linear probing with backward-shift deletion avoids tombstones.
+class caching_device_index_t {
+public:
+    struct entry_t {
+        addr_t tag = TAG_INVALID;
+        caching_device_block_t *block = nullptr;
+        int way = 0;
+    };
+
+    void
+    init(int num_blocks)
+    {
+        size_t capacity = 1;
+        capacity_bits_ = 0;
+        while (capacity < 2 * static_cast<size_t>(num_blocks)) {
+            capacity <<= 1;
+            ++capacity_bits_;
+        }
+        // Keep at least one bit of hash so the shift below stays in range.
+        if (capacity_bits_ == 0) {
+            capacity = 2;
+            capacity_bits_ = 1;
+        }
+        mask_ = capacity - 1;
+        table_.assign(capacity, entry_t());
+    }
+
+    // Returns the entry for "tag", or nullptr if "tag" is not present.
+    inline const entry_t *
+    find(addr_t tag) const
+    {
+        for (size_t i = hash(tag);; i = (i + 1) & mask_) {
+            const entry_t &entry = table_[i];
+            if (entry.tag == tag)
+                return &entry;
+            if (entry.tag == TAG_INVALID)
+                return nullptr;
+        }
+    }
+
+    // "tag" must not already be present.
+    inline void
+    insert(addr_t tag, caching_device_block_t *block, int way)
+    {
+        assert(tag != TAG_INVALID);
+        size_t i = hash(tag);
+        while (table_[i].tag != TAG_INVALID) {
+            assert(table_[i].tag != tag);
+            i = (i + 1) & mask_;
+        }
+        table_[i].tag = tag;
+        table_[i].block = block;
+        table_[i].way = way;
+    }
+
+    inline void
+    erase(addr_t tag)
+    {
+        size_t hole = hash(tag);
+        while (table_[hole].tag != tag) {
+            if (table_[hole].tag == TAG_INVALID)
+                return;
+            hole = (hole + 1) & mask_;
+        }
+        // Shift back any later entry in the probe run whose home slot is at or
+        // before the hole, so that lookups never stop early.
+        for (size_t i = (hole + 1) & mask_; table_[i].tag != TAG_INVALID;
+             i = (i + 1) & mask_) {
+            size_t home = hash(table_[i].tag);
+            if (((i - home) & mask_) >= ((i - hole) & mask_)) {
+                table_[hole] = table_[i];
+                hole = i;
+            }
+        }
+        table_[hole].tag = TAG_INVALID;
+    }
+
+private:
+    inline size_t
+    hash(addr_t tag) const
+    {
+        // Fibonacci hashing: tags are often strided, so we multiply to spread
+        // their low bits rather than using the identity.
+        uint64_t mixed = static_cast<uint64_t>(tag) * 0x9e3779b97f4a7c15ULL;
+        return static_cast<size_t>(mixed >> (64 - capacity_bits_));
+    }
+
+    std::vector<entry_t> table_;
+    size_t mask_ = 0;
+    int capacity_bits_ = 0;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _CACHING_DEVICE_INDEX_H_ */
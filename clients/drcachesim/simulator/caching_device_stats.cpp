@@ -135,6 +135,12 @@ caching_device_stats_t::child_access(const memref_t &memref, bool hit,
     // else being computed in access()
 }
 
+void
+caching_device_stats_t::add_child_hits(int64_t count)
+{
+    num_child_hits_ += count;
+}
+
 void
 caching_device_stats_t::check_compulsory_miss(addr_t addr)
 {
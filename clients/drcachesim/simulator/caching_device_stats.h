@@ -177,6 +177,11 @@ public:
     virtual void
     child_access(const memref_t &memref, bool hit, caching_device_block_t *cache_block);
 
+    // Called to account for a batch of hits by child caching devices, in place of
+    // individual child_access() calls, when simulating cores in parallel.
+    virtual void
+    add_child_hits(int64_t count);
+
     virtual void
     print_stats(std::string prefix);
 
@@ -0,0 +1,147 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "page_size_map.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <istream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include "memref.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+namespace {
+
+// Parses a size such as "4096", "2M", or "1G" into log2 of its value.
+// Returns -1 if the size is not a power of two.
+int
+parse_page_bits(const std::string &str)
+{
+    if (str.empty())
+        return -1;
+    char *end;
+    uint64_t size = strtoull(str.c_str(), &end, 0);
+    switch (*end) {
+    case 'k':
+    case 'K': size <<= 10; ++end; break;
+    case 'm':
+    case 'M': size <<= 20; ++end; break;
+    case 'g':
+    case 'G': size <<= 30; ++end; break;
+    default: break;
+    }
+    if (*end != '\0' || size == 0 || (size & (size - 1)) != 0)
+        return -1;
+    int bits = 0;
+    while ((size >>= 1) != 0)
+        ++bits;
+    return bits;
+}
+
+} // namespace
+
+std::string
+page_size_map_t::read(std::istream &in)
+{
+    std::string line;
+    int line_num = 0;
+    while (std::getline(in, line)) {
+        ++line_num;
+        std::istringstream fields(line);
+        std::string start_str, end_str, size_str;
+        if (!(fields >> start_str) || start_str[0] == '#')
+            continue;
+        std::string extra;
+        if (!(fields >> end_str >> size_str) || (fields >> extra)) {
+            return "Line " + std::to_string(line_num) +
+                ": expected <start> <end> <page_size>";
+        }
+        char *end;
+        addr_t start = strtoull(start_str.c_str(), &end, 0);
+        bool ok = *end == '\0';
+        addr_t limit = strtoull(end_str.c_str(), &end, 0);
+        ok = ok && *end == '\0';
+        int bits = parse_page_bits(size_str);
+        if (!ok || bits < 0)
+            return "Line " + std::to_string(line_num) + ": invalid number";
+        std::string error = add_range(start, limit, bits);
+        if (!error.empty())
+            return "Line " + std::to_string(line_num) + ": " + error;
+    }
+    return "";
+}
+
+std::string
+page_size_map_t::add_range(addr_t start, addr_t end, int page_bits)
+{
+    if (page_bits < base_page_bits_ || page_bits >= 64)
+        return "page size is smaller than the base page size";
+    addr_t mask = (static_cast<addr_t>(1) << page_bits) - 1;
+    if (start >= end || (start & mask) != 0 || (end & mask) != 0)
+        return "range is empty or not aligned to its page size";
+    range_t range = { start, end, page_bits };
+    auto it = std::upper_bound(
+        ranges_.begin(), ranges_.end(), start,
+        [](addr_t addr, const range_t &other) { return addr < other.start; });
+    if ((it != ranges_.end() && it->start < end) ||
+        (it != ranges_.begin() && std::prev(it)->end > start))
+        return "range overlaps an earlier range";
+    ranges_.insert(it, range);
+    last_range_ = 0;
+    return "";
+}
+
+int
+page_size_map_t::lookup(addr_t addr) const
+{
+    auto it = std::upper_bound(
+        ranges_.begin(), ranges_.end(), addr,
+        [](addr_t target, const range_t &range) { return target < range.start; });
+    if (it == ranges_.begin())
+        return base_page_bits_;
+    --it;
+    if (addr >= it->end)
+        return base_page_bits_;
+    last_range_ = it - ranges_.begin();
+    return it->page_bits;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
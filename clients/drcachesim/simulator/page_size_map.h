@@ -0,0 +1,117 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* page_size_map: the page size that maps each virtual address, for simulating
+ * TLBs over a mix of base and huge pages.
+ */
+
+#ifndef _PAGE_SIZE_MAP_H_
+#define _PAGE_SIZE_MAP_H_ 1
+
+#include <stddef.h>
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "memref.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// Addresses outside of every added range use the base page size.  Ranges are
+// typically read from a file produced from /proc/pid/smaps (AnonHugePages) or
+// from the hugetlbfs mappings of the traced application.
+class page_size_map_t {
+public:
+    explicit page_size_map_t(int base_page_bits)
+        : base_page_bits_(base_page_bits)
+    {
+    }
+
+    // Reads one range per line as "<start> <end> <page_size>", where start and
+    // end may be hex and the size may carry a K, M, or G suffix.  Blank lines and
+    // lines starting with '#' are ignored.  Returns "" on success or an error.
+    std::string
+    read(std::istream &in);
+
+    // Maps [start, end) with pages of 2^page_bits bytes.  Returns "" on success
+    // or an error if the range is misaligned or overlaps an earlier range.
+    std::string
+    add_range(addr_t start, addr_t end, int page_bits);
+
+    // Returns log2 of the size of the page containing "addr".
+    int
+    page_bits(addr_t addr) const
+    {
+        if (ranges_.empty())
+            return base_page_bits_;
+        const range_t &last = ranges_[last_range_];
+        if (addr >= last.start && addr < last.end)
+            return last.page_bits;
+        return lookup(addr);
+    }
+
+    int
+    get_base_page_bits() const
+    {
+        return base_page_bits_;
+    }
+
+    bool
+    empty() const
+    {
+        return ranges_.empty();
+    }
+
+private:
+    struct range_t {
+        addr_t start;
+        addr_t end;
+        int page_bits;
+    };
+
+    int
+    lookup(addr_t addr) const;
+
+    int base_page_bits_;
+    // Sorted by start and non-overlapping.
+    std::vector<range_t> ranges_;
+    // Accesses cluster, so we check the last matching range first.
+    mutable size_t last_range_ = 0;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _PAGE_SIZE_MAP_H_ */
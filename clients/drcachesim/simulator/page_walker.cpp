@@ -0,0 +1,206 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "page_walker.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <locale>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "cache_simulator.h"
+#include "memref.h"
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+constexpr addr_t page_table_t::TABLE_BASE;
+
+addr_t
+page_table_t::entry_address(memref_pid_t pid, int level, addr_t vaddr)
+{
+    // Each table has 512 eight-byte entries, each covering 2^shift bytes.
+    int shift = 39 - 9 * level;
+    addr_t reach = shift + 9 >= 64 ? 0 : vaddr >> (shift + 9);
+    auto key = std::make_tuple(pid, level, reach);
+    auto it = tables_.find(key);
+    if (it == tables_.end()) {
+        it = tables_.emplace(key, next_table_).first;
+        next_table_ += static_cast<addr_t>(1) << TABLE_BITS;
+    }
+    return it->second + ((vaddr >> shift) & 511) * sizeof(uint64_t);
+}
+
+bool
+page_walker_t::pwc_t::lookup(memref_pid_t pid, addr_t tag, uint64_t now)
+{
+    for (entry_t &entry : entries) {
+        if (entry.tag == tag && entry.pid == pid) {
+            entry.last_use = now;
+            ++hits;
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+page_walker_t::pwc_t::insert(memref_pid_t pid, addr_t tag, uint64_t now)
+{
+    if (capacity == 0)
+        return;
+    if (entries.size() < capacity) {
+        entries.push_back({ pid, tag, now });
+        return;
+    }
+    auto victim = std::min_element(
+        entries.begin(), entries.end(),
+        [](const entry_t &a, const entry_t &b) { return a.last_use < b.last_use; });
+    *victim = { pid, tag, now };
+}
+
+page_walker_t::page_walker_t(page_table_t *table,
+                             const std::vector<unsigned int> &pwc_entries,
+                             const std::vector<unsigned int> &latencies,
+                             cache_simulator_t *caches, int core)
+    : table_(table)
+    , latencies_(latencies)
+    , caches_(caches)
+    , core_(core)
+    , supplied_(1, 0)
+{
+    for (int level = PML4; level < PT; ++level) {
+        if (level < static_cast<int>(pwc_entries.size()))
+            pwcs_[level].capacity = pwc_entries[level];
+        pwcs_[level].entries.reserve(pwcs_[level].capacity);
+    }
+    if (latencies_.empty())
+        latencies_.push_back(0);
+}
+
+uint64_t
+page_walker_t::entry_latency(int level) const
+{
+    if (level == 0 || latencies_.size() < 2)
+        return latencies_.back();
+    return latencies_[std::min<size_t>(level, latencies_.size() - 1) - 1];
+}
+
+void
+page_walker_t::walk(memref_pid_t pid, addr_t vaddr, int page_bits)
+{
+    ++walks_;
+    ++now_;
+    int leaf = PT;
+    if (page_bits >= level_shift(PDPT))
+        leaf = PDPT;
+    else if (page_bits >= level_shift(PD))
+        leaf = PD;
+    // Start below the deepest cached non-leaf entry.
+    int start = PML4;
+    for (int level = leaf - 1; level >= PML4; --level) {
+        if (pwcs_[level].lookup(pid, vaddr >> level_shift(level), now_)) {
+            start = level + 1;
+            break;
+        }
+    }
+    for (int level = start; level <= leaf; ++level) {
+        int from = 0;
+        if (caches_ != nullptr) {
+            memref_t entry = {};
+            entry.data.type = TRACE_TYPE_READ;
+            entry.data.pid = pid;
+            entry.data.addr = table_->entry_address(pid, level, vaddr);
+            entry.data.size = sizeof(uint64_t);
+            caches_->access_shared(core_, entry, &from);
+        }
+        if (from >= static_cast<int>(supplied_.size()))
+            supplied_.resize(from + 1, 0);
+        ++supplied_[from];
+        ++entry_reads_;
+        cycles_ += entry_latency(from);
+        if (level < leaf)
+            pwcs_[level].insert(pid, vaddr >> level_shift(level), now_);
+    }
+}
+
+void
+page_walker_t::reset_stats()
+{
+    walks_ = 0;
+    entry_reads_ = 0;
+    cycles_ = 0;
+    std::fill(supplied_.begin(), supplied_.end(), 0);
+    for (pwc_t &pwc : pwcs_)
+        pwc.hits = 0;
+}
+
+void
+page_walker_t::print_stats(const std::string &prefix) const
+{
+    static const char *const PWC_LABELS[] = { "PML4 cache hits:", "PDPT cache hits:",
+                                              "PDE cache hits:" };
+    auto print = [&prefix](const std::string &label, uint64_t value) {
+        std::cerr << prefix << std::setw(21) << std::left << label << std::setw(17)
+                  << std::right << value << std::endl;
+    };
+    std::cerr.imbue(std::locale("")); // Add commas, at least for my locale
+    print("Walks:", walks_);
+    for (int level = PML4; level < PT; ++level) {
+        if (pwcs_[level].capacity > 0)
+            print(PWC_LABELS[level], pwcs_[level].hits);
+    }
+    print("Entries read:", entry_reads_);
+    if (caches_ != nullptr) {
+        for (size_t level = 1; level < supplied_.size(); ++level)
+            print("Entries from L" + std::to_string(level) + ":", supplied_[level]);
+        print("Entries from memory:", supplied_[0]);
+    }
+    print("Walk cycles:", cycles_);
+    if (walks_ > 0) {
+        std::cerr << prefix << std::setw(21) << std::left
+                  << "Cycles per walk:" << std::setw(17) << std::fixed
+                  << std::setprecision(2) << std::right
+                  << static_cast<double>(cycles_) / walks_ << std::endl;
+    }
+    std::cerr.imbue(std::locale("C")); // Reset to avoid affecting later prints.
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -0,0 +1,188 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* page_walker: the page table walks that service last-level TLB misses, with
+ * x86-64 style paging-structure caches.
+ */
+
+#ifndef _PAGE_WALKER_H_
+#define _PAGE_WALKER_H_ 1
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "memref.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+class cache_simulator_t;
+
+// Synthetic four-level page tables.  Traces do not record where the kernel
+// placed the page tables, so each table page is assigned the next free page of
+// a physical region above any real address the first time it is walked.  This
+// gives walks the locality of a real radix table: neighboring pages share their
+// upper-level entries and pack eight last-level entries per cache line.
+// One instance is shared by the walkers of all cores.
+class page_table_t {
+public:
+    // Returns the address of the entry at "level" (a page_walker_t::level_t)
+    // that translates "vaddr" in process "pid".
+    addr_t
+    entry_address(memref_pid_t pid, int level, addr_t vaddr);
+
+private:
+    static constexpr addr_t TABLE_BASE = static_cast<addr_t>(1) << 56;
+    static constexpr int TABLE_BITS = 12;
+
+    // Keyed by pid, level, and the virtual address bits above the table's reach.
+    std::map<std::tuple<memref_pid_t, int, addr_t>, addr_t> tables_;
+    addr_t next_table_ = TABLE_BASE;
+};
+
+// Walks the page table of one core.  The paging-structure caches hold the
+// non-leaf entries most recently read for each level so a walk can start below
+// the root: a PDE cache hit leaves only the last-level PTE to read.  Each entry
+// read is sent to the optional cache hierarchy, whose answer determines the
+// latency charged for it.
+class page_walker_t {
+public:
+    enum level_t {
+        PML4,
+        PDPT,
+        PD,
+        PT,
+        NUM_LEVELS,
+    };
+
+    // "pwc_entries" holds the PML4, PDPT, and PDE cache sizes, where 0 disables
+    // a cache.  "latencies" holds the cycles charged for an entry supplied by
+    // each cache level from the L1 outward, followed by memory; levels beyond
+    // the list use its last cache entry.  "caches" may be null, in which case
+    // every entry comes from memory.
+    page_walker_t(page_table_t *table, const std::vector<unsigned int> &pwc_entries,
+                  const std::vector<unsigned int> &latencies, cache_simulator_t *caches,
+                  int core);
+
+    // Translates "vaddr", which is mapped by a page of 2^page_bits bytes.
+    void
+    walk(memref_pid_t pid, addr_t vaddr, int page_bits);
+
+    void
+    reset_stats();
+
+    void
+    print_stats(const std::string &prefix) const;
+
+    uint64_t
+    get_walks() const
+    {
+        return walks_;
+    }
+    // The entries read by all walks, which excludes those skipped thanks to
+    // the paging-structure caches.
+    uint64_t
+    get_entry_reads() const
+    {
+        return entry_reads_;
+    }
+    uint64_t
+    get_pwc_hits(level_t level) const
+    {
+        return pwcs_[level].hits;
+    }
+    uint64_t
+    get_cycles() const
+    {
+        return cycles_;
+    }
+    // The entries supplied by cache level "level", counting from 1 for the L1,
+    // or by memory for level 0.
+    uint64_t
+    get_entries_from(int level) const
+    {
+        return level >= 0 && level < static_cast<int>(supplied_.size())
+            ? supplied_[level]
+            : 0;
+    }
+
+private:
+    // A fully associative LRU cache of the entries of one level.
+    struct pwc_t {
+        struct entry_t {
+            memref_pid_t pid;
+            addr_t tag;
+            uint64_t last_use;
+        };
+        bool
+        lookup(memref_pid_t pid, addr_t tag, uint64_t now);
+        void
+        insert(memref_pid_t pid, addr_t tag, uint64_t now);
+
+        size_t capacity = 0;
+        std::vector<entry_t> entries;
+        uint64_t hits = 0;
+    };
+
+    static int
+    level_shift(int level)
+    {
+        return 39 - 9 * level;
+    }
+
+    uint64_t
+    entry_latency(int level) const;
+
+    page_table_t *table_;
+    std::vector<unsigned int> latencies_;
+    cache_simulator_t *caches_;
+    int core_;
+    // Only PML4, PDPT, and PD have caches, as last-level entries go to the TLB.
+    pwc_t pwcs_[PT];
+    uint64_t now_ = 0;
+
+    uint64_t walks_ = 0;
+    uint64_t entry_reads_ = 0;
+    uint64_t cycles_ = 0;
+    // Indexed by the cache level that supplied each entry, with memory at 0.
+    std::vector<uint64_t> supplied_;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _PAGE_WALKER_H_ */
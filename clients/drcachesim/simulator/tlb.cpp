@@ -40,6 +40,7 @@
 #include "caching_device_block.h"
 #include "tlb_entry.h"
 #include "trace_entry.h"
+#include "way_search.h"
 
 namespace dynamorio {
 namespace drmemtrace {
@@ -67,19 +68,21 @@ tlb_t::request(const memref_t &memref_in)
     // the right data struct to the parent and stats collectors.
     memref_t memref;
     // We support larger sizes to improve the IPC perf.
-    // This means that one memref could touch multiple blocks.
-    // We treat each block separately for statistics purposes.
+    // This means that one memref could touch multiple pages, which may differ
+    // in size.  We treat each page separately for statistics purposes.
     addr_t final_addr = memref_in.data.addr + memref_in.data.size - 1 /*avoid overflow*/;
-    addr_t final_tag = compute_tag(final_addr);
-    addr_t tag = compute_tag(memref_in.data.addr);
+    int bits = page_bits(memref_in.data.addr);
+    addr_t tag = compute_page_tag(memref_in.data.addr, bits);
     memref_pid_t pid = memref_in.data.pid;
 
-    // Optimization: check last tag and pid if single-block
-    if (tag == final_tag && tag == last_tag_ && pid == last_pid_) {
+    // Optimization: check last tag and pid if single-page
+    if ((memref_in.data.addr >> bits) == (final_addr >> bits) && tag == last_tag_ &&
+        pid == last_pid_) {
         // Make sure last_tag_ and pid are properly in sync.
         caching_device_block_t *tlb_entry =
             &get_caching_device_block(last_block_idx_, last_way_);
-        assert(tag != TAG_INVALID && tag == tlb_entry->tag_ &&
+        assert(tag != TAG_INVALID &&
+               tag == get_block_tag(last_block_idx_, last_way_) &&
                pid == ((tlb_entry_t *)tlb_entry)->pid_);
         record_access_stats(memref_in, true /*hit*/, tlb_entry);
         access_update(last_block_idx_, last_way_);
@@ -87,16 +90,27 @@ tlb_t::request(const memref_t &memref_in)
     }
 
     memref = memref_in;
-    for (; tag <= final_tag; ++tag) {
+    while (true) {
         int way;
         int block_idx = compute_block_idx(tag);
+        // The top page's end wraps to 0.
+        addr_t next_addr = ((memref.data.addr >> bits) + 1) << bits;
+        bool last_page = next_addr == 0 || final_addr < next_addr;
 
-        if (tag + 1 <= final_tag)
-            memref.data.size = ((tag + 1) << block_size_bits_) - memref.data.addr;
+        if (!last_page)
+            memref.data.size = next_addr - memref.data.addr;
 
+        // Search the set's tags, then confirm the pid of any match.
         for (way = 0; way < associativity_; ++way) {
+            int match = find_way_with_tag(&tags_[block_idx + way], associativity_ - way,
+                                          tag);
+            if (match < 0) {
+                way = associativity_;
+                break;
+            }
+            way += match;
             caching_device_block_t *tlb_entry = &get_caching_device_block(block_idx, way);
-            if (tlb_entry->tag_ == tag && ((tlb_entry_t *)tlb_entry)->pid_ == pid) {
+            if (((tlb_entry_t *)tlb_entry)->pid_ == pid) {
                 record_access_stats(memref, true /*hit*/, tlb_entry);
                 break;
             }
@@ -107,28 +121,33 @@ tlb_t::request(const memref_t &memref_in)
             caching_device_block_t *tlb_entry = &get_caching_device_block(block_idx, way);
 
             record_access_stats(memref, false /*miss*/, tlb_entry);
-            // If no parent we assume we get the data from main memory
+            // If no parent we walk the page table, or assume we get the data
+            // from main memory if we have no walker.
             if (parent_ != NULL)
                 parent_->request(memref);
+            else if (walker_ != nullptr)
+                walker_->walk(pid, memref.data.addr, bits);
 
             // XXX: do we need to handle TLB coherency?
 
-            tlb_entry->tag_ = tag;
+            update_tag(block_idx, way, tag);
             ((tlb_entry_t *)tlb_entry)->pid_ = pid;
         }
 
         access_update(block_idx, way);
 
-        if (tag + 1 <= final_tag) {
-            addr_t next_addr = (tag + 1) << block_size_bits_;
-            memref.data.addr = next_addr;
-            memref.data.size = final_addr - next_addr + 1 /*undo the -1*/;
-        }
         // Optimization: remember last tag and pid
         last_tag_ = tag;
         last_way_ = way;
         last_block_idx_ = block_idx;
         last_pid_ = pid;
+
+        if (last_page)
+            break;
+        memref.data.addr = next_addr;
+        memref.data.size = final_addr - next_addr + 1 /*undo the -1*/;
+        bits = page_bits(next_addr);
+        tag = compute_page_tag(next_addr, bits);
     }
 }
 
@@ -38,6 +38,8 @@
 
 #include "caching_device.h"
 #include "memref.h"
+#include "page_size_map.h"
+#include "page_walker.h"
 #include "tlb_entry.h"
 #include "tlb_stats.h"
 
@@ -49,6 +51,21 @@ public:
     void
     request(const memref_t &memref) override;
 
+    // Looks up each address with the page size "page_sizes" gives it instead of
+    // the block size, so base and huge pages share the entries.
+    void
+    set_page_size_map(const page_size_map_t *page_sizes)
+    {
+        page_sizes_ = page_sizes;
+    }
+
+    // Sends misses to "walker" when this TLB has no parent.
+    void
+    set_page_walker(page_walker_t *walker)
+    {
+        walker_ = walker;
+    }
+
     // TODO i#4816: The addition of the pid as a lookup parameter beyond just the tag
     // needs to be imposed on the parent methods invalidate(), contains_tag(), and
     // propagate_eviction() by overriding them.
@@ -57,8 +74,28 @@ protected:
     void
     init_blocks() override;
 
+    int
+    page_bits(addr_t addr) const
+    {
+        return page_sizes_ == nullptr ? block_size_bits_ : page_sizes_->page_bits(addr);
+    }
+
+    // A huge page's tag records its size in the top bits, which the page number
+    // of a canonical address never reaches, so that it cannot match a base page
+    // with the same number.  Base page tags are plain page numbers.
+    addr_t
+    compute_page_tag(addr_t addr, int page_bits) const
+    {
+        addr_t tag = addr >> page_bits;
+        if (page_bits != block_size_bits_)
+            tag |= static_cast<addr_t>(page_bits) << 57;
+        return tag;
+    }
+
     // Optimization: remember last pid in addition to last tag
     memref_pid_t last_pid_;
+    const page_size_map_t *page_sizes_ = nullptr;
+    page_walker_t *walker_ = nullptr;
 };
 
 } // namespace drmemtrace
@@ -33,7 +33,9 @@
 #include "tlb_simulator.h"
 
 #include <stddef.h>
+#include <stdlib.h>
 
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -42,7 +44,10 @@
 #include "memref.h"
 #include "options.h"
 #include "utils.h"
+#include "cache_simulator.h"
 #include "caching_device_stats.h"
+#include "page_size_map.h"
+#include "page_walker.h"
 #include "simulator.h"
 #include "tlb.h"
 #include "tlb_simulator_create.h"
@@ -58,6 +63,24 @@ tlb_simulator_create(const tlb_simulator_knobs_t &knobs)
     return new tlb_simulator_t(knobs);
 }
 
+namespace {
+
+// Parses a comma-separated list of integers.
+bool
+parse_uint_list(const std::string &str, std::vector<unsigned int> &values)
+{
+    for (const std::string &field : split_by(str, ",")) {
+        char *end;
+        unsigned long value = strtoul(field.c_str(), &end, 0);
+        if (field.empty() || *end != '\0')
+            return false;
+        values.push_back(static_cast<unsigned int>(value));
+    }
+    return true;
+}
+
+} // namespace
+
 tlb_simulator_t::tlb_simulator_t(const tlb_simulator_knobs_t &knobs)
     : simulator_t(knobs.num_cores, knobs.skip_refs, knobs.warmup_refs,
                   knobs.warmup_fraction, knobs.sim_refs, knobs.cpu_scheduling,
@@ -108,6 +131,51 @@ tlb_simulator_t::tlb_simulator_t(const tlb_simulator_knobs_t &knobs)
             return;
         }
     }
+
+    page_sizes_.reset(new page_size_map_t(compute_log2((int)knobs_.page_size)));
+    if (!knobs_.TLB_page_size_map.empty()) {
+        std::ifstream map_file(knobs_.TLB_page_size_map);
+        std::string error = map_file.good() ? page_sizes_->read(map_file)
+                                            : "failed to open the file";
+        if (!error.empty()) {
+            error_string_ = "Usage error: failed to read TLB_page_size_map " +
+                knobs_.TLB_page_size_map + ": " + error;
+            success_ = false;
+            return;
+        }
+    }
+    std::vector<unsigned int> pwc_entries;
+    std::vector<unsigned int> latencies;
+    if (!parse_uint_list(knobs_.TLB_pwc_entries, pwc_entries) ||
+        !parse_uint_list(knobs_.TLB_walk_latencies, latencies) || latencies.empty()) {
+        error_string_ = "Usage error: TLB_pwc_entries and TLB_walk_latencies must be "
+                        "comma-separated lists of integers.";
+        success_ = false;
+        return;
+    }
+    if (knobs_.TLB_walk_caches) {
+        cache_simulator_knobs_t cache_knobs = knobs_.walk_cache_knobs;
+        cache_knobs.num_cores = knobs_.num_cores;
+        walk_caches_.reset(new cache_simulator_t(cache_knobs));
+        if (!*walk_caches_) {
+            error_string_ = "Failed to create the page walk caches: " +
+                walk_caches_->get_error_string();
+            success_ = false;
+            return;
+        }
+    }
+    for (unsigned int i = 0; i < knobs_.num_cores; i++) {
+        walkers_.emplace_back(new page_walker_t(&page_table_, pwc_entries, latencies,
+                                                walk_caches_.get(), i));
+        // A map with only base pages changes nothing, so we keep the faster
+        // lookups without one.
+        if (!page_sizes_->empty()) {
+            itlbs_[i]->set_page_size_map(page_sizes_.get());
+            dtlbs_[i]->set_page_size_map(page_sizes_.get());
+            lltlbs_[i]->set_page_size_map(page_sizes_.get());
+        }
+        lltlbs_[i]->set_page_walker(walkers_[i].get());
+    }
 }
 
 tlb_simulator_t::~tlb_simulator_t()
@@ -177,12 +245,16 @@ tlb_simulator_t::process_memref(const memref_t &memref)
         simref = &phys_memref;
     }
 
-    if (type_is_instr(simref->instr.type))
+    if (type_is_instr(simref->instr.type)) {
         itlbs_[core]->request(*simref);
-    else if (simref->data.type == TRACE_TYPE_READ ||
-             simref->data.type == TRACE_TYPE_WRITE)
+        if (walk_caches_)
+            walk_caches_->access_shared(core, *simref);
+    } else if (simref->data.type == TRACE_TYPE_READ ||
+               simref->data.type == TRACE_TYPE_WRITE) {
         dtlbs_[core]->request(*simref);
-    else if (simref->exit.type == TRACE_TYPE_THREAD_EXIT) {
+        if (walk_caches_)
+            walk_caches_->access_shared(core, *simref);
+    } else if (simref->exit.type == TRACE_TYPE_THREAD_EXIT) {
         handle_thread_exit(simref->exit.tid);
         last_thread_ = 0;
     } else if (type_is_prefetch(simref->data.type) ||
@@ -212,6 +284,7 @@ tlb_simulator_t::process_memref(const memref_t &memref)
                 itlbs_[i]->get_stats()->reset();
                 dtlbs_[i]->get_stats()->reset();
                 lltlbs_[i]->get_stats()->reset();
+                walkers_[i]->reset_stats();
             }
         }
     } else {
@@ -233,6 +306,8 @@ tlb_simulator_t::print_results()
             dtlbs_[i]->get_stats()->print_stats("    ");
             std::cerr << "  LL stats:" << std::endl;
             lltlbs_[i]->get_stats()->print_stats("    ");
+            std::cerr << "  Page walk stats:" << std::endl;
+            walkers_[i]->print_stats("    ");
         }
     }
     return true;
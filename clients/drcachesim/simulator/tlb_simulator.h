@@ -36,10 +36,15 @@
 #ifndef _TLB_SIMULATOR_H_
 #define _TLB_SIMULATOR_H_ 1
 
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "cache_simulator.h"
 #include "memref.h"
+#include "page_size_map.h"
+#include "page_walker.h"
 #include "simulator.h"
 #include "tlb.h"
 #include "tlb_simulator_create.h"
@@ -69,6 +74,14 @@ protected:
     tlb_t **itlbs_;
     tlb_t **dtlbs_;
     tlb_t **lltlbs_;
+
+    // The last-level TLB misses of each core walk the shared page table.
+    std::unique_ptr<page_size_map_t> page_sizes_;
+    page_table_t page_table_;
+    std::vector<std::unique_ptr<page_walker_t>> walkers_;
+    // The optional cache hierarchy read by walks, which also sees every
+    // instruction and data access so that walks compete with them.
+    std::unique_ptr<cache_simulator_t> walk_caches_;
 };
 
 } // namespace drmemtrace
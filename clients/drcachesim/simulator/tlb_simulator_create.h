@@ -37,6 +37,7 @@
 
 #include <string>
 #include "analysis_tool.h"
+#include "cache_simulator_create.h"
 
 namespace dynamorio {
 namespace drmemtrace {
@@ -62,6 +63,10 @@ struct tlb_simulator_knobs_t {
         , TLB_L2_entries(1024)
         , TLB_L2_assoc(4)
         , TLB_replace_policy("LFU")
+        , TLB_page_size_map("")
+        , TLB_pwc_entries("2,4,32")
+        , TLB_walk_latencies("4,40,200")
+        , TLB_walk_caches(false)
         , skip_refs(0)
         , warmup_refs(0)
         , warmup_fraction(0.0)
@@ -80,6 +85,12 @@ struct tlb_simulator_knobs_t {
     unsigned int TLB_L2_entries;
     unsigned int TLB_L2_assoc;
     std::string TLB_replace_policy;
+    std::string TLB_page_size_map;
+    std::string TLB_pwc_entries;
+    std::string TLB_walk_latencies;
+    bool TLB_walk_caches;
+    // The hierarchy page walks read through when TLB_walk_caches is set.
+    cache_simulator_knobs_t walk_cache_knobs;
     uint64_t skip_refs;
     uint64_t warmup_refs;
     double warmup_fraction;
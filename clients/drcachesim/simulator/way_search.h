@@ -0,0 +1,233 @@
+/* **********************************************************
+ * Copyright (c) 2023 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* way_search: searches across all ways of a set of a caching device.
+ */
+
+#ifndef _WAY_SEARCH_H_
+#define _WAY_SEARCH_H_ 1
+
+#include <stdint.h>
+
+#if defined(X86_64)
+#    include <emmintrin.h>
+#elif defined(ARM_64)
+#    include <arm_neon.h>
+#endif
+
+#include "memref.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// These routines operate on the structure-of-arrays tags and counters kept
+// by caching_device_t, where the ways of one set are contiguous.  Each has a
+// vector path for the instruction sets which are part of the target's
+// baseline (SSE2 on x86_64 and NEON on AArch64) and a scalar path used for
+// the remaining ways and on other targets.  All return the lowest matching
+// way, just like a serial walk over the ways would.
+
+// Returns the first way whose tag equals "tag", or -1 if there is none.
+static inline int
+find_way_with_tag(const addr_t *tags, int num_ways, addr_t tag)
+{
+    int way = 0;
+#if defined(X86_64)
+    const __m128i key = _mm_set1_epi64x(static_cast<long long>(tag));
+    for (; way + 4 <= num_ways; way += 4) {
+        __m128i eq_lo = _mm_cmpeq_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(tags + way)), key);
+        __m128i eq_hi = _mm_cmpeq_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(tags + way + 2)), key);
+        // SSE2 has no 64-bit compare: a tag matches if both of its halves do.
+        eq_lo = _mm_and_si128(eq_lo, _mm_shuffle_epi32(eq_lo, _MM_SHUFFLE(2, 3, 0, 1)));
+        eq_hi = _mm_and_si128(eq_hi, _mm_shuffle_epi32(eq_hi, _MM_SHUFFLE(2, 3, 0, 1)));
+        int mask = _mm_movemask_pd(_mm_castsi128_pd(eq_lo)) |
+            (_mm_movemask_pd(_mm_castsi128_pd(eq_hi)) << 2);
+        if (mask != 0) {
+            for (int i = 0;; ++i) {
+                if ((mask & (1 << i)) != 0)
+                    return way + i;
+            }
+        }
+    }
+#elif defined(ARM_64)
+    const uint64x2_t key = vdupq_n_u64(static_cast<uint64_t>(tag));
+    for (; way + 2 <= num_ways; way += 2) {
+        uint64x2_t eq =
+            vceqq_u64(vld1q_u64(reinterpret_cast<const uint64_t *>(tags + way)), key);
+        if (vmaxvq_u32(vreinterpretq_u32_u64(eq)) != 0)
+            return vgetq_lane_u64(eq, 0) != 0 ? way : way + 1;
+    }
+#endif
+    for (; way < num_ways; ++way) {
+        if (tags[way] == tag)
+            return way;
+    }
+    return -1;
+}
+
+// Returns the first way whose counter equals "value", or -1 if there is none.
+static inline int
+find_way_with_counter(const int *counters, int num_ways, int value)
+{
+    int way = 0;
+#if defined(X86_64)
+    const __m128i key = _mm_set1_epi32(value);
+    for (; way + 4 <= num_ways; way += 4) {
+        __m128i eq = _mm_cmpeq_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(counters + way)), key);
+        if (_mm_movemask_ps(_mm_castsi128_ps(eq)) != 0)
+            break;
+    }
+#elif defined(ARM_64)
+    const int32x4_t key = vdupq_n_s32(value);
+    for (; way + 4 <= num_ways; way += 4) {
+        if (vmaxvq_u32(vceqq_s32(vld1q_s32(counters + way), key)) != 0)
+            break;
+    }
+#endif
+    for (; way < num_ways; ++way) {
+        if (counters[way] == value)
+            return way;
+    }
+    return -1;
+}
+
+// Returns the first way holding the largest counter.
+static inline int
+find_way_with_max_counter(const int *counters, int num_ways)
+{
+    int way = 0;
+    int max = counters[0];
+#if defined(X86_64)
+    if (num_ways >= 4) {
+        __m128i max_vec = _mm_loadu_si128(reinterpret_cast<const __m128i *>(counters));
+        for (way = 4; way + 4 <= num_ways; way += 4) {
+            __m128i val =
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(counters + way));
+            // SSE2 has no _mm_max_epi32 so we select by hand.
+            __m128i gt = _mm_cmpgt_epi32(val, max_vec);
+            max_vec = _mm_or_si128(_mm_and_si128(gt, val), _mm_andnot_si128(gt, max_vec));
+        }
+        int lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), max_vec);
+        for (int i = 0; i < 4; ++i) {
+            if (lanes[i] > max)
+                max = lanes[i];
+        }
+    }
+#elif defined(ARM_64)
+    if (num_ways >= 4) {
+        int32x4_t max_vec = vld1q_s32(counters);
+        for (way = 4; way + 4 <= num_ways; way += 4)
+            max_vec = vmaxq_s32(max_vec, vld1q_s32(counters + way));
+        max = vmaxvq_s32(max_vec);
+    }
+#endif
+    for (; way < num_ways; ++way) {
+        if (counters[way] > max)
+            max = counters[way];
+    }
+    return find_way_with_counter(counters, num_ways, max);
+}
+
+// Returns the first way holding the smallest counter.
+static inline int
+find_way_with_min_counter(const int *counters, int num_ways)
+{
+    int way = 0;
+    int min = counters[0];
+#if defined(X86_64)
+    if (num_ways >= 4) {
+        __m128i min_vec = _mm_loadu_si128(reinterpret_cast<const __m128i *>(counters));
+        for (way = 4; way + 4 <= num_ways; way += 4) {
+            __m128i val =
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(counters + way));
+            __m128i lt = _mm_cmplt_epi32(val, min_vec);
+            min_vec = _mm_or_si128(_mm_and_si128(lt, val), _mm_andnot_si128(lt, min_vec));
+        }
+        int lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), min_vec);
+        for (int i = 0; i < 4; ++i) {
+            if (lanes[i] < min)
+                min = lanes[i];
+        }
+    }
+#elif defined(ARM_64)
+    if (num_ways >= 4) {
+        int32x4_t min_vec = vld1q_s32(counters);
+        for (way = 4; way + 4 <= num_ways; way += 4)
+            min_vec = vminq_s32(min_vec, vld1q_s32(counters + way));
+        min = vminvq_s32(min_vec);
+    }
+#endif
+    for (; way < num_ways; ++way) {
+        if (counters[way] < min)
+            min = counters[way];
+    }
+    return find_way_with_counter(counters, num_ways, min);
+}
+
+// Increments every counter which is not larger than "limit".
+static inline void
+increment_counters_up_to(int *counters, int num_ways, int limit)
+{
+    int way = 0;
+#if defined(X86_64)
+    const __m128i lim = _mm_set1_epi32(limit);
+    const __m128i ones = _mm_set1_epi32(-1);
+    for (; way + 4 <= num_ways; way += 4) {
+        __m128i *ptr = reinterpret_cast<__m128i *>(counters + way);
+        __m128i val = _mm_loadu_si128(ptr);
+        // Subtracting the all-ones mask of the lanes <= limit adds 1 to them.
+        __m128i le = _mm_andnot_si128(_mm_cmpgt_epi32(val, lim), ones);
+        _mm_storeu_si128(ptr, _mm_sub_epi32(val, le));
+    }
+#elif defined(ARM_64)
+    const int32x4_t lim = vdupq_n_s32(limit);
+    for (; way + 4 <= num_ways; way += 4) {
+        int32x4_t val = vld1q_s32(counters + way);
+        uint32x4_t le = vcleq_s32(val, lim);
+        vst1q_s32(counters + way, vsubq_s32(val, vreinterpretq_s32_u32(le)));
+    }
+#endif
+    for (; way < num_ways; ++way) {
+        if (counters[way] <= limit)
+            ++counters[way];
+    }
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _WAY_SEARCH_H_ */
@@ -38,6 +38,7 @@
 
 #include <assert.h>
 
+#include <atomic>
 #include <iostream>
 #include <vector>
 
@@ -177,10 +178,125 @@ test_queries()
     return true;
 }
 
+bool
+test_batches()
+{
+    std::cerr << "\n----------------\nTesting batches\n";
+    static constexpr int NUM_INPUTS = 3;
+    static constexpr int NUM_INSTRS = 600;
+    static constexpr int BASE_TID = 100;
+    std::vector<trace_entry_t> inputs[NUM_INPUTS];
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        memref_tid_t tid = BASE_TID + i;
+        inputs[i].push_back(make_thread(tid));
+        inputs[i].push_back(make_pid(1));
+        for (int j = 0; j < NUM_INSTRS; ++j) {
+            if (j % 100 == 0)
+                inputs[i].push_back(make_timestamp(10 + j));
+            inputs[i].push_back(make_instr(42 + j));
+        }
+        inputs[i].push_back(make_exit(tid));
+    }
+
+    class test_tool_t : public analysis_tool_t {
+    public:
+        bool
+        process_memref(const memref_t &memref) override
+        {
+            assert(false); // Only expect batches.
+            return false;
+        }
+        bool
+        process_memref_batch(const memref_t *memrefs, size_t count) override
+        {
+            check_batch(memrefs, count, /*one_thread=*/false);
+            return true;
+        }
+        bool
+        print_results() override
+        {
+            return true;
+        }
+        bool
+        parallel_shard_supported() override
+        {
+            return true;
+        }
+        bool
+        memref_batch_supported() override
+        {
+            return true;
+        }
+        void *
+        parallel_shard_init_stream(int shard_index, void *worker_data,
+                                   memtrace_stream_t *stream) override
+        {
+            return nullptr;
+        }
+        bool
+        parallel_shard_memref(void *shard_data, const memref_t &memref) override
+        {
+            assert(false); // Only expect batches.
+            return false;
+        }
+        bool
+        parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs,
+                                    size_t count) override
+        {
+            check_batch(memrefs, count, /*one_thread=*/true);
+            return true;
+        }
+        std::atomic<int64_t> instrs { 0 };
+        std::atomic<int64_t> batches { 0 };
+
+    private:
+        void
+        check_batch(const memref_t *memrefs, size_t count, bool one_thread)
+        {
+            assert(count > 0);
+            ++batches;
+            for (size_t i = 0; i < count; ++i) {
+                // A batch in parallel mode belongs to a single shard.
+                assert(!one_thread || memrefs[i].instr.tid == memrefs[0].instr.tid);
+                if (type_is_instr(memrefs[i].instr.type))
+                    ++instrs;
+                // Timestamps and thread exits only ever end a batch.
+                if (memrefs[i].exit.type == TRACE_TYPE_THREAD_EXIT ||
+                    (memrefs[i].marker.type == TRACE_TYPE_MARKER &&
+                     memrefs[i].marker.marker_type == TRACE_MARKER_TYPE_TIMESTAMP))
+                    assert(i == count - 1);
+            }
+        }
+    };
+
+    for (int parallel = 0; parallel < 2; ++parallel) {
+        std::vector<scheduler_t::input_workload_t> sched_inputs;
+        for (int i = 0; i < NUM_INPUTS; i++) {
+            std::vector<scheduler_t::input_reader_t> readers;
+            readers.emplace_back(
+                std::unique_ptr<mock_reader_t>(new mock_reader_t(inputs[i])),
+                std::unique_ptr<mock_reader_t>(new mock_reader_t()), BASE_TID + i);
+            sched_inputs.emplace_back(std::move(readers));
+        }
+        std::vector<analysis_tool_t *> tools;
+        auto test_tool = std::unique_ptr<test_tool_t>(new test_tool_t);
+        tools.push_back(test_tool.get());
+        mock_analyzer_t analyzer(sched_inputs, &tools[0], (int)tools.size(),
+                                 parallel != 0, parallel != 0 ? 2 : 1, nullptr);
+        assert(!!analyzer);
+        bool res = analyzer.run();
+        assert(res);
+        assert(test_tool->instrs == NUM_INPUTS * NUM_INSTRS);
+        // Far fewer deliveries than records.
+        assert(test_tool->batches < NUM_INPUTS * NUM_INSTRS / 10);
+    }
+    return true;
+}
+
 int
 test_main(int argc, const char *argv[])
 {
-    if (!test_queries())
+    if (!test_queries() || !test_batches())
         return 1;
     std::cerr << "All done!\n";
     return 0;
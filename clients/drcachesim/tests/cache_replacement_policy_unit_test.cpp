@@ -37,6 +37,9 @@
 #include "cache_replacement_policy_unit_test.h"
 #include "simulator/cache_fifo.h"
 #include "simulator/cache_lru.h"
+#include "simulator/cache_plru.h"
+#include "simulator/cache_rrip.h"
+#include "simulator/cache_ship.h"
 
 namespace dynamorio {
 namespace drmemtrace {
@@ -99,6 +102,20 @@ public:
                expected_replacement_way_after_access);
     }
 
+    void
+    access_from_pc_and_check(const addr_t addr, const addr_t pc,
+                             const int expected_replacement_way_after_access)
+    {
+        memref_t ref;
+        ref.data.type = TRACE_TYPE_READ;
+        ref.data.size = 1;
+        ref.data.addr = addr;
+        ref.data.pc = pc;
+        this->request(ref);
+        assert(this->get_next_way_to_replace(this->get_block_index(addr)) ==
+               expected_replacement_way_after_access);
+    }
+
     void
     invalidate_and_check(const addr_t addr,
                          const int expected_replacement_way_after_access)
@@ -392,6 +409,182 @@ unit_test_cache_lfu_eight_way()
     cache_lfu_test.access_and_check(addr_vec[ADDR_I], 4); //     A  L  i  D  E  F  K  H
 }
 
+void
+unit_test_cache_plru_four_way()
+{
+    cache_policy_test_t<cache_plru_t> cache_plru_test(/*associativity=*/4,
+                                                      /*line_size=*/32,
+                                                      /*total_size=*/256);
+    cache_plru_test.initialize_cache();
+
+    assert(cache_plru_test.get_replace_policy() == "PLRU");
+    assert(cache_plru_test.block_indices_are_identical(addr_vec));
+    assert(cache_plru_test.tags_are_different(addr_vec));
+
+    // Lower-case letter shows the way that is to be replaced after the access.
+    // Unlike LRU, the victim only tracks the most recent access in each subtree.
+    cache_plru_test.access_and_check(addr_vec[ADDR_A], 1); //     A x X X
+    cache_plru_test.access_and_check(addr_vec[ADDR_B], 2); //     A B x X
+    cache_plru_test.access_and_check(addr_vec[ADDR_C], 3); //     A B C x
+    cache_plru_test.access_and_check(addr_vec[ADDR_D], 0); //     a B C D
+    cache_plru_test.access_and_check(addr_vec[ADDR_A], 2); //     A B c D
+    cache_plru_test.access_and_check(addr_vec[ADDR_A], 2); //     A B c D
+    cache_plru_test.access_and_check(addr_vec[ADDR_E], 1); //     A b E D
+
+    cache_plru_test.invalidate_and_check(addr_vec[ADDR_A], 0); // x B E D
+
+    cache_plru_test.access_and_check(addr_vec[ADDR_F], 3); //     F B E d
+    cache_plru_test.access_and_check(addr_vec[ADDR_B], 3); //     F B E d
+    cache_plru_test.access_and_check(addr_vec[ADDR_G], 0); //     f B E G
+    cache_plru_test.access_and_check(addr_vec[ADDR_E], 0); //     f B E G
+}
+
+void
+unit_test_cache_plru_bad_configs()
+{
+    // Tree PLRU needs a power-of-2 associativity that fits its per-set word.
+    caching_device_stats_t stats(/*miss_file=*/"", 32);
+    cache_plru_t plru_3way;
+    assert(!plru_3way.init(/*associativity=*/3, 32, 3 * 32 * 4, nullptr, &stats));
+    cache_plru_t plru_128way;
+    assert(!plru_128way.init(/*associativity=*/128, 32, 128 * 32, nullptr, &stats));
+}
+
+void
+unit_test_cache_srrip_four_way()
+{
+    cache_policy_test_t<cache_rrip_t> cache_srrip_test(/*associativity=*/4,
+                                                       /*line_size=*/32,
+                                                       /*total_size=*/256);
+    cache_srrip_test.initialize_cache();
+
+    assert(cache_srrip_test.get_replace_policy() == "SRRIP");
+    assert(cache_srrip_test.block_indices_are_identical(addr_vec));
+    assert(cache_srrip_test.tags_are_different(addr_vec));
+
+    // The comments show each way's RRPV after the access.  Fills insert at 2,
+    // hits promote to 0, and a miss ages the set until a 3 exists.
+    // Lower-case letter shows the way that is to be replaced after the access.
+    cache_srrip_test.access_and_check(addr_vec[ADDR_A], 1); // A2 x  X  X
+    cache_srrip_test.access_and_check(addr_vec[ADDR_B], 2); // A2 B2 x  X
+    cache_srrip_test.access_and_check(addr_vec[ADDR_C], 3); // A2 B2 C2 x
+    cache_srrip_test.access_and_check(addr_vec[ADDR_D], 0); // a2 B2 C2 D2
+    cache_srrip_test.access_and_check(addr_vec[ADDR_A], 1); // A0 b2 C2 D2
+    cache_srrip_test.access_and_check(addr_vec[ADDR_E], 2); // A1 E2 c3 D3
+    cache_srrip_test.access_and_check(addr_vec[ADDR_C], 3); // A1 E2 C0 d3
+    cache_srrip_test.access_and_check(addr_vec[ADDR_F], 1); // A1 e2 C0 F2
+    // The reused A and C outlast the scan of E, F, and G.
+    cache_srrip_test.access_and_check(addr_vec[ADDR_G], 3); // A2 G2 C1 f3
+    cache_srrip_test.access_and_check(addr_vec[ADDR_A], 3); // A0 G2 C1 f3
+
+    cache_srrip_test.invalidate_and_check(addr_vec[ADDR_C], 2); // A0 G2 x F3
+
+    cache_srrip_test.access_and_check(addr_vec[ADDR_B], 3); //     A0 G2 B2 f3
+}
+
+class cache_brrip_t : public cache_rrip_t {
+public:
+    cache_brrip_t()
+        : cache_rrip_t("cache_brrip", RRIP_BIMODAL)
+    {
+    }
+};
+
+void
+unit_test_cache_brrip_four_way()
+{
+    cache_policy_test_t<cache_brrip_t> cache_brrip_test(/*associativity=*/4,
+                                                        /*line_size=*/32,
+                                                        /*total_size=*/256);
+    cache_brrip_test.initialize_cache();
+
+    assert(cache_brrip_test.get_replace_policy() == "BRRIP");
+
+    // Most fills insert at 3, so a new block is the next victim unless it is hit.
+    cache_brrip_test.access_and_check(addr_vec[ADDR_A], 1); // A3 x  X  X
+    cache_brrip_test.access_and_check(addr_vec[ADDR_B], 2); // A3 B3 x  X
+    cache_brrip_test.access_and_check(addr_vec[ADDR_C], 3); // A3 B3 C3 x
+    cache_brrip_test.access_and_check(addr_vec[ADDR_D], 0); // a3 B3 C3 D3
+    cache_brrip_test.access_and_check(addr_vec[ADDR_A], 1); // A0 b3 C3 D3
+    cache_brrip_test.access_and_check(addr_vec[ADDR_E], 1); // A0 e3 C3 D3
+    cache_brrip_test.access_and_check(addr_vec[ADDR_F], 1); // A0 f3 C3 D3
+    cache_brrip_test.access_and_check(addr_vec[ADDR_F], 2); // A0 F0 c3 D3
+}
+
+class cache_drrip_test_t : public cache_rrip_t {
+public:
+    cache_drrip_test_t()
+        : cache_rrip_t("cache_drrip", RRIP_DYNAMIC)
+    {
+    }
+    int
+    get_psel() const
+    {
+        return psel_;
+    }
+};
+
+void
+unit_test_cache_drrip_dueling()
+{
+    // 128 sets give 32 constituencies of 4 sets: an SRRIP leader, a follower, a
+    // BRRIP leader, and another follower.
+    constexpr int ASSOC = 4;
+    constexpr int LINE_SIZE = 32;
+    constexpr int NUM_SETS = 128;
+    cache_stats_t stats(LINE_SIZE, /*miss_file=*/"", /*warmup_enabled=*/false);
+    cache_drrip_test_t cache;
+    assert(cache.init(ASSOC, LINE_SIZE, ASSOC * LINE_SIZE * NUM_SETS, nullptr, &stats));
+    assert(cache.get_replace_policy() == "DRRIP");
+    int start_psel = cache.get_psel();
+
+    // Cycling through one more line per set than fits thrashes SRRIP, while
+    // BRRIP keeps a fraction of the lines, so the followers should switch to
+    // BRRIP.
+    memref_t ref;
+    ref.data.type = TRACE_TYPE_READ;
+    ref.data.size = 1;
+    ref.data.pc = 0;
+    for (int iter = 0; iter < 50; ++iter) {
+        for (int line = 0; line < (ASSOC + 1) * NUM_SETS; ++line) {
+            ref.data.addr = line * LINE_SIZE;
+            cache.request(ref);
+        }
+    }
+    assert(cache.get_psel() > start_psel);
+    int64_t thrash_hits = stats.get_metric(metric_name_t::HITS);
+    assert(thrash_hits > 0);
+}
+
+void
+unit_test_cache_ship_four_way()
+{
+    cache_policy_test_t<cache_ship_t> cache_ship_test(/*associativity=*/4,
+                                                      /*line_size=*/32,
+                                                      /*total_size=*/256);
+    cache_ship_test.initialize_cache();
+
+    assert(cache_ship_test.get_replace_policy() == "SHiP");
+
+    constexpr addr_t REUSE_PC = 0x1000;
+    constexpr addr_t SCAN_PC = 0x2000;
+    // A fills from a PC whose blocks are reused.
+    cache_ship_test.access_from_pc_and_check(addr_vec[ADDR_A], REUSE_PC, 1);
+    cache_ship_test.access_from_pc_and_check(addr_vec[ADDR_A], REUSE_PC, 1);
+    // Until its signature is trained, the scanning PC inserts like SRRIP: each
+    // new block lands at 2 and the oldest is evicted.
+    cache_ship_test.access_from_pc_and_check(addr_vec[ADDR_B], SCAN_PC, 2);
+    cache_ship_test.access_from_pc_and_check(addr_vec[ADDR_C], SCAN_PC, 3);
+    cache_ship_test.access_from_pc_and_check(addr_vec[ADDR_D], SCAN_PC, 1);
+    // The eviction of B without reuse drops the scanning signature's counter to
+    // 0, after which its blocks are inserted at 3 and replaced first.
+    cache_ship_test.access_from_pc_and_check(addr_vec[ADDR_E], SCAN_PC, 1);
+    cache_ship_test.access_from_pc_and_check(addr_vec[ADDR_F], SCAN_PC, 1);
+    cache_ship_test.access_from_pc_and_check(addr_vec[ADDR_G], SCAN_PC, 1);
+    // The reused block survived the scan.
+    cache_ship_test.access_from_pc_and_check(addr_vec[ADDR_A], REUSE_PC, 1);
+}
+
 void
 unit_test_cache_replacement_policy()
 {
@@ -401,6 +594,12 @@ unit_test_cache_replacement_policy()
     unit_test_cache_fifo_eight_way();
     unit_test_cache_lfu_four_way();
     unit_test_cache_lfu_eight_way();
+    unit_test_cache_plru_four_way();
+    unit_test_cache_plru_bad_configs();
+    unit_test_cache_srrip_four_way();
+    unit_test_cache_brrip_four_way();
+    unit_test_cache_drrip_dueling();
+    unit_test_cache_ship_four_way();
     // XXX i#4842: Add more test sequences.
 }
 
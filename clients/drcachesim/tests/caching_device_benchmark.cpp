@@ -0,0 +1,176 @@
+/* **********************************************************
+ * Copyright (c) 2023 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Microbenchmark of caching_device_t lookups: compares the accesses per second of
+ * serial way walks versus the tag index (caching_device_t::set_hashtable_use())
+ * for typical L1, L2, and LLC geometries, and checks that both produce identical
+ * results.  It then compares the replacement policies against LRU.  Takes an
+ * optional access count: the regular test passes a tiny count as a smoke test, while
+ * the default is large enough for stable measurements.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#undef NDEBUG
+#include <assert.h>
+
+#include "simulator/cache_lru.h"
+#include "simulator/cache_plru.h"
+#include "simulator/cache_rrip.h"
+#include "simulator/cache_ship.h"
+#include "simulator/caching_device_stats.h"
+#include "../common/memref.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+namespace {
+
+struct benchmark_config_t {
+    std::string name;
+    int assoc;
+    int size;
+};
+
+struct benchmark_result_t {
+    double accesses_per_sec;
+    int64_t hits;
+    int64_t misses;
+};
+
+const char *const POLICIES[] = { "LRU", "PLRU", "SRRIP", "DRRIP", "SHiP" };
+
+std::unique_ptr<cache_t>
+create_cache(const std::string &policy, const std::string &name)
+{
+    if (policy == "PLRU")
+        return std::unique_ptr<cache_t>(new cache_plru_t(name));
+    if (policy == "SRRIP")
+        return std::unique_ptr<cache_t>(new cache_rrip_t(name));
+    if (policy == "DRRIP")
+        return std::unique_ptr<cache_t>(
+            new cache_rrip_t(name, cache_rrip_t::RRIP_DYNAMIC));
+    if (policy == "SHiP")
+        return std::unique_ptr<cache_t>(new cache_ship_t(name));
+    return std::unique_ptr<cache_t>(new cache_lru_t(name));
+}
+
+benchmark_result_t
+run_benchmark(const benchmark_config_t &config, const std::string &policy,
+              bool use_index, int64_t num_accesses)
+{
+    static constexpr int LINE_SIZE = 64;
+    caching_device_stats_t stats(/*miss_file=*/"", LINE_SIZE);
+    std::unique_ptr<cache_t> cache_owner = create_cache(policy, config.name);
+    cache_t &cache = *cache_owner;
+    bool initialized = cache.init(config.assoc, LINE_SIZE, config.size,
+                                  /*parent=*/nullptr, &stats);
+    assert(initialized);
+    cache.set_hashtable_use(use_index);
+
+    // Most accesses go to a hot region half the cache size; the rest are spread
+    // over a region four times the cache size to cause misses and evictions.
+    const uint64_t hot_lines = config.size / LINE_SIZE / 2;
+    const uint64_t cold_lines = 4 * (config.size / LINE_SIZE);
+    memref_t ref;
+    ref.data.type = TRACE_TYPE_READ;
+    ref.data.size = 4;
+    ref.data.pc = 0;
+    uint64_t rand = 12345;
+    auto start = std::chrono::steady_clock::now();
+    for (int64_t i = 0; i < num_accesses; ++i) {
+        // A 64-bit LCG is plenty random for this purpose.
+        rand = rand * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t bits = rand >> 32;
+        uint64_t line = (bits % 8 != 0) ? (bits >> 3) % hot_lines
+                                        : hot_lines + (bits >> 3) % cold_lines;
+        ref.data.addr = line * LINE_SIZE;
+        // A few PCs, with the cold region's accesses from their own, give SHiP
+        // signatures to learn from.
+        ref.data.pc = 0x1000 + (bits % 8 != 0 ? (bits >> 20) % 4 : 4) * 4;
+        cache.request(ref);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(end - start).count();
+    benchmark_result_t result;
+    result.accesses_per_sec = secs > 0 ? num_accesses / secs : 0;
+    result.hits = stats.get_metric(metric_name_t::HITS);
+    result.misses = stats.get_metric(metric_name_t::MISSES);
+    return result;
+}
+
+} // namespace
+
+int
+test_main(int argc, const char *argv[])
+{
+    int64_t num_accesses = 5000000;
+    if (argc > 1)
+        num_accesses = std::atoll(argv[1]);
+    const benchmark_config_t configs[] = {
+        { "L1", 8, 32 * 1024 },
+        { "L2", 16, 1024 * 1024 },
+        { "LLC", 16, 32 * 1024 * 1024 },
+    };
+    for (const auto &config : configs) {
+        benchmark_result_t walk = run_benchmark(config, "LRU", false, num_accesses);
+        benchmark_result_t index = run_benchmark(config, "LRU", true, num_accesses);
+        assert(walk.hits == index.hits && walk.misses == index.misses);
+        assert(walk.hits + walk.misses == num_accesses);
+        std::cerr << std::setw(4) << config.name << " (assoc=" << config.assoc
+                  << ", size=" << config.size << "): way walk " << std::fixed
+                  << std::setprecision(1) << walk.accesses_per_sec / 1e6
+                  << "M accesses/sec, tag index " << index.accesses_per_sec / 1e6
+                  << "M accesses/sec\n";
+    }
+    for (const auto &config : configs) {
+        std::cerr << std::setw(4) << config.name << " policies:";
+        for (const char *policy : POLICIES) {
+            benchmark_result_t result =
+                run_benchmark(config, policy, false, num_accesses);
+            assert(result.hits + result.misses == num_accesses);
+            std::cerr << " " << policy << " " << std::fixed << std::setprecision(1)
+                      << result.accesses_per_sec / 1e6 << "M/s "
+                      << std::setprecision(2)
+                      << 100.0 * result.misses / num_accesses << "% miss;";
+        }
+        std::cerr << "\n";
+    }
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -33,14 +33,23 @@
 // Unit tests for drcachesim
 #include <iostream>
 #include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <vector>
 #undef NDEBUG
 #include <assert.h>
 #include "config_reader_unit_test.h"
 #include "cache_replacement_policy_unit_test.h"
+#include "memref_gen.h"
 #include "simulator/cache.h"
 #include "simulator/cache_lru.h"
 #include "simulator/cache_simulator.h"
+#include "simulator/page_size_map.h"
+#include "simulator/page_walker.h"
+#include "simulator/tlb.h"
 #include "../common/memref.h"
+#include "../common/memtrace_stream.h"
 #include "../common/utils.h"
 
 namespace dynamorio {
@@ -313,6 +322,219 @@ LLC {
            num_accesses - 1);
 }
 
+// Simulates the cores of "knobs" in parallel with "make_ref(core, i)" as record i
+// of each core and checks that all results match a serial simulation interleaving
+// the cores one record at a time.
+static void
+check_core_sharded_matches_serial(cache_simulator_knobs_t knobs,
+                                  const std::function<memref_t(int, int)> &make_ref,
+                                  int num_refs)
+{
+    const int num_cores = static_cast<int>(knobs.num_cores);
+    // Serial reference: each tid is assigned to its own core in order.
+    cache_simulator_t serial_sim(knobs);
+    for (int i = 0; i < num_refs; i++) {
+        for (int core = 0; core < num_cores; core++) {
+            if (!serial_sim.process_memref(make_ref(core, i))) {
+                std::cerr << "drcachesim unit_test_core_sharded failed: "
+                          << serial_sim.get_error_string() << "\n";
+                exit(1);
+            }
+        }
+    }
+
+    knobs.parallel_cores = true;
+    cache_simulator_t parallel_sim(knobs);
+    assert(parallel_sim.parallel_shard_supported());
+    assert(!parallel_sim.initialize_shard_type(SHARD_BY_THREAD).empty());
+    assert(parallel_sim.initialize_shard_type(SHARD_BY_CORE).empty());
+    std::vector<std::thread> threads;
+    for (int core = 0; core < num_cores; core++) {
+        threads.emplace_back([&parallel_sim, &make_ref, core, num_refs]() {
+            void *worker = parallel_sim.parallel_worker_init(core);
+            void *shard = parallel_sim.parallel_shard_init_stream(core, worker, nullptr);
+            for (int i = 0; i < num_refs; i++) {
+                if (!parallel_sim.parallel_shard_memref(shard, make_ref(core, i))) {
+                    std::cerr << "drcachesim unit_test_core_sharded failed: "
+                              << parallel_sim.parallel_shard_error(shard) << "\n";
+                    exit(1);
+                }
+                // Skew the cores' progress to vary the interleaving.
+                if (i % (100 * (core + 1)) == 0)
+                    std::this_thread::yield();
+            }
+            assert(parallel_sim.parallel_shard_exit(shard));
+            assert(parallel_sim.parallel_worker_exit(worker).empty());
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    const metric_name_t metrics[] = { metric_name_t::HITS, metric_name_t::MISSES,
+                                      metric_name_t::CHILD_HITS };
+    for (metric_name_t metric : metrics) {
+        for (int core = 0; core < num_cores; core++) {
+            assert(parallel_sim.get_cache_metric(metric, 1, core) ==
+                   serial_sim.get_cache_metric(metric, 1, core));
+        }
+        assert(parallel_sim.get_cache_metric(metric, 2) ==
+               serial_sim.get_cache_metric(metric, 2));
+    }
+    assert(parallel_sim.get_cache_metric(metric_name_t::HITS, 2) > 0);
+    assert(parallel_sim.get_cache_metric(metric_name_t::CHILD_HITS, 2) > 0);
+}
+
+void
+unit_test_core_sharded()
+{
+    static constexpr int NUM_CORES = 4;
+    static constexpr int NUM_REFS = 20000;
+    cache_simulator_knobs_t knobs = make_test_knobs();
+    knobs.num_cores = NUM_CORES;
+    knobs.LL_size = 1024 * 64;
+    // Each core touches its own lines, some of them repeatedly.
+    check_core_sharded_matches_serial(
+        knobs,
+        [](int core, int i) {
+            memref_t ref;
+            ref.data.type = (i % 3 == 0) ? TRACE_TYPE_WRITE : TRACE_TYPE_READ;
+            ref.data.tid = core + 1;
+            ref.data.pid = 1;
+            ref.data.size = 4;
+            ref.data.addr =
+                (core + 1) * 0x100000 + ((i % 5 == 0) ? i % 97 : i % 16) * 64;
+            return ref;
+        },
+        NUM_REFS);
+    // The cores share lines in an LLC too small to hold them all, so the LLC
+    // results depend on the order in which the cores' misses reach it.
+    knobs.LL_size = 1024 * 16;
+    knobs.L1I_size = 1024;
+    knobs.L1D_size = 1024;
+    knobs.L1I_assoc = 4;
+    knobs.L1D_assoc = 4;
+    check_core_sharded_matches_serial(
+        knobs,
+        [](int core, int i) {
+            memref_t ref;
+            ref.data.type = (i % 4 == 0) ? TRACE_TYPE_INSTR : TRACE_TYPE_READ;
+            ref.data.tid = core + 1;
+            ref.data.pid = 1;
+            ref.data.size = 4;
+            ref.data.addr = 0x100000 + ((i / 2 * (core + 3) + core * 7) % 400) * 64;
+            return ref;
+        },
+        NUM_REFS);
+
+    // When the analyzer runs serially, or the hierarchy cannot be simulated in
+    // parallel, we fall back to a regular serial simulation.
+    auto make_shared_ref = [](int core, int i) {
+        memref_t ref;
+        ref.data.type = TRACE_TYPE_READ;
+        ref.data.tid = core + 1;
+        ref.data.pid = 1;
+        ref.data.size = 4;
+        ref.data.addr = 0x100000 + ((i * (core + 3)) % 400) * 64;
+        return ref;
+    };
+    auto check_serial_fallback = [&make_shared_ref](cache_simulator_knobs_t knobs,
+                                                    memtrace_stream_t *serial_stream) {
+        cache_simulator_t serial_sim(knobs);
+        knobs.parallel_cores = true;
+        cache_simulator_t fallback_sim(knobs);
+        assert(fallback_sim.initialize_stream(serial_stream).empty());
+        assert(fallback_sim.initialize_shard_type(SHARD_BY_CORE).empty());
+        for (int i = 0; i < 1000; i++) {
+            for (int core = 0; core < static_cast<int>(knobs.num_cores); core++) {
+                assert(serial_sim.process_memref(make_shared_ref(core, i)));
+                assert(fallback_sim.process_memref(make_shared_ref(core, i)));
+            }
+        }
+        for (metric_name_t metric : { metric_name_t::HITS, metric_name_t::MISSES }) {
+            assert(fallback_sim.get_cache_metric(metric, 2) ==
+                   serial_sim.get_cache_metric(metric, 2));
+        }
+        assert(fallback_sim.get_cache_metric(metric_name_t::MISSES, 2) > 0);
+    };
+    default_memtrace_stream_t serial_stream;
+    check_serial_fallback(knobs, &serial_stream);
+    knobs.model_coherence = true;
+    cache_simulator_t coherence_sim(knobs);
+    assert(!coherence_sim.parallel_shard_supported());
+    check_serial_fallback(knobs, nullptr);
+    knobs.model_coherence = false;
+
+    // Unsupported knobs are rejected.
+    knobs.parallel_cores = true;
+    knobs.warmup_refs = 10;
+    cache_simulator_t warmup_sim(knobs);
+    assert(!warmup_sim.initialize_shard_type(SHARD_BY_CORE).empty());
+}
+
+void
+unit_test_sampling_extrapolation()
+{
+    static constexpr int NUM_CORES = 2;
+    static constexpr int REMOVED_INSTRS = 100;
+    static constexpr int WARMUP_INSTRS = 20;
+    static constexpr int WINDOW_INSTRS = 10;
+    static constexpr int WINDOW_LINES = 5;
+    // Each thread has a removed region, a warmup region missing on every
+    // instruction, and a window missing on its first WINDOW_LINES instructions.
+    auto make_ref = [](int core, int i) {
+        memref_tid_t tid = core + 1;
+        addr_t base = (core + 1) * 0x100000;
+        if (i == 0)
+            return gen_marker(tid, TRACE_MARKER_TYPE_SAMPLE_SKIP, REMOVED_INSTRS);
+        if (i <= WARMUP_INSTRS)
+            return gen_instr(tid, base + i * 64);
+        if (i == WARMUP_INSTRS + 1)
+            return gen_marker(tid, TRACE_MARKER_TYPE_SAMPLE_WINDOW, 0);
+        return gen_instr(tid, base + 0x10000 + (i % WINDOW_LINES) * 64);
+    };
+    const int num_refs = WARMUP_INSTRS + WINDOW_INSTRS + 2;
+    // Only the window misses are scaled, by the ratio of all instructions to
+    // window ones.
+    const int64_t expected = NUM_CORES * WINDOW_LINES *
+        (WINDOW_INSTRS + WARMUP_INSTRS + REMOVED_INSTRS) / WINDOW_INSTRS;
+    cache_simulator_knobs_t knobs = make_test_knobs();
+    knobs.num_cores = NUM_CORES;
+    knobs.LL_size = 1024 * 64;
+
+    cache_simulator_t serial_sim(knobs);
+    for (int i = 0; i < num_refs; i++) {
+        for (int core = 0; core < NUM_CORES; core++)
+            assert(serial_sim.process_memref(make_ref(core, i)));
+    }
+    assert(serial_sim.get_cache_metric(metric_name_t::MISSES, 2) ==
+           NUM_CORES * (WARMUP_INSTRS + WINDOW_LINES));
+    assert(serial_sim.get_extrapolated_misses("LL") == expected);
+
+    // The LLC is shared among the cores in parallel operation, where its misses
+    // are attributed as the cores' requests are replayed.
+    knobs.parallel_cores = true;
+    cache_simulator_t parallel_sim(knobs);
+    assert(parallel_sim.initialize_shard_type(SHARD_BY_CORE).empty());
+    std::vector<std::thread> threads;
+    for (int core = 0; core < NUM_CORES; core++) {
+        threads.emplace_back([&parallel_sim, &make_ref, core, num_refs]() {
+            void *worker = parallel_sim.parallel_worker_init(core);
+            void *shard = parallel_sim.parallel_shard_init_stream(core, worker, nullptr);
+            for (int i = 0; i < num_refs; i++)
+                assert(parallel_sim.parallel_shard_memref(shard, make_ref(core, i)));
+            assert(parallel_sim.parallel_shard_exit(shard));
+            assert(parallel_sim.parallel_worker_exit(worker).empty());
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    assert(parallel_sim.get_extrapolated_misses("LL") == expected);
+
+    cache_simulator_t unsampled_sim(make_test_knobs());
+    assert(unsampled_sim.process_memref(gen_instr(1)));
+    assert(unsampled_sim.get_extrapolated_misses("LL") == -1);
+}
+
 // Generate a sequence of read accesses to a cache in a 2-D access pattern.
 // Loop A is the outer loop, while loop B is the inner, fastest-changing
 // loop.  The whole 2D access pattern is repeated <loop_count> times.
@@ -596,6 +818,248 @@ unit_test_cache_accessors()
     }
 }
 
+// Tests page size lookups and the validation of huge page ranges.
+void
+unit_test_page_size_map()
+{
+    page_size_map_t map(12);
+    assert(map.page_bits(0x200000) == 12);
+    assert(map.add_range(0x200000, 0x600000, 21).empty());
+    assert(map.add_range(0x40000000, 0x80000000, 30).empty());
+    // Misaligned, smaller than a base page, or overlapping ranges are rejected.
+    assert(!map.add_range(0x800000, 0x900000, 21).empty());
+    assert(!map.add_range(0x800000, 0xa00000, 11).empty());
+    assert(!map.add_range(0x400000, 0x800000, 21).empty());
+    assert(map.page_bits(0x1ff000) == 12);
+    assert(map.page_bits(0x200000) == 21);
+    assert(map.page_bits(0x5fffff) == 21);
+    assert(map.page_bits(0x600000) == 12);
+    assert(map.page_bits(0x7fffffff) == 30);
+    assert(map.page_bits(0x80000000) == 12);
+
+    page_size_map_t from_file(12);
+    std::istringstream good("# start end size\n\n0x200000 0x400000 2M\n"
+                            "1073741824 0x80000000 1g\n");
+    assert(from_file.read(good).empty());
+    assert(from_file.page_bits(0x300000) == 21);
+    assert(from_file.page_bits(0x40000000) == 30);
+    std::istringstream bad("0x200000 0x400000 3M\n");
+    assert(!from_file.read(bad).empty());
+}
+
+// Tests that the paging-structure caches shorten walks and that walks read
+// their entries through a cache hierarchy.
+void
+unit_test_page_walker()
+{
+    constexpr addr_t BASE = 0x7f0000000000;
+    constexpr memref_pid_t PID = 1;
+    page_table_t table;
+    page_walker_t walker(&table, { 2, 4, 32 }, { 4, 40, 200 }, nullptr, 0);
+    walker.walk(PID, BASE, 12);
+    assert(walker.get_entry_reads() == 4);
+    // The next page shares the PDE, so only its PTE is read.
+    walker.walk(PID, BASE + 0x1000, 12);
+    assert(walker.get_pwc_hits(page_walker_t::PD) == 1);
+    assert(walker.get_entry_reads() == 5);
+    // The next 2M region shares the PDPTE and reads its PDE and PTE.
+    walker.walk(PID, BASE + 0x200000, 12);
+    assert(walker.get_pwc_hits(page_walker_t::PDPT) == 1);
+    assert(walker.get_entry_reads() == 7);
+    // A 2M page ends at its PDE.
+    walker.walk(PID, BASE + 0x400000, 21);
+    assert(walker.get_entry_reads() == 8);
+    // Another process shares nothing.
+    walker.walk(PID + 1, BASE, 12);
+    assert(walker.get_entry_reads() == 12);
+    assert(walker.get_walks() == 5);
+    // Without a hierarchy every entry costs the memory latency.
+    assert(walker.get_cycles() == 12 * 200);
+    assert(walker.get_entries_from(0) == 12);
+
+    page_walker_t no_pwc(&table, { 0, 0, 0 }, { 4, 40, 200 }, nullptr, 0);
+    no_pwc.walk(PID, BASE, 12);
+    no_pwc.walk(PID, BASE + 0x1000, 12);
+    assert(no_pwc.get_entry_reads() == 8);
+
+    cache_simulator_knobs_t knobs = make_test_knobs();
+    cache_simulator_t caches(knobs);
+    page_walker_t cached(&table, { 0, 0, 0 }, { 4, 40, 200 }, &caches, 0);
+    cached.walk(PID, BASE, 12);
+    assert(cached.get_entries_from(0) == 4);
+    // All four entries are now in the L1, including the neighboring PTE which
+    // shares a line with the first.
+    cached.walk(PID, BASE + 0x1000, 12);
+    assert(cached.get_entries_from(1) == 4);
+    assert(cached.get_cycles() == 4 * 200 + 4 * 4);
+}
+
+// Tests that a TLB holds one entry per huge page alongside base pages and
+// walks on its misses.
+void
+unit_test_tlb_huge_pages()
+{
+    constexpr addr_t HUGE_BASE = 0x40000000;
+    page_size_map_t map(12);
+    assert(map.add_range(HUGE_BASE, HUGE_BASE + 0x400000, 21).empty());
+    page_table_t table;
+    page_walker_t walker(&table, { 2, 4, 32 }, { 4, 40, 200 }, nullptr, 0);
+    tlb_stats_t stats(4096);
+    tlb_t tlb;
+    assert(tlb.init(4, 4096, 16, nullptr, &stats));
+    tlb.set_page_size_map(&map);
+    tlb.set_page_walker(&walker);
+
+    memref_t ref = {};
+    ref.data.type = TRACE_TYPE_READ;
+    ref.data.pid = 1;
+    ref.data.size = 8;
+    // Every base page of a 2M page hits its single entry.
+    for (addr_t offs = 0; offs < 0x200000; offs += 0x1000) {
+        ref.data.addr = HUGE_BASE + offs;
+        tlb.request(ref);
+    }
+    assert(stats.get_metric(metric_name_t::MISSES) == 1);
+    assert(stats.get_metric(metric_name_t::HITS) == 511);
+    // A 2M walk reads the PML4E, PDPTE, and PDE.
+    assert(walker.get_entry_reads() == 3);
+    // An access straddling both 2M pages needs both entries.
+    ref.data.addr = HUGE_BASE + 0x1ffffc;
+    tlb.request(ref);
+    assert(stats.get_metric(metric_name_t::MISSES) == 2);
+    assert(walker.get_walks() == 2);
+    // Base pages below the range each need their own entry.
+    for (addr_t offs = 0x1000; offs <= 0x4000; offs += 0x1000) {
+        ref.data.addr = HUGE_BASE - offs;
+        tlb.request(ref);
+    }
+    assert(stats.get_metric(metric_name_t::MISSES) == 6);
+    assert(walker.get_walks() == 6);
+}
+
+// Runs "instrs" instructions, every "load_every"th of which loads from "stride"
+// bytes past the previous load.
+static void
+run_timing_trace(cache_simulator_t &cache_sim, int instrs, int load_every,
+                 addr_t stride)
+{
+    memref_t instr = {};
+    instr.instr.type = TRACE_TYPE_INSTR;
+    instr.instr.size = 4;
+    instr.instr.addr = 0x1000;
+    memref_t load = {};
+    load.data.type = TRACE_TYPE_READ;
+    load.data.size = 8;
+    load.data.addr = 0x100000;
+    for (int i = 0; i < instrs; i++) {
+        if (!cache_sim.process_memref(instr)) {
+            std::cerr << "drcachesim unit_test_cache_timing failed: "
+                      << cache_sim.get_error_string() << "\n";
+            exit(1);
+        }
+        if (i % load_every != 0)
+            continue;
+        cache_sim.process_memref(load);
+        load.data.addr += stride;
+    }
+}
+
+void
+unit_test_cache_timing()
+{
+    constexpr int NUM_INSTRS = 1000;
+    cache_simulator_knobs_t knobs = make_test_knobs();
+    knobs.timing = true;
+    // Every load misses all the way to memory.
+    knobs.rob_size = 1;
+    cache_simulator_t blocking(knobs);
+    run_timing_trace(blocking, NUM_INSTRS, 1, 64);
+    const cache_timing_t *timing = blocking.get_timing();
+    assert(timing->get_instructions(0) == NUM_INSTRS);
+    assert(timing->get_cycles(0) > NUM_INSTRS * (knobs.LL_latency + 1));
+    assert(timing->get_amat(0) > knobs.LL_latency + knobs.dram_row_hit_latency);
+    // Plus the single instruction line.
+    assert(timing->get_dram().get_reads() == NUM_INSTRS + 1);
+    // Consecutive lines share rows.
+    assert(timing->get_dram().get_row_hits() > timing->get_dram().get_row_conflicts());
+    uint64_t blocking_cycles = timing->get_cycles(0);
+
+    // An instruction window overlaps the misses.
+    knobs.rob_size = 224;
+    cache_simulator_t overlapped(knobs);
+    run_timing_trace(overlapped, NUM_INSTRS, 1, 64);
+    uint64_t overlapped_cycles = overlapped.get_timing()->get_cycles(0);
+    assert(overlapped_cycles < blocking_cycles / 4);
+    assert(overlapped.get_timing()->get_mshr_stall_cycles(0) > 0);
+
+    // Fewer MSHRs limit the overlap.
+    knobs.L1_mshrs = 2;
+    cache_simulator_t few_mshrs(knobs);
+    run_timing_trace(few_mshrs, NUM_INSTRS, 1, 64);
+    assert(few_mshrs.get_timing()->get_cycles(0) > 2 * overlapped_cycles);
+    assert(few_mshrs.get_timing()->get_mshr_stall_cycles(0) >
+           overlapped.get_timing()->get_mshr_stall_cycles(0));
+
+    // So does the bandwidth.
+    knobs.L1_mshrs = 16;
+    knobs.dram_bytes_per_cycle = 1;
+    cache_simulator_t narrow_bus(knobs);
+    run_timing_trace(narrow_bus, NUM_INSTRS, 1, 64);
+    assert(narrow_bus.get_timing()->get_cycles(0) >= NUM_INSTRS * 64);
+
+    // Prefetches of the next line arrive too late for back-to-back loads walking
+    // through memory and in time for sparse ones.
+    knobs = make_test_knobs();
+    knobs.timing = true;
+    knobs.data_prefetcher = "nextline";
+    cache_simulator_t dense(knobs);
+    run_timing_trace(dense, NUM_INSTRS, 1, 8);
+    assert(dense.get_timing()->get_prefetches(0) > 0);
+    assert(dense.get_timing()->get_late_prefetches(0) > 0);
+    assert(dense.get_timing()->get_timely_prefetches(0) == 0);
+    cache_simulator_t sparse(knobs);
+    run_timing_trace(sparse, NUM_INSTRS * 100, 500, 64);
+    assert(sparse.get_timing()->get_timely_prefetches(0) > 0);
+    assert(sparse.get_timing()->get_late_prefetches(0) == 0);
+
+    // Latencies from a configuration file.
+    std::string config = R"MYCONFIG(// Timed 2-level config.
+num_cores       1
+line_size       64
+warmup_refs     1000
+timing          true
+L1I {
+  type            instruction
+  core            0
+  size            256
+  assoc           4
+  latency         2
+  parent          LLC
+}
+L1D {
+  type            data
+  core            0
+  size            256
+  assoc           4
+  latency         3
+  mshrs           1
+  parent          LLC
+}
+LLC {
+  size            8K
+  assoc           8
+  latency         20
+  parent          memory
+}
+)MYCONFIG";
+    std::istringstream config_in(config);
+    cache_simulator_t configured(&config_in);
+    assert(configured.get_timing() != nullptr);
+    run_timing_trace(configured, NUM_INSTRS, 1, 0);
+    // Once the line has arrived every load hits.
+    assert(configured.get_timing()->get_amat(0) == 3);
+}
+
 int
 test_main(int argc, const char *argv[])
 {
@@ -614,7 +1078,13 @@ test_main(int argc, const char *argv[])
     unit_test_warmup_refs();
     unit_test_sim_refs();
     unit_test_child_hits();
+    unit_test_core_sharded();
+    unit_test_sampling_extrapolation();
     unit_test_cache_replacement_policy();
+    unit_test_page_size_map();
+    unit_test_page_walker();
+    unit_test_tlb_huge_pages();
+    unit_test_cache_timing();
     return 0;
 }
 
@@ -0,0 +1,153 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Microbenchmark of flat_addr_map_t versus std::unordered_map for the per-shard
+ * line counting and the final reduction done by tools such as histogram_t: reports
+ * the time and the resident memory of each, and checks that both produce
+ * identical counts.  Takes an optional access count; the default is small enough
+ * to run as a regular test.
+ */
+
+#include <stdint.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+#undef NDEBUG
+#include <assert.h>
+
+#include "flat_addr_map.h"
+#include "memref.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+namespace {
+
+constexpr int NUM_SHARDS = 4;
+
+// Returns the resident set size in bytes, or 0 if it is unavailable.
+size_t
+get_rss()
+{
+#ifdef LINUX
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (file == nullptr)
+        return 0;
+    unsigned long size, resident;
+    int res = fscanf(file, "%lu %lu", &size, &resident);
+    fclose(file);
+    if (res != 2)
+        return 0;
+    return resident * 4096;
+#else
+    return 0;
+#endif
+}
+
+struct benchmark_result_t {
+    double seconds;
+    size_t rss;
+    size_t unique_lines;
+    uint64_t checksum;
+};
+
+// Each shard touches a hot set of lines shared by all shards and a large set of
+// lines private to it, as is typical of threads with a shared code and heap.
+template <typename map_t>
+benchmark_result_t
+run_benchmark(int64_t num_accesses)
+{
+    const uint64_t hot_lines = 1 << 14;
+    const uint64_t cold_lines = static_cast<uint64_t>(num_accesses) / NUM_SHARDS / 4;
+    size_t rss_before = get_rss();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<map_t> shards(NUM_SHARDS);
+    map_t reduced;
+    for (int shard = 0; shard < NUM_SHARDS; ++shard) {
+        uint64_t rand = 12345 + shard;
+        for (int64_t i = 0; i < num_accesses / NUM_SHARDS; ++i) {
+            // A 64-bit LCG is plenty random for this purpose.
+            rand = rand * 6364136223846793005ULL + 1442695040888963407ULL;
+            uint64_t bits = rand >> 32;
+            addr_t line = (bits % 4 != 0)
+                ? 0x7f0000000000ULL / 64 + (bits >> 2) % hot_lines
+                : 0x10000000ULL * (shard + 1) + (bits >> 2) % cold_lines;
+            ++shards[shard][line];
+        }
+    }
+    for (const map_t &shard : shards) {
+        for (const auto &keyval : shard)
+            reduced[keyval.first] += keyval.second;
+    }
+    auto end = std::chrono::steady_clock::now();
+    benchmark_result_t result;
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    size_t rss_after = get_rss();
+    result.rss = rss_after > rss_before ? rss_after - rss_before : 0;
+    result.unique_lines = reduced.size();
+    result.checksum = 0;
+    for (const auto &keyval : reduced)
+        result.checksum += keyval.first * keyval.second;
+    return result;
+}
+
+} // namespace
+
+int
+test_main(int argc, const char *argv[])
+{
+    int64_t num_accesses = 4000000;
+    if (argc > 1)
+        num_accesses = std::atoll(argv[1]);
+    // We run the flat map first: its large single allocations are returned to the
+    // system when freed, so they do not hide the node allocations measured next.
+    benchmark_result_t flat = run_benchmark<flat_addr_map_t<uint64_t>>(num_accesses);
+    benchmark_result_t nodes =
+        run_benchmark<std::unordered_map<addr_t, uint64_t>>(num_accesses);
+    assert(flat.unique_lines == nodes.unique_lines && flat.checksum == nodes.checksum);
+    std::cerr << num_accesses << " accesses to " << flat.unique_lines
+              << " unique lines in " << NUM_SHARDS << " shards:\n"
+              << std::fixed << std::setprecision(3) << "  std::unordered_map: "
+              << nodes.seconds << "s, " << nodes.rss / 1024 << "KB RSS\n"
+              << "  flat_addr_map_t:    " << flat.seconds << "s, " << flat.rss / 1024
+              << "KB RSS\n";
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -0,0 +1,215 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Unit tests for flat_addr_map_t and flat_addr_set_t. */
+
+#include <stdint.h>
+
+#include <cstdio>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "flat_addr_map.h"
+#include "memref.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+#define CHECK(cond, msg, ...)             \
+    do {                                  \
+        if (!(cond)) {                    \
+            fprintf(stderr, "%s\n", msg); \
+            return false;                 \
+        }                                 \
+    } while (0)
+
+namespace {
+
+uint64_t
+next_random(uint64_t &state)
+{
+    // A 64-bit LCG is plenty random for this purpose.
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 16;
+}
+
+bool
+same_contents(const flat_addr_map_t<uint64_t> &map,
+              const std::unordered_map<addr_t, uint64_t> &expect)
+{
+    CHECK(map.size() == expect.size(), "size mismatch");
+    size_t iterated = 0;
+    for (const auto &entry : map) {
+        const auto it = expect.find(entry.first);
+        CHECK(it != expect.end() && it->second == entry.second, "entry mismatch");
+        ++iterated;
+    }
+    CHECK(iterated == expect.size(), "iteration mismatch");
+    for (const auto &entry : expect) {
+        const uint64_t *value = map.find(entry.first);
+        CHECK(value != nullptr && *value == entry.second, "lookup mismatch");
+    }
+    return true;
+}
+
+// Compares random operations against std::unordered_map.  The keys are drawn
+// from a limited range so that erased keys are often re-inserted and deleted
+// slots are reused, and are spread so both low and high bits vary.
+bool
+test_random_operations()
+{
+    flat_addr_map_t<uint64_t> map;
+    std::unordered_map<addr_t, uint64_t> expect;
+    uint64_t state = 42;
+    for (int i = 0; i < 400000; ++i) {
+        uint64_t bits = next_random(state);
+        addr_t key = (bits % 5000) * 0x1040 + ((bits % 5000) << 40);
+        switch ((bits >> 20) % 4) {
+        case 0:
+        case 1:
+            map[key] += i;
+            expect[key] += i;
+            break;
+        case 2: {
+            bool erased = map.erase(key);
+            CHECK(erased == (expect.erase(key) == 1), "erase mismatch");
+            break;
+        }
+        case 3:
+            CHECK(map.count(key) == expect.count(key), "count mismatch");
+            break;
+        }
+        if (i % 50000 == 0 && !same_contents(map, expect))
+            return false;
+    }
+    if (!same_contents(map, expect))
+        return false;
+    // Erasing everything should leave room for new entries without growing.
+    size_t usage = map.memory_usage();
+    for (const auto &entry : expect)
+        CHECK(map.erase(entry.first), "failed to erase");
+    CHECK(map.empty() && map.begin() == map.end(), "erase all failed");
+    for (addr_t key = 0; key < expect.size(); ++key)
+        map[key] = key;
+    CHECK(map.size() == expect.size() && map.memory_usage() == usage,
+          "deleted slots were not reused");
+    map.clear();
+    CHECK(map.empty() && map.find(0) == nullptr, "clear failed");
+    return true;
+}
+
+bool
+test_copy_and_merge()
+{
+    flat_addr_map_t<uint64_t> maps[3];
+    std::unordered_map<addr_t, uint64_t> expect;
+    for (addr_t i = 0; i < 3; ++i) {
+        // Overlapping ranges of keys.
+        for (addr_t key = i * 1000; key < i * 1000 + 3000; ++key) {
+            maps[i][key << 6] = key + i;
+            expect[key << 6] += key + i;
+        }
+    }
+    flat_addr_map_t<uint64_t> merged;
+    for (int i = 0; i < 3; ++i)
+        merged.merge_add(maps[i]);
+    if (!same_contents(merged, expect))
+        return false;
+    flat_addr_map_t<uint64_t> copy(merged);
+    CHECK(copy == merged, "copy mismatch");
+    copy[1] = 1;
+    CHECK(copy != merged, "copy not independent");
+    flat_addr_map_t<uint64_t> moved(std::move(copy));
+    CHECK(moved.size() == merged.size() + 1 && copy.empty(), "move failed");
+    // A map that was moved from is usable again.
+    copy[2] = 2;
+    CHECK(copy.size() == 1 && *copy.find(2) == 2, "reuse after move failed");
+    // Reserving up front avoids growth.
+    flat_addr_map_t<uint64_t> reserved;
+    reserved.reserve(10000);
+    size_t usage = reserved.memory_usage();
+    for (addr_t key = 0; key < 10000; ++key)
+        reserved[key] = key;
+    CHECK(reserved.memory_usage() == usage, "reserve was insufficient");
+    return true;
+}
+
+bool
+test_set()
+{
+    flat_addr_set_t set;
+    std::unordered_set<addr_t> expect;
+    uint64_t state = 7;
+    for (int i = 0; i < 100000; ++i) {
+        addr_t key = next_random(state) % 20000;
+        if (i % 3 == 2) {
+            CHECK(set.erase(key) == (expect.erase(key) == 1), "set erase mismatch");
+        } else {
+            CHECK(set.insert(key) == expect.insert(key).second, "set insert mismatch");
+        }
+    }
+    CHECK(set.size() == expect.size(), "set size mismatch");
+    for (addr_t key : set)
+        CHECK(expect.count(key) == 1, "set iteration mismatch");
+    flat_addr_set_t other;
+    for (addr_t key = 0; key < 30000; key += 2)
+        other.insert(key);
+    set.merge(other);
+    for (addr_t key = 0; key < 30000; key += 2)
+        expect.insert(key);
+    CHECK(set.size() == expect.size(), "set merge mismatch");
+    flat_addr_set_t copy = set;
+    CHECK(copy == set, "set copy mismatch");
+    // The set stores no values.
+    flat_addr_map_t<uint64_t> map;
+    for (addr_t key : set)
+        map[key] = 0;
+    CHECK(set.memory_usage() < map.memory_usage() * 6 / 10, "set too large");
+    return true;
+}
+
+} // namespace
+
+int
+test_main(int argc, const char *argv[])
+{
+    if (!test_random_operations() || !test_copy_and_merge() || !test_set())
+        return 1;
+    std::cerr << "All done!\n";
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
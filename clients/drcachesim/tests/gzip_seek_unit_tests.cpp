@@ -0,0 +1,306 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Unit tests for seeking in gzip traces via the seek index written by
+ * gzip_chunked_ostream_t.
+ */
+
+#include <stdint.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "compressed_file_reader.h"
+#include "gzip_ostream.h"
+#include "memref.h"
+#include "mock_reader.h"
+#include "seek_index.h"
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+#ifndef HAS_ZLIB
+#    error zlib is required for this test
+#endif
+
+#define CHECK(cond, msg, ...)             \
+    do {                                  \
+        if (!(cond)) {                    \
+            fprintf(stderr, "%s\n", msg); \
+            return false;                 \
+        }                                 \
+    } while (0)
+
+namespace {
+
+constexpr uint64_t CHUNK_INSTRS = 10;
+constexpr uint64_t NUM_INSTRS = 95;
+constexpr uint64_t NUM_CHUNKS = (NUM_INSTRS + CHUNK_INSTRS - 1) / CHUNK_INSTRS;
+constexpr memref_tid_t TID = 42;
+// The count of visible header markers: version, filetype, cache line size,
+// chunk instruction count, page size, timestamp, and cpu.
+constexpr uint64_t HEADER_RECORDS = 7;
+
+// The timestamp in the middle of each chunk.
+uint64_t
+chunk_timestamp(uint64_t chunk)
+{
+    return 1000 + chunk * 10;
+}
+
+uint64_t
+file_size(const std::string &path)
+{
+    std::ifstream file(path, std::ifstream::binary | std::ifstream::ate);
+    return static_cast<uint64_t>(file.tellg());
+}
+
+// Writes a trace laid out the way raw2trace chunks its output: each chunk
+// after the first is preceded by a footer and starts with a record ordinal plus
+// repeated timestamp and cpu headers.  Each instruction has one data load.
+bool
+write_chunked_trace(const std::string &path)
+{
+    gzip_chunked_ostream_t out(path);
+    CHECK(out.good(), "failed to open output");
+    CHECK(out.open_new_component("chunk.0000").empty(), "failed to start chunk");
+    trace_entry_t header = {};
+    header.type = TRACE_TYPE_HEADER;
+    header.addr = TRACE_ENTRY_VERSION;
+    std::vector<trace_entry_t> entries = {
+        header,
+        make_thread(TID),
+        make_pid(1),
+        make_version(TRACE_ENTRY_VERSION),
+        make_marker(TRACE_MARKER_TYPE_FILETYPE, OFFLINE_FILE_TYPE_DEFAULT),
+        make_marker(TRACE_MARKER_TYPE_CACHE_LINE_SIZE, 64),
+        make_marker(TRACE_MARKER_TYPE_CHUNK_INSTR_COUNT, CHUNK_INSTRS),
+        make_marker(TRACE_MARKER_TYPE_PAGE_SIZE, 4096),
+        make_timestamp(1),
+        make_marker(TRACE_MARKER_TYPE_CPU_ID, 0),
+    };
+    for (uint64_t i = 0; i < NUM_INSTRS; ++i) {
+        uint64_t chunk = i / CHUNK_INSTRS;
+        if (i > 0 && i % CHUNK_INSTRS == 0) {
+            entries.push_back(make_marker(TRACE_MARKER_TYPE_CHUNK_FOOTER, chunk - 1));
+            out.write(reinterpret_cast<const char *>(entries.data()),
+                      entries.size() * sizeof(entries[0]));
+            entries.clear();
+            CHECK(out.open_new_component("chunk").empty(), "failed to start chunk");
+            // Prior chunks hold two records per instruction plus a timestamp, a
+            // cpu, and a footer.
+            entries.push_back(make_marker(TRACE_MARKER_TYPE_RECORD_ORDINAL,
+                                          HEADER_RECORDS + 2 * i + 3 * chunk));
+            entries.push_back(make_timestamp(chunk_timestamp(chunk - 1)));
+            entries.push_back(make_marker(TRACE_MARKER_TYPE_CPU_ID, chunk));
+        }
+        if (i % CHUNK_INSTRS == CHUNK_INSTRS / 2) {
+            entries.push_back(make_timestamp(chunk_timestamp(chunk)));
+            entries.push_back(make_marker(TRACE_MARKER_TYPE_CPU_ID, chunk + 1));
+        }
+        entries.push_back(make_instr(0x1000 + i));
+        trace_entry_t load = make_instr(0x8000 + i, TRACE_TYPE_READ);
+        load.size = 4;
+        entries.push_back(load);
+    }
+    entries.push_back(make_exit(TID));
+    entries.push_back(make_footer());
+    out.write(reinterpret_cast<const char *>(entries.data()),
+              entries.size() * sizeof(entries[0]));
+    CHECK(out.good(), "failed to write output");
+    // The index must be complete once close() returns.
+    CHECK(out.close().empty(), "failed to close output");
+    CHECK(std::ifstream(path + DRMEMTRACE_SEEK_INDEX_SUFFIX).good(), "index not written");
+    return true;
+}
+
+bool
+test_index_contents(const std::string &path)
+{
+    std::vector<seek_index_entry_t> index;
+    CHECK(read_seek_index(path + DRMEMTRACE_SEEK_INDEX_SUFFIX, file_size(path), &index),
+          "failed to read index");
+    CHECK(index.size() == NUM_CHUNKS, "wrong index size");
+    CHECK(index[0].offset == 0 && index[0].timestamp == 1, "wrong first index entry");
+    for (uint64_t i = 1; i < NUM_CHUNKS; ++i) {
+        // The first timestamp in each chunk is the repeated prior one.
+        CHECK(index[i].timestamp == chunk_timestamp(i - 1), "wrong index timestamp");
+    }
+    // A stale index must be ignored.
+    CHECK(!read_seek_index(path + DRMEMTRACE_SEEK_INDEX_SUFFIX, file_size(path) + 1,
+                           &index) &&
+              index.empty(),
+          "stale index should be rejected");
+    return true;
+}
+
+struct position_t {
+    bool at_eof;
+    uint64_t last_timestamp;
+    // The ordinals at the first instruction after the skip.
+    uint64_t instr_ordinal;
+    uint64_t record_ordinal;
+    std::vector<memref_t> next;
+};
+
+// Skips "first" and then "second" instructions and returns where we ended up
+// and the next few records.
+bool
+skip_and_read(const std::string &path, uint64_t first, uint64_t second,
+              position_t *pos)
+{
+    std::unique_ptr<reader_t> reader(new compressed_file_reader_t(path));
+    std::unique_ptr<reader_t> reader_end(new compressed_file_reader_t());
+    CHECK(reader->init(), "failed to initialize reader");
+    reader->skip_instructions(first);
+    if (*reader != *reader_end && second > 0) {
+        // Read a little before the second skip.
+        ++(*reader);
+        reader->skip_instructions(second);
+    }
+    pos->at_eof = *reader == *reader_end;
+    pos->last_timestamp = reader->get_last_timestamp();
+    pos->instr_ordinal = 0;
+    pos->record_ordinal = 0;
+    pos->next.clear();
+    for (int i = 0; i < 6 && *reader != *reader_end; ++i, ++(*reader)) {
+        const memref_t &memref = **reader;
+        if (pos->instr_ordinal == 0 && type_is_instr(memref.instr.type)) {
+            pos->instr_ordinal = reader->get_instruction_ordinal();
+            pos->record_ordinal = reader->get_record_ordinal();
+        }
+        pos->next.push_back(memref);
+    }
+    return true;
+}
+
+// Returns the record ordinal of each instruction in a full linear read.
+bool
+read_instr_record_ordinals(const std::string &path, std::vector<uint64_t> *ordinals)
+{
+    std::unique_ptr<reader_t> reader(new compressed_file_reader_t(path));
+    std::unique_ptr<reader_t> reader_end(new compressed_file_reader_t());
+    CHECK(reader->init(), "failed to initialize reader");
+    // Instruction ordinals start at 1.
+    ordinals->assign(1, 0);
+    for (; *reader != *reader_end; ++(*reader)) {
+        if (type_is_instr((**reader).instr.type))
+            ordinals->push_back(reader->get_record_ordinal());
+    }
+    CHECK(ordinals->size() == NUM_INSTRS + 1, "wrong instruction count");
+    return true;
+}
+
+bool
+same_memref(const memref_t &a, const memref_t &b)
+{
+    if (a.marker.type != b.marker.type)
+        return false;
+    if (a.marker.type == TRACE_TYPE_MARKER) {
+        return a.marker.marker_type == b.marker.marker_type &&
+            a.marker.marker_value == b.marker.marker_value;
+    }
+    if (type_is_instr(a.instr.type)) {
+        return a.instr.addr == b.instr.addr && a.instr.size == b.instr.size &&
+            a.instr.tid == b.instr.tid;
+    }
+    return a.data.addr == b.data.addr && a.data.pc == b.data.pc &&
+        a.data.tid == b.data.tid;
+}
+
+// Compares skipping with the index to skipping by a linear walk in a copy of the
+// file without the index.  Record ordinals are compared to an unskipped read.
+bool
+test_skip(const std::string &path, const std::string &unindexed_path)
+{
+    std::vector<uint64_t> record_ordinals;
+    if (!read_instr_record_ordinals(unindexed_path, &record_ordinals))
+        return false;
+    for (uint64_t second : { 0, 3, 17 }) {
+        for (uint64_t first = 0; first < NUM_INSTRS + 3; ++first) {
+            position_t indexed, linear;
+            if (!skip_and_read(path, first, second, &indexed) ||
+                !skip_and_read(unindexed_path, first, second, &linear))
+                return false;
+            CHECK(indexed.at_eof == linear.at_eof, "eof mismatch");
+            CHECK(indexed.last_timestamp == linear.last_timestamp,
+                  "timestamp mismatch");
+            CHECK(indexed.instr_ordinal == linear.instr_ordinal,
+                  "instr ordinal mismatch");
+            CHECK(indexed.instr_ordinal == 0 ||
+                      indexed.record_ordinal ==
+                          record_ordinals[static_cast<size_t>(indexed.instr_ordinal)],
+                  "record ordinal mismatch");
+            CHECK(indexed.next.size() == linear.next.size(), "record count mismatch");
+            for (size_t i = 0; i < indexed.next.size(); ++i) {
+                CHECK(same_memref(indexed.next[i], linear.next[i]),
+                      "record mismatch");
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int
+test_main(int argc, const char *argv[])
+{
+    // We use the current directory as we have no temp dir parameter.
+    const std::string path = "gzip_seek_unit_tests.trace.gz";
+    const std::string unindexed_path = "gzip_seek_unit_tests.unindexed.trace.gz";
+    if (!write_chunked_trace(path))
+        return 1;
+    // A copy without an index exercises the linear skip for comparison.
+    {
+        std::ifstream src(path, std::ifstream::binary);
+        std::ofstream dst(unindexed_path, std::ofstream::binary);
+        dst << src.rdbuf();
+    }
+    std::remove((unindexed_path + DRMEMTRACE_SEEK_INDEX_SUFFIX).c_str());
+    bool res = test_index_contents(path) && test_skip(path, unindexed_path);
+    std::remove(path.c_str());
+    std::remove((path + DRMEMTRACE_SEEK_INDEX_SUFFIX).c_str());
+    std::remove(unindexed_path.c_str());
+    if (!res)
+        return 1;
+    std::cerr << "All done!\n";
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -0,0 +1,256 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Unit tests for the miss_ratio_curve tool. */
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+#undef NDEBUG
+#include <assert.h>
+
+#include "../tools/miss_ratio_curve.h"
+#include "../tools/miss_ratio_curve_create.h"
+#include "../common/memref.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+class miss_ratio_curve_test_t : public miss_ratio_curve_t {
+public:
+    explicit miss_ratio_curve_test_t(const miss_ratio_curve_knobs_t &knobs)
+        : miss_ratio_curve_t(knobs)
+    {
+    }
+
+    // Make these public for testing.
+    using miss_ratio_curve_t::curve_point_t;
+    using miss_ratio_curve_t::shard_data_t;
+
+    std::vector<curve_point_t>
+    get_curve()
+    {
+        std::vector<const shard_data_t *> shards;
+        for (const auto &shard : shard_map_)
+            shards.push_back(shard.second);
+        return compute_curve(shards);
+    }
+
+    const shard_data_t *
+    get_shard(memref_tid_t index)
+    {
+        return shard_map_[index];
+    }
+};
+
+static memref_t
+generate_memref(const addr_t addr)
+{
+    memref_t memref;
+    memref.data.type = TRACE_TYPE_READ;
+    memref.data.pid = 1;
+    memref.data.tid = 2;
+    memref.data.addr = addr;
+    memref.data.size = 4;
+    memref.data.pc = 0;
+    return memref;
+}
+
+// Returns a stream of cache line numbers where most accesses go to a small hot
+// set and the rest are spread over a much larger cold set.
+static std::vector<addr_t>
+generate_lines(int num_accesses, int hot_lines, int cold_lines)
+{
+    std::vector<addr_t> lines;
+    uint64_t rand = 12345;
+    for (int i = 0; i < num_accesses; ++i) {
+        // A 64-bit LCG is plenty random for this purpose.
+        rand = rand * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t bits = rand >> 32;
+        lines.push_back((bits % 4 != 0) ? (bits >> 2) % hot_lines
+                                        : hot_lines + (bits >> 2) % cold_lines);
+    }
+    return lines;
+}
+
+static std::unique_ptr<miss_ratio_curve_test_t>
+run_lines(const miss_ratio_curve_knobs_t &knobs, const std::vector<addr_t> &lines)
+{
+    std::unique_ptr<miss_ratio_curve_test_t> mrc(new miss_ratio_curve_test_t(knobs));
+    for (addr_t line : lines) {
+        bool success = mrc->process_memref(generate_memref(line * knobs.line_size));
+        assert(success);
+    }
+    return mrc;
+}
+
+// Returns the miss ratio of an LRU cache of each size up to max_lines, computed
+// by simulating a stack directly.
+static std::vector<double>
+exact_miss_ratios(const std::vector<addr_t> &lines, size_t max_lines)
+{
+    std::vector<addr_t> stack;
+    std::vector<uint64_t> misses(max_lines + 1);
+    for (addr_t line : lines) {
+        auto it = std::find(stack.begin(), stack.end(), line);
+        // A first access misses in every cache.
+        size_t depth = it == stack.end() ? max_lines : it - stack.begin();
+        for (size_t size = 0; size <= max_lines && size <= depth; ++size)
+            ++misses[size];
+        if (it != stack.end())
+            stack.erase(it);
+        stack.insert(stack.begin(), line);
+    }
+    std::vector<double> ratios;
+    for (uint64_t count : misses)
+        ratios.push_back(static_cast<double>(count) / lines.size());
+    return ratios;
+}
+
+// With no sampling, the curve should be exact.
+void
+exact_curve_test()
+{
+    std::cerr << "exact_curve_test()\n";
+    std::vector<addr_t> lines = generate_lines(50000, 100, 1000);
+    miss_ratio_curve_knobs_t knobs;
+    knobs.sample_sets = 1;
+    auto mrc = run_lines(knobs, lines);
+    auto curve = mrc->get_curve();
+    std::vector<double> exact = exact_miss_ratios(lines, 2000);
+    assert(curve.size() > 20);
+    assert(curve.front().cache_lines == 1);
+    assert(curve.back().cache_lines > 1100);
+    for (size_t i = 0; i < curve.size(); ++i) {
+        const auto &point = curve[i];
+        if (i > 0) {
+            assert(point.cache_lines > curve[i - 1].cache_lines);
+            assert(point.miss_ratio <= curve[i - 1].miss_ratio);
+        }
+        double expected = exact[std::min<size_t>(point.cache_lines, exact.size() - 1)];
+        assert(std::abs(point.miss_ratio - expected) < 1e-9);
+        assert(point.miss_ratio_low == point.miss_ratio &&
+               point.miss_ratio_high == point.miss_ratio);
+    }
+    // A cache as large as the working set only takes cold misses.
+    assert(std::abs(curve.back().miss_ratio - 1100.0 / lines.size()) < 1e-9);
+}
+
+// Test that shards processed in parallel are merged.
+void
+parallel_merge_test()
+{
+    std::cerr << "parallel_merge_test()\n";
+    std::vector<addr_t> lines = generate_lines(20000, 100, 1000);
+    miss_ratio_curve_knobs_t knobs;
+    knobs.sample_lines = 256;
+    auto serial = run_lines(knobs, lines);
+    auto serial_curve = serial->get_curve();
+    std::unique_ptr<miss_ratio_curve_test_t> parallel(new miss_ratio_curve_test_t(knobs));
+    void *shards[2];
+    for (int i = 0; i < 2; ++i)
+        shards[i] = parallel->parallel_shard_init(i, nullptr);
+    // Two shards with identical accesses have the same curve as one.
+    for (addr_t line : lines) {
+        for (int i = 0; i < 2; ++i) {
+            bool success = parallel->parallel_shard_memref(
+                shards[i], generate_memref(line * knobs.line_size));
+            assert(success);
+        }
+    }
+    for (int i = 0; i < 2; ++i) {
+        assert(parallel->get_shard(i)->total_refs == lines.size());
+        assert(parallel->parallel_shard_exit(shards[i]));
+    }
+    auto parallel_curve = parallel->get_curve();
+    assert(parallel_curve.size() == serial_curve.size());
+    for (size_t i = 0; i < serial_curve.size(); ++i) {
+        assert(parallel_curve[i].cache_lines == serial_curve[i].cache_lines);
+        assert(std::abs(parallel_curve[i].miss_ratio - serial_curve[i].miss_ratio) <
+               1e-9);
+    }
+}
+
+// Test that a fixed-size sample bounds memory while staying close to the exact
+// curve.
+void
+sampled_curve_test()
+{
+    std::cerr << "sampled_curve_test()\n";
+    constexpr unsigned int SAMPLE_LINES = 4096;
+    std::vector<addr_t> lines = generate_lines(400000, 1000, 40000);
+    miss_ratio_curve_knobs_t knobs;
+    knobs.sample_sets = 1;
+    knobs.sample_lines = 1 << 20;
+    auto exact = run_lines(knobs, lines);
+    auto exact_curve = exact->get_curve();
+    knobs.sample_sets = 4;
+    knobs.sample_lines = SAMPLE_LINES;
+    auto sampled = run_lines(knobs, lines);
+    auto sampled_curve = sampled->get_curve();
+    const auto *shard = sampled->get_shard(2);
+    for (const auto &set : shard->sample_sets) {
+        assert(set->lines.size() <= SAMPLE_LINES);
+        assert(set->rate < 0.2);
+    }
+    size_t exact_index = 0;
+    double max_error = 0.;
+    for (const auto &point : sampled_curve) {
+        assert(point.miss_ratio_low <= point.miss_ratio &&
+               point.miss_ratio <= point.miss_ratio_high);
+        // The sampled curve can end before or after the exact one.
+        while (exact_index + 1 < exact_curve.size() &&
+               exact_curve[exact_index + 1].cache_lines <= point.cache_lines)
+            ++exact_index;
+        max_error = std::max(
+            max_error, std::abs(point.miss_ratio - exact_curve[exact_index].miss_ratio));
+    }
+    std::cerr << "Maximum error: " << max_error << "\n";
+    assert(max_error < 0.05);
+}
+
+int
+test_main(int argc, const char *argv[])
+{
+    exact_curve_test();
+    parallel_merge_test();
+    sampled_curve_test();
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
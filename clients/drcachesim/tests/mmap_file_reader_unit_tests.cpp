@@ -0,0 +1,296 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Unit tests for mmap_file_reader_t and mmap_record_file_reader_t. */
+
+#include <stdint.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "file_reader.h"
+#include "memref.h"
+#include "mmap_file_reader.h"
+#include "mock_reader.h"
+#include "record_file_reader.h"
+#include "scheduler.h"
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+#ifndef HAS_MMAP
+#    error mmap support is required for this test
+#endif
+
+#define CHECK(cond, msg, ...)             \
+    do {                                  \
+        if (!(cond)) {                    \
+            fprintf(stderr, "%s\n", msg); \
+            return false;                 \
+        }                                 \
+    } while (0)
+
+namespace {
+
+constexpr memref_tid_t TID = 42;
+constexpr int NUM_INSTRS = 2000;
+
+std::vector<trace_entry_t>
+make_trace()
+{
+    trace_entry_t header = {};
+    header.type = TRACE_TYPE_HEADER;
+    header.addr = TRACE_ENTRY_VERSION;
+    std::vector<trace_entry_t> entries = {
+        header,
+        make_thread(TID),
+        make_pid(1),
+        make_version(TRACE_ENTRY_VERSION),
+        make_marker(TRACE_MARKER_TYPE_FILETYPE, OFFLINE_FILE_TYPE_DEFAULT),
+        make_marker(TRACE_MARKER_TYPE_CACHE_LINE_SIZE, 64),
+        make_marker(TRACE_MARKER_TYPE_PAGE_SIZE, 4096),
+        make_timestamp(1),
+        make_marker(TRACE_MARKER_TYPE_CPU_ID, 0),
+    };
+    for (int i = 0; i < NUM_INSTRS; ++i) {
+        if (i % 100 == 99)
+            entries.push_back(make_timestamp(2 + i));
+        // Exercise the in-place type update for maybe-fetched instructions.
+        if (i % 10 == 5) {
+            entries.push_back(make_instr(0x1000 + i, TRACE_TYPE_INSTR_MAYBE_FETCH));
+            entries.push_back(make_instr(0x1000 + i, TRACE_TYPE_INSTR_MAYBE_FETCH));
+        } else
+            entries.push_back(make_instr(0x1000 + i));
+        trace_entry_t load = make_instr(0x8000 + i, TRACE_TYPE_READ);
+        load.size = 4;
+        entries.push_back(load);
+    }
+    entries.push_back(make_exit(TID));
+    entries.push_back(make_footer());
+    return entries;
+}
+
+bool
+write_trace(const std::string &path, const std::vector<trace_entry_t> &entries,
+            size_t trailing_bytes)
+{
+    std::ofstream out(path, std::ofstream::binary);
+    out.write(reinterpret_cast<const char *>(entries.data()),
+              entries.size() * sizeof(entries[0]));
+    // A truncated final entry.
+    for (size_t i = 0; i < trailing_bytes; ++i)
+        out.put(0);
+    CHECK(out.good(), "failed to write trace");
+    return true;
+}
+
+bool
+same_memref(const memref_t &a, const memref_t &b)
+{
+    if (a.marker.type != b.marker.type || a.marker.tid != b.marker.tid)
+        return false;
+    if (a.marker.type == TRACE_TYPE_MARKER) {
+        return a.marker.marker_type == b.marker.marker_type &&
+            a.marker.marker_value == b.marker.marker_value;
+    }
+    if (type_is_instr(a.instr.type))
+        return a.instr.addr == b.instr.addr && a.instr.size == b.instr.size;
+    return a.data.addr == b.data.addr && a.data.size == b.data.size &&
+        a.data.pc == b.data.pc;
+}
+
+// Compares the mapped reader to the stream reader, with a skip partway in.
+bool
+test_file_reader(const std::string &path)
+{
+    std::unique_ptr<reader_t> mapped(new mmap_file_reader_t(path));
+    std::unique_ptr<reader_t> mapped_end(new mmap_file_reader_t());
+    std::unique_ptr<reader_t> stream(new file_reader_t<std::ifstream *>(path));
+    std::unique_ptr<reader_t> stream_end(new file_reader_t<std::ifstream *>());
+    CHECK(mapped->init() && stream->init(), "failed to initialize readers");
+    int count = 0;
+    while (*mapped != *mapped_end && *stream != *stream_end) {
+        CHECK(same_memref(**mapped, **stream), "record mismatch");
+        CHECK(mapped->get_record_ordinal() == stream->get_record_ordinal() &&
+                  mapped->get_instruction_ordinal() ==
+                      stream->get_instruction_ordinal() &&
+                  mapped->get_last_timestamp() == stream->get_last_timestamp(),
+              "ordinal mismatch");
+        if (++count == 100) {
+            mapped->skip_instructions(777);
+            stream->skip_instructions(777);
+        } else {
+            ++(*mapped);
+            ++(*stream);
+        }
+    }
+    CHECK(*mapped == *mapped_end && *stream == *stream_end, "length mismatch");
+    CHECK(count > NUM_INSTRS, "too few records");
+    return true;
+}
+
+bool
+test_record_reader(const std::string &path, const std::vector<trace_entry_t> &entries)
+{
+    mmap_record_file_reader_t reader(path);
+    mmap_record_file_reader_t reader_end;
+    CHECK(reader.init(), "failed to initialize record reader");
+    size_t i = 0;
+    for (; reader != reader_end; ++reader, ++i) {
+        CHECK(i < entries.size(), "too many records");
+        const trace_entry_t &entry = *reader;
+        CHECK(entry.type == entries[i].type && entry.size == entries[i].size &&
+                  entry.addr == entries[i].addr,
+              "record mismatch");
+    }
+    CHECK(i == entries.size(), "too few records");
+    return true;
+}
+
+// Returns the number of mappings of "path" in this process, or -1 if unknown.
+int
+count_mappings(const std::string &path)
+{
+#ifdef LINUX
+    std::ifstream maps("/proc/self/maps");
+    if (!maps.good())
+        return -1;
+    int count = 0;
+    std::string line;
+    while (std::getline(maps, line)) {
+        if (line.size() >= path.size() &&
+            line.compare(line.size() - path.size(), path.size(), path) == 0)
+            ++count;
+    }
+    return count;
+#else
+    return -1;
+#endif
+}
+
+// Initializing a reader again opens its file again, which must replace the
+// previous mapping.
+bool
+test_reopen(const std::string &path, const std::vector<trace_entry_t> &entries)
+{
+    {
+        mmap_record_file_reader_t reader(path);
+        CHECK(reader.init() && reader.init(), "failed to reopen record reader");
+        int count = count_mappings(path);
+        CHECK(count == -1 || count == 1, "record reader leaked its first mapping");
+        CHECK((*reader).type == entries[0].type, "reopened record reader not at start");
+    }
+    {
+        mmap_file_reader_t reader(path);
+        CHECK(reader.init() && reader.init(), "failed to reopen file reader");
+        int count = count_mappings(path);
+        CHECK(count == -1 || count == 1, "file reader leaked its first mapping");
+    }
+    int count = count_mappings(path);
+    CHECK(count == -1 || count == 0, "reader did not unmap on destruction");
+    return true;
+}
+
+bool
+test_empty_file(const std::string &empty_path)
+{
+    // An empty file is at its end from the start, as with a stream reader.
+    mmap_record_file_reader_t reader(empty_path);
+    mmap_record_file_reader_t reader_end;
+    CHECK(reader.init(), "failed to initialize record reader on empty file");
+    CHECK(reader == reader_end, "empty file has records");
+    // A trace needs a header, so the memref reader fails as a stream reader does.
+    mmap_file_reader_t mapped(empty_path);
+    file_reader_t<std::ifstream *> stream(empty_path);
+    CHECK(!mapped.init() && !stream.init(), "empty file has a header");
+    return true;
+}
+
+bool
+test_scheduler(const std::string &path)
+{
+    // The scheduler should pick the mapped reader for a .trace file and deliver
+    // the same records as a stream reader.
+    scheduler_t scheduler;
+    std::vector<scheduler_t::input_workload_t> sched_inputs;
+    sched_inputs.emplace_back(path);
+    CHECK(scheduler.init(sched_inputs, 1,
+                         scheduler_t::make_scheduler_serial_options(/*verbosity=*/0)) ==
+              scheduler_t::STATUS_SUCCESS,
+          "failed to initialize scheduler");
+    std::unique_ptr<reader_t> stream(new file_reader_t<std::ifstream *>(path));
+    std::unique_ptr<reader_t> stream_end(new file_reader_t<std::ifstream *>());
+    CHECK(stream->init(), "failed to initialize reader");
+    auto *outstream = scheduler.get_stream(0);
+    memref_t memref;
+    for (scheduler_t::stream_status_t status = outstream->next_record(memref);
+         status != scheduler_t::STATUS_EOF; status = outstream->next_record(memref)) {
+        CHECK(status == scheduler_t::STATUS_OK, "scheduler failure");
+        CHECK(*stream != *stream_end && same_memref(memref, **stream),
+              "scheduler record mismatch");
+        ++(*stream);
+    }
+    CHECK(*stream == *stream_end, "scheduler ended early");
+    return true;
+}
+
+} // namespace
+
+int
+test_main(int argc, const char *argv[])
+{
+    // We use the current directory as we have no temp dir parameter.
+    const std::string path = "mmap_file_reader_unit_tests.trace";
+    const std::string empty_path = "mmap_file_reader_unit_tests.empty.trace";
+    std::vector<trace_entry_t> entries = make_trace();
+    bool res = write_trace(path, entries, 0) && test_file_reader(path) &&
+        test_record_reader(path, entries) && test_scheduler(path) &&
+        // A trailing partial record should be ignored like a failed stream read.
+        write_trace(path, entries, sizeof(trace_entry_t) / 2) &&
+        test_file_reader(path) && test_record_reader(path, entries) &&
+        write_trace(empty_path, {}, 0) && test_empty_file(empty_path) &&
+        test_reopen(path, entries);
+    std::remove(path.c_str());
+    std::remove(empty_path.c_str());
+    if (!res)
+        return 1;
+    std::cerr << "All done!\n";
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -0,0 +1,192 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Unit tests for pipelined_ostream_t. */
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "pipelined_ostream.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+#define CHECK(cond, msg, ...)             \
+    do {                                  \
+        if (!(cond)) {                    \
+            fprintf(stderr, "%s\n", msg); \
+            return false;                 \
+        }                                 \
+    } while (0)
+
+namespace {
+
+// Records what reaches the wrapped stream, and can fail writes past a limit.
+class limited_streambuf_t : public std::basic_streambuf<char, std::char_traits<char>> {
+public:
+    limited_streambuf_t(std::string *sink, size_t limit)
+        : sink_(sink)
+        , limit_(limit)
+    {
+    }
+
+protected:
+    std::streamsize
+    xsputn(const char *s, std::streamsize count) override
+    {
+        if (sink_->size() + count > limit_)
+            return 0;
+        sink_->append(s, count);
+        return count;
+    }
+    int
+    overflow(int ch) override
+    {
+        if (ch == traits_type::eof())
+            return traits_type::not_eof(ch);
+        char c = traits_type::to_char_type(ch);
+        return xsputn(&c, 1) == 1 ? ch : traits_type::eof();
+    }
+
+private:
+    std::string *sink_;
+    size_t limit_;
+};
+
+class limited_ostream_t : public std::ostream {
+public:
+    limited_ostream_t(std::string *sink, size_t limit)
+        : std::ostream(&buf_)
+        , buf_(sink, limit)
+    {
+    }
+
+private:
+    limited_streambuf_t buf_;
+};
+
+std::string
+make_data(int stream, size_t size)
+{
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; ++i)
+        data[i] = static_cast<char>((i * 31 + stream * 7) ^ (i >> 8));
+    return data;
+}
+
+// Interleaves writes of several streams sharing a pool in uneven pieces, including
+// single characters, and checks that each output is complete and in order.
+bool
+test_ordering(int num_threads, size_t buffer_size)
+{
+    constexpr int NUM_STREAMS = 5;
+    constexpr size_t DATA_SIZE = 100000;
+    std::vector<std::string> outputs(NUM_STREAMS);
+    std::vector<std::string> inputs;
+    {
+        pipelined_write_pool_t pool(num_threads);
+        std::vector<std::unique_ptr<pipelined_ostream_t>> streams;
+        for (int i = 0; i < NUM_STREAMS; ++i) {
+            inputs.push_back(make_data(i, DATA_SIZE));
+            streams.emplace_back(new pipelined_ostream_t(
+                std::unique_ptr<std::ostream>(
+                    new limited_ostream_t(&outputs[i], DATA_SIZE)),
+                &pool, buffer_size));
+        }
+        std::vector<size_t> pos(NUM_STREAMS, 0);
+        for (size_t step = 0;; ++step) {
+            bool any = false;
+            for (int i = 0; i < NUM_STREAMS; ++i) {
+                size_t len = std::min<size_t>(1 + (step * 37 + i * 11) % 3001,
+                                              DATA_SIZE - pos[i]);
+                if (len == 0)
+                    continue;
+                any = true;
+                if (len == 1)
+                    streams[i]->put(inputs[i][pos[i]]);
+                else
+                    streams[i]->write(&inputs[i][pos[i]], len);
+                CHECK(streams[i]->good(), "unexpected write failure");
+                pos[i] += len;
+            }
+            if (!any)
+                break;
+        }
+        CHECK(streams[0]->flush().good(), "flush failed");
+        CHECK(outputs[0] == inputs[0], "flush did not write everything");
+        // Destroying the rest must complete their output.
+    }
+    for (int i = 0; i < NUM_STREAMS; ++i)
+        CHECK(outputs[i] == inputs[i], "output differs from input");
+    return true;
+}
+
+// A failure in the wrapped stream must turn the pipelined stream bad no later
+// than the next flush.
+bool
+test_failure()
+{
+    std::string output;
+    pipelined_write_pool_t pool(2);
+    pipelined_ostream_t stream(
+        std::unique_ptr<std::ostream>(new limited_ostream_t(&output, 1000)), &pool,
+        256);
+    std::string data = make_data(0, 2000);
+    stream.write(data.data(), data.size());
+    stream.flush();
+    CHECK(!stream.good(), "write failure was not reported");
+    CHECK(output.size() <= 1000, "wrote past the failure");
+    return true;
+}
+
+} // namespace
+
+int
+test_main(int argc, const char *argv[])
+{
+    if (!test_ordering(1, 4096) || !test_ordering(3, 4096) || !test_ordering(4, 17) ||
+        !test_failure())
+        return 1;
+    std::cerr << "All done!\n";
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -36,7 +36,10 @@
 #include "memref_gen.h"
 #include "tracer/raw2trace.h"
 #include "tracer/raw2trace_directory.h"
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <sstream>
 
 namespace dynamorio {
@@ -101,12 +104,12 @@ class raw2trace_test_t : public raw2trace_t {
 public:
     raw2trace_test_t(const std::vector<std::istream *> &input,
                      const std::vector<std::ostream *> &output, instrlist_t &instrs,
-                     void *drcontext)
+                     void *drcontext, int worker_count = -1)
         : raw2trace_t(nullptr, input, output, {}, INVALID_FILE, nullptr, nullptr,
                       drcontext,
                       // The sequences are small so we print everything for easier
                       // debugging and viewing of what's going on.
-                      4)
+                      4, worker_count)
     {
         module_mapper_ = std::unique_ptr<module_mapper_t>(
             new test_module_mapper_t(&instrs, drcontext));
@@ -114,12 +117,13 @@ public:
     }
     raw2trace_test_t(const std::vector<std::istream *> &input,
                      const std::vector<archive_ostream_t *> &output, instrlist_t &instrs,
-                     void *drcontext, uint64_t chunk_instr_count = 10 * 1000 * 1000)
+                     void *drcontext, uint64_t chunk_instr_count = 10 * 1000 * 1000,
+                     int worker_count = -1)
         : raw2trace_t(nullptr, input, {}, output, INVALID_FILE, nullptr, nullptr,
                       drcontext,
                       // The sequences are small so we print everything for easier
                       // debugging and viewing of what's going on.
-                      4, /*worker_count=*/-1, /*alt_module_dir=*/"", chunk_instr_count)
+                      4, worker_count, /*alt_module_dir=*/"", chunk_instr_count)
     {
         module_mapper_ = std::unique_ptr<module_mapper_t>(
             new test_module_mapper_t(&instrs, drcontext));
@@ -139,6 +143,9 @@ public:
             std::unique_ptr<module_mapper_t>(new test_multi_module_mapper_t(modules));
         set_modmap_(module_mapper_.get());
     }
+    using raw2trace_t::get_persisted_block_count;
+    using raw2trace_t::get_helped_segment_count;
+    using raw2trace_t::set_segment_entries;
 };
 
 class archive_ostream_test_t : public archive_ostream_t {
@@ -305,81 +312,140 @@ populate_all_stats(raw2trace_test_t &raw2trace, std::vector<uint64_t> *stats)
     }
 }
 
-// Takes ownership of ilist and destroys it.
+// Converts each of "raws" as a thread file, with our subclass supplying the
+// decodings of "ilist" or else the bounds of "modules", and appends each file's
+// output to the corresponding element of "entries".  The output is an archive with
+// chunks of chunk_instr_count instructions if that is non-zero.  A worker_count of
+// 2 or more splits the files into segments converted concurrently, which are made
+// small to have many of them.  Takes ownership of ilist and destroys it.
 bool
-run_raw2trace(void *drcontext, const std::vector<offline_entry_t> raw, instrlist_t *ilist,
-              std::vector<trace_entry_t> &entries, std::vector<uint64_t> *stats = nullptr,
-              int chunk_instr_count = 0,
-              const std::vector<test_multi_module_mapper_t::bounds_t> &modules = {})
+run_raw2trace(void *drcontext, const std::vector<std::vector<offline_entry_t>> &raws,
+              instrlist_t *ilist, std::vector<std::vector<trace_entry_t>> &entries,
+              std::vector<uint64_t> *stats = nullptr, int chunk_instr_count = 0,
+              const std::vector<test_multi_module_mapper_t::bounds_t> &modules = {},
+              int worker_count = -1, const std::string &decode_cache_file = "",
+              uint64_t *persisted_blocks = nullptr, uint64_t *helped_segments = nullptr)
 {
-    // We need an istream so we use istringstream.
-    std::ostringstream raw_out;
-    for (const auto &entry : raw) {
-        std::string as_string(reinterpret_cast<const char *>(&entry),
-                              reinterpret_cast<const char *>(&entry + 1));
-        raw_out << as_string;
-    }
-    std::istringstream raw_in(raw_out.str());
+    // We need istreams so we use istringstream.
+    std::vector<std::unique_ptr<std::istringstream>> raw_ins;
     std::vector<std::istream *> input;
-    input.push_back(&raw_in);
-
-    std::string result;
-
-    if (chunk_instr_count > 0) {
-        // We need an archive_ostream to enable chunking.
-        archive_ostream_test_t result_stream;
-        std::vector<archive_ostream_t *> output;
-        output.push_back(&result_stream);
+    for (const auto &raw : raws) {
+        std::ostringstream raw_out;
+        for (const auto &entry : raw) {
+            std::string as_string(reinterpret_cast<const char *>(&entry),
+                                  reinterpret_cast<const char *>(&entry + 1));
+            raw_out << as_string;
+        }
+        raw_ins.emplace_back(new std::istringstream(raw_out.str()));
+        input.push_back(raw_ins.back().get());
+    }
 
-        // Run raw2trace with our subclass supplying our decodings.
-        // Pass in our chunk instr count.
-        raw2trace_test_t raw2trace(input, output, *ilist, drcontext, chunk_instr_count);
+    std::vector<std::string> results;
+    auto convert = [&](raw2trace_test_t &raw2trace) {
+        if (worker_count >= 2)
+            raw2trace.set_segment_entries(8);
+        if (!decode_cache_file.empty())
+            raw2trace.set_decode_cache_file(decode_cache_file);
         std::string error = raw2trace.do_conversion();
         CHECK(error.empty(), error);
-        result = result_stream.str();
         populate_all_stats(raw2trace, stats);
-    } else if (modules.empty()) {
-        // We need an ostream to capture out.
-        std::ostringstream result_stream;
-        std::vector<std::ostream *> output;
-        output.push_back(&result_stream);
+        if (persisted_blocks != nullptr)
+            *persisted_blocks = raw2trace.get_persisted_block_count();
+        if (helped_segments != nullptr)
+            *helped_segments = raw2trace.get_helped_segment_count();
+        return true;
+    };
+    if (chunk_instr_count > 0) {
+        // We need archive_ostreams to enable chunking.
+        std::vector<std::unique_ptr<archive_ostream_test_t>> result_streams;
+        std::vector<archive_ostream_t *> output;
+        for (size_t i = 0; i < raws.size(); ++i) {
+            result_streams.emplace_back(new archive_ostream_test_t);
+            output.push_back(result_streams.back().get());
+        }
 
         // Run raw2trace with our subclass supplying our decodings.
-        raw2trace_test_t raw2trace(input, output, *ilist, drcontext);
-        std::string error = raw2trace.do_conversion();
-        CHECK(error.empty(), error);
-        result = result_stream.str();
-        populate_all_stats(raw2trace, stats);
+        // Pass in our chunk instr count.
+        raw2trace_test_t raw2trace(input, output, *ilist, drcontext, chunk_instr_count,
+                                   worker_count);
+        if (!convert(raw2trace))
+            return false;
+        for (const auto &result_stream : result_streams)
+            results.push_back(result_stream->str());
     } else {
-        // We need an ostream to capture out.
-        std::ostringstream result_stream;
+        // We need ostreams to capture out.
+        std::vector<std::unique_ptr<std::ostringstream>> result_streams;
         std::vector<std::ostream *> output;
-        output.push_back(&result_stream);
+        for (size_t i = 0; i < raws.size(); ++i) {
+            result_streams.emplace_back(new std::ostringstream);
+            output.push_back(result_streams.back().get());
+        }
 
-        // Run raw2trace with our subclass supplying module bounds.
-        raw2trace_test_t raw2trace(input, output, modules, drcontext);
-        std::string error = raw2trace.do_conversion();
-        CHECK(error.empty(), error);
-        result = result_stream.str();
-        populate_all_stats(raw2trace, stats);
+        if (modules.empty()) {
+            // Run raw2trace with our subclass supplying our decodings.
+            raw2trace_test_t raw2trace(input, output, *ilist, drcontext, worker_count);
+            if (!convert(raw2trace))
+                return false;
+        } else {
+            // Run raw2trace with our subclass supplying module bounds.
+            raw2trace_test_t raw2trace(input, output, modules, drcontext);
+            if (!convert(raw2trace))
+                return false;
+        }
+        for (const auto &result_stream : result_streams)
+            results.push_back(result_stream->str());
     }
     if (ilist != nullptr)
         instrlist_clear_and_destroy(drcontext, ilist);
 
     // Now check the results.
-    char *start = &result[0];
-    char *end = start + result.size();
-    CHECK(result.size() % sizeof(trace_entry_t) == 0,
-          "output is not a multiple of trace_entry_t");
-    while (start < end) {
-        entries.push_back(*reinterpret_cast<trace_entry_t *>(start));
-        start += sizeof(trace_entry_t);
+    entries.resize(results.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+        char *start = &results[i][0];
+        char *end = start + results[i].size();
+        CHECK(results[i].size() % sizeof(trace_entry_t) == 0,
+              "output is not a multiple of trace_entry_t");
+        while (start < end) {
+            entries[i].push_back(*reinterpret_cast<trace_entry_t *>(start));
+            start += sizeof(trace_entry_t);
+        }
+        int idx = 0;
+        for (const auto &entry : entries[i]) {
+            std::cerr << idx << " type: " << entry.type << " size: " << entry.size
+                      << " val: " << entry.addr << "\n";
+            ++idx;
+        }
     }
-    int idx = 0;
-    for (const auto &entry : entries) {
-        std::cerr << idx << " type: " << entry.type << " size: " << entry.size
-                  << " val: " << entry.addr << "\n";
-        ++idx;
+    return true;
+}
+
+// Converts a single thread's raw entries.  Takes ownership of ilist and destroys it.
+bool
+run_raw2trace(void *drcontext, const std::vector<offline_entry_t> raw, instrlist_t *ilist,
+              std::vector<trace_entry_t> &entries, std::vector<uint64_t> *stats = nullptr,
+              int chunk_instr_count = 0,
+              const std::vector<test_multi_module_mapper_t::bounds_t> &modules = {})
+{
+    std::vector<std::vector<trace_entry_t>> thread_entries;
+    if (!run_raw2trace(drcontext, { raw }, ilist, thread_entries, stats,
+                       chunk_instr_count, modules))
+        return false;
+    entries.insert(entries.end(), thread_entries[0].begin(), thread_entries[0].end());
+    return true;
+}
+
+// Returns whether the conversions produced identical entries.
+bool
+same_entries(const std::vector<std::vector<trace_entry_t>> &a,
+             const std::vector<std::vector<trace_entry_t>> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].size() != b[i].size() ||
+            (!a[i].empty() &&
+             memcmp(a[i].data(), b[i].data(), a[i].size() * sizeof(a[i][0])) != 0))
+            return false;
     }
     return true;
 }
@@ -2559,46 +2625,177 @@ test_stats_timestamp_instr_count(void *drcontext)
     raw2.push_back(make_timestamp(789));
     raw2.push_back(make_exit());
 
-    // XXX: Below, we duplicate some work done by run_raw2trace. We could
-    // extend run_raw2trace to work with multiple threads by accepting nested
-    // vectors but maybe it's better to keep it specialized to the single
-    // thread case so that the most common use remains simple.
-
-    // We need an istream so we use istringstream.
-    std::ostringstream raw_out1;
-    for (const auto &entry : raw1) {
-        std::string as_string(reinterpret_cast<const char *>(&entry),
-                              reinterpret_cast<const char *>(&entry + 1));
-        raw_out1 << as_string;
-    }
-    std::ostringstream raw_out2;
-    for (const auto &entry : raw2) {
-        std::string as_string(reinterpret_cast<const char *>(&entry),
-                              reinterpret_cast<const char *>(&entry + 1));
-        raw_out2 << as_string;
-    }
-    std::istringstream raw_in1(raw_out1.str()), raw_in2(raw_out2.str());
-    std::vector<std::istream *> input;
-    input.push_back(&raw_in1);
-    input.push_back(&raw_in2);
-
-    // We need an ostream to capture out.
-    std::ostringstream result_stream1, result_stream2;
-    std::vector<std::ostream *> output;
-    output.push_back(&result_stream1);
-    output.push_back(&result_stream2);
-
-    // Run raw2trace with our subclass supplying our decodings.
+    std::vector<std::vector<trace_entry_t>> entries;
     std::vector<uint64_t> stats;
-    raw2trace_test_t raw2trace(input, output, *ilist, drcontext);
-    std::string error = raw2trace.do_conversion();
-    CHECK(error.empty(), error);
-    populate_all_stats(raw2trace, &stats);
+    if (!run_raw2trace(drcontext, { raw1, raw2 }, ilist, entries, &stats))
+        return false;
     return stats[RAW2TRACE_STAT_FINAL_TRACE_INSTRUCTION_COUNT] == 4 &&
         stats[RAW2TRACE_STAT_EARLIEST_TRACE_TIMESTAMP] == 123 &&
         stats[RAW2TRACE_STAT_LATEST_TRACE_TIMESTAMP] == 789;
 }
 
+bool
+test_segmented_conversion(void *drcontext)
+{
+    std::cerr << "\n===============\nTesting segmented conversion\n";
+    instrlist_t *ilist = instrlist_create(drcontext);
+    // raw2trace doesn't like offsets of 0 so we shift with a nop.
+    instr_t *nop = XINST_CREATE_nop(drcontext);
+    instr_t *move1 =
+        XINST_CREATE_move(drcontext, opnd_create_reg(REG1), opnd_create_reg(REG2));
+    instr_t *move2 =
+        XINST_CREATE_move(drcontext, opnd_create_reg(REG2), opnd_create_reg(REG1));
+    instr_t *jmp_move2 = XINST_CREATE_jump(drcontext, opnd_create_instr(move2));
+    instr_t *jcc_move1 =
+        XINST_CREATE_jump_cond(drcontext, DR_PRED_EQ, opnd_create_instr(move1));
+    instr_t *ret = XINST_CREATE_return(drcontext);
+    instrlist_append(ilist, nop);
+    // Block 1.
+    instrlist_append(ilist, move1);
+    instrlist_append(ilist, jmp_move2);
+    // Block 2.
+    instrlist_append(ilist, move2);
+    instrlist_append(ilist, jcc_move1);
+    // Block 3, which cannot start a segment.
+    instrlist_append(ilist, ret);
+    size_t offs_move1 = instr_length(drcontext, nop);
+    size_t offs_move2 = offs_move1 + instr_length(drcontext, move1) +
+        instr_length(drcontext, jmp_move2);
+    size_t offs_ret = offs_move2 + instr_length(drcontext, move2) +
+        instr_length(drcontext, jcc_move1);
+
+    // Each timestamp is a potential split point, with branches delayed across it.
+    auto make_raw = [&](int tid, int iters) {
+        std::vector<offline_entry_t> raw;
+        raw.push_back(make_header());
+        raw.push_back(make_tid(tid));
+        raw.push_back(make_pid());
+        raw.push_back(make_line_size());
+        for (int i = 0; i < iters; ++i) {
+            raw.push_back(make_timestamp());
+            raw.push_back(make_core());
+            if (i % 7 == 3) {
+                raw.push_back(make_block(offs_ret, 1));
+            }
+            if (i % 11 == 5)
+                raw.push_back(make_window_id(i / 11));
+            raw.push_back(make_block(offs_move1, 2));
+            raw.push_back(make_block(offs_move2, 2));
+            if (i % 3 == 0)
+                raw.push_back(make_block(offs_move1, 2));
+        }
+        raw.push_back(make_block(offs_move2, 2));
+        raw.push_back(make_exit());
+        return raw;
+    };
+
+    bool res = true;
+    const std::vector<std::vector<offline_entry_t>> raw = { make_raw(1, 50) };
+    for (int chunk_instr_count : { 10 * 1000 * 1000, 7 }) {
+        std::vector<std::vector<trace_entry_t>> serial, segmented;
+        if (!run_raw2trace(drcontext, raw, instrlist_clone(drcontext, ilist), serial,
+                           /*stats=*/nullptr, chunk_instr_count, /*modules=*/ {},
+                           /*worker_count=*/0) ||
+            !run_raw2trace(drcontext, raw, instrlist_clone(drcontext, ilist), segmented,
+                           /*stats=*/nullptr, chunk_instr_count, /*modules=*/ {},
+                           /*worker_count=*/4))
+            res = false;
+        else if (!same_entries(serial, segmented)) {
+            std::cerr << "Segmented output differs for chunk size " << chunk_instr_count
+                      << "\n";
+            res = false;
+        }
+    }
+    // With one large file among small ones and no spare workers up front, the
+    // workers done with the small files help convert the large one.
+    std::vector<std::vector<offline_entry_t>> raws = { make_raw(1, 2000) };
+    for (int tid = 2; tid <= 4; ++tid)
+        raws.push_back(make_raw(tid, 2));
+    std::vector<std::vector<trace_entry_t>> serial, segmented;
+    uint64_t helped_segments = 0;
+    if (!run_raw2trace(drcontext, raws, instrlist_clone(drcontext, ilist), serial,
+                       /*stats=*/nullptr, /*chunk_instr_count=*/0, /*modules=*/ {},
+                       /*worker_count=*/0) ||
+        !run_raw2trace(drcontext, raws, instrlist_clone(drcontext, ilist), segmented,
+                       /*stats=*/nullptr, /*chunk_instr_count=*/0, /*modules=*/ {},
+                       /*worker_count=*/4, /*decode_cache_file=*/"",
+                       /*persisted_blocks=*/nullptr, &helped_segments))
+        res = false;
+    else if (!same_entries(serial, segmented)) {
+        std::cerr << "Segmented output differs for unequal files\n";
+        res = false;
+    } else if (helped_segments == 0) {
+        std::cerr << "No worker helped convert the large file\n";
+        res = false;
+    }
+    instrlist_clear_and_destroy(drcontext, ilist);
+    return res;
+}
+
+bool
+test_decode_cache_file(void *drcontext)
+{
+    std::cerr << "\n===============\nTesting decode cache file\n";
+    instrlist_t *ilist = instrlist_create(drcontext);
+    // raw2trace doesn't like offsets of 0 so we shift with a nop.
+    instr_t *nop = XINST_CREATE_nop(drcontext);
+    instr_t *move1 =
+        XINST_CREATE_move(drcontext, opnd_create_reg(REG1), opnd_create_reg(REG2));
+    instr_t *store =
+        XINST_CREATE_store(drcontext, OPND_CREATE_MEMPTR(REG2, 0), opnd_create_reg(REG1));
+    instr_t *jmp = XINST_CREATE_jump(drcontext, opnd_create_instr(move1));
+    instr_t *move2 =
+        XINST_CREATE_move(drcontext, opnd_create_reg(REG2), opnd_create_reg(REG1));
+    instrlist_append(ilist, nop);
+    instrlist_append(ilist, move1);
+    instrlist_append(ilist, store);
+    instrlist_append(ilist, jmp);
+    instrlist_append(ilist, move2);
+    size_t offs_move1 = instr_length(drcontext, nop);
+    size_t offs_move2 = offs_move1 + instr_length(drcontext, move1) +
+        instr_length(drcontext, store) + instr_length(drcontext, jmp);
+
+    std::vector<offline_entry_t> raw;
+    raw.push_back(make_header());
+    raw.push_back(make_tid());
+    raw.push_back(make_pid());
+    raw.push_back(make_line_size());
+    raw.push_back(make_timestamp());
+    raw.push_back(make_core());
+    for (int i = 0; i < 3; ++i) {
+        raw.push_back(make_block(offs_move1, 3));
+        raw.push_back(make_memref(42 + i));
+    }
+    raw.push_back(make_block(offs_move2, 1));
+    raw.push_back(make_exit());
+
+    // We use the current directory as we have no temp dir parameter.
+    const std::string cache_file = "raw2trace_unit_tests.decode_cache";
+    std::remove(cache_file.c_str());
+    std::vector<std::vector<trace_entry_t>> uncached, cold, warm;
+    uint64_t uncached_count, cold_count, warm_count;
+    auto convert = [&](const std::string &file,
+                       std::vector<std::vector<trace_entry_t>> &entries,
+                       uint64_t *persisted_blocks) {
+        return run_raw2trace(drcontext, { raw }, instrlist_clone(drcontext, ilist),
+                             entries, /*stats=*/nullptr, /*chunk_instr_count=*/0,
+                             /*modules=*/ {}, /*worker_count=*/-1, file,
+                             persisted_blocks);
+    };
+    bool res = convert("", uncached, &uncached_count) &&
+        convert(cache_file, cold, &cold_count) && convert(cache_file, warm, &warm_count);
+    std::remove(cache_file.c_str());
+    instrlist_clear_and_destroy(drcontext, ilist);
+    if (!res)
+        return false;
+    // Both blocks come from the file in the second conversion.
+    CHECK(uncached_count == 0 && cold_count == 0 && warm_count == 2,
+          "decode cache file was not used");
+    CHECK(same_entries(uncached, cold) && same_entries(uncached, warm),
+          "decode cache file changed the output");
+    return true;
+}
+
 int
 test_main(int argc, const char *argv[])
 {
@@ -2616,7 +2813,8 @@ test_main(int argc, const char *argv[])
         !test_rseq_side_exit_inverted_with_timestamp(drcontext) ||
         !test_xfer_modoffs(drcontext) || !test_xfer_absolute(drcontext) ||
         !test_branch_decoration(drcontext) ||
-        !test_stats_timestamp_instr_count(drcontext))
+        !test_stats_timestamp_instr_count(drcontext) ||
+        !test_segmented_conversion(drcontext) || !test_decode_cache_file(drcontext))
         return 1;
     return 0;
 }
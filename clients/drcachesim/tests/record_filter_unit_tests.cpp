@@ -39,9 +39,11 @@
 #include "tools/filter/null_filter.h"
 #include "tools/filter/cache_filter.h"
 #include "tools/filter/record_filter.h"
+#include "tools/filter/sample_filter.h"
 #include "tools/filter/type_filter.h"
 
 #include <inttypes.h>
+#include <algorithm>
 #include <fstream>
 #include <vector>
 
@@ -397,6 +399,157 @@ test_cache_and_type_filter()
     return true;
 }
 
+// Runs a record_filter_t with the single filter "filter" on "input" and returns
+// its output in "output".
+static bool
+run_single_filter(
+    std::unique_ptr<dynamorio::drmemtrace::record_filter_t::record_filter_func_t> filter,
+    const std::vector<trace_entry_t> &input, std::vector<trace_entry_t> &output)
+{
+    if (filter->get_error_string() != "") {
+        fprintf(stderr, "Couldn't construct a filter %s",
+                filter->get_error_string().c_str());
+        return false;
+    }
+    std::vector<
+        std::unique_ptr<dynamorio::drmemtrace::record_filter_t::record_filter_func_t>>
+        filters;
+    filters.push_back(std::move(filter));
+    auto stream = std::unique_ptr<local_stream_t>(new local_stream_t());
+    auto record_filter = std::unique_ptr<test_record_filter_t>(
+        new test_record_filter_t(std::move(filters), /*last_timestamp=*/0));
+    void *shard_data =
+        record_filter->parallel_shard_init_stream(0, nullptr, stream.get());
+    CHECK(*record_filter, "Filtering init failed");
+    for (const trace_entry_t &entry : input) {
+        CHECK(record_filter->parallel_shard_memref(shard_data, entry),
+              "Filtering failed");
+    }
+    if (!record_filter->parallel_shard_exit(shard_data) || !*record_filter) {
+        fprintf(stderr, "Filtering exit failed\n");
+        return false;
+    }
+    output = record_filter->get_output_entries();
+    return true;
+}
+
+static bool
+test_sample_filter()
+{
+    // A thread of NUM_INSTRS instructions, each with a load.  Instructions repeat
+    // every 4 pcs and only the first has an encoding, which the filter must still
+    // output before the first kept instance of that pc.
+    constexpr int NUM_INSTRS = 14;
+    constexpr addr_t TID = 7;
+    std::vector<trace_entry_t> header = {
+        { TRACE_TYPE_HEADER, 0, { 0x1 } },
+        { TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_VERSION, { 0x2 } },
+        { TRACE_TYPE_MARKER,
+          TRACE_MARKER_TYPE_FILETYPE,
+          { OFFLINE_FILE_TYPE_ENCODINGS } },
+        { TRACE_TYPE_THREAD, 0, { TID } },
+        { TRACE_TYPE_PID, 0, { 0x3 } },
+        { TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_TIMESTAMP, { 0x4 } },
+        { TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_CPU_ID, { 0x5 } },
+    };
+    const trace_entry_t encoding = { TRACE_TYPE_ENCODING, 4, { 0xdead } };
+    auto instr = [](int i) -> trace_entry_t {
+        return { TRACE_TYPE_INSTR, 4, { static_cast<addr_t>(0x100 + 4 * (i % 4)) } };
+    };
+    auto load = [](int i) -> trace_entry_t {
+        return { TRACE_TYPE_READ, 8, { static_cast<addr_t>(0x800 + 8 * i) } };
+    };
+    auto marker = [](trace_marker_type_t type, addr_t value) -> trace_entry_t {
+        return { TRACE_TYPE_MARKER, static_cast<unsigned short>(type), { value } };
+    };
+    std::vector<trace_entry_t> input = header;
+    for (int i = 0; i < NUM_INSTRS; ++i) {
+        if (i == 0)
+            input.push_back(encoding);
+        input.push_back(instr(i));
+        input.push_back(load(i));
+    }
+    input.push_back({ TRACE_TYPE_THREAD_EXIT, 0, { TID } });
+    input.push_back({ TRACE_TYPE_FOOTER, 0, { 0x6 } });
+
+    // With 3 skipped, 1 warmup, and 2 window instructions, instructions 3 and 9
+    // are warmup, 4-5 and 10-11 are windows, and the trace ends in a skip.
+    std::vector<trace_entry_t> expected = header;
+    expected[2].addr |= OFFLINE_FILE_TYPE_IFILTERED | OFFLINE_FILE_TYPE_DFILTERED;
+    auto add_kept = [&](int i) {
+        expected.push_back(instr(i));
+        expected.push_back(load(i));
+    };
+    expected.push_back(marker(TRACE_MARKER_TYPE_SAMPLE_SKIP, 3));
+    add_kept(3);
+    expected.push_back(marker(TRACE_MARKER_TYPE_SAMPLE_WINDOW, 0));
+    expected.push_back(encoding);
+    add_kept(4);
+    add_kept(5);
+    expected.push_back(marker(TRACE_MARKER_TYPE_SAMPLE_SKIP, 3));
+    add_kept(9);
+    expected.push_back(marker(TRACE_MARKER_TYPE_SAMPLE_WINDOW, 1));
+    add_kept(10);
+    add_kept(11);
+    expected.push_back(marker(TRACE_MARKER_TYPE_SAMPLE_SKIP, 2));
+    expected.push_back({ TRACE_TYPE_THREAD_EXIT, 0, { TID } });
+    expected.push_back({ TRACE_TYPE_FOOTER, 0, { 0x6 } });
+
+    std::vector<trace_entry_t> output;
+    if (!run_single_filter(
+            std::unique_ptr<dynamorio::drmemtrace::record_filter_t::record_filter_func_t>(
+                new dynamorio::drmemtrace::sample_filter_t(
+                    /*window_instrs=*/2, /*skip_instrs=*/3, /*warmup_instrs=*/1)),
+            input, output))
+        return false;
+    for (size_t i = 0; i < std::max(output.size(), expected.size()); ++i) {
+        if (i >= output.size() || i >= expected.size() ||
+            memcmp(&output[i], &expected[i], sizeof(trace_entry_t)) != 0) {
+            fprintf(stderr, "Wrong sample filter result at pos=%zu\n", i);
+            return false;
+        }
+    }
+
+    // With random skips, every instruction is either kept or counted as removed,
+    // and each window is complete except perhaps the last.
+    constexpr int NUM_RANDOM_INSTRS = 1000;
+    input = header;
+    for (int i = 0; i < NUM_RANDOM_INSTRS; ++i)
+        input.push_back(instr(i));
+    input.push_back({ TRACE_TYPE_THREAD_EXIT, 0, { TID } });
+    if (!run_single_filter(
+            std::unique_ptr<dynamorio::drmemtrace::record_filter_t::record_filter_func_t>(
+                new dynamorio::drmemtrace::sample_filter_t(
+                    /*window_instrs=*/10, /*skip_instrs=*/50, /*warmup_instrs=*/5,
+                    /*random_seed=*/42)),
+            input, output))
+        return false;
+    uint64_t kept = 0, removed = 0, windows = 0, window_instrs = 0;
+    bool in_window = false;
+    for (const trace_entry_t &entry : output) {
+        if (entry.type == TRACE_TYPE_INSTR) {
+            ++kept;
+            if (in_window)
+                ++window_instrs;
+        } else if (entry.type == TRACE_TYPE_MARKER &&
+                   entry.size == TRACE_MARKER_TYPE_SAMPLE_SKIP) {
+            CHECK(!in_window || window_instrs == 10, "Incomplete sampling window");
+            removed += entry.addr;
+            in_window = false;
+        } else if (entry.type == TRACE_TYPE_MARKER &&
+                   entry.size == TRACE_MARKER_TYPE_SAMPLE_WINDOW) {
+            CHECK(entry.addr == windows, "Wrong sampling window ordinal");
+            ++windows;
+            in_window = true;
+            window_instrs = 0;
+        }
+    }
+    CHECK(kept + removed == NUM_RANDOM_INSTRS, "Sampling lost instructions");
+    CHECK(windows > 1 && kept < NUM_RANDOM_INSTRS / 2, "Too few instructions sampled");
+    fprintf(stderr, "test_sample_filter passed\n");
+    return true;
+}
+
 // Tests I/O for the record_filter.
 static bool
 test_null_filter()
@@ -454,7 +607,7 @@ test_main(int argc, const char *argv[])
         FATAL_ERROR("Usage error: %s\nUsage:\n%s", parse_err.c_str(),
                     droption_parser_t::usage_short(DROPTION_SCOPE_ALL).c_str());
     }
-    if (!test_cache_and_type_filter() || !test_null_filter())
+    if (!test_cache_and_type_filter() || !test_sample_filter() || !test_null_filter())
         return 1;
     // TODO i#5675: Add test using a freshly generated trace (during the test) when
     // zip support is added.
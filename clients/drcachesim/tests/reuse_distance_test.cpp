@@ -31,6 +31,7 @@
  */
 
 #include <iostream>
+#include <memory>
 #undef NDEBUG
 #include <assert.h>
 
@@ -502,6 +503,103 @@ data_histogram_test()
     }
 }
 
+// Runs the same pseudo-random access stream through a new reuse_distance_test_t
+// with the given knobs and returns it.
+std::unique_ptr<reuse_distance_test_t>
+run_random_stream(const reuse_distance_knobs_t &knobs)
+{
+    constexpr int NUM_ACCESSES = 200000;
+    constexpr int HOT_LINES = 200;
+    constexpr int COLD_LINES = 20000;
+    std::unique_ptr<reuse_distance_test_t> reuse_distance(
+        new reuse_distance_test_t(knobs));
+    uint64_t rand = 12345;
+    for (int i = 0; i < NUM_ACCESSES; ++i) {
+        // A 64-bit LCG is plenty random for this purpose.
+        rand = rand * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t bits = rand >> 32;
+        uint64_t line = (bits % 4 != 0) ? (bits >> 2) % HOT_LINES
+                                        : HOT_LINES + (bits >> 2) % COLD_LINES;
+        trace_type_t type = (bits & 0x100) != 0 ? TRACE_TYPE_INSTR : TRACE_TYPE_READ;
+        bool success =
+            reuse_distance->process_memref(generate_memref(line * knobs.line_size, type));
+        assert(success);
+    }
+    return reuse_distance;
+}
+
+// Test that the tree engine's results match the list engine's.
+void
+tree_engine_test()
+{
+    std::cerr << "tree_engine_test()\n";
+    for (unsigned int distance_limit : { 0, 3000 }) {
+        reuse_distance_knobs_t knobs;
+        knobs.distance_threshold = 1000;
+        knobs.distance_limit = distance_limit;
+        knobs.engine = "list";
+        auto list = run_random_stream(knobs);
+        knobs.engine = "tree";
+        auto tree = run_random_stream(knobs);
+        auto *list_shard = list->get_aggregated_results();
+        auto *tree_shard = tree->get_aggregated_results();
+        assert(list_shard->dist_map.size() > 1000);
+        assert(list_shard->dist_map == tree_shard->dist_map);
+        assert(list_shard->dist_map_data == tree_shard->dist_map_data);
+        assert(list_shard->ref_list->cur_time_ == tree_shard->ref_list->cur_time_);
+        assert(list_shard->pruned_address_count == tree_shard->pruned_address_count);
+        assert(list_shard->pruned_address_hits == tree_shard->pruned_address_hits);
+        assert(list_shard->cache_map.size() == tree_shard->cache_map.size());
+        int64_t distant_refs = 0;
+        for (const auto &entry : list_shard->cache_map) {
+            const auto it = tree_shard->cache_map.find(entry.first);
+            assert(it != tree_shard->cache_map.end());
+            assert(it->second->total_refs == entry.second->total_refs);
+            assert(it->second->distant_refs == entry.second->distant_refs);
+            distant_refs += entry.second->distant_refs;
+        }
+        assert(distant_refs > 0);
+    }
+}
+
+// Test sampling by cycling through a set of lines, where every reuse has the
+// same distance.
+void
+sampled_reuse_distance_test()
+{
+    std::cerr << "sampled_reuse_distance_test()\n";
+    constexpr int NUM_LINES = 4000;
+    constexpr int NUM_PASSES = 10;
+    constexpr double SAMPLE_RATE = 0.1;
+    for (const char *engine : { "list", "tree" }) {
+        reuse_distance_knobs_t knobs;
+        knobs.engine = engine;
+        knobs.sample_rate = SAMPLE_RATE;
+        reuse_distance_test_t reuse_distance(knobs);
+        for (int pass = 0; pass < NUM_PASSES; ++pass) {
+            for (int line = 0; line < NUM_LINES; ++line) {
+                bool success = reuse_distance.process_memref(
+                    generate_memref(static_cast<addr_t>(line) * knobs.line_size));
+                assert(success);
+            }
+        }
+        auto *shard = reuse_distance.get_aggregated_results();
+        // Totals cover all accesses but only sampled lines are tracked.
+        assert(shard->total_refs == NUM_LINES * NUM_PASSES);
+        int64_t sampled_lines = static_cast<int64_t>(shard->cache_map.size());
+        assert(sampled_lines > NUM_LINES * SAMPLE_RATE * 0.8 &&
+               sampled_lines < NUM_LINES * SAMPLE_RATE * 1.2);
+        // The estimated distances should be close to the true distance.
+        int64_t reuses = 0;
+        for (const auto &entry : shard->dist_map) {
+            assert(entry.first > (NUM_LINES - 1) * 0.8 &&
+                   entry.first < (NUM_LINES - 1) * 1.2);
+            reuses += entry.second;
+        }
+        assert(reuses == sampled_lines * (NUM_PASSES - 1));
+    }
+}
+
 int
 test_main(int argc, const char *argv[])
 {
@@ -511,6 +609,8 @@ test_main(int argc, const char *argv[])
     simple_reuse_distance_test();
     reuse_distance_limit_test();
     data_histogram_test();
+    tree_engine_test();
+    sampled_reuse_distance_test();
     return 0;
 }
 
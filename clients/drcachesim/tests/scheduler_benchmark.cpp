@@ -0,0 +1,170 @@
+/* **********************************************************
+ * Copyright (c) 2023 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Microbenchmark of the dynamic scheduler: measures input switches per second
+ * for increasing numbers of outputs, each driven by its own thread, using a
+ * single global ready queue versus per-output ready queues with work stealing
+ * (SCHEDULER_LOCAL_READY_QUEUES).  Takes an optional per-input instruction
+ * count; the default is small enough to run as a regular test.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#undef NDEBUG
+#include <assert.h>
+
+#include "scheduler.h"
+#include "mock_reader.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+namespace {
+
+struct benchmark_result_t {
+    double switches_per_sec;
+    int64_t switches;
+    int64_t instrs;
+};
+
+void
+simulate_output(scheduler_t::stream_t *stream, std::atomic<int64_t> *switches,
+                std::atomic<int64_t> *instrs)
+{
+    memref_t record;
+    int64_t local_switches = 0;
+    int64_t local_instrs = 0;
+    int prev_input = -1;
+    for (scheduler_t::stream_status_t status = stream->next_record(record);
+         status != scheduler_t::STATUS_EOF; status = stream->next_record(record)) {
+        if (status == scheduler_t::STATUS_WAIT) {
+            std::this_thread::yield();
+            continue;
+        }
+        assert(status == scheduler_t::STATUS_OK);
+        int input = stream->get_input_stream_ordinal();
+        if (input != prev_input) {
+            ++local_switches;
+            prev_input = input;
+        }
+        if (type_is_instr(record.instr.type))
+            ++local_instrs;
+    }
+    *switches += local_switches;
+    *instrs += local_instrs;
+}
+
+benchmark_result_t
+run_benchmark(int num_outputs, bool local_queues, int num_instrs)
+{
+    static constexpr int INPUTS_PER_OUTPUT = 4;
+    static constexpr memref_tid_t TID_BASE = 100;
+    // A tiny quantum makes the benchmark dominated by scheduling decisions.
+    static constexpr int QUANTUM_DURATION = 2;
+    int num_inputs = num_outputs * INPUTS_PER_OUTPUT;
+    std::vector<scheduler_t::input_workload_t> sched_inputs;
+    for (int i = 0; i < num_inputs; i++) {
+        memref_tid_t tid = TID_BASE + i;
+        std::vector<trace_entry_t> inputs;
+        inputs.push_back(make_thread(tid));
+        inputs.push_back(make_pid(1));
+        for (int j = 0; j < num_instrs; j++) {
+            if (j % 100 == 0)
+                inputs.push_back(make_timestamp(10 * (j + 1) + i));
+            inputs.push_back(make_instr(42 + (j % 64) * 4));
+        }
+        inputs.push_back(make_exit(tid));
+        std::vector<scheduler_t::input_reader_t> readers;
+        readers.emplace_back(std::unique_ptr<mock_reader_t>(new mock_reader_t(inputs)),
+                             std::unique_ptr<mock_reader_t>(new mock_reader_t()), tid);
+        sched_inputs.emplace_back(std::move(readers));
+    }
+    scheduler_t::scheduler_options_t sched_ops(
+        scheduler_t::MAP_TO_ANY_OUTPUT, scheduler_t::DEPENDENCY_TIMESTAMPS,
+        local_queues ? scheduler_t::SCHEDULER_LOCAL_READY_QUEUES
+                     : scheduler_t::SCHEDULER_DEFAULTS);
+    sched_ops.quantum_duration = QUANTUM_DURATION;
+    scheduler_t scheduler;
+    if (scheduler.init(sched_inputs, num_outputs, sched_ops) !=
+        scheduler_t::STATUS_SUCCESS)
+        assert(false);
+    std::atomic<int64_t> switches(0);
+    std::atomic<int64_t> instrs(0);
+    std::vector<std::thread> threads;
+    threads.reserve(num_outputs);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_outputs; ++i) {
+        threads.emplace_back(
+            std::thread(&simulate_output, scheduler.get_stream(i), &switches, &instrs));
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    auto end = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(end - start).count();
+    benchmark_result_t result;
+    result.switches = switches.load();
+    result.instrs = instrs.load();
+    result.switches_per_sec = secs > 0 ? result.switches / secs : 0;
+    return result;
+}
+
+} // namespace
+
+int
+test_main(int argc, const char *argv[])
+{
+    int num_instrs = 2000;
+    if (argc > 1)
+        num_instrs = std::atoi(argv[1]);
+    for (int num_outputs = 1; num_outputs <= 64; num_outputs *= 4) {
+        benchmark_result_t global = run_benchmark(num_outputs, false, num_instrs);
+        benchmark_result_t local = run_benchmark(num_outputs, true, num_instrs);
+        // Both must run every instruction exactly once.
+        int64_t expected_instrs = static_cast<int64_t>(num_outputs) * 4 * num_instrs;
+        assert(global.instrs == expected_instrs);
+        assert(local.instrs == expected_instrs);
+        std::cerr << std::setw(2) << num_outputs << " outputs: global queue "
+                  << std::fixed << std::setprecision(2)
+                  << global.switches_per_sec / 1e6 << "M switches/sec, local queues "
+                  << local.switches_per_sec / 1e6 << "M switches/sec\n";
+    }
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
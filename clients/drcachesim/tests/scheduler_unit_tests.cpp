@@ -257,6 +257,162 @@ test_parallel()
     assert(count == 2 * NUM_INPUTS);
 }
 
+static void
+test_batch()
+{
+    std::cerr << "\n----------------\nTesting batches\n";
+    static constexpr memref_tid_t TID_A = 42;
+    static constexpr size_t MAX_BATCH = 4;
+    std::vector<trace_entry_t> refs = {
+        /* clang-format off */
+        make_thread(TID_A),
+        make_pid(1),
+        make_version(4),
+        make_timestamp(10),
+        make_instr(10),
+        make_instr(11),
+        make_instr(12),
+        make_instr(13),
+        make_instr(14),
+        make_instr(15),
+        make_timestamp(20),
+        make_instr(20),
+        make_exit(TID_A),
+        /* clang-format on */
+    };
+    // Read one record at a time to get the expected records and ordinals.
+    std::vector<memref_t> expect_records;
+    std::vector<uint64_t> expect_ordinals;
+    for (int pass = 0; pass < 2; ++pass) {
+        std::vector<scheduler_t::input_reader_t> readers;
+        readers.emplace_back(std::unique_ptr<mock_reader_t>(new mock_reader_t(refs)),
+                             std::unique_ptr<mock_reader_t>(new mock_reader_t()), TID_A);
+        scheduler_t scheduler;
+        std::vector<scheduler_t::input_workload_t> sched_inputs;
+        sched_inputs.emplace_back(std::move(readers));
+        if (scheduler.init(sched_inputs, 1,
+                           scheduler_t::make_scheduler_parallel_options(
+                               /*verbosity=*/4)) != scheduler_t::STATUS_SUCCESS)
+            assert(false);
+        auto *stream = scheduler.get_stream(0);
+        if (pass == 0) {
+            memref_t memref;
+            for (scheduler_t::stream_status_t status = stream->next_record(memref);
+                 status != scheduler_t::STATUS_EOF;
+                 status = stream->next_record(memref)) {
+                assert(status == scheduler_t::STATUS_OK);
+                expect_records.push_back(memref);
+                expect_ordinals.push_back(stream->get_record_ordinal());
+            }
+            continue;
+        }
+        memref_t batch[MAX_BATCH];
+        size_t count;
+        size_t total = 0;
+        for (scheduler_t::stream_status_t status =
+                 stream->next_record_batch(batch, MAX_BATCH, count, 0);
+             status != scheduler_t::STATUS_EOF;
+             status = stream->next_record_batch(batch, MAX_BATCH, count, 0)) {
+            assert(status == scheduler_t::STATUS_OK);
+            assert(count > 0 && count <= MAX_BATCH);
+            for (size_t i = 0; i < count; ++i) {
+                const memref_t &expect = expect_records[total + i];
+                assert(batch[i].instr.type == expect.instr.type &&
+                       batch[i].instr.addr == expect.instr.addr);
+                // Timestamps and thread exits only ever end a batch.
+                bool is_boundary = batch[i].exit.type == TRACE_TYPE_THREAD_EXIT ||
+                    (batch[i].marker.type == TRACE_TYPE_MARKER &&
+                     batch[i].marker.marker_type == TRACE_MARKER_TYPE_TIMESTAMP);
+                assert(!is_boundary || i == count - 1);
+                assert(is_boundary || i < count - 1 || count == MAX_BATCH ||
+                       total + count == expect_records.size());
+            }
+            total += count;
+            // The stream describes the final record of the batch.
+            assert(stream->get_record_ordinal() == expect_ordinals[total - 1]);
+        }
+        assert(total == expect_records.size());
+    }
+}
+
+static void
+test_batch_input_switch()
+{
+    std::cerr << "\n----------------\nTesting batches across input switches\n";
+    static constexpr int NUM_INPUTS = 2;
+    static constexpr int NUM_INSTRS = 9;
+    static constexpr int QUANTUM_DURATION = 3;
+    static constexpr size_t MAX_BATCH = 8;
+    static constexpr memref_tid_t TID_BASE = 100;
+    std::vector<trace_entry_t> inputs[NUM_INPUTS];
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        memref_tid_t tid = TID_BASE + i;
+        inputs[i].push_back(make_thread(tid));
+        inputs[i].push_back(make_pid(1));
+        for (int j = 0; j < NUM_INSTRS; j++)
+            inputs[i].push_back(make_instr(42 + j * 4));
+        inputs[i].push_back(make_exit(tid));
+    }
+    // Read one record at a time to get the expected records and their inputs.
+    std::vector<memref_t> expect_records;
+    std::vector<int> expect_inputs;
+    bool split_batch = false;
+    for (int pass = 0; pass < 2; ++pass) {
+        std::vector<scheduler_t::input_workload_t> sched_inputs;
+        for (int i = 0; i < NUM_INPUTS; i++) {
+            std::vector<scheduler_t::input_reader_t> readers;
+            readers.emplace_back(
+                std::unique_ptr<mock_reader_t>(new mock_reader_t(inputs[i])),
+                std::unique_ptr<mock_reader_t>(new mock_reader_t()), TID_BASE + i);
+            sched_inputs.emplace_back(std::move(readers));
+        }
+        scheduler_t::scheduler_options_t sched_ops(scheduler_t::MAP_TO_ANY_OUTPUT,
+                                                   scheduler_t::DEPENDENCY_IGNORE,
+                                                   scheduler_t::SCHEDULER_DEFAULTS,
+                                                   /*verbosity=*/4);
+        sched_ops.quantum_duration = QUANTUM_DURATION;
+        scheduler_t scheduler;
+        if (scheduler.init(sched_inputs, 1, sched_ops) != scheduler_t::STATUS_SUCCESS)
+            assert(false);
+        auto *stream = scheduler.get_stream(0);
+        if (pass == 0) {
+            memref_t memref;
+            for (scheduler_t::stream_status_t status = stream->next_record(memref);
+                 status != scheduler_t::STATUS_EOF;
+                 status = stream->next_record(memref)) {
+                assert(status == scheduler_t::STATUS_OK);
+                expect_records.push_back(memref);
+                expect_inputs.push_back(stream->get_input_stream_ordinal());
+            }
+            continue;
+        }
+        memref_t batch[MAX_BATCH];
+        size_t count;
+        size_t total = 0;
+        for (scheduler_t::stream_status_t status =
+                 stream->next_record_batch(batch, MAX_BATCH, count, 0);
+             status != scheduler_t::STATUS_EOF;
+             status = stream->next_record_batch(batch, MAX_BATCH, count, 0)) {
+            assert(status == scheduler_t::STATUS_OK);
+            assert(count > 0 && count <= MAX_BATCH);
+            // Every record of the batch comes from the input the stream describes.
+            for (size_t i = 0; i < count; ++i) {
+                const memref_t &expect = expect_records[total + i];
+                assert(batch[i].instr.type == expect.instr.type &&
+                       batch[i].instr.addr == expect.instr.addr &&
+                       batch[i].instr.tid == expect.instr.tid);
+                assert(expect_inputs[total + i] == stream->get_input_stream_ordinal());
+            }
+            total += count;
+            if (count < MAX_BATCH && batch[count - 1].exit.type != TRACE_TYPE_THREAD_EXIT)
+                split_batch = true;
+        }
+        assert(total == expect_records.size());
+    }
+    // The quantum ended partway through a batch.
+    assert(split_batch);
+}
+
 static void
 test_param_checks()
 {
@@ -1706,6 +1862,75 @@ test_synthetic_multi_threaded(const char *testdir)
 #endif
 }
 
+static void
+test_synthetic_with_local_queues()
+{
+    std::cerr << "\n----------------\nTesting synthetic with local ready queues\n";
+    static constexpr int NUM_WORKLOADS = 2;
+    static constexpr int NUM_INPUTS_PER_WORKLOAD = 4;
+    static constexpr int NUM_OUTPUTS = 3;
+    static constexpr int NUM_INSTRS = 12;
+    static constexpr memref_tid_t TID_BASE = 100;
+    // The second workload is bound to the last output.
+    static constexpr scheduler_t::output_ordinal_t BOUND_OUTPUT = NUM_OUTPUTS - 1;
+    std::vector<scheduler_t::input_workload_t> sched_inputs;
+    for (int workload_idx = 0; workload_idx < NUM_WORKLOADS; workload_idx++) {
+        std::vector<scheduler_t::input_reader_t> readers;
+        for (int input_idx = 0; input_idx < NUM_INPUTS_PER_WORKLOAD; input_idx++) {
+            memref_tid_t tid =
+                TID_BASE + workload_idx * NUM_INPUTS_PER_WORKLOAD + input_idx;
+            std::vector<trace_entry_t> inputs;
+            inputs.push_back(make_thread(tid));
+            inputs.push_back(make_pid(1));
+            for (int instr_idx = 0; instr_idx < NUM_INSTRS; instr_idx++) {
+                if (instr_idx % 3 == 0)
+                    inputs.push_back(make_timestamp(10 * (instr_idx + 1) + input_idx));
+                inputs.push_back(make_instr(42 + instr_idx * 4));
+            }
+            inputs.push_back(make_exit(tid));
+            readers.emplace_back(
+                std::unique_ptr<mock_reader_t>(new mock_reader_t(inputs)),
+                std::unique_ptr<mock_reader_t>(new mock_reader_t()), tid);
+        }
+        sched_inputs.emplace_back(std::move(readers));
+        if (workload_idx == 1) {
+            std::set<scheduler_t::output_ordinal_t> cores;
+            cores.insert(BOUND_OUTPUT);
+            sched_inputs.back().thread_modifiers.emplace_back(cores);
+        }
+    }
+    scheduler_t::scheduler_options_t sched_ops(
+        scheduler_t::MAP_TO_ANY_OUTPUT, scheduler_t::DEPENDENCY_TIMESTAMPS,
+        scheduler_t::SCHEDULER_LOCAL_READY_QUEUES, /*verbosity=*/3);
+    sched_ops.quantum_duration = 3;
+    scheduler_t scheduler;
+    if (scheduler.init(sched_inputs, NUM_OUTPUTS, sched_ops) !=
+        scheduler_t::STATUS_SUCCESS)
+        assert(false);
+    std::vector<std::string> sched_as_string =
+        run_lockstep_simulation(scheduler, NUM_OUTPUTS, TID_BASE);
+    // The exact interleaving depends on which queue each input lands in, so we
+    // check that every instruction ran exactly once, that the bindings were
+    // honored, and that the unbound outputs stole work from each other.
+    std::vector<int> instr_count(NUM_WORKLOADS * NUM_INPUTS_PER_WORKLOAD, 0);
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        std::cerr << "cpu #" << i << " schedule: " << sched_as_string[i] << "\n";
+        std::set<char> seen;
+        for (char c : sched_as_string[i]) {
+            if (c < 'A' || c > 'Z')
+                continue;
+            seen.insert(c);
+            ++instr_count[c - 'A'];
+            if (c - 'A' >= NUM_INPUTS_PER_WORKLOAD)
+                assert(i == BOUND_OUTPUT);
+        }
+        if (i != BOUND_OUTPUT)
+            assert(seen.size() > 1);
+    }
+    for (int count : instr_count)
+        assert(count == NUM_INSTRS);
+}
+
 static void
 test_speculation()
 {
@@ -2974,6 +3199,8 @@ test_main(int argc, const char *argv[])
 
     test_serial();
     test_parallel();
+    test_batch();
+    test_batch_input_switch();
     test_param_checks();
     test_regions();
     test_only_threads();
@@ -2986,6 +3213,7 @@ test_main(int argc, const char *argv[])
     test_synthetic_with_bindings_weighted();
     test_synthetic_with_syscalls();
     test_synthetic_multi_threaded(argv[1]);
+    test_synthetic_with_local_queues();
     test_speculation();
     test_replay();
     test_replay_multi_threaded(argv[1]);
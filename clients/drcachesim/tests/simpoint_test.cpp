@@ -0,0 +1,186 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Unit tests for the simpoint tool. */
+
+#include <stdint.h>
+
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+#undef NDEBUG
+#include <assert.h>
+
+#include "../tools/simpoint.h"
+#include "../tools/simpoint_create.h"
+#include "../common/memref.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+static constexpr uint64_t INTERVAL_INSTRS = 1000;
+
+static memref_t
+generate_instr(memref_tid_t tid, addr_t pc, bool branch)
+{
+    memref_t memref;
+    memref.instr.type = branch ? TRACE_TYPE_INSTR_CONDITIONAL_JUMP : TRACE_TYPE_INSTR;
+    memref.instr.pid = 1;
+    memref.instr.tid = tid;
+    memref.instr.addr = pc;
+    memref.instr.size = 4;
+    memref.instr.indirect_branch_target = 0;
+    return memref;
+}
+
+// Returns an interval of a loop over blocks of 10 instructions starting at
+// "base", with a load after each branch to check that data is ignored.
+static std::vector<memref_t>
+generate_interval(memref_tid_t tid, addr_t base, int num_blocks)
+{
+    std::vector<memref_t> memrefs;
+    for (uint64_t i = 0; i < INTERVAL_INSTRS; ++i) {
+        int block = static_cast<int>(i / 10) % num_blocks;
+        bool branch = i % 10 == 9;
+        memrefs.push_back(generate_instr(tid, base + block * 0x100 + (i % 10) * 4, branch));
+        if (branch) {
+            memref_t load = memrefs.back();
+            load.data.type = TRACE_TYPE_READ;
+            load.data.addr = 0x100000 + i;
+            memrefs.push_back(load);
+        }
+    }
+    return memrefs;
+}
+
+// Returns a thread alternating between two phases that run different code, in
+// runs of "run" intervals, followed by a short tail.
+static std::vector<memref_t>
+generate_thread(memref_tid_t tid, int num_intervals, int run)
+{
+    std::vector<memref_t> memrefs;
+    for (int i = 0; i < num_intervals; ++i) {
+        std::vector<memref_t> interval = (i / run) % 2 == 0
+            ? generate_interval(tid, 0x10000, 5)
+            : generate_interval(tid, 0x80000, 7);
+        memrefs.insert(memrefs.end(), interval.begin(), interval.end());
+    }
+    for (int i = 0; i < 10; ++i)
+        memrefs.push_back(generate_instr(tid, 0x10000 + i * 4, false));
+    return memrefs;
+}
+
+// Two phases should give two clusters, each represented by an interval of its
+// own phase and weighted by its share of the intervals.
+void
+two_phase_test()
+{
+    std::cerr << "two_phase_test()\n";
+    simpoint_knobs_t knobs;
+    knobs.interval_instrs = INTERVAL_INSTRS;
+    knobs.max_clusters = 8;
+    // The first phase runs 12 of the 20 intervals.
+    std::vector<memref_t> memrefs = generate_thread(42, 20, 4);
+    std::unique_ptr<simpoint_t> tool(new simpoint_t(knobs));
+    assert(!!*tool);
+    for (const memref_t &memref : memrefs)
+        assert(tool->process_memref(memref));
+    std::vector<simpoint_t::representative_t> reps = tool->get_representatives();
+    assert(reps.size() == 2);
+    double total_weight = 0.;
+    for (const auto &rep : reps) {
+        assert(rep.tid == 42);
+        assert(rep.stop_instruction - rep.start_instruction + 1 == INTERVAL_INSTRS);
+        assert((rep.start_instruction - 1) % INTERVAL_INSTRS == 0);
+        int interval = static_cast<int>((rep.start_instruction - 1) / INTERVAL_INSTRS);
+        bool first_phase = (interval / 4) % 2 == 0;
+        assert(std::abs(rep.weight - (first_phase ? 0.6 : 0.4)) < 1e-9);
+        total_weight += rep.weight;
+    }
+    assert(std::abs(total_weight - 1.0) < 1e-9);
+    assert(reps[0].start_instruction < reps[1].start_instruction);
+
+    // The regions are in the form the scheduler takes.
+    std::vector<scheduler_t::input_thread_info_t> regions =
+        tool->get_regions_of_interest();
+    assert(regions.size() == 1);
+    assert(regions[0].tids.size() == 1 && regions[0].tids[0] == 42);
+    assert(regions[0].regions_of_interest.size() == 2);
+    for (size_t i = 0; i < reps.size(); ++i) {
+        assert(regions[0].regions_of_interest[i].start_instruction ==
+               reps[i].start_instruction);
+        assert(regions[0].regions_of_interest[i].stop_instruction ==
+               reps[i].stop_instruction);
+    }
+}
+
+// A single phase needs a single cluster, and parallel shards are combined.
+void
+parallel_test()
+{
+    std::cerr << "parallel_test()\n";
+    simpoint_knobs_t knobs;
+    knobs.interval_instrs = INTERVAL_INSTRS;
+    std::unique_ptr<simpoint_t> tool(new simpoint_t(knobs));
+    assert(tool->initialize_shard_type(SHARD_BY_CORE) != "");
+    assert(tool->initialize_shard_type(SHARD_BY_THREAD) == "");
+    void *shards[2];
+    std::vector<memref_t> memrefs[2];
+    for (int i = 0; i < 2; ++i) {
+        shards[i] = tool->parallel_shard_init(i, nullptr);
+        // The run length exceeds the interval count, so each thread has one phase.
+        memrefs[i] = generate_thread(10 + i, 6, 100);
+    }
+    for (int i = 0; i < 2; ++i) {
+        for (const memref_t &memref : memrefs[i])
+            assert(tool->parallel_shard_memref(shards[i], memref));
+        assert(tool->parallel_shard_exit(shards[i]));
+    }
+    std::vector<simpoint_t::representative_t> reps = tool->get_representatives();
+    assert(reps.size() == 1);
+    assert(std::abs(reps[0].weight - 1.0) < 1e-9);
+    assert(reps[0].tid == 10 || reps[0].tid == 11);
+    assert(tool->get_regions_of_interest().size() == 1);
+}
+
+int
+test_main(int argc, const char *argv[])
+{
+    two_phase_test();
+    parallel_test();
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -166,9 +166,12 @@ private:
 class test_analyzer_t : public analyzer_t {
 public:
     test_analyzer_t(const std::vector<memref_t> &refs, analysis_tool_t **tools,
-                    int num_tools, bool parallel, uint64_t interval_microseconds)
+                    int num_tools, bool parallel, uint64_t interval_microseconds,
+                    size_t shard_count = 0)
         : analyzer_t()
     {
+        // There is no scheduler to count the inputs for interval streaming.
+        interval_stream_shard_count_ = shard_count;
         num_tools_ = num_tools;
         tools_ = tools;
         parallel_ = parallel;
@@ -360,6 +363,7 @@ public:
         : seen_memrefs_(0)
         , expected_state_snapshots_(expected_state_snapshots)
         , outstanding_snapshots_(0)
+        , generated_snapshots_(0)
         , combine_only_active_shards_(combine_only_active_shards)
     {
     }
@@ -378,6 +382,7 @@ public:
         snapshot->component_intervals.push_back(
             { /*tid=*/0, seen_memrefs_, interval_id });
         ++outstanding_snapshots_;
+        ++generated_snapshots_;
         return snapshot;
     }
     bool
@@ -432,6 +437,7 @@ public:
         snapshot->component_intervals.push_back(
             { shard->tid, shard->seen_memrefs, interval_id });
         ++outstanding_snapshots_;
+        ++generated_snapshots_;
         return snapshot;
     }
     analysis_tool_t::interval_state_snapshot_t *
@@ -515,11 +521,17 @@ public:
     {
         return outstanding_snapshots_;
     }
+    int
+    get_generated_snapshot_count() const
+    {
+        return generated_snapshots_;
+    }
 
 private:
     int seen_memrefs_;
     std::vector<recorded_snapshot_t> expected_state_snapshots_;
     int outstanding_snapshots_;
+    int generated_snapshots_;
     bool combine_only_active_shards_;
 
     // Data tracked per shard.
@@ -533,11 +545,10 @@ private:
     static constexpr memref_tid_t kInvalidTid = -1;
 };
 
-static bool
-test_non_zero_interval(bool parallel, bool combine_only_active_shards = true)
+static std::vector<memref_t>
+make_interval_test_refs()
 {
-    constexpr uint64_t kIntervalMicroseconds = 100;
-    std::vector<memref_t> refs = {
+    return {
         // Trace for a single worker which has two constituent shards. (scheduler_t
         // does not guarantee that workers will process shards one after the other.)
         // Expected active interval_id: tid_51_local | tid_52_local | whole_trace
@@ -562,7 +573,11 @@ test_non_zero_interval(bool parallel, bool combine_only_active_shards = true)
         gen_instr(52, 20016),                             // _ | 6 | 7
         gen_exit(52)                                      // _ | 6 | 7
     };
+}
 
+static std::vector<test_analysis_tool_t::recorded_snapshot_t>
+make_expected_snapshots(bool parallel, bool combine_only_active_shards)
+{
     std::vector<test_analysis_tool_t::recorded_snapshot_t> expected_state_snapshots;
     if (!parallel) {
         // Each whole trace interval is made up of only one snapshot, the
@@ -611,6 +626,16 @@ test_non_zero_interval(bool parallel, bool combine_only_active_shards = true)
                                                       { { 51, 9, 6 }, { 52, 11, 6 } })
         };
     }
+    return expected_state_snapshots;
+}
+
+static bool
+test_non_zero_interval(bool parallel, bool combine_only_active_shards = true)
+{
+    constexpr uint64_t kIntervalMicroseconds = 100;
+    std::vector<memref_t> refs = make_interval_test_refs();
+    std::vector<test_analysis_tool_t::recorded_snapshot_t> expected_state_snapshots =
+        make_expected_snapshots(parallel, combine_only_active_shards);
     std::vector<analysis_tool_t *> tools;
     auto test_analysis_tool = std::unique_ptr<test_analysis_tool_t>(
         new test_analysis_tool_t(expected_state_snapshots, combine_only_active_shards));
@@ -654,11 +679,78 @@ test_non_zero_interval(bool parallel, bool combine_only_active_shards = true)
     return true;
 }
 
+// Streams the whole-trace intervals to a sink as they complete, which should yield the
+// same intervals as merging them all at the end.
+static bool
+test_streamed_intervals(bool parallel, bool combine_only_active_shards = true)
+{
+    constexpr uint64_t kIntervalMicroseconds = 100;
+    std::vector<memref_t> refs = make_interval_test_refs();
+    test_analysis_tool_t test_analysis_tool(
+        make_expected_snapshots(parallel, combine_only_active_shards),
+        combine_only_active_shards);
+    dummy_analysis_tool_t dummy_analysis_tool;
+    std::vector<analysis_tool_t *> tools = { &test_analysis_tool,
+                                             &dummy_analysis_tool };
+    test_analyzer_t test_analyzer(refs, &tools[0], (int)tools.size(), parallel,
+                                  kIntervalMicroseconds, parallel ? 2 : 0);
+    std::vector<test_analysis_tool_t::recorded_snapshot_t> streamed;
+    int generated_at_first_stream = -1;
+    int max_outstanding = 0;
+    bool sink_ok = true;
+    test_analyzer.set_interval_sink(
+        [&](int tool_idx, const analysis_tool_t::interval_state_snapshot_t *snapshot,
+            const analysis_tool_t::interval_state_snapshot_t *prev_snapshot) {
+            // The dummy tool never produces snapshots.
+            if (tool_idx != 0)
+                sink_ok = false;
+            auto *recorded =
+                dynamic_cast<const test_analysis_tool_t::recorded_snapshot_t *>(
+                    snapshot);
+            if ((prev_snapshot == nullptr) != streamed.empty() ||
+                (prev_snapshot != nullptr &&
+                 prev_snapshot->interval_id != streamed.back().interval_id))
+                sink_ok = false;
+            if (generated_at_first_stream < 0) {
+                generated_at_first_stream =
+                    test_analysis_tool.get_generated_snapshot_count();
+            }
+            max_outstanding = std::max(
+                max_outstanding, test_analysis_tool.get_outstanding_snapshot_count());
+            streamed.push_back(*recorded);
+            return true;
+        });
+    CHECK(test_analyzer.run(), "failed to run streaming test_analyzer");
+    CHECK(sink_ok, "unexpected sink arguments");
+    std::vector<analysis_tool_t::interval_state_snapshot_t *> streamed_ptrs;
+    for (auto &snapshot : streamed)
+        streamed_ptrs.push_back(&snapshot);
+    CHECK(test_analysis_tool.print_interval_results(streamed_ptrs),
+          "streamed intervals differ from the merged ones");
+    CHECK(test_analysis_tool.get_outstanding_snapshot_count() == 0,
+          "failed to release all streamed snapshots");
+    // Intervals must be published while the trace is still being analyzed, with only
+    // a few snapshots alive at once: the latest one per shard, one not yet merged,
+    // and the current and previous whole-trace ones.  Merging at the end instead
+    // holds all 8 shard snapshots first.
+    CHECK(generated_at_first_stream > 0 &&
+              generated_at_first_stream <
+                  test_analysis_tool.get_generated_snapshot_count(),
+          "intervals were not streamed incrementally");
+    CHECK(max_outstanding <= 5, "too many snapshots held while streaming");
+    fprintf(stderr,
+            "test_streamed_intervals done for parallel=%d, "
+            "combine_only_active_shards=%d\n",
+            parallel, combine_only_active_shards);
+    return true;
+}
+
 int
 test_main(int argc, const char *argv[])
 {
     if (!test_non_zero_interval(false) || !test_non_zero_interval(true, true) ||
-        !test_non_zero_interval(true, false))
+        !test_non_zero_interval(true, false) || !test_streamed_intervals(false) ||
+        !test_streamed_intervals(true, true) || !test_streamed_intervals(true, false))
         return 1;
     fprintf(stderr, "All done!\n");
     return 0;
@@ -0,0 +1,370 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Unit tests for the frame-indexed zstd archives written by zstd_ostream_t and
+ * read by zstd_istream_t and zstd_file_reader_t.
+ */
+
+#include <stdint.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "file_reader.h"
+#include "memref.h"
+#include "mock_reader.h"
+#include "record_file_reader.h"
+#include "trace_entry.h"
+#include "zstd_file_reader.h"
+#include "zstd_istream.h"
+#include "zstd_ostream.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+#ifndef HAS_ZSTD
+#    error zstd is required for this test
+#endif
+
+#define CHECK(cond, msg, ...)             \
+    do {                                  \
+        if (!(cond)) {                    \
+            fprintf(stderr, "%s\n", msg); \
+            return false;                 \
+        }                                 \
+    } while (0)
+
+namespace {
+
+struct component_t {
+    std::string name;
+    std::string data;
+};
+
+std::vector<component_t>
+make_components()
+{
+    // Spanning several frames, with an empty component in the middle.
+    std::string large;
+    for (uint32_t i = 0; large.size() < 3 * ZSTD_ARCHIVE_FRAME_BYTES / 2; ++i)
+        large += std::to_string(i * 2654435761U) + ",";
+    std::string exact(ZSTD_ARCHIVE_FRAME_BYTES, 'x');
+    return { { "first", "first component" },
+             { "large", large },
+             { "empty", "" },
+             { "exact", exact },
+             { "last", "last component" } };
+}
+
+std::string
+read_all(std::istream &in)
+{
+    std::string res;
+    char buf[1000];
+    while (in.read(buf, sizeof(buf)) || in.gcount() > 0)
+        res.append(buf, static_cast<size_t>(in.gcount()));
+    return res;
+}
+
+bool
+test_archive(const std::string &path)
+{
+    std::vector<component_t> components = make_components();
+    std::string all;
+    {
+        zstd_ostream_t out(path);
+        CHECK(out.good(), "failed to open output");
+        for (const auto &component : components) {
+            CHECK(out.open_new_component(component.name).empty(),
+                  "failed to open component");
+            out.write(component.data.data(), component.data.size());
+            all += component.data;
+        }
+        CHECK(out.good(), "failed to write output");
+    }
+    zstd_istream_t in(path);
+    CHECK(in.good(), "failed to open input");
+    CHECK(in.num_components() == components.size(), "wrong component count");
+    CHECK(read_all(in) == all, "sequential read mismatch");
+    // Jump around, including backward, in the middle of reading.
+    for (size_t i : { 3, 1, 4, 0, 2, 1 }) {
+        std::string rest;
+        for (size_t j = i; j < components.size(); ++j)
+            rest += components[j].data;
+        CHECK(in.open_component(components[i].name).empty(), "failed to open by name");
+        char c;
+        if (!rest.empty()) {
+            CHECK(in.get(c) && c == rest[0], "wrong first character");
+            CHECK(in.seek_component(i), "failed to open by index");
+        }
+        CHECK(read_all(in) == rest, "read after seek mismatch");
+    }
+    CHECK(!in.open_component("missing").empty(), "missing component should fail");
+    CHECK(!in.seek_component(components.size()), "bad index should fail");
+
+    // Standard zstd tools must be able to decode the file: check that it is a
+    // sequence of plain frames followed by a skippable frame.
+    std::ifstream raw(path, std::ifstream::binary);
+    std::string contents = read_all(raw);
+    uint32_t magic;
+    contents.copy(reinterpret_cast<char *>(&magic), sizeof(magic));
+    CHECK(magic == 0xFD2FB528, "not a zstd frame");
+    CHECK(ZSTD_getFrameContentSize(contents.data(), contents.size()) ==
+              components[0].data.size(),
+          "wrong first frame size");
+
+    // Corrupted or truncated files must be rejected.
+    {
+        std::ofstream truncated(path, std::ofstream::binary);
+        truncated.write(contents.data(), contents.size() - 1);
+    }
+    zstd_istream_t bad(path);
+    CHECK(!bad.good(), "truncated archive should be rejected");
+    return true;
+}
+
+constexpr uint64_t CHUNK_INSTRS = 10;
+constexpr uint64_t NUM_INSTRS = 95;
+constexpr memref_tid_t TID = 42;
+// The count of visible header markers: version, filetype, cache line size,
+// chunk instruction count, page size, timestamp, and cpu.
+constexpr uint64_t HEADER_RECORDS = 7;
+
+// Writes a trace laid out the way raw2trace chunks its output, as a zstd archive
+// with one component per chunk and as an uncompressed file.
+bool
+write_chunked_trace(const std::string &path, const std::string &plain_path)
+{
+    zstd_ostream_t out(path);
+    std::ofstream plain(plain_path, std::ofstream::binary);
+    CHECK(out.good() && plain.good(), "failed to open output");
+    CHECK(out.open_new_component("chunk.0000").empty(), "failed to start chunk");
+    trace_entry_t header = {};
+    header.type = TRACE_TYPE_HEADER;
+    header.addr = TRACE_ENTRY_VERSION;
+    std::vector<trace_entry_t> entries = {
+        header,
+        make_thread(TID),
+        make_pid(1),
+        make_version(TRACE_ENTRY_VERSION),
+        make_marker(TRACE_MARKER_TYPE_FILETYPE, OFFLINE_FILE_TYPE_DEFAULT),
+        make_marker(TRACE_MARKER_TYPE_CACHE_LINE_SIZE, 64),
+        make_marker(TRACE_MARKER_TYPE_CHUNK_INSTR_COUNT, CHUNK_INSTRS),
+        make_marker(TRACE_MARKER_TYPE_PAGE_SIZE, 4096),
+        make_timestamp(1),
+        make_marker(TRACE_MARKER_TYPE_CPU_ID, 0),
+    };
+    auto flush = [&]() {
+        out.write(reinterpret_cast<const char *>(entries.data()),
+                  entries.size() * sizeof(entries[0]));
+        plain.write(reinterpret_cast<const char *>(entries.data()),
+                    entries.size() * sizeof(entries[0]));
+        entries.clear();
+    };
+    for (uint64_t i = 0; i < NUM_INSTRS; ++i) {
+        uint64_t chunk = i / CHUNK_INSTRS;
+        if (i > 0 && i % CHUNK_INSTRS == 0) {
+            entries.push_back(make_marker(TRACE_MARKER_TYPE_CHUNK_FOOTER, chunk - 1));
+            flush();
+            CHECK(out.open_new_component("chunk").empty(), "failed to start chunk");
+            // Prior chunks hold two records per instruction plus a timestamp, a
+            // cpu, and a footer.
+            entries.push_back(make_marker(TRACE_MARKER_TYPE_RECORD_ORDINAL,
+                                          HEADER_RECORDS + 2 * i + 3 * chunk));
+            entries.push_back(make_timestamp(1000 + (chunk - 1) * 10));
+            entries.push_back(make_marker(TRACE_MARKER_TYPE_CPU_ID, chunk));
+        }
+        if (i % CHUNK_INSTRS == CHUNK_INSTRS / 2) {
+            entries.push_back(make_timestamp(1000 + chunk * 10));
+            entries.push_back(make_marker(TRACE_MARKER_TYPE_CPU_ID, chunk + 1));
+        }
+        entries.push_back(make_instr(0x1000 + i));
+        trace_entry_t load = make_instr(0x8000 + i, TRACE_TYPE_READ);
+        load.size = 4;
+        entries.push_back(load);
+    }
+    entries.push_back(make_exit(TID));
+    entries.push_back(make_footer());
+    flush();
+    CHECK(out.good() && plain.good(), "failed to write output");
+    return true;
+}
+
+struct position_t {
+    bool at_eof;
+    uint64_t last_timestamp;
+    // The ordinals at the first instruction after the skip.
+    uint64_t instr_ordinal;
+    uint64_t record_ordinal;
+    std::vector<memref_t> next;
+};
+
+// Skips "first" and then "second" instructions and returns where we ended up
+// and the next few records.
+template <typename T>
+bool
+skip_and_read(const std::string &path, uint64_t first, uint64_t second,
+              position_t *pos)
+{
+    std::unique_ptr<reader_t> reader(new file_reader_t<T>(path));
+    std::unique_ptr<reader_t> reader_end(new file_reader_t<T>());
+    CHECK(reader->init(), "failed to initialize reader");
+    reader->skip_instructions(first);
+    if (*reader != *reader_end && second > 0) {
+        // Read a little before the second skip.
+        ++(*reader);
+        reader->skip_instructions(second);
+    }
+    pos->at_eof = *reader == *reader_end;
+    pos->last_timestamp = reader->get_last_timestamp();
+    pos->instr_ordinal = 0;
+    pos->record_ordinal = 0;
+    pos->next.clear();
+    for (int i = 0; i < 6 && *reader != *reader_end; ++i, ++(*reader)) {
+        const memref_t &memref = **reader;
+        if (pos->instr_ordinal == 0 && type_is_instr(memref.instr.type)) {
+            pos->instr_ordinal = reader->get_instruction_ordinal();
+            pos->record_ordinal = reader->get_record_ordinal();
+        }
+        pos->next.push_back(memref);
+    }
+    return true;
+}
+
+// Returns the record ordinal of each instruction in a full linear read.
+bool
+read_instr_record_ordinals(const std::string &path, std::vector<uint64_t> *ordinals)
+{
+    std::unique_ptr<reader_t> reader(new zstd_file_reader_t(path));
+    std::unique_ptr<reader_t> reader_end(new zstd_file_reader_t());
+    CHECK(reader->init(), "failed to initialize reader");
+    // Instruction ordinals start at 1.
+    ordinals->assign(1, 0);
+    for (; *reader != *reader_end; ++(*reader)) {
+        if (type_is_instr((**reader).instr.type))
+            ordinals->push_back(reader->get_record_ordinal());
+    }
+    CHECK(ordinals->size() == NUM_INSTRS + 1, "wrong instruction count");
+    return true;
+}
+
+bool
+same_memref(const memref_t &a, const memref_t &b)
+{
+    if (a.marker.type != b.marker.type)
+        return false;
+    if (a.marker.type == TRACE_TYPE_MARKER) {
+        return a.marker.marker_type == b.marker.marker_type &&
+            a.marker.marker_value == b.marker.marker_value;
+    }
+    if (type_is_instr(a.instr.type)) {
+        return a.instr.addr == b.instr.addr && a.instr.size == b.instr.size &&
+            a.instr.tid == b.instr.tid;
+    }
+    return a.data.addr == b.data.addr && a.data.pc == b.data.pc &&
+        a.data.tid == b.data.tid;
+}
+
+// Compares skipping by jumping to a chunk with skipping by a linear walk of
+// the uncompressed copy.  Record ordinals are compared to an unskipped read.
+bool
+test_skip(const std::string &path, const std::string &plain_path)
+{
+    std::vector<uint64_t> record_ordinals;
+    if (!read_instr_record_ordinals(path, &record_ordinals))
+        return false;
+    for (uint64_t second : { 0, 3, 17 }) {
+        for (uint64_t first = 0; first < NUM_INSTRS + 3; ++first) {
+            position_t jumped, linear;
+            if (!skip_and_read<zstd_reader_t>(path, first, second, &jumped) ||
+                !skip_and_read<std::ifstream *>(plain_path, first, second, &linear))
+                return false;
+            CHECK(jumped.at_eof == linear.at_eof, "eof mismatch");
+            CHECK(jumped.last_timestamp == linear.last_timestamp, "timestamp mismatch");
+            CHECK(jumped.instr_ordinal == linear.instr_ordinal, "instr ordinal mismatch");
+            CHECK(jumped.instr_ordinal == 0 ||
+                      jumped.record_ordinal ==
+                          record_ordinals[static_cast<size_t>(jumped.instr_ordinal)],
+                  "record ordinal mismatch");
+            CHECK(jumped.next.size() == linear.next.size(), "record count mismatch");
+            for (size_t i = 0; i < jumped.next.size(); ++i)
+                CHECK(same_memref(jumped.next[i], linear.next[i]), "record mismatch");
+        }
+    }
+    return true;
+}
+
+bool
+test_record_reader(const std::string &path, const std::string &plain_path)
+{
+    zstd_record_file_reader_t reader(path);
+    zstd_record_file_reader_t reader_end;
+    CHECK(reader.init(), "failed to initialize record reader");
+    std::ifstream plain(plain_path, std::ifstream::binary);
+    trace_entry_t expect;
+    for (; reader != reader_end; ++reader) {
+        CHECK(plain.read(reinterpret_cast<char *>(&expect), sizeof(expect)),
+              "too many records");
+        CHECK(memcmp(&*reader, &expect, sizeof(expect)) == 0, "record mismatch");
+    }
+    CHECK(!plain.read(reinterpret_cast<char *>(&expect), sizeof(expect)),
+          "too few records");
+    return true;
+}
+
+} // namespace
+
+int
+test_main(int argc, const char *argv[])
+{
+    // We use the current directory as we have no temp dir parameter.
+    const std::string archive_path = "zstd_archive_unit_tests.zst";
+    const std::string path = "zstd_archive_unit_tests.trace.zst";
+    const std::string plain_path = "zstd_archive_unit_tests.trace";
+    bool res = test_archive(archive_path) && write_chunked_trace(path, plain_path) &&
+        test_skip(path, plain_path) && test_record_reader(path, plain_path);
+    std::remove(archive_path.c_str());
+    std::remove(path.c_str());
+    std::remove(plain_path.c_str());
+    if (!res)
+        return 1;
+    std::cerr << "All done!\n";
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
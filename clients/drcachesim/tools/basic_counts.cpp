@@ -49,6 +49,7 @@
 #include <vector>
 
 #include "analysis_tool.h"
+#include "flat_addr_map.h"
 #include "memref.h"
 #include "trace_entry.h"
 #include "utils.h"
@@ -131,7 +132,7 @@ back_align(addr_t addr, addr_t align)
     return addr & ~(align - 1);
 }
 
-void update_map_from_access(std::unordered_map<addr_t, uint64_t> * m, addr_t start_addr, uint64_t size, uint64_t line_size, uint64_t line_size_bits_) {
+void update_map_from_access(flat_addr_map_t<uint64_t> * m, addr_t start_addr, uint64_t size, uint64_t line_size, uint64_t line_size_bits_) {
         for (addr_t addr = back_align(start_addr, line_size);
             addr < start_addr + size && addr < addr + line_size /* overflow */;
             addr += line_size) {
@@ -161,6 +162,12 @@ basic_counts_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
         }
         counters-> addr_loads.clear();
         counters-> addr_stores.clear();
+    } else if (memref.marker.type == TRACE_TYPE_MARKER &&
+               memref.marker.marker_type == TRACE_MARKER_TYPE_SAMPLE_WINDOW) {
+        ++counters->sample_windows;
+    } else if (memref.marker.type == TRACE_TYPE_MARKER &&
+               memref.marker.marker_type == TRACE_MARKER_TYPE_SAMPLE_SKIP) {
+        counters->sample_skipped_instrs += memref.marker.marker_value;
     }
     return true;
 }
@@ -199,56 +206,59 @@ basic_counts_t::cmp_threads(const std::pair<memref_tid_t, per_shard_t *> &l,
 
 void
 basic_counts_t::print_counters(const counters_t &counters, const std::string &prefix,
-                               bool for_kernel_trace)
+                               bool for_kernel_trace, std::ostream &out)
 {
-    std::cerr << std::setw(12) << counters.instrs << prefix
-              << " (fetched) instructions\n";
+    out << std::setw(12) << counters.instrs << prefix << " (fetched) instructions\n";
     if (counters.is_tracking_unique_pc_addrs()) {
-        std::cerr << std::setw(12) << counters.unique_pc_addrs.size() << prefix
-                  << " unique (fetched) instructions\n";
+        out << std::setw(12) << counters.unique_pc_addrs.size() << prefix
+            << " unique (fetched) instructions\n";
     }
-    std::cerr << std::setw(12) << counters.instrs_nofetch << prefix
-              << " non-fetched instructions\n";
+    out << std::setw(12) << counters.instrs_nofetch << prefix
+        << " non-fetched instructions\n";
     if (for_kernel_trace) {
-        std::cerr << std::setw(12) << counters.user_instrs << prefix
-                  << " userspace instructions\n";
-        std::cerr << std::setw(12) << counters.kernel_instrs << prefix
-                  << " kernel instructions\n";
+        out << std::setw(12) << counters.user_instrs << prefix
+            << " userspace instructions\n";
+        out << std::setw(12) << counters.kernel_instrs << prefix
+            << " kernel instructions\n";
     }
-    std::cerr << std::setw(12) << counters.prefetches << prefix << " prefetches\n";
-    std::cerr << std::setw(12) << counters.loads << prefix << " data loads\n";
-    std::cerr << std::setw(12) << counters.stores << prefix << " data stores\n";
-    std::cerr << std::setw(12) << counters.icache_flushes << prefix
-              << " icache flushes\n";
-    std::cerr << std::setw(12) << counters.dcache_flushes << prefix
-              << " dcache flushes\n";
+    out << std::setw(12) << counters.prefetches << prefix << " prefetches\n";
+    out << std::setw(12) << counters.loads << prefix << " data loads\n";
+    out << std::setw(12) << counters.stores << prefix << " data stores\n";
+    out << std::setw(12) << counters.icache_flushes << prefix << " icache flushes\n";
+    out << std::setw(12) << counters.dcache_flushes << prefix << " dcache flushes\n";
     if (shard_type_ != SHARD_BY_THREAD || counters.unique_threads.size() > 1 ||
         prefix == TOTAL_COUNT_PREFIX) {
-        std::cerr << std::setw(12) << counters.unique_threads.size() << prefix
-                  << " threads\n";
+        out << std::setw(12) << counters.unique_threads.size() << prefix << " threads\n";
+    }
+    out << std::setw(12) << counters.sched_markers << prefix << " scheduling markers\n";
+    out << std::setw(12) << counters.xfer_markers << prefix << " transfer markers\n";
+    out << std::setw(12) << counters.func_id_markers << prefix
+        << " function id markers\n";
+    out << std::setw(12) << counters.func_retaddr_markers << prefix
+        << " function return address markers\n";
+    out << std::setw(12) << counters.func_arg_markers << prefix
+        << " function argument markers\n";
+    out << std::setw(12) << counters.func_retval_markers << prefix
+        << " function return value markers\n";
+    out << std::setw(12) << counters.phys_addr_markers << prefix
+        << " physical address + virtual address marker pairs\n";
+    out << std::setw(12) << counters.phys_unavail_markers << prefix
+        << " physical address unavailable markers\n";
+    out << std::setw(12) << counters.syscall_number_markers << prefix
+        << " system call number markers\n";
+    out << std::setw(12) << counters.syscall_blocking_markers << prefix
+        << " blocking system call markers\n";
+    out << std::setw(12) << counters.other_markers << prefix << " other markers\n";
+    out << std::setw(12) << counters.encodings << prefix << " encodings\n";
+    if (counters.sample_windows > 0 || counters.sample_skipped_instrs > 0) {
+        out << std::setw(12) << counters.sample_windows << prefix
+            << " sampling windows\n";
+        out << std::setw(12) << counters.sample_skipped_instrs << prefix
+            << " instructions removed by sampling\n";
+        // The kept counts scale by the same factor to estimate the whole trace.
+        out << std::setw(12) << counters.instrs + counters.sample_skipped_instrs
+            << prefix << " estimated unsampled instructions\n";
     }
-    std::cerr << std::setw(12) << counters.sched_markers << prefix
-              << " scheduling markers\n";
-    std::cerr << std::setw(12) << counters.xfer_markers << prefix
-              << " transfer markers\n";
-    std::cerr << std::setw(12) << counters.func_id_markers << prefix
-              << " function id markers\n";
-    std::cerr << std::setw(12) << counters.func_retaddr_markers << prefix
-              << " function return address markers\n";
-    std::cerr << std::setw(12) << counters.func_arg_markers << prefix
-              << " function argument markers\n";
-    std::cerr << std::setw(12) << counters.func_retval_markers << prefix
-              << " function return value markers\n";
-    std::cerr << std::setw(12) << counters.phys_addr_markers << prefix
-              << " physical address + virtual address marker pairs\n";
-    std::cerr << std::setw(12) << counters.phys_unavail_markers << prefix
-              << " physical address unavailable markers\n";
-    std::cerr << std::setw(12) << counters.syscall_number_markers << prefix
-              << " system call number markers\n";
-    std::cerr << std::setw(12) << counters.syscall_blocking_markers << prefix
-              << " blocking system call markers\n";
-    std::cerr << std::setw(12) << counters.other_markers << prefix << " other markers\n";
-    std::cerr << std::setw(12) << counters.encodings << prefix << " encodings\n";
 }
 
 bool
@@ -416,6 +426,21 @@ basic_counts_t::print_interval_results(
     return true;
 }
 
+bool
+basic_counts_t::print_interval_result(const interval_state_snapshot_t *snapshot_base,
+                                      const interval_state_snapshot_t *prev_snapshot,
+                                      std::ostream &out)
+{
+    auto *snapshot = dynamic_cast<const count_snapshot_t *>(snapshot_base);
+    out << "Interval #" << snapshot->interval_id << " ending at timestamp "
+        << snapshot->interval_end_timestamp << ":\n";
+    counters_t diff = snapshot->counters;
+    if (prev_snapshot != nullptr)
+        diff -= dynamic_cast<const count_snapshot_t *>(prev_snapshot)->counters;
+    print_counters(diff, " interval delta", /*for_kernel_trace=*/false, out);
+    return true;
+}
+
 bool
 basic_counts_t::release_interval_snapshot(
     analysis_tool_t::interval_state_snapshot_t *snapshot)
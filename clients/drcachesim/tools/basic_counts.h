@@ -35,6 +35,7 @@
 
 #include <stdint.h>
 
+#include <iostream>
 #include <mutex>
 #include <string>
 #include <unordered_map>
@@ -43,12 +44,13 @@
 #include <vector>
 
 #include "analysis_tool.h"
+#include "flat_addr_map.h"
 #include "memref.h"
 
 namespace dynamorio {
 namespace drmemtrace {
 
-class basic_counts_t : public analysis_tool_t {
+class basic_counts_t : public batched_analysis_tool_t<basic_counts_t> {
 public:
     basic_counts_t(unsigned int verbose);
     ~basic_counts_t() override;
@@ -83,6 +85,10 @@ public:
     print_interval_results(
         const std::vector<interval_state_snapshot_t *> &interval_snapshots) override;
     bool
+    print_interval_result(const interval_state_snapshot_t *snapshot,
+                          const interval_state_snapshot_t *prev_snapshot,
+                          std::ostream &out) override;
+    bool
     release_interval_snapshot(interval_state_snapshot_t *snapshot) override;
 
     // i#3068: We use the following struct to also export the counters.
@@ -114,10 +120,10 @@ public:
             icache_flushes += rhs.icache_flushes;
             dcache_flushes += rhs.dcache_flushes;
             encodings += rhs.encodings;
-            if (track_unique_pc_addrs) {
-                unique_pc_addrs.insert(rhs.unique_pc_addrs.begin(),
-                                       rhs.unique_pc_addrs.end());
-            }
+            sample_windows += rhs.sample_windows;
+            sample_skipped_instrs += rhs.sample_skipped_instrs;
+            if (track_unique_pc_addrs)
+                unique_pc_addrs.merge(rhs.unique_pc_addrs);
             unique_threads.insert(rhs.unique_threads.begin(), rhs.unique_threads.end());
             return *this;
         }
@@ -145,6 +151,8 @@ public:
             icache_flushes -= rhs.icache_flushes;
             dcache_flushes -= rhs.dcache_flushes;
             encodings -= rhs.encodings;
+            sample_windows -= rhs.sample_windows;
+            sample_skipped_instrs -= rhs.sample_skipped_instrs;
             for (const uint64_t addr : rhs.unique_pc_addrs) {
                 unique_pc_addrs.erase(addr);
             }
@@ -175,6 +183,8 @@ public:
                 other_markers == rhs.other_markers &&
                 icache_flushes == rhs.icache_flushes &&
                 dcache_flushes == rhs.dcache_flushes && encodings == rhs.encodings &&
+                sample_windows == rhs.sample_windows &&
+                sample_skipped_instrs == rhs.sample_skipped_instrs &&
                 unique_pc_addrs == rhs.unique_pc_addrs &&
                 unique_threads == rhs.unique_threads;
         }
@@ -201,11 +211,15 @@ public:
         // The encoding entries aren't exposed at the memref_t level, but
         // we use encoding_is_new as a proxy.
         int64_t encodings = 0;
-        std::unordered_set<uint64_t> unique_pc_addrs;
+        // From the #TRACE_MARKER_TYPE_SAMPLE_WINDOW and #TRACE_MARKER_TYPE_SAMPLE_SKIP
+        // markers of a sampled trace.
+        int64_t sample_windows = 0;
+        int64_t sample_skipped_instrs = 0;
+        flat_addr_set_t unique_pc_addrs;
         std::unordered_set<memref_tid_t> unique_threads;
         // TODO do we need to keep track of access sizes
-        std::unordered_map<addr_t, uint64_t> addr_loads;
-        std::unordered_map<addr_t, uint64_t> addr_stores;
+        flat_addr_map_t<uint64_t> addr_loads;
+        flat_addr_map_t<uint64_t> addr_stores;
 
         // Metadata for the counts. These are not used for the equality, increment,
         // or decrement operation, and must be set explicitly.
@@ -219,7 +233,8 @@ public:
         stop_tracking_unique_pc_addrs()
         {
             track_unique_pc_addrs = false;
-            unique_pc_addrs.clear();
+            // Release the memory rather than just emptying the set.
+            unique_pc_addrs = flat_addr_set_t();
         }
         bool
         is_tracking_unique_pc_addrs() const
@@ -273,7 +288,7 @@ protected:
                 const std::pair<memref_tid_t, per_shard_t *> &r);
     void
     print_counters(const counters_t &counters, const std::string &prefix,
-                   bool for_kernel_trace = false);
+                   bool for_kernel_trace = false, std::ostream &out = std::cerr);
     void
     compute_shard_interval_result(per_shard_t *shard, uint64_t interval_id);
 
@@ -82,12 +82,14 @@ is_any_instr_type(trace_type_t type)
 record_filter_t::record_filter_t(
     const std::string &output_dir,
     std::vector<std::unique_ptr<record_filter_func_t>> filters, uint64_t stop_timestamp,
-    unsigned int verbose)
+    unsigned int verbose, int write_threads)
     : output_dir_(output_dir)
     , filters_(std::move(filters))
     , stop_timestamp_(stop_timestamp)
     , verbosity_(verbose)
 {
+    if (write_threads > 0)
+        write_pool_.reset(new pipelined_write_pool_t(write_threads));
     UNUSED(verbosity_);
     UNUSED(output_prefix_);
 }
@@ -126,6 +128,11 @@ record_filter_t::parallel_shard_init_stream(int shard_index, void *worker_data,
 {
     auto per_shard = new per_shard_t;
     per_shard->writer = get_writer(per_shard, shard_stream);
+    if (per_shard->writer && write_pool_) {
+        VPRINT(this, 3, "Pipelining the writes for %s\n", per_shard->output_path.c_str());
+        per_shard->writer.reset(
+            new pipelined_ostream_t(std::move(per_shard->writer), write_pool_.get()));
+    }
     per_shard->shard_stream = shard_stream;
     per_shard->enabled = true;
     per_shard->input_entry_count = 0;
@@ -157,6 +164,13 @@ record_filter_t::parallel_shard_exit(void *shard_data)
         if (!filters_[i]->parallel_shard_exit(per_shard->filter_shard_data[i]))
             res = false;
     }
+    // Pipelined writes can fail after write_trace_entry() returned, so we check
+    // for any failure before closing.
+    if (per_shard->writer && !per_shard->writer->flush()) {
+        per_shard->error = "Failed to write to output file " + per_shard->output_path;
+        success_ = false;
+        res = false;
+    }
     // Destroy the writer since we do not need it anymore. This also makes sure
     // that data is written out to the file; curiously, a simple flush doesn't
     // do it.
@@ -267,6 +281,23 @@ record_filter_t::parallel_shard_memref(void *shard_data, const trace_entry_t &in
         per_shard->last_delayed_unit_header.clear();
     }
 
+    if (per_shard->enabled) {
+        for (int i = 0; i < static_cast<int>(filters_.size()); ++i) {
+            if (!filters_[i]->parallel_shard_insert(
+                    entry, per_shard->filter_shard_data[i], per_shard->inserted)) {
+                per_shard->error = "Filter function failed to insert entries " +
+                    filters_[i]->get_error_string();
+                success_ = false;
+                return false;
+            }
+        }
+        if (!per_shard->inserted.empty()) {
+            if (!write_trace_entries(per_shard, per_shard->inserted))
+                return false;
+            per_shard->inserted.clear();
+        }
+    }
+
     if (is_any_instr_type(static_cast<trace_type_t>(entry.type))) {
         // Output if we have encodings that haven't yet been output.
         if (!per_shard->last_encoding.empty()) {
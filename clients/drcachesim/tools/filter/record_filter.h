@@ -45,6 +45,7 @@
 #include "analysis_tool.h"
 #include "memref.h"
 #include "memtrace_stream.h"
+#include "pipelined_ostream.h"
 #include "trace_entry.h"
 
 namespace dynamorio {
@@ -55,6 +56,11 @@ namespace drmemtrace {
  * trace. Streams through each shard independenty and parallelly, and
  * writes the filtered version to the output directory with the same
  * base name. Serial mode is not yet supported.
+ *
+ * If \p write_threads is non-zero, the output of each shard is buffered and
+ * written (and thus compressed, for a compressed output) by a pool of that many
+ * threads, overlapping it with the filtering.  Otherwise each shard is written
+ * on the thread that filters it.
  */
 class record_filter_t : public record_analysis_tool_t {
 public:
@@ -93,6 +99,21 @@ public:
          */
         virtual bool
         parallel_shard_filter(trace_entry_t &entry, void *shard_data) = 0;
+        /**
+         * Invoked for each \p entry that all #record_filter_func_t chose to
+         * include in the result trace, other than the unit header markers and
+         * encodings whose output is deferred until an instruction is output.
+         * Any entries appended to \p inserted are written to the result trace
+         * right before \p entry (and before the encoding of \p entry, if any),
+         * which lets a filter annotate the result trace with markers of its own.
+         * \p shard_data is same as what was returned by parallel_shard_init().
+         */
+        virtual bool
+        parallel_shard_insert(const trace_entry_t &entry, void *shard_data,
+                              std::vector<trace_entry_t> &inserted)
+        {
+            return true;
+        }
         /**
          * Invoked when all #trace_entry_t in a shard have been processed
          * by parallel_shard_filter(). \p shard_data is same as what was
@@ -116,7 +137,8 @@ public:
 
     record_filter_t(const std::string &output_dir,
                     std::vector<std::unique_ptr<record_filter_func_t>> filters,
-                    uint64_t stop_timestamp, unsigned int verbose);
+                    uint64_t stop_timestamp, unsigned int verbose,
+                    int write_threads = 0);
     ~record_filter_t() override;
     bool
     process_memref(const trace_entry_t &entry) override;
@@ -143,6 +165,8 @@ protected:
         std::vector<trace_entry_t> last_delayed_unit_header;
         std::unordered_map<uint64_t, std::vector<trace_entry_t>> delayed_encodings;
         std::vector<trace_entry_t> last_encoding;
+        // Scratch space for parallel_shard_insert().
+        std::vector<trace_entry_t> inserted;
         uint64_t input_entry_count;
         uint64_t output_entry_count;
         memtrace_stream_t *shard_stream;
@@ -165,6 +189,8 @@ private:
     write_trace_entries(per_shard_t *shard, const std::vector<trace_entry_t> &entries);
 
     std::string output_dir_;
+    // Writes shard output off the worker threads when write_threads is non-zero.
+    std::unique_ptr<pipelined_write_pool_t> write_pool_;
     std::vector<std::unique_ptr<record_filter_func_t>> filters_;
     uint64_t stop_timestamp_;
     unsigned int verbosity_;
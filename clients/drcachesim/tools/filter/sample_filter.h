@@ -0,0 +1,221 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* sample_filter: keeps periodic or randomly placed windows of a trace. */
+
+#ifndef _SAMPLE_FILTER_H_
+#define _SAMPLE_FILTER_H_ 1
+
+#include "record_filter.h"
+#include "trace_entry.h"
+
+#include <stdint.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace dynamorio {
+namespace drmemtrace {
+
+/**
+ * Samples each shard: keeps detailed windows of \p window_instrs instructions,
+ * each preceded by \p warmup_instrs warmup instructions, and removes the
+ * instructions and data references in between.  The removed region before each
+ * warmup is \p skip_instrs instructions long, or if \p random_seed is non-zero
+ * a pseudo-random length averaging \p skip_instrs, which avoids aliasing with
+ * periodic program behavior.  Markers are kept.  The trace records the removed
+ * instruction counts in #TRACE_MARKER_TYPE_SAMPLE_SKIP markers and the window
+ * starts in #TRACE_MARKER_TYPE_SAMPLE_WINDOW markers, which lets analysis tools
+ * extrapolate their results to the whole trace.
+ */
+class sample_filter_t : public record_filter_t::record_filter_func_t {
+public:
+    sample_filter_t(uint64_t window_instrs, uint64_t skip_instrs, uint64_t warmup_instrs,
+                    uint64_t random_seed = 0)
+        : window_instrs_(window_instrs)
+        , skip_instrs_(skip_instrs)
+        , warmup_instrs_(warmup_instrs)
+        , random_seed_(random_seed)
+    {
+        if (window_instrs_ == 0)
+            error_string_ = "The sampling window must contain at least 1 instruction";
+    }
+    void *
+    parallel_shard_init(memtrace_stream_t *shard_stream,
+                        bool partial_trace_filter) override
+    {
+        per_shard_t *per_shard = new per_shard_t;
+        per_shard->rng.seed(random_seed_);
+        return per_shard;
+    }
+    bool
+    parallel_shard_filter(trace_entry_t &entry, void *shard_data) override
+    {
+        per_shard_t *per_shard = reinterpret_cast<per_shard_t *>(shard_data);
+        switch (entry.type) {
+        case TRACE_TYPE_MARKER:
+            if (entry.size == TRACE_MARKER_TYPE_FILETYPE)
+                entry.addr |= OFFLINE_FILE_TYPE_IFILTERED | OFFLINE_FILE_TYPE_DFILTERED;
+            return true;
+        case TRACE_TYPE_THREAD:
+            // Make the random skips of a thread independent of the shard order.
+            if (random_seed_ != 0)
+                per_shard->rng.seed(random_seed_ ^ entry.addr);
+            return true;
+        case TRACE_TYPE_HEADER:
+        case TRACE_TYPE_FOOTER:
+        case TRACE_TYPE_PID:
+        case TRACE_TYPE_THREAD_EXIT:
+        case TRACE_TYPE_ENCODING:
+            // Encodings are only output along with a kept instruction.
+            return true;
+        }
+        if (type_is_instr(static_cast<trace_type_t>(entry.type)) ||
+            entry.type == TRACE_TYPE_INSTR_MAYBE_FETCH) {
+            while (per_shard->phase_instrs_left == 0)
+                next_phase(per_shard);
+            --per_shard->phase_instrs_left;
+            if (per_shard->phase == PHASE_SKIP)
+                ++per_shard->skipped_instrs;
+        }
+        // Data references and non-fetched instructions follow the phase of the
+        // preceding instruction.
+        return per_shard->phase != PHASE_SKIP;
+    }
+    bool
+    parallel_shard_insert(const trace_entry_t &entry, void *shard_data,
+                          std::vector<trace_entry_t> &inserted) override
+    {
+        per_shard_t *per_shard = reinterpret_cast<per_shard_t *>(shard_data);
+        if (entry.type == TRACE_TYPE_THREAD_EXIT &&
+            (per_shard->pending_skip ||
+             (per_shard->phase == PHASE_SKIP && per_shard->skipped_instrs > 0))) {
+            add_marker(inserted, TRACE_MARKER_TYPE_SAMPLE_SKIP,
+                       per_shard->skipped_instrs);
+            per_shard->skipped_instrs = 0;
+            per_shard->pending_skip = false;
+        }
+        if (!type_is_instr(static_cast<trace_type_t>(entry.type)) &&
+            entry.type != TRACE_TYPE_INSTR_MAYBE_FETCH)
+            return true;
+        if (per_shard->pending_skip) {
+            add_marker(inserted, TRACE_MARKER_TYPE_SAMPLE_SKIP,
+                       per_shard->skipped_instrs);
+            per_shard->skipped_instrs = 0;
+            per_shard->pending_skip = false;
+        }
+        if (per_shard->pending_window) {
+            add_marker(inserted, TRACE_MARKER_TYPE_SAMPLE_WINDOW,
+                       per_shard->window_count - 1);
+            per_shard->pending_window = false;
+        }
+        return true;
+    }
+    bool
+    parallel_shard_exit(void *shard_data) override
+    {
+        per_shard_t *per_shard = reinterpret_cast<per_shard_t *>(shard_data);
+        delete per_shard;
+        return true;
+    }
+
+private:
+    enum phase_t {
+        PHASE_SKIP,
+        PHASE_WARMUP,
+        PHASE_WINDOW,
+    };
+    struct per_shard_t {
+        // The first instruction ends this empty window and starts the initial
+        // skipped region.
+        phase_t phase = PHASE_WINDOW;
+        uint64_t phase_instrs_left = 0;
+        uint64_t skipped_instrs = 0;
+        uint64_t window_count = 0;
+        // The markers to insert before the next output instruction.  If another
+        // filter removes that instruction they move on to the next one.
+        bool pending_skip = false;
+        bool pending_window = false;
+        std::mt19937_64 rng;
+    };
+
+    void
+    next_phase(per_shard_t *per_shard)
+    {
+        switch (per_shard->phase) {
+        case PHASE_SKIP:
+            per_shard->phase = PHASE_WARMUP;
+            per_shard->phase_instrs_left = warmup_instrs_;
+            // We record every skipped region, even an empty one, so tools can rely
+            // on each warmup starting with a marker.
+            per_shard->pending_skip = true;
+            break;
+        case PHASE_WARMUP:
+            per_shard->phase = PHASE_WINDOW;
+            per_shard->phase_instrs_left = window_instrs_;
+            ++per_shard->window_count;
+            per_shard->pending_window = true;
+            break;
+        case PHASE_WINDOW:
+            per_shard->phase = PHASE_SKIP;
+            if (random_seed_ != 0 && skip_instrs_ > 0) {
+                per_shard->phase_instrs_left =
+                    std::uniform_int_distribution<uint64_t>(0, 2 * skip_instrs_)(
+                        per_shard->rng);
+            } else
+                per_shard->phase_instrs_left = skip_instrs_;
+            break;
+        }
+    }
+
+    static void
+    add_marker(std::vector<trace_entry_t> &inserted, trace_marker_type_t type,
+               uint64_t value)
+    {
+        trace_entry_t marker;
+        marker.type = TRACE_TYPE_MARKER;
+        marker.size = static_cast<unsigned short>(type);
+        marker.addr = static_cast<addr_t>(value);
+        inserted.push_back(marker);
+    }
+
+    uint64_t window_instrs_;
+    uint64_t skip_instrs_;
+    uint64_t warmup_instrs_;
+    uint64_t random_seed_;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+#endif /* _SAMPLE_FILTER_H_ */
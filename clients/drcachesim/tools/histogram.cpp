@@ -45,6 +45,7 @@
 #include <vector>
 
 #include "analysis_tool.h"
+#include "flat_addr_map.h"
 #include "memref.h"
 #include "trace_entry.h"
 #include "utils.h"
@@ -120,7 +121,7 @@ bool
 histogram_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
 {
     shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
-    std::unordered_map<addr_t, uint64_t> *cache_map = nullptr;
+    flat_addr_map_t<uint64_t> *cache_map = nullptr;
     addr_t start_addr;
     size_t size;
     if (type_is_instr(memref.instr.type) ||
@@ -176,12 +177,8 @@ histogram_t::reduce_results(uint64_t *unique_icache_lines, uint64_t *unique_dcac
         reduced_ = serial_shard_;
     } else {
         for (const auto &shard : shard_map_) {
-            for (const auto &keyvals : shard.second->icache_map) {
-                reduced_.icache_map[keyvals.first] += keyvals.second;
-            }
-            for (const auto &keyvals : shard.second->dcache_map) {
-                reduced_.dcache_map[keyvals.first] += keyvals.second;
-            }
+            reduced_.icache_map.merge_add(shard.second->icache_map);
+            reduced_.dcache_map.merge_add(shard.second->dcache_map);
         }
     }
     if (unique_icache_lines != nullptr)
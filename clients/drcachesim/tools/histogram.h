@@ -44,6 +44,7 @@
 #include <unordered_map>
 
 #include "analysis_tool.h"
+#include "flat_addr_map.h"
 #include "memref.h"
 #include "trace_entry.h"
 
@@ -80,8 +81,8 @@ public:
 
 protected:
     struct shard_data_t {
-        std::unordered_map<addr_t, uint64_t> icache_map;
-        std::unordered_map<addr_t, uint64_t> dcache_map;
+        flat_addr_map_t<uint64_t> icache_map;
+        flat_addr_map_t<uint64_t> dcache_map;
         std::string error;
     };
 
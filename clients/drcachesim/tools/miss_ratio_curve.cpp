@@ -0,0 +1,393 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "miss_ratio_curve.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "analysis_tool.h"
+#include "memref.h"
+#include "miss_ratio_curve_create.h"
+#include "reuse_distance.h"
+#include "trace_entry.h"
+#include "utils.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+const std::string miss_ratio_curve_t::TOOL_NAME = "Miss ratio curve tool";
+
+analysis_tool_t *
+miss_ratio_curve_tool_create(const miss_ratio_curve_knobs_t &knobs)
+{
+    return new miss_ratio_curve_t(knobs);
+}
+
+miss_ratio_curve_t::miss_ratio_curve_t(const miss_ratio_curve_knobs_t &knobs)
+    : knobs_(knobs)
+    , line_size_bits_(compute_log2((int)knobs_.line_size))
+{
+}
+
+miss_ratio_curve_t::~miss_ratio_curve_t()
+{
+    for (auto &shard : shard_map_) {
+        delete shard.second;
+    }
+}
+
+miss_ratio_curve_t::sample_set_t::sample_set_t(uint64_t seed, double initial_rate)
+    : hash_seed(seed)
+    , rate(initial_rate)
+    // We never want distant references counted.
+    , ref_tree(std::numeric_limits<uint64_t>::max())
+{
+    if (initial_rate >= 1.0)
+        sample_all = true;
+    else
+        hash_limit = static_cast<uint64_t>(std::ldexp(initial_rate, 64));
+}
+
+miss_ratio_curve_t::shard_data_t::shard_data_t(const miss_ratio_curve_knobs_t &knobs)
+{
+    for (unsigned int i = 0; i < knobs.sample_sets; ++i) {
+        // Seeding with multiples of the golden ratio gives unrelated hashes.
+        sample_sets.emplace_back(
+            new sample_set_t(i * 0x9e3779b97f4a7c15ULL, knobs.sample_rate));
+    }
+}
+
+size_t
+miss_ratio_curve_t::distance_bucket(uint64_t distance)
+{
+    if (distance < SUB_BUCKETS)
+        return static_cast<size_t>(distance);
+    size_t shift = 0;
+    while ((distance >> shift) >= 2 * SUB_BUCKETS)
+        ++shift;
+    return SUB_BUCKETS * shift + static_cast<size_t>(distance >> shift);
+}
+
+uint64_t
+miss_ratio_curve_t::bucket_start(size_t bucket)
+{
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+    size_t shift = bucket / SUB_BUCKETS - 1;
+    return static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+}
+
+bool
+miss_ratio_curve_t::parallel_shard_supported()
+{
+    return true;
+}
+
+void *
+miss_ratio_curve_t::parallel_shard_init(int shard_index, void *worker_data)
+{
+    auto shard = new shard_data_t(knobs_);
+    std::lock_guard<std::mutex> guard(shard_map_mutex_);
+    shard_map_[shard_index] = shard;
+    return reinterpret_cast<void *>(shard);
+}
+
+bool
+miss_ratio_curve_t::parallel_shard_exit(void *shard_data)
+{
+    // Nothing (we read the shard data in print_results).
+    return true;
+}
+
+std::string
+miss_ratio_curve_t::parallel_shard_error(void *shard_data)
+{
+    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
+    return shard->error;
+}
+
+void
+miss_ratio_curve_t::sample_access(sample_set_t *set, addr_t tag)
+{
+    // This is the same splitmix64 finalizer used by reuse_distance_t's sampling.
+    uint64_t hash = static_cast<uint64_t>(tag) + set->hash_seed;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    if (!set->sample_all && hash >= set->hash_limit)
+        return;
+    double weight = 1.0 / set->rate;
+    set->total_weight += weight;
+    auto it = set->lines.find(tag);
+    if (it == set->lines.end()) {
+        line_ref_t *ref = set->line_pool.alloc(tag);
+        set->lines.insert(std::make_pair(tag, ref));
+        set->ref_tree.add_to_front(ref);
+        set->by_hash.push(std::make_pair(hash, tag));
+        set->cold_weight += weight;
+        if (set->lines.size() > knobs_.sample_lines)
+            lower_rate(set);
+        return;
+    }
+    uint64_t distance = static_cast<uint64_t>(set->ref_tree.move_to_front(it->second));
+    if (!set->sample_all)
+        distance = static_cast<uint64_t>(std::llround(distance / set->rate));
+    size_t bucket = distance_bucket(distance);
+    if (bucket >= set->histogram.size())
+        set->histogram.resize(bucket + 1);
+    set->histogram[bucket] += weight;
+}
+
+void
+miss_ratio_curve_t::lower_rate(sample_set_t *set)
+{
+    // Drop the lines with the largest hash and exclude that hash from now on.
+    uint64_t limit = set->by_hash.top().first;
+    while (!set->by_hash.empty() && set->by_hash.top().first == limit) {
+        auto it = set->lines.find(set->by_hash.top().second);
+        set->by_hash.pop();
+        line_ref_t *ref = it->second;
+        set->ref_tree.vacate_slot(static_cast<size_t>(ref->time_stamp));
+        set->line_pool.free(ref);
+        set->lines.erase(it);
+    }
+    set->sample_all = false;
+    set->hash_limit = limit;
+    set->rate = std::ldexp(static_cast<double>(limit), -64);
+    if (knobs_.verbose >= 2) {
+        std::cerr << "Lowered sampling rate to " << set->rate << " with "
+                  << set->lines.size() << " lines\n";
+    }
+}
+
+bool
+miss_ratio_curve_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
+{
+    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
+    if (memref.data.type == TRACE_TYPE_THREAD_EXIT) {
+        shard->tid = memref.exit.tid;
+        return true;
+    }
+    // Like reuse_distance_t, we model a unified cache.
+    if (type_is_instr(memref.instr.type) || memref.data.type == TRACE_TYPE_READ ||
+        memref.data.type == TRACE_TYPE_WRITE || type_is_prefetch(memref.data.type)) {
+        ++shard->total_refs;
+        addr_t tag = memref.data.addr >> line_size_bits_;
+        for (auto &set : shard->sample_sets)
+            sample_access(set.get(), tag);
+    }
+    return true;
+}
+
+bool
+miss_ratio_curve_t::process_memref(const memref_t &memref)
+{
+    // For serial operation we index using the tid.
+    shard_data_t *shard;
+    const auto &lookup = shard_map_.find(memref.data.tid);
+    if (lookup == shard_map_.end()) {
+        shard = new shard_data_t(knobs_);
+        shard_map_[memref.data.tid] = shard;
+    } else
+        shard = lookup->second;
+    if (!parallel_shard_memref(reinterpret_cast<void *>(shard), memref)) {
+        error_string_ = shard->error;
+        return false;
+    }
+    return true;
+}
+
+std::vector<miss_ratio_curve_t::curve_point_t>
+miss_ratio_curve_t::compute_curve(const std::vector<const shard_data_t *> &shards)
+{
+    std::vector<curve_point_t> curve;
+    uint64_t total_refs = 0;
+    for (const shard_data_t *shard : shards)
+        total_refs += shard->total_refs;
+    if (total_refs == 0 || knobs_.sample_sets == 0)
+        return curve;
+    // The miss ratio at each bucket start, per sample set.
+    std::vector<std::vector<double>> ratios(knobs_.sample_sets);
+    size_t num_buckets = 0;
+    for (size_t i = 0; i < ratios.size(); ++i) {
+        std::vector<double> histogram;
+        double cold_weight = 0.;
+        double total_weight = 0.;
+        for (const shard_data_t *shard : shards) {
+            const sample_set_t *set = shard->sample_sets[i].get();
+            if (set->histogram.size() > histogram.size())
+                histogram.resize(set->histogram.size());
+            for (size_t bucket = 0; bucket < set->histogram.size(); ++bucket)
+                histogram[bucket] += set->histogram[bucket];
+            cold_weight += set->cold_weight;
+            total_weight += set->total_weight;
+        }
+        if (histogram.empty())
+            histogram.resize(1);
+        // The SHARDS-adj correction (Waldspurger et al., ATC'17): attribute the
+        // difference between the actual and estimated access counts to the
+        // smallest distance, which counters the sampling bias toward or away from
+        // frequently accessed lines.
+        histogram[0] += static_cast<double>(total_refs) - total_weight;
+        num_buckets = std::max(num_buckets, histogram.size());
+        ratios[i].resize(histogram.size() + 1);
+        double misses = cold_weight;
+        for (size_t bucket = histogram.size(); bucket > 0; --bucket) {
+            ratios[i][bucket] = misses / total_refs;
+            misses += histogram[bucket - 1];
+        }
+    }
+    // A cache of zero lines is not interesting, so we start at one line.
+    for (size_t bucket = 1; bucket <= num_buckets; ++bucket) {
+        double sum = 0.;
+        double sum_squares = 0.;
+        for (const auto &ratio : ratios) {
+            // Past the end of a shorter histogram the ratio is that of its end.
+            double value = ratio[std::min(bucket, ratio.size() - 1)];
+            value = std::min(1.0, std::max(0.0, value));
+            sum += value;
+            sum_squares += value * value;
+        }
+        size_t count = ratios.size();
+        curve_point_t point;
+        point.cache_lines = bucket_start(bucket);
+        point.miss_ratio = sum / count;
+        double error = 0.;
+        if (count > 1) {
+            // A 95% confidence interval for the mean of the sample sets.
+            double variance =
+                (sum_squares - sum * point.miss_ratio) / static_cast<double>(count - 1);
+            error = 1.96 * std::sqrt(std::max(0.0, variance) / count);
+        }
+        point.miss_ratio_low = std::max(0.0, point.miss_ratio - error);
+        point.miss_ratio_high = std::min(1.0, point.miss_ratio + error);
+        curve.push_back(point);
+    }
+    return curve;
+}
+
+void
+miss_ratio_curve_t::print_csv(std::ostream &out, const std::vector<curve_point_t> &curve)
+{
+    out << "cache_lines,cache_bytes,miss_ratio,miss_ratio_low,miss_ratio_high\n";
+    out << std::fixed << std::setprecision(6);
+    for (const curve_point_t &point : curve) {
+        out << point.cache_lines << "," << point.cache_lines * knobs_.line_size << ","
+            << point.miss_ratio << "," << point.miss_ratio_low << ","
+            << point.miss_ratio_high << "\n";
+    }
+}
+
+void
+miss_ratio_curve_t::print_json(std::ostream &out, const std::vector<curve_point_t> &curve,
+                               uint64_t total_refs)
+{
+    out << "{\n  \"line_size\": " << knobs_.line_size
+        << ",\n  \"accesses\": " << total_refs
+        << ",\n  \"sample_sets\": " << knobs_.sample_sets << ",\n  \"curve\": [";
+    out << std::fixed << std::setprecision(6);
+    for (size_t i = 0; i < curve.size(); ++i) {
+        const curve_point_t &point = curve[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\"cache_lines\": " << point.cache_lines
+            << ", \"cache_bytes\": " << point.cache_lines * knobs_.line_size
+            << ", \"miss_ratio\": " << point.miss_ratio
+            << ", \"miss_ratio_low\": " << point.miss_ratio_low
+            << ", \"miss_ratio_high\": " << point.miss_ratio_high << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+bool
+miss_ratio_curve_t::print_results()
+{
+    // Each shard is treated as having its own cache, as reuse_distance_t does, and
+    // the aggregate curve combines their misses.
+    std::vector<const shard_data_t *> shards;
+    uint64_t total_refs = 0;
+    for (const auto &shard : shard_map_) {
+        shards.push_back(shard.second);
+        total_refs += shard.second->total_refs;
+    }
+    std::vector<curve_point_t> curve = compute_curve(shards);
+
+    std::cerr << TOOL_NAME << " aggregated results:\n";
+    std::cerr << "Total accesses: " << total_refs << "\n";
+    double min_rate = 1.0;
+    size_t sampled_lines = 0;
+    for (const shard_data_t *shard : shards) {
+        for (const auto &set : shard->sample_sets) {
+            min_rate = std::min(min_rate, set->rate);
+            sampled_lines = std::max(sampled_lines, set->lines.size());
+        }
+    }
+    std::cerr << "Lowest sampled cache line rate: " << min_rate << "\n";
+    std::cerr << "Most lines in a sample set: " << sampled_lines << "\n";
+
+    std::ofstream file;
+    std::ostream *out = &std::cerr;
+    if (!knobs_.output_file.empty()) {
+        file.open(knobs_.output_file);
+        if (!file.good()) {
+            error_string_ = "Failed to open " + knobs_.output_file;
+            return false;
+        }
+        out = &file;
+        std::cerr << "Curve written to " << knobs_.output_file << "\n";
+    }
+    if (knobs_.output_format == "json")
+        print_json(*out, curve, total_refs);
+    else
+        print_csv(*out, curve);
+    if (!out->good()) {
+        error_string_ = "Failed to write the curve";
+        return false;
+    }
+    return true;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -0,0 +1,163 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* miss-ratio-curve: computes approximate LRU miss ratios for all cache sizes.
+ */
+
+#ifndef _MISS_RATIO_CURVE_H_
+#define _MISS_RATIO_CURVE_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "analysis_tool.h"
+#include "memref.h"
+#include "miss_ratio_curve_create.h"
+#include "reuse_distance.h"
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// This tool implements fixed-size SHARDS (Waldspurger et al., FAST'15): cache lines
+// are sampled by hashing their tags, and the reuse distances of the sampled lines,
+// scaled by the inverse of the sampling rate, estimate the distance histogram.
+// The sampling rate is lowered whenever a sample set grows past a fixed number of
+// lines, so memory is bounded regardless of the trace's working set.  A hit in an
+// LRU cache of N lines is a reuse at a distance below N, so the histogram yields
+// the whole curve.  Several sample sets with different hash functions provide an
+// estimate of the error.
+class miss_ratio_curve_t : public analysis_tool_t {
+public:
+    explicit miss_ratio_curve_t(const miss_ratio_curve_knobs_t &knobs);
+    ~miss_ratio_curve_t() override;
+    bool
+    process_memref(const memref_t &memref) override;
+    bool
+    print_results() override;
+    bool
+    parallel_shard_supported() override;
+    void *
+    parallel_shard_init(int shard_index, void *worker_data) override;
+    bool
+    parallel_shard_exit(void *shard_data) override;
+    bool
+    parallel_shard_memref(void *shard_data, const memref_t &memref) override;
+    std::string
+    parallel_shard_error(void *shard_data) override;
+
+protected:
+    // One point on the curve: the estimated miss ratio for a cache of cache_lines
+    // lines, with bounds from the spread across sample sets.
+    struct curve_point_t {
+        uint64_t cache_lines;
+        double miss_ratio;
+        double miss_ratio_low;
+        double miss_ratio_high;
+    };
+
+    // A set of sampled lines along with the histogram of their weighted reuse
+    // distances.  Each access is weighted by the inverse of the rate at the time.
+    struct sample_set_t {
+        sample_set_t(uint64_t seed, double initial_rate);
+        const uint64_t hash_seed;
+        // Lines whose hash is below this limit are sampled, unless sample_all.
+        uint64_t hash_limit = 0;
+        bool sample_all = false;
+        double rate;
+        std::unordered_map<addr_t, line_ref_t *> lines;
+        // The sampled lines by hash, largest first, for lowering the rate.
+        std::priority_queue<std::pair<uint64_t, addr_t>> by_hash;
+        line_ref_pool_t line_pool;
+        line_ref_tree_t ref_tree;
+        // The weight of reuses in each distance bucket (see distance_bucket()).
+        std::vector<double> histogram;
+        double cold_weight = 0.;
+        double total_weight = 0.;
+    };
+
+    struct shard_data_t {
+        explicit shard_data_t(const miss_ratio_curve_knobs_t &knobs);
+        std::vector<std::unique_ptr<sample_set_t>> sample_sets;
+        uint64_t total_refs = 0;
+        memref_tid_t tid = 0;
+        std::string error;
+    };
+
+    // Distances below SUB_BUCKETS have their own buckets, with SUB_BUCKETS buckets
+    // for each power of two above that.
+    static size_t
+    distance_bucket(uint64_t distance);
+    // Returns the smallest distance in "bucket".
+    static uint64_t
+    bucket_start(size_t bucket);
+
+    void
+    sample_access(sample_set_t *set, addr_t tag);
+    void
+    lower_rate(sample_set_t *set);
+
+    // Computes the curve for the merged sample sets of the given shards.
+    std::vector<curve_point_t>
+    compute_curve(const std::vector<const shard_data_t *> &shards);
+    void
+    print_csv(std::ostream &out, const std::vector<curve_point_t> &curve);
+    void
+    print_json(std::ostream &out, const std::vector<curve_point_t> &curve,
+               uint64_t total_refs);
+
+    static constexpr size_t SUB_BUCKETS = 8;
+
+    const miss_ratio_curve_knobs_t knobs_;
+    const size_t line_size_bits_;
+    static const std::string TOOL_NAME;
+    // In parallel operation the keys are "shard indices": just ints.
+    std::unordered_map<memref_tid_t, shard_data_t *> shard_map_;
+    // This mutex is only needed in parallel_shard_init.  In all other accesses to
+    // shard_map (process_memref, print_results) we are single-threaded.
+    std::mutex shard_map_mutex_;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _MISS_RATIO_CURVE_H_ */
@@ -0,0 +1,91 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* miss ratio curve tool creation */
+
+#ifndef _MISS_RATIO_CURVE_CREATE_H_
+#define _MISS_RATIO_CURVE_CREATE_H_ 1
+
+#include <string>
+
+#include "analysis_tool.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+/**
+ * @file drmemtrace/miss_ratio_curve_create.h
+ * @brief DrMemtrace miss ratio curve tool creation.
+ */
+
+/**
+ * The options for miss_ratio_curve_tool_create().
+ * The options are currently documented in \ref sec_drcachesim_ops.
+ */
+// These options are currently documented in ../common/options.cpp.
+struct miss_ratio_curve_knobs_t {
+    miss_ratio_curve_knobs_t()
+        : line_size(64)
+        , sample_rate(1.0)
+        , sample_lines(8192)
+        , sample_sets(4)
+        , output_format("csv")
+        , verbose(0)
+    {
+    }
+    unsigned int line_size;
+    // The initial fraction of cache lines sampled, which drops as needed to keep
+    // at most sample_lines lines in each sample set.
+    double sample_rate;
+    unsigned int sample_lines;
+    // The number of independently hashed sample sets per shard, whose spread
+    // provides the error bounds.
+    unsigned int sample_sets;
+    // Either "csv" or "json".
+    std::string output_format;
+    // If empty, the curve is printed to stderr.
+    std::string output_file;
+    unsigned int verbose;
+};
+
+/**
+ * Creates an analysis tool which computes an approximate miss ratio curve for a
+ * fully associative LRU cache of every size in a single pass.
+ */
+analysis_tool_t *
+miss_ratio_curve_tool_create(const miss_ratio_curve_knobs_t &knobs);
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _MISS_RATIO_CURVE_CREATE_H_ */
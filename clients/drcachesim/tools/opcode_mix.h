@@ -51,7 +51,7 @@
 namespace dynamorio {
 namespace drmemtrace {
 
-class opcode_mix_t : public analysis_tool_t {
+class opcode_mix_t : public batched_analysis_tool_t<opcode_mix_t> {
 public:
     // The module_file_path is optional and unused for traces with
     // OFFLINE_FILE_TYPE_ENCODINGS.
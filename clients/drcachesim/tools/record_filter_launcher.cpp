@@ -38,6 +38,7 @@
 #include "tools/filter/null_filter.h"
 #include "tools/filter/cache_filter.h"
 #include "tools/filter/type_filter.h"
+#include "tools/filter/sample_filter.h"
 #include "tools/filter/record_filter.h"
 #include "tests/test_helpers.h"
 
@@ -84,6 +85,13 @@ static droption_t<uint64_t>
                       "when the tool sees a TRACE_MARKER_TYPE_TIMESTAMP marker with "
                       "timestamp greater than the specified value.");
 
+static droption_t<int> op_write_threads(
+    DROPTION_SCOPE_FRONTEND, "write_threads", 4,
+    "Number of threads compressing and writing the output.",
+    "The filtered entries of each shard are buffered and handed to a pool of this "
+    "many threads, which compress and write them while the filtering continues. "
+    "Use 0 to compress and write on the filtering threads instead.");
+
 static droption_t<int> op_cache_filter_size(
     DROPTION_SCOPE_FRONTEND, "cache_filter_size", 0,
     "[Required] Enable data cache filter with given size (in bytes).",
@@ -102,6 +110,35 @@ static droption_t<std::string> op_remove_marker_types(
     "Comma-separated integers for marker types to remove. "
     "See trace_marker_type_t for the list of marker types.");
 
+static droption_t<uint64_t> op_sample_window_instrs(
+    DROPTION_SCOPE_FRONTEND, "sample_window_instrs", 0,
+    "Enable sampling with detailed windows of this many instructions.",
+    "Enable sampling: keep windows of this many instructions, each preceded by "
+    "-sample_warmup_instrs instructions and a removed region of about "
+    "-sample_skip_instrs instructions.  The removed instruction counts and the window "
+    "starts are recorded in markers so analysis tools can extrapolate their results.");
+
+static droption_t<uint64_t>
+    op_sample_skip_instrs(DROPTION_SCOPE_FRONTEND, "sample_skip_instrs", 0,
+                          "Instructions removed between sampling windows.",
+                          "The number of instructions removed before each warmup "
+                          "region when -sample_window_instrs is set.  With "
+                          "-sample_seed this is the average instead.");
+
+static droption_t<uint64_t>
+    op_sample_warmup_instrs(DROPTION_SCOPE_FRONTEND, "sample_warmup_instrs", 0,
+                            "Warmup instructions kept before each sampling window.",
+                            "The number of instructions kept before each window when "
+                            "-sample_window_instrs is set, to warm up simulated "
+                            "state such as caches.");
+
+static droption_t<uint64_t> op_sample_seed(
+    DROPTION_SCOPE_FRONTEND, "sample_seed", 0,
+    "Seed for random sampling window placement.",
+    "If non-zero, the removed regions between sampling windows have random lengths "
+    "averaging -sample_skip_instrs, seeded by this value and the thread id, instead of "
+    "a fixed length.  This avoids aliasing with periodic program behavior.");
+
 template <typename T>
 std::vector<T>
 parse_string(const std::string &s, char sep = ',')
@@ -161,12 +198,21 @@ _tmain(int argc, const TCHAR *targv[])
                 new dynamorio::drmemtrace::type_filter_t(filter_trace_types,
                                                          filter_marker_types)));
     }
+    if (op_sample_window_instrs.get_value() > 0) {
+        filter_funcs.emplace_back(
+            std::unique_ptr<dynamorio::drmemtrace::record_filter_t::record_filter_func_t>(
+                new dynamorio::drmemtrace::sample_filter_t(
+                    op_sample_window_instrs.get_value(),
+                    op_sample_skip_instrs.get_value(),
+                    op_sample_warmup_instrs.get_value(), op_sample_seed.get_value())));
+    }
     // TODO i#5675: Add other filters.
 
     auto record_filter = std::unique_ptr<record_analysis_tool_t>(
         new dynamorio::drmemtrace::record_filter_t(
             op_output_dir.get_value(), std::move(filter_funcs),
-            op_stop_timestamp.get_value(), op_verbose.get_value()));
+            op_stop_timestamp.get_value(), op_verbose.get_value(),
+            op_write_threads.get_value()));
     std::vector<record_analysis_tool_t *> tools;
     tools.push_back(record_filter.get());
 
@@ -76,6 +76,8 @@ reuse_distance_t::reuse_distance_t(const reuse_distance_knobs_t &knobs)
                      std::cerr << "cache line size " << knobs_.line_size << ", "
                                << "reuse distance threshold " << knobs_.distance_threshold
                                << ", distance limit " << knobs_.distance_limit << "\n");
+    if (knobs_.sample_rate < 1.0)
+        sample_hash_limit_ = static_cast<uint64_t>(std::ldexp(knobs_.sample_rate, 64));
 }
 
 reuse_distance_t::~reuse_distance_t()
@@ -85,12 +87,40 @@ reuse_distance_t::~reuse_distance_t()
     }
 }
 
-reuse_distance_t::shard_data_t::shard_data_t(uint64_t reuse_threshold, uint64_t skip_dist,
-                                             uint32_t distance_limit, bool verify)
-    : distance_limit(distance_limit)
+reuse_distance_t::shard_data_t::shard_data_t(const reuse_distance_knobs_t &knobs)
+    : distance_limit(knobs.distance_limit)
 {
-    ref_list = std::unique_ptr<line_ref_list_t>(
-        new line_ref_list_t(reuse_threshold, skip_dist, verify));
+    // When sampling, each tracked line stands in for 1/rate lines, so the
+    // threshold and limit shrink accordingly when counted in tracked lines.
+    double rate = std::min(knobs.sample_rate, 1.0);
+    uint64_t threshold =
+        static_cast<uint64_t>(std::llround(knobs.distance_threshold * rate));
+    if (distance_limit > 0) {
+        line_limit = std::max(static_cast<uint64_t>(std::llround(distance_limit * rate)),
+                              static_cast<uint64_t>(1));
+    }
+    line_pool = std::unique_ptr<line_ref_pool_t>(new line_ref_pool_t);
+    if (knobs.engine == "tree") {
+        ref_list = std::unique_ptr<line_ref_stack_t>(new line_ref_tree_t(threshold));
+    } else {
+        ref_list = std::unique_ptr<line_ref_stack_t>(
+            new line_ref_list_t(threshold, knobs.skip_list_distance, knobs.verify_skip));
+    }
+}
+
+bool
+reuse_distance_t::line_is_sampled(addr_t tag) const
+{
+    if (knobs_.sample_rate >= 1.0)
+        return true;
+    // As in SHARDS (Waldspurger et al., FAST'15), we sample by hashing the line so
+    // that every access to a sampled line is seen.  The splitmix64 finalizer is a
+    // cheap hash with good enough mixing for this.
+    uint64_t hash = static_cast<uint64_t>(tag);
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash < sample_hash_limit_;
 }
 
 bool
@@ -102,8 +132,7 @@ reuse_distance_t::parallel_shard_supported()
 void *
 reuse_distance_t::parallel_shard_init(int shard_index, void *worker_data)
 {
-    auto shard = new shard_data_t(knobs_.distance_threshold, knobs_.skip_list_distance,
-                                  knobs_.distance_limit, knobs_.verify_skip);
+    auto shard = new shard_data_t(knobs_);
     std::lock_guard<std::mutex> guard(shard_map_mutex_);
     shard_map_[shard_index] = shard;
     return reinterpret_cast<void *>(shard);
@@ -153,10 +182,12 @@ reuse_distance_t::parallel_shard_memref(void *shard_data, const memref_t &memref
             ++shard->data_refs;
         }
         addr_t tag = memref.data.addr >> line_size_bits_;
+        if (!line_is_sampled(tag))
+            return true;
         std::unordered_map<addr_t, line_ref_t *>::iterator it =
             shard->cache_map.find(tag);
         if (it == shard->cache_map.end()) {
-            line_ref_t *ref = new line_ref_t(tag);
+            line_ref_t *ref = shard->line_pool->alloc(tag);
             // insert into the map
             shard->cache_map.insert(std::pair<addr_t, line_ref_t *>(tag, ref));
             // insert into the list
@@ -166,10 +197,9 @@ reuse_distance_t::parallel_shard_memref(void *shard_data, const memref_t &memref
                 ++shard->pruned_address_hits;
                 shard->pruned_addresses.erase(tag); // It has been unpruned.
             }
-            if (shard->distance_limit > 0 &&
-                shard->distance_limit < shard->cache_map.size()) {
+            if (shard->line_limit > 0 && shard->line_limit < shard->cache_map.size()) {
                 // Distance list is too long, so prune most-distant entry.
-                ref = shard->ref_list->tail_; // Get a pointer to the line.
+                ref = shard->ref_list->least_recent(); // Get a pointer to the line.
                 assert(ref != NULL);
                 addr_t tag_to_remove = ref->tag;
                 // Move this line from the cache_map to the pruned set.
@@ -178,11 +208,14 @@ reuse_distance_t::parallel_shard_memref(void *shard_data, const memref_t &memref
                 ++shard->pruned_address_count;
                 // Remove this oldest entry from the reference list.
                 shard->ref_list->prune_tail();
-                // Delete the no-longer-needed line object
-                delete ref;
+                // Recycle the no-longer-needed line object.
+                shard->line_pool->free(ref);
             }
         } else {
             int64_t dist = shard->ref_list->move_to_front(it->second);
+            // Scale sampled distances to estimate the full distance.
+            if (knobs_.sample_rate < 1.0)
+                dist = std::llround(dist / knobs_.sample_rate);
             auto &dist_map = is_instr_type ? shard->dist_map : shard->dist_map_data;
             distance_histogram_t::iterator dist_it = dist_map.find(dist);
             if (dist_it == dist_map.end())
@@ -202,8 +235,7 @@ reuse_distance_t::process_memref(const memref_t &memref)
     shard_data_t *shard;
     const auto &lookup = shard_map_.find(memref.data.tid);
     if (lookup == shard_map_.end()) {
-        shard = new shard_data_t(knobs_.distance_threshold, knobs_.skip_list_distance,
-                                 knobs_.distance_limit, knobs_.verify_skip);
+        shard = new shard_data_t(knobs_);
         shard_map_[memref.data.tid] = shard;
     } else
         shard = lookup->second;
@@ -267,6 +299,11 @@ reuse_distance_t::print_shard_results(const shard_data_t *shard)
     std::cerr << "Distance limit: " << shard->distance_limit << "\n";
     std::cerr << "Pruned addresses: " << shard->pruned_address_count << "\n";
     std::cerr << "Pruned address hits: " << shard->pruned_address_hits << "\n";
+    if (knobs_.sample_rate < 1.0) {
+        std::cerr << "Sampled cache line rate: " << knobs_.sample_rate
+                  << " (the counts of unique accesses, lines, and reuses include only "
+                  << "sampled lines; distances are scaled)\n";
+    }
     std::cerr << "\n";
 
     std::cerr.precision(2);
@@ -436,9 +473,7 @@ reuse_distance_t::get_aggregated_results()
         return aggregated_results_.get();
 
     // Otherwise, aggregate the per-shard data to get whole-trace data.
-    aggregated_results_ = std::unique_ptr<shard_data_t>(
-        new shard_data_t(knobs_.distance_threshold, knobs_.skip_list_distance,
-                         knobs_.distance_limit, knobs_.verify_skip));
+    aggregated_results_ = std::unique_ptr<shard_data_t>(new shard_data_t(knobs_));
     for (auto &shard : shard_map_) {
         aggregated_results_->total_refs += shard.second->total_refs;
         aggregated_results_->data_refs += shard.second->data_refs;
@@ -471,7 +506,7 @@ reuse_distance_t::get_aggregated_results()
             const auto &existing = aggregated_results_->cache_map.find(entry.first);
             line_ref_t *ref;
             if (existing == aggregated_results_->cache_map.end()) {
-                ref = new line_ref_t(entry.first);
+                ref = aggregated_results_->line_pool->alloc(entry.first);
                 aggregated_results_->cache_map.insert(
                     std::pair<addr_t, line_ref_t *>(entry.first, ref));
                 ref->total_refs = 0;
@@ -492,11 +527,6 @@ reuse_distance_t::print_results()
     std::cerr << TOOL_NAME << " aggregated results:\n";
     print_shard_results(get_aggregated_results());
 
-    // For regular shards the line_ref_t's are deleted in ~line_ref_list_t.
-    for (auto &iter : get_aggregated_results()->cache_map) {
-        delete iter.second;
-    }
-
     if (shard_map_.size() > 1) {
         using keyval_t = std::pair<memref_tid_t, shard_data_t *>;
         std::vector<keyval_t> sorted(shard_map_.begin(), shard_map_.end());
@@ -41,9 +41,12 @@
 #include <stdint.h>
 
 #include <iostream>
+#include <algorithm>
 #include <memory>
 #include <mutex>
+#include <new>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -72,10 +75,11 @@ namespace drmemtrace {
 #    define IF_DEBUG_VERBOSE(level, action)
 #endif
 
-struct line_ref_list_t;
+struct line_ref_stack_t;
 struct line_ref_t;
+class line_ref_pool_t;
 
-class reuse_distance_t : public analysis_tool_t {
+class reuse_distance_t : public batched_analysis_tool_t<reuse_distance_t> {
 public:
     explicit reuse_distance_t(const reuse_distance_knobs_t &knobs);
     ~reuse_distance_t() override;
@@ -109,8 +113,7 @@ protected:
     // the shards we're given.  This is for simplicity and to give the user a method
     // for computing over different units if for some reason that was desired.
     struct shard_data_t {
-        shard_data_t(uint64_t reuse_threshold, uint64_t skip_dist,
-                     unsigned int distance_limit, bool verify);
+        explicit shard_data_t(const reuse_distance_knobs_t &knobs);
         std::unordered_map<addr_t, line_ref_t *> cache_map;
         std::unordered_set<addr_t> pruned_addresses;
         // These are our reuse distance histograms: one for all accesses and one
@@ -126,7 +129,9 @@ protected:
         distance_histogram_t dist_map;
         distance_histogram_t dist_map_data;
         bool dist_map_is_instr_only = true;
-        std::unique_ptr<line_ref_list_t> ref_list;
+        // Owns the line_ref_t nodes in cache_map.
+        std::unique_ptr<line_ref_pool_t> line_pool;
+        std::unique_ptr<line_ref_stack_t> ref_list;
         int64_t total_refs = 0;
         int64_t data_refs = 0; // Non-instruction reference count.
         // Ideally the shard index would be the tid when shard==thread but that's
@@ -135,6 +140,9 @@ protected:
         std::string error;
         // Keep a per-shard copy of distance_limit for parallel operation.
         unsigned int distance_limit = 0;
+        // The limit on the number of lines in ref_list implied by distance_limit,
+        // which is smaller than distance_limit when sampling.
+        uint64_t line_limit = 0;
         // Track the number of insertions (pruned_address_count) and deletions
         // (pruned_address_hits) from the pruned_addresses set.
         uint64_t pruned_address_count = 0;
@@ -149,6 +157,11 @@ protected:
     void
     print_shard_results(const shard_data_t *shard);
 
+    // Returns whether accesses to the cache line "tag" are tracked under
+    // knobs_.sample_rate.
+    bool
+    line_is_sampled(addr_t tag) const;
+
     // Return a pointer to aggregate results, building them if needed.
     virtual const shard_data_t *
     get_aggregated_results();
@@ -156,6 +169,8 @@ protected:
 
     const reuse_distance_knobs_t knobs_;
     const size_t line_size_bits_;
+    // Sampled lines are those whose tag hashes below this value.
+    uint64_t sample_hash_limit_ = 0;
     static const std::string TOOL_NAME;
     // In parallel operation the keys are "shard indices": just ints.
     std::unordered_map<memref_tid_t, shard_data_t *> shard_map_;
@@ -192,6 +207,81 @@ struct line_ref_t {
     }
 };
 
+// Allocates line_ref_t nodes in large blocks, which is considerably cheaper in
+// both time and space than a heap allocation per distinct cache line.  All nodes
+// are released when the pool is destroyed.
+class line_ref_pool_t {
+public:
+    line_ref_t *
+    alloc(addr_t tag)
+    {
+        void *mem;
+        if (free_list_ != nullptr) {
+            mem = free_list_;
+            free_list_ = free_list_->next;
+        } else {
+            if (next_ == BLOCK_SIZE) {
+                blocks_.emplace_back(new storage_t[BLOCK_SIZE]);
+                next_ = 0;
+            }
+            mem = &blocks_.back()[next_++];
+        }
+        return new (mem) line_ref_t(tag);
+    }
+
+    // Returns "ref" to the pool for reuse by a later alloc().
+    void
+    free(line_ref_t *ref)
+    {
+        ref->next = free_list_;
+        free_list_ = ref;
+    }
+
+private:
+    // line_ref_t is trivially destructible so we never run its destructor.
+    using storage_t =
+        typename std::aligned_storage<sizeof(line_ref_t), alignof(line_ref_t)>::type;
+    static constexpr size_t BLOCK_SIZE = 4096;
+    std::vector<std::unique_ptr<storage_t[]>> blocks_;
+    size_t next_ = BLOCK_SIZE;
+    line_ref_t *free_list_ = nullptr;
+};
+
+// The interface to a structure ordering cache lines by how recently they were
+// accessed, from which reuse distances are computed.  The nodes themselves are
+// owned by a line_ref_pool_t.
+struct line_ref_stack_t {
+    uint64_t cur_time_ = 0; // current time stamp
+    uint64_t threshold_;    // the reuse distance threshold
+
+    explicit line_ref_stack_t(uint64_t reuse_threshold)
+        : threshold_(reuse_threshold)
+    {
+    }
+
+    virtual ~line_ref_stack_t()
+    {
+    }
+
+    // Adds a new cache line as the most recently accessed.
+    virtual void
+    add_to_front(line_ref_t *ref) = 0;
+
+    // Makes a cache line already present the most recently accessed, updating its
+    // reference counts.  Returns its reuse distance: the number of distinct lines
+    // accessed since its prior access.
+    virtual int64_t
+    move_to_front(line_ref_t *ref) = 0;
+
+    // Returns the least recently accessed cache line.
+    virtual line_ref_t *
+    least_recent() = 0;
+
+    // Removes the least recently accessed cache line.
+    virtual void
+    prune_tail() = 0;
+};
+
 // We use a doubly linked list to keep track of the cache line reuse distance.
 // The head of the list is the most recently accessed cache line.
 // The earlier a cache line was accessed last time, the deeper that cache line
@@ -207,38 +297,29 @@ struct line_ref_t {
 // We have a second doubly-linked list, a one-layer skip list, for
 // more efficient computation of the depth.  Each node in the skip
 // list stores its depth from the front.
-struct line_ref_list_t {
+struct line_ref_list_t : public line_ref_stack_t {
     line_ref_t *head_;       // the most recently accessed cache line
     line_ref_t *gate_;       // the earliest cache line refs within the threshold
     line_ref_t *tail_;       // the least recently accessed cache line
-    uint64_t cur_time_;      // current time stamp
     uint64_t unique_lines_;  // the total number of unique cache lines accessed
-    uint64_t threshold_;     // the reuse distance threshold
     uint64_t skip_distance_; // distance between skip list nodes
     bool verify_skip_;       // check results using brute-force walks
 
     line_ref_list_t(uint64_t reuse_threshold_, uint64_t skip_dist, bool verify)
-        : head_(NULL)
+        : line_ref_stack_t(reuse_threshold_)
+        , head_(NULL)
         , gate_(NULL)
         , tail_(NULL)
-        , cur_time_(0)
         , unique_lines_(0)
-        , threshold_(reuse_threshold_)
         , skip_distance_(skip_dist)
         , verify_skip_(verify)
     {
     }
 
-    virtual ~line_ref_list_t()
+    line_ref_t *
+    least_recent() override
     {
-        line_ref_t *ref;
-        line_ref_t *next;
-        if (head_ == NULL)
-            return;
-        for (ref = head_; ref != NULL; ref = next) {
-            next = ref->next;
-            delete ref;
-        }
+        return tail_;
     }
 
     bool
@@ -287,7 +368,7 @@ struct line_ref_list_t {
     // than the threshold so that the gate points to the earliest
     // referenced cache line within the threshold.
     void
-    add_to_front(line_ref_t *ref)
+    add_to_front(line_ref_t *ref) override
     {
         IF_DEBUG_VERBOSE(3, std::cerr << "Add tag 0x" << std::hex << ref->tag << "\n");
         // update head_
@@ -335,7 +416,7 @@ struct line_ref_list_t {
 
     // Remove the last entry from the distance list.
     void
-    prune_tail()
+    prune_tail() override
     {
         // Make sure the tail pointers are legal.
         assert(tail_ != NULL);
@@ -368,7 +449,7 @@ struct line_ref_list_t {
     // line is the gate_ cache line or any cache line after.
     // Returns the reuse distance of ref.
     int64_t
-    move_to_front(line_ref_t *ref)
+    move_to_front(line_ref_t *ref) override
     {
         IF_DEBUG_VERBOSE(
             3, std::cerr << "Move tag 0x" << std::hex << ref->tag << " to front\n");
@@ -447,6 +528,158 @@ struct line_ref_list_t {
     }
 };
 
+// An order-statistic alternative to line_ref_list_t, following Bennett and
+// Kruskal: each cache line occupies the slot of its most recent access time
+// and a Fenwick tree counts the occupied slots, so the reuse distance of a line
+// is the number of occupied slots after its own.  This takes O(log n) time
+// regardless of the distance and needs no tuning.  Slots vacated by re-accessed
+// lines are reclaimed by periodically renumbering the lines, which keeps memory
+// proportional to the number of lines rather than the number of accesses.
+// Each line's time_stamp holds its slot; the list fields of line_ref_t are
+// unused.
+struct line_ref_tree_t : public line_ref_stack_t {
+    std::vector<line_ref_t *> slots_; // the line last accessed at each slot, if any
+    std::vector<uint32_t> counts_;    // Fenwick tree of occupied slot counts
+    size_t next_slot_;                // the slot for the next access
+    size_t oldest_slot_;              // no occupied slots precede this one
+    uint64_t live_lines_;             // the number of occupied slots
+
+    explicit line_ref_tree_t(uint64_t reuse_threshold_)
+        : line_ref_stack_t(reuse_threshold_)
+        , next_slot_(0)
+        , oldest_slot_(0)
+        , live_lines_(0)
+    {
+    }
+
+    // Returns the number of occupied slots at or before "slot".
+    uint64_t
+    count_through(size_t slot) const
+    {
+        uint64_t count = 0;
+        for (size_t i = slot + 1; i > 0; i &= i - 1)
+            count += counts_[i - 1];
+        return count;
+    }
+
+    void
+    update_count(size_t slot, int delta)
+    {
+        for (size_t i = slot; i < counts_.size(); i |= i + 1)
+            counts_[i] += delta;
+    }
+
+    // Renumbers the occupied slots to be contiguous from 0, and resizes to leave
+    // as many free slots as there are lines, which bounds the amortized cost.
+    void
+    compact()
+    {
+        size_t live = 0;
+        for (size_t i = oldest_slot_; i < next_slot_; ++i) {
+            if (slots_[i] != NULL) {
+                slots_[live] = slots_[i];
+                slots_[live]->time_stamp = live;
+                ++live;
+            }
+        }
+        assert(live == live_lines_);
+        size_t size = 2 * live;
+        if (size < MIN_SLOTS)
+            size = MIN_SLOTS;
+        slots_.resize(size);
+        if (slots_.capacity() > 2 * size)
+            slots_.shrink_to_fit();
+        std::fill(slots_.begin() + live, slots_.end(), nullptr);
+        // Build the tree in linear time by pushing each node's count to its parent.
+        counts_.assign(size, 0);
+        for (size_t i = 0; i < size; ++i) {
+            if (i < live)
+                ++counts_[i];
+            size_t parent = i | (i + 1);
+            if (parent < size)
+                counts_[parent] += counts_[i];
+        }
+        if (counts_.capacity() > 2 * size)
+            counts_.shrink_to_fit();
+        next_slot_ = live;
+        oldest_slot_ = 0;
+        IF_DEBUG_VERBOSE(3,
+                         std::cerr << "Compacted " << std::dec << live
+                                   << " lines into " << size << " slots\n");
+    }
+
+    // Places ref in the slot for the current access.
+    void
+    occupy_next_slot(line_ref_t *ref)
+    {
+        if (next_slot_ == slots_.size())
+            compact();
+        slots_[next_slot_] = ref;
+        ref->time_stamp = next_slot_;
+        update_count(next_slot_, 1);
+        ++next_slot_;
+        ++live_lines_;
+        ++cur_time_;
+    }
+
+    void
+    vacate_slot(size_t slot)
+    {
+        slots_[slot] = NULL;
+        update_count(slot, -1);
+        --live_lines_;
+    }
+
+    void
+    add_to_front(line_ref_t *ref) override
+    {
+        IF_DEBUG_VERBOSE(3, std::cerr << "Add tag 0x" << std::hex << ref->tag << "\n");
+        occupy_next_slot(ref);
+    }
+
+    int64_t
+    move_to_front(line_ref_t *ref) override
+    {
+        IF_DEBUG_VERBOSE(
+            3, std::cerr << "Move tag 0x" << std::hex << ref->tag << " to front\n");
+        ref->total_refs++;
+        size_t slot = static_cast<size_t>(ref->time_stamp);
+        int64_t dist = static_cast<int64_t>(live_lines_ - count_through(slot));
+        // Like line_ref_list_t, a repeated access to the front line does not
+        // advance the time.
+        if (dist == 0)
+            return 0;
+        // This matches line_ref_list_t's gate, which sits at a distance of
+        // exactly the threshold.
+        if (static_cast<uint64_t>(dist) > threshold_)
+            ref->distant_refs++;
+        vacate_slot(slot);
+        occupy_next_slot(ref);
+        return dist;
+    }
+
+    line_ref_t *
+    least_recent() override
+    {
+        assert(live_lines_ > 0);
+        while (slots_[oldest_slot_] == NULL)
+            ++oldest_slot_;
+        return slots_[oldest_slot_];
+    }
+
+    void
+    prune_tail() override
+    {
+        least_recent(); // Advances oldest_slot_.
+        IF_DEBUG_VERBOSE(3,
+                         std::cerr << "Prune tag 0x" << std::hex << least_recent()->tag
+                                   << "\n");
+        vacate_slot(oldest_slot_);
+    }
+
+    static constexpr size_t MIN_SLOTS = 1024;
+};
+
 } // namespace drmemtrace
 } // namespace dynamorio
 
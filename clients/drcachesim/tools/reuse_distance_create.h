@@ -35,6 +35,8 @@
 #ifndef _REUSE_DISTANCE_CREATE_H_
 #define _REUSE_DISTANCE_CREATE_H_ 1
 
+#include <string>
+
 #include "analysis_tool.h"
 
 namespace dynamorio {
@@ -61,6 +63,8 @@ struct reuse_distance_knobs_t {
         , verify_skip(false)
         , verbose(0)
         , histogram_bin_multiplier(1.00)
+        , engine("list")
+        , sample_rate(1.0)
     {
     }
     unsigned int line_size;
@@ -72,6 +76,12 @@ struct reuse_distance_knobs_t {
     bool verify_skip;
     unsigned int verbose;
     double histogram_bin_multiplier;
+    // Either "list" for a linked list accelerated by a skip list, or "tree" for an
+    // order-statistic tree over access times.
+    std::string engine;
+    // If below 1, only this fraction of cache lines, selected by hashing, are
+    // tracked, and their distances are scaled up by the inverse.
+    double sample_rate;
 };
 
 /** Creates an analysis tool which computes reuse distance. */
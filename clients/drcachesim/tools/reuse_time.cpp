@@ -45,6 +45,7 @@
 #include <vector>
 
 #include "analysis_tool.h"
+#include "flat_addr_map.h"
 #include "memref.h"
 #include "trace_entry.h"
 #include "utils.h"
@@ -145,14 +146,16 @@ reuse_time_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
 
     shard->time_stamp++;
     addr_t line = memref.data.addr >> line_size_bits_;
-    if (shard->time_map.count(line) > 0) {
-        int64_t reuse_time = shard->time_stamp - shard->time_map[line];
+    // Time stamps start at 1, so a new entry's 0 means no prior access.
+    int64_t &last_time = shard->time_map[line];
+    if (last_time > 0) {
+        int64_t reuse_time = shard->time_stamp - last_time;
         if (DEBUG_VERBOSE(3)) {
             std::cerr << "Reuse " << reuse_time << std::endl;
         }
         shard->reuse_time_histogram[reuse_time]++;
     }
-    shard->time_map[line] = shard->time_stamp;
+    last_time = shard->time_stamp;
     return true;
 }
 
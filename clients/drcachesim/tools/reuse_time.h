@@ -40,6 +40,7 @@
 #include <unordered_map>
 
 #include "analysis_tool.h"
+#include "flat_addr_map.h"
 #include "memref.h"
 #include "trace_entry.h"
 
@@ -69,7 +70,7 @@ protected:
     // Just like for reuse_distance_t, we assume that the shard unit is the unit over
     // which we should measure time.  By default this is a traced thread.
     struct shard_data_t {
-        std::unordered_map<addr_t, int64_t> time_map;
+        flat_addr_map_t<int64_t> time_map;
         int64_t time_stamp = 0;
         int64_t total_instructions = 0;
         std::unordered_map<int64_t, int64_t> reuse_time_histogram;
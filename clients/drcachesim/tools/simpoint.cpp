@@ -0,0 +1,502 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "simpoint.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "analysis_tool.h"
+#include "memref.h"
+#include "scheduler.h"
+#include "simpoint_create.h"
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+const std::string simpoint_t::TOOL_NAME = "SimPoint tool";
+constexpr double simpoint_t::MIN_VARIANCE;
+
+analysis_tool_t *
+simpoint_tool_create(const simpoint_knobs_t &knobs)
+{
+    return new simpoint_t(knobs);
+}
+
+simpoint_t::simpoint_t(const simpoint_knobs_t &knobs)
+    : knobs_(knobs)
+{
+    if (knobs_.interval_instrs == 0)
+        error_string_ = "The interval length must be positive";
+    else if (knobs_.max_clusters == 0)
+        error_string_ = "The maximum cluster count must be positive";
+    else if (knobs_.projection_dims == 0)
+        error_string_ = "The projection must have at least one dimension";
+    success_ = error_string_.empty();
+}
+
+simpoint_t::~simpoint_t()
+{
+    for (auto &shard : shard_map_) {
+        delete shard.second;
+    }
+}
+
+std::string
+simpoint_t::initialize_shard_type(shard_type_t shard_type)
+{
+    // The intervals are ranges of instruction ordinals of a single input.
+    if (shard_type != SHARD_BY_THREAD)
+        return TOOL_NAME + " requires thread-sharded analysis";
+    return "";
+}
+
+bool
+simpoint_t::parallel_shard_supported()
+{
+    return true;
+}
+
+void *
+simpoint_t::parallel_shard_init(int shard_index, void *worker_data)
+{
+    auto shard = new shard_data_t;
+    std::lock_guard<std::mutex> guard(shard_map_mutex_);
+    shard_map_[shard_index] = shard;
+    return reinterpret_cast<void *>(shard);
+}
+
+bool
+simpoint_t::parallel_shard_exit(void *shard_data)
+{
+    finish_shard(reinterpret_cast<shard_data_t *>(shard_data));
+    return true;
+}
+
+std::string
+simpoint_t::parallel_shard_error(void *shard_data)
+{
+    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
+    return shard->error;
+}
+
+double
+simpoint_t::projection(addr_t block_start, unsigned int dim) const
+{
+    // This is the same splitmix64 finalizer used by reuse_distance_t's sampling.
+    uint64_t hash = static_cast<uint64_t>(block_start) +
+        (dim + 1) * 0x9e3779b97f4a7c15ULL + knobs_.seed;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    // The top 53 bits scaled by 2^-52 make a uniform double in [0, 2), which we
+    // shift to [-1, 1).  The projection relies on the elements being centred on
+    // zero: with all of them positive, every projected vector would lean towards
+    // the same direction and the distances between intervals would shrink.
+    return std::ldexp(static_cast<double>(hash >> 11), -52) - 1.0;
+}
+
+void
+simpoint_t::end_interval(shard_data_t *shard)
+{
+    if (shard->block_instrs > 0) {
+        // Blocks spanning intervals are split.
+        shard->block_counts[shard->block_start] += shard->block_instrs;
+        shard->block_instrs = 0;
+    }
+    interval_t interval;
+    interval.tid = shard->tid;
+    interval.start_instruction = shard->interval_start;
+    interval.stop_instruction = shard->instrs;
+    interval.point.resize(knobs_.projection_dims);
+    uint64_t total = shard->instrs - shard->interval_start + 1;
+    // Projecting first and normalizing second is the same as the reverse, with
+    // fewer operations.
+    for (const auto &block : shard->block_counts) {
+        for (unsigned int dim = 0; dim < knobs_.projection_dims; ++dim)
+            interval.point[dim] += block.second * projection(block.first, dim);
+    }
+    for (double &coord : interval.point)
+        coord /= total;
+    shard->block_counts.clear();
+    shard->intervals.push_back(std::move(interval));
+    shard->interval_start = shard->instrs + 1;
+}
+
+void
+simpoint_t::finish_shard(shard_data_t *shard)
+{
+    if (shard->finished)
+        return;
+    shard->finished = true;
+    // A final partial interval is clustered only if it is at least half as long
+    // as the rest, to avoid a short tail representing a whole cluster.
+    uint64_t tail = shard->instrs + 1 - shard->interval_start;
+    if (tail > 0 && tail >= knobs_.interval_instrs / 2)
+        end_interval(shard);
+    else if (tail > 0)
+        ++skipped_intervals_;
+    shard->block_counts = flat_addr_map_t<uint64_t>();
+}
+
+bool
+simpoint_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
+{
+    if (!type_is_instr(memref.instr.type))
+        return true;
+    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
+    shard->tid = memref.instr.tid;
+    if (shard->block_instrs == 0)
+        shard->block_start = memref.instr.addr;
+    ++shard->block_instrs;
+    ++shard->instrs;
+    // A block ends at any transfer of control.  We do not split blocks at the
+    // targets of branches, which is why we key blocks by their first pc.
+    if (type_is_instr_branch(memref.instr.type) ||
+        memref.instr.type == TRACE_TYPE_INSTR_SYSENTER) {
+        shard->block_counts[shard->block_start] += shard->block_instrs;
+        shard->block_instrs = 0;
+    }
+    if (shard->instrs + 1 - shard->interval_start == knobs_.interval_instrs)
+        end_interval(shard);
+    return true;
+}
+
+bool
+simpoint_t::process_memref(const memref_t &memref)
+{
+    // For serial operation we index using the tid.
+    shard_data_t *shard;
+    const auto &lookup = shard_map_.find(memref.data.tid);
+    if (lookup == shard_map_.end()) {
+        shard = new shard_data_t;
+        shard_map_[memref.data.tid] = shard;
+    } else
+        shard = lookup->second;
+    if (!parallel_shard_memref(reinterpret_cast<void *>(shard), memref)) {
+        error_string_ = shard->error;
+        return false;
+    }
+    return true;
+}
+
+simpoint_t::clustering_t
+simpoint_t::cluster(const std::vector<const interval_t *> &intervals, unsigned int k,
+                    std::mt19937_64 &rng) const
+{
+    const size_t count = intervals.size();
+    auto distance = [](const std::vector<double> &a, const std::vector<double> &b) {
+        double sum = 0.;
+        for (size_t i = 0; i < a.size(); ++i)
+            sum += (a[i] - b[i]) * (a[i] - b[i]);
+        return sum;
+    };
+    clustering_t best;
+    best.sum_squared_distance = std::numeric_limits<double>::max();
+    for (int restart = 0; restart < KMEANS_RESTARTS; ++restart) {
+        clustering_t result;
+        // k-means++ initialization: each further center is picked with a
+        // probability proportional to its squared distance from the nearest center.
+        std::vector<double> nearest(count, std::numeric_limits<double>::max());
+        result.centers.push_back(
+            intervals[std::uniform_int_distribution<size_t>(0, count - 1)(rng)]->point);
+        while (result.centers.size() < k) {
+            double total = 0.;
+            for (size_t i = 0; i < count; ++i) {
+                nearest[i] = std::min(
+                    nearest[i], distance(intervals[i]->point, result.centers.back()));
+                total += nearest[i];
+            }
+            size_t pick = 0;
+            if (total > 0.) {
+                double target = std::uniform_real_distribution<double>(0., total)(rng);
+                while (pick + 1 < count && target >= nearest[pick]) {
+                    target -= nearest[pick];
+                    ++pick;
+                }
+            } else
+                pick = std::uniform_int_distribution<size_t>(0, count - 1)(rng);
+            result.centers.push_back(intervals[pick]->point);
+        }
+        // Lloyd's iterations.
+        result.assignment.assign(count, -1);
+        for (int iter = 0; iter < KMEANS_MAX_ITERATIONS; ++iter) {
+            bool changed = false;
+            result.sum_squared_distance = 0.;
+            for (size_t i = 0; i < count; ++i) {
+                int closest = 0;
+                double closest_dist = std::numeric_limits<double>::max();
+                for (unsigned int c = 0; c < k; ++c) {
+                    double dist = distance(intervals[i]->point, result.centers[c]);
+                    if (dist < closest_dist) {
+                        closest_dist = dist;
+                        closest = c;
+                    }
+                }
+                if (result.assignment[i] != closest) {
+                    result.assignment[i] = closest;
+                    changed = true;
+                }
+                result.sum_squared_distance += closest_dist;
+            }
+            if (!changed)
+                break;
+            std::vector<size_t> sizes(k);
+            for (auto &center : result.centers)
+                std::fill(center.begin(), center.end(), 0.);
+            for (size_t i = 0; i < count; ++i) {
+                std::vector<double> &center = result.centers[result.assignment[i]];
+                for (size_t dim = 0; dim < center.size(); ++dim)
+                    center[dim] += intervals[i]->point[dim];
+                ++sizes[result.assignment[i]];
+            }
+            for (unsigned int c = 0; c < k; ++c) {
+                if (sizes[c] == 0) {
+                    // Keep an empty cluster's center on a point so it can recover.
+                    result.centers[c] = intervals[c % count]->point;
+                    continue;
+                }
+                for (double &coord : result.centers[c])
+                    coord /= sizes[c];
+            }
+        }
+        if (result.sum_squared_distance < best.sum_squared_distance)
+            best = std::move(result);
+    }
+    return best;
+}
+
+double
+simpoint_t::bic_score(const std::vector<const interval_t *> &intervals,
+                      const clustering_t &clustering) const
+{
+    // The x-means score (Pelleg and Moore, ICML'00) for identical spherical
+    // Gaussian clusters, as used by SimPoint.
+    const double count = static_cast<double>(intervals.size());
+    const double dims = static_cast<double>(knobs_.projection_dims);
+    const double k = static_cast<double>(clustering.centers.size());
+    std::vector<double> sizes(clustering.centers.size());
+    for (int c : clustering.assignment)
+        ++sizes[c];
+    // The per-dimension variance, bounded away from zero for perfect clusterings.
+    double variance = count > k ? clustering.sum_squared_distance / ((count - k) * dims)
+                                : 0.;
+    variance = std::max(variance, MIN_VARIANCE);
+    const double two_pi = 2. * 3.14159265358979323846;
+    double log_likelihood = -count * dims / 2. * std::log(two_pi * variance) -
+        dims * (count - k) / 2.;
+    for (double size : sizes) {
+        if (size > 0.)
+            log_likelihood += size * std::log(size / count);
+    }
+    double params = (k - 1.) + dims * k + 1.;
+    return log_likelihood - params / 2. * std::log(count);
+}
+
+void
+simpoint_t::compute_representatives()
+{
+    if (computed_)
+        return;
+    computed_ = true;
+    std::vector<const interval_t *> intervals;
+    for (auto &shard : shard_map_) {
+        finish_shard(shard.second);
+        for (const interval_t &interval : shard.second->intervals)
+            intervals.push_back(&interval);
+    }
+    // The shard order is not deterministic.
+    std::sort(intervals.begin(), intervals.end(),
+              [](const interval_t *a, const interval_t *b) {
+                  return a->tid < b->tid ||
+                      (a->tid == b->tid && a->start_instruction < b->start_instruction);
+              });
+    clustered_intervals_ = intervals.size();
+    if (intervals.empty())
+        return;
+    std::mt19937_64 rng(knobs_.seed);
+    // The variance, and thus the score, is undefined when every interval has its
+    // own cluster.
+    unsigned int max_k = static_cast<unsigned int>(std::min<size_t>(
+        knobs_.max_clusters, std::max<size_t>(intervals.size() - 1, 1)));
+    std::vector<clustering_t> clusterings;
+    std::vector<double> scores;
+    for (unsigned int k = 1; k <= max_k; ++k) {
+        clusterings.push_back(cluster(intervals, k, rng));
+        scores.push_back(bic_score(intervals, clusterings.back()));
+        if (knobs_.verbose >= 1) {
+            std::cerr << TOOL_NAME << ": k=" << k << " score " << scores.back()
+                      << "\n";
+        }
+    }
+    double min_score = *std::min_element(scores.begin(), scores.end());
+    double max_score = *std::max_element(scores.begin(), scores.end());
+    size_t chosen = 0;
+    while (scores[chosen] < min_score + BIC_THRESHOLD * (max_score - min_score))
+        ++chosen;
+    const clustering_t &clustering = clusterings[chosen];
+    num_clusters_ = static_cast<unsigned int>(chosen + 1);
+
+    uint64_t total_instrs = 0;
+    std::vector<uint64_t> cluster_instrs(num_clusters_);
+    std::vector<size_t> closest(num_clusters_, intervals.size());
+    std::vector<double> closest_dist(num_clusters_, std::numeric_limits<double>::max());
+    for (size_t i = 0; i < intervals.size(); ++i) {
+        int c = clustering.assignment[i];
+        uint64_t instrs =
+            intervals[i]->stop_instruction - intervals[i]->start_instruction + 1;
+        cluster_instrs[c] += instrs;
+        total_instrs += instrs;
+        double dist = 0.;
+        for (size_t dim = 0; dim < intervals[i]->point.size(); ++dim) {
+            double diff = intervals[i]->point[dim] - clustering.centers[c][dim];
+            dist += diff * diff;
+        }
+        if (dist < closest_dist[c]) {
+            closest_dist[c] = dist;
+            closest[c] = i;
+        }
+    }
+    for (unsigned int c = 0; c < num_clusters_; ++c) {
+        // A cluster emptied during k-means has no representative.
+        if (closest[c] == intervals.size())
+            continue;
+        const interval_t *interval = intervals[closest[c]];
+        representatives_.push_back(
+            { interval->tid, interval->start_instruction, interval->stop_instruction,
+              static_cast<double>(cluster_instrs[c]) / total_instrs,
+              static_cast<int>(c) });
+    }
+    std::sort(representatives_.begin(), representatives_.end(),
+              [](const representative_t &a, const representative_t &b) {
+                  return a.tid < b.tid ||
+                      (a.tid == b.tid && a.start_instruction < b.start_instruction);
+              });
+}
+
+std::vector<simpoint_t::representative_t>
+simpoint_t::get_representatives()
+{
+    compute_representatives();
+    return representatives_;
+}
+
+std::vector<scheduler_t::input_thread_info_t>
+simpoint_t::get_regions_of_interest()
+{
+    compute_representatives();
+    // The scheduler requires each thread's ranges in increasing order, which
+    // get_representatives() provides.
+    std::map<memref_tid_t, std::vector<scheduler_t::range_t>> regions;
+    for (const representative_t &rep : representatives_) {
+        regions[rep.tid].emplace_back(rep.start_instruction, rep.stop_instruction);
+    }
+    std::vector<scheduler_t::input_thread_info_t> result;
+    for (auto &thread : regions) {
+        result.emplace_back(thread.second);
+        result.back().tids.push_back(thread.first);
+    }
+    return result;
+}
+
+void
+simpoint_t::print_representatives(std::ostream &out, bool csv)
+{
+    if (csv)
+        out << "tid,start_instruction,stop_instruction,weight,cluster\n";
+    else {
+        out << std::setw(10) << "Thread" << std::setw(16) << "Start instr"
+            << std::setw(16) << "Stop instr" << std::setw(10) << "Weight"
+            << std::setw(9) << "Cluster"
+            << "\n";
+    }
+    for (const representative_t &rep : representatives_) {
+        if (csv) {
+            out << rep.tid << "," << rep.start_instruction << ","
+                << rep.stop_instruction << "," << std::fixed << std::setprecision(6)
+                << rep.weight << "," << rep.cluster << "\n";
+        } else {
+            out << std::setw(10) << rep.tid << std::setw(16) << rep.start_instruction
+                << std::setw(16) << rep.stop_instruction << std::setw(10) << std::fixed
+                << std::setprecision(4) << rep.weight << std::setw(9) << rep.cluster
+                << "\n";
+        }
+    }
+}
+
+bool
+simpoint_t::print_results()
+{
+    compute_representatives();
+    std::cerr << TOOL_NAME << " results:\n";
+    std::cerr << "Intervals of " << knobs_.interval_instrs
+              << " instructions clustered: " << clustered_intervals_ << "\n";
+    if (skipped_intervals_ > 0) {
+        std::cerr << "Short final intervals not clustered: " << skipped_intervals_
+                  << "\n";
+    }
+    if (representatives_.empty()) {
+        std::cerr << "No complete intervals to cluster.\n";
+        return true;
+    }
+    std::cerr << "Clusters: " << num_clusters_ << "\n";
+    std::cerr << "Representative intervals:\n";
+    print_representatives(std::cerr, /*csv=*/false);
+    if (!knobs_.output_file.empty()) {
+        std::ofstream file(knobs_.output_file);
+        print_representatives(file, /*csv=*/true);
+        if (!file.good()) {
+            error_string_ = "Failed to write " + knobs_.output_file;
+            return false;
+        }
+        std::cerr << "Representative intervals written to " << knobs_.output_file
+                  << "\n";
+    }
+    return true;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -0,0 +1,187 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* simpoint: picks representative intervals by clustering basic block vectors.
+ */
+
+#ifndef _SIMPOINT_H_
+#define _SIMPOINT_H_ 1
+
+#include <stdint.h>
+
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "analysis_tool.h"
+#include "flat_addr_map.h"
+#include "memref.h"
+#include "scheduler.h"
+#include "simpoint_create.h"
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// This tool follows SimPoint (Sherwood et al., ASPLOS'02; Hamerly et al., JILP'05).
+// Each thread is divided into intervals of a fixed instruction count, and each
+// interval is summarized by its basic block vector: the instructions executed in
+// each basic block, normalized by the interval length.  The vectors are randomly
+// projected to a few dimensions and clustered with k-means for each number of
+// clusters up to a limit, picking the smallest count whose Bayesian information
+// criterion score is close to the best.  The interval closest to each cluster
+// center represents the cluster, weighted by the cluster's share of instructions.
+class simpoint_t : public analysis_tool_t {
+public:
+    // A representative interval.
+    struct representative_t {
+        memref_tid_t tid;
+        // The instruction ordinals of the interval within its thread, which are
+        // inclusive and start at 1, as in scheduler_t::range_t.
+        uint64_t start_instruction;
+        uint64_t stop_instruction;
+        // The fraction of all clustered instructions whose cluster this interval
+        // represents.
+        double weight;
+        int cluster;
+    };
+
+    explicit simpoint_t(const simpoint_knobs_t &knobs);
+    ~simpoint_t() override;
+    std::string
+    initialize_shard_type(shard_type_t shard_type) override;
+    bool
+    process_memref(const memref_t &memref) override;
+    bool
+    print_results() override;
+    bool
+    parallel_shard_supported() override;
+    void *
+    parallel_shard_init(int shard_index, void *worker_data) override;
+    bool
+    parallel_shard_exit(void *shard_data) override;
+    bool
+    parallel_shard_memref(void *shard_data, const memref_t &memref) override;
+    std::string
+    parallel_shard_error(void *shard_data) override;
+
+    // Returns the representative intervals, ordered by thread and then by position.
+    // Valid once all shards have been processed.
+    std::vector<representative_t>
+    get_representatives();
+
+    // Returns the representative intervals as regions of interest for each thread,
+    // for use in scheduler_t::input_workload_t::thread_modifiers to simulate only
+    // the representative intervals of the same trace.
+    std::vector<scheduler_t::input_thread_info_t>
+    get_regions_of_interest();
+
+protected:
+    struct interval_t {
+        memref_tid_t tid;
+        uint64_t start_instruction;
+        uint64_t stop_instruction;
+        // The projected, normalized basic block vector.
+        std::vector<double> point;
+    };
+
+    struct shard_data_t {
+        memref_tid_t tid = 0;
+        // The ordinal of the last instruction.
+        uint64_t instrs = 0;
+        uint64_t interval_start = 1;
+        addr_t block_start = 0;
+        uint64_t block_instrs = 0;
+        // The instructions executed in each block of the current interval, keyed
+        // by the block's first pc.
+        flat_addr_map_t<uint64_t> block_counts;
+        std::vector<interval_t> intervals;
+        bool finished = false;
+        std::string error;
+    };
+
+    struct clustering_t {
+        std::vector<std::vector<double>> centers;
+        std::vector<int> assignment;
+        double sum_squared_distance = 0.;
+    };
+
+    void
+    end_interval(shard_data_t *shard);
+    void
+    finish_shard(shard_data_t *shard);
+    // Returns a pseudo-random element of the projection matrix in [-1, 1).
+    double
+    projection(addr_t block_start, unsigned int dim) const;
+
+    clustering_t
+    cluster(const std::vector<const interval_t *> &intervals, unsigned int k,
+            std::mt19937_64 &rng) const;
+    double
+    bic_score(const std::vector<const interval_t *> &intervals,
+              const clustering_t &clustering) const;
+    void
+    compute_representatives();
+    void
+    print_representatives(std::ostream &out, bool csv);
+
+    // Each k-means run picks the best of this many initializations.
+    static constexpr int KMEANS_RESTARTS = 5;
+    static constexpr int KMEANS_MAX_ITERATIONS = 100;
+    // The smallest cluster count whose score reaches this fraction of the range
+    // of scores is chosen, as SimPoint does.
+    static constexpr double BIC_THRESHOLD = 0.9;
+    // Bounds the variance of identical intervals for scoring.
+    static constexpr double MIN_VARIANCE = 1e-12;
+
+    const simpoint_knobs_t knobs_;
+    static const std::string TOOL_NAME;
+    // In parallel operation the keys are "shard indices": just ints.
+    std::unordered_map<memref_tid_t, shard_data_t *> shard_map_;
+    // This mutex is only needed in parallel_shard_init.  In all other accesses to
+    // shard_map (process_memref, print_results) we are single-threaded.
+    std::mutex shard_map_mutex_;
+    bool computed_ = false;
+    uint64_t clustered_intervals_ = 0;
+    uint64_t skipped_intervals_ = 0;
+    unsigned int num_clusters_ = 0;
+    std::vector<representative_t> representatives_;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _SIMPOINT_H_ */
@@ -0,0 +1,92 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* simpoint tool creation */
+
+#ifndef _SIMPOINT_CREATE_H_
+#define _SIMPOINT_CREATE_H_ 1
+
+#include <stdint.h>
+
+#include <string>
+
+#include "analysis_tool.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+/**
+ * @file drmemtrace/simpoint_create.h
+ * @brief DrMemtrace SimPoint phase clustering tool creation.
+ */
+
+/**
+ * The options for simpoint_tool_create().
+ * The options are currently documented in \ref sec_drcachesim_ops.
+ */
+// These options are currently documented in ../common/options.cpp.
+struct simpoint_knobs_t {
+    simpoint_knobs_t()
+        : interval_instrs(10000000)
+        , max_clusters(30)
+        , projection_dims(15)
+        , seed(1)
+        , verbose(0)
+    {
+    }
+    // The length of the intervals of each thread that are clustered.
+    uint64_t interval_instrs;
+    // The largest number of clusters tried.
+    unsigned int max_clusters;
+    // The dimensions the basic block vectors are randomly projected to.
+    unsigned int projection_dims;
+    // Seeds the projection and the k-means initialization.
+    uint64_t seed;
+    // If non-empty, the representative intervals are also written to this file as
+    // comma-separated values.
+    std::string output_file;
+    unsigned int verbose;
+};
+
+/**
+ * Creates an analysis tool which divides each thread into intervals of a fixed
+ * instruction count, clusters the intervals by their basic block vectors, and
+ * reports one representative interval and its weight for each cluster.
+ */
+analysis_tool_t *
+simpoint_tool_create(const simpoint_knobs_t &knobs);
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _SIMPOINT_CREATE_H_ */
@@ -400,6 +400,14 @@ view_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
             std::cerr << "<marker: system call failed: " << memref.marker.marker_value
                       << ">\n";
             break;
+        case TRACE_MARKER_TYPE_SAMPLE_SKIP:
+            std::cerr << "<marker: sampling skipped " << memref.marker.marker_value
+                      << " instructions>\n";
+            break;
+        case TRACE_MARKER_TYPE_SAMPLE_WINDOW:
+            std::cerr << "<marker: sampling window " << memref.marker.marker_value
+                      << ">\n";
+            break;
         case TRACE_MARKER_TYPE_RECORD_ORDINAL:
             std::cerr << "<marker: record ordinal 0x" << std::hex
                       << memref.marker.marker_value << std::dec << ">\n";
@@ -330,10 +330,18 @@ open_new_window_dir(ptr_int_t window_num)
     NOTIFY(2, "Created new window dir %s\n", windir);
 }
 
+static inline bool
+write_behind_enabled();
+
+static void
+write_behind_flush_thread(per_thread_t *data);
+
 static void
 close_thread_file(void *drcontext)
 {
     per_thread_t *data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+    if (write_behind_enabled())
+        write_behind_flush_thread(data);
 #ifdef HAS_SNAPPY
     if (op_offline.get_value() && snappy_enabled()) {
         data->snappy_writer->~snappy_file_writer_t();
@@ -513,6 +521,359 @@ prepend_offline_thread_header(void *drcontext)
     return size;
 }
 
+// Compresses (if requested) and writes the given data to the thread's file.
+// With -write_behind_threads this is called from a write-behind worker.
+static void
+write_thread_file(per_thread_t *data, byte *start, byte *end, thread_id_t tid,
+                  ptr_int_t window)
+{
+    ssize_t size = end - start;
+    ssize_t wrote;
+#ifdef HAS_SNAPPY
+    if (op_offline.get_value() && snappy_enabled())
+        wrote = data->snappy_writer->compress_and_write(start, size);
+    else
+#endif
+#ifdef HAS_ZLIB
+        if (op_offline.get_value() && (op_raw_compress.get_value() == "zlib" ||
+                                       op_raw_compress.get_value() == "gzip")) {
+        data->zstream.next_in = (Bytef *)start;
+        data->zstream.avail_in = static_cast<uInt>(size);
+        int res;
+        do {
+            data->zstream.next_out = (Bytef *)data->buf_compressed;
+            data->zstream.avail_out = static_cast<uInt>(max_buf_size);
+            res = deflate(&data->zstream, Z_NO_FLUSH);
+            NOTIFY(3, "deflate => %d in=%d out=%d => in=%d, out=%d, write=%d\n", res,
+                   size, size, data->zstream.avail_in, data->zstream.avail_out,
+                   max_buf_size - data->zstream.avail_out);
+            DR_ASSERT(res != Z_STREAM_ERROR);
+            wrote = file_ops_func.write_file(data->file, data->buf_compressed,
+                                             max_buf_size - data->zstream.avail_out);
+        } while (data->zstream.avail_out == 0);
+        DR_ASSERT(data->zstream.avail_in == 0);
+        wrote = size;
+    } else
+#endif
+#ifdef HAS_LZ4
+        if (op_offline.get_value() && op_raw_compress.get_value() == "lz4") {
+        size_t res = LZ4F_compressUpdate(data->lzcxt, data->buf_lz4, data->buf_lz4_size,
+                                         start, size, nullptr);
+        DR_ASSERT(!LZ4F_isError(res));
+        wrote = file_ops_func.write_file(data->file, data->buf_lz4, res);
+        DR_ASSERT(static_cast<size_t>(wrote) == res);
+        wrote = size;
+    } else
+#endif
+        wrote = file_ops_func.write_file(data->file, start, size);
+    if (wrote < size) {
+        FATAL("Fatal error: failed to write trace for T%d window %zd: wrote %zd "
+              "of %zd\n", tid, window, wrote, size);
+    }
+}
+
+/***************************************************************************
+ * Write-behind output for -write_behind_threads.
+ *
+ * Full trace buffers are queued to a pool of client threads which compress and
+ * write them, so the app thread only pays for swapping in a clean buffer.  Each
+ * app thread is bound to a single worker to keep its compressor state and file
+ * writes in order.  Queued buffers come from a global pool bounded by
+ * -write_behind_max_mem; an app thread only blocks when that cap is reached.
+ */
+
+struct write_job_t {
+    per_thread_t *data;
+    // The max_buf_size allocation, which is reset and recycled once written.
+    byte *buf;
+    byte *start;
+    byte *end;
+    thread_id_t tid;
+    ptr_int_t window;
+    write_job_t *next;
+};
+
+struct write_behind_worker_t {
+    // Held while processing jobs.  DR does not suspend a client thread holding a
+    // lock, so a job is never abandoned partway through at process exit.  An app
+    // thread acquires it to flush its own jobs or to help when it is blocked.
+    void *busy_lock;
+    void *queue_lock;
+    void *ready;
+    write_job_t *head;
+    write_job_t *tail;
+};
+
+static write_behind_worker_t *write_behind_workers;
+static std::atomic<uint> next_write_behind_worker;
+static void *write_pool_lock;
+static void *write_pool_freed;
+// Clean buffers, linked through their first pointer-sized slot.
+static byte *write_pool_free_list;
+// The size of all free and queued buffers, bounded by -write_behind_max_mem.
+static size_t write_pool_bytes;
+
+static inline bool
+write_behind_enabled()
+{
+    return write_behind_workers != nullptr;
+}
+
+static write_job_t *
+write_behind_dequeue(write_behind_worker_t *worker)
+{
+    dr_mutex_lock(worker->queue_lock);
+    write_job_t *job = worker->head;
+    if (job != nullptr) {
+        worker->head = job->next;
+        if (worker->head == nullptr)
+            worker->tail = nullptr;
+    }
+    dr_mutex_unlock(worker->queue_lock);
+    return job;
+}
+
+// The caller must hold the busy_lock of the job's worker.
+static void
+write_behind_process(write_job_t *job)
+{
+    write_thread_file(job->data, job->start, job->end, job->tid, job->window);
+    // Restore the zeroed buffer and redzone sentinel our instrumentation expects.
+    size_t used = job->end - job->buf;
+    memset(job->buf, 0, used < trace_buf_size ? used : trace_buf_size);
+    if (used > trace_buf_size)
+        memset(job->buf + trace_buf_size, -1, redzone_size);
+    dr_mutex_lock(write_pool_lock);
+    *(byte **)job->buf = write_pool_free_list;
+    write_pool_free_list = job->buf;
+    dr_mutex_unlock(write_pool_lock);
+    dr_event_signal(write_pool_freed);
+    dr_global_free(job, sizeof(*job));
+}
+
+static void
+write_behind_thread(void *arg)
+{
+    write_behind_worker_t *worker = (write_behind_worker_t *)arg;
+    // Creating several client threads before any of them has started running is
+    // not reliable, so each worker creates the next one.
+    if (worker + 1 < write_behind_workers + op_write_behind_threads.get_value() &&
+        !dr_create_client_thread(write_behind_thread, worker + 1))
+        FATAL("Fatal error: failed to create write-behind thread.\n");
+    while (true) {
+        dr_mutex_lock(worker->busy_lock);
+        write_job_t *job = write_behind_dequeue(worker);
+        if (job != nullptr)
+            write_behind_process(job);
+        dr_mutex_unlock(worker->busy_lock);
+        if (job == nullptr)
+            dr_event_wait(worker->ready);
+    }
+}
+
+// Processes one queued job from any idle worker.  Returns whether one was found.
+static bool
+write_behind_help()
+{
+    for (uint i = 0; i < op_write_behind_threads.get_value(); ++i) {
+        write_behind_worker_t *worker = &write_behind_workers[i];
+        if (!dr_mutex_trylock(worker->busy_lock))
+            continue;
+        write_job_t *job = write_behind_dequeue(worker);
+        if (job != nullptr)
+            write_behind_process(job);
+        dr_mutex_unlock(worker->busy_lock);
+        if (job != nullptr)
+            return true;
+    }
+    return false;
+}
+
+// Returns a clean buffer, blocking if the pool is at its cap.
+static byte *
+write_behind_get_buffer(per_thread_t *data)
+{
+    uint64 stall_start = 0;
+    byte *buf = nullptr;
+    bool allocate = false;
+    while (true) {
+        dr_mutex_lock(write_pool_lock);
+        if (write_pool_free_list != nullptr) {
+            buf = write_pool_free_list;
+            write_pool_free_list = *(byte **)buf;
+            *(byte **)buf = nullptr;
+        } else if (write_pool_bytes == 0 ||
+                   write_pool_bytes + max_buf_size <=
+                       op_write_behind_max_mem.get_value()) {
+            write_pool_bytes += max_buf_size;
+            allocate = true;
+        }
+        bool more_free = write_pool_free_list != nullptr;
+        dr_mutex_unlock(write_pool_lock);
+        if (buf != nullptr || allocate) {
+            // The pool event only wakes one waiter at a time.
+            if (more_free && stall_start != 0)
+                dr_event_signal(write_pool_freed);
+            break;
+        }
+        if (stall_start == 0)
+            stall_start = dr_get_microseconds();
+        // Rather than just waiting, write out a queued buffer ourselves if some
+        // worker is idle: this also ensures progress at process exit when the
+        // workers have been terminated.
+        if (!write_behind_help())
+            dr_event_wait(write_pool_freed);
+    }
+    if (stall_start != 0)
+        data->write_behind_stall_us += dr_get_microseconds() - stall_start;
+    if (allocate) {
+        buf = (byte *)dr_raw_mem_alloc(max_buf_size, DR_MEMPROT_READ | DR_MEMPROT_WRITE,
+                                       NULL);
+        if (buf == NULL)
+            FATAL("Fatal error: out of memory for write-behind buffers.\n");
+        /* dr_raw_mem_alloc guarantees to give us zeroed memory. */
+        memset(buf + trace_buf_size, -1, redzone_size);
+    }
+    return buf;
+}
+
+// Queues [start, end) for writing to the thread's file.  If swap_buffer is set,
+// the range lies within data->buf_base, which is handed off as is and replaced by
+// a clean buffer; otherwise the data is copied.
+static void
+write_behind_submit(per_thread_t *data, byte *start, byte *end, thread_id_t tid,
+                    ptr_int_t window, bool swap_buffer)
+{
+    byte *buf = write_behind_get_buffer(data);
+    write_job_t *job = (write_job_t *)dr_global_alloc(sizeof(*job));
+    job->data = data;
+    job->tid = tid;
+    job->window = window;
+    job->next = nullptr;
+    if (swap_buffer) {
+        job->buf = data->buf_base;
+        job->start = start;
+        job->end = end;
+        data->buf_base = buf;
+    } else {
+        DR_ASSERT(end - start <= static_cast<ssize_t>(max_buf_size));
+        memcpy(buf, start, end - start);
+        job->buf = buf;
+        job->start = buf;
+        job->end = buf + (end - start);
+    }
+    write_behind_worker_t *worker = &write_behind_workers[data->write_behind_worker];
+    dr_mutex_lock(worker->queue_lock);
+    if (worker->tail == nullptr)
+        worker->head = job;
+    else
+        worker->tail->next = job;
+    worker->tail = job;
+    dr_mutex_unlock(worker->queue_lock);
+    dr_event_signal(worker->ready);
+}
+
+// Writes out all of the thread's queued data.  Must be called before the thread's
+// file or compressor state is finalized.
+static void
+write_behind_flush_thread(per_thread_t *data)
+{
+    uint64 flush_start = dr_get_microseconds();
+    write_behind_worker_t *worker = &write_behind_workers[data->write_behind_worker];
+    // Once we hold the busy lock none of our jobs can be in progress elsewhere.
+    dr_mutex_lock(worker->busy_lock);
+    write_job_t *mine = nullptr, **mine_tail = &mine;
+    dr_mutex_lock(worker->queue_lock);
+    write_job_t **prev = &worker->head;
+    worker->tail = nullptr;
+    for (write_job_t *job = worker->head, *next; job != nullptr; job = next) {
+        next = job->next;
+        if (job->data == data) {
+            *prev = next;
+            job->next = nullptr;
+            *mine_tail = job;
+            mine_tail = &job->next;
+        } else {
+            worker->tail = job;
+            prev = &job->next;
+        }
+    }
+    dr_mutex_unlock(worker->queue_lock);
+    for (write_job_t *job = mine, *next; job != nullptr; job = next) {
+        next = job->next;
+        write_behind_process(job);
+    }
+    dr_mutex_unlock(worker->busy_lock);
+    data->write_behind_stall_us += dr_get_microseconds() - flush_start;
+}
+
+static void
+write_behind_init()
+{
+    write_pool_lock = dr_mutex_create();
+    write_pool_freed = dr_event_create();
+    write_pool_free_list = nullptr;
+    write_pool_bytes = 0;
+    uint count = op_write_behind_threads.get_value();
+    write_behind_workers = (write_behind_worker_t *)dr_global_alloc(
+        count * sizeof(*write_behind_workers));
+    for (uint i = 0; i < count; ++i) {
+        write_behind_worker_t *worker = &write_behind_workers[i];
+        worker->busy_lock = dr_mutex_create();
+        worker->queue_lock = dr_mutex_create();
+        worker->ready = dr_event_create();
+        worker->head = nullptr;
+        worker->tail = nullptr;
+    }
+    if (!dr_create_client_thread(write_behind_thread, &write_behind_workers[0]))
+        FATAL("Fatal error: failed to create write-behind thread.\n");
+}
+
+static void
+write_behind_free_pool()
+{
+    while (write_pool_free_list != nullptr) {
+        byte *buf = write_pool_free_list;
+        write_pool_free_list = *(byte **)buf;
+        dr_raw_mem_free(buf, max_buf_size);
+    }
+    write_pool_bytes = 0;
+}
+
+// Any lock still held belonged to a worker that does not exist in a fork child.
+static void
+write_behind_destroy_lock(void *lock)
+{
+    if (dr_mutex_trylock(lock)) {
+        dr_mutex_unlock(lock);
+        dr_mutex_destroy(lock);
+    }
+}
+
+static void
+write_behind_exit()
+{
+    for (uint i = 0; i < op_write_behind_threads.get_value(); ++i) {
+        write_behind_worker_t *worker = &write_behind_workers[i];
+        // Each thread flushes its own jobs at exit, so anything left here was
+        // queued by the parent of a fork child.
+        for (write_job_t *job = worker->head, *next; job != nullptr; job = next) {
+            next = job->next;
+            dr_raw_mem_free(job->buf, max_buf_size);
+            dr_global_free(job, sizeof(*job));
+        }
+        write_behind_destroy_lock(worker->busy_lock);
+        write_behind_destroy_lock(worker->queue_lock);
+        dr_event_destroy(worker->ready);
+    }
+    dr_global_free(write_behind_workers,
+                   op_write_behind_threads.get_value() * sizeof(*write_behind_workers));
+    write_behind_workers = nullptr;
+    write_behind_free_pool();
+    write_behind_destroy_lock(write_pool_lock);
+    dr_event_destroy(write_pool_freed);
+}
+
 static inline byte *
 atomic_pipe_write(void *drcontext, byte *pipe_start, byte *pipe_end, ptr_int_t window)
 {
@@ -546,54 +907,12 @@ write_trace_data(void *drcontext, byte *towrite_start, byte *towrite_end,
                                            max_buf_size)) {
                 FATAL("Fatal error: failed to hand off trace\n");
             }
+        } else if (write_behind_enabled()) {
+            write_behind_submit(data, towrite_start, towrite_end,
+                                dr_get_thread_id(drcontext), window, false);
         } else {
-            ssize_t wrote;
-#ifdef HAS_SNAPPY
-            if (op_offline.get_value() && snappy_enabled())
-                wrote = data->snappy_writer->compress_and_write(towrite_start, size);
-            else
-#endif
-#ifdef HAS_ZLIB
-                if (op_offline.get_value() &&
-                    (op_raw_compress.get_value() == "zlib" ||
-                     op_raw_compress.get_value() == "gzip")) {
-                data->zstream.next_in = (Bytef *)towrite_start;
-                data->zstream.avail_in = static_cast<uInt>(size);
-                int res;
-                do {
-                    data->zstream.next_out = (Bytef *)data->buf_compressed;
-                    data->zstream.avail_out = static_cast<uInt>(max_buf_size);
-                    res = deflate(&data->zstream, Z_NO_FLUSH);
-                    NOTIFY(3, "deflate => %d in=%d out=%d => in=%d, out=%d, write=%d\n",
-                           res, size, size, data->zstream.avail_in,
-                           data->zstream.avail_out,
-                           max_buf_size - data->zstream.avail_out);
-                    DR_ASSERT(res != Z_STREAM_ERROR);
-                    wrote =
-                        file_ops_func.write_file(data->file, data->buf_compressed,
-                                                 max_buf_size - data->zstream.avail_out);
-                } while (data->zstream.avail_out == 0);
-                DR_ASSERT(data->zstream.avail_in == 0);
-                wrote = size;
-            } else
-#endif
-#ifdef HAS_LZ4
-                if (op_offline.get_value() && op_raw_compress.get_value() == "lz4") {
-                size_t res =
-                    LZ4F_compressUpdate(data->lzcxt, data->buf_lz4, data->buf_lz4_size,
-                                        towrite_start, size, nullptr);
-                DR_ASSERT(!LZ4F_isError(res));
-                wrote = file_ops_func.write_file(data->file, data->buf_lz4, res);
-                DR_ASSERT(static_cast<size_t>(wrote) == res);
-                wrote = size;
-            } else
-#endif
-                wrote = file_ops_func.write_file(data->file, towrite_start, size);
-            if (wrote < size) {
-                FATAL("Fatal error: failed to write trace for T%d window %zd: wrote %zd "
-                      "of %zd\n",
-                      dr_get_thread_id(drcontext), get_local_window(data), wrote, size);
-            }
+            write_thread_file(data, towrite_start, towrite_end,
+                              dr_get_thread_id(drcontext), window);
         }
         return towrite_start;
     } else {
@@ -739,9 +1058,12 @@ is_ok_to_split_before(trace_type_t type, size_t size)
         type == TRACE_TYPE_THREAD_EXIT || op_L0I_filter.get_value();
 }
 
+// If full_buffer is set, [buf_base, buf_ptr) is the thread's whole trace buffer and
+// its contents are not needed afterward, which lets write-behind output hand off
+// the buffer itself.  data->buf_base is then replaced with a clean buffer.
 static uint
 output_buffer(void *drcontext, per_thread_t *data, byte *buf_base, byte *buf_ptr,
-              size_t header_size)
+              size_t header_size, bool full_buffer = false)
 {
     byte *pipe_start = buf_base;
     if (!op_offline.get_value()) {
@@ -808,6 +1130,12 @@ output_buffer(void *drcontext, per_thread_t *data, byte *buf_base, byte *buf_ptr
                                       instru->get_entry_size(pipe_start + header_size)));
             atomic_pipe_write(drcontext, pipe_start, buf_ptr, get_local_window(data));
         }
+    } else if (full_buffer && write_behind_enabled() &&
+               // The L0 filter transition can leave buf_base mid-allocation.
+               ALIGN_BACKWARD(data->buf_base, dr_page_size()) ==
+                   reinterpret_cast<ptr_uint_t>(data->buf_base)) {
+        write_behind_submit(data, pipe_start, buf_ptr, dr_get_thread_id(drcontext),
+                            get_local_window(data), true);
     } else {
         write_trace_data(drcontext, pipe_start, buf_ptr, get_local_window(data));
     }
@@ -1180,6 +1508,7 @@ process_and_output_buffer(void *drcontext, bool skip_size_cap)
         }
     }
 
+    byte *filled_buf_base = data->buf_base;
     if (do_write) {
         if (op_L0_filter_until_instrs.get_value() && mode == BBDUP_MODE_L0_FILTER) {
             uintptr_t toadd =
@@ -1230,11 +1559,12 @@ process_and_output_buffer(void *drcontext, bool skip_size_cap)
         if (op_use_physical.get_value()) {
             skip = process_buffer_for_physaddr(drcontext, data, header_size, buf_ptr);
         }
-        current_num_refs +=
-            output_buffer(drcontext, data, data->buf_base + skip, buf_ptr, header_size);
+        current_num_refs += output_buffer(drcontext, data, data->buf_base + skip,
+                                          buf_ptr, header_size, true);
     }
 
-    if (file_ops_func.handoff_buf == NULL) {
+    // Write-behind output swaps in an already-clean buffer.
+    if (file_ops_func.handoff_buf == NULL && data->buf_base == filled_buf_base) {
         // Our instrumentation reads from buffer and skips the clean call if the
         // content is 0, so we need set zero in the trace buffer and set non-zero
         // in redzone.
@@ -1309,6 +1639,11 @@ init_thread_io(void *drcontext)
             data->buf_lz4_size, DR_MEMPROT_READ | DR_MEMPROT_WRITE, nullptr));
     }
 #endif
+    if (write_behind_enabled()) {
+        data->write_behind_worker =
+            next_write_behind_worker.fetch_add(1, std::memory_order_relaxed) %
+            op_write_behind_threads.get_value();
+    }
 
     if (op_use_physical.get_value()) {
         if (!data->physaddr.init()) {
@@ -1477,10 +1812,39 @@ init_io()
     DR_ASSERT(cur_window_instr_count.is_lock_free());
 }
 
+void
+start_io_threads()
+{
+    if (op_write_behind_threads.get_value() > 0) {
+        if (!op_offline.get_value() || file_ops_func.handoff_buf != NULL) {
+            NOTIFY(0,
+                   "-write_behind_threads requires -offline without a buffer handoff: "
+                   "ignoring\n");
+        } else
+            write_behind_init();
+    }
+}
+
+#ifdef UNIX
+void
+fork_init_io()
+{
+    // The parent's workers write out whatever the parent had queued: the child
+    // drops those jobs and starts its own workers.  A buffer that was mid-write
+    // in the parent at the time of the fork is not reachable and is leaked.
+    if (write_behind_enabled()) {
+        write_behind_exit();
+        write_behind_init();
+    }
+}
+#endif
+
 void
 exit_io()
 {
     notify_beyond_global_max_once = 0;
+    if (write_behind_enabled())
+        write_behind_exit();
 }
 
 } // namespace drmemtrace
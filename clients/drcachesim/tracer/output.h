@@ -61,6 +61,16 @@ init_buffers(per_thread_t *data);
 void
 init_io();
 
+// Creates any internal output threads.  This must be called once the rest of
+// the client's initialization is complete.
+void
+start_io_threads();
+
+#ifdef UNIX
+void
+fork_init_io();
+#endif
+
 void
 exit_io();
 
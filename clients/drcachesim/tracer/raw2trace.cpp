@@ -57,13 +57,16 @@
 
 #include <algorithm>
 #include <array>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <deque>
+#include <fstream>
 #include <iomanip>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <thread>
@@ -981,6 +984,24 @@ raw2trace_t::process_syscall_pt(raw2trace_thread_data_t *tdata, uint64_t syscall
 }
 #endif
 
+bool
+raw2trace_t::process_thread_start(raw2trace_thread_data_t *tdata,
+                                  const offline_entry_t *in_entry)
+{
+    tdata->saw_header = trace_metadata_reader_t::is_thread_start(
+        in_entry, &tdata->error, &tdata->version, &tdata->file_type);
+    VPRINT(2, "Trace file version is %d; type is %d\n", tdata->version,
+           tdata->file_type);
+    if (!tdata->error.empty())
+        return false;
+    // We do not complain if tdata->version >= OFFLINE_FILE_VERSION_ENCODINGS
+    // and encoding_file_ == INVALID_FILE since we have several tests with
+    // that setup.  We do complain during processing about unknown instructions.
+    if (tdata->saw_header)
+        return process_header(tdata);
+    return true;
+}
+
 bool
 raw2trace_t::process_next_thread_buffer(raw2trace_thread_data_t *tdata,
                                         OUT bool *end_of_record)
@@ -992,102 +1013,104 @@ raw2trace_t::process_next_thread_buffer(raw2trace_thread_data_t *tdata,
         // We look for the initial header here rather than the top of
         // process_thread_file() to support use cases where buffers are passed from
         // another source.
-        tdata->saw_header = trace_metadata_reader_t::is_thread_start(
-            in_entry, &tdata->error, &tdata->version, &tdata->file_type);
-        VPRINT(2, "Trace file version is %d; type is %d\n", tdata->version,
-               tdata->file_type);
-        if (!tdata->error.empty())
+        if (!process_thread_start(tdata, in_entry))
             return false;
-        // We do not complain if tdata->version >= OFFLINE_FILE_VERSION_ENCODINGS
-        // and encoding_file_ == INVALID_FILE since we have several tests with
-        // that setup.  We do complain during processing about unknown instructions.
-        if (tdata->saw_header) {
-            if (!process_header(tdata))
-                return false;
-        }
         in_entry = get_next_entry(tdata);
     }
-    byte *buf_base = reinterpret_cast<byte *>(get_write_buffer(tdata));
     bool last_bb_handled = true;
     for (; in_entry != nullptr; in_entry = get_next_entry(tdata)) {
-        // Make a copy to avoid clobbering the entry we pass to process_offline_entry()
-        // when it calls get_next_entry() on its own.
-        offline_entry_t entry = *in_entry;
-        if (entry.timestamp.type == OFFLINE_TYPE_TIMESTAMP) {
-            VPRINT(2, "Thread %u timestamp 0x" ZHEX64_FORMAT_STRING "\n",
-                   (uint)tdata->tid, (uint64)entry.timestamp.usec);
-            accumulate_to_statistic(tdata, RAW2TRACE_STAT_EARLIEST_TRACE_TIMESTAMP,
-                                    static_cast<uint64>(entry.timestamp.usec));
-            accumulate_to_statistic(tdata, RAW2TRACE_STAT_LATEST_TRACE_TIMESTAMP,
-                                    static_cast<uint64>(entry.timestamp.usec));
-            byte *buf = buf_base +
-                trace_metadata_writer_t::write_timestamp(buf_base,
-                                                         (uintptr_t)entry.timestamp.usec);
-            tdata->last_timestamp_ = entry.timestamp.usec;
-            if ((uint)(buf - buf_base) >= WRITE_BUFFER_SIZE) {
-                tdata->error = "Too many entries";
-                return false;
-            }
-            if (!write(tdata, reinterpret_cast<trace_entry_t *>(buf_base),
-                       reinterpret_cast<trace_entry_t *>(buf)))
-                return false;
-            continue;
+        if (!process_thread_buffer_entry(tdata, in_entry, end_of_record,
+                                         &last_bb_handled))
+            return false;
+    }
+    return true;
+}
+
+bool
+raw2trace_t::process_thread_buffer_entry(raw2trace_thread_data_t *tdata,
+                                         const offline_entry_t *in_entry,
+                                         OUT bool *end_of_record,
+                                         INOUT bool *last_bb_handled)
+{
+    byte *buf_base = reinterpret_cast<byte *>(get_write_buffer(tdata));
+    // Make a copy to avoid clobbering the entry we pass to process_offline_entry()
+    // when it calls get_next_entry() on its own.
+    offline_entry_t entry = *in_entry;
+    if (entry.timestamp.type == OFFLINE_TYPE_TIMESTAMP) {
+        VPRINT(2, "Thread %u timestamp 0x" ZHEX64_FORMAT_STRING "\n", (uint)tdata->tid,
+               (uint64)entry.timestamp.usec);
+        accumulate_to_statistic(tdata, RAW2TRACE_STAT_EARLIEST_TRACE_TIMESTAMP,
+                                static_cast<uint64>(entry.timestamp.usec));
+        accumulate_to_statistic(tdata, RAW2TRACE_STAT_LATEST_TRACE_TIMESTAMP,
+                                static_cast<uint64>(entry.timestamp.usec));
+        byte *buf = buf_base +
+            trace_metadata_writer_t::write_timestamp(buf_base,
+                                                     (uintptr_t)entry.timestamp.usec);
+        tdata->last_timestamp_ = entry.timestamp.usec;
+        if ((uint)(buf - buf_base) >= WRITE_BUFFER_SIZE) {
+            tdata->error = "Too many entries";
+            return false;
         }
+        return write(tdata, reinterpret_cast<trace_entry_t *>(buf_base),
+                     reinterpret_cast<trace_entry_t *>(buf));
+    }
 #ifdef BUILD_PT_POST_PROCESSOR
-        if (entry.extended.type == OFFLINE_TYPE_EXTENDED &&
-            entry.extended.ext == OFFLINE_EXT_TYPE_MARKER &&
-            entry.extended.valueB == TRACE_MARKER_TYPE_SYSCALL_IDX) {
-            if (!process_syscall_pt(tdata, entry.extended.valueA))
-                return false;
-            continue;
-        }
+    if (entry.extended.type == OFFLINE_TYPE_EXTENDED &&
+        entry.extended.ext == OFFLINE_EXT_TYPE_MARKER &&
+        entry.extended.valueB == TRACE_MARKER_TYPE_SYSCALL_IDX) {
+        return process_syscall_pt(tdata, entry.extended.valueA);
+    }
 #endif
-        // Append delayed branches at the end or before xfer or window-change
-        // markers; else, delay until we see a non-cti inside a block, to handle
-        // double branches (i#5141) and to group all (non-xfer) markers with a new
-        // timestamp.
-        if (entry.extended.type == OFFLINE_TYPE_EXTENDED &&
-            (entry.extended.ext == OFFLINE_EXT_TYPE_FOOTER ||
-             (entry.extended.ext == OFFLINE_EXT_TYPE_MARKER &&
-              (entry.extended.valueB == TRACE_MARKER_TYPE_KERNEL_EVENT ||
-               entry.extended.valueB == TRACE_MARKER_TYPE_KERNEL_XFER ||
-               (entry.extended.valueB == TRACE_MARKER_TYPE_WINDOW_ID &&
-                entry.extended.valueA != tdata->last_window))))) {
-            app_pc next_pc = nullptr;
-            // Get the next instr's pc from the interruption value in the marker
-            // (a record for the next instr itself won't appear until the signal
-            // returns, if that happens).
-            if (entry.extended.ext == OFFLINE_EXT_TYPE_MARKER &&
-                entry.extended.valueB == TRACE_MARKER_TYPE_KERNEL_EVENT) {
-                uintptr_t marker_val = 0;
-                if (!get_marker_value(tdata, &in_entry, &marker_val))
-                    return false;
-                next_pc = reinterpret_cast<app_pc>(marker_val);
-                // Restore in case it was a two-record value.
-                unread_last_entry(tdata);
-                in_entry = get_next_entry(tdata);
-                entry = *in_entry;
-            } // Else we will delete the final branch in append_delayed_branch().
-            if (!append_delayed_branch(tdata, next_pc))
-                return false;
-        }
+    // Append delayed branches at the end or before xfer or window-change
+    // markers; else, delay until we see a non-cti inside a block, to handle
+    // double branches (i#5141) and to group all (non-xfer) markers with a new
+    // timestamp.
+    if (entry.extended.type == OFFLINE_TYPE_EXTENDED &&
+        (entry.extended.ext == OFFLINE_EXT_TYPE_FOOTER ||
+         (entry.extended.ext == OFFLINE_EXT_TYPE_MARKER &&
+          (entry.extended.valueB == TRACE_MARKER_TYPE_KERNEL_EVENT ||
+           entry.extended.valueB == TRACE_MARKER_TYPE_KERNEL_XFER ||
+           (entry.extended.valueB == TRACE_MARKER_TYPE_WINDOW_ID &&
+            entry.extended.valueA != tdata->last_window))))) {
+        app_pc next_pc = nullptr;
+        // Get the next instr's pc from the interruption value in the marker
+        // (a record for the next instr itself won't appear until the signal
+        // returns, if that happens).
         if (entry.extended.ext == OFFLINE_EXT_TYPE_MARKER &&
-            entry.extended.valueB == TRACE_MARKER_TYPE_WINDOW_ID)
-            tdata->last_window = entry.extended.valueA;
-        bool flush_decode_cache = false;
-        bool success = process_offline_entry(tdata, &entry, tdata->tid, end_of_record,
-                                             &last_bb_handled, &flush_decode_cache);
-        if (flush_decode_cache)
-            decode_cache_[tdata->worker].clear();
-        if (!success)
+            entry.extended.valueB == TRACE_MARKER_TYPE_KERNEL_EVENT) {
+            uintptr_t marker_val = 0;
+            if (!get_marker_value(tdata, &in_entry, &marker_val))
+                return false;
+            next_pc = reinterpret_cast<app_pc>(marker_val);
+            // Restore in case it was a two-record value.
+            unread_last_entry(tdata);
+            in_entry = get_next_entry(tdata);
+            entry = *in_entry;
+        } // Else we will delete the final branch in append_delayed_branch().
+        if (!append_delayed_branch(tdata, next_pc))
             return false;
     }
-    return true;
+    if (entry.extended.ext == OFFLINE_EXT_TYPE_MARKER &&
+        entry.extended.valueB == TRACE_MARKER_TYPE_WINDOW_ID)
+        tdata->last_window = entry.extended.valueA;
+    bool flush_decode_cache = false;
+    bool success = process_offline_entry(tdata, &entry, tdata->tid, end_of_record,
+                                         last_bb_handled, &flush_decode_cache);
+    if (flush_decode_cache)
+        decode_cache_[tdata->worker].clear();
+    return success;
 }
 
 bool
 raw2trace_t::process_thread_file(raw2trace_thread_data_t *tdata)
 {
+    if (split_files_ && !process_thread_file_in_segments(tdata)) {
+        std::stringstream ss;
+        ss << "Failed to process file for thread " << (uint)tdata->tid << ": "
+           << tdata->error;
+        tdata->error = ss.str();
+        return false;
+    }
     bool end_of_file = false;
     while (!end_of_file) {
         VPRINT(4, "About to read thread #%d==%d at pos %d\n", tdata->index,
@@ -1126,6 +1149,436 @@ raw2trace_t::process_thread_file(raw2trace_thread_data_t *tdata)
     return true;
 }
 
+// A thread's file is split into segments just before the first block after a
+// timestamp once a segment is large enough.  Such a block's first instruction is
+// required to be a non-branch, non-syscall, non-rep-string instruction so that
+// converting it depends on no state other than what is checked or replayed in
+// stitch_thread_segment(): in particular, it flushes any delayed branches using a
+// pc we can compute up front.
+struct raw2trace_t::thread_segment_t {
+    // The raw entries, ending with the first entry of the next segment.
+    std::vector<offline_entry_t> entries;
+    // The original pc of the first instruction of the next segment.
+    app_pc next_pc = nullptr;
+    // Whether the segment ends at a segment start (else it ends the splittable
+    // part of the file).
+    bool has_next = false;
+    // State for speculative conversion, which is initialized as though the
+    // segment starts in the state the reader predicted.
+    uint64 start_window = 0;
+    bool start_saw_rseq_entry = false;
+    std::unique_ptr<raw2trace_thread_data_t> speculative;
+    segment_writes_t writes;
+    bool speculation_succeeded = false;
+    bool done = false;
+};
+
+struct raw2trace_t::segment_reader_t {
+    // The first entry of the next segment, already read.
+    offline_entry_t next_start;
+    bool have_next_start = false;
+    bool at_end = false;
+    // The state of the conversion at the reading point, as best we can tell
+    // without converting.  Mispredictions cause serial conversion of a segment.
+    uint64 last_window = 0;
+    bool saw_rseq_entry = false;
+};
+
+// The segments of one file which no worker has taken yet.  Guarded by the
+// segment_pool_t lock.
+struct raw2trace_t::segment_queue_t {
+    std::deque<thread_segment_t *> pending;
+    // The raw entries read from the file so far.
+    uint64 entries_read = 0;
+};
+
+// The files being split into segments, shared by all workers.  A single lock
+// suffices as it is only taken once per segment.
+struct raw2trace_t::segment_pool_t {
+    std::mutex lock;
+    std::condition_variable cond;
+    std::vector<segment_queue_t *> queues;
+    // The workers still converting files of their own.
+    int busy_workers = 0;
+};
+
+// Presents a segment's raw entries as a std::istream for get_next_entry().
+class segment_streambuf_t : public std::streambuf {
+public:
+    explicit segment_streambuf_t(std::vector<offline_entry_t> &entries)
+    {
+        char *start = reinterpret_cast<char *>(entries.data());
+        setg(start, start, start + entries.size() * sizeof(entries[0]));
+    }
+};
+
+bool
+raw2trace_t::is_segment_start(const offline_entry_t &entry, OUT app_pc *orig_pc)
+{
+    if (entry.pc.type != OFFLINE_TYPE_PC || entry.pc.instr_count == 0 ||
+        entry.pc.modidx == PC_MODIDX_INVALID ||
+        (entry.pc.modidx == 0 && entry.pc.modoffs == 0) ||
+        entry.pc.modidx >= modvec_().size() ||
+        modvec_()[entry.pc.modidx].map_seg_base == NULL)
+        return false;
+    app_pc start_pc = modmap_().get_map_pc(entry.pc.modidx, entry.pc.modoffs);
+    app_pc pc = start_pc;
+    *orig_pc =
+        modmap_().get_orig_pc_from_map_pc(start_pc, entry.pc.modidx, entry.pc.modoffs);
+    instr_summary_t desc;
+    if (!instr_summary_t::construct(dcontext_, start_pc, &pc, *orig_pc, &desc, 0))
+        return false;
+    return !desc.is_cti() && !desc.is_syscall() &&
+        desc.type() != TRACE_TYPE_INSTR_MAYBE_FETCH;
+}
+
+void
+raw2trace_t::read_thread_segment(raw2trace_thread_data_t *tdata,
+                                 segment_reader_t *reader, thread_segment_t *segment)
+{
+    // We give up on splitting if we cannot find a split point in a reasonable
+    // distance, to bound our memory usage.
+    static constexpr uint64_t MAX_SEGMENT_SCALE = 8;
+    segment->speculative.reset(new raw2trace_thread_data_t);
+    raw2trace_thread_data_t *spec = segment->speculative.get();
+    spec->index = tdata->index;
+    spec->tid = tdata->tid;
+    spec->version = tdata->version;
+    spec->file_type = tdata->file_type;
+    spec->cache_line_size = tdata->cache_line_size;
+    spec->saw_header = true;
+    spec->rseq_want_rollback_ = tdata->rseq_want_rollback_;
+    segment->start_saw_rseq_entry = tdata->rseq_want_rollback_ && reader->saw_rseq_entry;
+    segment->start_window = reader->last_window;
+    spec->rseq_ever_saw_entry_ = segment->start_saw_rseq_entry;
+    spec->last_window = segment->start_window;
+    spec->write_log = &segment->writes;
+    if (reader->have_next_start) {
+        segment->entries.push_back(reader->next_start);
+        reader->have_next_start = false;
+    }
+    bool after_timestamp = false;
+    while (true) {
+        offline_entry_t entry;
+        if (!tdata->pre_read.empty()) {
+            entry = tdata->pre_read.front();
+            tdata->pre_read.pop_front();
+        } else if (!tdata->thread_file->read(reinterpret_cast<char *>(&entry),
+                                             sizeof(entry))) {
+            reader->at_end = true;
+            return;
+        }
+        segment->entries.push_back(entry);
+        if (segment->entries.size() > segment_entries_ && after_timestamp &&
+            is_segment_start(entry, &segment->next_pc)) {
+            segment->has_next = true;
+            reader->next_start = entry;
+            reader->have_next_start = true;
+            return;
+        }
+        if (entry.timestamp.type == OFFLINE_TYPE_TIMESTAMP) {
+            after_timestamp = true;
+            continue;
+        }
+        bool is_marker = entry.extended.type == OFFLINE_TYPE_EXTENDED &&
+            entry.extended.ext == OFFLINE_EXT_TYPE_MARKER;
+        after_timestamp = after_timestamp && is_marker &&
+            entry.extended.valueB == TRACE_MARKER_TYPE_CPU_ID;
+        if (is_marker && entry.extended.valueB == TRACE_MARKER_TYPE_WINDOW_ID)
+            reader->last_window = entry.extended.valueA;
+        else if (is_marker && entry.extended.valueB == TRACE_MARKER_TYPE_RSEQ_ENTRY)
+            reader->saw_rseq_entry = true;
+        if (segment->entries.size() > MAX_SEGMENT_SCALE * segment_entries_) {
+            VPRINT(1, "Thread %d has no segment split point: converting serially\n",
+                   tdata->index);
+            reader->at_end = true;
+            return;
+        }
+    }
+}
+
+bool
+raw2trace_t::process_thread_segment(raw2trace_thread_data_t *tdata,
+                                    thread_segment_t *segment)
+{
+    DEBUG_ASSERT(segment->has_next && tdata->pre_read.empty());
+    segment_streambuf_t buf(segment->entries);
+    std::istream stream(&buf);
+    std::istream *saved_file = tdata->thread_file;
+    tdata->thread_file = &stream;
+    bool end_of_record = false;
+    bool last_bb_handled = true;
+    bool reached_next = false;
+    bool success = true;
+    for (const offline_entry_t *in_entry = get_next_entry(tdata); in_entry != nullptr;
+         in_entry = get_next_entry(tdata)) {
+        if (tdata->pre_read.empty() && buf.in_avail() <= 0) {
+            // This is the next segment's first entry, which we leave for that
+            // segment, but we still flush delayed branches here as the conversion of
+            // that entry would.  An rseq region spanning the split point does not
+            // allow this, and we leave everything to the next segment.
+            reached_next = true;
+            if (!tdata->rseq_buffering_enabled_)
+                success = append_delayed_branch(tdata, segment->next_pc);
+            break;
+        }
+        if (!process_thread_buffer_entry(tdata, in_entry, &end_of_record,
+                                         &last_bb_handled)) {
+            success = false;
+            break;
+        }
+    }
+    tdata->thread_file = saved_file;
+    if (success && (!reached_next || end_of_record)) {
+        tdata->error = "Segment conversion did not stop at the segment end";
+        success = false;
+    }
+    return success;
+}
+
+void
+raw2trace_t::help_convert_segments(int worker)
+{
+    segment_pool_t &pool = *segment_pool_;
+    if (!worker_tasks_[worker].empty()) {
+        {
+            std::lock_guard<std::mutex> guard(pool.lock);
+            --pool.busy_workers;
+        }
+        pool.cond.notify_all();
+    }
+    while (true) {
+        thread_segment_t *segment = nullptr;
+        {
+            std::unique_lock<std::mutex> guard(pool.lock);
+            pool.cond.wait(guard, [&pool, &segment] {
+                // We help the file with the most entries read so far, as the largest
+                // file still being converted is the likeliest to hold up the
+                // conversion.
+                segment_queue_t *largest = nullptr;
+                for (segment_queue_t *queue : pool.queues) {
+                    if (!queue->pending.empty() &&
+                        (largest == nullptr ||
+                         queue->entries_read > largest->entries_read))
+                        largest = queue;
+                }
+                if (largest != nullptr) {
+                    segment = largest->pending.front();
+                    largest->pending.pop_front();
+                }
+                return segment != nullptr || pool.busy_workers == 0;
+            });
+            if (segment == nullptr)
+                return;
+        }
+        raw2trace_thread_data_t *spec = segment->speculative.get();
+        spec->worker = worker;
+        // Growing the log is a significant cost so we reserve a typical size.
+        segment->writes.entries.reserve(2 * segment->entries.size());
+        segment->writes.decode_pcs.reserve(segment->entries.size() / 2);
+        segment->writes.call_ends.reserve(segment->entries.size() / 2);
+        segment->speculation_succeeded =
+            process_thread_segment(spec, segment) && !spec->rseq_buffering_enabled_;
+        if (!segment->speculation_succeeded) {
+            VPRINT(2, "Thread %d speculative segment conversion failed: %s\n",
+                   spec->index, spec->error.c_str());
+        }
+        count_helped_segments_.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> guard(pool.lock);
+            segment->done = true;
+        }
+        pool.cond.notify_all();
+    }
+}
+
+bool
+raw2trace_t::stitch_thread_segment(raw2trace_thread_data_t *tdata,
+                                   thread_segment_t *segment)
+{
+    raw2trace_thread_data_t *spec = segment->speculative.get();
+    // The speculative conversion is only valid if it started in the same state
+    // that the serial conversion has reached.
+    if (!segment->speculation_succeeded || tdata->rseq_buffering_enabled_ ||
+        delayed_branches_exist(tdata) || tdata->last_window != segment->start_window ||
+        tdata->rseq_ever_saw_entry_ != segment->start_saw_rseq_entry) {
+        VPRINT(2, "Thread %d converting a segment of %zu entries serially\n",
+               tdata->index, segment->entries.size());
+        return process_thread_segment(tdata, segment);
+    }
+    // Replay the writes.  Encodings are only emitted the first time an
+    // instruction is seen, which for the segment alone is too often: we drop
+    // those the thread has already emitted before the segment.
+    segment_writes_t &writes = segment->writes;
+    std::vector<trace_entry_t> kept;
+    size_t entry_start = 0, pc_start = 0;
+    for (const auto &call_end : writes.call_ends) {
+        kept.clear();
+        int instr_ordinal = -1;
+        int encoding_start = -1;
+        for (size_t i = entry_start; i < call_end.first; ++i) {
+            const trace_entry_t &entry = writes.entries[i];
+            if (entry.type == TRACE_TYPE_ENCODING) {
+                if (encoding_start < 0)
+                    encoding_start = static_cast<int>(kept.size());
+            } else if (type_is_instr(static_cast<trace_type_t>(entry.type)) &&
+                       entry.size > 0) {
+                size_t pc_index = pc_start + ++instr_ordinal;
+                if (encoding_start >= 0 && pc_index < call_end.second &&
+                    !record_encoding_emitted(tdata, writes.decode_pcs[pc_index])) {
+                    // An indirect branch target marker may follow the encodings.
+                    kept.erase(std::remove_if(kept.begin() + encoding_start, kept.end(),
+                                              [](const trace_entry_t &prior) {
+                                                  return prior.type ==
+                                                      TRACE_TYPE_ENCODING;
+                                              }),
+                               kept.end());
+                }
+                encoding_start = -1;
+            } else if (entry.type != TRACE_TYPE_MARKER ||
+                       (entry.size != TRACE_MARKER_TYPE_BRANCH_TARGET &&
+                        entry.size != TRACE_MARKER_TYPE_SPLIT_VALUE)) {
+                encoding_start = -1;
+            }
+            kept.push_back(entry);
+        }
+        if (!kept.empty() &&
+            !write(tdata, kept.data(), kept.data() + kept.size(),
+                   writes.decode_pcs.data() + pc_start, call_end.second - pc_start))
+            return false;
+        entry_start = call_end.first;
+        pc_start = call_end.second;
+    }
+    tdata->count_elided += spec->count_elided;
+    tdata->count_duplicate_syscall += spec->count_duplicate_syscall;
+    tdata->count_false_syscall += spec->count_false_syscall;
+    tdata->count_rseq_abort += spec->count_rseq_abort;
+    tdata->count_rseq_side_exit += spec->count_rseq_side_exit;
+    tdata->earliest_trace_timestamp =
+        std::min(tdata->earliest_trace_timestamp, spec->earliest_trace_timestamp);
+    tdata->latest_trace_timestamp =
+        std::max(tdata->latest_trace_timestamp, spec->latest_trace_timestamp);
+    if (spec->last_timestamp_ != 0)
+        tdata->last_timestamp_ = spec->last_timestamp_;
+    tdata->last_window = spec->last_window;
+    tdata->prev_instr_was_rep_string = spec->prev_instr_was_rep_string;
+    tdata->last_pc_if_syscall_ = spec->last_pc_if_syscall_;
+    tdata->rseq_ever_saw_entry_ = spec->rseq_ever_saw_entry_;
+    return true;
+}
+
+bool
+raw2trace_t::process_thread_file_in_segments(raw2trace_thread_data_t *tdata)
+{
+    if (tdata->saw_header)
+        return true;
+    // We leave anything unusual about the start of the file to the serial path.
+    const offline_entry_t *in_entry = get_next_entry(tdata);
+    if (in_entry == nullptr)
+        return true;
+    if (!trace_metadata_reader_t::check_entry_thread_start(in_entry).empty()) {
+        unread_last_entry(tdata);
+        return true;
+    }
+    if (!process_thread_start(tdata, in_entry))
+        return false;
+    // Filtered traces can change type midway, which we do not try to predict.
+    if (TESTANY(OFFLINE_FILE_TYPE_FILTERED | OFFLINE_FILE_TYPE_IFILTERED |
+                    OFFLINE_FILE_TYPE_DFILTERED |
+                    OFFLINE_FILE_TYPE_BIMODAL_FILTERED_WARMUP,
+                tdata->file_type))
+        return true;
+#ifdef BUILD_PT_POST_PROCESSOR
+    if (tdata->kthread_file != nullptr)
+        return true;
+#endif
+    segment_pool_t &pool = *segment_pool_;
+    segment_queue_t queue;
+    {
+        std::lock_guard<std::mutex> guard(pool.lock);
+        pool.queues.push_back(&queue);
+    }
+    // We keep a few segments queued for idle workers to take, and read further
+    // ahead only as they take them, to bound memory usage.
+    static const size_t kQueuedSegments = 2;
+    const size_t max_in_flight = static_cast<size_t>(worker_count_) + kQueuedSegments;
+    segment_reader_t reader;
+    std::deque<std::unique_ptr<thread_segment_t>> in_flight;
+    bool success = true;
+    int segment_count = 0;
+    while (true) {
+        while (!reader.at_end && in_flight.size() < max_in_flight) {
+            {
+                std::lock_guard<std::mutex> guard(pool.lock);
+                if (queue.pending.size() >= kQueuedSegments)
+                    break;
+            }
+            in_flight.emplace_back(new thread_segment_t);
+            thread_segment_t *segment = in_flight.back().get();
+            read_thread_segment(tdata, &reader, segment);
+            if (segment->has_next) {
+                {
+                    std::lock_guard<std::mutex> guard(pool.lock);
+                    queue.pending.push_back(segment);
+                    queue.entries_read += segment->entries.size();
+                }
+                pool.cond.notify_all();
+            }
+        }
+        if (in_flight.empty())
+            break;
+        thread_segment_t *segment = in_flight.front().get();
+        if (!segment->has_next) {
+            // Hand the rest of the file to the serial path.
+            DEBUG_ASSERT(in_flight.size() == 1 && tdata->pre_read.empty());
+            tdata->pre_read.insert(tdata->pre_read.end(), segment->entries.begin(),
+                                   segment->entries.end());
+            in_flight.pop_front();
+            break;
+        }
+        {
+            std::unique_lock<std::mutex> guard(pool.lock);
+            if (!queue.pending.empty() && queue.pending.front() == segment) {
+                // No idle worker took it, so we convert it ourselves in
+                // stitch_thread_segment() rather than wait.
+                queue.pending.pop_front();
+                segment->done = true;
+            }
+            // We also wake to queue more segments once workers take them.
+            pool.cond.wait(guard, [&] {
+                return segment->done ||
+                    (!reader.at_end && in_flight.size() < max_in_flight &&
+                     queue.pending.size() < kQueuedSegments);
+            });
+            if (!segment->done)
+                continue;
+        }
+        if (!stitch_thread_segment(tdata, segment)) {
+            success = false;
+            break;
+        }
+        ++segment_count;
+        in_flight.pop_front();
+    }
+    VPRINT(1, "Thread %d converted %d segments concurrently\n", tdata->index,
+           segment_count);
+    {
+        // Workers may still be converting segments we have not stitched.
+        std::unique_lock<std::mutex> guard(pool.lock);
+        pool.queues.erase(std::find(pool.queues.begin(), pool.queues.end(), &queue));
+        for (thread_segment_t *segment : queue.pending)
+            segment->done = true;
+        pool.cond.wait(guard, [&in_flight] {
+            for (const auto &segment : in_flight) {
+                if (segment->has_next && !segment->done)
+                    return false;
+            }
+            return true;
+        });
+    }
+    return success;
+}
+
 std::string
 raw2trace_t::check_thread_file(std::istream *f)
 {
@@ -1199,6 +1652,8 @@ raw2trace_t::do_conversion()
         return error;
     if (thread_data_.empty())
         return "No thread files found.";
+    if (!decode_cache_path_.empty())
+        read_decode_cache_file();
     // XXX i#3286: Add a %-completed progress message by looking at the file sizes.
     if (worker_count_ == 0) {
         for (size_t i = 0; i < thread_data_.size(); ++i) {
@@ -1221,9 +1676,19 @@ raw2trace_t::do_conversion()
         std::vector<std::thread> threads;
         VPRINT(1, "Creating %d worker threads\n", worker_count_);
         threads.reserve(worker_count_);
+        if (split_files_) {
+            segment_pool_.reset(new segment_pool_t);
+            for (int i = 0; i < worker_count_; ++i) {
+                if (!worker_tasks_[i].empty())
+                    ++segment_pool_->busy_workers;
+            }
+        }
         for (int i = 0; i < worker_count_; ++i) {
-            threads.push_back(
-                std::thread(&raw2trace_t::process_tasks, this, &worker_tasks_[i]));
+            threads.push_back(std::thread([this, i]() {
+                process_tasks(&worker_tasks_[i]);
+                if (split_files_)
+                    help_convert_segments(i);
+            }));
         }
         for (std::thread &thread : threads)
             thread.join();
@@ -1245,12 +1710,22 @@ raw2trace_t::do_conversion()
     error = aggregate_and_write_schedule_files();
     if (!error.empty())
         return error;
+    if (!decode_cache_path_.empty()) {
+        // The cache is an optimization so we do not fail the conversion.
+        error = write_decode_cache_file();
+        if (!error.empty())
+            WARN("%s", error.c_str());
+    }
     VPRINT(1, "Omitted " UINT64_FORMAT_STRING " duplicate system calls.\n",
            count_duplicate_syscall_);
     VPRINT(1, "Omitted " UINT64_FORMAT_STRING " false system calls.\n",
            count_false_syscall_);
     VPRINT(1, "Reconstructed " UINT64_FORMAT_STRING " elided addresses.\n",
            count_elided_);
+    if (!decode_cache_path_.empty()) {
+        VPRINT(1, "Reused " UINT64_FORMAT_STRING " blocks from the decode cache file.\n",
+               get_persisted_block_count());
+    }
     VPRINT(1, "Adjusted " UINT64_FORMAT_STRING " rseq aborts.\n", count_rseq_abort_);
     VPRINT(1, "Adjusted " UINT64_FORMAT_STRING " rseq side exits.\n",
            count_rseq_side_exit_);
@@ -1545,7 +2020,9 @@ raw2trace_t::append_bb_entries(raw2trace_thread_data_t *tdata,
         DR_ASSERT(instrs_are_separate);
     } else {
         if (!instr_summary_exists(tdata, in_entry->pc.modidx, in_entry->pc.modoffs,
-                                  start_pc, 0, decode_pc)) {
+                                  start_pc, 0, decode_pc) &&
+            !load_persisted_block(tdata, in_entry->pc.modidx, in_entry->pc.modoffs,
+                                  start_pc, instr_count)) {
             if (!analyze_elidable_addresses(tdata, in_entry->pc.modidx,
                                             in_entry->pc.modoffs, start_pc, instr_count))
                 return false;
@@ -2493,6 +2970,7 @@ raw2trace_t::create_instr_summary(raw2trace_thread_data_t *tdata, uint64 modidx,
 {
     if (block == nullptr) {
         block = new block_summary_t(block_start, instr_count);
+        block->cache_variant = decode_cache_variant(tdata);
         DEBUG_ASSERT(index >= 0 && index < static_cast<int>(block->instrs.size()));
         decode_cache_[tdata->worker].add(modidx, modoffs, block);
         VPRINT(5,
@@ -2559,6 +3037,326 @@ raw2trace_t::set_instr_summary_flags(raw2trace_thread_data_t *tdata, uint64 modi
     return true;
 }
 
+/***************************************************************************
+ * Persistent decode cache
+ */
+
+// The decode cache file holds a header followed by one record per block: a
+// persisted_record_t, then the block's original start pc and code bytes, then a
+// persisted_instr_t per instruction each followed by its memory operands.  The
+// fields are in host layout: the header rejects files from other builds.
+static const char kDecodeCacheMagic[8] = { 'D', 'R', 'R', '2', 'T', 'D', 'C', '\0' };
+static const uint kDecodeCacheFormat = 1;
+
+struct persisted_header_t {
+    char magic[8];
+    uint format;
+    uint dr_version;
+    uint isa_mode;
+    uint opnd_size;
+};
+
+struct persisted_record_t {
+    uint64 module_checksum;
+    uint64 modoffs;
+    int variant;
+    uint instr_count;
+    uint payload_size;
+};
+
+struct persisted_instr_t {
+    uint64 branch_target_pc;
+    uint16_t type;
+    uint16_t prefetch_type;
+    uint16_t flush_type;
+    byte length;
+    byte packed;
+    uint8_t num_mem_srcs;
+    uint8_t num_memrefs;
+};
+
+static const uint kMaxPersistedPayload = 1 << 24;
+static const byte kPersistedRememberBase = 0x1;
+static const byte kPersistedUseRememberedBase = 0x2;
+
+static void
+append_bytes(std::string *buf, const void *data, size_t size)
+{
+    buf->append(reinterpret_cast<const char *>(data), size);
+}
+
+static bool
+extract_bytes(const std::string &buf, INOUT size_t *pos, void *data, size_t size)
+{
+    if (buf.size() - *pos < size)
+        return false;
+    memcpy(data, buf.data() + *pos, size);
+    *pos += size;
+    return true;
+}
+
+// A checksum to tell modules apart.  The blocks themselves store their code bytes
+// so a collision costs only a lookup.
+static uint64
+checksum_bytes(const byte *start, size_t size)
+{
+    static constexpr uint64 FNV_PRIME = 0x100000001b3ULL;
+    uint64 hash = 0xcbf29ce484222325ULL ^ size;
+    size_t i = 0;
+    for (; i + sizeof(uint64) <= size; i += sizeof(uint64)) {
+        uint64 word;
+        memcpy(&word, start + i, sizeof(word));
+        hash = (hash ^ word) * FNV_PRIME;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; ++i)
+        hash = (hash ^ start[i]) * FNV_PRIME;
+    // Reserve 0 for unmapped modules.
+    return hash == 0 ? 1 : hash;
+}
+
+void
+raw2trace_t::set_decode_cache_file(const std::string &path)
+{
+    decode_cache_path_ = path;
+}
+
+int
+raw2trace_t::decode_cache_variant(raw2trace_thread_data_t *tdata)
+{
+    // Filtered blocks do not go through analyze_elidable_addresses().
+    if (TESTANY(OFFLINE_FILE_TYPE_FILTERED | OFFLINE_FILE_TYPE_IFILTERED,
+                get_file_type(tdata)))
+        return -1;
+    // These match the checks in analyze_elidable_addresses().
+    int version = get_version(tdata);
+    if (version <= OFFLINE_FILE_VERSION_NO_ELISION ||
+        TESTANY(OFFLINE_FILE_TYPE_NO_OPTIMIZATIONS | OFFLINE_FILE_TYPE_INSTRUCTION_ONLY,
+                get_file_type(tdata)))
+        return 0;
+    return version;
+}
+
+void
+raw2trace_t::read_decode_cache_file()
+{
+    const std::vector<module_t> &modules = modvec_();
+    module_checksums_.assign(modules.size(), 0);
+    for (size_t i = 0; i < modules.size(); ++i) {
+        // Secondary segments share their module's checksum, as they may contain
+        // unmapped holes.  The primary segment holds the headers including any
+        // build id.
+        if (modules[i].total_map_size == 0) {
+            if (i > 0 && modules[i].map_seg_base != nullptr)
+                module_checksums_[i] = module_checksums_[i - 1];
+        } else if (modules[i].map_seg_base != nullptr) {
+            // The recorded size may exceed the mapping of an alternate binary.
+            module_checksums_[i] = checksum_bytes(
+                modules[i].map_seg_base,
+                (std::min)(modules[i].seg_size, modules[i].total_map_size));
+        }
+    }
+    std::ifstream file(decode_cache_path_, std::ios::binary);
+    if (!file.good()) {
+        VPRINT(1, "No decode cache file %s found\n", decode_cache_path_.c_str());
+        return;
+    }
+    persisted_header_t header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        memcmp(header.magic, kDecodeCacheMagic, sizeof(header.magic)) != 0 ||
+        header.format != kDecodeCacheFormat || header.dr_version != _USES_DR_VERSION_ ||
+        header.isa_mode != static_cast<uint>(dr_get_isa_mode(dcontext_)) ||
+        header.opnd_size != sizeof(opnd_t)) {
+        WARN("Ignoring incompatible decode cache file %s", decode_cache_path_.c_str());
+        return;
+    }
+    persisted_record_t record;
+    while (file.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+        // A block is bounded by the raw entry instr count field.
+        if (record.payload_size > kMaxPersistedPayload) {
+            WARN("Decode cache file %s is corrupt", decode_cache_path_.c_str());
+            break;
+        }
+        std::string payload(record.payload_size, '\0');
+        if (!file.read(&payload[0], record.payload_size)) {
+            WARN("Decode cache file %s is truncated", decode_cache_path_.c_str());
+            break;
+        }
+        persisted_blocks_[persisted_block_key_t(record.module_checksum, record.modoffs,
+                                                record.variant, record.instr_count)] =
+            std::move(payload);
+    }
+    VPRINT(1, "Read %zu blocks from decode cache file %s\n", persisted_blocks_.size(),
+           decode_cache_path_.c_str());
+}
+
+bool
+raw2trace_t::load_persisted_block(raw2trace_thread_data_t *tdata, uint64 modidx,
+                                  uint64 modoffs, app_pc start_pc, uint instr_count)
+{
+    if (persisted_blocks_.empty() || modidx >= module_checksums_.size() ||
+        module_checksums_[static_cast<size_t>(modidx)] == 0)
+        return false;
+    int variant = decode_cache_variant(tdata);
+    if (variant < 0)
+        return false;
+    auto it = persisted_blocks_.find(persisted_block_key_t(
+        module_checksums_[static_cast<size_t>(modidx)], modoffs, variant, instr_count));
+    if (it == persisted_blocks_.end() ||
+        lookup_block_summary(tdata, modidx, modoffs, start_pc) != nullptr)
+        return false;
+    const std::string &payload = it->second;
+    const module_t &module = modvec_()[static_cast<size_t>(modidx)];
+    size_t pos = 0;
+    uint64 saved_orig_pc;
+    uint code_size;
+    if (!extract_bytes(payload, &pos, &saved_orig_pc, sizeof(saved_orig_pc)) ||
+        !extract_bytes(payload, &pos, &code_size, sizeof(code_size)) ||
+        payload.size() - pos < code_size ||
+        start_pc + code_size > module.map_seg_base + module.seg_size ||
+        memcmp(payload.data() + pos, start_pc, code_size) != 0)
+        return false;
+    pos += code_size;
+    // The same code may be loaded at a different address: pc-relative values
+    // need to be shifted.
+    ptr_int_t delta = static_cast<ptr_int_t>(
+        reinterpret_cast<ptr_uint_t>(modmap_().get_orig_pc(modidx, modoffs)) -
+        static_cast<ptr_uint_t>(saved_orig_pc));
+    std::unique_ptr<block_summary_t> block(new block_summary_t(start_pc, instr_count));
+    app_pc pc = start_pc;
+    for (instr_summary_t &desc : block->instrs) {
+        persisted_instr_t instr;
+        if (!extract_bytes(payload, &pos, &instr, sizeof(instr)))
+            return false;
+        desc.pc_ = pc;
+        desc.length_ = instr.length;
+        desc.packed_ = instr.packed;
+        desc.type_ = instr.type;
+        desc.prefetch_type_ = instr.prefetch_type;
+        desc.flush_type_ = instr.flush_type;
+        desc.branch_target_pc_ = instr.branch_target_pc == 0
+            ? nullptr
+            : reinterpret_cast<app_pc>(
+                  static_cast<ptr_uint_t>(instr.branch_target_pc) + delta);
+        desc.num_mem_srcs_ = instr.num_mem_srcs;
+        for (int i = 0; i < instr.num_memrefs; ++i) {
+            opnd_t opnd;
+            byte flags;
+            if (!extract_bytes(payload, &pos, &opnd, sizeof(opnd)) ||
+                !extract_bytes(payload, &pos, &flags, sizeof(flags)))
+                return false;
+#if defined(X64) || defined(ARM)
+            if (opnd_is_rel_addr(opnd)) {
+                opnd = opnd_create_rel_addr(static_cast<byte *>(opnd_get_addr(opnd)) +
+                                                delta,
+                                            opnd_get_size(opnd));
+            }
+#endif
+            desc.mem_srcs_and_dests_.push_back(instr_summary_t::memref_summary_t(opnd));
+            desc.mem_srcs_and_dests_.back().remember_base =
+                TESTANY(kPersistedRememberBase, flags);
+            desc.mem_srcs_and_dests_.back().use_remembered_base =
+                TESTANY(kPersistedUseRememberedBase, flags);
+        }
+        pc += instr.length;
+    }
+    if (pc != start_pc + code_size)
+        return false;
+    block->cache_variant = variant;
+    VPRINT(5, "Loaded persisted block summary for " PFX "\n", start_pc);
+    decode_cache_[tdata->worker].add(modidx, modoffs, block.get());
+    tdata->last_decode_block_start = start_pc;
+    tdata->last_decode_modidx = modidx;
+    tdata->last_decode_modoffs = modoffs;
+    tdata->last_block_summary = block.release();
+    count_persisted_blocks_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+std::string
+raw2trace_t::write_decode_cache_file()
+{
+    // We keep what we read, including blocks of modules not in this trace, and add
+    // what we decoded.
+    for (block_hashtable_t &cache : decode_cache_) {
+        cache.for_each([this](uint64 modidx, uint64 modoffs, block_summary_t *block) {
+            if (block->cache_variant < 0 || modidx >= module_checksums_.size() ||
+                module_checksums_[static_cast<size_t>(modidx)] == 0)
+                return;
+            // Blocks cut short by an error have missing instructions.
+            for (const instr_summary_t &desc : block->instrs) {
+                if (desc.pc() == nullptr)
+                    return;
+            }
+            std::string payload;
+            uint64 orig_pc = reinterpret_cast<ptr_uint_t>(
+                modmap_().get_orig_pc(modidx, modoffs));
+            uint code_size =
+                static_cast<uint>(block->instrs.back().next_pc() - block->start_pc);
+            append_bytes(&payload, &orig_pc, sizeof(orig_pc));
+            append_bytes(&payload, &code_size, sizeof(code_size));
+            append_bytes(&payload, block->start_pc, code_size);
+            for (const instr_summary_t &desc : block->instrs) {
+                persisted_instr_t instr = {};
+                instr.branch_target_pc =
+                    reinterpret_cast<ptr_uint_t>(desc.branch_target_pc_);
+                instr.type = desc.type_;
+                instr.prefetch_type = desc.prefetch_type_;
+                instr.flush_type = desc.flush_type_;
+                instr.length = desc.length_;
+                instr.packed = desc.packed_;
+                instr.num_mem_srcs = desc.num_mem_srcs_;
+                instr.num_memrefs = static_cast<uint8_t>(desc.mem_srcs_and_dests_.size());
+                append_bytes(&payload, &instr, sizeof(instr));
+                for (const auto &memref : desc.mem_srcs_and_dests_) {
+                    byte flags = (memref.remember_base ? kPersistedRememberBase : 0) |
+                        (memref.use_remembered_base ? kPersistedUseRememberedBase : 0);
+                    append_bytes(&payload, &memref.opnd, sizeof(memref.opnd));
+                    append_bytes(&payload, &flags, sizeof(flags));
+                }
+            }
+            persisted_blocks_[persisted_block_key_t(
+                module_checksums_[static_cast<size_t>(modidx)], modoffs,
+                block->cache_variant, static_cast<uint>(block->instrs.size()))] =
+                std::move(payload);
+        });
+    }
+    // We write to a temporary file and rename it to avoid leaving a partial file
+    // behind, and so concurrent conversions see either the old or the new file.
+    std::string tmp_path = decode_cache_path_ + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        persisted_header_t header = {};
+        memcpy(header.magic, kDecodeCacheMagic, sizeof(header.magic));
+        header.format = kDecodeCacheFormat;
+        header.dr_version = _USES_DR_VERSION_;
+        header.isa_mode = static_cast<uint>(dr_get_isa_mode(dcontext_));
+        header.opnd_size = sizeof(opnd_t);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (const auto &keyval : persisted_blocks_) {
+            persisted_record_t record = {};
+            record.module_checksum = std::get<0>(keyval.first);
+            record.modoffs = std::get<1>(keyval.first);
+            record.variant = std::get<2>(keyval.first);
+            record.instr_count = std::get<3>(keyval.first);
+            record.payload_size = static_cast<uint>(keyval.second.size());
+            file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+            file.write(keyval.second.data(), keyval.second.size());
+        }
+        if (!file.good())
+            return "Failed to write decode cache file " + tmp_path;
+    }
+    if (std::rename(tmp_path.c_str(), decode_cache_path_.c_str()) != 0) {
+        // Windows does not replace an existing file.
+        std::remove(decode_cache_path_.c_str());
+        if (std::rename(tmp_path.c_str(), decode_cache_path_.c_str()) != 0)
+            return "Failed to rename decode cache file to " + decode_cache_path_;
+    }
+    VPRINT(1, "Wrote %zu blocks to decode cache file %s\n", persisted_blocks_.size(),
+           decode_cache_path_.c_str());
+    return "";
+}
+
 bool
 instr_summary_t::construct(void *dcontext, app_pc block_start, INOUT app_pc *pc,
                            app_pc orig_pc, OUT instr_summary_t *desc, uint verbosity)
@@ -3047,6 +3845,14 @@ raw2trace_t::write(raw2trace_thread_data_t *tdata, const trace_entry_t *start,
                                        decode_pcs + decode_pcs_size);
         return true;
     }
+    if (tdata->write_log != nullptr) {
+        segment_writes_t *log = tdata->write_log;
+        log->entries.insert(log->entries.end(), start, end);
+        log->decode_pcs.insert(log->decode_pcs.end(), decode_pcs,
+                               decode_pcs + decode_pcs_size);
+        log->call_ends.emplace_back(log->entries.size(), log->decode_pcs.size());
+        return true;
+    }
     if (tdata->out_archive != nullptr) {
         bool prev_was_encoding = false;
         int instr_ordinal = -1;
@@ -3404,6 +4210,10 @@ raw2trace_t::raw2trace_t(
             thread_data_[i]->worker = worker;
             worker = (worker + 1) % worker_count_;
         }
+        // Workers with no file of their own, or none left, help convert
+        // segments of the files still being converted, using their own decode
+        // caches.  Thus a large file among small ones is not left to one worker.
+        split_files_ = worker_count_ > 1;
     } else
         cache_count = 1;
     decode_cache_.reserve(cache_count);
@@ -52,10 +52,12 @@
 #include <fstream>
 #include <limits>
 #include <list>
+#include <map>
 #include <memory>
 #include <queue>
 #include <set>
 #include <string>
+#include <tuple>
 #include <type_traits>
 #include <unordered_map>
 #include <utility>
@@ -111,6 +113,10 @@ namespace drmemtrace {
 #    define TRACE_SUFFIX_ZIP "trace.zip"
 #endif
 
+#ifdef HAS_ZSTD
+#    define TRACE_SUFFIX_ZSTD "trace.zst"
+#endif
+
 #ifdef HAS_ZLIB
 #    define TRACE_SUFFIX_GZ "trace.gz"
 #endif
@@ -676,7 +682,8 @@ protected:
 
 private:
     static const int MAX_DECODE_SIZE = 1024;
-    byte decode_buf_[MAX_DECODE_SIZE];
+    // Zeroed so the contents past the encoded instructions are deterministic.
+    byte decode_buf_[MAX_DECODE_SIZE] = {};
 };
 
 /**
@@ -935,6 +942,19 @@ public:
     virtual std::string
     do_conversion();
 
+    /**
+     * Enables a persistent decode cache in the file at \p path, which is read by
+     * do_conversion() before converting and rewritten afterward.  Blocks decoded in a
+     * prior conversion of a module with identical contents are taken from the file
+     * rather than decoded again, which speeds up repeated conversions of traces of
+     * the same binaries.  Modules are identified by a checksum of their mapped
+     * contents, so the file may be shared among traces of different applications.
+     * A missing, stale, or corrupt file is not an error: decoding then proceeds as
+     * though no cache were present.
+     */
+    void
+    set_decode_cache_file(const std::string &path);
+
     static std::string
     check_thread_file(std::istream *f);
 
@@ -970,6 +990,9 @@ protected:
         }
         app_pc start_pc;
         std::vector<instr_summary_t> instrs;
+        // The decode_cache_variant() under which this block was decoded, or -1 if
+        // it should not be persisted.
+        int cache_variant = -1;
     };
 
     struct branch_info_t {
@@ -990,6 +1013,15 @@ protected:
         int buf_idx; // Index into rseq_buffer_.
     };
 
+    // The records passed to each write() call while speculatively converting one
+    // segment of a thread's raw file, for in-order replay into the real output.
+    struct segment_writes_t {
+        std::vector<trace_entry_t> entries;
+        std::vector<app_pc> decode_pcs;
+        // The end offsets into "entries" and "decode_pcs" of each write() call.
+        std::vector<std::pair<size_t, size_t>> call_ends;
+    };
+
     // Per-traced-thread data is stored here and accessed without locks by having each
     // traced thread processed by only one processing thread.
     struct raw2trace_thread_data_t {
@@ -1097,6 +1129,10 @@ protected:
         std::vector<branch_info_t> rseq_branch_targets_;
         std::vector<app_pc> rseq_decode_pcs_;
 
+        // If non-nullptr, write() appends here instead of writing to out_file.
+        // This is used for speculative conversion of a segment of a thread's file.
+        segment_writes_t *write_log = nullptr;
+
 #ifdef BUILD_PT_POST_PROCESSOR
         std::istream *kthread_file;
         std::vector<syscall_pt_entry_t> pre_read_pt_entries;
@@ -1250,6 +1286,37 @@ protected:
         modmap_ptr_ = modmap;
     }
 
+    /**
+     * Sets the number of raw entries after which a thread's file is split into a
+     * new segment when there are enough workers to convert segments of the same
+     * file concurrently.  This is mainly intended for testing.
+     */
+    void
+    set_segment_entries(uint64_t entries)
+    {
+        segment_entries_ = entries;
+    }
+
+    /**
+     * Returns the number of segments of thread files converted by workers other
+     * than the one converting the file.  This is mainly intended for testing.
+     */
+    uint64
+    get_helped_segment_count() const
+    {
+        return count_helped_segments_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the number of blocks taken from the persistent decode cache file
+     * (see set_decode_cache_file()) rather than decoded.
+     */
+    uint64
+    get_persisted_block_count() const
+    {
+        return count_persisted_blocks_.load(std::memory_order_relaxed);
+    }
+
     const module_mapper_t *modmap_ptr_ = nullptr;
 
     uint64 count_elided_ = 0;
@@ -1426,6 +1493,50 @@ private:
     bool
     process_thread_file(raw2trace_thread_data_t *tdata);
 
+    // Support for splitting one thread's file into segments which are converted
+    // concurrently by workers with no file of their own left to convert.
+    struct thread_segment_t;
+    struct segment_reader_t;
+    struct segment_queue_t;
+    struct segment_pool_t;
+
+    // Processes the thread's header and then as much of its file as can be split
+    // into segments, leaving the rest in tdata->pre_read and tdata->thread_file for
+    // process_thread_file() to handle serially.
+    bool
+    process_thread_file_in_segments(raw2trace_thread_data_t *tdata);
+
+    bool
+    is_segment_start(const offline_entry_t &entry, OUT app_pc *orig_pc);
+
+    void
+    read_thread_segment(raw2trace_thread_data_t *tdata, segment_reader_t *reader,
+                        thread_segment_t *segment);
+
+    // Once "worker" has converted its own files, converts segments of the largest
+    // files still being converted until every worker is done with its own files.
+    void
+    help_convert_segments(int worker);
+
+    // Converts the segment's entries up to the first entry of the next segment,
+    // at which point any delayed branches are flushed.
+    bool
+    process_thread_segment(raw2trace_thread_data_t *tdata, thread_segment_t *segment);
+
+    // Appends the segment's output to tdata's output, either by replaying its
+    // speculative conversion or by converting it again in place.
+    bool
+    stitch_thread_segment(raw2trace_thread_data_t *tdata, thread_segment_t *segment);
+
+    // Processes the thread header starting at in_entry, if it is one.
+    bool
+    process_thread_start(raw2trace_thread_data_t *tdata, const offline_entry_t *in_entry);
+
+    bool
+    process_thread_buffer_entry(raw2trace_thread_data_t *tdata,
+                                const offline_entry_t *in_entry, OUT bool *end_of_record,
+                                INOUT bool *last_bb_handled);
+
     void
     process_tasks(std::vector<raw2trace_thread_data_t *> *tasks);
 
@@ -1436,6 +1547,25 @@ private:
     analyze_elidable_addresses(raw2trace_thread_data_t *tdata, uint64 modidx,
                                uint64 modoffs, app_pc start_pc, uint instr_count);
 
+    // Returns which decodings of a block are interchangeable for the persistent
+    // decode cache: the elision flags depend on the trace version and type.  Returns
+    // -1 if blocks of "tdata" are not to be persisted.
+    int
+    decode_cache_variant(raw2trace_thread_data_t *tdata);
+
+    void
+    read_decode_cache_file();
+
+    std::string
+    write_decode_cache_file();
+
+    // Installs the block at modidx+modoffs from the persistent decode cache into the
+    // worker's decode cache.  Returns false if the block is not in the persistent
+    // cache or is already present in the worker's cache.
+    bool
+    load_persisted_block(raw2trace_thread_data_t *tdata, uint64 modidx, uint64 modoffs,
+                         app_pc start_pc, uint instr_count);
+
     bool
     process_memref(raw2trace_thread_data_t *tdata, trace_entry_t **buf_in,
                    const instr_summary_t *instr, instr_summary_t::memref_summary_t memref,
@@ -1479,6 +1609,13 @@ private:
 
     int worker_count_;
     std::vector<std::vector<raw2trace_thread_data_t *>> worker_tasks_;
+    // Whether thread files are split into segments, which idle workers convert.
+    bool split_files_ = false;
+    std::unique_ptr<segment_pool_t> segment_pool_;
+    std::atomic<uint64> count_helped_segments_ { 0 };
+    // The number of raw entries after which a thread file is split.
+    uint64_t segment_entries_ = kDefaultSegmentEntries;
+    static const uint64_t kDefaultSegmentEntries = 1 << 18;
 
     class block_hashtable_t {
         // We use a hashtable to cache decodings.  We compared the performance of
@@ -1555,6 +1692,30 @@ private:
 #endif
         }
 
+        // Calls "func" with the modidx, modoffs, and summary of every block.
+        template <typename func_t>
+        void
+        for_each(func_t func)
+        {
+#ifdef X64
+            for (uint i = 0; i < HASHTABLE_SIZE(table.table_bits); ++i) {
+                for (hash_entry_t *e = table.table[i]; e != nullptr; e = e->next) {
+                    uint64 key = reinterpret_cast<uint64>(e->key);
+                    func(key >> PC_MODOFFS_BITS, key & ((1ULL << PC_MODOFFS_BITS) - 1),
+                         static_cast<block_summary_t *>(e->payload));
+                }
+            }
+#else
+            for (auto &keyval : table) {
+                if (keyval.second == nullptr)
+                    continue;
+                func(keyval.first >> PC_MODOFFS_BITS,
+                     keyval.first & ((1ULL << PC_MODOFFS_BITS) - 1),
+                     keyval.second.get());
+            }
+#endif
+        }
+
     private:
         static void
         free_payload(void *ptr)
@@ -1577,6 +1738,17 @@ private:
     // We use a per-worker cache to avoid locks.
     std::vector<block_hashtable_t> decode_cache_;
 
+    // The persistent decode cache: see set_decode_cache_file().  The blocks read
+    // from the file are keyed by module checksum, module offset, decode cache
+    // variant, and instruction count, and hold serialized instr_summary_t fields.
+    // They are only read during conversion so they need no lock.
+    typedef std::tuple<uint64, uint64, int, uint> persisted_block_key_t;
+    std::string decode_cache_path_;
+    std::map<persisted_block_key_t, std::string> persisted_blocks_;
+    // The checksum of each module's mapped contents, or 0 if it is not mapped.
+    std::vector<uint64> module_checksums_;
+    std::atomic<uint64> count_persisted_blocks_ { 0 };
+
     // Store optional parameters for the module_mapper_t until we need to construct it.
     const char *(*user_parse_)(const char *src, OUT void **data) = nullptr;
     void (*user_free_)(void *data) = nullptr;
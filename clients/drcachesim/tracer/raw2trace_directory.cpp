@@ -74,6 +74,9 @@
 #    include "common/lz4_istream.h"
 #    include "common/lz4_ostream.h"
 #endif
+#ifdef HAS_ZSTD
+#    include "common/zstd_ostream.h"
+#endif
 
 namespace dynamorio {
 namespace drmemtrace {
@@ -124,13 +127,17 @@ raw2trace_directory_t::trace_suffix()
 #ifdef HAS_ZIP
         return TRACE_SUFFIX_ZIP;
 #endif
-    } else if (compress_type_ == "gzip") {
+    } else if (compress_type_ == "gzip" || compress_type_ == "gzip_indexed") {
 #ifdef HAS_ZLIB
         return TRACE_SUFFIX_GZ;
 #endif
     } else if (compress_type_ == "lz4") {
 #ifdef HAS_LZ4
         return TRACE_SUFFIX_LZ4;
+#endif
+    } else if (compress_type_ == "zstd") {
+#ifdef HAS_ZSTD
+        return TRACE_SUFFIX_ZSTD;
 #endif
     }
     return TRACE_SUFFIX;
@@ -265,10 +272,33 @@ raw2trace_directory_t::open_thread_log_file(const char *basename)
     } else if (compress_type_ == "gzip") {
 #ifdef HAS_ZLIB
         ofile = new gzip_ostream_t(path);
+#endif
+    } else if (compress_type_ == "gzip_indexed") {
+#ifdef HAS_ZLIB
+        // Chunked so that readers can seek using the index it writes.
+        gzip_chunked_ostream_t *chunked = new gzip_chunked_ostream_t(path);
+        out_archives_.push_back(chunked);
+        indexed_files_.push_back(chunked);
+        if (!(*out_archives_.back()))
+            return "Failed to open output file " + std::string(path);
+
+        VPRINT(1, "Opened output file %s\n", path);
+        return "";
 #endif
     } else if (compress_type_ == "lz4") {
 #ifdef HAS_LZ4
         ofile = new lz4_ostream_t(path);
+#endif
+    } else if (compress_type_ == "zstd") {
+#ifdef HAS_ZSTD
+        // Each chunk is a separate component which readers can seek to.
+        ofile = new zstd_ostream_t(path);
+        out_archives_.push_back(reinterpret_cast<archive_ostream_t *>(ofile));
+        if (!(*out_archives_.back()))
+            return "Failed to open output file " + std::string(path);
+
+        VPRINT(1, "Opened output file %s\n", path);
+        return "";
 #endif
     }
     if (!ofile) {
@@ -481,6 +511,11 @@ raw2trace_directory_t::initialize(const std::string &indir, const std::string &o
     indir_ = indir;
     outdir_ = outdir;
     compress_type_ = compress;
+#ifndef HAS_ZSTD
+    // Rather than silently writing uncompressed files.
+    if (compress_type_ == "zstd")
+        return "zstd compression is not supported: this build lacks libzstd";
+#endif
 #ifdef WINDOWS
     // Canonicalize.
     std::replace(indir_.begin(), indir_.end(), ALT_DIRSEP[0], DIRSEP[0]);
@@ -595,6 +630,19 @@ raw2trace_directory_t::initialize_funclist_file(
     return "";
 }
 
+std::string
+raw2trace_directory_t::finish_output_files()
+{
+#ifdef HAS_ZLIB
+    for (gzip_chunked_ostream_t *file : indexed_files_) {
+        std::string error = file->close();
+        if (!error.empty())
+            return error;
+    }
+#endif
+    return "";
+}
+
 raw2trace_directory_t::~raw2trace_directory_t()
 {
     if (modfile_bytes_ != nullptr)
@@ -56,6 +56,8 @@
 namespace dynamorio {
 namespace drmemtrace {
 
+class gzip_chunked_ostream_t;
+
 class raw2trace_directory_t {
 public:
     raw2trace_directory_t(unsigned int verbosity = 0)
@@ -88,6 +90,12 @@ public:
     initialize_funclist_file(const std::string &funclist_file_path,
                              OUT std::vector<std::vector<std::string>> *entries);
 
+    // Completes the output files, including writing the seek indices for
+    // "gzip_indexed" compression.  Returns "" on success or an error message on
+    // failure.  If not called, this happens on destruction with errors ignored.
+    std::string
+    finish_output_files();
+
     static std::string
     tracedir_from_rawdir(const std::string &rawdir);
 
@@ -131,6 +139,8 @@ private:
     std::string outdir_;
     unsigned int verbosity_;
     std::string compress_type_;
+    // The subset of out_archives_ with seek indices.
+    std::vector<gzip_chunked_ostream_t *> indexed_files_;
 };
 
 } // namespace drmemtrace
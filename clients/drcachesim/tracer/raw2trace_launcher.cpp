@@ -76,7 +76,9 @@ static droption_t<bytesize_t> op_chunk_instr_count(
     DROPTION_SCOPE_FRONTEND, "chunk_instr_count", 10 * 1000 * 1000U,
     "Chunk instruction count",
     "Specifies the size in instructions of the chunks into which a trace output file "
-    "is split inside a zipfile.  This is the granularity of a fast seek. "
+    "is split inside a zipfile, or into separate indexed members of a gzip file for "
+    "-compress gzip_indexed.  "
+    "This is the granularity of a fast seek. "
     "For 32-bit this cannot exceed 4G.");
 
 static droption_t<unsigned int> op_verbose(DROPTION_SCOPE_FRONTEND, "verbose", 0,
@@ -92,15 +94,41 @@ static droption_t<int>
 
 static droption_t<std::string> op_trace_compress(
     DROPTION_SCOPE_FRONTEND, "compress", DEFAULT_TRACE_COMPRESSION_TYPE,
-    "Trace compression: \"zip\",\"gzip\",\"zlib\",\"lz4\",\"none\"",
+#ifdef HAS_ZSTD
+    "Trace compression: \"zip\",\"gzip\",\"gzip_indexed\",\"zlib\",\"lz4\",\"zstd\","
+    "\"none\"",
     "Specifies the compression type to use for trace files: \"zip\", "
-    "\"gzip\", \"zlib\", \"lz4\", or \"none\". "
+    "\"gzip\", \"gzip_indexed\", \"zlib\", \"lz4\", \"zstd\", or \"none\". "
+#else
+    "Trace compression: \"zip\",\"gzip\",\"gzip_indexed\",\"zlib\",\"lz4\",\"none\"",
+    "Specifies the compression type to use for trace files: \"zip\", "
+    "\"gzip\", \"gzip_indexed\", \"zlib\", \"lz4\", or \"none\". "
+#endif
+    "\"gzip_indexed\" writes each -chunk_instr_count chunk as a separate gzip member "
+    "and a \".idx\" seek index alongside each file, which lets readers jump to the "
+    "target chunk when skipping instructions.  As each member is compressed "
+    "independently the files are larger: negligibly so at the default "
+    "-chunk_instr_count, but by several percent for chunks of a few thousand "
+    "instructions. "
     "In most cases where fast skipping by instruction count is not needed "
     "lz4 compression generally improves performance and is recommended. "
+#ifdef HAS_ZSTD
+    "zstd compresses nearly as well as gzip at a fraction of the decompression "
+    "cost, decompresses ahead on a separate thread, and supports fast skipping "
+    "by jumping to the target chunk. "
+#endif
     "When it comes to storage types, the impact on overhead varies: "
     "for SSDs, zip and gzip often increase overhead and should only be chosen "
     "if space is limited.");
 
+static droption_t<std::string> op_decode_cache_file(
+    DROPTION_SCOPE_FRONTEND, "decode_cache_file", "", "Persistent decode cache file",
+    "Specifies a file in which decoded instruction information is saved for reuse by "
+    "later conversions.  The file is read before converting, if it exists, and "
+    "rewritten afterward.  Blocks are matched by module contents, not by path, so one "
+    "file can be shared by conversions of traces of different applications.  Repeated "
+    "conversions of traces of the same binaries skip most decoding work.");
+
 #define FATAL_ERROR(msg, ...)                               \
     do {                                                    \
         fprintf(stderr, "ERROR: " msg "\n", ##__VA_ARGS__); \
@@ -138,9 +166,14 @@ _tmain(int argc, const TCHAR *targv[])
                           op_verbose.get_value(), op_jobs.get_value(),
                           op_alt_module_dir.get_value(), op_chunk_instr_count.get_value(),
                           dir.in_kfiles_map_, dir.kcoredir_, dir.kallsymsdir_);
+    if (!op_decode_cache_file.get_value().empty())
+        raw2trace.set_decode_cache_file(op_decode_cache_file.get_value());
     std::string error = raw2trace.do_conversion();
     if (!error.empty())
         FATAL_ERROR("Conversion failed: %s", error.c_str());
+    error = dir.finish_output_files();
+    if (!error.empty())
+        FATAL_ERROR("Failed to finish output files: %s", error.c_str());
 
     return 0;
 }
@@ -160,6 +160,8 @@ static uint64 num_refs;      /* keep a global memory reference count */
 static uint64 num_writeouts;
 static uint64 num_v2p_writeouts;
 static uint64 num_phys_markers;
+static uint64 write_behind_stall_us;
+static uint64 write_behind_max_thread_stall_us;
 
 static drmgr_priority_t pri_pre_bbdup = { sizeof(drmgr_priority_t),
                                           DRMGR_PRIORITY_NAME_MEMTRACE, NULL, NULL,
@@ -320,6 +322,11 @@ event_bb_setup(void *drbbdup_ctx, void *drcontext, void *tag, instrlist_t *bb,
         // XXX i#2039: We have possible future use cases for BBDUP_MODE_FUNC_ONLY
         // to track functions during no-tracing periods, possibly replacing the
         // NOP mode for some of those.  For now it is not enabled.
+        // Blocks are mostly built and then executed in the current mode, so
+        // dispatch to it first.
+        res = drbbdup_set_hot_case_encoding(
+            drbbdup_ctx, tracing_mode.load(std::memory_order_acquire));
+        DR_ASSERT(res == DRBBDUP_SUCCESS);
     } else {
         /* Tracing is always on, so we have just one type of instrumentation and
          * do not need block duplication.
@@ -1891,7 +1898,16 @@ event_thread_exit(void *drcontext)
         num_writeouts += data->num_writeouts;
         num_v2p_writeouts += data->num_v2p_writeouts;
         num_phys_markers += data->num_phys_markers;
+        write_behind_stall_us += data->write_behind_stall_us;
+        if (data->write_behind_stall_us > write_behind_max_thread_stall_us)
+            write_behind_max_thread_stall_us = data->write_behind_stall_us;
         dr_mutex_unlock(mutex);
+        if (op_write_behind_threads.get_value() > 0) {
+            NOTIFY(1,
+                   "T" TIDFMT " stalled " UINT64_FORMAT_STRING
+                   " us on write-behind output.\n",
+                   dr_get_thread_id(drcontext), data->write_behind_stall_us);
+        }
         dr_raw_mem_free(data->buf_base, max_buf_size);
         if (data->reserve_buf != NULL)
             dr_raw_mem_free(data->reserve_buf, max_buf_size);
@@ -1921,6 +1937,13 @@ event_exit(void)
            "drmemtrace exiting process " PIDFMT "; traced " UINT64_FORMAT_STRING
            " references in " UINT64_FORMAT_STRING " writeouts.\n",
            dr_get_process_id(), num_refs, num_writeouts);
+    if (op_write_behind_threads.get_value() > 0) {
+        NOTIFY(1,
+               "drmemtrace threads stalled " UINT64_FORMAT_STRING
+               " us in total and at most " UINT64_FORMAT_STRING
+               " us per thread on write-behind output.\n",
+               write_behind_stall_us, write_behind_max_thread_stall_us);
+    }
     if (op_use_physical.get_value()) {
         dr_log(NULL, DR_LOG_ALL, 1,
                "drcachesim num physical address markers emitted: " UINT64_FORMAT_STRING
@@ -1974,6 +1997,8 @@ event_exit(void)
     trace_thread_cb_user_data = nullptr;
     thread_filtering_enabled = false;
     num_refs = 0;
+    write_behind_stall_us = 0;
+    write_behind_max_thread_stall_us = 0;
     num_refs_racy = 0;
     num_filter_refs_racy = 0;
 
@@ -2089,7 +2114,9 @@ fork_init(void *drcontext)
      * initial header in process_and_output_buffer() for offline).
      */
     data->num_refs = 0;
+    data->write_behind_stall_us = 0;
     if (op_offline.get_value()) {
+        fork_init_io();
         data->file = INVALID_FILE;
         if (!init_offline_dir()) {
             FATAL("Failed to create a subdir in %s\n", op_outdir.get_value().c_str());
@@ -2355,6 +2382,7 @@ drmemtrace_client_main(client_id_t id, int argc, const char *argv[])
     // 3 total: thus 1 more than the base.
     if (has_tracing_windows())
         ++ops.num_spill_slots;
+    ops.inter_block_liveness = op_inter_block_liveness.get_value();
 
     if (!drmgr_init() || !drutil_init() || drreg_init(&ops) != DRREG_SUCCESS ||
         !drx_init())
@@ -2441,6 +2469,8 @@ drmemtrace_client_main(client_id_t id, int argc, const char *argv[])
             FATAL("Failed to initialize drpttracer.\n");
     }
 #endif
+
+    start_io_threads();
 }
 
 } // namespace drmemtrace
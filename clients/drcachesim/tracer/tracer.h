@@ -114,6 +114,9 @@ typedef struct {
     uint64 num_phys_markers;
     byte *v2p_buf;
     uint64 num_v2p_writeouts; /* v2p_buf writeout instances. */
+    /* For -write_behind_threads. */
+    uint write_behind_worker;
+    uint64 write_behind_stall_us;
 #ifdef BUILD_PT_TRACER
     /* For syscall kernel trace. */
     syscall_pt_trace_t syscall_pt_trace;
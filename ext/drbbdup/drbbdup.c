@@ -68,6 +68,11 @@
  */
 #define TABLE_SIZE 65536 /* Must be a power of 2 to perform efficient mod. */
 
+/* The maximum number of address ranges that a global case switch flushes. Blocks are
+ * coalesced into this many ranges, as each flush has a fixed cost.
+ */
+#define MAX_GLOBAL_FLUSH_RANGES 16
+
 #ifdef AARCHXX
 #    define MAX_IMMED_IN_CMP 255
 #endif
@@ -100,6 +105,7 @@ typedef enum {
 typedef struct {
     uintptr_t encoding; /* The encoding specific to the case. */
     bool is_defined;    /* Denotes whether the case is defined. */
+    bool is_deferred;   /* Registered, but to be generated upon first use. */
 } drbbdup_case_t;
 
 /* Contains per bb information required for managing bb copies. */
@@ -116,6 +122,8 @@ typedef struct {
     bool is_scratch_reg2_dead; /* If _needed, is DRBBDUP_SCRATCH_REG2 dead at start. */
 #endif
     bool is_gen; /* Denotes whether a new bb copy is dynamically being generated. */
+    bool is_default_hot; /* Denotes whether the default case is dispatched first. */
+    bool is_case_global; /* Denotes whether built for the global case with no dispatch. */
     drbbdup_case_t default_case;
     drbbdup_case_t *cases; /* Is NULL if enable_dup is not set. */
 } drbbdup_manager_t;
@@ -144,6 +152,9 @@ typedef struct {
     instr_t *first_nonlabel_instr; /* The first non label instr of the bb copy. */
     instr_t *last_instr;           /* The last instr of the bb copy being considered. */
     byte *tls_seg_base;            /* For access from another thread. */
+    bool has_hot_case;             /* Whether set-up named a hot case. */
+    uintptr_t hot_case_encoding;   /* The hot case named during set-up. */
+    instr_t *hot_default_label;    /* Target of the hot default case's dispatch. */
 } drbbdup_per_thread;
 
 static bool is_thread_private = false; /* Denotes whether DR caches are thread-private. */
@@ -158,6 +169,8 @@ static drbbdup_stats_t stats;
 
 /* An outlined code cache (storing a clean call) for dynamically generating a case. */
 static app_pc new_case_cache_pc = NULL;
+/* An outlined code cache for generating a deferred case upon first use. */
+static app_pc lazy_case_cache_pc = NULL;
 static void *case_cache_mutex = NULL;
 
 static int tls_idx = -1; /* For thread local storage info. */
@@ -171,6 +184,9 @@ drbbdup_encoding_already_included(drbbdup_manager_t *manager, uintptr_t encoding
 static void
 drbbdup_handle_new_case();
 
+static void
+drbbdup_handle_lazy_case();
+
 static app_pc
 init_fp_cache(void (*clean_call_func)());
 
@@ -264,6 +280,20 @@ drbbdup_count(drbbdup_manager_t *manager)
     return count;
 }
 
+/* Returns the number of cases whose generation is deferred until first use. */
+static uint
+drbbdup_deferred_count(drbbdup_manager_t *manager)
+{
+    ASSERT(manager != NULL, "should not be NULL");
+
+    uint count = 0;
+    for (int i = 0; i < opts.non_default_case_limit; i++) {
+        if (manager->cases[i].is_deferred)
+            count++;
+    }
+    return count;
+}
+
 /* Returns whether there are only two cases and one has a zero encoding. */
 static bool
 drbbdup_case_zero_vs_nonzero(drbbdup_manager_t *manager)
@@ -274,6 +304,8 @@ drbbdup_case_zero_vs_nonzero(drbbdup_manager_t *manager)
     uintptr_t nondefault_encoding = 0;
     bool found = false;
     for (int i = 0; i < opts.non_default_case_limit; i++) {
+        if (manager->cases[i].is_deferred)
+            return false; /* More cases will be added. */
         if (manager->cases[i].is_defined) {
             if (found)
                 return false;
@@ -300,6 +332,73 @@ drbbdup_add_copy(void *drcontext, instrlist_t *bb, instrlist_t *orig_bb)
     }
 }
 
+/* Returns the current value of the global case encoding. */
+static uintptr_t
+drbbdup_get_global_case(void)
+{
+    void *addr = opnd_get_addr(opts.runtime_case_opnd);
+#ifdef X64
+    return (uintptr_t)dr_atomic_load64((volatile int64 *)addr);
+#else
+    return (uintptr_t)dr_atomic_load32((volatile int *)addr);
+#endif
+}
+
+/* Sets up the block to contain only the current global case, without a dispatcher.
+ * The block is treated as having duplication disabled, with the global case taking
+ * the place of the default case.  An encoding that is not registered for the block
+ * leaves the default case in place, just as the dispatcher would.
+ */
+static void
+drbbdup_specialize_for_global_case(drbbdup_manager_t *manager)
+{
+    uintptr_t encoding = drbbdup_get_global_case();
+    if (drbbdup_encoding_already_included(manager, encoding, false))
+        manager->default_case.encoding = encoding;
+    manager->is_case_global = true;
+    manager->enable_dup = false;
+}
+
+/* Arranges for the dispatcher to compare against the hot case first and, with lazy
+ * case generation, defers generating all other non-default cases.
+ */
+static void
+drbbdup_set_up_hot_case(drbbdup_manager_t *manager, uintptr_t encoding)
+{
+    int hot_index = -1;
+    for (int i = 0; i < opts.non_default_case_limit; i++) {
+        if (manager->cases[i].is_defined && manager->cases[i].encoding == encoding) {
+            hot_index = i;
+            break;
+        }
+    }
+    if (hot_index > 0) {
+        /* Copies are laid out and dispatched in case order.  Defined cases are
+         * contiguous, and remain so after the swap.
+         */
+        drbbdup_case_t hot_case = manager->cases[hot_index];
+        manager->cases[hot_index] = manager->cases[0];
+        manager->cases[0] = hot_case;
+    } else if (hot_index < 0) {
+        /* This includes an unregistered encoding, as that dispatches to the default. */
+        manager->is_default_hot = true;
+    }
+    if (opts.lazy_case_generation) {
+        for (int i = manager->is_default_hot ? 0 : 1; i < opts.non_default_case_limit;
+             i++) {
+            if (manager->cases[i].is_defined) {
+                manager->cases[i].is_defined = false;
+                manager->cases[i].is_deferred = true;
+            }
+        }
+    }
+    if (opts.is_stat_enabled) {
+        dr_mutex_lock(stat_mutex);
+        stats.hot_case_count++;
+        dr_mutex_unlock(stat_mutex);
+    }
+}
+
 /* Creates a manager, which contains book-keeping data for a fragment. */
 static drbbdup_manager_t *
 drbbdup_create_manager(void *drcontext, void *tag, instrlist_t *bb)
@@ -345,6 +444,16 @@ drbbdup_create_manager(void *drcontext, void *tag, instrlist_t *bb)
                       "dynamic case generation was disabled globally: cannot enable");
     }
 
+    drbbdup_per_thread *pt =
+        (drbbdup_per_thread *)drmgr_get_tls_field(drcontext, tls_idx);
+    if (manager->enable_dup) {
+        if (opts.is_case_global)
+            drbbdup_specialize_for_global_case(manager);
+        else if (pt->has_hot_case)
+            drbbdup_set_up_hot_case(manager, pt->hot_case_encoding);
+    }
+    pt->has_hot_case = false;
+
     /* Check whether user wants copies for this particular bb. */
     if (!manager->enable_dup && manager->cases != NULL) {
         /* Multiple cases not wanted. Destroy cases. */
@@ -468,7 +577,9 @@ drbbdup_set_up_copies(void *drcontext, instrlist_t *bb, drbbdup_manager_t *manag
 
     /* Perform duplication. */
     int num_copies = (int)drbbdup_count(manager);
-    ASSERT(num_copies >= 1, "there must be at least one copy");
+    /* With lazy case generation the default case may be the only copy so far. */
+    ASSERT(num_copies >= 1 || drbbdup_deferred_count(manager) > 0,
+           "there must be at least one copy");
     int start = num_copies - 1;
     int i;
     for (i = start; i >= 0; i--) {
@@ -537,6 +648,11 @@ drbbdup_set_up_copies(void *drcontext, instrlist_t *bb, drbbdup_manager_t *manag
 static bool
 is_dup_expected(drbbdup_manager_t *manager, bool for_trace, bool translating)
 {
+    /* A trace must use the global case in effect now, which may have changed since
+     * its constituent blocks were built.
+     */
+    if (manager != NULL && manager->is_case_global && !translating)
+        return false;
     return for_trace || translating || (manager != NULL && manager->is_gen);
 }
 
@@ -563,7 +679,9 @@ drbbdup_do_duplication(hashtable_t *manager_table, void *drcontext, void *tag,
 
         if (opts.is_stat_enabled) {
             dr_mutex_lock(stat_mutex);
-            if (!manager->enable_dup)
+            if (manager->is_case_global)
+                stats.global_case_count++;
+            else if (!manager->enable_dup)
                 stats.no_dup_count++;
             if (!manager->enable_dynamic_handling)
                 stats.no_dynamic_handling_count++;
@@ -577,6 +695,12 @@ drbbdup_do_duplication(hashtable_t *manager_table, void *drcontext, void *tag,
 
             dr_mutex_unlock(case_cache_mutex);
         }
+        if (manager->enable_dup && drbbdup_deferred_count(manager) > 0) {
+            dr_mutex_lock(case_cache_mutex);
+            if (lazy_case_cache_pc == NULL)
+                lazy_case_cache_pc = init_fp_cache(drbbdup_handle_lazy_case);
+            dr_mutex_unlock(case_cache_mutex);
+        }
     }
 
     if (manager->enable_dup) {
@@ -1306,7 +1430,7 @@ drbbdup_do_dynamic_handling(drbbdup_manager_t *manager)
     for (i = 0; i < opts.non_default_case_limit; i++) {
         drbbdup_case = &manager->cases[i];
         /* Search for empty undefined slot. */
-        if (!drbbdup_case->is_defined)
+        if (!drbbdup_case->is_defined && !drbbdup_case->is_deferred)
             return true;
     }
 
@@ -1424,12 +1548,53 @@ drbbdup_insert_dynamic_handling(void *drcontext, void *tag, instrlist_t *bb,
     instrlist_meta_preinsert(bb, where, done_label);
 }
 
+/* Insert the trigger for generating a deferred case upon its first encounter. */
+static void
+drbbdup_insert_lazy_handling(void *drcontext, void *tag, instrlist_t *bb, instr_t *where,
+                             drbbdup_manager_t *manager)
+{
+    opnd_t drbbdup_opnd = opnd_create_reg(manager->scratch_reg);
+    instr_t *gen_label = INSTR_CREATE_label(drcontext);
+    instr_t *done_label = INSTR_CREATE_label(drcontext);
+
+    ASSERT(lazy_case_cache_pc != NULL,
+           "case cache for lazy generation must be already initialised.");
+    ASSERT(manager->scratch_reg == DRBBDUP_SCRATCH_REG, "must have main scratch reg");
+
+    for (int i = 0; i < opts.non_default_case_limit; i++) {
+        if (!manager->cases[i].is_deferred)
+            continue;
+        drbbdup_insert_compare_encoding_and_branch(
+            drcontext, bb, where, manager, &manager->cases[i], false /*avoid_flags*/,
+            manager->scratch_reg, true /*=jmp_if_equal*/, gen_label);
+    }
+    instrlist_meta_preinsert(bb, where,
+                             XINST_CREATE_jump(drcontext, opnd_create_instr(done_label)));
+
+    instrlist_meta_preinsert(bb, where, gen_label);
+    /* Pass the encoding and the tag to the outlined clean call. */
+    opnd_t encoding_opnd =
+        drbbdup_get_tls_raw_slot_opnd(drcontext, DRBBDUP_ENCODING_SLOT);
+    instrlist_meta_preinsert(bb, where,
+                             XINST_CREATE_store(drcontext, encoding_opnd, drbbdup_opnd));
+    instrlist_insert_mov_immed_ptrsz(drcontext, (ptr_int_t)tag, drbbdup_opnd, bb, where,
+                                     NULL, NULL);
+    instrlist_meta_preinsert(
+        bb, where, XINST_CREATE_jump(drcontext, opnd_create_pc(lazy_case_cache_pc)));
+
+    instrlist_meta_preinsert(bb, where, done_label);
+}
+
 /* Inserts code right before the last bb copy which is used to handle the default
  * case. */
 static void
 drbbdup_insert_dispatch_end(void *drcontext, void *tag, instrlist_t *bb, instr_t *where,
-                            drbbdup_manager_t *manager)
+                            drbbdup_per_thread *pt, drbbdup_manager_t *manager)
 {
+    /* Deferred cases are not unknown: check for them before any dynamic handling. */
+    if (drbbdup_deferred_count(manager) > 0)
+        drbbdup_insert_lazy_handling(drcontext, tag, bb, where, manager);
+
     /* Check whether dynamic case handling is enabled by the user to handle an unkown
      * case encoding.
      */
@@ -1437,10 +1602,35 @@ drbbdup_insert_dispatch_end(void *drcontext, void *tag, instrlist_t *bb, instr_t
         drbbdup_insert_dynamic_handling(drcontext, tag, bb, where, manager);
     }
 
+    /* A hot default case skips all of the above. */
+    if (pt->hot_default_label != NULL) {
+        instrlist_meta_preinsert(bb, where, pt->hot_default_label);
+        pt->hot_default_label = NULL;
+    }
+
     /* Last bb version is always the default case. */
     drbbdup_insert_landing_restoration(drcontext, bb, where, manager);
 }
 
+/* Records the cost of the dispatcher that was just inserted for a new fragment. */
+static void
+drbbdup_record_dispatch_stats(drbbdup_manager_t *manager)
+{
+    uint compares = drbbdup_count(manager) + drbbdup_deferred_count(manager);
+    if (manager->is_default_hot && !drbbdup_case_zero_vs_nonzero(manager))
+        compares++;
+    if (manager->enable_dynamic_handling)
+        compares++;
+    dr_mutex_lock(stat_mutex);
+    stats.dispatch_count++;
+    stats.dispatch_compare_count += compares;
+    if (!manager->are_flags_dead)
+        stats.dispatch_flags_spill_count++;
+    if (!manager->is_scratch_reg_dead)
+        stats.dispatch_reg_spill_count++;
+    dr_mutex_unlock(stat_mutex);
+}
+
 static dr_emit_flags_t
 drbbdup_instrument_instr(void *drcontext, void *tag, instrlist_t *bb, instr_t *instr,
                          instr_t *where, bool for_trace, bool translating,
@@ -1508,6 +1698,19 @@ drbbdup_instrument_dups(void *drcontext, void *tag, instrlist_t *bb, instr_t *in
     if (drmgr_is_first_instr(drcontext, instr)) {
         ASSERT(pt->case_index == -1, "case index should start at -1");
         drbbdup_encode_runtime_case(drcontext, pt, tag, bb, instr, manager);
+        /* A hot default case jumps straight to its copy instead of being compared
+         * against every other case first.  This is not worthwhile for the aflags-free
+         * zero-vs-nonzero dispatch, which needs a single compare anyway.
+         */
+        if (manager->is_default_hot && !drbbdup_case_zero_vs_nonzero(manager)) {
+            pt->hot_default_label = INSTR_CREATE_label(drcontext);
+            drbbdup_insert_compare_encoding_and_branch(
+                drcontext, bb, instr, manager, &manager->default_case,
+                false /*avoid_flags*/, manager->scratch_reg, true /*=jmp_if_equal*/,
+                pt->hot_default_label);
+        }
+        if (opts.is_stat_enabled && !translating)
+            drbbdup_record_dispatch_stats(manager);
     }
 
     if (drbbdup_is_at_start(instr)) {
@@ -1561,7 +1764,7 @@ drbbdup_instrument_dups(void *drcontext, void *tag, instrlist_t *bb, instr_t *in
         instr_t *next_bb_label = drbbdup_next_start(end_instr);
         if (next_bb_label == NULL) {
             pt->case_index = DRBBDUP_DEFAULT_INDEX; /* Refer to default. */
-            drbbdup_insert_dispatch_end(drcontext, tag, bb, next_instr, manager);
+            drbbdup_insert_dispatch_end(drcontext, tag, bb, next_instr, pt, manager);
         } else {
             /* We have reached the start of a new bb version (not the last one). */
             IF_DEBUG(bool found = false;)
@@ -1765,7 +1968,7 @@ drbbdup_include_encoding(drbbdup_manager_t *manager, uintptr_t new_encoding)
         drbbdup_case_t *dup_case;
         for (i = 0; i < opts.non_default_case_limit; i++) {
             dup_case = &manager->cases[i];
-            if (!dup_case->is_defined) {
+            if (!dup_case->is_defined && !dup_case->is_deferred) {
                 dup_case->is_defined = true;
                 dup_case->encoding = new_encoding;
                 return true;
@@ -1934,6 +2137,90 @@ drbbdup_handle_new_case()
     dr_redirect_execution(&mcontext);
 }
 
+/* Turns a deferred case into a defined one and prepares the redirection to the start
+ * of the bb.  Defined cases are kept contiguous, as instrumentation walks them in
+ * order, by moving the case into the first free slot.
+ */
+static void
+drbbdup_manage_lazy_case(void *drcontext, hashtable_t *manager_table,
+                         uintptr_t encoding, void *tag, dr_mcontext_t *mcontext,
+                         app_pc pc)
+{
+    drbbdup_manager_t *manager =
+        (drbbdup_manager_t *)hashtable_lookup(manager_table, tag);
+    ASSERT(manager != NULL, "manager cannot be NULL");
+    ASSERT(manager->enable_dup, "duplication should be enabled");
+
+    int deferred_index = -1, free_index = -1;
+    for (int i = 0; i < opts.non_default_case_limit; i++) {
+        drbbdup_case_t *dup_case = &manager->cases[i];
+        if (dup_case->is_deferred && dup_case->encoding == encoding)
+            deferred_index = i;
+        if (!dup_case->is_defined && free_index == -1)
+            free_index = i;
+    }
+    /* The case could have been generated already by another thread. */
+    if (deferred_index != -1) {
+        ASSERT(free_index != -1 && free_index <= deferred_index, "no free slot");
+        manager->cases[deferred_index] = manager->cases[free_index];
+        manager->cases[free_index].encoding = encoding;
+        manager->cases[free_index].is_defined = true;
+        manager->cases[free_index].is_deferred = false;
+        /* Keep the book-keeping data when the bb is rebuilt. */
+        manager->is_gen = true;
+        if (opts.is_stat_enabled) {
+            dr_mutex_lock(stat_mutex);
+            stats.lazy_gen_count++;
+            dr_mutex_unlock(stat_mutex);
+        }
+    }
+
+    drbbdup_prepare_redirect(drcontext, mcontext, manager, pc);
+}
+
+static void
+drbbdup_handle_lazy_case()
+{
+    void *drcontext = dr_get_current_drcontext();
+
+    drbbdup_per_thread *pt =
+        (drbbdup_per_thread *)drmgr_get_tls_field(drcontext, tls_idx);
+
+    /* Must use DR_MC_ALL due to dr_redirect_execution. */
+    dr_mcontext_t mcontext;
+    mcontext.size = sizeof(mcontext);
+    mcontext.flags = DR_MC_ALL;
+    dr_get_mcontext(drcontext, &mcontext);
+
+    /* Scratch register holds the tag. */
+    void *tag = (void *)reg_get_value(DRBBDUP_SCRATCH_REG, &mcontext);
+    app_pc pc = dr_fragment_app_pc(tag);
+
+    /* Get the deferred case. */
+    uintptr_t encoding = drbbdup_get_tls_raw_slot_val(drcontext, DRBBDUP_ENCODING_SLOT);
+
+    if (is_thread_private) {
+        drbbdup_manage_lazy_case(drcontext, &pt->manager_table, encoding, tag, &mcontext,
+                                 pc);
+    } else {
+        dr_rwlock_write_lock(rw_lock);
+        drbbdup_manage_lazy_case(drcontext, &global_manager_table, encoding, tag,
+                                 &mcontext, pc);
+        dr_rwlock_write_unlock(rw_lock);
+    }
+
+    LOG(drcontext, DR_LOG_ALL, 2,
+        "%s First use of case " PIFX " in bb with tag %p: flushing to generate it.\n",
+        __FUNCTION__, encoding, tag);
+
+    /* The fragment we came from lacks the case even if another thread generated it
+     * meanwhile, so we always flush.  No locks are held here.
+     */
+    dr_flush_region(pc, 1);
+
+    dr_redirect_execution(&mcontext);
+}
+
 static app_pc
 init_fp_cache(void (*clean_call_func)())
 {
@@ -1944,9 +2231,6 @@ init_fp_cache(void (*clean_call_func)())
     size_t size = dr_page_size();
     ilist = instrlist_create(drcontext);
 
-    DR_ASSERT_MSG(!opts.never_enable_dynamic_handling,
-                  "should not reach here if dynamic cases were disabled globally");
-
     dr_insert_clean_call(drcontext, ilist, NULL, (void *)clean_call_func, false, 0);
 
     /* Allocate code cache, and set Read-Write-Execute permissions using
@@ -1997,6 +2281,108 @@ drbbdup_register_case_encoding(void *drbbdup_ctx, uintptr_t encoding)
         return DRBBDUP_ERROR_CASE_LIMIT_REACHED;
 }
 
+drbbdup_status_t
+drbbdup_set_hot_case_encoding(void *drbbdup_ctx, uintptr_t encoding)
+{
+    if (drbbdup_init_count == 0)
+        return DRBBDUP_ERROR_NOT_INITIALIZED;
+    if (drbbdup_ctx == NULL)
+        return DRBBDUP_ERROR_INVALID_PARAMETER;
+
+    /* The call-back runs in the thread building the block, and the cases are only
+     * re-ordered once it returns so that registration order does not matter.
+     */
+    drbbdup_per_thread *pt =
+        (drbbdup_per_thread *)drmgr_get_tls_field(dr_get_current_drcontext(), tls_idx);
+    pt->has_hot_case = true;
+    pt->hot_case_encoding = encoding;
+    return DRBBDUP_SUCCESS;
+}
+
+/* Adds [tag, tag + 1) to the sorted ranges to flush.  Once there are too many
+ * ranges, the two closest ones are merged, which may flush blocks needlessly but
+ * keeps the number of flushes bounded.
+ */
+static void
+drbbdup_add_flush_range(app_pc *starts, app_pc *ends, uint *count, app_pc tag)
+{
+    uint i;
+    for (i = 0; i < *count && starts[i] <= tag; i++) {
+        if (tag < ends[i])
+            return; /* Already covered. */
+    }
+    for (uint j = *count; j > i; j--) {
+        starts[j] = starts[j - 1];
+        ends[j] = ends[j - 1];
+    }
+    starts[i] = tag;
+    ends[i] = tag + 1;
+    (*count)++;
+    if (*count <= MAX_GLOBAL_FLUSH_RANGES)
+        return;
+    uint closest = 0;
+    for (i = 1; i < *count - 1; i++) {
+        if (starts[i + 1] - ends[i] < starts[closest + 1] - ends[closest])
+            closest = i;
+    }
+    ends[closest] = ends[closest + 1];
+    for (i = closest + 1; i < *count - 1; i++) {
+        starts[i] = starts[i + 1];
+        ends[i] = ends[i + 1];
+    }
+    (*count)--;
+}
+
+drbbdup_status_t
+drbbdup_set_global_case_encoding(uintptr_t encoding)
+{
+    if (drbbdup_init_count == 0)
+        return DRBBDUP_ERROR_NOT_INITIALIZED;
+    if (!opts.is_case_global)
+        return DRBBDUP_ERROR_UNSET_FEATURE;
+
+    void *addr = opnd_get_addr(opts.runtime_case_opnd);
+    if (drbbdup_get_global_case() == encoding)
+        return DRBBDUP_SUCCESS;
+#ifdef X64
+    dr_atomic_store64((volatile int64 *)addr, (int64)encoding);
+#else
+    dr_atomic_store32((volatile int *)addr, (int)encoding);
+#endif
+
+    /* Blocks built from now on use the new encoding.  Collect the ones built for
+     * other cases.  A block whose case was not registered was built for its default
+     * case, which might happen to also be correct for the new encoding: we flush
+     * it anyway rather than keep the set of registered cases for every block.
+     */
+    app_pc starts[MAX_GLOBAL_FLUSH_RANGES + 1];
+    app_pc ends[MAX_GLOBAL_FLUSH_RANGES + 1];
+    uint count = 0;
+    dr_rwlock_read_lock(rw_lock);
+    for (uint i = 0; i < HASHTABLE_SIZE(global_manager_table.table_bits); i++) {
+        for (hash_entry_t *he = global_manager_table.table[i]; he != NULL;
+             he = he->next) {
+            drbbdup_manager_t *manager = (drbbdup_manager_t *)he->payload;
+            if (manager->is_case_global && manager->default_case.encoding != encoding) {
+                drbbdup_add_flush_range(starts, ends, &count,
+                                        dr_fragment_app_pc(he->key));
+            }
+        }
+    }
+    dr_rwlock_read_unlock(rw_lock);
+
+    for (uint i = 0; i < count; i++)
+        dr_unlink_flush_region(starts[i], ends[i] - starts[i]);
+
+    if (opts.is_stat_enabled) {
+        dr_mutex_lock(stat_mutex);
+        stats.global_switch_count++;
+        stats.global_flush_count += count;
+        dr_mutex_unlock(stat_mutex);
+    }
+    return DRBBDUP_SUCCESS;
+}
+
 drbbdup_status_t
 drbbdup_is_first_instr(void *drcontext, instr_t *instr, bool *is_start)
 {
@@ -2375,6 +2761,15 @@ drbbdup_init(drbbdup_options_t *ops_in)
      */
     memcpy(&opts, ops_in, ops_in->struct_size);
 
+    if (opts.is_case_global) {
+        /* The encoding is read when building blocks rather than in the cache. */
+        if (opts.insert_encode != NULL || dr_using_all_private_caches())
+            return DRBBDUP_ERROR_INVALID_PARAMETER;
+        if (!opnd_is_abs_addr(opts.runtime_case_opnd) &&
+            !opnd_is_rel_addr(opts.runtime_case_opnd))
+            return DRBBDUP_ERROR_INVALID_OPND;
+    }
+
     drreg_options_t drreg_ops = { sizeof(drreg_ops), 0 /* no regs needed */, false, NULL,
                                   true };
     drmgr_priority_t app2app_priority = { sizeof(drmgr_priority_t),
@@ -2444,6 +2839,8 @@ drbbdup_exit(void)
         /* Destroy only if initialised (which is done in a lazy fashion). */
         if (new_case_cache_pc != NULL)
             destroy_fp_cache(new_case_cache_pc);
+        if (lazy_case_cache_pc != NULL)
+            destroy_fp_cache(lazy_case_cache_pc);
         dr_mutex_destroy(case_cache_mutex);
 
         if (!drmgr_unregister_bb_app2app_event(drbbdup_duplicate_phase) ||
@@ -2466,6 +2863,7 @@ drbbdup_exit(void)
 
         /* Reset for re-attach. */
         new_case_cache_pc = NULL;
+        lazy_case_cache_pc = NULL;
 
     } else {
         /* Cannot have more than one initialisation of drbbdup. */
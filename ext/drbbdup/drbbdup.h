@@ -352,6 +352,28 @@ typedef struct {
      * usage by not allocating bookkeeping data needed for dynamic handling.
      */
     bool never_enable_dynamic_handling;
+    /**
+     * If true, a block whose #drbbdup_set_up_bb_dups_t call-back names a hot case via
+     * drbbdup_set_hot_case_encoding() is initially built with copies for only the hot
+     * case and the default case.  Each other registered case is generated the first
+     * time a thread encounters its encoding in that block, which flushes the block
+     * with dr_flush_region() and so synchronizes with all threads.  This avoids
+     * building instrumentation for cases that a block never executes under, at the
+     * cost of one flush per case that is eventually generated.
+     */
+    bool lazy_case_generation;
+    /**
+     * If true, the runtime case encoding is a single value shared by all threads that
+     * changes rarely.  Rather than dispatching on every block entry, each block that
+     * has duplication enabled is built with only the case matching the encoding that
+     * is in effect at the time, with no dispatch code at all.  The encoding must then
+     * be changed exclusively via drbbdup_set_global_case_encoding(), which flushes
+     * the blocks built for other cases.  This requires thread-shared code caches, a
+     * NULL \p insert_encode, and an absolute or pc-relative \p runtime_case_opnd.
+     * When set, \p lazy_case_generation and drbbdup_set_hot_case_encoding() have no
+     * effect.
+     */
+    bool is_case_global;
 } drbbdup_options_t;
 
 /**
@@ -371,6 +393,30 @@ typedef struct {
      * cases.
      */
     unsigned long bail_count;
+    /** Number of fragments built with a dispatcher. */
+    unsigned long dispatch_count;
+    /**
+     * Number of case encoding comparisons across the dispatchers of all fragments
+     * built.  Dividing by \p dispatch_count gives the average dispatcher length.
+     */
+    unsigned long dispatch_compare_count;
+    /** Number of dispatchers that preserve the arithmetic flags. */
+    unsigned long dispatch_flags_spill_count;
+    /** Number of dispatchers that spill a scratch register. */
+    unsigned long dispatch_reg_spill_count;
+    /** Number of fragments that dispatch to a hot case first. */
+    unsigned long hot_case_count;
+    /**
+     * Number of cases generated upon first use via
+     * #drbbdup_options_t.lazy_case_generation.
+     */
+    unsigned long lazy_gen_count;
+    /** Number of fragments built for the global case without a dispatcher. */
+    unsigned long global_case_count;
+    /** Number of calls to drbbdup_set_global_case_encoding() that changed the case. */
+    unsigned long global_switch_count;
+    /** Number of address ranges flushed by global case switches. */
+    unsigned long global_flush_count;
 } drbbdup_stats_t;
 
 /**
@@ -438,6 +484,46 @@ DR_EXPORT
 drbbdup_status_t
 drbbdup_register_case_encoding(void *drbbdup_ctx, uintptr_t encoding);
 
+DR_EXPORT
+/**
+ * Names \p encoding as the hot case of the basic block being set up: the case that is
+ * expected to execute most often.  The dispatcher compares against the hot case first
+ * so that it is reached with a single comparison.  The function should only be called
+ * by a #drbbdup_set_up_bb_dups_t call-back function which provides \p drbbdup_ctx.
+ *
+ * \p encoding may be the default case or a registered case, in either order relative
+ * to drbbdup_register_case_encoding().  Any other value names the default case, as
+ * that is where such an encoding is dispatched.  A natural choice when the encoding
+ * is a global mode is the mode in effect when the block is built.
+ *
+ * See also #drbbdup_options_t.lazy_case_generation.
+ *
+ * @return whether successful or an error code on failure.
+ */
+drbbdup_status_t
+drbbdup_set_hot_case_encoding(void *drbbdup_ctx, uintptr_t encoding);
+
+DR_EXPORT
+/**
+ * Changes the runtime case encoding to \p encoding when
+ * #drbbdup_options_t.is_case_global is set.  The new value is written to the memory
+ * referred to by #drbbdup_options_t.runtime_case_opnd, and every block that was built
+ * for a different case is then flushed via dr_unlink_flush_region() so that it is
+ * rebuilt for the new case.  Flushing is selective: the flushed blocks are coalesced
+ * into a small number of address ranges, which can also flush some neighboring blocks.
+ *
+ * The same restrictions apply as for dr_unlink_flush_region(): this may only be
+ * called from a clean call, a nudge, or a pre- or post-system call event, with no
+ * locks held.  A thread that is already executing inside a flushed fragment
+ * completes that fragment, which for a trace can span several blocks, under the
+ * prior case.  A clean call that needs the new case to take effect at once can call
+ * dr_redirect_execution() afterward.
+ *
+ * @return whether successful or an error code on failure.
+ */
+drbbdup_status_t
+drbbdup_set_global_case_encoding(uintptr_t encoding);
+
 DR_EXPORT
 /**
  * Indicates whether the instruction \p instr is the first instruction of
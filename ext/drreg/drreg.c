@@ -43,6 +43,7 @@
 #include "dr_api.h"
 #include "drmgr.h"
 #include "drvector.h"
+#include "hashtable.h"
 #include "drreg.h"
 #include "../ext_utils.h"
 #include <string.h>
@@ -130,6 +131,26 @@ typedef struct _per_thread_t {
 
 static drreg_options_t ops;
 
+/* For ops.inter_block_liveness: the liveness at the entry to a block, computed by
+ * decoding forward from its start pc.  Each entry is keyed by app pc.
+ */
+typedef struct _entry_liveness_t {
+    /* Bit GPR_IDX(reg) is set if reg is written before it is read. */
+    uint64 dead_gprs;
+    /* The EFLAGS_READ_ARITH bits for the flags that are read before written. */
+    ptr_uint_t aflags;
+} entry_liveness_t;
+
+/* We bound the forward decoding of a successor block. */
+#define MAX_ENTRY_LIVENESS_INSTRS 64
+#define ENTRY_LIVENESS_TABLE_BITS 10
+
+static hashtable_t entry_liveness_table;
+/* We use our own lock rather than a synchronized table so that a lookup and its
+ * subsequent add can be done without a lock in between.
+ */
+static void *entry_liveness_lock;
+
 static int tls_idx = -1;
 static uint tls_slot_offs;
 static reg_id_t tls_seg;
@@ -338,6 +359,214 @@ count_app_uses(per_thread_t *pt, opnd_t opnd)
     }
 }
 
+/* Registers that we never consider dead at a block exit. */
+static bool
+is_inter_block_candidate(reg_id_t reg)
+{
+    return !(reg == dr_get_stolen_reg() IF_ARM(|| reg == DR_REG_PC)
+                 IF_NOT_ARM(|| reg == DR_REG_XSP));
+}
+
+static void
+entry_liveness_free(void *entry)
+{
+    dr_global_free(entry, sizeof(entry_liveness_t));
+}
+
+/* Decodes forward from pc until the first control transfer or until
+ * MAX_ENTRY_LIVENESS_INSTRS instructions, recording which registers and arithmetic
+ * flags are written before they are read.  Anything not yet determined at that
+ * point is considered live.
+ */
+static void
+decode_entry_liveness(void *drcontext, app_pc pc, OUT entry_liveness_t *live)
+{
+    byte buf[MAX_INSTR_LENGTH];
+    uint64 known_gprs = 0;
+    ptr_uint_t known_aflags = 0;
+    instr_t instr;
+    reg_id_t reg;
+    int i;
+
+    live->dead_gprs = 0;
+    live->aflags = 0;
+    instr_init(drcontext, &instr);
+    for (i = 0; i < MAX_ENTRY_LIVENESS_INSTRS; i++) {
+        byte *next;
+        ptr_uint_t aflags_new, aflags_read;
+        /* We give up on an instruction close to the end of a readable region. */
+        if (!dr_safe_read(pc, sizeof(buf), buf, NULL))
+            break;
+        instr_reset(drcontext, &instr);
+        next = decode_from_copy(drcontext, buf, pc, &instr);
+        if (next == NULL || !instr_valid(&instr))
+            break;
+        /* We use the same queries as drreg_event_bb_analysis(). */
+        for (reg = DR_REG_START_GPR; reg <= DR_REG_STOP_GPR; reg++) {
+            uint64 bit = 1ULL << GPR_IDX(reg);
+            if (TEST(bit, known_gprs) || !is_inter_block_candidate(reg))
+                continue;
+            if (instr_reads_from_reg(&instr, reg, DR_QUERY_INCLUDE_COND_SRCS))
+                known_gprs |= bit;
+            else if (instr_writes_to_exact_reg(&instr, reg, DR_QUERY_INCLUDE_COND_SRCS)
+                     IF_X64(||
+                            instr_writes_to_exact_reg(&instr, reg_64_to_32(reg),
+                                                      DR_QUERY_INCLUDE_COND_SRCS))) {
+                known_gprs |= bit;
+                live->dead_gprs |= bit;
+            }
+        }
+        aflags_new = instr_get_arith_flags(&instr, DR_QUERY_INCLUDE_COND_SRCS);
+        aflags_read = (aflags_new & EFLAGS_READ_ARITH);
+        live->aflags |= (aflags_read & ~known_aflags);
+        known_aflags |=
+            aflags_read | EFLAGS_WRITE_TO_READ(aflags_new & EFLAGS_WRITE_ARITH);
+        if (instr_is_cti(&instr) || instr_is_interrupt(&instr) ||
+            instr_is_syscall(&instr))
+            break;
+        pc += (next - buf);
+    }
+    live->aflags |= (EFLAGS_READ_ARITH & ~known_aflags);
+    instr_free(drcontext, &instr);
+}
+
+/* Returns the cached liveness at the entry to pc, computing it if not yet known. */
+static void
+get_entry_liveness(void *drcontext, app_pc pc, OUT entry_liveness_t *live)
+{
+    entry_liveness_t *entry;
+    dr_mutex_lock(entry_liveness_lock);
+    entry = (entry_liveness_t *)hashtable_lookup(&entry_liveness_table, pc);
+    if (entry == NULL) {
+        entry = (entry_liveness_t *)dr_global_alloc(sizeof(*entry));
+        decode_entry_liveness(drcontext, pc, entry);
+        hashtable_add(&entry_liveness_table, pc, entry);
+    }
+    *live = *entry;
+    dr_mutex_unlock(entry_liveness_lock);
+}
+
+/* Sets the bounds of the non-writable module region containing tag, or leaves them
+ * NULL if tag is not in such a region.
+ */
+static void
+get_block_image_region(void *tag, OUT app_pc *start, OUT app_pc *end)
+{
+    app_pc pc = dr_fragment_app_pc(tag);
+    dr_mem_info_t info;
+    *start = NULL;
+    *end = NULL;
+    if (!dr_query_memory_ex(pc, &info) || TEST(DR_MEMPROT_WRITE, info.prot))
+        return;
+    if (info.type != DR_MEMTYPE_IMAGE) {
+        /* On UNIX, the segments of a module are not reported as image memory. */
+        module_data_t *mod = dr_lookup_module(pc);
+        if (mod == NULL)
+            return;
+        dr_free_module_data(mod);
+    }
+    *start = info.base_pc;
+    *end = info.base_pc + info.size;
+}
+
+static bool
+get_successor_liveness(void *drcontext, app_pc pc, app_pc region_start,
+                       app_pc region_end, OUT entry_liveness_t *live)
+{
+    if (pc < region_start || pc >= region_end)
+        return false;
+    get_entry_liveness(drcontext, pc, live);
+    return true;
+}
+
+static void
+get_liveness_at_index(per_thread_t *pt, uint index, OUT entry_liveness_t *live)
+{
+    reg_id_t reg;
+    live->dead_gprs = 0;
+    for (reg = DR_REG_START_GPR; reg <= DR_REG_STOP_GPR; reg++) {
+        if (drvector_get_entry(&pt->reg[GPR_IDX(reg)].live, index) == REG_DEAD)
+            live->dead_gprs |= 1ULL << GPR_IDX(reg);
+    }
+    live->aflags = (ptr_uint_t)drvector_get_entry(&pt->aflags.live, index);
+}
+
+/* Combines the liveness of two paths: a value is live if live on either. */
+static void
+merge_liveness(entry_liveness_t *dst, const entry_liveness_t *src)
+{
+    dst->dead_gprs &= src->dead_gprs;
+    dst->aflags |= src->aflags;
+}
+
+static bool
+get_fallthrough_liveness(void *drcontext, instrlist_t *bb, app_pc region_start,
+                         app_pc region_end, OUT entry_liveness_t *live)
+{
+    instr_t *last = instrlist_last_app(bb);
+    app_pc next_pc;
+    if (last == NULL || instr_get_app_pc(last) == NULL)
+        return false;
+    next_pc = decode_next_pc(drcontext, instr_get_app_pc(last));
+    if (next_pc == NULL)
+        return false;
+    return get_successor_liveness(drcontext, next_pc, region_start, region_end, live);
+}
+
+/* Computes the liveness just after inst, which is at reverse index index and is
+ * either a control transfer or the final instruction of bb.  Returns false if
+ * everything must be considered live there.
+ */
+static bool
+get_exit_liveness(void *drcontext, per_thread_t *pt, instrlist_t *bb, instr_t *inst,
+                  uint index, bool xfer, app_pc region_start, app_pc region_end,
+                  OUT entry_liveness_t *live)
+{
+    entry_liveness_t fall_live;
+    opnd_t target;
+    if (!xfer) {
+        ASSERT(index == 0, "only the final instr falls through to another block");
+        return get_fallthrough_liveness(drcontext, bb, region_start, region_end, live);
+    }
+    if (!instr_is_ubr(inst) && !instr_is_cbr(inst) && !instr_is_call_direct(inst))
+        return false;
+    target = instr_get_target(inst);
+    if (opnd_is_instr(target) && !instr_is_call_direct(inst)) {
+        /* An intra-list branch: only a forward target has its liveness computed. */
+        instr_t *in;
+        uint dist = 0;
+        for (in = instr_get_next(inst); in != NULL && in != opnd_get_instr(target);
+             in = instr_get_next(in))
+            dist++;
+        if (in == NULL)
+            return false;
+        get_liveness_at_index(pt, index - 1 - dist, live);
+    } else if (opnd_is_pc(target)) {
+        if (!get_successor_liveness(drcontext, opnd_get_pc(target), region_start,
+                                    region_end, live))
+            return false;
+    } else
+        return false;
+    if (instr_is_cbr(inst)) {
+        if (index > 0)
+            get_liveness_at_index(pt, index - 1, &fall_live);
+        else if (!get_fallthrough_liveness(drcontext, bb, region_start, region_end,
+                                           &fall_live))
+            return false;
+        merge_liveness(live, &fall_live);
+    }
+    return true;
+}
+
+static void
+drreg_event_module_unload(void *drcontext, const module_data_t *info)
+{
+    /* A new module could be loaded at the same addresses. */
+    dr_mutex_lock(entry_liveness_lock);
+    hashtable_clear(&entry_liveness_table);
+    dr_mutex_unlock(entry_liveness_lock);
+}
+
 /* This event has to go last, to handle labels inserted by other components:
  * else our indices get off, and we can't simply skip labels in the
  * per-instr event b/c we need the liveness to advance at the label
@@ -352,9 +581,15 @@ drreg_event_bb_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for_tr
     ptr_uint_t aflags_new, aflags_cur = 0;
     uint index = 0;
     reg_id_t reg;
+    /* XXX: On 32-bit ARM we would need to decode successors in their own ISA mode. */
+    bool inter_block =
+        IF_ARM_ELSE(false, ops.inter_block_liveness && !ops.conservative);
+    app_pc region_start = NULL, region_end = NULL;
 
     for (reg = DR_REG_START_GPR; reg <= DR_REG_STOP_GPR; reg++)
         pt->reg[GPR_IDX(reg)].app_uses = 0;
+    if (inter_block)
+        get_block_image_region(tag, &region_start, &region_end);
     /* pt->bb_props is set to 0 at thread init and after each bb */
     pt->bb_has_internal_flow = false;
 
@@ -377,6 +612,12 @@ drreg_event_bb_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for_tr
                 __FUNCTION__, index, get_where_app_pc(inst));
         }
 
+        /* Liveness past the end of a path through the block */
+        entry_liveness_t exit_live;
+        bool has_exit_live = inter_block && (xfer || index == 0) &&
+            get_exit_liveness(drcontext, pt, bb, inst, index, xfer, region_start,
+                              region_end, &exit_live);
+
         /* GPR liveness */
         LOG(drcontext, DR_LOG_ALL, 3, "%s @%d." PFX ":", __FUNCTION__, index,
             get_where_app_pc(inst));
@@ -394,7 +635,10 @@ drreg_event_bb_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for_tr
                             instr_writes_to_exact_reg(inst, reg_64_to_32(reg),
                                                       DR_QUERY_INCLUDE_COND_SRCS)))
                 value = REG_DEAD;
-            else if (xfer)
+            else if (has_exit_live) {
+                value = TEST(1ULL << GPR_IDX(reg), exit_live.dead_gprs) ? REG_DEAD
+                                                                         : REG_LIVE;
+            } else if (xfer)
                 value = REG_LIVE;
             else if (index > 0)
                 value = drvector_get_entry(&pt->reg[GPR_IDX(reg)].live, index - 1);
@@ -405,11 +649,13 @@ drreg_event_bb_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for_tr
 
         /* aflags liveness */
         aflags_new = instr_get_arith_flags(inst, DR_QUERY_INCLUDE_COND_SRCS);
-        if (xfer)
+        if (xfer && !has_exit_live)
             aflags_cur = EFLAGS_READ_ARITH; /* assume flags are read before written */
         else {
             uint aflags_read, aflags_w2r;
-            if (index == 0)
+            if (has_exit_live)
+                aflags_cur = exit_live.aflags;
+            else if (index == 0)
                 aflags_cur = EFLAGS_READ_ARITH; /* assume flags are read before written */
             else {
                 aflags_cur =
@@ -2512,6 +2758,16 @@ drreg_init(drreg_options_t *ops_in)
 #endif
         /* Support use during init when there is no TLS (i#2910). */
         tls_data_init(&init_pt);
+
+        /* We set up the cache regardless of ops_in, as a later drreg_init() call may
+         * request ops.inter_block_liveness.
+         */
+        entry_liveness_lock = dr_mutex_create();
+        hashtable_init_ex(&entry_liveness_table, ENTRY_LIVENESS_TABLE_BITS,
+                          HASH_INTPTR, false /*!str_dup*/, false /*!synch*/,
+                          entry_liveness_free, NULL, NULL);
+        if (!drmgr_register_module_unload_event(drreg_event_module_unload))
+            return DRREG_ERROR;
     }
 
     if (ops_in->struct_size < offsetof(drreg_options_t, error_callback))
@@ -2546,6 +2802,11 @@ drreg_init(drreg_options_t *ops_in)
     /* If anyone wants to be conservative, then be conservative. */
     ops.conservative = ops.conservative || ops_in->conservative;
 
+    if (ops_in->struct_size > offsetof(drreg_options_t, inter_block_liveness)) {
+        ops.inter_block_liveness =
+            ops.inter_block_liveness || ops_in->inter_block_liveness;
+    }
+
     /* The first callback wins. */
     if (ops_in->struct_size > offsetof(drreg_options_t, error_callback) &&
         ops.error_callback == NULL)
@@ -2577,8 +2838,11 @@ drreg_exit(void)
     drmgr_unregister_tls_field(tls_idx);
     if (!drmgr_unregister_bb_insertion_event(drreg_event_bb_insert_early) ||
         !drmgr_unregister_bb_instrumentation_event(drreg_event_bb_analysis) ||
-        !drmgr_unregister_restore_state_ex_event(drreg_event_restore_state))
+        !drmgr_unregister_restore_state_ex_event(drreg_event_restore_state) ||
+        !drmgr_unregister_module_unload_event(drreg_event_module_unload))
         return DRREG_ERROR;
+    hashtable_delete(&entry_liveness_table);
+    dr_mutex_destroy(entry_liveness_lock);
 
     drmgr_exit();
 
@@ -180,6 +180,33 @@ typedef struct _drreg_options_t {
      * needed.
      */
     bool do_not_sum_slots;
+    /**
+     * By default, drreg computes register and arithmetic flag liveness within
+     * each basic block only, and treats every register and flag as live at a
+     * block exit.  This flag requests that drreg also consider the direct
+     * successors of each block: the target of a direct branch or call and the
+     * fall-through of a conditional branch or of a block that ends without a
+     * control transfer.  A register or flag that every such successor writes
+     * before reading is considered dead at the exit, which lets drreg skip
+     * spilling it when it is reserved near the end of a block.  The liveness of
+     * each successor is computed once by decoding its first instructions and is
+     * cached by application address.  Forward branches whose target is inside
+     * the same instruction list (such as those inserted by drbbdup) use the
+     * liveness at the target.
+     *
+     * Only successors inside the same non-writable module image region as the
+     * block are considered, and the cache is discarded whenever a module is
+     * unloaded.  Code in such regions that is modified in place (e.g., by a
+     * hot-patching library) is not supported in this mode.  As with intra-block
+     * liveness, drreg assumes that the application does not rely on the value of
+     * a dead register or flag when a fault happens; tools must likewise not
+     * request the application value of such a register at a block exit.
+     *
+     * This flag has no effect if \p conservative is set, and it is not yet
+     * supported on 32-bit ARM.  If multiple drreg_init() calls are made, this
+     * field is combined by logical OR.
+     */
+    bool inter_block_liveness;
 } drreg_options_t;
 
 DR_EXPORT
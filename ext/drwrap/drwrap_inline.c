@@ -0,0 +1,737 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* drwrap: DynamoRIO Function Wrapping and Replacing Extension
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Clean-call-free function wrapping for the drwrap Extension.
+ *
+ * This lives in its own library so that only users of drwrap_wrap_inline()
+ * depend on drreg and drx.
+ */
+
+#include "dr_api.h"
+#include "drwrap_inline.h"
+#include "drmgr.h"
+#include "drreg.h"
+#include "drx.h"
+#include "hashtable.h"
+#include "drvector.h"
+#include "../ext_utils.h"
+#include <string.h>
+#include <stddef.h> /* offsetof */
+
+/* currently using asserts on internal logic sanity checks (never on
+ * input from user)
+ */
+#ifdef DEBUG
+#    define ASSERT(x, msg) DR_ASSERT_MSG(x, msg)
+#else
+#    define ASSERT(x, msg) /* nothing */
+#endif
+
+#ifdef DEBUG
+static uint verbose = 0;
+#    define NOTIFY(level, ...)                   \
+        do {                                     \
+            if (verbose >= (level)) {            \
+                dr_fprintf(STDERR, __VA_ARGS__); \
+            }                                    \
+        } while (0)
+#else
+#    define NOTIFY(...) /* nothing */
+#endif
+
+#ifdef X86_64
+/* Like drwrap's DRWRAP_REPLACE_RETADDR sentinel, we clobber this caller-saved
+ * register, which is not used for return values, to reach the real return address.
+ */
+#    define RETURN_POINT_SCRATCH_REG DR_REG_RCX
+
+/* The sentinel block that inline-wrapped functions return to. */
+void
+inline_retaddr_sentinel(void);
+#endif
+
+/* drwrap_wrap_inline() requests, keyed by the function.  Never removed until exit.
+ * Protected by inline_lock.
+ */
+typedef struct _inline_entry_t {
+    app_pc func;
+    uint num_args;
+    bool capture_retval;
+    drwrap_inline_batch_cb_t batch_cb;
+    void *user_data;
+} inline_entry_t;
+
+#define INLINE_TABLE_HASH_BITS 6
+static hashtable_t inline_table;
+static void *inline_lock;
+
+/* Each return address replaced for drwrap_wrap_inline() is saved on a per-thread
+ * shadow stack, which is pushed and popped by inline code.  The stack begins with
+ * a zeroed frame that no return can match, which sends an empty-stack return to
+ * the slow path rather than reading off the bottom.
+ */
+typedef struct _inline_frame_t {
+    app_pc retaddr;
+    app_pc func;
+    /* The stack pointer at function entry, which points at the return address. */
+    reg_t xsp;
+} inline_frame_t;
+
+#define INLINE_STACK_DEPTH 512
+#define INLINE_STACK_SIZE ((INLINE_STACK_DEPTH + 1) * sizeof(inline_frame_t))
+
+typedef struct _per_thread_t {
+    inline_frame_t *stack;
+    byte *seg_base;
+} per_thread_t;
+
+static int tls_idx = -1;
+
+/* The records are sized to divide the page size so none straddles the drx_buf
+ * guard page.
+ */
+#define INLINE_BUFFER_SIZE (16 * 4096)
+
+/* Raw TLS slots holding the top and the limit of the shadow stack. */
+#define INLINE_TLS_TOP 0
+#define INLINE_TLS_LIMIT sizeof(void *)
+static reg_id_t inline_tls_seg;
+static uint inline_tls_offs;
+#define INLINE_TLS_SLOT(pt, slot) \
+    (*(inline_frame_t **)((pt)->seg_base + inline_tls_offs + (slot)))
+
+static drx_buf_t *inline_buf;
+/* Scratch registers for the entry instrumentation: any but the argument registers. */
+static drvector_t entry_allowed_regs;
+/* Scratch registers at the sentinel: any but the return value registers and the
+ * register clobbered by the transfer to the real return address.
+ */
+static drvector_t return_allowed_regs;
+
+static int drwrap_inline_init_count;
+
+/***************************************************************************
+ * UTILITIES
+ */
+
+static void
+inline_entry_free(void *v)
+{
+    dr_global_free(v, sizeof(inline_entry_t));
+}
+
+#ifdef X86_64
+/* Mirrors drwrap_arg_addr() for DRWRAP_CALLCONV_DEFAULT at function entry. */
+static opnd_t
+drwrap_inline_arg_opnd(uint arg)
+{
+#    ifdef UNIX
+    static const reg_id_t arg_regs[] = { DR_REG_RDI, DR_REG_RSI, DR_REG_RDX,
+                                         DR_REG_RCX, DR_REG_R8,  DR_REG_R9 };
+    const uint stack_arg_offset = 1 /*retaddr*/;
+#    else
+    static const reg_id_t arg_regs[] = { DR_REG_RCX, DR_REG_RDX, DR_REG_R8, DR_REG_R9 };
+    const uint stack_arg_offset = 1 /*retaddr*/ + 4 /*reserved*/;
+#    endif
+    if (arg < BUFFER_SIZE_ELEMENTS(arg_regs))
+        return opnd_create_reg(arg_regs[arg]);
+    return OPND_CREATE_MEMPTR(DR_REG_XSP,
+                              (arg - BUFFER_SIZE_ELEMENTS(arg_regs) + stack_arg_offset) *
+                                  sizeof(reg_t));
+}
+#endif
+
+/* Hands each run of records sharing a callback to that callback. */
+static void
+drwrap_inline_buf_full(void *drcontext, void *buf_base, size_t size)
+{
+    drwrap_inline_record_t *records = (drwrap_inline_record_t *)buf_base;
+    size_t count = size / sizeof(*records);
+    size_t start = 0;
+    inline_entry_t *run = NULL, *entry = NULL;
+    for (size_t i = 0; i < count; i++) {
+        if (entry == NULL || records[i].func != entry->func) {
+            dr_recurlock_lock(inline_lock);
+            entry = (inline_entry_t *)hashtable_lookup(&inline_table, records[i].func);
+            dr_recurlock_unlock(inline_lock);
+            ASSERT(entry != NULL, "inline record for unknown function");
+            if (entry == NULL)
+                return;
+        }
+        if (run != NULL &&
+            (entry->batch_cb != run->batch_cb || entry->user_data != run->user_data)) {
+            (*run->batch_cb)(drcontext, records + start, i - start, run->user_data);
+            start = i;
+        }
+        run = entry;
+    }
+    if (run != NULL)
+        (*run->batch_cb)(drcontext, records + start, count - start, run->user_data);
+}
+
+/* Writes a record from C code, such as the slow return path. */
+static void
+drwrap_inline_write_record(void *drcontext, drwrap_inline_record_t *record)
+{
+    byte *base = (byte *)drx_buf_get_buffer_base(drcontext, inline_buf);
+    byte *ptr = (byte *)drx_buf_get_buffer_ptr(drcontext, inline_buf);
+    if (ptr + sizeof(*record) > base + drx_buf_get_buffer_size(drcontext, inline_buf)) {
+        drwrap_inline_buf_full(drcontext, base, ptr - base);
+        ptr = base;
+    }
+    memcpy(ptr, record, sizeof(*record));
+    drx_buf_set_buffer_ptr(drcontext, inline_buf, ptr + sizeof(*record));
+}
+
+/***************************************************************************
+ * RETURNS
+ */
+
+/* Called when the top shadow stack frame does not match the stack pointer at the
+ * return sentinel: frames were abandoned by a longjmp or exception, the callee
+ * popped its arguments, or the thread switched stacks.
+ */
+static void
+drwrap_inline_return_slow(reg_t xsp, reg_t retval)
+{
+    void *drcontext = dr_get_current_drcontext();
+    per_thread_t *pt = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+    inline_frame_t *bottom = pt->stack + 1;
+    inline_frame_t *top = INLINE_TLS_SLOT(pt, INLINE_TLS_TOP);
+    inline_frame_t *frame = NULL, *any_frame = NULL, *f, *dst;
+    byte *stack_base = NULL;
+    size_t stack_size = 0;
+    drwrap_inline_record_t record;
+#define ON_THIS_STACK(f) \
+    ((byte *)(f)->xsp >= stack_base && (byte *)(f)->xsp < stack_base + stack_size)
+    /* The frame we returned from is the closest one below xsp, on this stack if
+     * there is one.  Frames further below it on this stack were abandoned, while
+     * frames on other stacks (such as for fibers or a signal stack) are kept.
+     */
+    dr_query_memory((byte *)xsp, &stack_base, &stack_size, NULL);
+    for (f = bottom; f < top; f++) {
+        if (f->xsp >= xsp)
+            continue;
+        if (any_frame == NULL || f->xsp > any_frame->xsp)
+            any_frame = f;
+        if (ON_THIS_STACK(f) && (frame == NULL || f->xsp > frame->xsp))
+            frame = f;
+    }
+    if (frame == NULL)
+        frame = any_frame;
+    if (frame == NULL) {
+        /* The sentinel is only ever written along with a frame, so the app must
+         * have copied it.  We have no return address to go to.
+         */
+        dr_fprintf(STDERR,
+                   "drwrap_inline: T" TIDFMT " reached the return sentinel at " PFX
+                   " with no matching shadow stack frame\n",
+                   dr_get_thread_id(drcontext), xsp);
+        ASSERT(false, "inline return sentinel reached with no matching frame");
+        dr_abort();
+    }
+    NOTIFY(2, "%s: T" TIDFMT " returning from " PFX " to " PFX "\n", __FUNCTION__,
+           dr_get_thread_id(drcontext), frame->func, frame->retaddr);
+    memset(&record, 0, sizeof(record));
+    record.func = frame->func;
+    record.is_return = 1;
+    record.values[0] = retval;
+    dr_write_saved_reg(drcontext, SPILL_SLOT_REDIRECT_NATIVE_TGT, (reg_t)frame->retaddr);
+    /* Pop the frame and the frames it abandoned, keeping the rest in order. */
+    bool frame_on_stack = ON_THIS_STACK(frame);
+    reg_t frame_xsp = frame->xsp;
+    for (f = bottom, dst = bottom; f < top; f++) {
+        if (f == frame || (frame_on_stack && f->xsp < frame_xsp && ON_THIS_STACK(f))) {
+            NOTIFY(2, "%s: T" TIDFMT " dropping frame for " PFX " @ " PFX "\n",
+                   __FUNCTION__, dr_get_thread_id(drcontext), f->func, f->xsp);
+            continue;
+        }
+        *dst++ = *f;
+    }
+    INLINE_TLS_SLOT(pt, INLINE_TLS_TOP) = dst;
+    drwrap_inline_write_record(drcontext, &record);
+#undef ON_THIS_STACK
+}
+
+#ifdef X86_64
+static void
+drwrap_inline_insert_entry(void *drcontext, instrlist_t *bb, instr_t *where,
+                           inline_entry_t *entry)
+{
+    reg_id_t reg_ptr, reg_tmp;
+    if (drreg_reserve_register(drcontext, bb, where, &entry_allowed_regs, &reg_ptr) !=
+            DRREG_SUCCESS ||
+        drreg_reserve_register(drcontext, bb, where, &entry_allowed_regs, &reg_tmp) !=
+            DRREG_SUCCESS ||
+        (entry->capture_retval &&
+         drreg_reserve_aflags(drcontext, bb, where) != DRREG_SUCCESS)) {
+        ASSERT(false, "failed to reserve scratch registers");
+        return;
+    }
+    /* Record the entry first, so a drx_buf fault cannot come after we have
+     * replaced the return address.
+     */
+    drx_buf_insert_load_buf_ptr(drcontext, inline_buf, bb, where, reg_ptr);
+    instrlist_insert_mov_immed_ptrsz(drcontext, (ptr_int_t)entry->func,
+                                     opnd_create_reg(reg_tmp), bb, where, NULL, NULL);
+    drx_buf_insert_buf_store(drcontext, inline_buf, bb, where, reg_ptr, DR_REG_NULL,
+                             opnd_create_reg(reg_tmp), OPSZ_PTR,
+                             offsetof(drwrap_inline_record_t, func));
+    drx_buf_insert_buf_store(drcontext, inline_buf, bb, where, reg_ptr, DR_REG_NULL,
+                             OPND_CREATE_INTPTR(0), OPSZ_PTR,
+                             offsetof(drwrap_inline_record_t, is_return));
+    for (uint i = 0; i < entry->num_args; i++) {
+        opnd_t arg = drwrap_inline_arg_opnd(i);
+        if (!opnd_is_reg(arg)) {
+            instrlist_meta_preinsert(
+                bb, where, XINST_CREATE_load(drcontext, opnd_create_reg(reg_tmp), arg));
+            arg = opnd_create_reg(reg_tmp);
+        }
+        drx_buf_insert_buf_store(drcontext, inline_buf, bb, where, reg_ptr, DR_REG_NULL,
+                                 arg, OPSZ_PTR,
+                                 offsetof(drwrap_inline_record_t, values) +
+                                     i * sizeof(ptr_uint_t));
+    }
+    drx_buf_insert_update_buf_ptr(drcontext, inline_buf, bb, where, reg_ptr, DR_REG_NULL,
+                                  sizeof(drwrap_inline_record_t));
+
+    if (entry->capture_retval) {
+        /* Push the return address on the shadow stack and replace it with the
+         * sentinel, unless the shadow stack is full.
+         */
+        instr_t *skip = INSTR_CREATE_label(drcontext);
+        dr_insert_read_raw_tls(drcontext, bb, where, inline_tls_seg,
+                               inline_tls_offs + INLINE_TLS_TOP, reg_ptr);
+        instrlist_meta_preinsert(
+            bb, where,
+            INSTR_CREATE_cmp(drcontext, opnd_create_reg(reg_ptr),
+                             dr_raw_tls_opnd(drcontext, inline_tls_seg,
+                                             inline_tls_offs + INLINE_TLS_LIMIT)));
+        instrlist_meta_preinsert(
+            bb, where, INSTR_CREATE_jcc(drcontext, OP_jae, opnd_create_instr(skip)));
+        instrlist_meta_preinsert(bb, where,
+                                 XINST_CREATE_load(drcontext, opnd_create_reg(reg_tmp),
+                                                   OPND_CREATE_MEMPTR(DR_REG_XSP, 0)));
+        instrlist_meta_preinsert(
+            bb, where,
+            XINST_CREATE_store(
+                drcontext,
+                OPND_CREATE_MEMPTR(reg_ptr, offsetof(inline_frame_t, retaddr)),
+                opnd_create_reg(reg_tmp)));
+        instrlist_insert_mov_immed_ptrsz(drcontext, (ptr_int_t)entry->func,
+                                         opnd_create_reg(reg_tmp), bb, where, NULL, NULL);
+        instrlist_meta_preinsert(
+            bb, where,
+            XINST_CREATE_store(
+                drcontext, OPND_CREATE_MEMPTR(reg_ptr, offsetof(inline_frame_t, func)),
+                opnd_create_reg(reg_tmp)));
+        instrlist_meta_preinsert(
+            bb, where,
+            XINST_CREATE_store(drcontext,
+                               OPND_CREATE_MEMPTR(reg_ptr, offsetof(inline_frame_t, xsp)),
+                               opnd_create_reg(DR_REG_XSP)));
+        instrlist_meta_preinsert(
+            bb, where,
+            INSTR_CREATE_lea(drcontext, opnd_create_reg(reg_ptr),
+                             OPND_CREATE_MEM_lea(reg_ptr, DR_REG_NULL, 0,
+                                                 sizeof(inline_frame_t))));
+        dr_insert_write_raw_tls(drcontext, bb, where, inline_tls_seg,
+                                inline_tls_offs + INLINE_TLS_TOP, reg_ptr);
+        instrlist_insert_mov_immed_ptrsz(drcontext, (ptr_int_t)inline_retaddr_sentinel,
+                                         opnd_create_reg(reg_tmp), bb, where, NULL, NULL);
+        instrlist_meta_preinsert(bb, where,
+                                 XINST_CREATE_store(drcontext,
+                                                    OPND_CREATE_MEMPTR(DR_REG_XSP, 0),
+                                                    opnd_create_reg(reg_tmp)));
+        instrlist_meta_preinsert(bb, where, skip);
+        if (drreg_unreserve_aflags(drcontext, bb, where) != DRREG_SUCCESS)
+            ASSERT(false, "failed to unreserve aflags");
+    }
+    if (drreg_unreserve_register(drcontext, bb, where, reg_ptr) != DRREG_SUCCESS ||
+        drreg_unreserve_register(drcontext, bb, where, reg_tmp) != DRREG_SUCCESS)
+        ASSERT(false, "failed to unreserve scratch registers");
+}
+
+/* Pops the shadow stack and records the return value, leaving the real return
+ * address in the slot used by dr_redirect_native_target().  All registers and
+ * the flags hold their application values again at the end.
+ */
+static void
+drwrap_inline_insert_return(void *drcontext, instrlist_t *bb, instr_t *where)
+{
+    reg_id_t reg_ret, reg_frame, reg_tmp, reg_ptr;
+    instr_t *slow = INSTR_CREATE_label(drcontext);
+    instr_t *done = INSTR_CREATE_label(drcontext);
+    if (drreg_reserve_register(drcontext, bb, where, &return_allowed_regs, &reg_ret) !=
+            DRREG_SUCCESS ||
+        drreg_get_app_value(drcontext, bb, where, DR_REG_XAX, reg_ret) !=
+            DRREG_SUCCESS ||
+        drreg_reserve_register(drcontext, bb, where, &return_allowed_regs,
+                               &reg_frame) != DRREG_SUCCESS ||
+        drreg_reserve_register(drcontext, bb, where, &return_allowed_regs, &reg_tmp) !=
+            DRREG_SUCCESS ||
+        drreg_reserve_register(drcontext, bb, where, &return_allowed_regs, &reg_ptr) !=
+            DRREG_SUCCESS ||
+        drreg_reserve_aflags(drcontext, bb, where) != DRREG_SUCCESS) {
+        ASSERT(false, "failed to reserve scratch registers");
+        return;
+    }
+    /* In the common case the top frame's entry stack pointer is just below ours. */
+    dr_insert_read_raw_tls(drcontext, bb, where, inline_tls_seg,
+                           inline_tls_offs + INLINE_TLS_TOP, reg_frame);
+    instrlist_meta_preinsert(
+        bb, where,
+        INSTR_CREATE_lea(drcontext, opnd_create_reg(reg_tmp),
+                         OPND_CREATE_MEM_lea(DR_REG_XSP, DR_REG_NULL, 0,
+                                             -(int)sizeof(app_pc))));
+    instrlist_meta_preinsert(
+        bb, where,
+        INSTR_CREATE_cmp(drcontext, opnd_create_reg(reg_tmp),
+                         OPND_CREATE_MEMPTR(reg_frame,
+                                            (int)offsetof(inline_frame_t, xsp) -
+                                                (int)sizeof(inline_frame_t))));
+    instrlist_meta_preinsert(
+        bb, where, INSTR_CREATE_jcc(drcontext, OP_jne, opnd_create_instr(slow)));
+    instrlist_meta_preinsert(
+        bb, where,
+        INSTR_CREATE_lea(drcontext, opnd_create_reg(reg_frame),
+                         OPND_CREATE_MEM_lea(reg_frame, DR_REG_NULL, 0,
+                                             -(int)sizeof(inline_frame_t))));
+    drx_buf_insert_load_buf_ptr(drcontext, inline_buf, bb, where, reg_ptr);
+    instrlist_meta_preinsert(
+        bb, where,
+        XINST_CREATE_load(drcontext, opnd_create_reg(reg_tmp),
+                          OPND_CREATE_MEMPTR(reg_frame, offsetof(inline_frame_t, func))));
+    drx_buf_insert_buf_store(drcontext, inline_buf, bb, where, reg_ptr, DR_REG_NULL,
+                             opnd_create_reg(reg_tmp), OPSZ_PTR,
+                             offsetof(drwrap_inline_record_t, func));
+    drx_buf_insert_buf_store(drcontext, inline_buf, bb, where, reg_ptr, DR_REG_NULL,
+                             OPND_CREATE_INTPTR(1), OPSZ_PTR,
+                             offsetof(drwrap_inline_record_t, is_return));
+    drx_buf_insert_buf_store(drcontext, inline_buf, bb, where, reg_ptr, DR_REG_NULL,
+                             opnd_create_reg(reg_ret), OPSZ_PTR,
+                             offsetof(drwrap_inline_record_t, values));
+    drx_buf_insert_update_buf_ptr(drcontext, inline_buf, bb, where, reg_ptr, DR_REG_NULL,
+                                  sizeof(drwrap_inline_record_t));
+    /* We pop last so that a translation anywhere above finds the frame. */
+    dr_insert_write_raw_tls(drcontext, bb, where, inline_tls_seg,
+                            inline_tls_offs + INLINE_TLS_TOP, reg_frame);
+    instrlist_meta_preinsert(
+        bb, where,
+        XINST_CREATE_load(drcontext, opnd_create_reg(reg_tmp),
+                          OPND_CREATE_MEMPTR(reg_frame,
+                                             offsetof(inline_frame_t, retaddr))));
+    instrlist_meta_preinsert(
+        bb, where,
+        XINST_CREATE_store(
+            drcontext, dr_reg_spill_slot_opnd(drcontext, SPILL_SLOT_REDIRECT_NATIVE_TGT),
+            opnd_create_reg(reg_tmp)));
+    instrlist_meta_preinsert(bb, where,
+                             XINST_CREATE_jump(drcontext, opnd_create_instr(done)));
+    instrlist_meta_preinsert(bb, where, slow);
+    /* The slow path needs no app state beyond its arguments, which keeps drreg's
+     * state the same along both paths.
+     */
+    dr_insert_clean_call_ex(drcontext, bb, where, (void *)drwrap_inline_return_slow, 0,
+                            2, opnd_create_reg(DR_REG_XSP), opnd_create_reg(reg_ret));
+    instrlist_meta_preinsert(bb, where, done);
+    if (drreg_unreserve_aflags(drcontext, bb, where) != DRREG_SUCCESS ||
+        drreg_unreserve_register(drcontext, bb, where, reg_ret) != DRREG_SUCCESS ||
+        drreg_unreserve_register(drcontext, bb, where, reg_frame) != DRREG_SUCCESS ||
+        drreg_unreserve_register(drcontext, bb, where, reg_tmp) != DRREG_SUCCESS ||
+        drreg_unreserve_register(drcontext, bb, where, reg_ptr) != DRREG_SUCCESS)
+        ASSERT(false, "failed to unreserve scratch registers");
+    /* Nothing follows in this block for drreg to restore before, as we leave it
+     * through the redirect below, so we restore everything now.
+     */
+    if (drreg_restore_all(drcontext, bb, where) != DRREG_SUCCESS)
+        ASSERT(false, "failed to restore app values");
+}
+#endif
+
+/***************************************************************************
+ * EVENTS
+ */
+
+static dr_emit_flags_t
+drwrap_inline_event_bb_app2app(void *drcontext, void *tag, instrlist_t *bb,
+                               bool for_trace, bool translating)
+{
+#ifdef X86_64
+    if (dr_fragment_app_pc(tag) == (app_pc)inline_retaddr_sentinel) {
+        /* This is our sentinel.  We want this to be invisible to observation clients,
+         * so we remove our return instruction and replace with just a meta nop.
+         * The insert event will still be called by drmgr.  The nop keeps the
+         * translation for the drx_buf stores and drreg spills inserted there.
+         */
+        instr_t *inst = instrlist_first(bb);
+        ASSERT(instr_get_next(inst) == NULL, "Must just be 1 instr");
+        instrlist_meta_preinsert(
+            bb, inst, INSTR_XL8(XINST_CREATE_nop(drcontext), instr_get_app_pc(inst)));
+        instrlist_remove(bb, inst);
+        instr_destroy(drcontext, inst);
+    }
+#endif
+    return DR_EMIT_DEFAULT;
+}
+
+static dr_emit_flags_t
+drwrap_inline_event_bb_insert(void *drcontext, void *tag, instrlist_t *bb,
+                              instr_t *inst, bool for_trace, bool translating,
+                              void *user_data)
+{
+    dr_emit_flags_t res = DR_EMIT_DEFAULT;
+#ifdef X86_64
+    if (instr_is_app(inst)) {
+        dr_recurlock_lock(inline_lock);
+        inline_entry_t *entry = (inline_entry_t *)hashtable_lookup(
+            &inline_table, (void *)instr_get_app_pc(inst));
+        if (entry != NULL)
+            drwrap_inline_insert_entry(drcontext, bb, inst, entry);
+        dr_recurlock_unlock(inline_lock);
+    }
+    if (dr_fragment_app_pc(tag) == (app_pc)inline_retaddr_sentinel) {
+        drwrap_inline_insert_return(drcontext, bb, inst);
+        /* The return code put the real retaddr into the DR slot that will be
+         * used by dr_redirect_native_target().
+         */
+        app_pc tgt = dr_redirect_native_target(drcontext);
+        reg_id_t scratch = RETURN_POINT_SCRATCH_REG;
+        instrlist_insert_mov_immed_ptrsz(drcontext, (ptr_int_t)tgt,
+                                         opnd_create_reg(scratch), bb, inst, NULL, NULL);
+        instrlist_meta_preinsert(
+            bb, inst, XINST_CREATE_jump_reg(drcontext, opnd_create_reg(scratch)));
+        /* This unusual transition confuses DR trying to stitch blocks together into
+         * a trace.
+         */
+        res = DR_EMIT_MUST_END_TRACE;
+    }
+#endif
+    return res;
+}
+
+static bool
+drwrap_inline_event_restore_state_ex(void *drcontext, bool restore_memory,
+                                     dr_restore_state_info_t *info)
+{
+#ifdef X86_64
+    per_thread_t *pt = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+    if (pt == NULL)
+        return true;
+    inline_frame_t *top = INLINE_TLS_SLOT(pt, INLINE_TLS_TOP);
+    if (info->mcontext->pc == (app_pc)inline_retaddr_sentinel && top > pt->stack + 1) {
+        NOTIFY(1, "%s: updating T" TIDFMT " PC to inline retaddr " PFX "\n", __FUNCTION__,
+               dr_get_thread_id(drcontext), (top - 1)->retaddr);
+        info->mcontext->pc = (top - 1)->retaddr;
+    }
+    /* Only restore the stack on detach: otherwise the sentinels keep working, while
+     * restoring them on every drx_buf guard page fault would lose returns.
+     */
+    if (!restore_memory || !dr_is_detaching())
+        return true;
+    for (inline_frame_t *frame = pt->stack + 1; frame < top; frame++) {
+        app_pc retaddr;
+        if (info->mcontext->xsp <= frame->xsp &&
+            dr_safe_read((void *)frame->xsp, sizeof(retaddr), &retaddr, NULL) &&
+            retaddr == (app_pc)inline_retaddr_sentinel) {
+            NOTIFY(1,
+                   "%s: updating T" TIDFMT " retaddr @ " PFX
+                   " from inline sentinel to real retaddr " PFX "\n",
+                   __FUNCTION__, dr_get_thread_id(drcontext), frame->xsp,
+                   frame->retaddr);
+            dr_safe_write((void *)frame->xsp, sizeof(frame->retaddr), &frame->retaddr,
+                          NULL);
+        }
+    }
+#endif
+    return true;
+}
+
+static void
+drwrap_inline_thread_init(void *drcontext)
+{
+    per_thread_t *pt = (per_thread_t *)dr_thread_alloc(drcontext, sizeof(*pt));
+    pt->stack = (inline_frame_t *)dr_thread_alloc(drcontext, INLINE_STACK_SIZE);
+    memset(pt->stack, 0, sizeof(*pt->stack));
+    pt->seg_base = dr_get_dr_segment_base(inline_tls_seg);
+    INLINE_TLS_SLOT(pt, INLINE_TLS_TOP) = pt->stack + 1;
+    INLINE_TLS_SLOT(pt, INLINE_TLS_LIMIT) = pt->stack + 1 + INLINE_STACK_DEPTH;
+    drmgr_set_tls_field(drcontext, tls_idx, (void *)pt);
+}
+
+static void
+drwrap_inline_thread_exit(void *drcontext)
+{
+    per_thread_t *pt = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+    ASSERT(pt != NULL, "missing per-thread data");
+    drmgr_set_tls_field(drcontext, tls_idx, NULL);
+    dr_thread_free(drcontext, pt->stack, INLINE_STACK_SIZE);
+    dr_thread_free(drcontext, pt, sizeof(*pt));
+}
+
+/***************************************************************************
+ * INIT
+ */
+
+DR_EXPORT
+bool
+drwrap_inline_init(void)
+{
+    drmgr_priority_t pri_app2app = { sizeof(pri_app2app),
+                                     DRMGR_PRIORITY_NAME_DRWRAP_INLINE, NULL, NULL,
+                                     DRMGR_PRIORITY_APP2APP_DRWRAP_INLINE };
+    drmgr_priority_t pri_insert = { sizeof(pri_insert), DRMGR_PRIORITY_NAME_DRWRAP_INLINE,
+                                    NULL, NULL, DRMGR_PRIORITY_INSERT_DRWRAP_INLINE };
+    drreg_options_t ops = { sizeof(ops), 5 /*max slots needed*/, false };
+
+    /* handle multiple sets of init/exit calls */
+    int count = dr_atomic_add32_return_sum(&drwrap_inline_init_count, 1);
+    if (count > 1)
+        return true;
+
+    drmgr_init();
+    if (drreg_init(&ops) != DRREG_SUCCESS || !drx_init())
+        return false;
+    if (!dr_raw_tls_calloc(&inline_tls_seg, &inline_tls_offs, 2, 0))
+        return false;
+    inline_buf = drx_buf_create_trace_buffer(INLINE_BUFFER_SIZE, drwrap_inline_buf_full);
+    if (inline_buf == NULL)
+        return false;
+    hashtable_init_ex(&inline_table, INLINE_TABLE_HASH_BITS, HASH_INTPTR,
+                      false /*!str_dup*/, false /*!synch*/, inline_entry_free, NULL,
+                      NULL);
+    inline_lock = dr_recurlock_create();
+
+    drreg_init_and_fill_vector(&entry_allowed_regs, true);
+    drreg_init_and_fill_vector(&return_allowed_regs, false);
+#ifdef X86_64
+    /* The entry instrumentation stores the argument registers directly. */
+    for (uint i = 0; i < DRWRAP_INLINE_MAX_ARGS; i++) {
+        opnd_t arg = drwrap_inline_arg_opnd(i);
+        if (opnd_is_reg(arg))
+            drreg_set_vector_entry(&entry_allowed_regs, opnd_get_reg(arg), false);
+    }
+    for (reg_id_t reg = DR_REG_START_GPR; reg <= DR_REG_STOP_GPR; reg++) {
+        if (reg != DR_REG_XAX && reg != DR_REG_XDX && reg != RETURN_POINT_SCRATCH_REG &&
+            reg != DR_REG_XSP)
+            drreg_set_vector_entry(&return_allowed_regs, reg, true);
+    }
+#endif
+
+    tls_idx = drmgr_register_tls_field();
+    if (tls_idx == -1)
+        return false;
+    if (!drmgr_register_thread_init_event(drwrap_inline_thread_init) ||
+        !drmgr_register_thread_exit_event(drwrap_inline_thread_exit) ||
+        !drmgr_register_bb_app2app_event(drwrap_inline_event_bb_app2app,
+                                         &pri_app2app) ||
+        !drmgr_register_bb_instrumentation_event(NULL, drwrap_inline_event_bb_insert,
+                                                 &pri_insert) ||
+        !drmgr_register_restore_state_ex_event(drwrap_inline_event_restore_state_ex))
+        return false;
+    return true;
+}
+
+DR_EXPORT
+void
+drwrap_inline_exit(void)
+{
+    /* handle multiple sets of init/exit calls */
+    int count = dr_atomic_add32_return_sum(&drwrap_inline_init_count, -1);
+    if (count != 0)
+        return;
+
+    if (!drmgr_unregister_thread_init_event(drwrap_inline_thread_init) ||
+        !drmgr_unregister_thread_exit_event(drwrap_inline_thread_exit) ||
+        !drmgr_unregister_bb_app2app_event(drwrap_inline_event_bb_app2app) ||
+        !drmgr_unregister_bb_insertion_event(drwrap_inline_event_bb_insert) ||
+        !drmgr_unregister_restore_state_ex_event(drwrap_inline_event_restore_state_ex) ||
+        !drmgr_unregister_tls_field(tls_idx))
+        ASSERT(false, "failed to unregister in drwrap_inline_exit");
+
+    drvector_delete(&entry_allowed_regs);
+    drvector_delete(&return_allowed_regs);
+    dr_recurlock_destroy(inline_lock);
+    hashtable_delete(&inline_table);
+    if (!drx_buf_free(inline_buf) || !dr_raw_tls_cfree(inline_tls_offs, 2))
+        ASSERT(false, "failed to free inline wrapping state");
+    inline_buf = NULL;
+    drx_exit();
+    if (drreg_exit() != DRREG_SUCCESS)
+        ASSERT(false, "failed to exit drreg");
+    drmgr_exit();
+}
+
+/***************************************************************************
+ * WRAPPING
+ */
+
+DR_EXPORT
+bool
+drwrap_wrap_inline(app_pc func, uint num_args, bool capture_retval,
+                   drwrap_inline_batch_cb_t batch_cb, void *user_data)
+{
+#ifdef X86_64
+    inline_entry_t *entry;
+    if (func == NULL || batch_cb == NULL || num_args > DRWRAP_INLINE_MAX_ARGS ||
+        inline_buf == NULL)
+        return false;
+    dr_recurlock_lock(inline_lock);
+    if (hashtable_lookup(&inline_table, (void *)func) != NULL) {
+        dr_recurlock_unlock(inline_lock);
+        return false;
+    }
+    entry = dr_global_alloc(sizeof(*entry));
+    entry->func = func;
+    entry->num_args = num_args;
+    entry->capture_retval = capture_retval;
+    entry->batch_cb = batch_cb;
+    entry->user_data = user_data;
+    hashtable_add(&inline_table, (void *)func, (void *)entry);
+    /* XXX: we're assuming void* tag == pc */
+    if (dr_fragment_exists_at(dr_get_current_drcontext(), func)) {
+        /* we do not guarantee faster than a lazy flush */
+        if (!dr_unlink_flush_region(func, 1))
+            ASSERT(false, "wrap update flush failed");
+    }
+    dr_recurlock_unlock(inline_lock);
+    return true;
+#else
+    /* XXX: The inline instrumentation is only implemented for x86_64 so far. */
+    return false;
+#endif
+}
+
+DR_EXPORT
+void
+drwrap_inline_get_retaddr_if_sentinel(void *drcontext, INOUT app_pc *possibly_sentinel)
+{
+    ASSERT(possibly_sentinel != NULL, "Input cannot be null.");
+#ifdef X86_64
+    if ((app_pc)inline_retaddr_sentinel != *possibly_sentinel)
+        return;
+    per_thread_t *pt = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+    ASSERT(pt != NULL, "Invalid drwrap_inline state.");
+    inline_frame_t *top = INLINE_TLS_SLOT(pt, INLINE_TLS_TOP);
+    ASSERT(top > pt->stack + 1, "Invalid drwrap_inline state.");
+    *possibly_sentinel = (top - 1)->retaddr;
+#endif
+}
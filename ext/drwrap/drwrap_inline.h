@@ -0,0 +1,180 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.   All rights reserved.
+ * **********************************************************/
+
+/* drwrap: DynamoRIO Function Wrapping and Replacing Extension
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Clean-call-free function wrapping for the drwrap Extension. */
+
+#ifndef _DRWRAP_INLINE_H_
+#define _DRWRAP_INLINE_H_ 1
+
+/**
+ * @file drwrap_inline.h
+ * @brief Header for the clean-call-free wrapping component of the DynamoRIO Function
+ * Wrapping and Replacing Extension
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "drext.h"
+
+/**
+ * \addtogroup drwrap Function Wrapping and Replacing
+ */
+/**@{*/ /* begin doxygen group */
+
+/***************************************************************************
+ * INLINE WRAPPING
+ */
+
+/**
+ * Priorities of drmgr instrumentation passes used by drwrap_inline.  Users
+ * of drwrap_inline can use the name DRMGR_PRIORITY_NAME_DRWRAP_INLINE in the
+ * drmgr_priority_t.before field or can use these numeric priorities
+ * in the drmgr_priority_t.priority field to ensure proper
+ * instrumentation pass ordering.
+ */
+enum {
+    /** Priority of the return sentinel rewriting. */
+    DRMGR_PRIORITY_APP2APP_DRWRAP_INLINE = -500,
+    /** Priority of drwrap_wrap_inline(). */
+    DRMGR_PRIORITY_INSERT_DRWRAP_INLINE = 500,
+};
+
+/** Name of drmgr instrumentation pass priorities for app2app and insert. */
+#define DRMGR_PRIORITY_NAME_DRWRAP_INLINE "drwrap_inline"
+
+/** The maximum number of arguments that drwrap_wrap_inline() can record. */
+#define DRWRAP_INLINE_MAX_ARGS 6
+
+/**
+ * A record written by the instrumentation inserted for drwrap_wrap_inline().
+ * One record is written on each entry to a wrapped function and, if requested,
+ * one on each return from it.
+ */
+typedef struct _drwrap_inline_record_t {
+    /** The wrapped function, as passed to drwrap_wrap_inline(). */
+    app_pc func;
+    /** Zero for a function entry record; non-zero for a function return record. */
+    ptr_uint_t is_return;
+    /**
+     * For an entry record, the first \p num_args arguments (as passed to
+     * drwrap_wrap_inline()) to the function.  For a return record, values[0]
+     * holds the return value.  The remaining entries are undefined.
+     */
+    ptr_uint_t values[DRWRAP_INLINE_MAX_ARGS];
+} drwrap_inline_record_t;
+
+/**
+ * The type of the callback passed to drwrap_wrap_inline(), which receives
+ * \p count consecutive records written by the thread \p drcontext.
+ */
+typedef void (*drwrap_inline_batch_cb_t)(void *drcontext,
+                                         drwrap_inline_record_t *records, size_t count,
+                                         void *user_data);
+
+DR_EXPORT
+/**
+ * Initializes the drwrap_inline component, which lives in its own library
+ * separate from the rest of drwrap and which initializes the drreg and drx
+ * extensions and allocates the per-thread buffer and shadow stack needed by
+ * drwrap_wrap_inline().  Must be called prior to any of the other routines
+ * in this header.  Can be called multiple times (by separate components,
+ * normally) but each call must be paired with a corresponding call to
+ * drwrap_inline_exit().
+ *
+ * \return whether successful.
+ */
+bool
+drwrap_inline_init(void);
+
+DR_EXPORT
+/**
+ * Cleans up the drwrap_inline component.
+ */
+void
+drwrap_inline_exit(void);
+
+DR_EXPORT
+/**
+ * Wraps the function \p func without any clean calls.  Instead of invoking
+ * callbacks on every call, inline instrumentation stores a
+ * #drwrap_inline_record_t holding the first \p num_args arguments into a
+ * per-thread drx_buf trace buffer on every entry to \p func.  If \p
+ * capture_retval is true, a second record holding the return value is
+ * stored when \p func returns.  \p batch_cb is called with \p user_data
+ * and the buffered records when the buffer fills up and when the thread
+ * exits.  Records are passed in the order they were written; consecutive
+ * records for all inline wraps sharing the same \p batch_cb and \p
+ * user_data are passed in a single call.
+ *
+ * This is intended for lightweight observation of frequently-called
+ * functions: the arguments and return value cannot be modified and the call
+ * cannot be skipped.  The arguments are located using
+ * #DRWRAP_CALLCONV_DEFAULT, and \p num_args cannot exceed
+ * #DRWRAP_INLINE_MAX_ARGS.
+ *
+ * Returns are detected by replacing the return address on the stack upon
+ * entry, in the same manner as and with the same transparency caveats as
+ * #DRWRAP_REPLACE_RETADDR.  drwrap_inline_get_retaddr_if_sentinel() maps
+ * the sentinel used here back to the real return address.  Returns from
+ * calls nested more than 512 deep within inline-wrapped functions are not
+ * recorded.  Frames abandoned by a longjmp or an exception are discarded
+ * without a return record when an enclosing wrapped function returns.
+ *
+ * The instrumentation at function entry and at the return sentinel obtains
+ * its scratch registers and the arithmetic flags from drreg, which preserves
+ * their application values.  As for the #DRWRAP_REPLACE_RETADDR sentinel,
+ * the transfer back to the real return address clobbers the caller-saved
+ * register xcx, which the calling convention does not use for return values.
+ *
+ * A function cannot be wrapped twice with this routine, and should not also
+ * be wrapped with drwrap_wrap().  An inline wrap cannot be removed.
+ * Currently this is only supported on x86_64.
+ *
+ * This routine may call dr_unlink_flush_region(), which means that it
+ * cannot be called while any locks are held that could block a thread
+ * processing a registered event callback or cache callout.
+ *
+ * \return whether successful.
+ */
+bool
+drwrap_wrap_inline(app_pc func, uint num_args, bool capture_retval,
+                   drwrap_inline_batch_cb_t batch_cb, void *user_data);
+
+DR_EXPORT
+/**
+ * If the provided app_pc (\p possibly_sentinel) is the return address sentinel
+ * used to implement drwrap_wrap_inline(), this routine replaces it with the actual
+ * return address of the inner-most inline-wrapped function.  Otherwise, it is a
+ * no-op.  This is the drwrap_wrap_inline() counterpart of
+ * drwrap_get_retaddr_if_sentinel().
+ */
+void
+drwrap_inline_get_retaddr_if_sentinel(void *drcontext, INOUT app_pc *possibly_sentinel);
+
+/**@}*/ /* end doxygen group */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DRWRAP_INLINE_H_ */
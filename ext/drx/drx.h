@@ -354,6 +354,60 @@ struct _drx_buf_t;
 /** Opaque handle which represents a buffer for use by the drx_buf framework. */
 typedef struct _drx_buf_t drx_buf_t;
 
+/**
+ * Callback for drx_buf_create_async_trace_buffer(), called on the application
+ * thread when one of its buffers has been filled or when the thread exits. The
+ * valid buffer data is contained within the interval [buf_base..buf_base+size).
+ * The thread has already moved on to another buffer by the time it writes again,
+ * so the callback should only queue \p buf_base for a consumer thread, which
+ * hands it back with drx_buf_release_buffer() once it is done with the contents.
+ */
+typedef void (*drx_buf_submit_cb_t)(void *drcontext, drx_buf_t *buf, void *buf_base,
+                                    size_t size);
+
+/**
+ * What an asynchronous trace buffer does when a buffer fills while all of the
+ * thread's other buffers are still held by the consumer.
+ */
+typedef enum {
+    /**
+     * Pass the full buffer to the full callback on the application thread, as a
+     * drx_buf_create_trace_buffer() buffer would, and then reuse it.  The thread is
+     * held up for the duration of the callback but never waits for the consumer,
+     * which is not safe in the fault handler where buffers are swapped.  Processed
+     * buffers are counted in #drx_buf_async_stats_t.
+     */
+    DRX_BUF_ASYNC_SYNC,
+    /**
+     * Discard the full buffer's contents and reuse it. Discarded data is counted in
+     * #drx_buf_async_stats_t.
+     */
+    DRX_BUF_ASYNC_DROP,
+    /** Allocate an additional buffer for the thread. */
+    DRX_BUF_ASYNC_GROW,
+} drx_buf_async_policy_t;
+
+/** Statistics for an asynchronous trace buffer, summed over all threads. */
+typedef struct _drx_buf_async_stats_t {
+    /**
+     * The size of this structure, which must be set by the caller to
+     * sizeof(drx_buf_async_stats_t).
+     */
+    size_t size;
+    /** Buffers passed to the submit callback. */
+    uint64 buffers_submitted;
+    /** Bytes of trace data in the submitted buffers. */
+    uint64 bytes_submitted;
+    /** Full buffers discarded under #DRX_BUF_ASYNC_DROP. */
+    uint64 buffers_dropped;
+    /** Bytes of trace data in the discarded buffers. */
+    uint64 bytes_dropped;
+    /** Buffers added under #DRX_BUF_ASYNC_GROW. */
+    uint64 buffers_grown;
+    /** Full buffers passed to the full callback under #DRX_BUF_ASYNC_SYNC. */
+    uint64 buffers_processed_sync;
+} drx_buf_async_stats_t;
+
 enum {
     /**
      * Buffer size to be specified in drx_buf_create_circular_buffer() in order
@@ -407,6 +461,49 @@ DR_EXPORT
 drx_buf_t *
 drx_buf_create_trace_buffer(size_t buffer_size, drx_buf_full_cb_t full_cb);
 
+DR_EXPORT
+/**
+ * Initializes the drx_buf extension with an asynchronous trace buffer: each
+ * thread owns \p num_buffers buffers of \p buffer_size bytes. When the one being
+ * written fills, it is passed to \p submit_cb and the thread continues in a free
+ * one, so the client's output work can run on its own threads (see
+ * dr_create_client_thread()) rather than stalling the application. \p policy
+ * selects what happens when no buffer is free; \p full_cb is only used, and is
+ * required, for #DRX_BUF_ASYNC_SYNC. Each submitted buffer must be returned with
+ * drx_buf_release_buffer(), which frees a thread's buffers once it has exited and
+ * all of them are back.
+ *
+ * \note Client threads are terminated before the final thread exit events at
+ * process exit, so the client should process any buffers still queued for them in
+ * its exit event.
+ *
+ * \note \p num_buffers must be at least 2.
+ *
+ * \return NULL if unsuccessful, a valid opaque struct pointer if successful.
+ */
+drx_buf_t *
+drx_buf_create_async_trace_buffer(size_t buffer_size, uint num_buffers,
+                                  drx_buf_async_policy_t policy,
+                                  drx_buf_submit_cb_t submit_cb,
+                                  drx_buf_full_cb_t full_cb);
+
+DR_EXPORT
+/**
+ * Returns a buffer which was passed to the submit callback of the asynchronous
+ * trace buffer \p buf to its thread for reuse. May be called from any thread.
+ * \returns whether successful.
+ */
+bool
+drx_buf_release_buffer(drx_buf_t *buf, void *buf_base);
+
+DR_EXPORT
+/**
+ * Retrieves the statistics of the asynchronous trace buffer \p buf. The caller
+ * must set the \p size field of \p stats. \returns whether successful.
+ */
+bool
+drx_buf_get_async_stats(drx_buf_t *buf, drx_buf_async_stats_t *stats);
+
 DR_EXPORT
 /** Cleans up the buffer associated with \p buf. \returns whether successful. */
 bool
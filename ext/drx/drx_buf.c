@@ -50,13 +50,43 @@
 #define MINSERT instrlist_meta_preinsert
 
 /* denotes the possible buffer types */
-typedef enum { DRX_BUF_CIRCULAR_FAST, DRX_BUF_CIRCULAR, DRX_BUF_TRACE } drx_buf_type_t;
+typedef enum {
+    DRX_BUF_CIRCULAR_FAST,
+    DRX_BUF_CIRCULAR,
+    DRX_BUF_TRACE,
+    DRX_BUF_ASYNC_TRACE,
+} drx_buf_type_t;
+
+struct _async_pool_t;
+
+/* One of the buffers of an asynchronous trace buffer. The header lives on its
+ * own page right before the buffer so that drx_buf_release_buffer() can find
+ * the owning pool from nothing but the buffer base, from any thread.
+ */
+typedef struct _async_slot_t {
+    struct _async_pool_t *pool;
+    struct _async_slot_t *next; /* free list link */
+    byte *cli_base;
+    size_t total_size; /* the size of the allocation starting at this header */
+} async_slot_t;
+
+/* The per-thread set of buffers of an asynchronous trace buffer. */
+typedef struct _async_pool_t {
+    void *lock;
+    async_slot_t *current;
+    async_slot_t *free_list;
+    /* Buffers handed to submit_cb and not yet released. */
+    uint outstanding;
+    /* Once the owning thread has exited, the last release frees the pool. */
+    bool exited;
+} async_pool_t;
 
 typedef struct {
     byte *seg_base;
-    byte *cli_base;    /* the base of the buffer from the client's perspective */
-    byte *buf_base;    /* the actual base of the buffer */
-    size_t total_size; /* the actual size of the buffer */
+    byte *cli_base;     /* the base of the buffer from the client's perspective */
+    byte *buf_base;     /* the actual base of the buffer */
+    size_t total_size;  /* the actual size of the buffer */
+    async_pool_t *pool; /* only for DRX_BUF_ASYNC_TRACE */
 } per_thread_t;
 
 struct _drx_buf_t {
@@ -68,6 +98,12 @@ struct _drx_buf_t {
     int tls_idx;
     uint tls_offs;
     reg_id_t tls_seg;
+    /* asynchronous trace buffers only */
+    uint num_buffers;
+    drx_buf_async_policy_t policy;
+    drx_buf_submit_cb_t submit_cb;
+    void *stats_lock;
+    drx_buf_async_stats_t stats;
 };
 
 /* global rwlock to lock against updates to the clients vector */
@@ -90,6 +126,12 @@ static per_thread_t *
 per_thread_init_2byte(void *drcontext, drx_buf_t *buf);
 static per_thread_t *
 per_thread_init_fault(void *drcontext, drx_buf_t *buf);
+static per_thread_t *
+per_thread_init_async(void *drcontext, drx_buf_t *buf);
+static void
+per_thread_exit_async(void *drcontext, drx_buf_t *buf, per_thread_t *data);
+static byte *
+async_swap_buffer(void *drcontext, drx_buf_t *buf, per_thread_t *data, size_t size);
 
 static void
 drx_buf_insert_update_buf_ptr_2byte(void *drcontext, drx_buf_t *buf, instrlist_t *ilist,
@@ -192,6 +234,27 @@ drx_buf_create_trace_buffer(size_t buf_size, drx_buf_full_cb_t full_cb)
     return drx_buf_init(DRX_BUF_TRACE, buf_size, full_cb);
 }
 
+DR_EXPORT
+drx_buf_t *
+drx_buf_create_async_trace_buffer(size_t buf_size, uint num_buffers,
+                                  drx_buf_async_policy_t policy,
+                                  drx_buf_submit_cb_t submit_cb,
+                                  drx_buf_full_cb_t full_cb)
+{
+    drx_buf_t *buf;
+    if (submit_cb == NULL || num_buffers < 2 || policy < DRX_BUF_ASYNC_SYNC ||
+        policy > DRX_BUF_ASYNC_GROW || (policy == DRX_BUF_ASYNC_SYNC && full_cb == NULL))
+        return NULL;
+    buf = drx_buf_init(DRX_BUF_ASYNC_TRACE, buf_size, full_cb);
+    if (buf == NULL)
+        return NULL;
+    buf->num_buffers = num_buffers;
+    buf->policy = policy;
+    buf->submit_cb = submit_cb;
+    buf->stats_lock = dr_mutex_create();
+    return buf;
+}
+
 static drx_buf_t *
 drx_buf_init(drx_buf_type_t bt, size_t bsz, drx_buf_full_cb_t full_cb)
 {
@@ -216,6 +279,11 @@ drx_buf_init(drx_buf_type_t bt, size_t bsz, drx_buf_full_cb_t full_cb)
     new_client->tls_seg = tls_seg;
     new_client->tls_idx = tls_idx;
     new_client->full_cb = full_cb;
+    new_client->num_buffers = 1;
+    new_client->policy = DRX_BUF_ASYNC_SYNC;
+    new_client->submit_cb = NULL;
+    new_client->stats_lock = NULL;
+    memset(&new_client->stats, 0, sizeof(new_client->stats));
     dr_rwlock_write_lock(global_buf_rwlock);
     /* We don't attempt to re-use NULL entries (presumably which
      * have already been freed), for simplicity.
@@ -248,6 +316,8 @@ drx_buf_free(drx_buf_t *buf)
 
     if (!drmgr_unregister_tls_field(buf->tls_idx) || !dr_raw_tls_cfree(buf->tls_offs, 1))
         return false;
+    if (buf->stats_lock != NULL)
+        dr_mutex_destroy(buf->stats_lock);
     dr_global_free(buf, sizeof(*buf));
 
     return true;
@@ -295,6 +365,8 @@ event_thread_init(void *drcontext)
         if (buf != NULL) {
             if (buf->buf_type == DRX_BUF_CIRCULAR_FAST)
                 data = per_thread_init_2byte(drcontext, buf);
+            else if (buf->buf_type == DRX_BUF_ASYNC_TRACE)
+                data = per_thread_init_async(drcontext, buf);
             else
                 data = per_thread_init_fault(drcontext, buf);
             drmgr_set_tls_field(drcontext, buf->tls_idx, data);
@@ -314,6 +386,10 @@ event_thread_exit(void *drcontext)
         if (buf != NULL) {
             per_thread_t *data = drmgr_get_tls_field(drcontext, buf->tls_idx);
             byte *cli_ptr = BUF_PTR(data->seg_base, buf->tls_offs);
+            if (buf->buf_type == DRX_BUF_ASYNC_TRACE) {
+                per_thread_exit_async(drcontext, buf, data);
+                continue;
+            }
             /* buffer has not yet been deleted, call user callback(s) */
             if (buf->full_cb != NULL) {
                 (*buf->full_cb)(drcontext, data->cli_base,
@@ -343,6 +419,7 @@ per_thread_init_2byte(void *drcontext, drx_buf_t *buf)
                            NULL);
     per_thread->buf_base = ret;
     per_thread->cli_base = (void *)ALIGN_FORWARD(ret, buf->buf_size);
+    per_thread->pool = NULL;
     return per_thread;
 }
 
@@ -370,9 +447,209 @@ per_thread_init_fault(void *drcontext, drx_buf_t *buf)
     DR_ASSERT(ok);
     per_thread->buf_base = ret;
     per_thread->cli_base = ret + ALIGN_FORWARD(buf->buf_size, page_size) - buf->buf_size;
+    per_thread->pool = NULL;
+    return per_thread;
+}
+
+static async_slot_t *
+async_slot_create(drx_buf_t *buf, async_pool_t *pool)
+{
+    size_t page_size = dr_page_size();
+    /* A header page followed by the same layout as per_thread_init_fault(): the
+     * buffer ends right at a read-only page.
+     */
+    size_t total_size = page_size + ALIGN_FORWARD(buf->buf_size, page_size) + page_size;
+    byte *ret = dr_raw_mem_alloc(total_size, DR_MEMPROT_READ | DR_MEMPROT_WRITE, NULL);
+    async_slot_t *slot = (async_slot_t *)ret;
+    bool ok;
+    DR_ASSERT(ret != NULL);
+    ok = dr_memory_protect(ret + total_size - page_size, page_size, DR_MEMPROT_READ);
+    DR_ASSERT(ok);
+    slot->pool = pool;
+    slot->next = NULL;
+    slot->cli_base = ret + total_size - page_size - buf->buf_size;
+    slot->total_size = total_size;
+    return slot;
+}
+
+static async_slot_t *
+async_slot_from_base(drx_buf_t *buf, byte *cli_base)
+{
+    size_t page_size = dr_page_size();
+    return (async_slot_t *)(cli_base + buf->buf_size -
+                            ALIGN_FORWARD(buf->buf_size, page_size) - page_size);
+}
+
+static void
+async_set_current(per_thread_t *data, async_slot_t *slot)
+{
+    data->pool->current = slot;
+    data->buf_base = (byte *)slot;
+    data->total_size = slot->total_size;
+    data->cli_base = slot->cli_base;
+}
+
+static per_thread_t *
+per_thread_init_async(void *drcontext, drx_buf_t *buf)
+{
+    per_thread_t *per_thread = dr_thread_alloc(drcontext, sizeof(per_thread_t));
+    /* Buffers are released from the client's consumer threads, so the pool is in
+     * global memory.
+     */
+    async_pool_t *pool = dr_global_alloc(sizeof(*pool));
+    uint i;
+    per_thread->seg_base = dr_get_dr_segment_base(buf->tls_seg);
+    pool->lock = dr_mutex_create();
+    pool->free_list = NULL;
+    pool->outstanding = 0;
+    pool->exited = false;
+    for (i = 1; i < buf->num_buffers; ++i) {
+        async_slot_t *slot = async_slot_create(buf, pool);
+        slot->next = pool->free_list;
+        pool->free_list = slot;
+    }
+    per_thread->pool = pool;
+    async_set_current(per_thread, async_slot_create(buf, pool));
     return per_thread;
 }
 
+static void
+async_pool_free(async_pool_t *pool)
+{
+    while (pool->free_list != NULL) {
+        async_slot_t *slot = pool->free_list;
+        pool->free_list = slot->next;
+        dr_raw_mem_free(slot, slot->total_size);
+    }
+    dr_mutex_destroy(pool->lock);
+    dr_global_free(pool, sizeof(*pool));
+}
+
+/* Hands the current buffer, holding \p size bytes, to submit_cb and makes a free
+ * buffer current, applying the backpressure policy if there is none.  Returns the
+ * new buffer base, which is the old one if the contents were dropped or processed
+ * synchronously.
+ *
+ * This runs in the fault handler, holding global_buf_rwlock, so it must never wait
+ * for the consumer: a consumer that needs that lock, or that is suspended by DR
+ * while we are in the handler, would never release a buffer.
+ */
+static byte *
+async_swap_buffer(void *drcontext, drx_buf_t *buf, per_thread_t *data, size_t size)
+{
+    async_pool_t *pool = data->pool;
+    async_slot_t *full = pool->current;
+    async_slot_t *next;
+    bool grown = false;
+
+    dr_mutex_lock(pool->lock);
+    next = pool->free_list;
+    if (next != NULL)
+        pool->free_list = next->next;
+    /* The consumer may release the full buffer as soon as we submit it. */
+    if (next != NULL || buf->policy == DRX_BUF_ASYNC_GROW)
+        pool->outstanding++;
+    dr_mutex_unlock(pool->lock);
+
+    if (next == NULL && buf->policy != DRX_BUF_ASYNC_GROW) {
+        /* Keep using the full buffer, after processing or dropping its contents. */
+        if (buf->policy == DRX_BUF_ASYNC_SYNC)
+            (*buf->full_cb)(drcontext, full->cli_base, size);
+        dr_mutex_lock(buf->stats_lock);
+        if (buf->policy == DRX_BUF_ASYNC_SYNC) {
+            buf->stats.buffers_processed_sync++;
+        } else {
+            buf->stats.buffers_dropped++;
+            buf->stats.bytes_dropped += size;
+        }
+        dr_mutex_unlock(buf->stats_lock);
+        return full->cli_base;
+    }
+
+    (*buf->submit_cb)(drcontext, buf, full->cli_base, size);
+    if (next == NULL) {
+        next = async_slot_create(buf, pool);
+        grown = true;
+    }
+    async_set_current(data, next);
+
+    dr_mutex_lock(buf->stats_lock);
+    buf->stats.buffers_submitted++;
+    buf->stats.bytes_submitted += size;
+    if (grown)
+        buf->stats.buffers_grown++;
+    dr_mutex_unlock(buf->stats_lock);
+    return next->cli_base;
+}
+
+static void
+per_thread_exit_async(void *drcontext, drx_buf_t *buf, per_thread_t *data)
+{
+    async_pool_t *pool = data->pool;
+    async_slot_t *slot = pool->current;
+    byte *cli_ptr = BUF_PTR(data->seg_base, buf->tls_offs);
+    size_t size = (size_t)(cli_ptr - slot->cli_base);
+    bool free_pool;
+
+    dr_mutex_lock(pool->lock);
+    pool->outstanding++;
+    dr_mutex_unlock(pool->lock);
+    (*buf->submit_cb)(drcontext, buf, slot->cli_base, size);
+    dr_mutex_lock(buf->stats_lock);
+    buf->stats.buffers_submitted++;
+    buf->stats.bytes_submitted += size;
+    dr_mutex_unlock(buf->stats_lock);
+
+    /* We do not wait for the consumer here: at process exit its threads are gone
+     * by the time the final thread exit event runs.
+     */
+    dr_mutex_lock(pool->lock);
+    pool->exited = true;
+    free_pool = pool->outstanding == 0;
+    dr_mutex_unlock(pool->lock);
+    if (free_pool)
+        async_pool_free(pool);
+    dr_thread_free(drcontext, data, sizeof(per_thread_t));
+}
+
+DR_EXPORT
+bool
+drx_buf_release_buffer(drx_buf_t *buf, void *buf_base)
+{
+    async_slot_t *slot;
+    async_pool_t *pool;
+    bool free_pool;
+    if (buf == NULL || buf->buf_type != DRX_BUF_ASYNC_TRACE || buf_base == NULL)
+        return false;
+    slot = async_slot_from_base(buf, (byte *)buf_base);
+    if (slot->cli_base != (byte *)buf_base)
+        return false;
+    pool = slot->pool;
+    dr_mutex_lock(pool->lock);
+    slot->next = pool->free_list;
+    pool->free_list = slot;
+    pool->outstanding--;
+    free_pool = pool->exited && pool->outstanding == 0;
+    dr_mutex_unlock(pool->lock);
+    if (free_pool)
+        async_pool_free(pool);
+    return true;
+}
+
+DR_EXPORT
+bool
+drx_buf_get_async_stats(drx_buf_t *buf, drx_buf_async_stats_t *stats)
+{
+    if (buf == NULL || buf->buf_type != DRX_BUF_ASYNC_TRACE || stats == NULL ||
+        stats->size != sizeof(*stats))
+        return false;
+    dr_mutex_lock(buf->stats_lock);
+    *stats = buf->stats;
+    dr_mutex_unlock(buf->stats_lock);
+    stats->size = sizeof(*stats);
+    return true;
+}
+
 DR_EXPORT
 void
 drx_buf_insert_load_buf_ptr(void *drcontext, drx_buf_t *buf, instrlist_t *ilist,
@@ -697,9 +974,15 @@ safe_memcpy(drx_buf_t *buf, void *src, size_t len)
     if (!dr_safe_write(cli_ptr, len, src, NULL)) {
         /* we overflowed the client buffer, so flush it and try again */
         byte *cli_base = data->cli_base;
-        BUF_PTR(data->seg_base, buf->tls_offs) = cli_base;
-        if (buf->full_cb != NULL)
-            (*buf->full_cb)(drcontext, cli_base, (size_t)(cli_ptr - cli_base));
+        if (buf->buf_type == DRX_BUF_ASYNC_TRACE) {
+            cli_base =
+                async_swap_buffer(drcontext, buf, data, (size_t)(cli_ptr - cli_base));
+            BUF_PTR(data->seg_base, buf->tls_offs) = cli_base;
+        } else {
+            BUF_PTR(data->seg_base, buf->tls_offs) = cli_base;
+            if (buf->full_cb != NULL)
+                (*buf->full_cb)(drcontext, cli_base, (size_t)(cli_ptr - cli_base));
+        }
         memcpy(cli_base, src, len);
     }
 }
@@ -811,9 +1094,16 @@ reset_buf_ptr(void *drcontext, dr_mcontext_t *raw_mcontext, byte *seg_base,
      * for the user to override it in the callback.
      */
     tmp_base = BUF_PTR(seg_base, buf->tls_offs);
-    BUF_PTR(seg_base, buf->tls_offs) = cli_base;
-    if (buf->full_cb != NULL)
-        (*buf->full_cb)(drcontext, cli_base, (size_t)(tmp_base - cli_base));
+    if (buf->buf_type == DRX_BUF_ASYNC_TRACE) {
+        /* Rather than waiting on the client, we move on to another buffer. */
+        per_thread_t *data = drmgr_get_tls_field(drcontext, buf->tls_idx);
+        BUF_PTR(seg_base, buf->tls_offs) =
+            async_swap_buffer(drcontext, buf, data, (size_t)(tmp_base - cli_base));
+    } else {
+        BUF_PTR(seg_base, buf->tls_offs) = cli_base;
+        if (buf->full_cb != NULL)
+            (*buf->full_cb)(drcontext, cli_base, (size_t)(tmp_base - cli_base));
+    }
 
     /* change contents of buf_ptr and retry the instruction */
     reg_set_value(buf_ptr, raw_mcontext, (reg_t)BUF_PTR(seg_base, buf->tls_offs));
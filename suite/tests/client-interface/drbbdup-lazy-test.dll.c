@@ -0,0 +1,132 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Tests hot case dispatch and lazy case generation.  The case encoding rotates
+ * through all cases as the app runs, and every copy checks that it was dispatched
+ * to under its own case.
+ */
+
+#include "dr_api.h"
+#include "client_tools.h"
+#include "drmgr.h"
+#include "drbbdup.h"
+
+#define NUM_CASES 4
+#define ROTATE_PERIOD 64
+
+static uintptr_t case_encoding = 0;
+static uint case_count[NUM_CASES];
+static uint exec_count;
+
+static uintptr_t
+set_up_bb_dups(void *drbbdup_ctx, void *drcontext, void *tag, instrlist_t *bb,
+               bool *enable_dups, bool *enable_dynamic_handling, void *user_data)
+{
+    drbbdup_status_t res;
+
+    /* Name the hot case before registering it to test that order does not matter. */
+    res = drbbdup_set_hot_case_encoding(drbbdup_ctx, case_encoding);
+    CHECK(res == DRBBDUP_SUCCESS, "failed to set hot case");
+    for (uintptr_t i = 1; i < NUM_CASES; i++) {
+        res = drbbdup_register_case_encoding(drbbdup_ctx, i);
+        CHECK(res == DRBBDUP_SUCCESS, "failed to register case");
+    }
+
+    *enable_dups = true;
+    *enable_dynamic_handling = false; /* disable dynamic handling */
+    return 0;                         /* return default case */
+}
+
+static void
+at_copy_start(uintptr_t encoding)
+{
+    CHECK(encoding == case_encoding, "dispatched to the wrong case");
+    case_count[encoding]++;
+    if (++exec_count % ROTATE_PERIOD == 0)
+        case_encoding = (case_encoding + 1) % NUM_CASES;
+}
+
+static void
+instrument_instr(void *drcontext, void *tag, instrlist_t *bb, instr_t *instr,
+                 instr_t *where, uintptr_t encoding, void *user_data,
+                 void *orig_analysis_data, void *analysis_data)
+{
+    bool is_start;
+    drbbdup_status_t res = drbbdup_is_first_instr(drcontext, instr, &is_start);
+    CHECK(res == DRBBDUP_SUCCESS, "failed to check whether instr is start");
+    if (is_start) {
+        dr_insert_clean_call(drcontext, bb, where, at_copy_start, false, 1,
+                             OPND_CREATE_INTPTR(encoding));
+    }
+}
+
+static void
+event_exit(void)
+{
+    for (int i = 0; i < NUM_CASES; i++)
+        CHECK(case_count[i] > 0, "case was never executed");
+
+    drbbdup_stats_t stats = { sizeof(stats) };
+    drbbdup_status_t res = drbbdup_get_stats(&stats);
+    CHECK(res == DRBBDUP_SUCCESS, "failed to get stats");
+    CHECK(stats.hot_case_count > 0, "no hot case was set up");
+    CHECK(stats.lazy_gen_count > 0, "no case was generated lazily");
+    CHECK(stats.dispatch_count > 0, "no dispatcher was built");
+    CHECK(stats.dispatch_compare_count >= stats.dispatch_count,
+          "a dispatcher has at least one comparison");
+
+    res = drbbdup_exit();
+    CHECK(res == DRBBDUP_SUCCESS, "drbbdup exit failed");
+    drmgr_exit();
+}
+
+DR_EXPORT void
+dr_init(client_id_t id)
+{
+    drmgr_init();
+
+    drbbdup_options_t opts = { 0 };
+    opts.struct_size = sizeof(drbbdup_options_t);
+    opts.set_up_bb_dups = set_up_bb_dups;
+    opts.instrument_instr = instrument_instr;
+    opts.runtime_case_opnd = OPND_CREATE_ABSMEM(&case_encoding, OPSZ_PTR);
+    opts.atomic_load_encoding = false;
+    opts.non_default_case_limit = NUM_CASES - 1;
+    opts.never_enable_dynamic_handling = true;
+    opts.lazy_case_generation = true;
+    opts.is_stat_enabled = true;
+
+    drbbdup_status_t res = drbbdup_init(&opts);
+    CHECK(res == DRBBDUP_SUCCESS, "drbbdup init failed");
+    dr_register_exit_event(event_exit);
+}
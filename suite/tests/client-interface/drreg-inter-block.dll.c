@@ -0,0 +1,155 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Tests drreg's inter-block liveness by clobbering every register and the
+ * arithmetic flags at each point where drreg reports them dead.  If drreg
+ * wrongly considered an app value dead across a block boundary, the app would
+ * misbehave.
+ */
+
+#include "dr_api.h"
+#include "client_tools.h"
+#include "drmgr.h"
+#include "drreg.h"
+
+#define POISON_VALUE 0x0badc0de
+
+/* No locks performed on this counter. Single-thread is assumed. */
+static int dead_at_direct_exit;
+
+static void
+event_exit(void);
+static dr_emit_flags_t
+event_bb_insert(void *drcontext, void *tag, instrlist_t *bb, instr_t *inst,
+                bool for_trace, bool translating, void *user_data);
+
+DR_EXPORT void
+dr_init(client_id_t id)
+{
+    drreg_options_t ops = { sizeof(ops), 2 /*max slots needed*/, false };
+    bool ok;
+    drreg_status_t res;
+
+    dr_set_client_name("DynamoRIO Sample Client 'drreg-inter-block'",
+                       "http://dynamorio.org/issues");
+
+    ops.inter_block_liveness = true;
+    drmgr_init();
+    res = drreg_init(&ops);
+    CHECK(res == DRREG_SUCCESS, "drreg init failed");
+    dr_register_exit_event(event_exit);
+
+    ok = drmgr_register_bb_instrumentation_event(NULL, event_bb_insert, NULL);
+    CHECK(ok, "drmgr register bb failed");
+}
+
+static void
+event_exit(void)
+{
+    bool ok = drmgr_unregister_bb_insertion_event(event_bb_insert);
+    CHECK(ok, "drmgr unregister bb failed");
+    /* Without inter-block liveness nothing can be dead at a direct branch or call
+     * that does not itself write the register.
+     */
+    CHECK(dead_at_direct_exit > 0, "inter-block liveness was not used");
+    drreg_exit();
+    drmgr_exit();
+}
+
+static bool
+is_direct_exit(instr_t *inst)
+{
+    return (instr_is_ubr(inst) || instr_is_cbr(inst) || instr_is_call_direct(inst)) &&
+        opnd_is_pc(instr_get_target(inst));
+}
+
+static void
+clobber_register(void *drcontext, instrlist_t *bb, instr_t *inst, reg_id_t reg,
+                 bool aflags_dead)
+{
+    drvector_t allowed;
+    drreg_status_t res;
+    reg_id_t reserved;
+
+    res = drreg_init_and_fill_vector(&allowed, false);
+    CHECK(res == DRREG_SUCCESS, "failed to init vector");
+    res = drreg_set_vector_entry(&allowed, reg, true);
+    CHECK(res == DRREG_SUCCESS, "failed to set entry in vector");
+    res = drreg_reserve_register(drcontext, bb, inst, &allowed, &reserved);
+    CHECK(res == DRREG_SUCCESS && reserved == reg, "failed to reserve dead reg");
+    instrlist_insert_mov_immed_ptrsz(drcontext, POISON_VALUE, opnd_create_reg(reg), bb,
+                                     inst, NULL, NULL);
+    if (aflags_dead) {
+        res = drreg_reserve_aflags(drcontext, bb, inst);
+        CHECK(res == DRREG_SUCCESS, "failed to reserve aflags");
+        instrlist_meta_preinsert(
+            bb, inst,
+            XINST_CREATE_cmp(drcontext, opnd_create_reg(reg), opnd_create_reg(reg)));
+        res = drreg_unreserve_aflags(drcontext, bb, inst);
+        CHECK(res == DRREG_SUCCESS, "failed to unreserve aflags");
+    }
+    res = drreg_unreserve_register(drcontext, bb, inst, reg);
+    CHECK(res == DRREG_SUCCESS, "failed to unreserve reg");
+    drvector_delete(&allowed);
+}
+
+static dr_emit_flags_t
+event_bb_insert(void *drcontext, void *tag, instrlist_t *bb, instr_t *inst,
+                bool for_trace, bool translating, void *user_data)
+{
+    drreg_status_t res;
+    reg_id_t reg;
+    uint aflags;
+    bool clobber_aflags;
+
+    if (!instr_is_app(inst))
+        return DR_EMIT_DEFAULT;
+    res = drreg_aflags_liveness(drcontext, inst, &aflags);
+    CHECK(res == DRREG_SUCCESS, "failed to query aflags liveness");
+    clobber_aflags = (aflags == 0);
+    for (reg = DR_REG_START_GPR; reg <= DR_REG_STOP_GPR; reg++) {
+        bool is_dead;
+        if (reg == dr_get_stolen_reg() IF_ARM(|| reg == DR_REG_PC)
+                IF_NOT_ARM(|| reg == DR_REG_XSP))
+            continue;
+        res = drreg_is_register_dead(drcontext, reg, inst, &is_dead);
+        CHECK(res == DRREG_SUCCESS, "failed to check whether reg is dead");
+        if (!is_dead)
+            continue;
+        if (is_direct_exit(inst) && !instr_writes_to_reg(inst, reg, DR_QUERY_DEFAULT))
+            dead_at_direct_exit++;
+        clobber_register(drcontext, bb, inst, reg, clobber_aflags);
+        clobber_aflags = false;
+    }
+    return DR_EMIT_DEFAULT;
+}
@@ -0,0 +1,83 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Test drwrap_wrap_inline(). */
+
+#include "tools.h"
+#include <setjmp.h>
+
+static jmp_buf env;
+
+EXPORT NOINLINE ptr_int_t
+sum6(ptr_int_t a, ptr_int_t b, ptr_int_t c, ptr_int_t d, ptr_int_t e, ptr_int_t f)
+{
+    return a + b + c + d + e + f;
+}
+
+EXPORT NOINLINE int
+recurse(int depth)
+{
+    if (depth == 0)
+        return 0;
+    return recurse(depth - 1) + 1;
+}
+
+EXPORT NOINLINE void
+jump_out(int value)
+{
+    longjmp(env, value);
+}
+
+EXPORT NOINLINE int
+catcher(int value)
+{
+    /* The return from here finds jump_out's abandoned frame on top. */
+    if (setjmp(env) == 0)
+        jump_out(value);
+    return value;
+}
+
+int
+main(void)
+{
+    ptr_int_t total = 0;
+    int i;
+    /* Enough calls to fill the trace buffer several times. */
+    for (i = 0; i < 2000; i++)
+        total += sum6(i, 1, 2, 3, 4, 5);
+    print("total %d\n", (int)total);
+    print("recurse returned %d\n", recurse(10));
+    print("catcher returned %d\n", catcher(7));
+    print("sum6 returned %d\n", (int)sum6(1, 2, 3, 4, 5, 6));
+    return 0;
+}
@@ -0,0 +1,157 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Test drwrap_wrap_inline(). */
+
+#include "dr_api.h"
+#include "drmgr.h"
+#include "drwrap_inline.h"
+
+#define CHECK(x, ...)                        \
+    do {                                     \
+        if (!(x)) {                          \
+            dr_fprintf(STDERR, __VA_ARGS__); \
+            dr_abort();                      \
+        }                                    \
+    } while (0)
+
+typedef struct _func_stats_t {
+    const char *name;
+    app_pc pc;
+    int calls;
+    int returns;
+} func_stats_t;
+
+enum { SUM6, RECURSE, CATCHER, JUMP_OUT, NUM_FUNCS };
+
+static func_stats_t funcs[NUM_FUNCS] = {
+    { "sum6" },
+    { "recurse" },
+    { "catcher" },
+    { "jump_out" },
+};
+
+/* Distinguishes the two groups of functions passed to batch_cb. */
+static int jump_group;
+static int batches;
+static ptr_uint_t expected_sum;
+
+/* disable the MSVC warning about a constant loop predicate (the while(0) in CHECK) */
+#ifdef _MSC_VER
+#    pragma warning(disable : 4127)
+#endif
+
+static void
+batch_cb(void *drcontext, drwrap_inline_record_t *records, size_t count,
+         void *user_data)
+{
+    size_t i;
+    batches++;
+    for (i = 0; i < count; i++) {
+        drwrap_inline_record_t *rec = &records[i];
+        int f;
+        for (f = 0; f < NUM_FUNCS; f++) {
+            if (rec->func == funcs[f].pc)
+                break;
+        }
+        CHECK(f < NUM_FUNCS, "record for unknown function " PFX "\n", rec->func);
+        CHECK((user_data == &jump_group) == (f == CATCHER || f == JUMP_OUT),
+              "wrong user_data\n");
+        if (rec->is_return)
+            funcs[f].returns++;
+        else
+            funcs[f].calls++;
+        switch (f) {
+        case SUM6:
+            /* sum6 is a leaf, so its return directly follows its entry. */
+            if (rec->is_return) {
+                CHECK(rec->values[0] == expected_sum, "wrong sum6 return value\n");
+            } else {
+                int arg;
+                expected_sum = 0;
+                for (arg = 0; arg < 6; arg++)
+                    expected_sum += rec->values[arg];
+            }
+            break;
+        case RECURSE:
+            if (rec->is_return) {
+                CHECK(rec->values[0] == (ptr_uint_t)funcs[f].returns - 1,
+                      "wrong recurse return value\n");
+            } else {
+                CHECK(rec->values[0] == (ptr_uint_t)(11 - funcs[f].calls),
+                      "wrong recurse arg\n");
+            }
+            break;
+        case CATCHER:
+            CHECK(rec->values[0] == 7, "wrong catcher value\n");
+            break;
+        case JUMP_OUT: CHECK(!rec->is_return, "unexpected jump_out return\n"); break;
+        }
+    }
+}
+
+static void
+event_exit(void)
+{
+    int f;
+    CHECK(batches > 2, "expected the buffer to fill\n");
+    for (f = 0; f < NUM_FUNCS; f++) {
+        dr_fprintf(STDERR, "%s: %d calls, %d returns\n", funcs[f].name, funcs[f].calls,
+                   funcs[f].returns);
+    }
+    drwrap_inline_exit();
+    drmgr_exit();
+    dr_fprintf(STDERR, "all done\n");
+}
+
+DR_EXPORT void
+dr_init(client_id_t id)
+{
+    module_data_t *module = dr_get_main_module();
+    int f;
+
+    drmgr_init();
+    CHECK(drwrap_inline_init(), "drwrap_inline_init failed\n");
+    dr_register_exit_event(event_exit);
+
+    for (f = 0; f < NUM_FUNCS; f++) {
+        funcs[f].pc = (app_pc)dr_get_proc_address(module->handle, funcs[f].name);
+        CHECK(funcs[f].pc != NULL, "failed to find %s\n", funcs[f].name);
+        CHECK(drwrap_wrap_inline(funcs[f].pc, f == SUM6 ? 6 : 1, true, batch_cb,
+                                 (f == CATCHER || f == JUMP_OUT) ? &jump_group : NULL),
+              "wrap failed\n");
+    }
+    CHECK(!drwrap_wrap_inline(funcs[SUM6].pc, 1, false, batch_cb, NULL),
+          "duplicate wrap should fail\n");
+    dr_free_module_data(module);
+}
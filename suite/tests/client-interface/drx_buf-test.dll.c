@@ -43,6 +43,13 @@
 #define CIRCULAR_FAST_SZ DRX_BUF_FAST_CIRCULAR_BUFSZ
 #define CIRCULAR_SLOW_SZ 256
 #define TRACE_SZ 256
+#define ASYNC_NUM_BUFS 2
+/* Each thread has at most ASYNC_NUM_BUFS buffers queued. */
+#define ASYNC_QUEUE_SZ 64
+/* The drop and grow buffers are only released at exit: each submits at most one
+ * per fill plus one per thread exit.
+ */
+#define ASYNC_HELD_SZ (2 * (NUM_ITER * 2 + 2))
 
 #define MINSERT instrlist_meta_preinsert
 
@@ -62,8 +69,33 @@ static const char test_null[TRACE_SZ];
 static drx_buf_t *circular_fast;
 static drx_buf_t *circular_slow;
 static drx_buf_t *trace;
+static drx_buf_t *async_trace;
+static drx_buf_t *async_drop;
+static drx_buf_t *async_grow;
 static volatile int num_faults;
 
+/* Submitted async_trace buffers waiting for async_consumer(). */
+static void *async_queue[ASYNC_QUEUE_SZ];
+static int async_queue_head, async_queue_tail;
+static void *async_lock;
+static bool async_consumer_started;
+/* DR only suspends client threads after the exit event, so event_exit() stops
+ * async_consumer() itself before checking the results.
+ */
+static volatile bool async_exiting;
+static void *async_consumer_done;
+static int num_submits;
+static volatile int num_releases;
+static volatile int num_sync;
+/* Submitted async_drop and async_grow buffers, released in event_exit(). */
+static drx_buf_t *async_held_buf[ASYNC_HELD_SZ];
+static void *async_held[ASYNC_HELD_SZ];
+static int num_held;
+static int num_drop_submits, num_grow_submits;
+
+static void
+async_consumer(void *arg);
+
 static void
 event_thread_init(void *drcontext)
 {
@@ -80,6 +112,15 @@ event_thread_init(void *drcontext)
 
     buf_base = drx_buf_get_buffer_base(drcontext, trace);
     memset(buf_base, 0, TRACE_SZ);
+
+    buf_base = drx_buf_get_buffer_base(drcontext, async_trace);
+    memset(buf_base, 0, TRACE_SZ);
+
+    buf_base = drx_buf_get_buffer_base(drcontext, async_drop);
+    memset(buf_base, 0, TRACE_SZ);
+
+    buf_base = drx_buf_get_buffer_base(drcontext, async_grow);
+    memset(buf_base, 0, TRACE_SZ);
 }
 
 static void
@@ -111,6 +152,85 @@ verify_trace_buffer(void *drcontext, void *buf_base, size_t size)
     dr_atomic_add32_return_sum(&num_faults, 1);
 }
 
+static void
+async_submit(void *drcontext, drx_buf_t *buf, void *buf_base, size_t size)
+{
+    /* Full buffers, and empty ones from thread exit. */
+    CHECK(size == TRACE_SZ || size == 0, "wrong size submitted");
+    dr_mutex_lock(async_lock);
+    if (buf == async_trace) {
+        CHECK(async_queue_tail - async_queue_head < ASYNC_QUEUE_SZ,
+              "async queue overflow");
+        async_queue[async_queue_tail++ % ASYNC_QUEUE_SZ] = buf_base;
+        num_submits++;
+    } else {
+        CHECK(buf == async_drop || buf == async_grow, "wrong buffer submitted");
+        CHECK(num_held < ASYNC_HELD_SZ, "too many buffers held");
+        async_held_buf[num_held] = buf;
+        async_held[num_held++] = buf_base;
+        if (buf == async_drop)
+            num_drop_submits++;
+        else
+            num_grow_submits++;
+    }
+    dr_mutex_unlock(async_lock);
+}
+
+/* The synchronous fallback for async_trace when the consumer falls behind. */
+static void
+async_sync_full(void *drcontext, void *buf_base, size_t size)
+{
+    CHECK(size == TRACE_SZ, "wrong size processed synchronously");
+    dr_atomic_add32_return_sum(&num_sync, 1);
+}
+
+/* Releases one queued buffer, returning false if there were none. */
+static bool
+async_consume_one(void)
+{
+    void *buf_base = NULL;
+    dr_mutex_lock(async_lock);
+    if (async_queue_head < async_queue_tail)
+        buf_base = async_queue[async_queue_head++ % ASYNC_QUEUE_SZ];
+    dr_mutex_unlock(async_lock);
+    if (buf_base == NULL)
+        return false;
+    CHECK(drx_buf_release_buffer(async_trace, buf_base), "release failed");
+    dr_atomic_add32_return_sum(&num_releases, 1);
+    return true;
+}
+
+static void
+async_consumer(void *arg)
+{
+    while (!async_exiting) {
+        if (!async_consume_one())
+            dr_sleep(1);
+    }
+    dr_event_signal(async_consumer_done);
+}
+
+/* Writes an element to \p buf and then fills it, which should swap buffers. */
+static void
+insert_async_fill(void *drcontext, instrlist_t *bb, instr_t *inst, drx_buf_t *buf,
+                  reg_id_t reg_ptr, reg_id_t scratch)
+{
+    drx_buf_insert_load_buf_ptr(drcontext, buf, bb, inst, reg_ptr);
+    drx_buf_insert_buf_store(drcontext, buf, bb, inst, reg_ptr, DR_REG_NULL,
+                             opnd_create_reg(scratch), OPSZ_4, 0);
+    drx_buf_insert_update_buf_ptr(drcontext, buf, bb, inst, reg_ptr, DR_REG_NULL,
+                                  sizeof(int));
+    dr_insert_clean_call(drcontext, bb, inst, verify_buffers_dirty, false, 2,
+                         OPND_CREATE_INTPTR(buf), opnd_create_reg(scratch));
+    drx_buf_insert_load_buf_ptr(drcontext, buf, bb, inst, reg_ptr);
+    drx_buf_insert_update_buf_ptr(drcontext, buf, bb, inst, reg_ptr, DR_REG_NULL,
+                                  TRACE_SZ - sizeof(int));
+    drx_buf_insert_buf_store(drcontext, buf, bb, inst, reg_ptr, DR_REG_NULL,
+                             opnd_create_reg(scratch), OPSZ_4, 0);
+    dr_insert_clean_call(drcontext, bb, inst, verify_buffers_empty, false, 1,
+                         OPND_CREATE_INTPTR(buf));
+}
+
 static void
 verify_store(drx_buf_t *client)
 {
@@ -178,6 +298,19 @@ event_app_instruction(void *drcontext, void *tag, instrlist_t *bb, instr_t *inst
     reg_id_t scratch = IF_X86_ELSE(reg_tmp, DR_REG_R5);
     ptr_int_t subtest = (ptr_int_t)user_data;
 
+    /* A client thread created in dr_init() can crash before the app starts, so
+     * like the client thread tests we create the consumer from the first block.
+     */
+    if (drmgr_is_first_instr(drcontext, inst)) {
+        dr_mutex_lock(async_lock);
+        if (!async_consumer_started) {
+            async_consumer_started = true;
+            CHECK(dr_create_client_thread(async_consumer, NULL),
+                  "consumer thread failed");
+        }
+        dr_mutex_unlock(async_lock);
+    }
+
     if (!instr_is_label(inst))
         return DR_EMIT_DEFAULT;
 
@@ -265,6 +398,11 @@ event_app_instruction(void *drcontext, void *tag, instrlist_t *bb, instr_t *inst
         /* the buffer is now clean */
         dr_insert_clean_call(drcontext, bb, inst, verify_buffers_empty, false, 1,
                              OPND_CREATE_INTPTR(trace));
+
+        /* the same for the async trace buffers, one per policy */
+        insert_async_fill(drcontext, bb, inst, async_trace, reg_ptr, scratch);
+        insert_async_fill(drcontext, bb, inst, async_drop, reg_ptr, scratch);
+        insert_async_fill(drcontext, bb, inst, async_grow, reg_ptr, scratch);
     } else if (subtest == DRX_BUF_TEST_4_C) {
         /* test immediate store: 8 bytes (if possible), 4 bytes, 2 bytes and 1 byte */
         /* "ABCDEFGH\x00" (x2 for x64) */
@@ -391,16 +529,62 @@ event_app_instruction(void *drcontext, void *tag, instrlist_t *bb, instr_t *inst
 static void
 event_exit(void)
 {
+    drx_buf_async_stats_t stats;
+    int i;
+    /* Stop the consumer, then release the final thread's buffer ourselves. */
+    async_exiting = true;
+    dr_event_wait(async_consumer_done);
+    dr_event_destroy(async_consumer_done);
+    while (async_consume_one()) {
+    }
     /* we are supposed to have faulted NUM_ITER times per thread, plus 2 more
      * because the callback is called on thread_exit(). Finally, two more for
      * drx_buf_insert_buf_memcpy().
      */
     CHECK(num_faults == NUM_ITER * 2 + 2 + 2, "the number of faults don't match up");
+    /* Each fault was either submitted or, if the consumer fell behind, processed
+     * synchronously.  Each thread exit submits too.
+     */
+    CHECK(num_submits + num_sync == NUM_ITER * 2 + 2,
+          "the number of submits don't match up");
+    CHECK(num_releases == num_submits, "not all buffers were released");
+    stats.size = sizeof(stats);
+    CHECK(drx_buf_get_async_stats(async_trace, &stats), "get stats failed");
+    CHECK(stats.buffers_submitted == (uint64)num_submits &&
+              stats.buffers_processed_sync == (uint64)num_sync &&
+              stats.buffers_dropped == 0 && stats.buffers_grown == 0,
+          "async stats don't match up");
+
+    /* Nothing released async_drop's buffers, so after each thread's first fault
+     * every fault dropped the contents of the one it kept writing.
+     */
+    CHECK(drx_buf_get_async_stats(async_drop, &stats), "get stats failed");
+    CHECK(num_drop_submits == 2 + 2 && stats.buffers_submitted == 2 + 2 &&
+              stats.buffers_dropped == NUM_ITER * 2 - 2 &&
+              stats.bytes_dropped == (NUM_ITER * 2 - 2) * TRACE_SZ &&
+              stats.buffers_grown == 0 && stats.buffers_processed_sync == 0,
+          "async drop stats don't match up");
+    /* Nor async_grow's, so after each thread's first fault every fault grew. */
+    CHECK(drx_buf_get_async_stats(async_grow, &stats), "get stats failed");
+    CHECK(num_grow_submits == NUM_ITER * 2 + 2 &&
+              stats.buffers_submitted == NUM_ITER * 2 + 2 &&
+              stats.buffers_grown == NUM_ITER * 2 - 2 && stats.buffers_dropped == 0 &&
+              stats.buffers_processed_sync == 0,
+          "async grow stats don't match up");
+    /* The last release of each exited thread's buffers frees them. */
+    for (i = 0; i < num_held; i++) {
+        CHECK(drx_buf_release_buffer(async_held_buf[i], async_held[i]),
+              "release failed");
+    }
     if (!drmgr_unregister_bb_insertion_event(event_app_instruction))
         CHECK(false, "exit failed");
     drx_buf_free(circular_fast);
     drx_buf_free(circular_slow);
     drx_buf_free(trace);
+    drx_buf_free(async_trace);
+    drx_buf_free(async_drop);
+    drx_buf_free(async_grow);
+    dr_mutex_destroy(async_lock);
     drmgr_unregister_thread_init_event(event_thread_init);
     drmgr_exit();
     drx_exit();
@@ -420,6 +604,23 @@ dr_init(client_id_t id)
     CHECK(circular_fast != NULL, "circular fast failed");
     CHECK(circular_slow != NULL, "circular slow failed");
     CHECK(trace != NULL, "trace failed");
+    async_trace = drx_buf_create_async_trace_buffer(
+        TRACE_SZ, ASYNC_NUM_BUFS, DRX_BUF_ASYNC_SYNC, async_submit, async_sync_full);
+    async_drop = drx_buf_create_async_trace_buffer(TRACE_SZ, ASYNC_NUM_BUFS,
+                                                   DRX_BUF_ASYNC_DROP, async_submit,
+                                                   NULL);
+    async_grow = drx_buf_create_async_trace_buffer(TRACE_SZ, ASYNC_NUM_BUFS,
+                                                   DRX_BUF_ASYNC_GROW, async_submit,
+                                                   NULL);
+    CHECK(async_trace != NULL, "async trace failed");
+    CHECK(async_drop != NULL, "async drop failed");
+    CHECK(async_grow != NULL, "async grow failed");
+    CHECK(drx_buf_create_async_trace_buffer(TRACE_SZ, ASYNC_NUM_BUFS,
+                                            DRX_BUF_ASYNC_SYNC, async_submit,
+                                            NULL) == NULL,
+          "sync policy without a full callback should fail");
+    async_lock = dr_mutex_create();
+    async_consumer_done = dr_event_create();
 
     CHECK(drmgr_register_thread_init_event(event_thread_init),
           "event thread init failed");